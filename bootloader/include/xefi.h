@@ -33,6 +33,28 @@ efi_file_protocol* xefi_open_file(char16_t* filename);
 void* xefi_read_file(efi_file_protocol* file, size_t* _sz, size_t front_bytes);
 void* xefi_load_file(char16_t* filename, size_t* size_out, size_t front_bytes);
 
+// Overlapped file read.  xefi_read_file_begin() allocates the buffer and
+// starts the transfer with ReadEx() when the firmware's file protocol is
+// revision 2 or later, so the caller can do other work while the disk is
+// busy; on older firmware it falls back to a synchronous Read() and the
+// data is already in place when it returns.  xefi_read_file_finish() waits
+// for an outstanding transfer and returns the data, or NULL on error
+// (releasing the buffer).  A begin that returns an error has already
+// cleaned up; do not call finish for it.
+typedef struct {
+    efi_file_protocol* file;
+    efi_file_io_token token;
+    void* data;         // where the file contents land
+    size_t size;        // file size in bytes
+    size_t pages;       // allocation, starting front_bytes before data
+    size_t front_bytes;
+    bool pending;       // a ReadEx() is outstanding
+} xefi_file_read;
+
+efi_status xefi_read_file_begin(efi_file_protocol* file, size_t front_bytes,
+                                xefi_file_read* rd);
+void* xefi_read_file_finish(xefi_file_read* rd, size_t* _sz);
+
 efi_status xefi_find_pci_mmio(efi_boot_services* bs, uint8_t cls, uint8_t sub, uint8_t ifc, uint64_t* mmio);
 
 // GUIDs
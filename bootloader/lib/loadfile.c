@@ -7,6 +7,7 @@
 
 #include <xefi.h>
 #include <stdio.h>
+#include <string.h>
 
 #ifndef VERBOSE
 #define xprintf(...) do {} while (0);
@@ -99,6 +100,97 @@ void* xefi_read_file(efi_file_protocol* file, size_t* _sz, size_t front_bytes) {
     return data + front_bytes;
 }
 
+efi_status xefi_read_file_begin(efi_file_protocol* file, size_t front_bytes,
+                                xefi_file_read* rd) {
+    efi_status r;
+
+    char buf[512];
+    size_t sz = sizeof(buf);
+    efi_file_info* finfo = (void*)buf;
+    r = file->GetInfo(file, &FileInfoGuid, &sz, finfo);
+    if (r) {
+        xprintf("LoadFile: Cannot get FileInfo (%s)\n", xefi_strerror(r));
+        return r;
+    }
+
+    memset(rd, 0, sizeof(*rd));
+    rd->file = file;
+    rd->size = finfo->FileSize;
+    rd->front_bytes = front_bytes;
+    rd->pages = (finfo->FileSize + front_bytes + 4095) / 4096;
+
+    void* data = NULL;
+    r = gBS->AllocatePages(AllocateAnyPages, EfiLoaderData, rd->pages,
+                           (efi_physical_addr*)&data);
+    if (r) {
+        xprintf("LoadFile: Cannot allocate buffer (%s)\n", xefi_strerror(r));
+        return r;
+    }
+    rd->data = data + front_bytes;
+
+    if ((file->Revision >= EFI_FILE_PROTOCOL_REVISION2) && (file->ReadEx != NULL)) {
+        r = gBS->CreateEvent(0, TPL_CALLBACK, NULL, NULL, &rd->token.Event);
+        if (r == EFI_SUCCESS) {
+            rd->token.Status = EFI_NOT_READY;
+            rd->token.BufferSize = rd->size;
+            rd->token.Buffer = rd->data;
+            r = file->ReadEx(file, &rd->token);
+            if (r == EFI_SUCCESS) {
+                rd->pending = true;
+                return EFI_SUCCESS;
+            }
+            gBS->CloseEvent(rd->token.Event);
+            rd->token.Event = NULL;
+        }
+        xprintf("LoadFile: ReadEx failed, reading synchronously (%s)\n",
+                xefi_strerror(r));
+    }
+
+    // No async support; by the time we return the read is already done.
+    sz = rd->size;
+    r = file->Read(file, &sz, rd->data);
+    if ((r == EFI_SUCCESS) && (sz != rd->size)) {
+        xprintf("LoadFile: Short read\n");
+        r = EFI_LOAD_ERROR;
+    }
+    if (r) {
+        xprintf("LoadFile: Error reading file (%s)\n", xefi_strerror(r));
+        gBS->FreePages((efi_physical_addr)data, rd->pages);
+        rd->data = NULL;
+        return r;
+    }
+    return EFI_SUCCESS;
+}
+
+void* xefi_read_file_finish(xefi_file_read* rd, size_t* _sz) {
+    efi_status r = EFI_SUCCESS;
+
+    if (rd->pending) {
+        size_t index;
+        r = gBS->WaitForEvent(1, &rd->token.Event, &index);
+        gBS->CloseEvent(rd->token.Event);
+        rd->pending = false;
+        if (r == EFI_SUCCESS) {
+            r = rd->token.Status;
+        }
+        if ((r == EFI_SUCCESS) && (rd->token.BufferSize != rd->size)) {
+            xprintf("LoadFile: Short read\n");
+            r = EFI_LOAD_ERROR;
+        }
+    }
+    if (rd->data == NULL) {
+        return NULL;
+    }
+    if (r) {
+        xprintf("LoadFile: Error reading file (%s)\n", xefi_strerror(r));
+        gBS->FreePages((efi_physical_addr)(rd->data - rd->front_bytes), rd->pages);
+        rd->data = NULL;
+        return NULL;
+    }
+    *_sz = rd->size;
+    return rd->data;
+}
+
 void* xefi_load_file(char16_t* filename, size_t* _sz, size_t front_bytes) {
     efi_file_protocol* file = xefi_open_file(filename);
     if (!file) {
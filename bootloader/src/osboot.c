@@ -385,6 +385,29 @@ EFIAPI efi_status efi_main(efi_handle img, efi_system_table* sys) {
         goto fail;
     }
 
+    // If we have a local kernel, start loading its ramdisk now so the
+    // transfer overlaps the boot prompt below; by the time the user picks
+    // (m) -- or the timeout picks it for them -- the data is usually
+    // already in memory and we only have to wait for the tail end.
+    efi_file_protocol* ramdisk_file = NULL;
+    const char* ramdisk_name = NULL;
+    xefi_file_read ramdisk_rd;
+    if (kernel != NULL) {
+        ramdisk_file = xefi_open_file(L"bootdata.bin");
+        ramdisk_name = "bootdata.bin";
+        if (ramdisk_file == NULL) {
+            ramdisk_file = xefi_open_file(L"ramdisk.bin");
+            ramdisk_name = "ramdisk.bin";
+        }
+        if (ramdisk_file) {
+            printf("Loading %s...\n", ramdisk_name);
+            if (xefi_read_file_begin(ramdisk_file, FRONT_BYTES, &ramdisk_rd)) {
+                ramdisk_file->Close(ramdisk_file);
+                ramdisk_file = NULL;
+            }
+        }
+    }
+
     char valid_keys[4];
     memset(valid_keys, 0, sizeof(valid_keys));
     int key_idx = 0;
@@ -417,6 +440,8 @@ EFIAPI efi_status efi_main(efi_handle img, efi_system_table* sys) {
     gBS->SetWatchdogTimer(0, 0x10000, 0, NULL);
 
     int timeout_s = cmdline_get_uint32("bootloader.timeout", DEFAULT_TIMEOUT);
+    size_t rsz = 0;
+    void* ramdisk = NULL;
     while (true) {
         printf("\nPress (b) for the boot menu");
         if (have_network) {
@@ -441,18 +466,13 @@ EFIAPI efi_status efi_main(efi_handle img, efi_system_table* sys) {
             do_netboot();
             break;
         case 'm': {
-            size_t rsz = 0;
-            void* ramdisk = NULL;
-            efi_file_protocol* ramdisk_file = xefi_open_file(L"bootdata.bin");
-            const char* ramdisk_name = "bootdata.bin";
-            if (ramdisk_file == NULL) {
-                ramdisk_file = xefi_open_file(L"ramdisk.bin");
-                ramdisk_name = "ramdisk.bin";
-            }
             if (ramdisk_file) {
-                printf("Loading %s...\n", ramdisk_name);
-                ramdisk = xefi_read_file(ramdisk_file, &rsz, FRONT_BYTES);
+                ramdisk = xefi_read_file_finish(&ramdisk_rd, &rsz);
+                if (ramdisk == NULL) {
+                    printf("Failed to load %s\n", ramdisk_name);
+                }
                 ramdisk_file->Close(ramdisk_file);
+                ramdisk_file = NULL;
             }
             boot_kernel(gImg, gSys, kernel, ksz, ramdisk, rsz);
             break;
@@ -36,6 +36,10 @@ status_t arch_guest_get_gpr(const mxtl::unique_ptr<GuestContext>& context,
     return ERR_NOT_SUPPORTED;
 }
 
+status_t arch_guest_interrupt(const mxtl::unique_ptr<GuestContext>& context, uint32_t vector) {
+    return ERR_NOT_SUPPORTED;
+}
+
 status_t arch_guest_set_ip(const mxtl::unique_ptr<GuestContext>& context, uintptr_t guest_ip) {
     return ERR_NOT_SUPPORTED;
 }
@@ -100,6 +100,12 @@ static inline uint32_t arch_dcache_line_size(void) {
     return 4u << dcache_log2;
 }
 
+static inline bool arch_usermode_can_get_cpu_num(void) {
+    // arch_mp_init_percpu stamps each cpu's number into tpidrro_el0,
+    // which EL0 can read but not write.
+    return true;
+}
+
 // Log architecture-specific data for process creation.
 // This can only be called after the process has been created and before
 // it is running: |aspace| is assumed to live across the call.
@@ -23,6 +23,10 @@
 #define LOCAL_TRACE 0
 #define TRACE_CONTEXT_SWITCH 0
 
+/* Unmaps at least this large flush the whole ASID in one TLBI rather than
+ * issuing one broadcast TLBI per page. */
+#define MMU_ARM64_ASID_FLUSH_THRESHOLD (32UL * PAGE_SIZE)
+
 static_assert(((long)KERNEL_BASE >> MMU_KERNEL_SIZE_SHIFT) == -1, "");
 static_assert(((long)KERNEL_ASPACE_BASE >> MMU_KERNEL_SIZE_SHIFT) == -1, "");
 static_assert(MMU_KERNEL_SIZE_SHIFT <= 48, "");
@@ -85,6 +89,8 @@ static pte_t mmu_flags_to_pte_attr(uint flags) {
         attr |= MMU_PTE_ATTR_NORMAL_MEMORY | MMU_PTE_ATTR_SH_INNER_SHAREABLE;
         break;
     case ARCH_MMU_FLAG_WRITE_COMBINING:
+        attr |= MMU_PTE_ATTR_NORMAL_UNCACHED;
+        break;
     case ARCH_MMU_FLAG_UNCACHED:
         attr |= MMU_PTE_ATTR_STRONGLY_ORDERED;
         break;
@@ -204,6 +210,9 @@ status_t arch_mmu_query(arch_aspace_t* aspace, vaddr_t vaddr, paddr_t* paddr, ui
         case MMU_PTE_ATTR_DEVICE:
             *flags |= ARCH_MMU_FLAG_UNCACHED_DEVICE;
             break;
+        case MMU_PTE_ATTR_NORMAL_UNCACHED:
+            *flags |= ARCH_MMU_FLAG_WRITE_COMBINING;
+            break;
         case MMU_PTE_ATTR_NORMAL_MEMORY:
             break;
         default:
@@ -264,7 +273,15 @@ static status_t alloc_page_table(paddr_t* paddrp, uint page_size_shift) {
     return 0;
 }
 
-static void free_page_table(void* vaddr, paddr_t paddr, uint page_size_shift) {
+/* Frees a page table, or queues it on |deferred| if the caller is
+ * batching invalidations and will free it after the TLB flush.  Tables
+ * smaller than PAGE_SIZE come from the heap and are freed immediately in
+ * either case; the heap never unmaps its pages, so a stale walk through
+ * one reads garbage but cannot fault, the same window the non-batched
+ * path already has between the per-page TLBIs and the final DSB.
+ */
+static void free_page_table(void* vaddr, paddr_t paddr, uint page_size_shift,
+                            struct list_node* deferred) {
     DEBUG_ASSERT(page_size_shift <= MMU_MAX_PAGE_SIZE_SHIFT);
 
     LTRACEF("vaddr %p paddr 0x%lx page_size_shift %u\n", vaddr, paddr, page_size_shift);
@@ -276,7 +293,11 @@ static void free_page_table(void* vaddr, paddr_t paddr, uint page_size_shift) {
         page = paddr_to_vm_page(paddr);
         if (!page)
             panic("bad page table paddr 0x%lx\n", paddr);
-        pmm_free_page(page);
+        if (deferred) {
+            list_add_tail(deferred, &page->free.node);
+        } else {
+            pmm_free_page(page);
+        }
     } else {
         free(vaddr);
     }
@@ -343,10 +364,62 @@ static bool page_table_is_clear(volatile pte_t* page_table, uint page_size_shift
     return true;
 }
 
+/* Splits the block descriptor at |page_table[index]| into a table of
+ * next-level entries covering the same range with the same attributes, so
+ * that part of the block can then be unmapped or have its permissions
+ * changed.  Follows break-before-make: the entry is invalidated and
+ * flushed before the table descriptor is installed, as the architecture
+ * requires when changing a block to a table.
+ */
+static status_t arm64_mmu_split_block(vaddr_t vaddr, uint index_shift, uint page_size_shift,
+                                      volatile pte_t* page_table, vaddr_t index, uint asid) {
+    pte_t old_pte = page_table[index];
+    DEBUG_ASSERT((old_pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK);
+
+    paddr_t paddr;
+    status_t ret = alloc_page_table(&paddr, page_size_shift);
+    if (ret)
+        return ret;
+    volatile pte_t* sub_table = static_cast<volatile pte_t*>(paddr_to_kvaddr(paddr));
+
+    uint next_shift = index_shift - (page_size_shift - 3);
+    paddr_t block_paddr = old_pte & MMU_PTE_OUTPUT_ADDR_MASK;
+    pte_t attrs = old_pte & ~(MMU_PTE_OUTPUT_ADDR_MASK | MMU_PTE_DESCRIPTOR_MASK);
+    pte_t descriptor = (next_shift == page_size_shift) ? MMU_PTE_L3_DESCRIPTOR_PAGE
+                                                       : MMU_PTE_L012_DESCRIPTOR_BLOCK;
+
+    vaddr_t entries = 1UL << (page_size_shift - 3);
+    for (vaddr_t i = 0; i < entries; i++) {
+        sub_table[i] = (block_paddr + (i << next_shift)) | attrs | descriptor;
+    }
+    __asm__ volatile("dmb ishst" ::
+                         : "memory");
+
+    page_table[index] = MMU_PTE_DESCRIPTOR_INVALID;
+    __asm__ volatile("dmb ishst" ::
+                         : "memory");
+    if (asid == MMU_ARM64_GLOBAL_ASID)
+        ARM64_TLBI(vaae1is, vaddr >> 12);
+    else
+        ARM64_TLBI(vae1is, vaddr >> 12 | (vaddr_t)asid << 48);
+    DSB;
+
+    page_table[index] = paddr | MMU_PTE_L012_DESCRIPTOR_TABLE;
+    LTRACEF("pte %p[%#" PRIxPTR "] = %#" PRIx64 " (split block)\n",
+            page_table, index, page_table[index]);
+    return NO_ERROR;
+}
+
+/* If |deferred| is non-NULL the caller flushes the whole ASID once the
+ * walk completes: the per-page TLBIs are skipped and emptied page tables
+ * are queued on |deferred| rather than freed, since remote CPUs may walk
+ * them until that flush.
+ */
 static ssize_t arm64_mmu_unmap_pt(vaddr_t vaddr, vaddr_t vaddr_rel,
                                   size_t size,
                                   uint index_shift, uint page_size_shift,
-                                  volatile pte_t* page_table, uint asid) {
+                                  volatile pte_t* page_table, uint asid,
+                                  struct list_node* deferred) {
     volatile pte_t* next_page_table;
     vaddr_t index;
     size_t chunk_size;
@@ -377,7 +450,7 @@ static ssize_t arm64_mmu_unmap_pt(vaddr_t vaddr, vaddr_t vaddr_rel,
             arm64_mmu_unmap_pt(vaddr, vaddr_rem, chunk_size,
                                index_shift - (page_size_shift - 3),
                                page_size_shift,
-                               next_page_table, asid);
+                               next_page_table, asid, deferred);
             if (chunk_size == block_size ||
                 page_table_is_clear(next_page_table, page_size_shift)) {
                 LTRACEF("pte %p[0x%lx] = 0 (was page table)\n", page_table, index);
@@ -385,16 +458,29 @@ static ssize_t arm64_mmu_unmap_pt(vaddr_t vaddr, vaddr_t vaddr_rel,
                 __asm__ volatile("dmb ishst" ::
                                      : "memory");
                 free_page_table(const_cast<pte_t*>(next_page_table), page_table_paddr,
-                                page_size_shift);
+                                page_size_shift, deferred);
             }
         } else if (pte) {
+            if (index_shift > page_size_shift &&
+                (vaddr_rem != 0 || chunk_size != block_size)) {
+                /* partial unmap of a block mapping: split it into
+                 * next-level entries and retry this chunk.  If the split
+                 * fails, fall through and unmap the whole block; a
+                 * subsequent page fault brings the rest back. */
+                if (arm64_mmu_split_block(vaddr, index_shift, page_size_shift,
+                                          page_table, index, asid) == NO_ERROR) {
+                    continue;
+                }
+            }
             LTRACEF("pte %p[0x%lx] = 0\n", page_table, index);
             page_table[index] = MMU_PTE_DESCRIPTOR_INVALID;
             CF;
-            if (asid == MMU_ARM64_GLOBAL_ASID)
-                ARM64_TLBI(vaae1is, vaddr >> 12);
-            else
-                ARM64_TLBI(vae1is, vaddr >> 12 | (vaddr_t)asid << 48);
+            if (!deferred) {
+                if (asid == MMU_ARM64_GLOBAL_ASID)
+                    ARM64_TLBI(vaae1is, vaddr >> 12);
+                else
+                    ARM64_TLBI(vae1is, vaddr >> 12 | (vaddr_t)asid << 48);
+            }
         } else {
             LTRACEF("pte %p[0x%lx] already clear\n", page_table, index);
         }
@@ -487,7 +573,7 @@ static ssize_t arm64_mmu_map_pt(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
 
 err:
     arm64_mmu_unmap_pt(vaddr_in, vaddr_rel_in, size_in - size,
-                       index_shift, page_size_shift, page_table, asid);
+                       index_shift, page_size_shift, page_table, asid, NULL);
     DSB;
     return ERR_INTERNAL;
 }
@@ -541,6 +627,17 @@ static int arm64_mmu_protect_pt(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
                 goto err;
             }
         } else if (pte) {
+            if (index_shift > page_size_shift &&
+                (vaddr_rem != 0 || chunk_size != block_size)) {
+                /* changing permissions on part of a block mapping: split
+                 * it into next-level entries and retry this chunk */
+                ret = arm64_mmu_split_block(vaddr, index_shift, page_size_shift,
+                                            page_table, index, asid);
+                if (ret != NO_ERROR) {
+                    goto err;
+                }
+                continue;
+            }
             pte = (pte & ~MMU_PTE_PERMISSION_MASK) | attrs;
             LTRACEF("pte %p[%#" PRIxPTR "] = %#" PRIx64 "\n",
                     page_table, index, pte);
@@ -621,9 +718,25 @@ static ssize_t arm64_mmu_unmap(vaddr_t vaddr, size_t size,
         return ERR_INVALID_ARGS;
     }
 
+    /* For large unmaps of a user aspace, one ASID-wide invalidate is
+     * cheaper than a broadcast TLBI per page: skip the per-page TLBIs in
+     * the walk and issue a single ASIDE1IS afterwards.  The kernel aspace
+     * maps with the global ASID, which that instruction cannot reach, so
+     * it always takes the per-page path. */
+    struct list_node deferred = LIST_INITIAL_VALUE(deferred);
+    bool flush_asid = (asid != MMU_ARM64_GLOBAL_ASID) &&
+                      (size >= MMU_ARM64_ASID_FLUSH_THRESHOLD);
+
     ssize_t ret = arm64_mmu_unmap_pt(vaddr, vaddr_rel, size,
-                       top_index_shift, page_size_shift, top_page_table, asid);
+                       top_index_shift, page_size_shift, top_page_table, asid,
+                       flush_asid ? &deferred : NULL);
+    if (flush_asid)
+        ARM64_TLBI(ASIDE1IS, asid);
     DSB;
+    /* page tables queued during the walk are safe to recycle now that the
+     * invalidate has completed */
+    if (!list_is_empty(&deferred))
+        pmm_free(&deferred);
     return ret;
 }
 
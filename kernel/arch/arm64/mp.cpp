@@ -49,6 +49,11 @@ status_t arch_mp_send_ipi(mp_cpu_mask_t target, mp_ipi_t ipi)
 
 void arch_mp_init_percpu(void)
 {
+    // Publish our cpu number in tpidrro_el0, which EL0 can read but not
+    // write; the vDSO's mx_system_get_cpu_num depends on this.  Nothing
+    // else uses the register, and the context switch path leaves it alone.
+    __asm__ volatile("msr tpidrro_el0, %0" :: "r"((uint64_t)arch_curr_cpu_num()));
+
     interrupt_init_percpu();
 }
 
@@ -19,7 +19,10 @@ struct context_switch_frame {
     vaddr_t lr;
     vaddr_t pad;                // Padding to keep frame size a multiple of
     vaddr_t tpidr_el0;          //  sp alignment requirements (16 bytes)
-    vaddr_t tpidrro_el0;
+    vaddr_t pad2;               // tpidrro_el0 is deliberately not part of
+                                //  the frame: it holds the current cpu
+                                //  number for the vDSO (stamped once by
+                                //  arch_mp_init_percpu), not thread state.
     vaddr_t r18;
     vaddr_t r19;
     vaddr_t r20;
@@ -425,6 +425,14 @@ void x86_exception_handler(x86_iframe_t *frame)
             /* no return */
             break;
         }
+        case X86_INT_VMX_POSTED: {
+            /* Posted-interrupt notifications are consumed by the CPU when they
+             * arrive in VMX non-root mode; if one lands here the guest has
+             * already exited and the hypervisor will fold the posted bits into
+             * the virtual APIC before the next entry, so just ack it. */
+            apic_issue_eoi();
+            break;
+        }
         /* pass all other non-Intel defined irq vectors to the platform */
         case X86_INT_PLATFORM_BASE  ... X86_INT_PLATFORM_MAX: {
             CPU_STATS_INC(interrupts);
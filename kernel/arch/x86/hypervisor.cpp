@@ -11,6 +11,8 @@
 #include <arch/x86/apic.h>
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/interrupts.h>
+#include <kernel/auto_lock.h>
 #include <kernel/vm/fault.h>
 #include <kernel/vm/pmm.h>
 #include <hypervisor/guest_physical_address_space.h>
@@ -413,6 +415,19 @@ VmxonPerCpu* VmxonContext::PerCpu() {
     return &per_cpus_[arch_curr_cpu_num()];
 }
 
+/* Returns true if interrupts can be posted to the guest without a VM exit.
+ * This requires process-posted-interrupts, virtual-interrupt delivery, and
+ * acknowledge-interrupt-on-exit. See Volume 3, Section 29.6. */
+static bool posted_interrupts_supported() {
+    // The allowed-1 settings are in the high half of each MSR.
+    return (BITS_SHIFT(read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS), 63, 32) &
+            PINBASED_CTLS_POSTED_INTERRUPTS) &&
+           (BITS_SHIFT(read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2), 63, 32) &
+            PROCBASED_CTLS2_VIRT_INT_DELIVERY) &&
+           (BITS_SHIFT(read_msr(X86_MSR_IA32_VMX_TRUE_EXIT_CTLS), 63, 32) &
+            EXIT_CTLS_ACK_INT_ON_EXIT);
+}
+
 status_t VmcsPerCpu::Init(const VmxInfo& vmx_info) {
     status_t status = PerCpu::Init(vmx_info);
     if (status != NO_ERROR)
@@ -432,6 +447,13 @@ status_t VmcsPerCpu::Init(const VmxInfo& vmx_info) {
     local_apic_state_.active_interrupt = kInvalidInterrupt;
     local_apic_state_.tsc_deadline = 0;
     local_apic_state_.apic_addr = nullptr;
+    local_apic_state_.pi_desc = nullptr;
+    if (posted_interrupts_supported()) {
+        status = pi_desc_page_.Alloc(vmx_info, 0);
+        if (status != NO_ERROR)
+            return status;
+        local_apic_state_.pi_desc = pi_desc_page_.VirtualAddress<PostedInterruptDescriptor>();
+    }
     return NO_ERROR;
 }
 
@@ -530,6 +552,11 @@ status_t VmcsPerCpu::Setup(paddr_t pml4_address, paddr_t apic_access_address,
 
     AutoVmcsLoad vmcs_load(&page_);
 
+    // If the hardware supports it, deliver interrupts to the guest through
+    // posted-interrupt processing, so that the VMM can signal interrupts
+    // without forcing a VM exit.
+    const bool posted_interrupts = local_apic_state_.pi_desc != nullptr;
+
     // Setup secondary processor-based VMCS controls.
     status = set_vmcs_control(VmcsField32::PROCBASED_CTLS2,
                               read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2),
@@ -542,7 +569,11 @@ status_t VmcsPerCpu::Setup(paddr_t pml4_address, paddr_t apic_access_address,
                               PROCBASED_CTLS2_RDTSCP |
                               // Associate cached translations of linear
                               // addresses with a virtual processor ID.
-                              PROCBASED_CTLS2_VPID,
+                              PROCBASED_CTLS2_VPID |
+                              // Enable virtual-interrupt delivery, so posted
+                              // interrupts are evaluated and delivered from
+                              // the virtual APIC without a VM exit.
+                              (posted_interrupts ? PROCBASED_CTLS2_VIRT_INT_DELIVERY : 0),
                               0);
     if (status != NO_ERROR)
         return status;
@@ -554,7 +585,10 @@ status_t VmcsPerCpu::Setup(paddr_t pml4_address, paddr_t apic_access_address,
                               // External interrupts cause a VM exit.
                               PINBASED_CTLS_EXT_INT_EXITING |
                               // Non-maskable interrupts cause a VM exit.
-                              PINBASED_CTLS_NMI_EXITING,
+                              PINBASED_CTLS_NMI_EXITING |
+                              // Process interrupts posted to the descriptor
+                              // when the notification vector arrives.
+                              (posted_interrupts ? PINBASED_CTLS_POSTED_INTERRUPTS : 0),
                               0);
     if (status != NO_ERROR)
         return status;
@@ -605,7 +639,10 @@ status_t VmcsPerCpu::Setup(paddr_t pml4_address, paddr_t apic_access_address,
                               // Save the guest IA32_EFER MSR on exit.
                               EXIT_CTLS_SAVE_IA32_EFER |
                               // Load the host IA32_EFER MSR on exit.
-                              EXIT_CTLS_LOAD_IA32_EFER,
+                              EXIT_CTLS_LOAD_IA32_EFER |
+                              // Acknowledge interrupts on exit, required for
+                              // posted-interrupt processing.
+                              (posted_interrupts ? EXIT_CTLS_ACK_INT_ON_EXIT : 0),
                               0);
     if (status != NO_ERROR)
         return status;
@@ -666,8 +703,23 @@ status_t VmcsPerCpu::Setup(paddr_t pml4_address, paddr_t apic_access_address,
     vmcs_write(VmcsField64::EPT_POINTER, ept_pointer(pml4_address));
 
     // Setup APIC handling.
+    //
+    // NOTE: The virtual-APIC address is written in VmcsPerCpu::Enter, as the
+    // virtual APIC memory is provided after the guest has been created.
     vmcs_write(VmcsField64::APIC_ACCESS_ADDRESS, apic_access_address);
-    vmcs_write(VmcsField64::VIRTUAL_APIC_ADDRESS, vaddr_to_paddr(local_apic_state_.apic_addr));
+
+    if (posted_interrupts) {
+        vmcs_write(VmcsField16::POSTED_INTERRUPT_VECTOR,
+                   static_cast<uint16_t>(X86_INT_VMX_POSTED));
+        vmcs_write(VmcsField64::POSTED_INTERRUPT_DESC_ADDRESS, pi_desc_page_.PhysicalAddress());
+        // All guest interrupts are edge-triggered, so virtualize every EOI;
+        // none need to cause a VM exit.
+        vmcs_write(VmcsField64::EOI_EXIT_BITMAP0, 0);
+        vmcs_write(VmcsField64::EOI_EXIT_BITMAP1, 0);
+        vmcs_write(VmcsField64::EOI_EXIT_BITMAP2, 0);
+        vmcs_write(VmcsField64::EOI_EXIT_BITMAP3, 0);
+        vmcs_write(VmcsField16::GUEST_INTERRUPT_STATUS, 0);
+    }
 
     // Setup MSR handling.
     vmcs_write(VmcsField64::MSR_BITMAPS_ADDRESS, msr_bitmaps_address);
@@ -818,7 +870,7 @@ void vmx_exit(VmxState* vmx_state) {
 }
 
 status_t VmcsPerCpu::Enter(const VmcsContext& context, GuestPhysicalAddressSpace* gpas,
-                           FifoDispatcher* ctl_fifo) {
+                           FifoDispatcher* ctl_fifo, GuestPortTraps* port_traps) {
     AutoVmcsLoad vmcs_load(&page_);
     // FS is used for thread-local storage — save for this thread.
     vmcs_write(VmcsFieldXX::HOST_FS_BASE, read_msr(X86_MSR_IA32_FS_BASE));
@@ -838,8 +890,17 @@ status_t VmcsPerCpu::Enter(const VmcsContext& context, GuestPhysicalAddressSpace
     if (!vmx_state_.resume) {
         vmcs_write(VmcsFieldXX::GUEST_RIP, context.ip());
         vmcs_write(VmcsFieldXX::GUEST_CR3, context.cr3());
+        // The virtual APIC memory is provided after the VMCS has been setup,
+        // so write its address on first entry.
+        vmcs_write(VmcsField64::VIRTUAL_APIC_ADDRESS,
+                   vaddr_to_paddr(local_apic_state_.apic_addr));
     }
 
+    // Fold any interrupts posted while in VMX root mode into the virtual APIC,
+    // so they are delivered on VM entry.
+    if (local_apic_state_.pi_desc != nullptr)
+        sync_posted_interrupts(&local_apic_state_);
+
     status_t status = vmx_enter(&vmx_state_);
     if (status != NO_ERROR) {
         uint64_t error = vmcs_read(VmcsField32::INSTRUCTION_ERROR);
@@ -847,7 +908,7 @@ status_t VmcsPerCpu::Enter(const VmcsContext& context, GuestPhysicalAddressSpace
     } else {
         vmx_state_.resume = true;
         status = vmexit_handler(&vmcs_load, &vmx_state_.guest_state, &local_apic_state_, gpas,
-                                ctl_fifo);
+                                ctl_fifo, port_traps);
     }
     return status;
 }
@@ -891,6 +952,10 @@ status_t VmcsPerCpu::SetApicMem(mxtl::RefPtr<VmObject> apic_mem) {
                                               &local_apic_state_.apic_addr);
 }
 
+status_t VmcsPerCpu::Interrupt(uint32_t vector) {
+    return local_apic_signal_interrupt(&local_apic_state_, vector);
+}
+
 static int vmcs_setup(void* arg) {
     VmcsContext* context = static_cast<VmcsContext*>(arg);
     VmcsPerCpu* per_cpu = context->PerCpu();
@@ -1003,7 +1068,8 @@ static int vmcs_enter(void* arg) {
         return ERR_BAD_STATE;
     status_t status;
     do {
-        status = per_cpu->Enter(*context, context->gpas(), context->ctl_fifo());
+        status = per_cpu->Enter(*context, context->gpas(), context->ctl_fifo(),
+                                context->port_traps());
     } while (status == NO_ERROR);
     return status;
 }
@@ -1035,6 +1101,53 @@ status_t VmcsContext::SetApicMem(mxtl::RefPtr<VmObject> apic_mem) {
     return per_cpus_[0].SetApicMem(apic_mem);
 }
 
+status_t VmcsContext::Interrupt(uint32_t vector) {
+    // TODO(abdulla): Update this when we move to an external VCPU model.
+    return per_cpus_[0].Interrupt(vector);
+}
+
+status_t GuestPortTraps::Set(uint16_t port, uint16_t len, mxtl::RefPtr<FifoDispatcher> fifo) {
+    if (len == 0 || fifo == nullptr)
+        return ERR_INVALID_ARGS;
+    uint32_t end = static_cast<uint32_t>(port) + len;
+    if (end > UINT16_MAX + 1)
+        return ERR_INVALID_ARGS;
+
+    AutoLock lock(&lock_);
+    Trap* free_trap = nullptr;
+    for (size_t i = 0; i < kMaxTraps; i++) {
+        Trap* trap = &traps_[i];
+        if (trap->fifo == nullptr) {
+            if (free_trap == nullptr)
+                free_trap = trap;
+            continue;
+        }
+        // The range must not overlap an existing trap.
+        if (port < trap->port + trap->len && trap->port < end)
+            return ERR_ALREADY_EXISTS;
+    }
+    if (free_trap == nullptr)
+        return ERR_NO_RESOURCES;
+    free_trap->port = port;
+    free_trap->len = len;
+    free_trap->fifo = mxtl::move(fifo);
+    return NO_ERROR;
+}
+
+mxtl::RefPtr<FifoDispatcher> GuestPortTraps::Find(uint16_t port) {
+    AutoLock lock(&lock_);
+    for (size_t i = 0; i < kMaxTraps; i++) {
+        const Trap& trap = traps_[i];
+        if (trap.fifo != nullptr && port >= trap.port && port < trap.port + trap.len)
+            return trap.fifo;
+    }
+    return nullptr;
+}
+
+status_t VmcsContext::SetPortTrap(uint16_t port, uint16_t len, mxtl::RefPtr<FifoDispatcher> fifo) {
+    return port_traps_.Set(port, len, mxtl::move(fifo));
+}
+
 status_t VmcsContext::set_ip(uintptr_t guest_ip) {
     if (guest_ip >= gpas_->size())
         return ERR_INVALID_ARGS;
@@ -1087,6 +1200,10 @@ status_t x86_guest_set_apic_mem(const mxtl::unique_ptr<GuestContext>& context,
     return context->SetApicMem(apic_mem);
 }
 
+status_t arch_guest_interrupt(const mxtl::unique_ptr<GuestContext>& context, uint32_t vector) {
+    return context->Interrupt(vector);
+}
+
 status_t arch_guest_set_ip(const mxtl::unique_ptr<GuestContext>& context, uintptr_t guest_ip) {
     return context->set_ip(guest_ip);
 }
@@ -1094,3 +1211,9 @@ status_t arch_guest_set_ip(const mxtl::unique_ptr<GuestContext>& context, uintpt
 status_t x86_guest_set_cr3(const mxtl::unique_ptr<GuestContext>& context, uintptr_t guest_cr3) {
     return context->set_cr3(guest_cr3);
 }
+
+status_t x86_guest_set_port_trap(const mxtl::unique_ptr<GuestContext>& context,
+                                 uint16_t port, uint16_t len,
+                                 mxtl::RefPtr<FifoDispatcher> fifo) {
+    return context->SetPortTrap(port, len, mxtl::move(fifo));
+}
@@ -12,6 +12,7 @@
 #include <arch/x86/hypervisor_state.h>
 #include <kernel/event.h>
 #include <kernel/timer.h>
+#include <magenta/compiler.h>
 
 typedef struct mx_guest_gpr mx_guest_gpr_t;
 
@@ -47,8 +48,10 @@ static const uint32_t kInvalidInterrupt = UINT32_MAX >> 1;
 /* VMCS fields */
 enum class VmcsField16 : uint64_t {
     VPID                            = 0x0000,   /* Virtual processor ID */
+    POSTED_INTERRUPT_VECTOR         = 0x0002,   /* Posted-interrupt notification vector */
     GUEST_CS_SELECTOR               = 0x0802,   /* Guest CS selector */
     GUEST_TR_SELECTOR               = 0x080e,   /* Guest TR selector */
+    GUEST_INTERRUPT_STATUS          = 0x0810,   /* Guest interrupt status (RVI/SVI) */
     HOST_ES_SELECTOR                = 0x0c00,   /* Host ES selector */
     HOST_CS_SELECTOR                = 0x0c02,   /* Host CS selector */
     HOST_SS_SELECTOR                = 0x0c04,   /* Host SS selector */
@@ -65,7 +68,12 @@ enum class VmcsField64 : uint64_t {
     ENTRY_MSR_LOAD_ADDRESS          = 0x200a,   /* VM-entry MSR-load address */
     VIRTUAL_APIC_ADDRESS            = 0x2012,   /* Virtual-APIC address */
     APIC_ACCESS_ADDRESS             = 0x2014,   /* APIC-access address */
+    POSTED_INTERRUPT_DESC_ADDRESS   = 0x2016,   /* Posted-interrupt descriptor address */
     EPT_POINTER                     = 0x201a,   /* EPT pointer */
+    EOI_EXIT_BITMAP0                = 0x201c,   /* EOI-exit bitmap, vectors 0-63 */
+    EOI_EXIT_BITMAP1                = 0x201e,   /* EOI-exit bitmap, vectors 64-127 */
+    EOI_EXIT_BITMAP2                = 0x2020,   /* EOI-exit bitmap, vectors 128-191 */
+    EOI_EXIT_BITMAP3                = 0x2022,   /* EOI-exit bitmap, vectors 192-255 */
     GUEST_PHYSICAL_ADDRESS          = 0x2400,   /* Guest physical address */
     LINK_POINTER                    = 0x2800,   /* VMCS link pointer */
     GUEST_IA32_PAT                  = 0x2804,   /* Guest PAT */
@@ -145,6 +153,7 @@ enum class VmcsFieldXX : uint64_t {
 #define PROCBASED_CTLS2_EPT                 (1u << 1)
 #define PROCBASED_CTLS2_RDTSCP              (1u << 3)
 #define PROCBASED_CTLS2_VPID                (1u << 5)
+#define PROCBASED_CTLS2_VIRT_INT_DELIVERY   (1u << 9)
 
 /* PROCBASED_CTLS flags */
 #define PROCBASED_CTLS_INT_WINDOW_EXITING   (1u << 2)
@@ -161,9 +170,11 @@ enum class VmcsFieldXX : uint64_t {
 /* PINBASED_CTLS flags */
 #define PINBASED_CTLS_EXT_INT_EXITING       (1u << 0)
 #define PINBASED_CTLS_NMI_EXITING           (1u << 3)
+#define PINBASED_CTLS_POSTED_INTERRUPTS     (1u << 7)
 
 /* EXIT_CTLS flags */
 #define EXIT_CTLS_64BIT_MODE                (1u << 9)
+#define EXIT_CTLS_ACK_INT_ON_EXIT           (1u << 15)
 #define EXIT_CTLS_SAVE_IA32_PAT             (1u << 18)
 #define EXIT_CTLS_LOAD_IA32_PAT             (1u << 19)
 #define EXIT_CTLS_SAVE_IA32_EFER            (1u << 20)
@@ -260,6 +271,24 @@ private:
     VmxPage* page_;
 };
 
+/* Posted-interrupt descriptor. See Volume 3, Section 29.6.
+ *
+ * Interrupts are posted by atomically setting the vector's bit in |pir| and
+ * the outstanding-notification bit of |control|, then sending the notification
+ * vector to the CPU running the guest. If the CPU is in VMX non-root mode it
+ * folds the posted bits into the virtual APIC without a VM exit; otherwise the
+ * hypervisor does so before the next VM entry. */
+struct PostedInterruptDescriptor {
+    // Posted-interrupt requests, one bit per vector.
+    volatile int pir[8];
+    // Bit 0 is the outstanding-notification bit.
+    volatile int control;
+    uint32_t reserved[7];
+} __ALIGNED(64);
+
+static_assert(sizeof(PostedInterruptDescriptor) == 64,
+              "posted-interrupt descriptor must be 64 bytes");
+
 /* Stores the local APIC state across VM exits. */
 struct LocalApicState {
     // Timer for APIC timer.
@@ -274,6 +303,8 @@ struct LocalApicState {
     void* apic_addr;
     // Virtual local APIC memory.
     mxtl::RefPtr<VmObject> apic_mem;
+    // Posted-interrupt descriptor, or NULL if APICv is unsupported.
+    PostedInterruptDescriptor* pi_desc;
 };
 
 /* Creates a VMCS CPU context to initialize a VM. */
@@ -284,10 +315,11 @@ public:
     status_t Setup(paddr_t pml4_address, paddr_t apic_access_address,
                    paddr_t msr_bitmaps_address);
     status_t Enter(const VmcsContext& context, GuestPhysicalAddressSpace* gpas,
-                   FifoDispatcher* ctl_fifo);
+                   FifoDispatcher* ctl_fifo, GuestPortTraps* port_traps);
     status_t SetGpr(const mx_guest_gpr_t& guest_gpr);
     status_t GetGpr(mx_guest_gpr_t* guest_gpr) const;
     status_t SetApicMem(mxtl::RefPtr<VmObject> apic_mem);
+    status_t Interrupt(uint32_t vector);
 
     bool ShouldResume() const { return vmx_state_.resume; }
     bool HasApicMem() const { return local_apic_state_.apic_addr != nullptr; }
@@ -295,6 +327,7 @@ public:
 private:
     VmxPage host_msr_page_;
     VmxPage guest_msr_page_;
+    VmxPage pi_desc_page_;
     VmxState vmx_state_;
     LocalApicState local_apic_state_;
 };
@@ -13,6 +13,7 @@
 #ifndef ASSEMBLY
 
 #include <arch/x86.h>
+#include <arch/x86/feature.h>
 #include <arch/x86/mp.h>
 
 __BEGIN_CDECLS
@@ -71,6 +72,12 @@ static inline uint32_t arch_dcache_line_size(void) {
     return 0;
 }
 
+static inline bool arch_usermode_can_get_cpu_num(void) {
+    // x86_init_percpu programs each cpu's number into IA32_TSC_AUX,
+    // where usermode can read it back with rdtscp.
+    return x86_feature_test(X86_FEATURE_RDTSCP);
+}
+
 // Log architecture-specific data for process creation.
 // This can only be called after the process has been created and before
 // it is running: |aspace| is assumed to live across the call.
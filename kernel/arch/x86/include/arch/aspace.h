@@ -33,6 +33,23 @@ struct arch_aspace {
      * actually an mp_cpu_mask_t, but header dependencies. */
     volatile int active_cpus;
 
+    /* cpus that may hold stale TLB entries tagged with this aspace's PCID
+     * because they were inactive when an invalidation was issued; such a
+     * cpu flushes the PCID on its next switch into the aspace. */
+    volatile int stale_cpus;
+
+    /* PCID tagging state; see x86_pcid_context_switch() in mmu.cpp.  The
+     * pcid is only meaningful while pcid_generation matches the global
+     * generation counter. */
+    uint16_t pcid;
+    uint64_t pcid_generation;
+
+    /* while a batched page table edit is in flight, points at the
+     * struct tlb_invalidate_batch collecting its invalidations; mmu
+     * operations on an aspace are serialized by its lock, so there is
+     * at most one. */
+    void *tlb_batch;
+
     /* Pointer to a bitmap::RleBitmap representing the range of ports
      * enabled in this aspace. */
     void *io_bitmap;
@@ -17,6 +17,11 @@ __BEGIN_CDECLS
 
 typedef unsigned long spin_lock_t;
 
+/* the low half of the lock holds the owner cpu + 1; the high half holds
+ * the tail of the queue of waiters (see spinlock.cpp) */
+#define SPIN_LOCK_HOLDER_MASK ((unsigned long)0xffffffff)
+#define SPIN_LOCK_TAIL_SHIFT 32
+
 typedef x86_flags_t spin_lock_saved_state_t;
 typedef uint spin_lock_save_flags_t;
 
@@ -31,12 +36,12 @@ static inline void arch_spin_lock_init(spin_lock_t *lock)
 
 static inline bool arch_spin_lock_held(spin_lock_t *lock)
 {
-    return __atomic_load_n(lock, __ATOMIC_RELAXED) != 0;
+    return (__atomic_load_n(lock, __ATOMIC_RELAXED) & SPIN_LOCK_HOLDER_MASK) != 0;
 }
 
 static inline uint arch_spin_lock_holder_cpu(spin_lock_t *lock)
 {
-    return (uint)__atomic_load_n(lock, __ATOMIC_RELAXED) - 1;
+    return (uint)(__atomic_load_n(lock, __ATOMIC_RELAXED) & SPIN_LOCK_HOLDER_MASK) - 1;
 }
 
 /* flags are unused on x86 */
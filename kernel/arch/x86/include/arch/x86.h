@@ -362,6 +362,32 @@ static inline void write_msr (uint32_t msr_id, uint64_t msr_write_val)
         : : "c" (msr_id), "a" (msr_write_val & 0xffffffff), "d" (msr_write_val >> 32));
 }
 
+/* fs/gs base accessor instructions; only usable once CR4.FSGSBASE is set,
+ * much cheaper than going through the corresponding MSRs */
+static inline uint64_t x86_rdfsbase(void)
+{
+    uint64_t val;
+    __asm__ __volatile__ ("rdfsbase %0" : "=r" (val));
+    return val;
+}
+
+static inline void x86_wrfsbase(uint64_t val)
+{
+    __asm__ __volatile__ ("wrfsbase %0" : : "r" (val));
+}
+
+static inline uint64_t x86_rdgsbase(void)
+{
+    uint64_t val;
+    __asm__ __volatile__ ("rdgsbase %0" : "=r" (val));
+    return val;
+}
+
+static inline void x86_wrgsbase(uint64_t val)
+{
+    __asm__ __volatile__ ("wrgsbase %0" : : "r" (val));
+}
+
 
 static inline bool x86_is_paging_enabled(void)
 {
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <kernel/mutex.h>
 #include <magenta/types.h>
 #include <mxtl/array.h>
 #include <mxtl/ref_ptr.h>
@@ -54,6 +55,26 @@ private:
     explicit VmxonContext(mxtl::Array<VmxonPerCpu> per_cpus);
 };
 
+/* In-kernel completion of guest port writes.  Writes to a registered port
+ * range are queued as packets on the associated FIFO, without a round trip
+ * through the control FIFO per access. */
+class GuestPortTraps {
+public:
+    status_t Set(uint16_t port, uint16_t len, mxtl::RefPtr<FifoDispatcher> fifo);
+    mxtl::RefPtr<FifoDispatcher> Find(uint16_t port);
+
+private:
+    static const size_t kMaxTraps = 8;
+    struct Trap {
+        uint16_t port = 0;
+        uint16_t len = 0;
+        mxtl::RefPtr<FifoDispatcher> fifo;
+    };
+
+    Mutex lock_;
+    Trap traps_[kMaxTraps];
+};
+
 class VmcsContext {
 public:
     static status_t Create(mxtl::RefPtr<VmObject> phys_mem,
@@ -72,6 +93,8 @@ public:
     status_t SetGpr(const mx_guest_gpr_t& guest_gpr);
     status_t GetGpr(mx_guest_gpr_t* guest_gpr) const;
     status_t SetApicMem(mxtl::RefPtr<VmObject> apic_mem);
+    status_t SetPortTrap(uint16_t port, uint16_t len, mxtl::RefPtr<FifoDispatcher> fifo);
+    status_t Interrupt(uint32_t vector);
 
     status_t set_ip(uintptr_t guest_ip);
     uintptr_t ip() const {  return ip_; }
@@ -79,12 +102,14 @@ public:
     uintptr_t cr3() const { return cr3_; }
     GuestPhysicalAddressSpace* gpas() const { return gpas_.get(); }
     FifoDispatcher* ctl_fifo() const { return ctl_fifo_.get(); }
+    GuestPortTraps* port_traps() { return &port_traps_; }
 
 private:
     uintptr_t ip_ = UINTPTR_MAX;
     uintptr_t cr3_ = UINTPTR_MAX;
     mxtl::unique_ptr<GuestPhysicalAddressSpace> gpas_;
     mxtl::RefPtr<FifoDispatcher> ctl_fifo_;
+    GuestPortTraps port_traps_;
 
     VmxPage msr_bitmaps_page_;
     VmxPage apic_address_page_;
@@ -104,3 +129,9 @@ status_t x86_guest_set_apic_mem(const mxtl::unique_ptr<GuestContext>& context,
 /* Set the initial CR3 of the guest context.
  */
 status_t x86_guest_set_cr3(const mxtl::unique_ptr<GuestContext>& context, uintptr_t guest_cr3);
+
+/* Register in-kernel handling of guest writes to an I/O port range.
+ */
+status_t x86_guest_set_port_trap(const mxtl::unique_ptr<GuestContext>& context,
+                                 uint16_t port, uint16_t len,
+                                 mxtl::RefPtr<FifoDispatcher> fifo);
@@ -42,6 +42,7 @@ enum x86_interrupt_vector {
     X86_INT_IPI_GENERIC,
     X86_INT_IPI_RESCHEDULE,
     X86_INT_IPI_HALT,
+    X86_INT_VMX_POSTED, /* posted-interrupt notification for guests */
 
     X86_MAX_INT = 0xff,
 };
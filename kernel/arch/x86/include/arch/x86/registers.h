@@ -22,9 +22,13 @@
 #define X86_CR4_OSXMMEXPT               0x00000400 /* os supports xmm exception */
 #define X86_CR4_VMXE                    0x00002000 /* enable vmx */
 #define X86_CR4_FSGSBASE                0x00010000 /* enable {rd,wr}{fs,gs}base */
+#define X86_CR4_PCIDE                   0x00020000 /* PCID enable */
 #define X86_CR4_OSXSAVE                 0x00040000 /* os supports xsave */
 #define X86_CR4_SMEP                    0x00100000 /* SMEP protection enabling */
 #define X86_CR4_SMAP                    0x00200000 /* SMAP protection enabling */
+#define X86_CR3_PCID_MASK               0x0000000000000fffull /* PCID field when CR4.PCIDE is set */
+#define X86_CR3_BASE_MASK               0x000ffffffffff000ull /* page table base field */
+#define X86_CR3_NOFLUSH                 0x8000000000000000ull /* preserve PCID-tagged TLB entries */
 #define X86_EFER_SCE                    0x00000001 /* enable SYSCALL */
 #define X86_EFER_LME                    0x00000100 /* long mode enable */
 #define X86_EFER_LMA                    0x00000400 /* long mode active */
@@ -53,6 +57,7 @@
 #define X86_MSR_IA32_FS_BASE            0xc0000100 /* fs base address */
 #define X86_MSR_IA32_GS_BASE            0xc0000101 /* gs base address */
 #define X86_MSR_IA32_KERNEL_GS_BASE     0xc0000102 /* kernel gs base */
+#define X86_MSR_IA32_TSC_AUX            0xc0000103 /* TSC aux, read by rdtscp */
 #define X86_CR4_PSE                     0xffffffef /* Disabling PSE bit in the CR4 */
 
 /* EFLAGS/RFLAGS */
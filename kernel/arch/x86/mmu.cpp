@@ -33,6 +33,19 @@ uint8_t g_paddr_width = 32;
 /* True if the system supports 1GB pages */
 static bool supports_huge_pages = false;
 
+/* PCID allocator state.  When the cpu supports PCID, each user address
+ * space is tagged with a 12-bit PCID so that a context switch can reload
+ * CR3 without discarding the TLB.  PCIDs are handed out from a monotonic
+ * counter and never reused within a generation; when the counter runs out
+ * a new generation opens, and each cpu wipes its tagged entries the first
+ * time it switches inside the new generation, making the old PCIDs safe
+ * to recycle.  PCID 0 is reserved for the kernel address space. */
+static bool use_pcid = false;
+static spin_lock_t pcid_lock = SPIN_LOCK_INITIAL_VALUE;
+static uint64_t pcid_generation = 1;
+static uint16_t pcid_next = 1;
+static uint64_t cpu_pcid_generation[SMP_MAX_CPUS];
+
 /* top level kernel page tables, initialized in start.S */
 volatile pt_entry_t pml4[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE);
 volatile pt_entry_t pdp[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE); /* temporary */
@@ -126,6 +139,7 @@ static void x86_tlb_global_invalidate() {
 
 /* Task used for invalidating a TLB entry on each CPU */
 struct tlb_invalidate_page_context {
+    arch_aspace_t* aspace;
     ulong target_cr3;
     vaddr_t vaddr;
     enum page_table_levels level;
@@ -135,9 +149,16 @@ static void tlb_invalidate_page_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     tlb_invalidate_page_context* context = (tlb_invalidate_page_context*)raw_context;
 
-    ulong cr3 = x86_get_cr3();
+    ulong cr3 = x86_get_cr3() & (ulong)X86_CR3_BASE_MASK;
     if (context->target_cr3 != cr3 && !context->global_page) {
-        /* This invalidation doesn't apply to this CPU, ignore it */
+        /* This invalidation doesn't apply to this CPU.  With PCID the
+         * aspace's tagged entries nonetheless survive in our TLB, and we
+         * may be here mid-switch away from it (still in active_cpus, so
+         * tlb_invalidate_targets() did not stale-mark us); mark ourselves
+         * stale so our next switch into the aspace flushes its PCID. */
+        if (use_pcid && context->aspace != nullptr) {
+            atomic_or(&context->aspace->stale_cpus, (int)(1U << arch_curr_cpu_num()));
+        }
         return;
     }
 
@@ -153,6 +174,52 @@ static void tlb_invalidate_page_task(void* raw_context) {
     }
 }
 
+/* Pooled invalidation "transaction": a page table walk that edits many
+ * entries opens one of these on its aspace, invalidations accumulate in
+ * it, and a single mp_sync_exec executes them all when it is flushed.
+ * Overflowing the vaddr array degrades to a full invalidate, which is
+ * cheaper than that many IPI rounds anyway. */
+#define TLB_INVALIDATE_BATCH_MAX 32
+
+struct tlb_invalidate_batch {
+    arch_aspace_t* aspace;
+    ulong target_cr3;
+    bool global_page;
+    bool full_invalidate;
+    uint count;
+    vaddr_t vaddr[TLB_INVALIDATE_BATCH_MAX];
+    /* page tables emptied during the walk, freed only after the flush */
+    struct list_node to_free;
+};
+
+/* Compute which CPUs an invalidation of |aspace| must reach.
+ *
+ * Target only CPUs this aspace is active on.  It may be the case that some
+ * other CPU will become active in it after this load, or will have left it
+ * just before this load.  In the former case, it is becoming active after
+ * the write to the page table, so it will see the change.  In the latter
+ * case, it will get a spurious request to flush. */
+static mp_cpu_mask_t tlb_invalidate_targets(arch_aspace_t* aspace, bool global_page) {
+    if (global_page || aspace == nullptr) {
+        return MP_CPU_ALL;
+    }
+    static_assert(sizeof(mp_cpu_mask_t) == sizeof(aspace->active_cpus), "err");
+
+    /* With PCID tagging a cpu that is not running the aspace still holds
+     * its tagged TLB entries, so the cpus this invalidation will not
+     * reach must be marked stale; each flushes the PCID on its next
+     * switch into the aspace.  The marking must precede the target load
+     * below: a switching cpu sets its active bit before consuming its
+     * stale bit, so either that load sees it (and it gets the IPI) or
+     * its stale-bit check comes after this marking (and it flushes).
+     * Without PCID the CR3 reload on switch flushes everything and no
+     * tracking is needed. */
+    if (use_pcid) {
+        atomic_or(&aspace->stale_cpus, ~atomic_load(&aspace->active_cpus));
+    }
+    return atomic_load(&aspace->active_cpus);
+}
+
 /**
  * @brief Invalidate a single page at a given page table level
  *
@@ -160,33 +227,119 @@ static void tlb_invalidate_page_task(void* raw_context) {
  * @param vaddr The virtual address we are invalidating the TLB entry for
  * @param level The page table level that maps this vaddr
  * @param global_page True if we are invalidating a global mapping
- *
- * TODO(teisenbe): Optimize this.  This is horribly inefficient.
- * We should also change this to pool invalidations from a single
- * "transaction" and then only execute a single mp_sync_exec for that
- * transaction, rather than one per page.
  */
 void x86_tlb_invalidate_page(arch_aspace_t* aspace, vaddr_t vaddr, enum page_table_levels level,
                              bool global_page) {
-    ulong cr3 = aspace ? aspace->pt_phys : x86_get_cr3();
+    ulong cr3 = aspace ? aspace->pt_phys : (x86_get_cr3() & (ulong)X86_CR3_BASE_MASK);
+
+    /* If a batch is open on this aspace, pool the invalidation instead of
+     * issuing an IPI per page.  The batch is flushed in one mp_sync_exec
+     * once the page table walk completes. */
+    if (aspace != nullptr && aspace->tlb_batch != nullptr) {
+        tlb_invalidate_batch* batch = static_cast<tlb_invalidate_batch*>(aspace->tlb_batch);
+        DEBUG_ASSERT(batch->target_cr3 == cr3);
+        batch->global_page |= global_page;
+        if (level == PML4_L || batch->count == TLB_INVALIDATE_BATCH_MAX) {
+            batch->full_invalidate = true;
+        } else if (!batch->full_invalidate) {
+            batch->vaddr[batch->count++] = vaddr;
+        }
+        return;
+    }
+
     struct tlb_invalidate_page_context task_context = {
-        .target_cr3 = cr3, .vaddr = vaddr, .level = level, .global_page = global_page,
+        .aspace = aspace, .target_cr3 = cr3, .vaddr = vaddr, .level = level,
+        .global_page = global_page,
     };
 
-    /* Target only CPUs this aspace is active on.  It may be the case that some
-     * other CPU will become active in it after this load, or will have left it
-     * just before this load.  In the former case, it is becoming active after
-     * the write to the page table, so it will see the change.  In the latter
-     * case, it will get a spurious request to flush. */
-    mp_cpu_mask_t targets;
-    if (global_page || aspace == nullptr) {
-        targets = MP_CPU_ALL;
-    } else {
-        targets = atomic_load(&aspace->active_cpus);
-        static_assert(sizeof(mp_cpu_mask_t) == sizeof(aspace->active_cpus), "err");
+    mp_sync_exec(tlb_invalidate_targets(aspace, global_page), tlb_invalidate_page_task,
+                 &task_context);
+}
+
+/**
+ * @brief Open an invalidation batch on |aspace|
+ *
+ * Until the matching x86_tlb_invalidate_batch_flush(), invalidations for
+ * the aspace accumulate in |batch| rather than generating one IPI round
+ * each.  Page tables emptied while the batch is open must be deferred onto
+ * batch->to_free instead of freed, since remote CPUs may still walk them
+ * until the flush.  The caller must serialize MMU operations on the aspace
+ * (via the aspace write lock, or the arch-mmu lock on the fault path),
+ * which serializes batches; batch storage lives on the caller's stack.
+ */
+static void x86_tlb_invalidate_batch_begin(arch_aspace_t* aspace, tlb_invalidate_batch* batch) {
+    DEBUG_ASSERT(aspace && aspace->tlb_batch == nullptr);
+
+    batch->aspace = aspace;
+    batch->target_cr3 = aspace->pt_phys;
+    batch->global_page = false;
+    batch->full_invalidate = false;
+    batch->count = 0;
+    list_initialize(&batch->to_free);
+    aspace->tlb_batch = batch;
+}
+
+/* Task used for executing a pooled invalidation batch on each CPU */
+static void tlb_invalidate_batch_task(void* raw_context) {
+    DEBUG_ASSERT(arch_ints_disabled());
+    tlb_invalidate_batch* batch = (tlb_invalidate_batch*)raw_context;
+
+    ulong cr3 = x86_get_cr3() & (ulong)X86_CR3_BASE_MASK;
+    if (batch->target_cr3 != cr3 && !batch->global_page) {
+        /* see tlb_invalidate_page_task(): skipping the invlpgs leaves the
+         * aspace's tagged entries in our TLB, so stale-mark ourselves */
+        if (use_pcid) {
+            atomic_or(&batch->aspace->stale_cpus, (int)(1U << arch_curr_cpu_num()));
+        }
+        return;
     }
 
-    mp_sync_exec(targets, tlb_invalidate_page_task, &task_context);
+    if (batch->full_invalidate) {
+        x86_tlb_global_invalidate();
+        return;
+    }
+    for (uint i = 0; i < batch->count; ++i) {
+        __asm__ volatile("invlpg %0" ::"m"(*(uint8_t*)batch->vaddr[i]));
+    }
+}
+
+/**
+ * @brief Close the invalidation batch on |aspace| and execute it
+ *
+ * Issues at most one mp_sync_exec for everything pooled since
+ * x86_tlb_invalidate_batch_begin(), then frees any deferred page tables.
+ */
+static void x86_tlb_invalidate_batch_flush(arch_aspace_t* aspace) {
+    DEBUG_ASSERT(aspace && aspace->tlb_batch != nullptr);
+
+    tlb_invalidate_batch* batch = static_cast<tlb_invalidate_batch*>(aspace->tlb_batch);
+    aspace->tlb_batch = nullptr;
+
+    if (batch->count > 0 || batch->full_invalidate) {
+        mp_sync_exec(tlb_invalidate_targets(aspace, batch->global_page),
+                     tlb_invalidate_batch_task, batch);
+    }
+    if (!list_is_empty(&batch->to_free)) {
+        pmm_free(&batch->to_free);
+    }
+}
+
+/**
+ * @brief Free an emptied page table, or defer it if a batch is open
+ *
+ * While a batch is open the TLB flush for the entries that pointed at
+ * |table| has not happened yet, so a remote CPU may still walk through it;
+ * the page is queued on the batch and released after the flush instead.
+ */
+static void x86_mmu_free_page_table(arch_aspace_t* aspace, volatile pt_entry_t* table) {
+    vm_page_t* page = paddr_to_vm_page(X86_VIRT_TO_PHYS(table));
+
+    if (aspace != nullptr && aspace->tlb_batch != nullptr) {
+        tlb_invalidate_batch* batch = static_cast<tlb_invalidate_batch*>(aspace->tlb_batch);
+        list_add_tail(&batch->to_free, &page->free.node);
+        return;
+    }
+    pmm_free_page(page);
 }
 
 template <int Level>
@@ -767,7 +920,7 @@ static bool x86_mmu_remove_mapping(arch_aspace_t* aspace, volatile pt_entry_t* t
         }
         if (unmap_page_table) {
             unmap_entry<PageTable>(aspace, new_cursor->vaddr, e);
-            pmm_free_page(paddr_to_vm_page(X86_VIRT_TO_PHYS(next_table)));
+            x86_mmu_free_page_table(aspace, next_table);
             unmapped = true;
         }
         *new_cursor = cursor;
@@ -1135,7 +1288,10 @@ static status_t mmu_unmap(arch_aspace_t* aspace, vaddr_t vaddr, const size_t cou
     };
 
     MappingCursor result;
+    tlb_invalidate_batch batch;
+    x86_tlb_invalidate_batch_begin(aspace, &batch);
     x86_mmu_remove_mapping<PageTable<MAX_PAGING_LEVEL>>(aspace, aspace->pt_virt, start, &result);
+    x86_tlb_invalidate_batch_flush(aspace);
     DEBUG_ASSERT(result.size == 0);
 
     if (unmapped)
@@ -1260,6 +1416,7 @@ void x86_mmu_early_init() {
     uint8_t paddr_width = x86_physical_address_width();
 
     supports_huge_pages = x86_feature_test(X86_FEATURE_HUGE_PAGE);
+    use_pcid = x86_feature_test(X86_FEATURE_PCID);
 
     /* if we got something meaningful, override the defaults.
      * some combinations of cpu on certain emulators seems to return
@@ -1316,8 +1473,14 @@ status_t arch_mmu_init_aspace(arch_aspace_t* aspace, vaddr_t base, size_t size,
 
         LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p\n", aspace->pt_phys, aspace->pt_virt);
     }
+    aspace->tlb_batch = nullptr;
     aspace->io_bitmap = nullptr;
     aspace->active_cpus = 0;
+    aspace->stale_cpus = 0;
+    aspace->pcid = 0;
+    /* generation 0 never matches the allocator, so a PCID is assigned on
+     * the first context switch into this aspace */
+    aspace->pcid_generation = 0;
     spin_lock_init(&aspace->io_bitmap_lock);
 
     return NO_ERROR;
@@ -1343,6 +1506,10 @@ status_t guest_mmu_init_paspace(guest_paspace_t* paspace, size_t size) {
     paspace->base = 0;
     paspace->size = size;
     paspace->active_cpus = 0;
+    paspace->stale_cpus = 0;
+    paspace->pcid = 0;
+    paspace->pcid_generation = 0;
+    paspace->tlb_batch = nullptr;
     paspace->io_bitmap = nullptr;
     spin_lock_init(&paspace->io_bitmap_lock);
 
@@ -1392,20 +1559,70 @@ status_t guest_mmu_destroy_paspace(guest_paspace_t* paspace) {
     return mmu_destroy_aspace<ExtendedPageTable>(paspace);
 }
 
+/* Reloads CR3 for |aspace| using its PCID, avoiding a TLB wipe when the
+ * aspace's tagged entries are still valid.
+ */
+static void x86_pcid_context_switch(arch_aspace_t* aspace) {
+    spin_lock(&pcid_lock);
+    if (aspace->pcid_generation != pcid_generation) {
+        if (pcid_next > (uint16_t)X86_CR3_PCID_MASK) {
+            /* out of PCIDs: open a new generation, invalidating every
+             * PCID handed out so far.  Each cpu wipes its tagged entries
+             * below on its first switch inside the new generation, after
+             * which the recycled values are clean. */
+            pcid_generation++;
+            pcid_next = 1;
+        }
+        aspace->pcid = pcid_next++;
+        aspace->pcid_generation = pcid_generation;
+    }
+    uint64_t generation = aspace->pcid_generation;
+    ulong cr3 = aspace->pt_phys | aspace->pcid;
+    spin_unlock(&pcid_lock);
+
+    uint cpu = arch_curr_cpu_num();
+    int cpu_bit = (int)(1U << cpu);
+    bool stale = (atomic_and(&aspace->stale_cpus, ~cpu_bit) & cpu_bit) != 0;
+
+    if (cpu_pcid_generation[cpu] != generation) {
+        cpu_pcid_generation[cpu] = generation;
+        x86_set_cr3(cr3);
+        x86_tlb_global_invalidate();
+    } else if (stale) {
+        /* missed an invalidation while inactive; a plain reload flushes
+         * this PCID's non-global entries */
+        x86_set_cr3(cr3);
+    } else {
+        x86_set_cr3(cr3 | (ulong)X86_CR3_NOFLUSH);
+    }
+}
+
 void arch_mmu_context_switch(arch_aspace_t* old_aspace, arch_aspace_t* aspace) {
     mp_cpu_mask_t cpu_bit = 1U << arch_curr_cpu_num();
     if (aspace != nullptr) {
         DEBUG_ASSERT(aspace->magic == ARCH_ASPACE_MAGIC);
         LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, aspace->pt_phys);
-        x86_set_cr3(aspace->pt_phys);
+        if (use_pcid) {
+            /* become visible to invalidators before deciding whether the
+             * tagged entries can be kept; pairs with the stale marking in
+             * tlb_invalidate_targets().  Interrupts are off, so an IPI
+             * aimed at this cpu is handled after the CR3 below is loaded
+             * and its invlpgs apply to the right PCID. */
+            atomic_or(&aspace->active_cpus, cpu_bit);
+            x86_pcid_context_switch(aspace);
+        } else {
+            x86_set_cr3(aspace->pt_phys);
+            atomic_or(&aspace->active_cpus, cpu_bit);
+        }
 
         if (old_aspace != nullptr) {
             atomic_and(&old_aspace->active_cpus, ~cpu_bit);
         }
-        atomic_or(&aspace->active_cpus, cpu_bit);
     } else {
         LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
-        x86_set_cr3(kernel_pt_phys);
+        /* the kernel aspace runs on PCID 0 and all its mappings are
+         * global; preserve the outgoing aspace's tagged entries */
+        x86_set_cr3(use_pcid ? (kernel_pt_phys | (ulong)X86_CR3_NOFLUSH) : kernel_pt_phys);
         if (old_aspace != nullptr) {
             atomic_and(&old_aspace->active_cpus, ~cpu_bit);
         }
@@ -1503,6 +1720,9 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    /* Enable PCID tagging; legal here since CR3 still holds PCID 0 */
+    if (x86_feature_test(X86_FEATURE_PCID))
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     /* Set NXE bit in X86_MSR_IA32_EFER*/
@@ -74,6 +74,7 @@ MODULE_SRCS += \
 	$(LOCAL_DIR)/mp.cpp \
 	$(LOCAL_DIR)/proc_trace.cpp \
 	$(LOCAL_DIR)/registers.cpp \
+	$(LOCAL_DIR)/spinlock.cpp \
 	$(LOCAL_DIR)/thread.cpp \
 	$(LOCAL_DIR)/tsc.cpp \
 	$(LOCAL_DIR)/user_copy.cpp \
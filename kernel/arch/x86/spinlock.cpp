@@ -0,0 +1,140 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/spinlock.h>
+
+#include <arch/ops.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Queued (MCS-style) spinlock.
+//
+// The lock word keeps the holder cpu + 1 in the low half, as the old
+// test-and-set lock did, so the held/holder_cpu queries are unchanged.
+// The high half holds the tail of a queue of waiters. Each waiter spins
+// on its own per-cpu node instead of on the lock word, so a contended
+// lock's cacheline bounces between at most two cpus (the holder and the
+// head waiter) instead of all of them, and waiters are granted the lock
+// in FIFO order.
+
+// one node per nesting level: a cpu can be queued on at most one lock
+// per context (the thread plus nested interrupts)
+#define QNODE_COUNT 4
+
+struct spin_qnode {
+    struct spin_qnode* volatile next;
+    volatile uint32_t wait;
+};
+
+// aligning the type (not just the array) pads each cpu's nodes out to
+// their own cacheline
+static struct __CPU_ALIGN {
+    struct spin_qnode node[QNODE_COUNT];
+    uint32_t depth;
+} qnodes[SMP_MAX_CPUS];
+
+static inline spin_lock_t encode_tail(uint cpu, uint32_t idx) {
+    return (spin_lock_t)(cpu * QNODE_COUNT + idx + 1) << SPIN_LOCK_TAIL_SHIFT;
+}
+
+static inline struct spin_qnode* decode_tail(spin_lock_t lock_val) {
+    uint n = (uint)(lock_val >> SPIN_LOCK_TAIL_SHIFT) - 1;
+    return &qnodes[n / QNODE_COUNT].node[n % QNODE_COUNT];
+}
+
+static inline void spin_relax(void) {
+    __asm__ volatile("pause");
+}
+
+void arch_spin_lock(spin_lock_t* lock) {
+    const uint cpu = arch_curr_cpu_num();
+    const spin_lock_t val = cpu + 1;
+
+    // uncontended fast path
+    spin_lock_t old = 0;
+    if (likely(__atomic_compare_exchange_n(lock, &old, val, false,
+                                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)))
+        return;
+
+    // grab a queue node for this nesting level. the increment is a
+    // single instruction so an interrupt taken mid-update cannot end up
+    // reusing our node.
+    uint32_t idx = __atomic_fetch_add(&qnodes[cpu].depth, 1, __ATOMIC_RELAXED);
+    if (unlikely(idx >= QNODE_COUNT)) {
+        // interrupts are nested deeper than we have nodes; fall back to
+        // spinning on the lock word until the queue fully drains
+        old = 0;
+        while (!__atomic_compare_exchange_n(lock, &old, val, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            spin_relax();
+            old = 0;
+        }
+        __atomic_fetch_sub(&qnodes[cpu].depth, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    struct spin_qnode* node = &qnodes[cpu].node[idx];
+    node->next = NULL;
+    node->wait = 1;
+
+    // publish ourselves as the new tail of the queue
+    const spin_lock_t tail = encode_tail(cpu, idx);
+    old = __atomic_load_n(lock, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(lock, &old,
+                                        (old & SPIN_LOCK_HOLDER_MASK) | tail,
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        ;
+
+    if (old >> SPIN_LOCK_TAIL_SHIFT) {
+        // someone was queued ahead of us; link behind them and spin on
+        // our own node until they hand us the head of the queue
+        struct spin_qnode* prev = decode_tail(old);
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->wait, __ATOMIC_ACQUIRE))
+            spin_relax();
+    }
+
+    // we are the head waiter; wait for the holder to drop the lock
+    for (;;) {
+        while ((old = __atomic_load_n(lock, __ATOMIC_RELAXED)) & SPIN_LOCK_HOLDER_MASK)
+            spin_relax();
+        if (old == tail) {
+            // no one behind us: take the lock and empty the queue in one go
+            if (__atomic_compare_exchange_n(lock, &old, val, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+                break;
+            // a new waiter changed the tail; go around again
+            continue;
+        }
+        // a successor is (or is about to be) linked behind us: set the
+        // holder half without touching the tail. only the head waiter
+        // stores to the holder half, so the add cannot collide.
+        __atomic_fetch_add(lock, val, __ATOMIC_ACQUIRE);
+
+        // hand the head of the queue to our successor
+        struct spin_qnode* next;
+        while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL)
+            spin_relax();
+        __atomic_store_n(&next->wait, 0, __ATOMIC_RELEASE);
+        break;
+    }
+
+    __atomic_fetch_sub(&qnodes[cpu].depth, 1, __ATOMIC_RELAXED);
+}
+
+int arch_spin_trylock(spin_lock_t* lock) {
+    spin_lock_t old = 0;
+    if (__atomic_compare_exchange_n(lock, &old, arch_curr_cpu_num() + 1UL, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 0;
+    return 1;
+}
+
+void arch_spin_unlock(spin_lock_t* lock) {
+    // clear only the holder half; queued waiters own the tail half
+    spin_lock_t val = __atomic_load_n(lock, __ATOMIC_RELAXED) & SPIN_LOCK_HOLDER_MASK;
+    __atomic_fetch_sub(lock, val, __ATOMIC_RELEASE);
+}
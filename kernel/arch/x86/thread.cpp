@@ -16,6 +16,7 @@
 #include <kernel/spinlock.h>
 #include <arch/x86.h>
 #include <arch/x86/descriptor.h>
+#include <arch/x86/feature.h>
 #include <arch/x86/mp.h>
 #include <arch/x86/registers.h>
 
@@ -89,10 +90,23 @@ void arch_context_switch(thread_t *oldthread, thread_t *newthread)
     x86_set_tss_sp(newthread->stack_top);
 
     /* user and kernel gs have been swapped, so unswap them when loading
-     * from the msrs
+     * from the msrs. with FSGSBASE enabled, move the bases with the
+     * dedicated instructions instead, which are far cheaper than the
+     * serializing msr accesses; the user's gs base is parked in
+     * KERNEL_GS_BASE, so swap it in around the access (interrupts are
+     * disabled across the context switch).
      */
-    oldthread->arch.fs_base = read_msr(X86_MSR_IA32_FS_BASE);
-    oldthread->arch.gs_base = read_msr(X86_MSR_IA32_KERNEL_GS_BASE);
+    const bool fsgsbase = x86_feature_test(X86_FEATURE_FSGSBASE);
+    if (likely(fsgsbase)) {
+        DEBUG_ASSERT(arch_ints_disabled());
+        oldthread->arch.fs_base = x86_rdfsbase();
+        __asm__ __volatile__("swapgs");
+        oldthread->arch.gs_base = x86_rdgsbase();
+        __asm__ __volatile__("swapgs");
+    } else {
+        oldthread->arch.fs_base = read_msr(X86_MSR_IA32_FS_BASE);
+        oldthread->arch.gs_base = read_msr(X86_MSR_IA32_KERNEL_GS_BASE);
+    }
 
     /* The segment selector registers can't be preserved across context
      * switches in all cases, because some values get clobbered when
@@ -114,8 +128,15 @@ void arch_context_switch(thread_t *oldthread, thread_t *newthread)
         write_msr(X86_MSR_IA32_GS_BASE, gs_base);
     }
 
-    write_msr(X86_MSR_IA32_FS_BASE, newthread->arch.fs_base);
-    write_msr(X86_MSR_IA32_KERNEL_GS_BASE, newthread->arch.gs_base);
+    if (likely(fsgsbase)) {
+        x86_wrfsbase(newthread->arch.fs_base);
+        __asm__ __volatile__("swapgs");
+        x86_wrgsbase(newthread->arch.gs_base);
+        __asm__ __volatile__("swapgs");
+    } else {
+        write_msr(X86_MSR_IA32_FS_BASE, newthread->arch.fs_base);
+        write_msr(X86_MSR_IA32_KERNEL_GS_BASE, newthread->arch.gs_base);
+    }
 
 #if __has_feature(safe_stack)
     oldthread->arch.unsafe_sp = x86_read_gs_offset64(MX_TLS_UNSAFE_SP_OFFSET);
@@ -8,11 +8,14 @@
 #include <platform.h>
 #include <string.h>
 
+#include <arch/ops.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/interrupts.h>
 #include <arch/x86/mmu.h>
+#include <arch/x86/mp.h>
 #include <hypervisor/guest_physical_address_space.h>
+#include <kernel/mp.h>
 #include <kernel/sched.h>
 #include <kernel/timer.h>
 #include <kernel/vm/pmm.h>
@@ -29,6 +32,7 @@
 
 static const uint64_t kLocalApicPhysBase =
     APIC_PHYS_BASE | IA32_APIC_BASE_BSP | IA32_APIC_BASE_XAPIC_ENABLE;
+static const uint16_t kLocalApicIrr = 0x200;
 static const uint16_t kLocalApicLvtTimer = 0x320;
 
 static const uint32_t kInterruptInfoDeliverErrorCode = 1u << 11;
@@ -104,6 +108,15 @@ void interrupt_window_exiting(bool enable) {
 
 static status_t handle_external_interrupt(const ExitInfo& exit_info, AutoVmcsLoad* vmcs_load,
                                           LocalApicState* local_apic_state) {
+    // With acknowledge-interrupt-on-exit the processor has already consumed
+    // the host interrupt, so re-raise it as a self-IPI; it is then delivered
+    // through the IDT when reload briefly enables interrupts below.
+    if (local_apic_state->pi_desc != nullptr) {
+        uint32_t interrupt_info = vmcs_read(VmcsField32::EXIT_INTERRUPTION_INFORMATION);
+        if (interrupt_info & kInterruptInfoValid)
+            apic_send_self_ipi(static_cast<uint8_t>(interrupt_info & UINT8_MAX),
+                               DELIVERY_MODE_FIXED);
+    }
     vmcs_load->reload();
     if (vmcs_read(VmcsFieldXX::GUEST_RFLAGS) & X86_FLAGS_IF) {
         // If interrupts are enabled, we inject any active interrupts.
@@ -195,6 +208,9 @@ private:
     virtual bool OnCancel(Handle* handle) {
         return false;
     }
+    virtual mx_signals_t watched_signals() const {
+        return watched_signals_;
+    }
 };
 
 static status_t packet_wait(StateTracker* state_tracker, mx_signals_t signals) {
@@ -234,7 +250,7 @@ static status_t packet_read(FifoDispatcher* ctl_fifo, mx_guest_packet_t* packet)
 #endif // WITH_LIB_MAGENTA
 
 static status_t handle_io_instruction(const ExitInfo& exit_info, GuestState* guest_state,
-                                      FifoDispatcher* ctl_fifo) {
+                                      FifoDispatcher* ctl_fifo, GuestPortTraps* port_traps) {
     next_rip(exit_info);
 #if WITH_LIB_MAGENTA
     IoInfo io_info(exit_info.exit_qualification);
@@ -247,6 +263,18 @@ static status_t handle_io_instruction(const ExitInfo& exit_info, GuestState* gue
         packet.port_out.access_size = io_info.access_size;
         packet.port_out.port = io_info.port;
         memcpy(packet.port_out.data, &guest_state->rax, io_info.access_size);
+        // If the port is covered by an in-kernel trap, complete the write by
+        // queueing the packet to the trap FIFO; the VMM observes it
+        // asynchronously, without a transition per access. Fall back to the
+        // control FIFO if the trap FIFO is full.
+        mxtl::RefPtr<FifoDispatcher> trap_fifo = port_traps->Find(io_info.port);
+        if (trap_fifo != nullptr) {
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(&packet);
+            uint32_t actual;
+            status_t status = trap_fifo->Write(data, sizeof(packet), &actual);
+            if (status == NO_ERROR && actual == 1)
+                return NO_ERROR;
+        }
         return packet_write(ctl_fifo, packet);
     }
     packet.type = MX_GUEST_PKT_TYPE_PORT_IN;
@@ -309,14 +337,74 @@ static uint32_t* apic_reg(LocalApicState* local_apic_state, uint16_t reg) {
     return reinterpret_cast<uint32_t*>(addr + reg);
 }
 
+status_t local_apic_signal_interrupt(LocalApicState* local_apic_state, uint32_t vector) {
+    if (vector > UINT8_MAX)
+        return ERR_INVALID_ARGS;
+
+    PostedInterruptDescriptor* pi_desc = local_apic_state->pi_desc;
+    if (pi_desc != nullptr) {
+        // Post the interrupt and notify the CPU running the guest. If it is in
+        // VMX non-root mode the interrupt is delivered without a VM exit;
+        // otherwise sync_posted_interrupts folds it into the virtual APIC on
+        // the next VM entry. Guests are pinned to the boot CPU, see
+        // percpu_exec.
+        atomic_or(&pi_desc->pir[vector / 32], 1 << (vector % 32));
+        atomic_or(&pi_desc->control, 1 /* outstanding notification */);
+        event_signal(&local_apic_state->event, false);
+        apic_send_ipi(X86_INT_VMX_POSTED, bp_percpu.apic_id, DELIVERY_MODE_FIXED);
+        return NO_ERROR;
+    }
+
+    // Fallback injection through the VM-entry interruption field. Only a
+    // single interrupt can be pending at a time.
+    if (local_apic_state->active_interrupt != kInvalidInterrupt &&
+        local_apic_state->active_interrupt != vector)
+        return ERR_SHOULD_WAIT;
+    local_apic_state->active_interrupt = vector;
+    event_signal(&local_apic_state->event, false);
+    // Force a VM exit so that the interrupt is injected on the next VM entry.
+    mp_reschedule(1 << 0, 0);
+    return NO_ERROR;
+}
+
+void sync_posted_interrupts(LocalApicState* local_apic_state) {
+    PostedInterruptDescriptor* pi_desc = local_apic_state->pi_desc;
+    if ((atomic_and(&pi_desc->control, ~1) & 1) == 0)
+        return;
+
+    // A notification arrived while we were in VMX root mode, so the CPU did
+    // not process the posted interrupts. Fold them into the virtual APIC IRR
+    // and raise RVI to the highest folded vector: VM entry evaluates pending
+    // virtual interrupts from RVI (Intel Vol 3, 26.3.2.5), not from the IRR
+    // bits themselves, so without this the interrupt would sit unrecognized
+    // until an unrelated EOI or posted-interrupt event recomputed RVI.
+    uint32_t max_vector = 0;
+    for (size_t i = 0; i < countof(pi_desc->pir); i++) {
+        int pending = atomic_swap(&pi_desc->pir[i], 0);
+        if (pending == 0)
+            continue;
+        *apic_reg(local_apic_state, static_cast<uint16_t>(kLocalApicIrr + i * 0x10)) |= pending;
+        // Words are scanned low to high, so the last hit holds the highest
+        // pending vector.
+        max_vector = static_cast<uint32_t>(i * 32) + 31 - clz(static_cast<uint32_t>(pending));
+    }
+    if (max_vector != 0) {
+        // RVI is the low byte of the guest interrupt status; the vCPU's VMCS
+        // is loaded at this call site (see VmcsPerCpu::Enter).
+        uint16_t status = vmcs_read(VmcsField16::GUEST_INTERRUPT_STATUS);
+        if (max_vector > (status & 0xffu)) {
+            vmcs_write(VmcsField16::GUEST_INTERRUPT_STATUS,
+                       static_cast<uint16_t>((status & 0xff00u) | max_vector));
+        }
+    }
+}
+
 static handler_return deadline_callback(timer_t* timer, lk_time_t now, void* arg) {
     LocalApicState* local_apic_state = static_cast<LocalApicState*>(arg);
-    DEBUG_ASSERT(local_apic_state->active_interrupt == kInvalidInterrupt);
 
     uint32_t* lvt_timer = apic_reg(local_apic_state, kLocalApicLvtTimer);
-    local_apic_state->active_interrupt = *lvt_timer & LVT_TIMER_VECTOR_MASK;
     local_apic_state->tsc_deadline = 0;
-    event_signal(&local_apic_state->event, false);
+    local_apic_signal_interrupt(local_apic_state, *lvt_timer & LVT_TIMER_VECTOR_MASK);
     return INT_NO_RESCHEDULE;
 }
 
@@ -459,6 +547,11 @@ static status_t handle_ept_violation(const ExitInfo& exit_info, GuestPhysicalAdd
                                      FifoDispatcher* ctl_fifo) {
 #if WITH_LIB_MAGENTA
     vaddr_t guest_paddr = exit_info.guest_physical_address;
+    // Faults within guest physical memory are handled by populating the
+    // address space on demand. Anything outside of it is a memory trap for
+    // the VMM to handle.
+    if (guest_paddr < gpas->size())
+        return gpas->PageFault(guest_paddr);
     return handle_mem_trap(exit_info, guest_paddr, gpas, ctl_fifo);
 #else // WITH_LIB_MAGENTA
     return ERR_NOT_SUPPORTED;
@@ -495,7 +588,7 @@ static status_t handle_xsetbv(const ExitInfo& exit_info, GuestState* guest_state
 
 status_t vmexit_handler(AutoVmcsLoad* vmcs_load, GuestState* guest_state,
                         LocalApicState* local_apic_state, GuestPhysicalAddressSpace* gpas,
-                        FifoDispatcher* ctl_fifo) {
+                        FifoDispatcher* ctl_fifo, GuestPortTraps* port_traps) {
     ExitInfo exit_info;
 
     switch (exit_info.exit_reason) {
@@ -514,7 +607,7 @@ status_t vmexit_handler(AutoVmcsLoad* vmcs_load, GuestState* guest_state,
         dprintf(SPEW, "handling VMCALL instruction\n\n");
         return ERR_STOP;
     case ExitReason::IO_INSTRUCTION:
-        return handle_io_instruction(exit_info, guest_state, ctl_fifo);
+        return handle_io_instruction(exit_info, guest_state, ctl_fifo, port_traps);
     case ExitReason::RDMSR:
         dprintf(SPEW, "handling RDMSR instruction %#" PRIx64 "\n\n", guest_state->rcx);
         return handle_rdmsr(exit_info, guest_state);
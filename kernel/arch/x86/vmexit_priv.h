@@ -11,6 +11,7 @@
 class AutoVmcsLoad;
 class FifoDispatcher;
 class GuestPhysicalAddressSpace;
+class GuestPortTraps;
 struct GuestState;
 struct IoApicState;
 struct LocalApicState;
@@ -69,6 +70,8 @@ enum class InterruptionType : uint32_t {
 };
 
 void interrupt_window_exiting(bool enable);
+status_t local_apic_signal_interrupt(LocalApicState* local_apic_state, uint32_t vector);
+void sync_posted_interrupts(LocalApicState* local_apic_state);
 status_t vmexit_handler(AutoVmcsLoad* vmcs_load, GuestState* guest_state,
                         LocalApicState* local_apic_state, GuestPhysicalAddressSpace* gpas,
-                        FifoDispatcher* ctl_fifo);
+                        FifoDispatcher* ctl_fifo, GuestPortTraps* port_traps);
@@ -119,6 +119,11 @@ public:
     virtual uint8_t Read(const PciReg8 addr) const = 0;
     virtual uint16_t Read(const PciReg16 addr) const = 0;
     virtual uint32_t Read(const PciReg32 addr) const = 0;
+    /* Read a run of config space with a single pass of 32-bit accesses.
+     * offset must be uint32_t aligned; count is in uint32_t units.  Used
+     * to snapshot immutable regions (header, capability layout) at scan
+     * time instead of issuing one config access per register. */
+    virtual void ReadBlock(uint16_t offset, uint32_t* buf, size_t count) const = 0;
     virtual void Write(const PciReg8 addr, uint8_t val) const = 0;
     virtual void Write(const PciReg16 addr, uint16_t val) const = 0;
     virtual void Write(const PciReg32 addr, uint32_t val) const = 0;
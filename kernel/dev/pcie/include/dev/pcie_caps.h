@@ -57,6 +57,18 @@ constexpr uint8_t PCIE_CAP_ID_ENHANCED_ALLOCATION      = 0x14;
 
 #define PCIE_CAP_MSI_CTRL_SET_MME(val, ctrl)    (uint16_t)((ctrl & ~0x0070) | ((val & 0x7) << 4))
 #define PCIE_CAP_MSI_CTRL_SET_ENB(val, ctrl)    (uint16_t)((ctrl & ~0x0001) | (!!val))
+
+/**
+ * Structure definitions for capability PCIE_CAP_ID_MSIX
+ *
+ * @see The PCI Local Bus specificiaion v3.0 Section 6.8.2
+ */
+#define PCIE_CAP_MSIX_CTRL_GET_SIZE(ctrl)       ((ctrl) & 0x07FF)
+#define PCIE_CAP_MSIX_CTRL_GET_FMASK(ctrl)      ((ctrl & 0x4000) != 0)
+#define PCIE_CAP_MSIX_CTRL_GET_ENB(ctrl)        ((ctrl & 0x8000) != 0)
+
+#define PCIE_CAP_MSIX_CTRL_SET_FMASK(val, ctrl) (uint16_t)((ctrl & ~0x4000) | ((!!val) << 14))
+#define PCIE_CAP_MSIX_CTRL_SET_ENB(val, ctrl)   (uint16_t)((ctrl & ~0x8000) | ((!!val) << 15))
 #define PCS_CAPS_V1_ENDPOINT_SIZE        ((uint)offsetof(pcie_capabilities_t, link))
 #define PCS_CAPS_V1_UPSTREAM_PORT_SIZE   ((uint)offsetof(pcie_capabilities_t, slot))
 #define PCS_CAPS_V1_DOWNSTREAM_PORT_SIZE ((uint)offsetof(pcie_capabilities_t, root))
@@ -255,6 +267,43 @@ private:
     PciReg32 pending_bits_;
 };
 
+/* MSI-X Interrupts.
+ * @see PCI Local Bus Spec v3.0 section 6.8.2.
+ */
+class PciCapMsix : public PciStdCapability {
+public:
+    static constexpr uint16_t kControlOffset = 0x02;
+    static constexpr uint16_t kTableOffset   = 0x04;
+    static constexpr uint16_t kPbaOffset     = 0x08;
+    static constexpr uint16_t kCapSize       = static_cast<uint16_t>(kPbaOffset + 4u);
+    static constexpr uint32_t kBirMask       = 0x7;
+
+    PciCapMsix(const PcieDevice& dev, uint16_t base, uint8_t id);
+    ~PciCapMsix() {}
+
+    // Accessors
+    unsigned int table_size() const { return table_size_; }
+    uint32_t table_bar()      const { return table_bar_; }
+    uint32_t table_offset()   const { return table_offset_; }
+    uint32_t pba_bar()        const { return pba_bar_; }
+    uint32_t pba_offset()     const { return pba_offset_; }
+    PciReg16 ctrl_reg()  const { return ctrl_; }
+    PciReg32 table_reg() const { return table_; }
+    PciReg32 pba_reg()   const { return pba_; }
+
+private:
+    unsigned int table_size_ = 0;
+    uint32_t table_bar_ = 0;
+    uint32_t table_offset_ = 0;
+    uint32_t pba_bar_ = 0;
+    uint32_t pba_offset_ = 0;
+
+    // Cached registers
+    PciReg16 ctrl_;
+    PciReg32 table_;
+    PciReg32 pba_;
+};
+
 /* PCI Express Capability classes */
 
 class PciCapPcie : public PciStdCapability {
@@ -458,8 +458,9 @@ private:
             mxtl::RefPtr<SharedLegacyIrqHandler> shared_handler;
         } legacy;
 
-        PciCapMsi* msi = nullptr;
-        /* TODO(johngro) : Add MSI-X state */
-        struct { } msi_x;
+        PciCapMsi*  msi  = nullptr;
+        /* TODO(johngro) : program the vector table and add an MSI-X IRQ
+         * mode; right now we only discover and sanity check the capability. */
+        PciCapMsix* msix = nullptr;
     } irq_;
 };
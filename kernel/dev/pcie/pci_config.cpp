@@ -67,6 +67,7 @@ public:
     uint8_t Read(const PciReg8 addr) const override;
     uint16_t Read(const PciReg16 addr) const override;
     uint32_t Read(const PciReg32 addr) const override;
+    void ReadBlock(uint16_t offset, uint32_t* buf, size_t count) const override;
     void Write(const PciReg8 addr, uint8_t val) const override;
     void Write(const PciReg16 addr, uint16_t val) const override;
     void Write(const PciReg32 addr, uint32_t val) const override;
@@ -84,6 +85,9 @@ uint16_t PciPioConfig::Read(const PciReg16 addr) const {
 uint32_t PciPioConfig::Read(const PciReg32 addr) const {
     PANIC_UNIMPLEMENTED;
 }
+void PciPioConfig::ReadBlock(uint16_t offset, uint32_t* buf, size_t count) const {
+    PANIC_UNIMPLEMENTED;
+}
 void PciPioConfig::Write(const PciReg8 addr, uint8_t val) const {
     PANIC_UNIMPLEMENTED;
 }
@@ -101,6 +105,7 @@ public:
     uint8_t Read(const PciReg8 addr) const override;
     uint16_t Read(const PciReg16 addr) const override;
     uint32_t Read(const PciReg32 addr) const override;
+    void ReadBlock(uint16_t offset, uint32_t* buf, size_t count) const override;
     void Write(const PciReg8 addr, uint8_t val) const override;
     void Write(const PciReg16 addr, uint16_t val) const override;
     void Write(const PciReg32 addr, uint32_t val) const override;
@@ -125,6 +130,13 @@ uint32_t PciMmioConfig::Read(const PciReg32 addr) const {
     return LE32(*reg);
 }
 
+void PciMmioConfig::ReadBlock(uint16_t offset, uint32_t* buf, size_t count) const {
+    DEBUG_ASSERT(!(offset & (sizeof(uint32_t) - 1)));
+    auto reg = reinterpret_cast<const volatile uint32_t*>(base_ + offset);
+    for (size_t i = 0; i < count; i++)
+        buf[i] = LE32(reg[i]);
+}
+
 void PciMmioConfig::Write(PciReg8 addr, uint8_t val) const {
     auto reg = reinterpret_cast<volatile uint8_t*>(base_ + addr.offset());
     *reg = val;
@@ -255,6 +255,60 @@ PciCapMsi::PciCapMsi(const PcieDevice& dev, uint16_t base, uint8_t id)
     is_valid_ = true;
 }
 
+/*
+ * @see PCI Local Bus Specification 3.0 Section 6.8.2
+ */
+PciCapMsix::PciCapMsix(const PcieDevice& dev, uint16_t base, uint8_t id)
+    : PciStdCapability(dev, base, id) {
+    DEBUG_ASSERT(id == PCIE_CAP_ID_MSIX);
+    auto cfg = dev.config();
+
+    ctrl_  = PciReg16(static_cast<uint16_t>(base_ + kControlOffset));
+    table_ = PciReg32(static_cast<uint16_t>(base_ + kTableOffset));
+    pba_   = PciReg32(static_cast<uint16_t>(base_ + kPbaOffset));
+
+    uint16_t msix_end = static_cast<uint16_t>(base_ + kCapSize);
+    if (msix_end >= PCIE_BASE_CONFIG_SIZE) {
+        TRACEF("Device %02x:%02x.%01x (%04hx:%04hx) has illegally positioned "
+               "MSI-X capability structure.  Structure should be %u bytes "
+               "long, but ends at %u, past the end of config space.\n",
+               dev.bus_id(), dev.dev_id(), dev.func_id(),
+               dev.vendor_id(), dev.device_id(),
+               kCapSize, msix_end);
+        return;
+    }
+
+    uint16_t ctrl  = cfg->Read(ctrl_reg());
+    uint32_t table = cfg->Read(table_reg());
+    uint32_t pba   = cfg->Read(pba_reg());
+
+    table_size_   = static_cast<unsigned int>(PCIE_CAP_MSIX_CTRL_GET_SIZE(ctrl)) + 1;
+    table_bar_    = table & kBirMask;
+    table_offset_ = table & ~kBirMask;
+    pba_bar_      = pba & kBirMask;
+    pba_offset_   = pba & ~kBirMask;
+
+    if ((table_bar_ >= PCIE_MAX_BAR_REGS) || (pba_bar_ >= PCIE_MAX_BAR_REGS)) {
+        TRACEF("Device %02x:%02x.%01x (%04hx:%04hx) has invalid BAR indicators "
+               "in its MSI-X capability structure (table BIR %u, PBA BIR %u).\n",
+               dev.bus_id(), dev.dev_id(), dev.func_id(),
+               dev.vendor_id(), dev.device_id(),
+               table_bar_, pba_bar_);
+        return;
+    }
+
+    /* Success!
+     *
+     * Make sure that MSI-X is disabled and that the function mask is clear,
+     * then record what we found.  Programming the vector table has to wait
+     * until the BAR holding it has been allocated and mapped.
+     */
+    cfg->Write(ctrl_reg(), PCIE_CAP_MSIX_CTRL_SET_FMASK(0,
+                           PCIE_CAP_MSIX_CTRL_SET_ENB(0, ctrl)));
+
+    is_valid_ = true;
+}
+
 /* Catch quirks and invalid capability offsets we may see */
 inline status_t validate_capability_offset(uint8_t offset) {
     if (offset == 0xFF
@@ -275,7 +329,10 @@ inline status_t validate_capability_offset(uint8_t offset) {
 
 status_t PcieDevice::ParseStdCapabilitiesLocked() {
     status_t res = NO_ERROR;
-    uint8_t cap_offset = cfg_->Read(PciConfig::kCapabilitiesPtr);
+    /* The bottom two bits of every capability pointer are reserved and must
+     * be masked; this also keeps cap_offset aligned for the 16-bit header
+     * reads below. */
+    uint8_t cap_offset = cfg_->Read(PciConfig::kCapabilitiesPtr) & 0xFC;
     uint8_t caps_found = 0;
     AllocChecker ac;
 
@@ -296,7 +353,10 @@ status_t PcieDevice::ParseStdCapabilitiesLocked() {
             break;
         }
 
-        uint8_t id = cfg_->Read(PciReg8(cap_offset));
+        /* The capability id and next pointer share a 16-bit register, so
+         * fetch both with one config access. */
+        uint16_t cap_hdr = cfg_->Read(PciReg16(cap_offset));
+        uint8_t id = static_cast<uint8_t>(cap_hdr & 0xFF);
 
         LTRACEF("Found capability (#%u, id = 0x%02x) for device %02x:%02x.%01x (%04hx:%04hx)\n",
                 caps_found, id,
@@ -315,6 +375,8 @@ status_t PcieDevice::ParseStdCapabilitiesLocked() {
         switch(id) {
             case PCIE_CAP_ID_MSI:
                 cap = irq_.msi = new (&ac) PciCapMsi(*this, cap_offset, id); break;
+            case PCIE_CAP_ID_MSIX:
+                cap = irq_.msix = new (&ac) PciCapMsix(*this, cap_offset, id); break;
             case PCIE_CAP_ID_PCI_EXPRESS:
                 cap = pcie_ = new (&ac) PciCapPcie(*this, cap_offset, id); break;
             case PCIE_CAP_ID_ADVANCED_FEATURES:
@@ -330,7 +392,7 @@ status_t PcieDevice::ParseStdCapabilitiesLocked() {
         }
 
         caps_.detected.push_front(mxtl::unique_ptr<PciStdCapability>(cap));
-        cap_offset  = cfg_->Read(PciReg8(static_cast<uint16_t>(cap_offset + 0x1))) & 0xFC;
+        cap_offset  = static_cast<uint8_t>((cap_hdr >> 8) & 0xFC);
         caps_found++;
     }
 
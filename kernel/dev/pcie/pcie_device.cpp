@@ -127,13 +127,16 @@ status_t PcieDevice::InitLocked(PcieUpstreamNode& upstream) {
         return ERR_BAD_STATE;
     }
 
-    // Cache basic device info
-    vendor_id_ = cfg_->Read(PciConfig::kVendorId);
-    device_id_ = cfg_->Read(PciConfig::kDeviceId);
-    class_id_  = cfg_->Read(PciConfig::kBaseClass);
-    subclass_  = cfg_->Read(PciConfig::kSubClass);
-    prog_if_   = cfg_->Read(PciConfig::kProgramInterface);
-    rev_id_    = cfg_->Read(PciConfig::kRevisionId);
+    // Cache basic device info.  These registers are immutable, so snapshot
+    // them with a single ranged read rather than one config access apiece.
+    uint32_t hdr[3];
+    cfg_->ReadBlock(PciConfig::kVendorId.offset(), hdr, countof(hdr));
+    vendor_id_ = static_cast<uint16_t>(hdr[0] & 0xFFFF);
+    device_id_ = static_cast<uint16_t>(hdr[0] >> 16);
+    rev_id_    = static_cast<uint8_t>(hdr[2] & 0xFF);
+    prog_if_   = static_cast<uint8_t>((hdr[2] >> 8) & 0xFF);
+    subclass_  = static_cast<uint8_t>((hdr[2] >> 16) & 0xFF);
+    class_id_  = static_cast<uint8_t>(hdr[2] >> 24);
 
     // Determine the details of each of the BARs, but do not actually allocate
     // space on the bus for them yet.
@@ -583,7 +583,10 @@ status_t PcieDevice::QueryIrqModeCapabilitiesLocked(pcie_irq_mode_t mode,
         if (!bus_drv_.platform().supports_msi())
             return ERR_NOT_SUPPORTED;
 
-        /* TODO(johngro) : finish MSI-X implementation. */
+        /* The MSI-X capability is discovered and sanity checked (see
+         * irq_.msix), but we cannot enter MSI-X mode until the vector table
+         * can be mapped and programmed.
+         * TODO(johngro) : finish MSI-X implementation. */
         return ERR_NOT_SUPPORTED;
 
     default:
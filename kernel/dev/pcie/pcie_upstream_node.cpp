@@ -74,10 +74,14 @@ void PcieUpstreamNode::ScanDownstream() {
             /* If we can find the config, and it has a valid vendor ID, go ahead
              * and scan it looking for a valid function. */
             auto cfg = driver().GetConfig(managed_bus_id_, dev_id, func_id);
-            uint16_t vendor_id = cfg->Read(PciConfig::kVendorId);
+            /* Vendor and device id share a dword; probing with one 32-bit
+             * access costs the same for empty slots and saves a second
+             * access for populated ones. */
+            uint32_t vnd_dev_id = cfg->Read(PciReg32(PciConfig::kVendorId.offset()));
+            uint16_t vendor_id = static_cast<uint16_t>(vnd_dev_id & 0xFFFF);
             bool good_device = cfg && (vendor_id != PCIE_INVALID_VENDOR_ID);
             if (good_device) {
-                uint16_t device_id = cfg->Read(PciConfig::kDeviceId);
+                uint16_t device_id = static_cast<uint16_t>(vnd_dev_id >> 16);
                 LTRACEF("found valid device %04x:%04x at %02x:%02x.%01x\n",
                         vendor_id, device_id, managed_bus_id_, dev_id, func_id);
                 /* Don't scan the function again if we have already discovered
@@ -251,6 +251,20 @@ uint64_t ticks_per_second(void)
     return u64_mul_u32_fp32_64(1000 * 1000 * 1000, cntpct_per_ns);
 }
 
+bool platform_usermode_get_mono_ratio(uint32_t ratio[3])
+{
+    // usermode is only granted access to the virtual counter (EL0VCTEN, see
+    // arch/arm64/arch.cpp), so it can compute the monotonic clock itself
+    // only when that's the counter the kernel is using
+    if (reg_procs->read_ct != read_cntvct)
+        return false;
+
+    ratio[0] = ns_per_cntpct.l0;
+    ratio[1] = ns_per_cntpct.l32;
+    ratio[2] = ns_per_cntpct.l64;
+    return true;
+}
+
 static uint32_t abs_int32(int32_t a)
 {
     return (a > 0) ? a : -a;
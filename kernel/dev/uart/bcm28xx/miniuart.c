@@ -8,8 +8,9 @@
 #include <assert.h>
 #include <dev/interrupt.h>
 #include <dev/uart.h>
+#include <kernel/event.h>
 #include <kernel/thread.h>
-#include <lib/cbuf.h>
+#include <lib/spsc_buf.h>
 #include <dev/bcm28xx.h>
 #include <platform/debug.h>
 #include <reg.h>
@@ -22,7 +23,12 @@
 
 #define RXBUF_SIZE 16
 
-static cbuf_t uart_rx_buf;
+// Wait-free rx ring; the irq handler is the producer, bcm28xx_getc the
+// consumer.  The event is signaled once per batch of received bytes, not once
+// per byte.
+static spsc_buf_t uart_rx_buf;
+static event_t uart_rx_event =
+    EVENT_INITIAL_VALUE(uart_rx_event, false, EVENT_FLAG_AUTOUNSIGNAL);
 
 struct bcm283x_mu_regs {
     uint32_t io;
@@ -66,19 +72,24 @@ static enum handler_return aux_irq(void* arg) {
         return INT_NO_RESCHEDULE;
     }
 
-    bool resched = false;
+    // Stage the received bytes locally so the ring is written in one batch.
+    char buf[RXBUF_SIZE];
+    size_t pos = 0;
 
-    while (true) {
+    while (pos < sizeof(buf)) {
         uint32_t iir = readl(&mu_regs->iir);
         if ((iir & MU_IIR_BYTE_AVAIL) == 0)
             break;
 
-        resched = true;
-        char ch = readl(&mu_regs->io);
-        cbuf_write_char(&uart_rx_buf, ch, false);
+        buf[pos++] = (char)readl(&mu_regs->io);
     }
 
-    return resched ? INT_RESCHEDULE : INT_NO_RESCHEDULE;
+    if (pos == 0)
+        return INT_NO_RESCHEDULE;
+
+    spsc_buf_write(&uart_rx_buf, buf, pos);
+    event_signal(&uart_rx_event, false);
+    return INT_RESCHEDULE;
 }
 
 static int bcm28xx_putc(char c) {
@@ -101,7 +112,7 @@ static void bcm28xx_uart_init(mdi_node_ref_t* node, uint level) {
         (struct bcm283x_aux_regs*)AUX_BASE;
 
     // Create circular buffer to hold received data.
-    cbuf_initialize(&uart_rx_buf, RXBUF_SIZE);
+    spsc_buf_initialize(&uart_rx_buf, RXBUF_SIZE);
 
     // AUX Interrupt handler handles interrupts for SPI1, SPI2, and miniuart
     // Interrupt handler must decode IRQ.
@@ -122,13 +133,18 @@ static void bcm28xx_uart_init(mdi_node_ref_t* node, uint level) {
 }
 
 static int bcm28xx_getc(bool wait) {
-    cbuf_t* rxbuf = &uart_rx_buf;
+    spsc_buf_t* rxbuf = &uart_rx_buf;
 
     char c;
-    if (cbuf_read_char(rxbuf, &c, wait) == 1)
-        return c;
+    for (;;) {
+        if (spsc_buf_read_char(rxbuf, &c) == 1)
+            return c;
 
-    return -1;
+        if (!wait)
+            return -1;
+
+        event_wait(&uart_rx_event);
+    }
 }
 
 static int bcm28xx_pputc(char c)
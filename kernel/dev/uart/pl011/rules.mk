@@ -14,5 +14,6 @@ MODULE_DEPS += \
 	kernel/dev/pdev \
 	kernel/dev/pdev/uart \
 	kernel/lib/mdi \
+	kernel/lib/spsc_buf \
 
 include make/module.mk
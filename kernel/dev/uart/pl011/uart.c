@@ -8,7 +8,8 @@
 #include <reg.h>
 #include <stdio.h>
 #include <trace.h>
-#include <lib/cbuf.h>
+#include <lib/spsc_buf.h>
+#include <kernel/event.h>
 #include <kernel/thread.h>
 #include <dev/interrupt.h>
 #include <dev/uart.h>
@@ -42,7 +43,11 @@
 static uint64_t uart_base = 0;
 static uint32_t uart_irq = 0;
 
-static cbuf_t uart_rx_buf;
+/* wait-free rx ring; the irq handler is the producer, uart_getc the consumer.
+ * the event is signaled once per batch of received bytes, not once per byte */
+static spsc_buf_t uart_rx_buf;
+static event_t uart_rx_event =
+    EVENT_INITIAL_VALUE(uart_rx_event, false, EVENT_FLAG_AUTOUNSIGNAL);
 
 static enum handler_return pl011_uart_irq(void *arg)
 {
@@ -52,17 +57,25 @@ static enum handler_return pl011_uart_irq(void *arg)
     uint32_t isr = UARTREG(uart_base, UART_TMIS);
 
     if (isr & ((1<<4) | (1<<6))) { // rxmis
-        /* while fifo is not empty, read chars out of it */
+        char buf[RXBUF_SIZE];
+        size_t space = spsc_buf_space_avail(&uart_rx_buf);
+        size_t pos = 0;
+
+        /* while fifo is not empty, stage chars so the ring is written once */
         while ((UARTREG(uart_base, UART_TFR) & (1<<4)) == 0) {
             /* if we're out of rx buffer, mask the irq instead of handling it */
-            if (cbuf_space_avail(&uart_rx_buf) == 0) {
-                UARTREG(uart_base, UART_IMSC) &= ~((1<<4)|(1<<6)); // !rxim
+            if (pos == space || pos == sizeof(buf)) {
+                if (pos == space)
+                    UARTREG(uart_base, UART_IMSC) &= ~((1<<4)|(1<<6)); // !rxim
                 break;
             }
 
-            char c = UARTREG(uart_base, UART_DR);
-            cbuf_write_char(&uart_rx_buf, c, false);
+            buf[pos++] = (char)UARTREG(uart_base, UART_DR);
+        }
 
+        if (pos > 0) {
+            spsc_buf_write(&uart_rx_buf, buf, pos);
+            event_signal(&uart_rx_event, false);
             resched = true;
         }
     }
@@ -73,7 +86,7 @@ static enum handler_return pl011_uart_irq(void *arg)
 static void pl011_uart_init(mdi_node_ref_t* node, uint level)
 {
     // create circular buffer to hold received data
-    cbuf_initialize(&uart_rx_buf, RXBUF_SIZE);
+    spsc_buf_initialize(&uart_rx_buf, RXBUF_SIZE);
 
     // assumes interrupts are contiguous
     register_int_handler(uart_irq, &pl011_uart_irq, NULL);
@@ -108,12 +121,17 @@ static int pl011_uart_putc(char c)
 static int pl011_uart_getc(bool wait)
 {
     char c;
-    if (cbuf_read_char(&uart_rx_buf, &c, wait) == 1) {
-        UARTREG(uart_base, UART_IMSC) = ((1<<4)|(1<<6)); // rxim
-        return c;
-    }
+    for (;;) {
+        if (spsc_buf_read_char(&uart_rx_buf, &c) == 1) {
+            UARTREG(uart_base, UART_IMSC) = ((1<<4)|(1<<6)); // rxim
+            return c;
+        }
+
+        if (!wait)
+            return -1;
 
-    return -1;
+        event_wait(&uart_rx_event);
+    }
 }
 
 /* panic-time getc/putc */
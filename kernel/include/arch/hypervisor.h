@@ -55,6 +55,10 @@ status_t arch_guest_set_gpr(const mxtl::unique_ptr<GuestContext>& context,
 status_t arch_guest_get_gpr(const mxtl::unique_ptr<GuestContext>& context,
                             mx_guest_gpr_t* guest_gpr);
 
+/* Signal an interrupt vector to a guest context.
+ */
+status_t arch_guest_interrupt(const mxtl::unique_ptr<GuestContext>& context, uint32_t vector);
+
 /* Set the instruction pointer of a guest context.
  */
 status_t arch_guest_set_ip(const mxtl::unique_ptr<GuestContext>& context, uintptr_t guest_ip);
@@ -35,6 +35,10 @@ static uint64_t arch_cycle_count(void);
 static uint arch_curr_cpu_num(void);
 static uint arch_max_num_cpus(void);
 
+/* whether usermode can read its current cpu number directly from the
+ * hardware (see the vDSO's mx_system_get_cpu_num) */
+static bool arch_usermode_can_get_cpu_num(void);
+
 /* Use to align structures on cache lines to avoid cpu aliasing. */
 #define __CPU_ALIGN __ALIGNED(CACHE_LINE)
 #define __CPU_MAX_ALIGN __ALIGNED(MAX_CACHE_LINE)
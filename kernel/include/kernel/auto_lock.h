@@ -7,6 +7,7 @@
 #pragma once
 
 #include <kernel/mutex.h>
+#include <kernel/rwlock.h>
 #include <kernel/spinlock.h>
 #include <mxtl/auto_lock.h>
 #include <mxtl/macros.h>
@@ -35,6 +36,44 @@ private:
     spin_lock_t* spinlock_;
 };
 
+class AutoReadLock {
+public:
+    explicit AutoReadLock(rwlock_t* rw) : rwlock_(rw) { rwlock_acquire_read(rwlock_); }
+    ~AutoReadLock() { release(); }
+
+    void release() {
+        if (rwlock_) {
+            rwlock_release_read(rwlock_);
+            rwlock_ = nullptr;
+        }
+    }
+
+    // suppress default constructors
+    DISALLOW_COPY_ASSIGN_AND_MOVE(AutoReadLock);
+
+private:
+    rwlock_t* rwlock_;
+};
+
+class TA_SCOPED_CAP AutoWriteLock {
+public:
+    explicit AutoWriteLock(rwlock_t* rw) TA_ACQ(rw) : rwlock_(rw) { rwlock_acquire_write(rwlock_); }
+    ~AutoWriteLock() TA_REL() { release(); }
+
+    void release() TA_REL() {
+        if (rwlock_) {
+            rwlock_release_write(rwlock_);
+            rwlock_ = nullptr;
+        }
+    }
+
+    // suppress default constructors
+    DISALLOW_COPY_ASSIGN_AND_MOVE(AutoWriteLock);
+
+private:
+    rwlock_t* rwlock_;
+};
+
 class AutoSpinLockIrqSave {
 public:
     explicit AutoSpinLockIrqSave(spin_lock_t& lock) : spinlock_(&lock) { acquire(); }
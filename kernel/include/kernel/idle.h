@@ -0,0 +1,43 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+#ifndef __KERNEL_IDLE_H
+#define __KERNEL_IDLE_H
+
+#include <magenta/compiler.h>
+#include <sys/types.h>
+
+__BEGIN_CDECLS
+
+/* Idle depth levels, shallow to deep. Deeper states save more power but
+ * add wake latency. The exact cpu state behind SHALLOW and DEEP is up to
+ * the architecture; POLL never halts.
+ */
+#define IDLE_DEPTH_POLL     (0u)
+#define IDLE_DEPTH_SHALLOW  (1u)
+#define IDLE_DEPTH_DEEP     (2u)
+
+/* Idle the current cpu once, picking the depth from the next pending
+ * timer deadline and the cpu's depth cap. Returns when the cpu wakes for
+ * any reason. Called by the per cpu idle thread with interrupts enabled.
+ */
+void idle_enter(void);
+
+/* Cap the idle depth of |cpu|. Latency-critical threads pinned to a cpu
+ * can use this to keep it out of deep states; IDLE_DEPTH_DEEP restores
+ * the default. Takes effect the next time the cpu goes idle.
+ */
+void idle_set_depth_cap(uint cpu, uint max_depth);
+uint idle_get_depth_cap(uint cpu);
+
+/* Architecture hook: enter the idle state for |depth| (SHALLOW or DEEP)
+ * until the next wake event. The default implementation ignores the hint
+ * and halts via arch_idle().
+ */
+void arch_idle_hinted(uint depth);
+
+__END_CDECLS
+
+#endif
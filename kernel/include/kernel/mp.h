@@ -40,6 +40,12 @@ typedef enum {
 void mp_init(void);
 
 void mp_reschedule(mp_cpu_mask_t target, uint flags);
+
+/* opt-in coalescing of reschedule ipis: between begin and end, targets
+ * passed to mp_reschedule are accumulated and sent as a single ipi per
+ * cpu at end. must be called with the thread lock held. */
+void mp_reschedule_batch_begin(void);
+void mp_reschedule_batch_end(uint flags);
 void mp_sync_exec(mp_cpu_mask_t target, mp_sync_task_t task, void *context);
 void mp_set_curr_cpu_online(bool online);
 void mp_set_curr_cpu_active(bool active);
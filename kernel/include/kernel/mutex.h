@@ -30,6 +30,12 @@ typedef struct TA_CAP("mutex") mutex {
     uint32_t magic;
     uintptr_t val;
     wait_queue_t wait;
+
+    /* priority inheritance state, only manipulated under the THREAD_LOCK:
+     * the max effective priority among the waiters (-1 when uncontended)
+     * and membership in the holder's owned_mutex_list while contended */
+    int pi_priority;
+    struct list_node pi_node;
 } mutex_t;
 
 #define MUTEX_FLAG_QUEUED ((uintptr_t)1)
@@ -50,6 +56,8 @@ static inline thread_t *mutex_holder(const mutex_t *m) {
     .magic = MUTEX_MAGIC, \
     .val = 0, \
     .wait = WAIT_QUEUE_INITIAL_VALUE((m).wait), \
+    .pi_priority = -1, \
+    .pi_node = LIST_INITIAL_CLEARED_VALUE, \
 }
 
 /* Rules for Mutexes:
@@ -0,0 +1,39 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+#pragma once
+
+#include <kernel/mp.h>
+#include <magenta/compiler.h>
+#include <sys/types.h>
+
+__BEGIN_CDECLS
+
+/* Minimal NUMA topology registry.
+ *
+ * Platform code fills this in during boot (on pc, from the ACPI SRAT)
+ * before the secondary cpus start scheduling threads.  Until then, and
+ * forever on platforms with no topology source, every cpu reports node 0
+ * and the node cpu masks are empty, which makes all the node-preference
+ * paths in the pmm and the scheduler degenerate to the old behavior.
+ */
+
+#define NUMA_MAX_NODES 16
+
+/* one more than the highest node number registered so far; at least 1 */
+uint numa_node_count(void);
+
+/* the node a cpu belongs to; 0 until the platform registers it */
+uint numa_cpu_node(uint cpu_num);
+
+/* mask of the cpus registered on a node */
+mp_cpu_mask_t numa_node_cpu_mask(uint node);
+
+/* Called by platform code at boot, once per cpu.  Node numbers must be
+ * compacted to 0..NUMA_MAX_NODES-1 by the caller, since firmware domain
+ * ids are sparse. */
+void numa_register_cpu(uint cpu_num, uint node);
+
+__END_CDECLS
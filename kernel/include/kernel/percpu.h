@@ -16,14 +16,41 @@
 __BEGIN_CDECLS
 
 struct percpu {
-    /* per cpu timer queue */
-    struct list_node timer_queue;
+    /* per cpu run queue and bitmap to indicate which queues are non empty */
+    struct list_node run_queue[NUM_PRIORITIES];
+    uint32_t run_queue_bitmap;
+
+    /* per cpu queue of ready deadline class threads, sorted by absolute deadline */
+    struct list_node deadline_queue;
+
+    /* thread earmarked for direct handoff by the next sched_block() on this
+     * cpu.  a non-NULL hint always refers to a thread still sitting in the
+     * ready queues: it is cleared the moment the thread is dequeued to run,
+     * so the pointer can never dangle */
+    thread_t *handoff_hint;
+
+    /* per cpu timer pairing heap, ordered by scheduled time */
+    struct timer *timer_root;
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-    /* per cpu preemption timer */
+    /* per cpu preemption timer, armed one-shot for the running thread's
+     * next slice or budget expiry */
     timer_t preempt_timer;
+
+    /* true while the preemption timer is deliberately left unarmed: the
+     * running thread is real time, idle, or alone on the cpu.  consulted
+     * by thread_kick_preempt_timer() when a thread joins the run queue */
+    bool preempt_timer_off;
 #endif
 
+    /* per cpu cache of free pages, fronting the pmm arenas */
+    struct list_node page_cache;
+    size_t page_cache_count;
+
+    /* per cpu cache of retired thread structs and their stacks, fronting the heap */
+    struct list_node thread_cache;
+    size_t thread_cache_count;
+
     /* thread/cpu level statistics */
     struct cpu_stats stats;
 
@@ -38,4 +65,32 @@ static inline struct percpu *get_local_percpu(void) {
     return &percpu[arch_curr_cpu_num()];
 }
 
+/* Dynamic per-cpu allocator.
+ *
+ * percpu_alloc() carves a region out of a static per-cpu pool and returns
+ * a handle to cpu 0's instance; every other cpu's instance lives at a
+ * fixed stride from it.  Each cpu's pool is cacheline-isolated from the
+ * others, so dynamically allocated per-cpu data never false-shares across
+ * cpus the way ad-hoc [SMP_MAX_CPUS] arrays do.  Memory comes back
+ * zero-filled.  Allocations are permanent: there is no free, matching the
+ * boot-time subsystems (counters, caches, queues) this serves.
+ *
+ * Returns NULL when the pool is exhausted; grow PERCPU_DYN_POOL_SIZE if
+ * that ever happens.
+ */
+#define PERCPU_DYN_POOL_SIZE (8192)
+
+void *percpu_alloc(size_t size, size_t align);
+
+/* a specific cpu's instance of an allocation */
+static inline void *percpu_ptr(void *base, uint cpu_num) {
+    return (void *)((uintptr_t)base + cpu_num * PERCPU_DYN_POOL_SIZE);
+}
+
+/* the calling cpu's instance; a single percpu-base-relative load on x86
+ * to fetch the cpu number plus address arithmetic */
+static inline void *this_cpu_ptr(void *base) {
+    return percpu_ptr(base, arch_curr_cpu_num());
+}
+
 __END_CDECLS
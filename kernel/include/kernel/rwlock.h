@@ -0,0 +1,79 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#ifndef __KERNEL_RWLOCK_H
+#define __KERNEL_RWLOCK_H
+
+#include <magenta/atomic.h>
+#include <magenta/compiler.h>
+#include <magenta/thread_annotations.h>
+#include <assert.h>
+#include <debug.h>
+#include <stdint.h>
+#include <kernel/thread.h>
+
+__BEGIN_CDECLS
+
+#define RWLOCK_MAGIC (0x72776C6B)  // 'rwlk'
+
+/* Body of the reader-writer lock.
+ * The count field holds the number of active readers in the low bits plus
+ * the WRITER and QUEUED flags. The QUEUED flag and the wait queues are
+ * only manipulated under the THREAD_LOCK; while QUEUED is set every
+ * acquisition takes the slow path, which keeps the lock-free fast paths
+ * from racing a hand-off in progress.
+ */
+typedef struct TA_CAP("rwlock") rwlock {
+    uint32_t magic;
+    volatile int count;
+    thread_t *holder;   /* the write holder, for debug assertions only */
+    wait_queue_t reader_wait;
+    wait_queue_t writer_wait;
+} rwlock_t;
+
+#define RWLOCK_FLAG_WRITER (1 << 30)
+#define RWLOCK_FLAG_QUEUED (1 << 29)
+#define RWLOCK_READER_MASK (RWLOCK_FLAG_QUEUED - 1)
+
+#define RWLOCK_INITIAL_VALUE(rw) \
+{ \
+    .magic = RWLOCK_MAGIC, \
+    .count = 0, \
+    .holder = NULL, \
+    .reader_wait = WAIT_QUEUE_INITIAL_VALUE((rw).reader_wait), \
+    .writer_wait = WAIT_QUEUE_INITIAL_VALUE((rw).writer_wait), \
+}
+
+/* Rules for reader-writer locks:
+ * - Only safe to use from thread context.
+ * - Non-recursive in both modes; upgrades and downgrades are not supported.
+ * - Phase-fair: a releaser hands the lock to waiters of the other kind
+ *   first, and new readers queue behind a waiting writer, so neither side
+ *   can starve the other.
+ */
+void rwlock_init(rwlock_t *rw);
+void rwlock_destroy(rwlock_t *rw);
+void rwlock_acquire_read(rwlock_t *rw);
+void rwlock_release_read(rwlock_t *rw);
+void rwlock_acquire_write(rwlock_t *rw) TA_ACQ(rw);
+void rwlock_release_write(rwlock_t *rw) TA_REL(rw);
+
+/* is the lock held in either mode by anyone? this is the strongest
+ * assertion available on paths that may run under the read lock */
+static inline bool rwlock_held(const rwlock_t *rw)
+{
+    return atomic_load((volatile int *)&rw->count) != 0;
+}
+
+/* does the current thread hold the lock for write? */
+static inline bool is_rwlock_write_held(const rwlock_t *rw)
+{
+    return rw->holder == get_current_thread();
+}
+
+__END_CDECLS
+
+#endif
@@ -9,6 +9,9 @@
 #include <stdbool.h>
 #include <list.h>
 #include <kernel/thread.h>
+#include <magenta/compiler.h>
+
+__BEGIN_CDECLS
 
 /* scheduler interface, used internally by thread.c */
 /* not intended to be used by regular kernel code */
@@ -21,7 +24,33 @@ void sched_yield(void);
 void sched_preempt(void);
 void sched_reschedule(void);
 
+/* priority inheritance hooks, used by the mutex code under the THREAD_LOCK */
+int sched_get_effec_priority(const thread_t *t);
+void sched_inherit_priority(thread_t *t, int pri);
+
+/* as sched_inherit_priority, but for the donation userspace futex waiters
+ * make to a PI futex owner; tracked in a separate slot so the kernel
+ * mutex bookkeeping and the futex bookkeeping don't clobber each other */
+void sched_user_inherit_priority(thread_t *t, int pri);
+
+/* deadline class hooks, called under the THREAD_LOCK */
+status_t sched_set_deadline(thread_t *t, lk_time_t capacity, lk_time_t period);
+bool sched_deadline_tick(thread_t *t, lk_time_t elapsed);
+
+/* cpu affinity, called under the THREAD_LOCK */
+status_t sched_set_cpu_affinity(thread_t *t, uint32_t affinity);
+
+/* direct handoff: while enabled via sched_handoff_wakeups(), wakeups the
+ * current thread performs park the woken thread on this cpu and the next
+ * sched_block() here switches straight to it via sched_switch_to(),
+ * donating the remainder of the blocker's timeslice.  for synchronous
+ * message passing where the waker sleeps right after waking its peer. */
+void sched_handoff_wakeups(bool enable);
+void sched_switch_to(thread_t *t);
+
 /* the low level reschedule routine, called from the scheduler */
 void _thread_resched_internal(void);
 
 thread_t *sched_get_top_thread(uint cpu);
+
+__END_CDECLS
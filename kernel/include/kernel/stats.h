@@ -10,6 +10,12 @@
 
 __BEGIN_CDECLS
 
+/* runnable-to-running scheduling latency histogram: bucket 0 counts
+ * switches where the incoming thread waited under a microsecond, bucket n
+ * counts waits in [2^(n-1), 2^n) microseconds, and the last bucket absorbs
+ * everything longer */
+#define SCHED_LATENCY_HIST_BUCKETS 16
+
 /* per cpu kernel level statistics */
 struct cpu_stats {
     lk_time_t idle_time;
@@ -30,6 +36,9 @@ struct cpu_stats {
     /* inter-processor interrupts */
     ulong reschedule_ipis;
     ulong generic_ipis;
+
+    /* how long threads sat runnable before this cpu picked them up */
+    ulong sched_latency_hist[SCHED_LATENCY_HIST_BUCKETS];
 };
 
 __END_CDECLS
@@ -45,6 +45,8 @@ enum thread_user_state_change {
     THREAD_USER_STATE_RESUME,
 };
 
+struct mutex;
+
 typedef int (*thread_start_routine)(void *arg);
 typedef void (*thread_trampoline_routine)(void) __NO_RETURN;
 typedef void (*thread_user_callback_t)(enum thread_user_state_change new_state,
@@ -56,6 +58,8 @@ typedef void (*thread_user_callback_t)(enum thread_user_state_change new_state,
 #define THREAD_FLAG_REAL_TIME                 (1<<3)
 #define THREAD_FLAG_IDLE                      (1<<4)
 #define THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK  (1<<5)
+#define THREAD_FLAG_DEADLINE                  (1<<6)
+#define THREAD_FLAG_SCHED_HANDOFF             (1<<7)
 
 #define THREAD_SIGNAL_KILL                    (1<<0)
 #define THREAD_SIGNAL_SUSPEND                 (1<<1)
@@ -83,8 +87,33 @@ typedef struct thread {
     int base_priority;
     int priority_boost;
 
+    /* deadline class parameters, valid when THREAD_FLAG_DEADLINE is set.
+     * the thread is promised deadline_capacity worth of cpu out of every
+     * deadline_period, scheduled earliest-deadline-first ahead of the
+     * priority based classes. */
+    lk_time_t deadline_capacity;
+    lk_time_t deadline_period;
+    lk_time_t deadline_abs;     /* absolute deadline of the current period */
+    lk_time_t deadline_budget;  /* runtime remaining in the current period */
+
+    /* priority inherited from waiters on mutexes this thread holds, -1 if none */
+    int inherited_priority;
+
+    /* priority inherited from userspace futex waiters that have declared
+     * this thread the owner of a PI futex, -1 if none */
+    int user_inherited_priority;
+
+    /* contended mutexes this thread holds, for priority inheritance bookkeeping */
+    struct list_node owned_mutex_list;
+
+    /* if blocked in mutex_acquire, the mutex being acquired, so donated
+     * priority can chase chains of blocked holders */
+    struct mutex *blocking_mutex;
+
     uint last_cpu; /* last/current cpu the thread is running on */
     int pinned_cpu; /* only run on pinned_cpu if >= 0 */
+    uint ready_queue_cpu; /* which cpu's run queue holds the thread while READY */
+    uint32_t cpu_affinity; /* mask of cpus the thread is allowed to run on */
 
     /* pointer to the kernel address space this thread is associated with */
     vmm_aspace_t *aspace;
@@ -102,6 +131,12 @@ typedef struct thread {
      * left the scheduler. */
     lk_time_t runtime_ns;
 
+    /* when the thread last entered a run queue, and the total and worst
+     * case time it has spent READY waiting for a cpu */
+    lk_time_t last_ready_time;
+    lk_time_t queued_time_ns;
+    lk_time_t queued_time_max;
+
     /* if blocked, a pointer to the wait queue */
     struct wait_queue *blocking_wait_queue;
 
@@ -186,6 +221,8 @@ status_t thread_detach(thread_t *t);
 status_t thread_join(thread_t *t, int *retcode, lk_time_t deadline);
 status_t thread_detach_and_resume(thread_t *t);
 status_t thread_set_real_time(thread_t *t);
+status_t thread_set_deadline(thread_t *t, lk_time_t capacity, lk_time_t period);
+status_t thread_set_cpu_affinity(thread_t *t, uint32_t affinity);
 
 /* scheduler routines to be used by regular kernel code */
 void thread_yield(void);      /* give up the cpu and time slice voluntarily */
@@ -226,6 +263,10 @@ status_t thread_sleep_relative(lk_time_t delay);
 /* return the number of nanoseconds a thread has been running for */
 lk_time_t thread_runtime(const thread_t *t);
 
+/* return the number of nanoseconds a thread has spent READY waiting for a
+ * cpu; if max_out is non-NULL it receives the longest single wait */
+lk_time_t thread_queued_time(const thread_t *t, lk_time_t *max_out);
+
 /* deliver a kill signal to a thread */
 void thread_kill(thread_t *t, bool block);
 
@@ -257,9 +298,21 @@ static inline bool thread_is_real_time_or_idle(thread_t *t)
     return !!(t->flags & (THREAD_FLAG_REAL_TIME | THREAD_FLAG_IDLE));
 }
 
+static inline bool thread_is_deadline(thread_t *t)
+{
+    return !!(t->flags & THREAD_FLAG_DEADLINE);
+}
+
 /* called on every timer tick for the scheduler to do quantum expiration */
 enum handler_return thread_timer_tick(void);
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* called with the thread lock held when a thread joins a cpu's ready
+ * queues, so a cpu running tick-free with its preemption timer parked
+ * starts timing the current quantum again */
+void thread_kick_preempt_timer(uint cpu);
+#endif
+
 /* the current thread */
 #include <arch/current_thread.h>
 thread_t *get_current_thread(void);
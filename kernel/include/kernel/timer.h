@@ -24,14 +24,17 @@ typedef enum handler_return (*timer_callback)(struct timer *, lk_time_t now, voi
 
 typedef struct timer {
     int magic;
-    struct list_node node;
+    struct list_node node;       // membership in the parent's child list
+    struct list_node child_list; // pairing heap children
 
     lk_time_t scheduled_time;
+    lk_time_t slack;  // how late past scheduled_time the timer may fire
     lk_time_t period;
 
     timer_callback callback;
     void *arg;
 
+    int queued_cpu;          // which cpu's heap the timer sits in, <0 if unqueued
     volatile int active_cpu; // <0 if inactive
     volatile bool cancel;    // true if cancel is pending
 } timer_t;
@@ -40,10 +43,13 @@ typedef struct timer {
 { \
     .magic = TIMER_MAGIC, \
     .node = LIST_INITIAL_CLEARED_VALUE, \
+    .child_list = LIST_INITIAL_VALUE((t).child_list), \
     .scheduled_time = 0, \
+    .slack = 0, \
     .period = 0, \
     .callback = NULL, \
     .arg = NULL, \
+    .queued_cpu = -1, \
     .active_cpu = -1, \
     .cancel = false, \
 }
@@ -57,12 +63,21 @@ typedef struct timer {
 */
 void timer_initialize(timer_t *);
 void timer_set_oneshot(timer_t *, lk_time_t deadline, timer_callback, void *arg);
+
+/* as timer_set_oneshot, but the timer may fire up to slack ns past the
+ * deadline so that deadline-tolerant timers coalesce into fewer interrupts */
+void timer_set_oneshot_slack(timer_t *, lk_time_t deadline, lk_time_t slack, timer_callback, void *arg);
 void timer_set_periodic(timer_t *, lk_time_t period, timer_callback, void *arg);
 bool timer_cancel(timer_t *);
 
 void timer_transition_off_cpu(uint old_cpu);
 void timer_thaw_percpu(void);
 
+/* earliest scheduled time in the current cpu's timer heap, or
+ * INFINITE_TIME if no timers are queued. used by the idle governor to
+ * predict how long the cpu will stay idle */
+lk_time_t timer_earliest_deadline(void);
+
 /* special helper routine to simultaneously try to acquire a spinlock and check for
  * timer cancel, which is needed in a few special cases.
  * returns NO_ERROR if spinlock was acquired, ERR_TIMED_OUT if timer was canceled.
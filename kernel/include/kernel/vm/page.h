@@ -22,6 +22,10 @@ typedef struct vm_page {
     struct {
         uint32_t flags : 8;
         uint32_t state : 3;
+        // number of outstanding pins (MX_VMO_OP_LOCK) holding the page in
+        // place for DMA. Only meaningful in the OBJECT state; modified under
+        // the owning vm object's lock.
+        uint32_t pin_count : 5;
     };
     uint32_t map_count;
 
@@ -46,6 +50,14 @@ typedef struct vm_page {
 #define VM_PAGE_STRUCT_SIZE (sizeof(vm_page_t))
 static_assert(sizeof(vm_page_t) == 32, "");
 
+// bits for vm_page.flags
+// Page is a reclaim candidate (MX_VMO_OP_DONT_NEED). Only meaningful in the
+// OBJECT state; set and cleared under the owning vm object's lock.
+#define VM_PAGE_FLAG_DONT_NEED 0x1
+
+// maximum number of simultaneous pins on a single page
+#define VM_PAGE_PIN_MAX ((1u << 5) - 1)
+
 enum vm_page_state {
     VM_PAGE_STATE_FREE,
     VM_PAGE_STATE_ALLOC,
@@ -29,9 +29,16 @@ typedef struct pmm_arena_info {
 // Add a pre-filled memory arena to the physical allocator.
 status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 
+// Tag every arena whose base address falls inside [base, base + size) with
+// the NUMA node that memory belongs to. Called by platform code once the
+// topology is known, which may be well after the arenas were added;
+// allocations then prefer arenas on the requesting cpu's node.
+void pmm_set_node(paddr_t base, size_t size, uint node);
+
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)  // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_KMAP (0x1) // allocate only from arenas marked KMAP
+#define PMM_ALLOC_FLAG_ZERO (0x2) // return an already zeroed page; single page allocations only
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
@@ -9,6 +9,7 @@
 #include <arch/mmu.h>
 #include <assert.h>
 #include <kernel/mutex.h>
+#include <kernel/rwlock.h>
 #include <kernel/vm.h>
 #include <kernel/vm/vm_address_region.h>
 #include <lib/crypto/prng.h>
@@ -143,11 +144,17 @@ public:
 
 protected:
     // Share the aspace lock with VmAddressRegion/VmMapping so they can serialize
-    // changes to the aspace.
+    // changes to the aspace. Operations that modify the region tree take it
+    // for write; lookups and the page fault path take it for read.
     friend class VmAddressRegionOrMapping;
     friend class VmAddressRegion;
     friend class VmMapping;
-    mutex_t* lock() { return &lock_; }
+    rwlock_t* lock() { return &lock_; }
+
+    // Serializes page table updates between concurrent page faults, which
+    // only hold the aspace lock for read. Mutators of the region tree hold
+    // the aspace lock for write and so exclude the fault path entirely.
+    mutex_t* arch_mmu_lock() { return &arch_mmu_lock_; }
 
     // Expose the PRNG for ASLR to VmAddressRegion
     crypto::PRNG& AslrPrng() {
@@ -182,7 +189,8 @@ private:
     bool aspace_destroyed_ = false;
     bool aslr_enabled_ = false;
 
-    mutable mutex_t lock_ = MUTEX_INITIAL_VALUE(lock_);
+    mutable rwlock_t lock_ = RWLOCK_INITIAL_VALUE(lock_);
+    mutable mutex_t arch_mmu_lock_ = MUTEX_INITIAL_VALUE(arch_mmu_lock_);
 
     // root of virtual address space
     // Access to this reference is guarded by lock_.
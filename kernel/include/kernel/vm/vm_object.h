@@ -66,6 +66,39 @@ public:
         return ERR_NOT_SUPPORTED;
     }
 
+    // move the committed pages in [offset, offset+len) into |dest| at
+    // |dest_offset|, leaving the source range decommitted; no bytes are
+    // copied. |transferred| returns the number of bytes worth of pages
+    // that moved
+    virtual status_t TransferRange(mxtl::RefPtr<VmObject> dest, uint64_t offset,
+                                   uint64_t dest_offset, uint64_t len, uint64_t* transferred) {
+        return ERR_NOT_SUPPORTED;
+    }
+
+    // commit a range of the vmo and pin its pages in place so they cannot
+    // be decommitted, resized away, or reclaimed while DMA is in flight
+    virtual status_t Pin(uint64_t offset, uint64_t len) {
+        return ERR_NOT_SUPPORTED;
+    }
+
+    // release a pin previously taken with Pin over the same range
+    virtual status_t Unpin(uint64_t offset, uint64_t len) {
+        return ERR_NOT_SUPPORTED;
+    }
+
+    // hint that a range of the vmo is unlikely to be needed again soon.
+    // hinted pages may be reclaimed under memory pressure, in which case
+    // their contents are lost and later reads return zeros
+    virtual status_t DontNeedRange(uint64_t offset, uint64_t len) {
+        return ERR_NOT_SUPPORTED;
+    }
+
+    // cancel a previous DontNeedRange hint on a range of the vmo. pages
+    // already reclaimed are not brought back
+    virtual status_t WillNeedRange(uint64_t offset, uint64_t len) {
+        return ERR_NOT_SUPPORTED;
+    }
+
     // read/write operators against kernel pointers only
     virtual status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read) {
         return ERR_NOT_SUPPORTED;
@@ -150,6 +183,9 @@ public:
     // returns an enum rather than adding a new method for each clone type.
     bool is_cow_clone() const;
 
+    // Returns true if this VMO is backed by a list of pages (a VmObjectPaged).
+    virtual bool is_paged() const { return false; }
+
     // get a pointer to the page structure and/or physical address at the specified offset.
     // valid flags are VMM_PF_FLAG_*
     virtual status_t GetPageLocked(uint64_t offset, uint pf_flags,
@@ -202,9 +238,23 @@ protected:
 private:
     Mutex local_lock_;
 
+    // offset-sharded locks used to serialize copy-on-write faults on the
+    // same page while the shared tree lock is dropped for the copy; like
+    // lock_, every member of a clone tree points at the root's array
+    static constexpr size_t kFaultShardCount = 8;
+    Mutex local_fault_shards_[kFaultShardCount];
+
 protected:
     Mutex& lock_;
 
+    Mutex* const fault_shards_;
+
+    // never acquire a fault shard while holding lock_; the fault path
+    // drops lock_ first, then takes the shard, then reacquires lock_
+    Mutex* fault_shard(uint64_t offset) {
+        return &fault_shards_[(offset / PAGE_SIZE) % kFaultShardCount];
+    }
+
     // list of every mapping
     mxtl::DoublyLinkedList<VmMapping*> mapping_list_ TA_GUARDED(lock_);
 
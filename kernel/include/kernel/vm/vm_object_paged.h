@@ -36,6 +36,7 @@ public:
         // TODO: Figure out whether it's safe to lock here without causing
         // any deadlocks.
         TA_NO_THREAD_SAFETY_ANALYSIS { return size_; }
+    bool is_paged() const override { return true; }
 
     size_t AllocatedPagesInRange(uint64_t offset, uint64_t len) const override;
 
@@ -43,6 +44,26 @@ public:
     status_t CommitRangeContiguous(uint64_t offset, uint64_t len, uint64_t* committed,
                                    uint8_t alignment_log2) override;
     status_t DecommitRange(uint64_t offset, uint64_t len, uint64_t* decommitted) override;
+    status_t TransferRange(mxtl::RefPtr<VmObject> dest, uint64_t offset,
+                           uint64_t dest_offset, uint64_t len, uint64_t* transferred) override
+        // Takes both vmos' locks, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+    status_t Pin(uint64_t offset, uint64_t len) override;
+    status_t Unpin(uint64_t offset, uint64_t len) override;
+    status_t DontNeedRange(uint64_t offset, uint64_t len) override;
+    status_t WillNeedRange(uint64_t offset, uint64_t len) override;
+
+    // reclaim up to |target| pages previously hinted with DontNeedRange(),
+    // returning the number freed. called by the background evictor with the
+    // discard registry lock held (see vm_object_paged.cpp)
+    size_t EvictDontNeedPages(size_t target);
+
+    // node traits for the evictor's registry of vmos carrying hinted pages
+    struct DiscardListTraits {
+        static mxtl::DoublyLinkedListNodeState<VmObjectPaged*>& node_state(VmObjectPaged& vmo) {
+            return vmo.discard_node_state_;
+        }
+    };
 
     status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read) override;
     status_t Write(const void* ptr, uint64_t offset, size_t len, size_t* bytes_written) override;
@@ -117,6 +138,23 @@ private:
     uint64_t parent_offset_ TA_GUARDED(lock_) = 0;
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
 
+    // upper bound on the number of pages in page_list_ carrying the
+    // DONT_NEED flag; decommit and resize can free flagged pages without
+    // updating it, so the evictor resyncs it when its scan comes up empty
+    uint64_t dont_need_pages_ TA_GUARDED(lock_) = 0;
+
+    // count of pages in page_list_, maintained at every page add/free so
+    // whole-object AllocatedPages() queries are O(1) instead of a walk of
+    // the page list
+    uint64_t committed_pages_ TA_GUARDED(lock_) = 0;
+
+    // membership in the evictor's discard registry
+    mxtl::DoublyLinkedListNodeState<VmObjectPaged*> discard_node_state_;
+
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
 };
+
+// wake the discardable page evictor; called by the pmm when a slow-path
+// allocation finds free memory running low
+void vmo_evictor_kick();
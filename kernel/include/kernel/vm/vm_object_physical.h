@@ -29,6 +29,10 @@ public:
     status_t LookupUser(uint64_t offset, uint64_t len, user_ptr<paddr_t> buffer,
                         size_t buffer_size) override;
 
+    // physical vmos are always resident, so pinning only validates the range
+    status_t Pin(uint64_t offset, uint64_t len) override;
+    status_t Unpin(uint64_t offset, uint64_t len) override;
+
     void Dump(uint depth, bool verbose) override;
 
     status_t GetPageLocked(uint64_t offset, uint pf_flags,
@@ -88,9 +88,45 @@ public:
         }
     }
 
+    // walk every page in the range [start_offset, end_offset), skipping over
+    // gaps in O(log n) by seeking directly to the first populated node
+    template <typename T>
+    void ForEveryPageInRange(uint64_t start_offset, uint64_t end_offset, T per_page_func) {
+        const uint64_t node_span = PAGE_SIZE * VmPageListNode::kPageFanOut;
+        for (auto it = list_.lower_bound(start_offset & ~(node_span - 1));
+             it.IsValid() && it->offset() < end_offset; ++it) {
+            it->ForEveryPage([&per_page_func, start_offset, end_offset](auto&& p, uint64_t off) {
+                if (off >= start_offset && off < end_offset) {
+                    per_page_func(p, off);
+                }
+            });
+        }
+    }
+
+    // walk every page in the range [start_offset, end_offset), skipping over
+    // gaps in O(log n) by seeking directly to the first populated node
+    template <typename T>
+    void ForEveryPageInRange(uint64_t start_offset, uint64_t end_offset, T per_page_func) const {
+        const uint64_t node_span = PAGE_SIZE * VmPageListNode::kPageFanOut;
+        for (auto it = list_.lower_bound(start_offset & ~(node_span - 1));
+             it.IsValid() && it->offset() < end_offset; ++it) {
+            it->ForEveryPage([&per_page_func, start_offset, end_offset](auto&& p, uint64_t off) {
+                if (off >= start_offset && off < end_offset) {
+                    per_page_func(p, off);
+                }
+            });
+        }
+    }
+
     status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
+    // take the page at |offset| out of the list without freeing it,
+    // erasing the node if it empties; returns null if there is no page
+    vm_page* RemovePage(uint64_t offset);
     status_t FreePage(uint64_t offset);
+    // free every page in the range [start_offset, end_offset) back to the pmm
+    // in one batch, erasing nodes that empty out; returns the number freed
+    size_t FreePagesInRange(uint64_t start_offset, uint64_t end_offset);
     size_t FreeAllPages();
 
 private:
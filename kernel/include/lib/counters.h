@@ -0,0 +1,69 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <arch/ops.h>
+#include <magenta/compiler.h>
+#include <stddef.h>
+#include <stdint.h>
+
+__BEGIN_CDECLS
+
+// Kernel counters are cheap per-cpu tallies of interesting events,
+// always on and readable from userspace through the VMO published as
+// PA_VMO_KCOUNTERS (see magenta/kcounter.h for its layout).  Usage:
+//
+//   KCOUNTER(channel_msgs, "channel.messages");
+//   ...
+//   kcounter_add(&channel_msgs, 1);
+
+struct k_counter_desc {
+    const char* name;
+};
+
+// Define the counter's descriptor and reserve its arena slot by placing
+// the descriptor in the "kcountdesc" section; its position there is the
+// counter's index in each per-cpu array.
+#define KCOUNTER(var, name) \
+    __USED __SECTION("kcountdesc") \
+    static const struct k_counter_desc var = { name }
+
+extern const struct k_counter_desc __start_kcountdesc[] __WEAK;
+extern const struct k_counter_desc __stop_kcountdesc[] __WEAK;
+
+// Set up by an init hook once the VM is running; until then the pointer
+// is null and very early events simply go uncounted.
+extern int64_t* kcounters_arena;
+extern size_t kcounters_arena_stride; // 64-bit slots per cpu row
+
+static inline size_t kcounter_index(const struct k_counter_desc* var) {
+    return (size_t)(var - __start_kcountdesc);
+}
+
+// A plain, non-atomic increment of the current cpu's slot.  A thread
+// migrated between reading the cpu number and the store can race another
+// increment of the same slot and lose a count; that error rate is fine
+// for statistics and keeps the hot-path cost to a few instructions.
+static inline void kcounter_add(const struct k_counter_desc* var,
+                                int64_t add) {
+    if (kcounters_arena == NULL)
+        return;
+    kcounters_arena[arch_curr_cpu_num() * kcounters_arena_stride +
+                    kcounter_index(var)] += add;
+}
+
+__END_CDECLS
+
+#ifdef __cplusplus
+#include <mxtl/ref_ptr.h>
+
+class VmObject;
+
+// The VMO holding the header, name table, and arena, for userboot to
+// hand to userspace read-only; null if the arena was never set up.
+mxtl::RefPtr<VmObject> kcounters_get_vmo();
+#endif
@@ -42,6 +42,17 @@ enum lk_init_flags {
     LK_INIT_FLAG_ALL_CPUS        = LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_SECONDARY_CPUS,
     LK_INIT_FLAG_CPU_SUSPEND     = 0x4,
     LK_INIT_FLAG_CPU_RESUME      = 0x8,
+
+    /* The hook may run concurrently with other hooks at the same init level.
+     * Marking a hook parallel asserts it has no ordering dependency on any
+     * other hook at its level; ordering against other levels still holds,
+     * since all hooks at a level complete before the next level starts.
+     * Parallel hooks run on worker threads once the scheduler is up
+     * (level >= LK_INIT_LEVEL_THREADING on the primary cpu); before that,
+     * or on the secondary cpu / suspend / resume paths, the flag is ignored
+     * and the hook runs inline as usual.
+     */
+    LK_INIT_FLAG_PARALLEL        = 0x10,
 };
 
 void lk_init_level(enum lk_init_flags flags, uint start_level, uint stop_level);
@@ -75,4 +86,7 @@ struct lk_init_struct {
 #define LK_INIT_HOOK(_name, _hook, _level) \
     LK_INIT_HOOK_FLAGS(_name, _hook, _level, LK_INIT_FLAG_PRIMARY_CPU)
 
+#define LK_INIT_HOOK_PARALLEL(_name, _hook, _level) \
+    LK_INIT_HOOK_FLAGS(_name, _hook, _level, LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_PARALLEL)
+
 __END_CDECLS
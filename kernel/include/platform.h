@@ -8,6 +8,7 @@
 #ifndef __PLATFORM_H
 #define __PLATFORM_H
 
+#include <stdbool.h>
 #include <sys/types.h>
 #include <magenta/compiler.h>
 
@@ -39,6 +40,12 @@ lk_time_t current_time(void);
 /* high-precision timer ticks per second */
 uint64_t ticks_per_second(void);
 
+/* if the monotonic clock is computed directly from a hardware tick counter
+ * that usermode can also read, fill in the fixed point ns-per-tick factor
+ * (the fp_32_64 words {l0, l32, l64}, see lib/fixed_point.h) and return
+ * true; returns false when usermode must use the mx_time_get syscall */
+bool platform_usermode_get_mono_ratio(uint32_t ratio[3]);
+
 /* super early platform initialization, before almost everything */
 void platform_early_init(void);
 
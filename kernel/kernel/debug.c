@@ -96,6 +96,10 @@ static int cmd_threadstats(int argc, const cmd_args *argv, uint32_t flags)
         printf("\tinterrupts: %lu\n", percpu[i].stats.interrupts);
         printf("\ttimer interrupts: %lu\n", percpu[i].stats.timer_ints);
         printf("\ttimers: %lu\n", percpu[i].stats.timers);
+        printf("\tsched latency (log2 us buckets):");
+        for (uint j = 0; j < SCHED_LATENCY_HIST_BUCKETS; j++)
+            printf(" %lu", percpu[i].stats.sched_latency_hist[j]);
+        printf("\n");
     }
 
     return 0;
@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+/**
+ * @file
+ * @brief  Idle-state governor
+ *
+ * Picks how deeply each cpu idles from the next pending timer deadline:
+ * a cpu about to be woken spins or takes a shallow halt, a cpu with
+ * nothing scheduled for a while is allowed into the deepest state the
+ * architecture offers. Latency-critical threads can cap the depth of
+ * their designated cpus with idle_set_depth_cap().
+ */
+
+#include <kernel/idle.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <kernel/timer.h>
+#include <magenta/compiler.h>
+#include <platform.h>
+
+/* predicted idle shorter than this spins instead of halting, since the
+ * halt/wake round trip would eat most of the window */
+#define IDLE_POLL_THRESHOLD_NS      LK_USEC(10)
+
+/* predicted idle shorter than this stays in the shallowest halt state;
+ * anything longer may take the deepest state allowed by the cpu's cap */
+#define IDLE_SHALLOW_THRESHOLD_NS   LK_USEC(200)
+
+/* per cpu idle depth cap, IDLE_DEPTH_* */
+static uint idle_depth_cap[SMP_MAX_CPUS] = {
+    [0 ... SMP_MAX_CPUS - 1] = IDLE_DEPTH_DEEP,
+};
+
+void idle_set_depth_cap(uint cpu, uint max_depth)
+{
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+    DEBUG_ASSERT(max_depth <= IDLE_DEPTH_DEEP);
+
+    idle_depth_cap[cpu] = max_depth;
+}
+
+uint idle_get_depth_cap(uint cpu)
+{
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+
+    return idle_depth_cap[cpu];
+}
+
+static uint idle_pick_depth(void)
+{
+    lk_time_t deadline = timer_earliest_deadline();
+
+    uint depth = IDLE_DEPTH_DEEP;
+    if (deadline != INFINITE_TIME) {
+        lk_time_t now = current_time();
+        lk_time_t delta = (deadline > now) ? deadline - now : 0;
+
+        if (delta < IDLE_POLL_THRESHOLD_NS)
+            depth = IDLE_DEPTH_POLL;
+        else if (delta < IDLE_SHALLOW_THRESHOLD_NS)
+            depth = IDLE_DEPTH_SHALLOW;
+    }
+
+    uint cap = idle_depth_cap[arch_curr_cpu_num()];
+    return (depth > cap) ? cap : depth;
+}
+
+void idle_enter(void)
+{
+    uint depth = idle_pick_depth();
+
+    if (depth == IDLE_DEPTH_POLL) {
+        /* a wake is imminent; yield the pipeline and let the idle thread
+         * loop back around rather than paying a halt/wake round trip */
+        arch_spinloop_pause();
+        return;
+    }
+
+    arch_idle_hinted(depth);
+}
+
+/* architectures without depth support just halt */
+__WEAK void arch_idle_hinted(uint depth)
+{
+    arch_idle();
+}
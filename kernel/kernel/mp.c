@@ -21,9 +21,13 @@
 #include <kernel/spinlock.h>
 #include <kernel/stats.h>
 #include <kernel/timer.h>
+#include <lib/counters.h>
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(mp_reschedule_ipis, "kernel.mp.reschedule_ipis");
+KCOUNTER(mp_generic_ipis, "kernel.mp.generic_ipis");
+
 /* a global state structure, aligned on cpu cache line to minimize aliasing */
 struct mp_state mp __CPU_ALIGN = {
     .hotplug_lock = MUTEX_INITIAL_VALUE(mp.hotplug_lock),
@@ -34,6 +38,11 @@ struct mp_state mp __CPU_ALIGN = {
 struct mp_sync_context;
 static void mp_sync_task(void *context);
 
+/* pending reschedule targets accumulated while ipi batching is enabled.
+ * protected by the thread lock, which all reschedule paths hold. */
+static mp_cpu_mask_t resched_pending_mask;
+static bool resched_batching;
+
 void mp_init(void)
 {
     mp.ipi_task_lock = SPIN_LOCK_INITIAL_VALUE;
@@ -66,6 +75,51 @@ void mp_reschedule(mp_cpu_mask_t target, uint flags)
 
     LTRACEF("local %u, post mask target now 0x%x\n", local_cpu, target);
 
+    if (target == 0)
+        return;
+
+    /* if a batch is open, just record the targets; the ipi goes out
+     * once at mp_reschedule_batch_end() */
+    if (resched_batching) {
+        resched_pending_mask |= target;
+        return;
+    }
+
+    kcounter_add(&mp_reschedule_ipis, 1);
+    arch_mp_send_ipi(target, MP_IPI_RESCHEDULE);
+}
+
+void mp_reschedule_batch_begin(void)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    resched_batching = true;
+}
+
+void mp_reschedule_batch_end(uint flags)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    resched_batching = false;
+
+    mp_cpu_mask_t target = resched_pending_mask;
+    resched_pending_mask = 0;
+
+    if (target == 0)
+        return;
+
+    /* the targets were masked against active/realtime as they were
+     * accumulated, but cpus may have changed state since; recheck */
+    target &= mp.active_cpus;
+    if ((flags & MP_RESCHEDULE_FLAG_REALTIME) == 0) {
+        target &= ~mp.realtime_cpus;
+    }
+    target &= ~(1U << arch_curr_cpu_num());
+
+    if (target == 0)
+        return;
+
+    kcounter_add(&mp_reschedule_ipis, 1);
     arch_mp_send_ipi(target, MP_IPI_RESCHEDULE);
 }
 
@@ -149,6 +203,7 @@ void mp_sync_exec(mp_cpu_mask_t target, mp_sync_task_t task, void *context)
     spin_unlock(&mp.ipi_task_lock);
 
     /* let CPUs know to begin executing */
+    kcounter_add(&mp_generic_ipis, 1);
     __UNUSED status_t status = arch_mp_send_ipi(target, MP_IPI_GENERIC);
     DEBUG_ASSERT(status == NO_ERROR);
 
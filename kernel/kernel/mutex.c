@@ -27,6 +27,52 @@
 
 #define LOCAL_TRACE 0
 
+/* cap on how far a donated priority chases a chain of blocked holders;
+ * past this the remaining holders simply don't see the boost */
+#define MUTEX_PI_MAX_CHAIN 8
+
+/* recompute the priority |t| inherits from the contended mutexes it
+ * holds and hand the result to the scheduler.  THREAD_LOCK must be held. */
+static void mutex_pi_recompute(thread_t *t)
+{
+    int pri = -1;
+    mutex_t *held;
+    list_for_every_entry(&t->owned_mutex_list, held, mutex_t, pi_node) {
+        if (held->pi_priority > pri)
+            pri = held->pi_priority;
+    }
+    sched_inherit_priority(t, pri);
+}
+
+/* donate |waiter|'s effective priority to the holder of |m|, following
+ * holders that are themselves blocked acquiring another mutex so the
+ * boost is inherited transitively.  THREAD_LOCK must be held. */
+static void mutex_pi_donate(mutex_t *m, thread_t *waiter)
+{
+    int pri = sched_get_effec_priority(waiter);
+
+    for (uint depth = 0; m && depth < MUTEX_PI_MAX_CHAIN; depth++) {
+        thread_t *holder = mutex_holder(m);
+        DEBUG_ASSERT(holder);
+
+        if (pri > m->pi_priority)
+            m->pi_priority = pri;
+        if (!list_in_list(&m->pi_node))
+            list_add_head(&holder->owned_mutex_list, &m->pi_node);
+
+        /* stop once the holder already runs at least this high */
+        if (m->pi_priority <= sched_get_effec_priority(holder))
+            break;
+
+        mutex_pi_recompute(holder);
+
+        /* if the holder is itself parked in mutex_acquire, pass its new
+         * effective priority on down the chain */
+        m = holder->blocking_mutex;
+        pri = sched_get_effec_priority(holder);
+    }
+}
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -104,6 +150,11 @@ retry:
         goto retry;
     }
 
+    // donate our priority to the holder (and whatever chain of holders
+    // it is blocked behind) for as long as we wait
+    ct->blocking_mutex = m;
+    mutex_pi_donate(m, ct);
+
     // we have signalled that we're blocking, so drop into the wait queue
     status_t ret = wait_queue_block(&m->wait, INFINITE_TIME);
     if (unlikely(ret < NO_ERROR)) {
@@ -153,6 +204,23 @@ static inline void mutex_release_internal(mutex_t *m, bool reschedule, bool thre
     // release a thread in the wait queue
     thread_t *t = wait_queue_dequeue_one(&m->wait, NO_ERROR);
     DEBUG_ASSERT_MSG(t, "mutex_release: wait queue didn't have anything, but m->val = %#" PRIxPTR "\n", mutex_val(m));
+    t->blocking_mutex = NULL;
+
+    // the mutex stops donating to us; recompute what the remaining
+    // waiters donate and hang it off the new owner instead
+    if (list_in_list(&m->pi_node))
+        list_delete(&m->pi_node);
+
+    int pi = -1;
+    thread_t *w;
+    list_for_every_entry(&m->wait.list, w, thread_t, queue_node) {
+        int ep = sched_get_effec_priority(w);
+        if (ep > pi)
+            pi = ep;
+    }
+    m->pi_priority = pi;
+    if (pi >= 0)
+        list_add_head(&t->owned_mutex_list, &m->pi_node);
 
     // we woke up a thread, mark the mutex owned by that thread
     uintptr_t newval = (uintptr_t)t | (wait_queue_is_empty(&m->wait) ? 0 : MUTEX_FLAG_QUEUED);
@@ -162,6 +230,12 @@ static inline void mutex_release_internal(mutex_t *m, bool reschedule, bool thre
         panic("bad state in mutex release %p, current thread %p\n", m, ct);
     }
 
+    // shed whatever boost the mutex was giving us and grant the new
+    // owner its donation before it hits the run queue
+    mutex_pi_recompute(ct);
+    if (pi >= 0)
+        mutex_pi_recompute(t);
+
     // put the new thread back in the run queue and optionally reschedule locally
     sched_unblock(t);
     if (reschedule)
@@ -0,0 +1,51 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+/**
+ * @file
+ * @brief  NUMA topology registry
+ *
+ * Holds the cpu-to-node mapping registered by platform code at boot.
+ * All state is written before the secondary cpus start scheduling and is
+ * read-only afterwards, so the readers take no locks.
+ */
+
+#include <kernel/numa.h>
+
+#include <assert.h>
+#include <debug.h>
+
+static uint cpu_node[SMP_MAX_CPUS];
+static mp_cpu_mask_t node_cpus[NUMA_MAX_NODES];
+static uint node_count = 1;
+
+uint numa_node_count(void)
+{
+    return node_count;
+}
+
+uint numa_cpu_node(uint cpu_num)
+{
+    DEBUG_ASSERT(cpu_num < SMP_MAX_CPUS);
+    return cpu_node[cpu_num];
+}
+
+mp_cpu_mask_t numa_node_cpu_mask(uint node)
+{
+    DEBUG_ASSERT(node < NUMA_MAX_NODES);
+    return node_cpus[node];
+}
+
+void numa_register_cpu(uint cpu_num, uint node)
+{
+    DEBUG_ASSERT(cpu_num < SMP_MAX_CPUS);
+    ASSERT(node < NUMA_MAX_NODES);
+
+    cpu_node[cpu_num] = node;
+    node_cpus[node] |= (1u << cpu_num);
+    if (node >= node_count)
+        node_count = node + 1;
+}
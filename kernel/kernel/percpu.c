@@ -7,6 +7,45 @@
 #include <kernel/percpu.h>
 
 #include <arch/ops.h>
+#include <assert.h>
+#include <kernel/spinlock.h>
+#include <pow2.h>
+#include <trace.h>
 
 struct percpu percpu[SMP_MAX_CPUS];
 
+// Backing store for percpu_alloc(); one pool per cpu.  The pool size is a
+// multiple of MAX_CACHE_LINE and the array is aligned to it, so no cache
+// line is ever shared between two cpus' pools.
+static_assert(PERCPU_DYN_POOL_SIZE % MAX_CACHE_LINE == 0,
+              "percpu pools must be cacheline-isolated");
+static uint8_t percpu_dyn_pool[SMP_MAX_CPUS][PERCPU_DYN_POOL_SIZE] __CPU_MAX_ALIGN;
+
+static spin_lock_t percpu_dyn_lock = SPIN_LOCK_INITIAL_VALUE;
+static size_t percpu_dyn_used;
+
+void *percpu_alloc(size_t size, size_t align)
+{
+    DEBUG_ASSERT(size > 0);
+    DEBUG_ASSERT(align > 0 && ispow2(align));
+    DEBUG_ASSERT(align <= MAX_CACHE_LINE);
+
+    void *ptr = NULL;
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&percpu_dyn_lock, state);
+
+    size_t offset = ROUNDUP(percpu_dyn_used, align);
+    if (size <= PERCPU_DYN_POOL_SIZE && offset <= PERCPU_DYN_POOL_SIZE - size) {
+        ptr = &percpu_dyn_pool[0][offset];
+        percpu_dyn_used = offset + size;
+    }
+
+    spin_unlock_irqrestore(&percpu_dyn_lock, state);
+
+    if (unlikely(!ptr))
+        TRACEF("pool exhausted allocating %zu bytes (%zu of %u used)\n",
+               size, percpu_dyn_used, PERCPU_DYN_POOL_SIZE);
+
+    return ptr;
+}
@@ -20,9 +20,12 @@ MODULE_DEPS := \
 MODULE_SRCS := \
 	$(LOCAL_DIR)/debug.c \
 	$(LOCAL_DIR)/event.c \
+	$(LOCAL_DIR)/idle.c \
 	$(LOCAL_DIR)/init.c \
 	$(LOCAL_DIR)/mutex.c \
+	$(LOCAL_DIR)/numa.c \
 	$(LOCAL_DIR)/percpu.c \
+	$(LOCAL_DIR)/rwlock.c \
 	$(LOCAL_DIR)/sched.c \
 	$(LOCAL_DIR)/thread.c \
 	$(LOCAL_DIR)/timer.c \
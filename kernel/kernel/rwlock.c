@@ -0,0 +1,240 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+/**
+ * @file
+ * @brief  Reader-writer lock functions
+ *
+ * @defgroup rwlock Rwlock
+ * @{
+ */
+
+#include <kernel/rwlock.h>
+
+#include <debug.h>
+#include <assert.h>
+#include <err.h>
+#include <kernel/thread.h>
+#include <trace.h>
+
+#define LOCAL_TRACE 0
+
+/* Hand-off notes:
+ *
+ * All the slow paths run under the THREAD_LOCK, which serializes them
+ * against each other and makes the wait queues consistent with the QUEUED
+ * flag. The fast paths never *acquire* while QUEUED is set, but the
+ * *release* fast paths run outside the THREAD_LOCK and can drop the lock
+ * to idle between an acquirer's load of the word and its atomic_or of
+ * QUEUED. An acquirer that queues therefore re-checks the prior value
+ * returned by the atomic_or before blocking: if the lock went idle in
+ * that window no release slow path is coming, so the acquirer claims the
+ * lock itself instead of blocking. Once QUEUED is actually observed by a
+ * releaser, its fast-path cmpxchg fails and it takes the slow path.
+ *
+ * A woken waiter owns the lock when wait_queue_block() returns: the
+ * releaser installs the new count (reader count or WRITER flag) on the
+ * waiters' behalf before waking them.
+ */
+
+void rwlock_init(rwlock_t *rw)
+{
+    *rw = (rwlock_t)RWLOCK_INITIAL_VALUE(*rw);
+}
+
+void rwlock_destroy(rwlock_t *rw)
+{
+    DEBUG_ASSERT(rw->magic == RWLOCK_MAGIC);
+    DEBUG_ASSERT_MSG(atomic_load(&rw->count) == 0,
+                     "destroying rwlock %p while held, count %#x\n",
+                     rw, atomic_load(&rw->count));
+
+    rw->magic = 0;
+
+    THREAD_LOCK(state);
+    wait_queue_destroy(&rw->reader_wait);
+    wait_queue_destroy(&rw->writer_wait);
+    THREAD_UNLOCK(state);
+}
+
+void rwlock_acquire_read(rwlock_t *rw)
+{
+    DEBUG_ASSERT(rw->magic == RWLOCK_MAGIC);
+    DEBUG_ASSERT(!arch_in_int_handler());
+
+    /* fast path: no writer active and no one queued */
+    int old = atomic_load(&rw->count);
+    for (;;) {
+        if (old & (RWLOCK_FLAG_WRITER | RWLOCK_FLAG_QUEUED))
+            break;
+        if (atomic_cmpxchg(&rw->count, &old, old + 1))
+            return;
+    }
+
+    THREAD_LOCK(state);
+
+    old = atomic_load(&rw->count);
+    for (;;) {
+        if (old & (RWLOCK_FLAG_WRITER | RWLOCK_FLAG_QUEUED)) {
+            /* queue up behind the writer (or the hand-off in progress);
+             * the prior value tells us whether a holder remains to run
+             * the release slow path and wake us */
+            old = atomic_or(&rw->count, RWLOCK_FLAG_QUEUED);
+            if (likely(old != 0)) {
+                status_t ret = wait_queue_block(&rw->reader_wait, INFINITE_TIME);
+                DEBUG_ASSERT(ret == NO_ERROR);
+                /* the releaser counted us as a reader before waking us */
+                break;
+            }
+            /* the lock went idle between our load and the atomic_or, so
+             * no release is coming; claim the read lock ourselves. the
+             * queues must be empty: waiters only block with QUEUED
+             * already set, and releasers keep it raised while any
+             * remain, so an idle word means no one is waiting */
+            DEBUG_ASSERT(rw->reader_wait.count == 0 && rw->writer_wait.count == 0);
+            atomic_store(&rw->count, 1);
+            break;
+        }
+        if (atomic_cmpxchg(&rw->count, &old, old + 1))
+            break;
+    }
+
+    THREAD_UNLOCK(state);
+}
+
+void rwlock_release_read(rwlock_t *rw)
+{
+    DEBUG_ASSERT(rw->magic == RWLOCK_MAGIC);
+    DEBUG_ASSERT((atomic_load(&rw->count) & RWLOCK_READER_MASK) > 0);
+
+    /* fast path: not the last reader out, or no one waiting */
+    int old = atomic_load(&rw->count);
+    for (;;) {
+        if ((old & RWLOCK_READER_MASK) == 1 && (old & RWLOCK_FLAG_QUEUED))
+            break;
+        if (atomic_cmpxchg(&rw->count, &old, old - 1))
+            return;
+    }
+
+    /* we're the last reader and someone is queued; hand the lock over */
+    THREAD_LOCK(state);
+
+    old = atomic_load(&rw->count);
+    for (;;) {
+        int new;
+        bool wake_writer = false;
+        int wake_readers = 0;
+
+        if ((old & RWLOCK_READER_MASK) > 1 || !(old & RWLOCK_FLAG_QUEUED)) {
+            /* the queue drained (or grew readers) while we took the
+             * thread lock; just drop our count */
+            new = old - 1;
+        } else if (rw->writer_wait.count > 0) {
+            /* grant the lock to the next writer */
+            wake_writer = true;
+            new = RWLOCK_FLAG_WRITER |
+                  ((rw->writer_wait.count > 1 || rw->reader_wait.count > 0) ? RWLOCK_FLAG_QUEUED : 0);
+        } else {
+            /* only readers are queued; this shouldn't arise (readers only
+             * queue behind a writer), but let them in rather than strand
+             * them */
+            wake_readers = rw->reader_wait.count;
+            new = wake_readers;
+        }
+
+        if (!atomic_cmpxchg(&rw->count, &old, new))
+            continue;
+
+        if (wake_writer) {
+            wait_queue_wake_one(&rw->writer_wait, true, NO_ERROR);
+        } else if (wake_readers > 0) {
+            wait_queue_wake_all(&rw->reader_wait, true, NO_ERROR);
+        }
+        break;
+    }
+
+    THREAD_UNLOCK(state);
+}
+
+void rwlock_acquire_write(rwlock_t *rw)
+{
+    DEBUG_ASSERT(rw->magic == RWLOCK_MAGIC);
+    DEBUG_ASSERT(!arch_in_int_handler());
+    DEBUG_ASSERT_MSG(!is_rwlock_write_held(rw), "recursive write acquire of rwlock %p\n", rw);
+
+    /* fast path: lock is completely idle */
+    int old = 0;
+    if (likely(atomic_cmpxchg(&rw->count, &old, RWLOCK_FLAG_WRITER))) {
+        rw->holder = get_current_thread();
+        return;
+    }
+
+    THREAD_LOCK(state);
+
+    old = atomic_load(&rw->count);
+    for (;;) {
+        if (old != 0) {
+            /* as in rwlock_acquire_read(), re-check the prior value so a
+             * release fast path racing with us can't leave the lock idle
+             * with no one left to wake us */
+            old = atomic_or(&rw->count, RWLOCK_FLAG_QUEUED);
+            if (likely(old != 0)) {
+                status_t ret = wait_queue_block(&rw->writer_wait, INFINITE_TIME);
+                DEBUG_ASSERT(ret == NO_ERROR);
+                /* the releaser set RWLOCK_FLAG_WRITER on our behalf */
+                break;
+            }
+            DEBUG_ASSERT(rw->reader_wait.count == 0 && rw->writer_wait.count == 0);
+            atomic_store(&rw->count, RWLOCK_FLAG_WRITER);
+            break;
+        }
+        if (atomic_cmpxchg(&rw->count, &old, RWLOCK_FLAG_WRITER))
+            break;
+    }
+
+    rw->holder = get_current_thread();
+
+    THREAD_UNLOCK(state);
+}
+
+void rwlock_release_write(rwlock_t *rw)
+{
+    DEBUG_ASSERT(rw->magic == RWLOCK_MAGIC);
+    DEBUG_ASSERT_MSG(is_rwlock_write_held(rw), "releasing rwlock %p the current thread doesn't hold\n", rw);
+
+    rw->holder = NULL;
+
+    /* fast path: no one waiting */
+    int old = RWLOCK_FLAG_WRITER;
+    if (likely(atomic_cmpxchg(&rw->count, &old, 0)))
+        return;
+
+    /* someone queued up while we held the lock; phase-fair hand-off:
+     * readers first, since any queued reader was blocked by us or by a
+     * writer that went before us */
+    THREAD_LOCK(state);
+
+    DEBUG_ASSERT(atomic_load(&rw->count) == (RWLOCK_FLAG_WRITER | RWLOCK_FLAG_QUEUED));
+
+    int new;
+    if (rw->reader_wait.count > 0) {
+        new = rw->reader_wait.count |
+              (rw->writer_wait.count > 0 ? RWLOCK_FLAG_QUEUED : 0);
+        atomic_store(&rw->count, new);
+        wait_queue_wake_all(&rw->reader_wait, true, NO_ERROR);
+    } else if (rw->writer_wait.count > 0) {
+        new = RWLOCK_FLAG_WRITER |
+              (rw->writer_wait.count > 1 ? RWLOCK_FLAG_QUEUED : 0);
+        atomic_store(&rw->count, new);
+        wait_queue_wake_one(&rw->writer_wait, true, NO_ERROR);
+    } else {
+        /* QUEUED with empty queues shouldn't happen: the flag is only
+         * set next to a wait_queue_block under the THREAD_LOCK */
+        panic("rwlock %p QUEUED with no waiters\n", rw);
+    }
+
+    THREAD_UNLOCK(state);
+}
@@ -15,8 +15,10 @@
 #include <err.h>
 #include <lib/ktrace.h>
 #include <kernel/mp.h>
+#include <kernel/numa.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
+#include <platform.h>
 
 /* legacy implementation that just broadcast ipis for every reschedule */
 #define BROADCAST_RESCHEDULE 0
@@ -37,28 +39,55 @@
 #define LOCAL_KTRACE2(probe, x, y)
 #endif
 
-/* the run queue */
-static struct list_node run_queue[NUM_PRIORITIES];
-static uint32_t run_queue_bitmap;
+/* the run queues now live in the percpu structure, one set per cpu.
+ * all manipulation is still protected by the global thread lock, but
+ * keeping the queues separate avoids every reschedule on one cpu
+ * walking lists that other cpus are actively mutating. */
 
 /* make sure the bitmap is large enough to cover our number of priorities */
-static_assert(NUM_PRIORITIES <= sizeof(run_queue_bitmap) * CHAR_BIT, "");
+static_assert(NUM_PRIORITIES <= sizeof(((struct percpu *)0)->run_queue_bitmap) * CHAR_BIT, "");
+
+/* deadline class admission control: utilization (capacity / period) is
+ * tracked in parts per million, and the sum across all admitted threads is
+ * capped below the online cpu count so the fair classes cannot be starved
+ * outright */
+#define DEADLINE_UTIL_SCALE 1000000u
+#define DEADLINE_UTIL_LIMIT_PER_CPU 900000u /* 90% of one cpu */
+
+/* total admitted utilization, protected by the thread lock */
+static uint64_t deadline_total_util;
 
 /* compute the effective priority of a thread */
 static int effec_priority(const thread_t *t)
 {
     int ep = t->base_priority + t->priority_boost;
+
+    /* a priority donated by waiters on mutexes the thread holds, or by
+     * userspace futex waiters naming it as owner, overrides the natural
+     * priority when higher */
+    if (t->inherited_priority > ep)
+        ep = t->inherited_priority;
+    if (t->user_inherited_priority > ep)
+        ep = t->user_inherited_priority;
+
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
     return ep;
 }
 
+int sched_get_effec_priority(const thread_t *t)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    return effec_priority(t);
+}
+
 /* boost the priority of the thread by +1 */
 static void boost_thread(thread_t *t)
 {
     if (NO_BOOST)
         return;
 
-    if (unlikely(thread_is_real_time_or_idle(t)))
+    if (unlikely(thread_is_real_time_or_idle(t) || thread_is_deadline(t)))
         return;
 
     if (t->priority_boost < MAX_PRIORITY_ADJ &&
@@ -76,7 +105,7 @@ static void deboost_thread(thread_t *t, bool quantum_expiration)
     if (NO_BOOST)
         return;
 
-    if (unlikely(thread_is_real_time_or_idle(t)))
+    if (unlikely(thread_is_real_time_or_idle(t) || thread_is_deadline(t)))
         return;
 
     int boost_floor;
@@ -101,16 +130,16 @@ static void deboost_thread(thread_t *t, bool quantum_expiration)
     t->priority_boost--;
 }
 
-/* pick a 'random' cpu */
-static mp_cpu_mask_t rand_cpu(const mp_cpu_mask_t mask)
+/* pick a 'random' cpu out of the passed in mask of cpus */
+static uint rand_cpu(const mp_cpu_mask_t mask)
 {
     if (unlikely(mask == 0))
-        return 0;
+        return arch_curr_cpu_num();
 
     /* check that the mask passed in has at least one bit set in the online mask */
     mp_cpu_mask_t online = mp_get_online_mask();
     if (unlikely((mask & online) == 0))
-        return 0;
+        return arch_curr_cpu_num();
 
     /* compute the highest online cpu */
     uint highest_cpu = (sizeof(mp_cpu_mask_t) * CHAR_BIT - 1) - __builtin_clz(online);
@@ -124,87 +153,222 @@ static mp_cpu_mask_t rand_cpu(const mp_cpu_mask_t mask)
             rot = 0;
 
         if ((1u << rot) & mask)
-            return (1u << rot);
+            return rot;
     }
 }
 
-/* find a cpu to wake up */
-static mp_cpu_mask_t find_cpu(thread_t *t)
+/* find a cpu to run the thread on, returns the cpu number */
+static uint find_cpu(thread_t *t)
 {
-    if (BROADCAST_RESCHEDULE)
-        return MP_CPU_ALL_BUT_LOCAL;
+    /* pinned threads only ever go to their pinned cpu */
+    if (unlikely(t->pinned_cpu >= 0))
+        return (uint)t->pinned_cpu;
+
+    /* every choice below is filtered through the thread's affinity mask; if
+     * the mask excludes every online cpu, ignore it rather than stranding
+     * the thread */
+    mp_cpu_mask_t allowed = t->cpu_affinity;
+    if (unlikely((allowed & mp_get_online_mask()) == 0))
+        allowed = ~0u;
 
     /* get the last cpu the thread ran on */
-    mp_cpu_mask_t last_ran_cpu_mask = (1u << thread_last_cpu(t));
+    uint last_ran_cpu = thread_last_cpu(t);
+    mp_cpu_mask_t last_ran_cpu_mask = (1u << last_ran_cpu) & allowed;
 
     /* the current cpu */
-    mp_cpu_mask_t curr_cpu_mask = (1u << arch_curr_cpu_num());
+    uint curr_cpu = arch_curr_cpu_num();
+    mp_cpu_mask_t curr_cpu_mask = (1u << curr_cpu) & allowed;
 
     /* get a list of idle cpus */
-    mp_cpu_mask_t idle_cpu_mask = mp_get_idle_mask();
+    mp_cpu_mask_t idle_cpu_mask = mp_get_idle_mask() & allowed;
     if (idle_cpu_mask != 0) {
         if (idle_cpu_mask & curr_cpu_mask) {
             /* the current cpu is idle, so run it here */
-            return 0;
+            return curr_cpu;
         }
 
         if (last_ran_cpu_mask & idle_cpu_mask) {
             /* the last core it ran on is idle and isn't the current cpu */
-            return last_ran_cpu_mask;
+            return last_ran_cpu;
         }
 
+        /* prefer an idle cpu on the numa node where the thread last ran,
+         * where whatever it still has resident in memory is local */
+        mp_cpu_mask_t local_idle_mask =
+            idle_cpu_mask & numa_node_cpu_mask(numa_cpu_node(last_ran_cpu));
+        if (local_idle_mask != 0)
+            return rand_cpu(local_idle_mask);
+
         /* pick an idle_cpu */
         return rand_cpu(idle_cpu_mask);
     }
 
     /* no idle cpus */
-    if (last_ran_cpu_mask == curr_cpu_mask) {
+    if (last_ran_cpu == curr_cpu && curr_cpu_mask) {
         /* the last cpu it ran on is us */
-        /* pick a random cpu that isn't the current one */
-        return rand_cpu(mp_get_online_mask() & ~(curr_cpu_mask));
-    } else {
+        /* pick a random cpu that isn't the current one, staying on this
+         * numa node when it has another cpu to offer */
+        mp_cpu_mask_t others = mp_get_online_mask() & allowed & ~(curr_cpu_mask);
+        mp_cpu_mask_t local_others =
+            others & numa_node_cpu_mask(numa_cpu_node(curr_cpu));
+        if (local_others != 0)
+            return rand_cpu(local_others);
+        return rand_cpu(others ? others : curr_cpu_mask);
+    } else if (last_ran_cpu_mask) {
         /* pick the last cpu it ran on */
-        return last_ran_cpu_mask;
+        return last_ran_cpu;
+    } else {
+        /* the last cpu is no longer allowed, pick anywhere in the mask */
+        return rand_cpu(mp_get_online_mask() & allowed);
     }
 }
 
+/* pick the run queue for the current thread as it comes off the cpu.
+ * normally that is the current cpu's queue, unless the thread's affinity
+ * mask has been changed to exclude this cpu, in which case we migrate it
+ * and kick the target so it gets picked up. */
+static uint requeue_target_cpu(thread_t *t, uint curr_cpu)
+{
+    if (likely(t->cpu_affinity & (1u << curr_cpu)))
+        return curr_cpu;
+
+    uint cpu = find_cpu(t);
+    if (cpu != curr_cpu)
+        mp_reschedule(1u << cpu, 0);
+    return cpu;
+}
+
+/* insert a deadline class thread in the cpu's deadline queue, which is kept
+ * sorted by absolute deadline so the head is always the EDF pick */
+static void insert_in_deadline_queue(uint cpu, thread_t *t)
+{
+    DEBUG_ASSERT(!list_in_list(&t->queue_node));
+
+    t->ready_queue_cpu = cpu;
+
+    thread_t *other;
+    list_for_every_entry(&percpu[cpu].deadline_queue, other, thread_t, queue_node) {
+        if (t->deadline_abs < other->deadline_abs) {
+            list_add_before(&other->queue_node, &t->queue_node);
+            return;
+        }
+    }
+    list_add_tail(&percpu[cpu].deadline_queue, &t->queue_node);
+}
+
+/* a cpu running tick-free (sole runnable thread, preemption timer parked)
+ * must restart its quantum clock when a thread joins its ready queues */
+static void kick_preempt_timer(uint cpu)
+{
+#if PLATFORM_HAS_DYNAMIC_TIMER
+    thread_kick_preempt_timer(cpu);
+#endif
+}
+
 /* run queue manipulation */
-static void insert_in_run_queue_head(thread_t *t)
+static void insert_in_run_queue_head(uint cpu, thread_t *t)
 {
+    /* start the runnable-to-running latency clock */
+    t->last_ready_time = current_time();
+
+    if (unlikely(thread_is_deadline(t))) {
+        insert_in_deadline_queue(cpu, t);
+        kick_preempt_timer(cpu);
+        return;
+    }
+
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
     int ep = effec_priority(t);
 
-    list_add_head(&run_queue[ep], &t->queue_node);
-    run_queue_bitmap |= (1u << ep);
+    t->ready_queue_cpu = cpu;
+    list_add_head(&percpu[cpu].run_queue[ep], &t->queue_node);
+    percpu[cpu].run_queue_bitmap |= (1u << ep);
+
+    kick_preempt_timer(cpu);
 }
 
-static void insert_in_run_queue_tail(thread_t *t)
+static void insert_in_run_queue_tail(uint cpu, thread_t *t)
 {
+    /* start the runnable-to-running latency clock */
+    t->last_ready_time = current_time();
+
+    if (unlikely(thread_is_deadline(t))) {
+        insert_in_deadline_queue(cpu, t);
+        kick_preempt_timer(cpu);
+        return;
+    }
+
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
     int ep = effec_priority(t);
 
-    list_add_tail(&run_queue[ep], &t->queue_node);
-    run_queue_bitmap |= (1u << ep);
+    t->ready_queue_cpu = cpu;
+    list_add_tail(&percpu[cpu].run_queue[ep], &t->queue_node);
+    percpu[cpu].run_queue_bitmap |= (1u << ep);
+
+    kick_preempt_timer(cpu);
 }
 
-thread_t *sched_get_top_thread(uint cpu)
+/* a thread leaving a cpu's ready queues must not linger as that cpu's
+ * handoff hint; this keeps the hint from ever pointing at a thread that
+ * could run and exit out from under us */
+static void drop_handoff_hint(uint cpu, thread_t *t)
+{
+    if (unlikely(percpu[cpu].handoff_hint == t))
+        percpu[cpu].handoff_hint = NULL;
+}
+
+/* remove a thread from whichever run queue it is in */
+static void remove_from_run_queue(uint cpu, thread_t *t, int prio_queue)
+{
+    DEBUG_ASSERT(t->state == THREAD_READY);
+    DEBUG_ASSERT(list_in_list(&t->queue_node));
+
+    list_delete(&t->queue_node);
+
+    if (list_is_empty(&percpu[cpu].run_queue[prio_queue]))
+        percpu[cpu].run_queue_bitmap &= ~(1u << prio_queue);
+}
+
+/* when stealing, skip threads pinned to the victim cpu and threads whose
+ * affinity mask excludes the stealing (current) cpu */
+static bool steal_allowed(const thread_t *t)
+{
+    return t->pinned_cpu < 0 && (t->cpu_affinity & (1u << arch_curr_cpu_num()));
+}
+
+/* walk one cpu's run queues looking for the highest priority runnable thread.
+ * if stealing from another cpu's queue, skip threads that are pinned there. */
+static thread_t *dequeue_thread(uint queue_cpu, bool stealing)
 {
-    thread_t *newthread;
-    uint32_t local_run_queue_bitmap = run_queue_bitmap;
+    /* the deadline class outranks every priority queue; the queue is sorted
+     * so the first eligible entry is the earliest deadline */
+    thread_t *dlthread;
+    list_for_every_entry(&percpu[queue_cpu].deadline_queue, dlthread, thread_t, queue_node) {
+        if (!stealing || likely(steal_allowed(dlthread))) {
+            list_delete(&dlthread->queue_node);
+            drop_handoff_hint(queue_cpu, dlthread);
+
+            LOCAL_KTRACE2("sched_get_top_dl", (uint32_t)dlthread->user_tid,
+                          (uint32_t)(dlthread->deadline_abs / 1000u));
+
+            return dlthread;
+        }
+    }
+
+    uint32_t local_run_queue_bitmap = percpu[queue_cpu].run_queue_bitmap;
 
     while (local_run_queue_bitmap) {
         /* find the first (remaining) queue with a thread in it */
         uint next_queue = HIGHEST_PRIORITY - __builtin_clz(local_run_queue_bitmap)
-                          - (sizeof(run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
+                          - (sizeof(local_run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
 
-        list_for_every_entry(&run_queue[next_queue], newthread, thread_t, queue_node) {
-            if (likely(newthread->pinned_cpu < 0) || (uint)newthread->pinned_cpu == cpu) {
-                list_delete(&newthread->queue_node);
-
-                if (list_is_empty(&run_queue[next_queue]))
-                    run_queue_bitmap &= ~(1<<next_queue);
+        thread_t *newthread;
+        list_for_every_entry(&percpu[queue_cpu].run_queue[next_queue], newthread, thread_t, queue_node) {
+            if (!stealing || likely(steal_allowed(newthread))) {
+                remove_from_run_queue(queue_cpu, newthread, next_queue);
+                drop_handoff_hint(queue_cpu, newthread);
 
                 LOCAL_KTRACE2("sched_get_top", newthread->priority_boost, newthread->base_priority);
 
@@ -212,8 +376,45 @@ thread_t *sched_get_top_thread(uint cpu)
             }
         }
 
-        local_run_queue_bitmap &= ~(1<<next_queue);
+        local_run_queue_bitmap &= ~(1u << next_queue);
     }
+
+    return NULL;
+}
+
+/* the local run queues are dry, try to steal work off another cpu.
+ * start the scan at the cpu after us so the load spreads out a bit. */
+static thread_t *steal_thread(uint cpu)
+{
+    mp_cpu_mask_t candidates = mp_get_online_mask() & ~(1u << cpu);
+
+    for (uint i = 1; i < SMP_MAX_CPUS; i++) {
+        uint victim = (cpu + i) % SMP_MAX_CPUS;
+        if (((1u << victim) & candidates) == 0)
+            continue;
+
+        thread_t *t = dequeue_thread(victim, true);
+        if (t) {
+            LOCAL_KTRACE2("sched_steal", victim, effec_priority(t));
+            return t;
+        }
+    }
+
+    return NULL;
+}
+
+thread_t *sched_get_top_thread(uint cpu)
+{
+    /* local run queues first */
+    thread_t *newthread = dequeue_thread(cpu, false);
+    if (likely(newthread))
+        return newthread;
+
+    /* nothing local, see if anyone else has excess work queued up */
+    newthread = steal_thread(cpu);
+    if (newthread)
+        return newthread;
+
     /* no threads to run, select the idle thread for this cpu */
     return &percpu[cpu].idle_thread;
 }
@@ -229,10 +430,78 @@ void sched_block(void)
 
     LOCAL_KTRACE0("sched_block");
 
+    /* an earlier wakeup earmarked a thread for direct handoff; switch
+     * straight to it now that we are going to sleep */
+    uint cpu = arch_curr_cpu_num();
+    thread_t *handoff = percpu[cpu].handoff_hint;
+    if (unlikely(handoff != NULL)) {
+        percpu[cpu].handoff_hint = NULL;
+        sched_switch_to(handoff);
+        return;
+    }
+
     /* we are blocking on something. the blocking code should have already stuck us on a queue */
     _thread_resched_internal();
 }
 
+/* switch directly to |t|, donating the remainder of the current thread's
+ * timeslice.  |t| sits at the head of this cpu's queue for its priority, so
+ * the reschedule below selects it unless something strictly higher became
+ * ready in the meantime.  the current thread must already have been moved
+ * into a blocked state and off the run queues, exactly as for sched_block(). */
+void sched_switch_to(thread_t *t)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    thread_t *current_thread = get_current_thread();
+    uint cpu = arch_curr_cpu_num();
+
+    DEBUG_ASSERT(current_thread->state != THREAD_RUNNING);
+
+    LOCAL_KTRACE0("sched_switch_to");
+
+    /* hand our unused quantum to the target so the back-to-back rpc pair is
+     * charged like one thread; only for the fair classes, a deadline thread
+     * runs on its own budget */
+    if (t->state == THREAD_READY && t->ready_queue_cpu == cpu &&
+        !thread_is_real_time_or_idle(t) && !thread_is_deadline(t) &&
+        current_thread->remaining_time_slice > t->remaining_time_slice) {
+        t->remaining_time_slice = current_thread->remaining_time_slice;
+    }
+
+    _thread_resched_internal();
+}
+
+/* bracket a wakeup the current thread performs just before sleeping, such as
+ * a synchronous rpc handing a message to its peer.  wakeups issued while
+ * enabled go through direct handoff: the woken thread is parked at the head
+ * of this cpu's queue with no ipi, and the next sched_block() here switches
+ * straight to it */
+void sched_handoff_wakeups(bool enable)
+{
+    THREAD_LOCK(state);
+
+    thread_t *current_thread = get_current_thread();
+    if (enable)
+        current_thread->flags |= THREAD_FLAG_SCHED_HANDOFF;
+    else
+        current_thread->flags &= ~THREAD_FLAG_SCHED_HANDOFF;
+
+    THREAD_UNLOCK(state);
+}
+
+/* a deadline thread waking after its deadline has passed starts a fresh
+ * period; waking inside the current period resumes whatever budget is left */
+static void deadline_wakeup(thread_t *t)
+{
+    lk_time_t now = current_time();
+    if (now >= t->deadline_abs) {
+        t->deadline_abs = now + t->deadline_period;
+        t->deadline_budget = t->deadline_capacity;
+    }
+}
+
 void sched_unblock(thread_t *t)
 {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
@@ -244,11 +513,33 @@ void sched_unblock(thread_t *t)
     /* thread is being woken up, boost its priority */
     boost_thread(t);
 
-    /* stuff the new thread in the run queue */
+    if (unlikely(thread_is_deadline(t)))
+        deadline_wakeup(t);
+
+    /* a waker that is about to sleep (see sched_handoff_wakeups()) parks the
+     * woken thread on its own cpu and earmarks it for direct handoff; no ipi
+     * is needed since this cpu reschedules the moment the waker blocks */
+    uint curr_cpu = arch_curr_cpu_num();
+    if (unlikely(get_current_thread()->flags & THREAD_FLAG_SCHED_HANDOFF) &&
+        likely(!arch_in_int_handler()) &&
+        likely(t->pinned_cpu < 0 || (uint)t->pinned_cpu == curr_cpu) &&
+        likely(t->cpu_affinity & (1u << curr_cpu))) {
+        t->state = THREAD_READY;
+        insert_in_run_queue_head(curr_cpu, t);
+        percpu[curr_cpu].handoff_hint = t;
+        return;
+    }
+
+    /* select a cpu for the thread and stuff it in that cpu's run queue */
+    uint cpu = find_cpu(t);
     t->state = THREAD_READY;
-    insert_in_run_queue_head(t);
+    insert_in_run_queue_head(cpu, t);
 
-    mp_reschedule(find_cpu(t), 0);
+    if (BROADCAST_RESCHEDULE) {
+        mp_reschedule(MP_CPU_ALL_BUT_LOCAL, 0);
+    } else if (cpu != arch_curr_cpu_num()) {
+        mp_reschedule(1u << cpu, 0);
+    }
 }
 
 void sched_unblock_list(struct list_node *list)
@@ -258,6 +549,10 @@ void sched_unblock_list(struct list_node *list)
 
     LOCAL_KTRACE0("sched_unblock_list");
 
+    /* coalesce the reschedule ipis for the whole batch of wakeups,
+     * so each target cpu is interrupted at most once */
+    mp_reschedule_batch_begin();
+
     /* pop the list of threads and shove into the scheduler */
     thread_t *t;
     while ((t = list_remove_tail_type(list, thread_t, queue_node))) {
@@ -267,12 +562,22 @@ void sched_unblock_list(struct list_node *list)
         /* thread is being woken up, boost its priority */
         boost_thread(t);
 
-        /* stuff the new thread in the run queue */
+        if (unlikely(thread_is_deadline(t)))
+            deadline_wakeup(t);
+
+        /* select a cpu for the thread and stuff it in that cpu's run queue */
+        uint cpu = find_cpu(t);
         t->state = THREAD_READY;
-        insert_in_run_queue_head(t);
+        insert_in_run_queue_head(cpu, t);
 
-        mp_reschedule(find_cpu(t), 0);
+        if (BROADCAST_RESCHEDULE) {
+            mp_reschedule(MP_CPU_ALL_BUT_LOCAL, 0);
+        } else if (cpu != arch_curr_cpu_num()) {
+            mp_reschedule(1u << cpu, 0);
+        }
     }
+
+    mp_reschedule_batch_end(0);
 }
 
 void sched_yield(void)
@@ -289,7 +594,7 @@ void sched_yield(void)
     /* consume the rest of the time slice, deboost ourself, and go to the end of the queue */
     current_thread->remaining_time_slice = 0;
     deboost_thread(current_thread, false);
-    insert_in_run_queue_tail(current_thread);
+    insert_in_run_queue_tail(requeue_target_cpu(current_thread, arch_curr_cpu_num()), current_thread);
 
     _thread_resched_internal();
 }
@@ -300,6 +605,7 @@ void sched_preempt(void)
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
     thread_t *current_thread = get_current_thread();
+    uint curr_cpu = arch_curr_cpu_num();
 
     LOCAL_KTRACE0("sched_preempt");
 
@@ -307,12 +613,13 @@ void sched_preempt(void)
 
     /* idle thread doesn't go in the run queue */
     if (likely(!thread_is_idle(current_thread))) {
+        uint cpu = requeue_target_cpu(current_thread, curr_cpu);
         if (current_thread->remaining_time_slice > 0) {
-            insert_in_run_queue_head(current_thread);
+            insert_in_run_queue_head(cpu, current_thread);
         } else {
             /* if we're out of quantum, deboost the thread and put it at the tail of the queue */
             deboost_thread(current_thread, true);
-            insert_in_run_queue_tail(current_thread);
+            insert_in_run_queue_tail(cpu, current_thread);
         }
     }
 
@@ -325,6 +632,7 @@ void sched_reschedule(void)
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
     thread_t *current_thread = get_current_thread();
+    uint curr_cpu = arch_curr_cpu_num();
 
     LOCAL_KTRACE0("sched_reschedule");
 
@@ -336,20 +644,194 @@ void sched_reschedule(void)
         /* deboost the current thread */
         deboost_thread(current_thread, false);
 
+        uint cpu = requeue_target_cpu(current_thread, curr_cpu);
         if (current_thread->remaining_time_slice > 0) {
-            insert_in_run_queue_head(current_thread);
+            insert_in_run_queue_head(cpu, current_thread);
         } else {
-            insert_in_run_queue_tail(current_thread);
+            insert_in_run_queue_tail(cpu, current_thread);
         }
     }
 
     _thread_resched_internal();
 }
 
+/* set the priority a thread inherits into |slot| (-1 to clear), one slot
+ * per donation source (kernel mutexes, userspace PI futexes).  the caller
+ * hands us the already-computed value; our job is moving the thread
+ * between run queues if the change shifts its effective priority while it
+ * sits READY.  a RUNNING thread needs no requeue: a raise is already in
+ * effect and a drop takes hold at its next reschedule.  a BLOCKED
+ * thread's donation is propagated down the mutex chain by the mutex code
+ * itself. */
+static void adjust_inherited_priority(thread_t *t, int *slot, int pri)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(pri >= -1 && pri <= HIGHEST_PRIORITY);
+
+    /* a deadline thread already outranks every priority based thread, so
+     * donated priority changes nothing about its queue position */
+    if (unlikely(thread_is_deadline(t))) {
+        *slot = pri;
+        return;
+    }
+
+    if (*slot == pri)
+        return;
+
+    int old_ep = effec_priority(t);
+    *slot = pri;
+    int new_ep = effec_priority(t);
+
+    if (old_ep == new_ep)
+        return;
+
+    LOCAL_KTRACE2("sched_inherit", (uint32_t)t->user_tid, (uint32_t)new_ep);
+
+    if (t->state == THREAD_READY) {
+        /* shift the thread to the run queue matching its new effective
+         * priority; at the head when boosted so it runs promptly.
+         * requeueing does not restart the latency clock: the thread has
+         * been waiting since it first went READY */
+        lk_time_t ready_time = t->last_ready_time;
+        uint cpu = t->ready_queue_cpu;
+        remove_from_run_queue(cpu, t, old_ep);
+        if (new_ep > old_ep) {
+            insert_in_run_queue_head(cpu, t);
+            mp_reschedule(1u << cpu, 0);
+        } else {
+            insert_in_run_queue_tail(cpu, t);
+        }
+        t->last_ready_time = ready_time;
+    }
+}
+
+void sched_inherit_priority(thread_t *t, int pri)
+{
+    adjust_inherited_priority(t, &t->inherited_priority, pri);
+}
+
+/* the userspace futex donation lives in its own slot: the futex code
+ * computes the max over its own waiters, independent of the kernel mutex
+ * recomputation in mutex.c */
+void sched_user_inherit_priority(thread_t *t, int pri)
+{
+    adjust_inherited_priority(t, &t->user_inherited_priority, pri);
+}
+
+/* change the mask of cpus the thread may run on.  takes effect immediately:
+ * a READY thread parked on a now-excluded cpu is migrated and a RUNNING one
+ * is kicked so its cpu reschedules it away */
+status_t sched_set_cpu_affinity(thread_t *t, uint32_t affinity)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if ((affinity & mp_get_online_mask()) == 0)
+        return ERR_INVALID_ARGS;
+
+    t->cpu_affinity = affinity;
+
+    switch (t->state) {
+        case THREAD_RUNNING: {
+            uint cpu = thread_last_cpu(t);
+            if ((affinity & (1u << cpu)) == 0)
+                mp_reschedule(1u << cpu, 0);
+            break;
+        }
+        case THREAD_READY: {
+            uint cpu = t->ready_queue_cpu;
+            if ((affinity & (1u << cpu)) == 0) {
+                /* migration keeps the latency clock running */
+                lk_time_t ready_time = t->last_ready_time;
+                if (thread_is_deadline(t)) {
+                    list_delete(&t->queue_node);
+                } else {
+                    remove_from_run_queue(cpu, t, effec_priority(t));
+                }
+                drop_handoff_hint(cpu, t);
+                uint new_cpu = find_cpu(t);
+                insert_in_run_queue_head(new_cpu, t);
+                t->last_ready_time = ready_time;
+                if (new_cpu != arch_curr_cpu_num())
+                    mp_reschedule(1u << new_cpu, 0);
+            }
+            break;
+        }
+        default:
+            /* blocked or suspended threads pick up the mask via find_cpu()
+             * when they next wake */
+            break;
+    }
+
+    return NO_ERROR;
+}
+
+/* admit a thread to (or, with capacity == period == 0, remove it from) the
+ * deadline class.  the new parameters take effect the next time the thread
+ * is queued. */
+status_t sched_set_deadline(thread_t *t, lk_time_t capacity, lk_time_t period)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    uint64_t old_util = 0;
+    if (thread_is_deadline(t))
+        old_util = t->deadline_capacity * DEADLINE_UTIL_SCALE / t->deadline_period;
+
+    if (capacity == 0 && period == 0) {
+        /* leave the deadline class, returning to the fair queues */
+        if (!thread_is_deadline(t))
+            return NO_ERROR;
+        deadline_total_util -= old_util;
+        t->flags &= ~THREAD_FLAG_DEADLINE;
+        t->deadline_capacity = 0;
+        t->deadline_period = 0;
+        return NO_ERROR;
+    }
+
+    if (capacity == 0 || capacity > period)
+        return ERR_INVALID_ARGS;
+
+    /* admission control: refuse reservations that would push the total
+     * utilization past the cap, rather than silently degrading everyone's
+     * guarantees */
+    uint64_t util = capacity * DEADLINE_UTIL_SCALE / period;
+    uint64_t limit = (uint64_t)__builtin_popcount(mp_get_online_mask()) *
+                     DEADLINE_UTIL_LIMIT_PER_CPU;
+    if (deadline_total_util - old_util + util > limit)
+        return ERR_NO_RESOURCES;
+
+    deadline_total_util += util - old_util;
+    t->deadline_capacity = capacity;
+    t->deadline_period = period;
+    t->deadline_abs = current_time() + period;
+    t->deadline_budget = capacity;
+    t->flags |= THREAD_FLAG_DEADLINE;
+    return NO_ERROR;
+}
+
+/* charge elapsed run time against the current thread's budget; returns true
+ * if the budget is gone and the thread should be preempted.  on overrun the
+ * deadline is postponed a period and the budget refilled, so an overrunning
+ * thread falls behind its deadline class peers instead of starving them. */
+bool sched_deadline_tick(thread_t *t, lk_time_t elapsed)
+{
+    DEBUG_ASSERT(thread_is_deadline(t));
+
+    if (elapsed < t->deadline_budget) {
+        t->deadline_budget -= elapsed;
+        return false;
+    }
+
+    t->deadline_abs += t->deadline_period;
+    t->deadline_budget = t->deadline_capacity;
+    return true;
+}
+
 void sched_init_early(void)
 {
     /* initialize the run queues */
-    for (unsigned int i=0; i < NUM_PRIORITIES; i++)
-        list_initialize(&run_queue[i]);
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        for (unsigned int i = 0; i < NUM_PRIORITIES; i++)
+            list_initialize(&percpu[cpu].run_queue[i]);
+        list_initialize(&percpu[cpu].deadline_queue);
+    }
 }
-
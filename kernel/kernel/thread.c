@@ -23,6 +23,7 @@
 #include <string.h>
 #include <printf.h>
 #include <err.h>
+#include <kernel/idle.h>
 #include <kernel/percpu.h>
 #include <kernel/sched.h>
 #include <kernel/stats.h>
@@ -32,6 +33,7 @@
 #include <kernel/vm.h>
 #include <platform.h>
 #include <target.h>
+#include <lib/counters.h>
 #include <lib/dpc.h>
 #include <lib/heap.h>
 #include <lib/ktrace.h>
@@ -51,6 +53,13 @@
 #define THREAD_INITIAL_TIME_SLICE LK_MSEC(50)
 #define THREAD_TICK_RATE          LK_MSEC(10)
 
+KCOUNTER(thread_context_switches, "kernel.thread.context_switches");
+
+/* cap on the number of retired thread_t + stack pairs each cpu may cache */
+#define THREAD_CACHE_MAX_THREADS 8
+
+static bool thread_cache_enabled;
+
 /* global thread list */
 static struct list_node thread_list = LIST_INITIAL_VALUE(thread_list);
 
@@ -67,6 +76,10 @@ static void init_thread_struct(thread_t *t, const char *name)
     memset(t, 0, sizeof(thread_t));
     t->magic = THREAD_MAGIC;
     thread_set_pinned_cpu(t, -1);
+    t->cpu_affinity = ~0u;
+    t->inherited_priority = -1;
+    t->user_inherited_priority = -1;
+    list_initialize(&t->owned_mutex_list);
     strlcpy(t->name, name, sizeof(t->name));
     wait_queue_init(&t->retcode_wait_queue);
 }
@@ -86,6 +99,68 @@ static void initial_thread_func(void)
     thread_exit(ret);
 }
 
+/* only default sized stacks are recycled; this is the size they were
+ * originally allocated with, including any debug padding */
+static size_t thread_cache_stack_size(void)
+{
+    size_t stack_size = DEFAULT_STACK_SIZE;
+#if THREAD_STACK_BOUNDS_CHECK
+    stack_size += THREAD_STACK_PADDING_SIZE;
+#endif
+    return stack_size;
+}
+
+/* pop a retired thread and its stack(s) off the local cpu's cache, interrupts
+ * disabled to keep us from migrating or being preempted mid update */
+static thread_t *thread_cache_pop(void)
+{
+    if (unlikely(!thread_cache_enabled))
+        return NULL;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    struct percpu *cpu = get_local_percpu();
+    thread_t *t = list_remove_head_type(&cpu->thread_cache, thread_t, queue_node);
+    if (t)
+        cpu->thread_cache_count--;
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return t;
+}
+
+/* push a retired thread onto the local cpu's cache, returning false if the
+ * cache is full or the thread's resources are not the common recyclable shape */
+static bool thread_cache_push(thread_t *t)
+{
+    if (unlikely(!thread_cache_enabled))
+        return false;
+
+    /* only cache the common case of a heap allocated struct with default
+     * sized heap allocated stack(s), so a pop satisfies any default create */
+    if ((t->flags & (THREAD_FLAG_FREE_STRUCT | THREAD_FLAG_FREE_STACK)) !=
+        (THREAD_FLAG_FREE_STRUCT | THREAD_FLAG_FREE_STACK))
+        return false;
+    if (!t->stack || t->stack_size != thread_cache_stack_size())
+        return false;
+
+    bool cached = false;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    struct percpu *cpu = get_local_percpu();
+    if (cpu->thread_cache_count < THREAD_CACHE_MAX_THREADS) {
+        t->magic = 0;
+        list_add_head(&cpu->thread_cache, &t->queue_node);
+        cpu->thread_cache_count++;
+        cached = true;
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return cached;
+}
+
 /**
  * @brief  Create a new thread
  *
@@ -124,11 +199,28 @@ thread_t *thread_create_etc(
         thread_trampoline_routine alt_trampoline)
 {
     unsigned int flags = 0;
+    void *cached_stack = NULL;
+#if __has_feature(safe_stack)
+    void *cached_unsafe_stack = NULL;
+#endif
 
     if (!t) {
-        t = malloc(sizeof(thread_t));
-        if (!t)
-            return NULL;
+        /* common case: recycle a retired thread struct and stack pair off
+         * the local cpu's cache instead of hitting the heap */
+        if (!stack && stack_size == DEFAULT_STACK_SIZE) {
+            t = thread_cache_pop();
+            if (t) {
+                cached_stack = t->stack;
+#if __has_feature(safe_stack)
+                cached_unsafe_stack = t->unsafe_stack;
+#endif
+            }
+        }
+        if (!t) {
+            t = malloc(sizeof(thread_t));
+            if (!t)
+                return NULL;
+        }
         flags |= THREAD_FLAG_FREE_STRUCT;
     }
 
@@ -154,7 +246,7 @@ thread_t *thread_create_etc(
         stack_size += THREAD_STACK_PADDING_SIZE;
         flags |= THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK;
 #endif
-        t->stack = malloc(stack_size);
+        t->stack = cached_stack ? cached_stack : malloc(stack_size);
         if (!t->stack) {
             if (flags & THREAD_FLAG_FREE_STRUCT)
                 free(t);
@@ -172,7 +264,7 @@ thread_t *thread_create_etc(
     if (!unsafe_stack) {
         DEBUG_ASSERT(!stack);
         DEBUG_ASSERT(flags & THREAD_FLAG_FREE_STACK);
-        t->unsafe_stack = malloc(stack_size);
+        t->unsafe_stack = cached_unsafe_stack ? cached_unsafe_stack : malloc(stack_size);
         if (!t->unsafe_stack) {
             free(t->stack);
             if (flags & THREAD_FLAG_FREE_STRUCT)
@@ -218,6 +310,11 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 
 static void free_thread_resources(thread_t *t)
 {
+    /* try to stash the thread and its stack(s) on the local cpu's cache so
+     * the next default sized thread_create is a pop instead of heap calls */
+    if (thread_cache_push(t))
+        return;
+
     /* free its stack and the thread structure itself */
     if (t->flags & THREAD_FLAG_FREE_STACK) {
         if (t->stack)
@@ -250,7 +347,8 @@ status_t thread_set_real_time(thread_t *t)
     THREAD_LOCK(state);
 #if PLATFORM_HAS_DYNAMIC_TIMER
     if (t == get_current_thread()) {
-        /* if we're currently running, cancel the preemption timer. */
+        /* if we're currently running, park the preemption timer. */
+        percpu[arch_curr_cpu_num()].preempt_timer_off = true;
         timer_cancel(&percpu[arch_curr_cpu_num()].preempt_timer);
     }
 #endif
@@ -260,6 +358,67 @@ status_t thread_set_real_time(thread_t *t)
     return NO_ERROR;
 }
 
+/**
+ * @brief Place a thread in (or remove it from) the deadline scheduling class
+ *
+ * The thread is promised @a capacity worth of cpu time out of every
+ * @a period, scheduled earliest-deadline-first ahead of the priority based
+ * classes.  Reservations are admission controlled; a request that would
+ * oversubscribe the online cpus fails with ERR_NO_RESOURCES.  Passing zero
+ * for both parameters returns the thread to the fair classes.
+ *
+ * @param t Thread to adjust
+ * @param capacity Reserved run time per period, in ns
+ * @param period Reservation period, in ns
+ *
+ * @return NO_ERROR on success
+ */
+status_t thread_set_deadline(thread_t *t, lk_time_t capacity, lk_time_t period)
+{
+    if (!t)
+        return ERR_INVALID_ARGS;
+
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    THREAD_LOCK(state);
+    status_t status = sched_set_deadline(t, capacity, period);
+    if (status == NO_ERROR && t == get_current_thread()) {
+        /* reschedule so the new class takes effect immediately */
+        sched_reschedule();
+    }
+    THREAD_UNLOCK(state);
+
+    return status;
+}
+
+/**
+ * @brief Restrict a thread to a set of cpus
+ *
+ * @param t Thread to adjust
+ * @param affinity Bitmask of cpus the thread may run on; must include at
+ * least one online cpu
+ *
+ * @return NO_ERROR on success
+ */
+status_t thread_set_cpu_affinity(thread_t *t, uint32_t affinity)
+{
+    if (!t)
+        return ERR_INVALID_ARGS;
+
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    THREAD_LOCK(state);
+    status_t status = sched_set_cpu_affinity(t, affinity);
+    if (status == NO_ERROR && t == get_current_thread() &&
+        (affinity & (1u << arch_curr_cpu_num())) == 0) {
+        /* we've just excluded our own cpu; reschedule to migrate away */
+        sched_reschedule();
+    }
+    THREAD_UNLOCK(state);
+
+    return status;
+}
+
 /**
  * @brief  Make a suspended thread executable.
  *
@@ -463,6 +622,11 @@ __NO_RETURN static void thread_exit_locked(thread_t *current_thread, int retcode
     current_thread->state = THREAD_DEATH;
     current_thread->retcode = retcode;
 
+    /* release any deadline class reservation so the utilization can be
+     * handed out to someone else */
+    if (unlikely(thread_is_deadline(current_thread)))
+        sched_set_deadline(current_thread, 0, 0);
+
     /* if we're detached, then do our teardown here */
     if (current_thread->flags & THREAD_FLAG_DETACHED) {
         /* remove it from the master thread list */
@@ -688,7 +852,7 @@ void thread_process_pending_signals(void)
 __NO_RETURN static int idle_thread_routine(void *arg)
 {
     for (;;)
-        arch_idle();
+        idle_enter();
 }
 
 // On ARM64 with safe-stack, it's no longer possible to use the unsafe-sp
@@ -701,6 +865,103 @@ __NO_SAFESTACK static void final_context_switch(thread_t *oldthread,
     arch_context_switch(oldthread, newthread);
 }
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* true when any ready thread is queued on |cpu| beyond the one running */
+static bool cpu_has_ready_threads(uint cpu)
+{
+    return percpu[cpu].run_queue_bitmap != 0 ||
+           !list_is_empty(&percpu[cpu].deadline_queue);
+}
+
+/* With a one-shot preemption timer there is no periodic tick to consume
+ * quanta, so elapsed run time is charged against the slice or budget in
+ * wall clock terms wherever the thread stops (or checkpoints) running. */
+static void charge_run_time(thread_t *t, lk_time_t ran)
+{
+    if (thread_is_real_time_or_idle(t))
+        return;
+
+    if (unlikely(thread_is_deadline(t))) {
+        sched_deadline_tick(t, ran);
+    } else {
+        t->remaining_time_slice -= MIN(ran, t->remaining_time_slice);
+    }
+}
+
+/* The one-shot preemption timer fired: the running thread's slice or
+ * budget is up.  Charge it here so the preemption path sees an exhausted
+ * quantum and rotates the thread to the tail of its queue. */
+static enum handler_return preempt_timer_expired(timer_t *timer, lk_time_t now, void *arg)
+{
+    thread_t *current_thread = get_current_thread();
+
+    if (thread_is_real_time_or_idle(current_thread))
+        return INT_NO_RESCHEDULE;
+
+    lk_time_t ran = now - current_thread->last_started_running;
+    current_thread->runtime_ns += ran;
+    current_thread->last_started_running = now;
+
+    charge_run_time(current_thread, ran);
+
+    ktrace_probe2("preempt_expired", (uint32_t)current_thread->user_tid,
+                  current_thread->remaining_time_slice);
+
+    return INT_RESCHEDULE;
+}
+
+/* Program the preemption timer for the next instant a scheduling decision
+ * is due for |t|, which just became (or stays) the running thread:
+ *
+ *  - never for real time or idle threads, which run untimed
+ *  - budget exhaustion for deadline class threads
+ *  - slice exhaustion for fair threads with competition on their cpu
+ *
+ * A fair thread that is alone on its cpu leaves the timer parked and the
+ * cpu runs tick-free; thread_kick_preempt_timer() restarts the clock the
+ * moment another thread joins the run queue. */
+static void arm_preempt_timer(thread_t *t, uint cpu, lk_time_t now)
+{
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    lk_time_t delay;
+    if (unlikely(thread_is_deadline(t))) {
+        delay = t->deadline_budget;
+    } else if (thread_is_real_time_or_idle(t) || !cpu_has_ready_threads(cpu)) {
+        if (!percpu[cpu].preempt_timer_off) {
+            percpu[cpu].preempt_timer_off = true;
+            timer_cancel(&percpu[cpu].preempt_timer);
+        }
+        return;
+    } else {
+        delay = t->remaining_time_slice;
+    }
+
+    percpu[cpu].preempt_timer_off = false;
+    timer_cancel(&percpu[cpu].preempt_timer);
+    timer_set_oneshot(&percpu[cpu].preempt_timer, now + delay,
+                      preempt_timer_expired, NULL);
+}
+
+void thread_kick_preempt_timer(uint cpu)
+{
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (likely(!percpu[cpu].preempt_timer_off))
+        return;
+
+    if (cpu == arch_curr_cpu_num()) {
+        thread_t *current_thread = get_current_thread();
+        if (!thread_is_real_time_or_idle(current_thread))
+            arm_preempt_timer(current_thread, cpu, current_time());
+    } else {
+        /* push the remote cpu through a reschedule, which re-arms
+         * (realtime cpus are filtered out by mp_reschedule itself) */
+        mp_reschedule(1u << cpu, 0);
+    }
+}
+#endif
+
 /**
  * @brief  Cause another thread to be executed.
  *
@@ -733,13 +994,57 @@ void _thread_resched_internal(void)
     thread_t *oldthread = current_thread;
 
     /* if it's the same thread as we're already running, exit */
-    if (newthread == oldthread)
+    if (newthread == oldthread) {
+#if PLATFORM_HAS_DYNAMIC_TIMER
+        /* no switch, but the quantum clock still has to move: charge what
+         * ran so far, hand out a fresh slice if it is spent and re-arm
+         * (or park) the one-shot preemption timer */
+        if (!thread_is_real_time_or_idle(oldthread)) {
+            lk_time_t now = current_time();
+            lk_time_t ran = now - oldthread->last_started_running;
+            oldthread->runtime_ns += ran;
+            oldthread->last_started_running = now;
+            charge_run_time(oldthread, ran);
+            if (oldthread->remaining_time_slice == 0)
+                oldthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
+            arm_preempt_timer(oldthread, cpu, now);
+        }
+#endif
         return;
+    }
 
     lk_time_t now = current_time();
-    oldthread->runtime_ns += now - oldthread->last_started_running;
+    lk_time_t ran = now - oldthread->last_started_running;
+    oldthread->runtime_ns += ran;
     newthread->last_started_running = now;
 
+    /* record how long the incoming thread sat runnable before getting the
+     * cpu: a per-cpu histogram for the system-wide view, per-thread totals
+     * for MX_INFO_THREAD_STATS, and a ktrace probe for offline analysis */
+    if (likely(!thread_is_idle(newthread))) {
+        lk_time_t queued = now - newthread->last_ready_time;
+        newthread->queued_time_ns += queued;
+        if (queued > newthread->queued_time_max)
+            newthread->queued_time_max = queued;
+
+        uint64_t queued_us = queued / 1000u;
+        uint bucket = 0;
+        if (queued_us > 0)
+            bucket = 64 - __builtin_clzll(queued_us);
+        if (bucket >= SCHED_LATENCY_HIST_BUCKETS)
+            bucket = SCHED_LATENCY_HIST_BUCKETS - 1;
+        percpu[cpu].stats.sched_latency_hist[bucket]++;
+
+        ktrace_probe2("sched_latency", (uint32_t)newthread->user_tid,
+                      (queued_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)queued_us);
+    }
+
+#if PLATFORM_HAS_DYNAMIC_TIMER
+    /* charge the outgoing thread for its run, including partial quanta a
+     * periodic tick would have missed */
+    charge_run_time(oldthread, ran);
+#endif
+
     /* set up quantum for the new thread if it was consumed */
     if (newthread->remaining_time_slice == 0) {
         newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
@@ -762,6 +1067,7 @@ void _thread_resched_internal(void)
     }
 
     CPU_STATS_INC(context_switches);
+    kcounter_add(&thread_context_switches, 1);
 
     if (thread_is_idle(oldthread)) {
         percpu[cpu].stats.idle_time += now - oldthread->last_started_running;
@@ -771,21 +1077,9 @@ void _thread_resched_internal(void)
            (uint32_t)(uintptr_t)oldthread, (uint32_t)(uintptr_t)newthread);
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-    if (thread_is_real_time_or_idle(newthread)) {
-        if (!thread_is_real_time_or_idle(oldthread)) {
-            /* if we're switching from a non real time to a real time, cancel
-             * the preemption timer. */
-            TRACE_CONTEXT_SWITCH("stop preempt, cpu %u, old %p (%s), new %p (%s)\n",
-                    cpu, oldthread, oldthread->name, newthread, newthread->name);
-            timer_cancel(&percpu[cpu].preempt_timer);
-        }
-    } else if (thread_is_real_time_or_idle(oldthread)) {
-        /* if we're switching from a real time (or idle thread) to a regular one,
-         * set up a periodic timer to run our preemption tick. */
-        TRACE_CONTEXT_SWITCH("start preempt, cpu %u, old %p (%s), new %p (%s)\n",
-                cpu, oldthread, oldthread->name, newthread, newthread->name);
-        timer_set_periodic(&percpu[cpu].preempt_timer, THREAD_TICK_RATE, (timer_callback)thread_timer_tick, NULL);
-    }
+    /* time the incoming thread's slice or budget with a one-shot timer,
+     * or park the timer entirely if it runs untimed */
+    arm_preempt_timer(newthread, cpu, now);
 #endif
 
     /* set some optional target debug leds */
@@ -912,6 +1206,13 @@ enum handler_return thread_timer_tick(void)
     if (thread_is_real_time_or_idle(current_thread))
         return INT_NO_RESCHEDULE;
 
+    /* deadline class threads consume budget rather than a time slice */
+    if (unlikely(thread_is_deadline(current_thread))) {
+        if (sched_deadline_tick(current_thread, THREAD_TICK_RATE))
+            return INT_RESCHEDULE;
+        return INT_NO_RESCHEDULE;
+    }
+
     current_thread->remaining_time_slice -= MIN(THREAD_TICK_RATE, current_thread->remaining_time_slice);
 
     ktrace_probe2("timer_tick", (uint32_t)current_thread->user_tid, current_thread->remaining_time_slice);
@@ -1040,6 +1341,30 @@ lk_time_t thread_runtime(const thread_t *t)
     return runtime;
 }
 
+/**
+ * @brief Return the number of nanoseconds a thread has spent READY waiting
+ * for a cpu.
+ *
+ * If the thread is READY right now the current wait is included.  If
+ * max_out is non-NULL it receives the longest single wait observed so far.
+ */
+lk_time_t thread_queued_time(const thread_t *t, lk_time_t *max_out)
+{
+    THREAD_LOCK(state);
+
+    lk_time_t queued = t->queued_time_ns;
+    if (t->state == THREAD_READY) {
+        queued += current_time() - t->last_ready_time;
+    }
+    if (max_out) {
+        *max_out = t->queued_time_max;
+    }
+
+    THREAD_UNLOCK(state);
+
+    return queued;
+}
+
 /**
  * @brief Construct a thread t around the current running state
  *
@@ -1099,6 +1424,10 @@ void thread_init(void)
         timer_initialize(&percpu[i].preempt_timer);
     }
 #endif
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        list_initialize(&percpu[i].thread_cache);
+    }
+    thread_cache_enabled = true;
 }
 
 /**
@@ -1290,13 +1619,19 @@ void dump_thread(thread_t *t, bool full_dump)
         dprintf(INFO, "\truntime_ns %" PRIu64 ", runtime_s %" PRIu64 "\n",
                 runtime, runtime / 1000000000);
         dprintf(INFO, "\tstack %p, stack_size %zu\n", t->stack, t->stack_size);
-        dprintf(INFO, "\tentry %p, arg %p, flags 0x%x %s%s%s%s%s%s\n", t->entry, t->arg, t->flags,
+        dprintf(INFO, "\tentry %p, arg %p, flags 0x%x %s%s%s%s%s%s%s\n", t->entry, t->arg, t->flags,
                 (t->flags & THREAD_FLAG_DETACHED) ? "Dt" :"",
                 (t->flags & THREAD_FLAG_FREE_STACK) ? "Fs" :"",
                 (t->flags & THREAD_FLAG_FREE_STRUCT) ? "Ft" :"",
                 (t->flags & THREAD_FLAG_REAL_TIME) ? "Rt" :"",
                 (t->flags & THREAD_FLAG_IDLE) ? "Id" :"",
-                (t->flags & THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK) ? "Sc" :"");
+                (t->flags & THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK) ? "Sc" :"",
+                (t->flags & THREAD_FLAG_DEADLINE) ? "Dl" :"");
+        if (t->flags & THREAD_FLAG_DEADLINE) {
+            dprintf(INFO, "\tdeadline capacity %" PRIu64 ", period %" PRIu64 ", "
+                    "abs %" PRIu64 ", budget %" PRIu64 "\n",
+                    t->deadline_capacity, t->deadline_period, t->deadline_abs, t->deadline_budget);
+        }
         dprintf(INFO, "\twait queue %p, blocked_status %d, interruptable %d\n",
                 t->blocking_wait_queue, t->blocked_status, t->interruptable);
         dprintf(INFO, "\taspace %p\n", t->aspace);
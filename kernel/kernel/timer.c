@@ -17,6 +17,11 @@
  *
  * Timer callback functions are called in interrupt context.
  *
+ * Timers are held in a per cpu intrusive pairing heap keyed on the
+ * scheduled time: insertion and peeking at the earliest deadline are O(1),
+ * cancellation and expiry are O(log n) amortized, independent of how many
+ * timers are outstanding.
+ *
  * @{
  */
 #include <assert.h>
@@ -47,33 +52,100 @@ void timer_initialize(timer_t *timer)
     *timer = (timer_t)TIMER_INITIAL_VALUE(*timer);
 }
 
-static void insert_timer_in_queue(uint cpu, timer_t *timer)
+/* pairing heap primitives. all protected by the timer lock. */
+
+/* meld two heaps; the earlier deadline becomes the parent */
+static timer_t *heap_meld(timer_t *a, timer_t *b)
 {
-    timer_t *entry;
+    if (TIME_GT(a->scheduled_time, b->scheduled_time)) {
+        timer_t *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    DEBUG_ASSERT(!list_in_list(&b->node));
+    list_add_head(&a->child_list, &b->node);
+    return a;
+}
+
+/* detach and meld all the children of a node, two pass pairing style,
+ * returning the resulting heap (or NULL if there were no children) */
+static timer_t *heap_merge_children(timer_t *t)
+{
+    struct list_node pairs = LIST_INITIAL_VALUE(pairs);
+
+    /* first pass: meld adjacent pairs of children */
+    timer_t *a;
+    while ((a = list_remove_head_type(&t->child_list, timer_t, node))) {
+        timer_t *b = list_remove_head_type(&t->child_list, timer_t, node);
+        timer_t *pair = b ? heap_meld(a, b) : a;
+        list_add_head(&pairs, &pair->node);
+    }
+
+    /* second pass: fold the pairs together */
+    timer_t *result = NULL;
+    while ((a = list_remove_head_type(&pairs, timer_t, node))) {
+        result = result ? heap_meld(result, a) : a;
+    }
+    return result;
+}
 
+static void insert_timer_in_queue(uint cpu, timer_t *timer)
+{
     DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(timer->queued_cpu < 0);
+    DEBUG_ASSERT(!list_in_list(&timer->node));
 
     LTRACEF("timer %p, cpu %u, scheduled %" PRIu64 ", periodic %" PRIu64 "\n", timer, cpu, timer->scheduled_time, timer->period);
 
-    list_for_every_entry(&percpu[cpu].timer_queue, entry, timer_t, node) {
-        if (TIME_GT(entry->scheduled_time, timer->scheduled_time)) {
-            list_add_before(&entry->node, &timer->node);
-            return;
-        }
+    timer_t *root = percpu[cpu].timer_root;
+    percpu[cpu].timer_root = root ? heap_meld(root, timer) : timer;
+    timer->queued_cpu = (int)cpu;
+}
+
+/* remove an arbitrary timer from whichever cpu's heap it is queued on */
+static void remove_timer_from_queue(timer_t *timer)
+{
+    DEBUG_ASSERT(timer->queued_cpu >= 0);
+
+    uint cpu = (uint)timer->queued_cpu;
+
+    if (percpu[cpu].timer_root == timer) {
+        percpu[cpu].timer_root = heap_merge_children(timer);
+    } else {
+        /* unlink the subtree from its parent's child list, then hand the
+         * orphaned children back to the heap */
+        list_delete(&timer->node);
+        timer_t *orphans = heap_merge_children(timer);
+        if (orphans)
+            percpu[cpu].timer_root = heap_meld(percpu[cpu].timer_root, orphans);
     }
 
-    /* walked off the end of the list */
-    list_add_tail(&percpu[cpu].timer_queue, &timer->node);
+    timer->queued_cpu = -1;
+}
+
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* program the hardware timer for this cpu's earliest deadline, padded by
+ * that timer's slack so deadline-tolerant timers can coalesce */
+static void update_platform_timer(uint cpu)
+{
+    timer_t *head = percpu[cpu].timer_root;
+    if (head) {
+        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", head->scheduled_time);
+        platform_set_oneshot_timer(timer_tick, NULL, head->scheduled_time + head->slack);
+    }
 }
+#endif
 
-static void timer_set(timer_t *timer, lk_time_t deadline, lk_time_t period, timer_callback callback, void *arg)
+static void timer_set(timer_t *timer, lk_time_t deadline, lk_time_t slack, lk_time_t period,
+                      timer_callback callback, void *arg)
 {
     LTRACEF("timer %p, deadline %" PRIu64 ", period %" PRIu64 ", callback %p, arg %p\n", timer, deadline, period, callback, arg);
 
     DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
 
-    if (list_in_list(&timer->node)) {
-        panic("timer %p already in list\n", timer);
+    if (timer->queued_cpu >= 0) {
+        panic("timer %p already queued\n", timer);
     }
 
     spin_lock_saved_state_t state;
@@ -91,6 +163,7 @@ static void timer_set(timer_t *timer, lk_time_t deadline, lk_time_t period, time
 
     /* set up the structure */
     timer->scheduled_time = deadline;
+    timer->slack = slack;
     timer->period = period;
     timer->callback = callback;
     timer->arg = arg;
@@ -102,10 +175,9 @@ static void timer_set(timer_t *timer, lk_time_t deadline, lk_time_t period, time
     insert_timer_in_queue(cpu, timer);
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-    if (list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node) == timer) {
-        /* we just modified the head of the timer queue */
-        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", deadline);
-        platform_set_oneshot_timer(timer_tick, NULL, deadline);
+    if (percpu[cpu].timer_root == timer) {
+        /* we just became the head of the timer queue */
+        update_platform_timer(cpu);
     }
 #endif
 
@@ -129,7 +201,21 @@ out:
  */
 void timer_set_oneshot(timer_t *timer, lk_time_t deadline, timer_callback callback, void *arg)
 {
-    timer_set(timer, deadline, 0, callback, arg);
+    timer_set(timer, deadline, 0, 0, callback, arg);
+}
+
+/**
+ * @brief  Set up a timer that executes once, with a firing tolerance
+ *
+ * As timer_set_oneshot, but the callback may run up to slack ns past the
+ * deadline. The hardware timer is programmed at the padded deadline, so
+ * timers with tolerance piggyback on other interrupts that arrive first
+ * instead of generating their own.
+ */
+void timer_set_oneshot_slack(timer_t *timer, lk_time_t deadline, lk_time_t slack,
+                             timer_callback callback, void *arg)
+{
+    timer_set(timer, deadline, slack, 0, callback, arg);
 }
 
 /**
@@ -150,7 +236,7 @@ void timer_set_periodic(timer_t *timer, lk_time_t period, timer_callback callbac
 {
     if (period == 0)
         period = 1;
-    timer_set(timer, current_time() + period, period, callback, arg);
+    timer_set(timer, current_time() + period, 0, period, callback, arg);
 }
 
 /**
@@ -191,27 +277,26 @@ bool timer_cancel(timer_t *timer)
 
     bool callback_not_running;
 
-    /* if the timer is in a queue, remove it and adjust hardware timers if needed */
-    if (list_in_list(&timer->node)) {
+    /* if the timer is queued, remove it and adjust hardware timers if needed */
+    if (timer->queued_cpu >= 0) {
         callback_not_running = true;
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-        timer_t *oldhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer_t *oldhead = percpu[cpu].timer_root;
 #endif
 
-        /* remove it from the queue */
-        list_delete(&timer->node);
+        /* remove it from whichever heap it's in */
+        remove_timer_from_queue(timer);
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
         /* see if we've just modified the head of this cpu's timer queue */
         /* if we modified another cpu's queue, we'll just let it fire and sort itself out */
-        timer_t *newhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer_t *newhead = percpu[cpu].timer_root;
         if (newhead == NULL) {
             LTRACEF("clearing old hw timer, nothing in the queue\n");
             platform_stop_timer();
         } else if (newhead != oldhead) {
-            LTRACEF("setting new timer to %" PRIu64 "\n", newhead->scheduled_time);
-            platform_set_oneshot_timer(timer_tick, NULL, newhead->scheduled_time);
+            update_platform_timer(cpu);
         }
 #endif
     } else {
@@ -251,7 +336,7 @@ static enum handler_return timer_tick(void *arg, lk_time_t now)
 
     for (;;) {
         /* see if there's an event to process */
-        timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer = percpu[cpu].timer_root;
         if (likely(timer == 0))
             break;
         LTRACEF("next item on timer queue %p at %" PRIu64 " now %" PRIu64 " (%p, arg %p)\n", timer, timer->scheduled_time, now, timer->callback, timer->arg);
@@ -263,13 +348,13 @@ static enum handler_return timer_tick(void *arg, lk_time_t now)
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                 "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                 timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        remove_timer_from_queue(timer);
 
         /* mark the timer busy */
         timer->active_cpu = cpu;
         /* spinlock below acts as a memory barrier */
 
-        /* we pulled it off the list, release the list lock to handle it */
+        /* we pulled it off the heap, release the lock to handle it */
         spin_unlock(&timer_lock);
 
         LTRACEF("dequeued timer %p, scheduled %" PRIu64 " periodic %" PRIu64 "\n", timer, timer->scheduled_time, timer->period);
@@ -297,9 +382,9 @@ static enum handler_return timer_tick(void *arg, lk_time_t now)
         /* if we've been cancelled, it's not okay to touch the timer structure from now on out */
         if (!cancelled) {
             /* if it is a periodic timer and it hasn't been requeued
-             * by the callback put it back in the list
+             * by the callback put it back in the heap
              */
-            if (timer->period > 0 && !list_in_list(&timer->node)) {
+            if (timer->period > 0 && timer->queued_cpu < 0) {
                 LTRACEF("periodic timer, period %" PRIu64 "\n", timer->period);
                 timer->scheduled_time = now + timer->period;
                 insert_timer_in_queue(cpu, timer);
@@ -309,14 +394,12 @@ static enum handler_return timer_tick(void *arg, lk_time_t now)
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
     /* reset the timer to the next event */
-    timer = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer = percpu[cpu].timer_root;
     if (timer) {
         /* has to be the case or it would have fired already */
         DEBUG_ASSERT(TIME_GT(timer->scheduled_time, now));
 
-        LTRACEF("setting new timer for %" PRIu64 " nsecs for event %p\n", timer->scheduled_time,
-                timer);
-        platform_set_oneshot_timer(timer_tick, NULL, timer->scheduled_time);
+        update_platform_timer(cpu);
     }
 
     /* we're done manipulating the timer queue */
@@ -358,21 +441,20 @@ void timer_transition_off_cpu(uint old_cpu)
     spin_lock_irqsave(&timer_lock, state);
     uint cpu = arch_curr_cpu_num();
 
-    timer_t *old_head = list_peek_head_type(&percpu[old_cpu].timer_queue, timer_t, node);
+    timer_t *old_head = percpu[cpu].timer_root;
 
-    timer_t *entry = NULL, *tmp_entry = NULL;
     /* Move all timers from old_cpu to this cpu */
-    list_for_every_entry_safe(&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
-        list_delete(&entry->node);
+    timer_t *entry;
+    while ((entry = percpu[old_cpu].timer_root)) {
+        remove_timer_from_queue(entry);
         insert_timer_in_queue(cpu, entry);
     }
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
-    timer_t *new_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    timer_t *new_head = percpu[cpu].timer_root;
     if (new_head != NULL && new_head != old_head) {
         /* we just modified the head of the timer queue */
-        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", new_head->scheduled_time);
-        platform_set_oneshot_timer(timer_tick, NULL, new_head->scheduled_time);
+        update_platform_timer(cpu);
     }
 #endif
 
@@ -388,22 +470,32 @@ void timer_thaw_percpu(void)
     spin_lock(&timer_lock);
 
     uint cpu = arch_curr_cpu_num();
-
-    timer_t *t = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
-    if (t) {
-        LTRACEF("rescheduling timer for %" PRIu64 " nsecs\n", t->scheduled_time);
-        platform_set_oneshot_timer(timer_tick, NULL, t->scheduled_time);
+    if (percpu[cpu].timer_root) {
+        LTRACEF("rescheduling timer for %" PRIu64 " nsecs\n", percpu[cpu].timer_root->scheduled_time);
+        update_platform_timer(cpu);
     }
 
     spin_unlock(&timer_lock);
 #endif
 }
 
+lk_time_t timer_earliest_deadline(void)
+{
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&timer_lock, state);
+
+    timer_t *head = percpu[arch_curr_cpu_num()].timer_root;
+    lk_time_t deadline = head ? head->scheduled_time : INFINITE_TIME;
+
+    spin_unlock_irqrestore(&timer_lock, state);
+    return deadline;
+}
+
 void timer_init(void)
 {
     timer_lock = SPIN_LOCK_INITIAL_VALUE;
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
-        list_initialize(&percpu[i].timer_queue);
+        percpu[i].timer_root = NULL;
     }
 #if !PLATFORM_HAS_DYNAMIC_TIMER
     #warning "Platform does not have dynamic timer. Timer has 10ms resolution"
@@ -7,15 +7,23 @@
 
 #include <kernel/vm/pmm.h>
 
+#include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
 #include <kernel/auto_lock.h>
+#include <kernel/cmdline.h>
+#include <kernel/event.h>
 #include <kernel/mp.h>
 #include <kernel/mutex.h>
+#include <kernel/numa.h>
+#include <kernel/percpu.h>
+#include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <kernel/vm.h>
+#include <kernel/vm/vm_object_paged.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <list.h>
 #include <lk/init.h>
 #include <pow2.h>
@@ -32,11 +40,262 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(pmm_alloc_pages_count, "kernel.pmm.alloc_pages");
+KCOUNTER(pmm_free_pages_count, "kernel.pmm.free_pages");
+
 // the main arena list
 static Mutex arena_lock;
 static mxtl::DoublyLinkedList<PmmArena*> arena_list TA_GUARDED(arena_lock);
 static size_t arena_cumulative_size TA_GUARDED(arena_lock);
 
+// Per-cpu cache of free pages fronting the arenas. Single page allocs and
+// frees are served out of the local cpu's cache without taking the arena
+// lock; misses refill in bulk and overflows drain back through pmm_free().
+// Cached pages are always taken from KMAP arenas, so a cache hit satisfies
+// both flagless and PMM_ALLOC_FLAG_KMAP allocations, and they stay in the
+// allocated state from the arena's point of view.
+#define PAGE_CACHE_MAX_PAGES 64
+#define PAGE_CACHE_FILL_PAGES 16
+
+static bool page_cache_enabled;
+
+static void pmm_page_cache_init(uint level) {
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        list_initialize(&percpu[i].page_cache);
+    }
+    page_cache_enabled = true;
+}
+LK_INIT_HOOK(pmm_page_cache, pmm_page_cache_init, LK_INIT_LEVEL_VM);
+
+// pop a page off the local cpu's cache, interrupts disabled to keep us from
+// migrating or being preempted mid update
+static vm_page_t* page_cache_pop() {
+    if (unlikely(!page_cache_enabled))
+        return nullptr;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    struct percpu* cpu = get_local_percpu();
+    vm_page_t* page = list_remove_head_type(&cpu->page_cache, vm_page_t, free.node);
+    if (page)
+        cpu->page_cache_count--;
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return page;
+}
+
+// push a page onto the local cpu's cache, returning false if it's full
+static bool page_cache_push(vm_page_t* page) {
+    if (unlikely(!page_cache_enabled))
+        return false;
+
+    bool cached = false;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    struct percpu* cpu = get_local_percpu();
+    if (cpu->page_cache_count < PAGE_CACHE_MAX_PAGES) {
+        list_add_head(&cpu->page_cache, &page->free.node);
+        cpu->page_cache_count++;
+        cached = true;
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return cached;
+}
+
+// stash a bulk refill of pages in the local cpu's cache
+static void page_cache_fill(struct list_node* pages) {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    struct percpu* cpu = get_local_percpu();
+    struct list_node* node;
+    while (cpu->page_cache_count < PAGE_CACHE_MAX_PAGES &&
+           (node = list_remove_head(pages))) {
+        list_add_head(&cpu->page_cache, node);
+        cpu->page_cache_count++;
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
+// Pool of pre-zeroed pages fronting the arenas for PMM_ALLOC_FLAG_ZERO
+// allocations. A low priority scrubber thread pulls free pages, zeroes
+// them off the fault path and parks them here; when the pool runs dry the
+// allocation takes the normal path and zeroes inline, so the flag always
+// returns a clean page.
+#define ZERO_POOL_TARGET_PAGES 512u
+#define ZERO_POOL_LOW_WATER (ZERO_POOL_TARGET_PAGES / 4u)
+
+static spin_lock_t zero_pool_lock = SPIN_LOCK_INITIAL_VALUE;
+static struct list_node zero_pool TA_GUARDED(zero_pool_lock) = LIST_INITIAL_VALUE(zero_pool);
+static size_t zero_pool_count TA_GUARDED(zero_pool_lock);
+static event_t zero_scrub_event =
+    EVENT_INITIAL_VALUE(zero_scrub_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+static vm_page_t* zero_pool_pop() {
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&zero_pool_lock, state);
+
+    vm_page_t* page = list_remove_head_type(&zero_pool, vm_page_t, free.node);
+    bool wake_scrubber = false;
+    if (page) {
+        zero_pool_count--;
+        wake_scrubber = (zero_pool_count == ZERO_POOL_LOW_WATER);
+    }
+
+    spin_unlock_irqrestore(&zero_pool_lock, state);
+
+    if (wake_scrubber)
+        event_signal(&zero_scrub_event, false);
+    return page;
+}
+
+static int zero_scrub_thread(void* arg) {
+    for (;;) {
+        event_wait(&zero_scrub_event);
+
+        for (;;) {
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(&zero_pool_lock, state);
+            bool full = (zero_pool_count >= ZERO_POOL_TARGET_PAGES);
+            spin_unlock_irqrestore(&zero_pool_lock, state);
+            if (full)
+                break;
+
+            paddr_t pa;
+            vm_page_t* page = pmm_alloc_page(0, &pa);
+            if (!page) {
+                /* memory is tight; don't compete with real allocations */
+                break;
+            }
+            arch_zero_page(paddr_to_kvaddr(pa));
+
+            spin_lock_irqsave(&zero_pool_lock, state);
+            list_add_head(&zero_pool, &page->free.node);
+            zero_pool_count++;
+            spin_unlock_irqrestore(&zero_pool_lock, state);
+        }
+    }
+    return 0;
+}
+
+static void pmm_zero_scrub_init(uint level) {
+    thread_t* t = thread_create("pmm-zero-scrub", zero_scrub_thread, nullptr, LOW_PRIORITY,
+                                DEFAULT_STACK_SIZE);
+    if (t)
+        thread_resume(t);
+
+    /* prime the pool */
+    event_signal(&zero_scrub_event, false);
+}
+LK_INIT_HOOK_PARALLEL(pmm_zero_scrub, pmm_zero_scrub_init, LK_INIT_LEVEL_THREADING);
+
+// Reserved contiguous region fronting the arenas for pmm_alloc_contiguous.
+// A single run of pages, sized by kernel.pmm.contig-reserve-mb, is carved
+// out of a KMAP arena at boot while memory is still unfragmented; the
+// owning arena keeps counting them as allocated, so ordinary (movable)
+// page allocations can never land in the region and fragment it.
+// Contiguous requests are served from the reserve with a short first-fit
+// scan over its page states and fall back to the arenas when it cannot
+// satisfy them; frees route reserve pages back here instead of to the
+// arena free list.
+static paddr_t contig_reserve_base TA_GUARDED(arena_lock);
+static vm_page_t* contig_reserve_pages TA_GUARDED(arena_lock);
+static size_t contig_reserve_count TA_GUARDED(arena_lock);
+static size_t contig_reserve_free TA_GUARDED(arena_lock);
+
+static bool contig_reserve_owns(const vm_page_t* page) TA_REQ(arena_lock) {
+    return (contig_reserve_count > 0) &&
+           (page >= contig_reserve_pages) &&
+           (page < contig_reserve_pages + contig_reserve_count);
+}
+
+static size_t contig_reserve_alloc_locked(size_t count, uint8_t alignment_log2, paddr_t* pa,
+                                          struct list_node* list) TA_REQ(arena_lock) {
+    if (count > contig_reserve_free)
+        return 0;
+
+    const paddr_t top = contig_reserve_base + contig_reserve_count * PAGE_SIZE;
+    paddr_t candidate = ROUNDUP(contig_reserve_base, 1UL << alignment_log2);
+    while (candidate + count * PAGE_SIZE <= top) {
+        size_t i;
+        for (i = 0; i < count; i++) {
+            size_t index = (candidate - contig_reserve_base) / PAGE_SIZE + i;
+            if (!page_is_free(&contig_reserve_pages[index]))
+                break;
+        }
+        if (i == count) {
+            for (i = 0; i < count; i++) {
+                size_t index = (candidate - contig_reserve_base) / PAGE_SIZE + i;
+                vm_page_t* page = &contig_reserve_pages[index];
+                page->state = VM_PAGE_STATE_ALLOC;
+                if (list)
+                    list_add_tail(list, &page->free.node);
+            }
+            contig_reserve_free -= count;
+            if (pa)
+                *pa = candidate;
+            return count;
+        }
+        /* restart past the used page that ended the run */
+        candidate = ROUNDUP(candidate + (i + 1) * PAGE_SIZE, 1UL << alignment_log2);
+    }
+    return 0;
+}
+
+static void pmm_contig_reserve_init(uint level) {
+    uint64_t mb = cmdline_get_uint64("kernel.pmm.contig-reserve-mb", 0u);
+    if (mb == 0)
+        return;
+
+    size_t count = (mb * MB) / PAGE_SIZE;
+    struct list_node list = LIST_INITIAL_VALUE(list);
+    paddr_t pa;
+    // reserve out of a KMAP arena so the region can serve KMAP requests too
+    if (pmm_alloc_contiguous(count, PMM_ALLOC_FLAG_KMAP, PAGE_SIZE_SHIFT, &pa, &list) != count) {
+        printf("PMM: failed to reserve %" PRIu64 " MB contiguous region\n", mb);
+        return;
+    }
+
+    AutoLock al(&arena_lock);
+    contig_reserve_base = pa;
+    contig_reserve_pages = paddr_to_vm_page(pa);
+    DEBUG_ASSERT(contig_reserve_pages);
+    vm_page_t* page;
+    while ((page = list_remove_head_type(&list, vm_page_t, free.node))) {
+        page->state = VM_PAGE_STATE_FREE;
+    }
+    // a single arena satisfied the run, so the page structures are contiguous
+    DEBUG_ASSERT(paddr_to_vm_page(pa + (count - 1) * PAGE_SIZE) ==
+                 contig_reserve_pages + count - 1);
+    contig_reserve_count = count;
+    contig_reserve_free = count;
+    printf("PMM: reserved %" PRIu64 " MB contiguous region at %#" PRIxPTR "\n", mb, pa);
+}
+LK_INIT_HOOK(pmm_contig_reserve, pmm_contig_reserve_init, LK_INIT_LEVEL_VM);
+
+// A page is eligible for the local cpu's cache if it comes from a KMAP
+// arena on this cpu's numa node; caching remote pages would hand them back
+// out to later local allocations and defeat the node preference.
+// No lock analysis needed; arena membership, flags and node are set during
+// system initialization.
+static bool page_cacheable_here(const vm_page_t* page) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // contiguous reserve pages must flow back to the reserve via pmm_free()
+    if (contig_reserve_owns(page))
+        return false;
+
+    const uint local_node = numa_cpu_node(arch_curr_cpu_num());
+    for (const auto& a : arena_list) {
+        if (a.page_belongs_to_arena(page))
+            return (a.flags() & PMM_ARENA_FLAG_KMAP) != 0 && a.node() == local_node;
+    }
+    return false;
+}
+
 #if PMM_ENABLE_FREE_FILL
 static void pmm_enforce_fill(uint level) {
     for (auto& a : arena_list) {
@@ -107,21 +366,126 @@ done_add:
     return NO_ERROR;
 }
 
-vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+void pmm_set_node(paddr_t base, size_t size, uint node) {
+    LTRACEF("base %#" PRIxPTR " size %#zx node %u\n", base, size, node);
+
+    DEBUG_ASSERT(node < NUMA_MAX_NODES);
+
     AutoLock al(&arena_lock);
 
-    /* walk the arenas in order until we find one with a free page */
+    // arenas straddling a node boundary keep the node of their base address
     for (auto& a : arena_list) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
+        if (a.base() >= base && a.base() - base < size)
+            a.set_node(node);
+    }
+}
+
+static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock);
+
+// Threshold, as a divisor of total memory, below which the slow allocation
+// paths kick the vmo evictor to reclaim MX_VMO_OP_DONT_NEED hinted pages.
+#define EVICTOR_KICK_DIVISOR 32u
+
+static void check_free_memory_locked() TA_REQ(arena_lock) {
+    if (unlikely(pmm_count_free_pages_locked() <
+                 arena_cumulative_size / PAGE_SIZE / EVICTOR_KICK_DIVISOR))
+        vmo_evictor_kick();
+}
+
+vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
+    if (alloc_flags & PMM_ALLOC_FLAG_ZERO) {
+        vm_page_t* zeroed = zero_pool_pop();
+        if (likely(zeroed)) {
+            *pa = vm_page_to_paddr(zeroed);
+            kcounter_add(&pmm_alloc_pages_count, 1);
+            return zeroed;
         }
 
-        // try to allocate the page out of the arena
-        vm_page_t* page = a.AllocPage(pa);
-        if (page)
+        /* pool is empty; take the normal path and scrub inline */
+        zeroed = pmm_alloc_page(alloc_flags & ~PMM_ALLOC_FLAG_ZERO, pa);
+        if (zeroed)
+            arch_zero_page(paddr_to_kvaddr(*pa));
+        event_signal(&zero_scrub_event, false);
+        return zeroed;
+    }
+
+    /* fast path: serve the allocation out of the local cpu's cache */
+    vm_page_t* page = page_cache_pop();
+    if (likely(page)) {
+        *pa = vm_page_to_paddr(page);
+        kcounter_add(&pmm_alloc_pages_count, 1);
+        return page;
+    }
+
+    AutoLock al(&arena_lock);
+
+    /* hitting the arenas means the cpu caches are dry; if overall free
+     * memory is low as well, get the evictor reclaiming in the background */
+    check_free_memory_locked();
+
+    /* prefer arenas on the local cpu's numa node, falling back to the rest */
+    const uint local_node = numa_cpu_node(arch_curr_cpu_num());
+
+    /* cache miss; refill the cache in bulk from the KMAP arenas while we
+     * hold the lock, keeping one page for the caller */
+    if (likely(page_cache_enabled)) {
+        struct list_node fill_list;
+        list_initialize(&fill_list);
+
+        for (uint pass = 0; pass < 2 && list_is_empty(&fill_list); pass++) {
+            for (auto& a : arena_list) {
+                if ((pass == 0) != (a.node() == local_node))
+                    continue;
+
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+
+                if (a.AllocPages(1 + PAGE_CACHE_FILL_PAGES, &fill_list) > 0)
+                    break;
+            }
+        }
+
+        page = list_remove_head_type(&fill_list, vm_page_t, free.node);
+        if (page) {
+            *pa = vm_page_to_paddr(page);
+            page_cache_fill(&fill_list);
+
+            /* anything the cache couldn't hold goes back to the arenas */
+            if (!list_is_empty(&fill_list)) {
+                for (auto& a : arena_list) {
+                    vm_page_t* p;
+                    while ((p = list_peek_head_type(&fill_list, vm_page_t, free.node)) &&
+                           a.page_belongs_to_arena(p)) {
+                        list_delete(&p->free.node);
+                        a.FreePage(p);
+                    }
+                }
+            }
+            kcounter_add(&pmm_alloc_pages_count, 1);
             return page;
+        }
+    }
+
+    /* walk the arenas in order until we find one with a free page, taking
+     * the local numa node's arenas first */
+    for (uint pass = 0; pass < 2; pass++) {
+        for (auto& a : arena_list) {
+            if ((pass == 0) != (a.node() == local_node))
+                continue;
+
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+
+            // try to allocate the page out of the arena
+            page = a.AllocPage(pa);
+            if (page) {
+                kcounter_add(&pmm_alloc_pages_count, 1);
+                return page;
+            }
+        }
     }
 
     LTRACEF("failed to allocate page\n");
@@ -139,24 +503,34 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
 
     AutoLock al(&arena_lock);
 
-    /* walk the arenas in order, allocating as many pages as we can from each */
+    check_free_memory_locked();
+
+    /* walk the arenas in order, allocating as many pages as we can from
+     * each, with the local numa node's arenas getting first crack */
     size_t allocated = 0;
-    for (auto& a : arena_list) {
-        DEBUG_ASSERT(count > allocated);
+    const uint local_node = numa_cpu_node(arch_curr_cpu_num());
+    for (uint pass = 0; pass < 2 && allocated < count; pass++) {
+        for (auto& a : arena_list) {
+            DEBUG_ASSERT(count > allocated);
 
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+            if ((pass == 0) != (a.node() == local_node))
                 continue;
-        }
 
-        // ask the arena to allocate some pages
-        allocated += a.AllocPages(count - allocated, list);
-        DEBUG_ASSERT(allocated <= count);
-        if (allocated == count)
-            break;
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a.flags() & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+
+            // ask the arena to allocate some pages
+            allocated += a.AllocPages(count - allocated, list);
+            DEBUG_ASSERT(allocated <= count);
+            if (allocated == count)
+                break;
+        }
     }
 
+    kcounter_add(&pmm_alloc_pages_count, allocated);
     return allocated;
 }
 
@@ -189,6 +563,7 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
             break;
     }
 
+    kcounter_add(&pmm_alloc_pages_count, allocated);
     return allocated;
 }
 
@@ -203,6 +578,17 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
 
     AutoLock al(&arena_lock);
 
+    /* serve the run from the contiguous reserve first; it never holds
+     * movable pages, so a short scan finds a run no matter how
+     * fragmented the arenas have become.  the reserve was taken from a
+     * KMAP arena, so it satisfies KMAP requests as well. */
+    size_t reserved = contig_reserve_alloc_locked(count, alignment_log2, pa, list);
+    if (reserved > 0) {
+        DEBUG_ASSERT(reserved == count);
+        kcounter_add(&pmm_alloc_pages_count, reserved);
+        return reserved;
+    }
+
     for (auto& a : arena_list) {
         /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
         if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
@@ -213,6 +599,7 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
         size_t allocated = a.AllocContiguous(count, alignment_log2, pa, list);
         if (allocated > 0) {
             DEBUG_ASSERT(allocated == count);
+            kcounter_add(&pmm_alloc_pages_count, allocated);
             return allocated;
         }
     }
@@ -303,6 +690,15 @@ size_t pmm_free(struct list_node* list) {
 
         DEBUG_ASSERT(!page_is_free(page));
 
+        /* reserve pages go back to the reserve, never to the arena free
+         * list, so they stay unavailable to movable allocations */
+        if (contig_reserve_owns(page)) {
+            page->state = VM_PAGE_STATE_FREE;
+            contig_reserve_free++;
+            count++;
+            continue;
+        }
+
         /* see which arena this page belongs to and add it */
         for (auto& a : arena_list) {
             if (a.FreePage(page) >= 0) {
@@ -314,10 +710,24 @@ size_t pmm_free(struct list_node* list) {
 
     LTRACEF("returning count %u\n", count);
 
+    kcounter_add(&pmm_free_pages_count, count);
     return count;
 }
 
 size_t pmm_free_page(vm_page_t* page) {
+    DEBUG_ASSERT(!page_is_free(page));
+
+    /* fast path: stash the page in the local cpu's cache. only node-local
+     * KMAP arena pages can go in the cache, since cache hits serve KMAP
+     * allocations and are assumed local. */
+    if (likely(page_cacheable_here(page))) {
+        page->state = VM_PAGE_STATE_ALLOC;
+        if (page_cache_push(page)) {
+            kcounter_add(&pmm_free_pages_count, 1);
+            return 1;
+        }
+    }
+
     struct list_node list;
     list_initialize(&list);
 
@@ -331,6 +741,12 @@ static size_t pmm_count_free_pages_locked() TA_REQ(arena_lock) {
     for (const auto& a : arena_list) {
         free += a.free_count();
     }
+    /* pages sitting in the per-cpu caches or the contiguous reserve are
+     * free too, even though the arenas count them as allocated */
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        free += percpu[i].page_cache_count;
+    }
+    free += contig_reserve_free;
     return free;
 }
 
@@ -47,6 +47,13 @@ void PmmArena::CheckFreeFill(vm_page_t* page) {
 }
 #endif // PMM_ENABLE_FREE_FILL
 
+/* number of page structs initialized per Materialize() call. covers 128MB
+ * of physical memory per chunk, so a single materialization stays in the
+ * tens of microseconds while large-memory machines no longer pay for the
+ * whole array at boot.
+ */
+#define MATERIALIZE_CHUNK_PAGES (32768)
+
 void PmmArena::BootAllocArray() {
     /* allocate an array of pages to back this one */
     size_t page_count = size() / PAGE_SIZE;
@@ -56,24 +63,95 @@ void PmmArena::BootAllocArray() {
     LTRACEF("arena for base 0%#" PRIxPTR " size %#zx page array at %p size %zu\n", info_.base, info_.size,
             raw_page_array, size);
 
-    memset(raw_page_array, 0, size);
-
     page_array_ = (vm_page_t*)raw_page_array;
 
-    /* add them to the free list */
-    for (size_t i = 0; i < page_count; i++) {
+    /* allocate the free page bitmap, one bit per page; every page starts free */
+    size_t bitmap_words = (page_count + 63) / 64;
+    free_bitmap_ = (uint64_t*)boot_alloc_mem(bitmap_words * sizeof(uint64_t));
+    memset(free_bitmap_, 0xff, bitmap_words * sizeof(uint64_t));
+    if (page_count % 64) {
+        /* clear bits past the end of the arena */
+        free_bitmap_[bitmap_words - 1] = (1ULL << (page_count % 64)) - 1;
+    }
+
+    /* every page is free from the start, but the structs themselves are
+     * initialized and put on the free list a chunk at a time, on demand
+     * (see Materialize), so boot time no longer scales with arena size
+     */
+    free_count_ += page_count;
+}
+
+void PmmArena::Materialize(size_t up_to_index) {
+    size_t page_count = size() / PAGE_SIZE;
+
+    if (up_to_index <= materialized_)
+        return;
+
+    size_t end = MIN(ROUNDUP(up_to_index, MATERIALIZE_CHUNK_PAGES), page_count);
+
+    LTRACEF("arena %p materializing pages [%zu, %zu)\n", this, materialized_, end);
+
+    /* every page in the range is still free: allocation paths materialize
+     * before taking pages, so nothing can have touched these structs yet
+     */
+    memset(&page_array_[materialized_], 0, (end - materialized_) * VM_PAGE_STRUCT_SIZE);
+    for (size_t i = materialized_; i < end; i++) {
         auto& p = page_array_[i];
 
         list_add_tail(&free_list_, &p.free.node);
+#if PMM_ENABLE_FREE_FILL
+        if (enforce_fill_)
+            FreeFill(&p);
+#endif
     }
 
-    free_count_ += page_count;
+    materialized_ = end;
+}
+
+/* find the index of the first free page at or after start, or the page count
+ * if every remaining page is allocated */
+size_t PmmArena::bitmap_find_free(size_t start) const {
+    size_t page_count = size() / PAGE_SIZE;
+
+    size_t word = start / 64;
+    uint64_t bits = free_bitmap_[word] & ~((1ULL << (start % 64)) - 1);
+    for (;;) {
+        if (bits) {
+            size_t index = word * 64 + __builtin_ctzll(bits);
+            return (index < page_count) ? index : page_count;
+        }
+        if (++word > (page_count - 1) / 64)
+            return page_count;
+        bits = free_bitmap_[word];
+    }
+}
+
+/* find the index of the first allocated page in [start, end), or end if the
+ * entire range is free */
+size_t PmmArena::bitmap_find_allocated(size_t start, size_t end) const {
+    size_t word = start / 64;
+    uint64_t bits = ~free_bitmap_[word] & ~((1ULL << (start % 64)) - 1);
+    for (;;) {
+        if (bits) {
+            size_t index = word * 64 + __builtin_ctzll(bits);
+            return (index < end) ? index : end;
+        }
+        if (++word > (end - 1) / 64)
+            return end;
+        bits = ~free_bitmap_[word];
+    }
 }
 
 vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
     vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
-    if (!page)
-        return nullptr;
+    if (!page) {
+        if (materialized_ >= size() / PAGE_SIZE)
+            return nullptr;
+        Materialize(materialized_ + 1);
+        page = list_remove_head_type(&free_list_, vm_page_t, free.node);
+        if (!page)
+            return nullptr;
+    }
 
     DEBUG_ASSERT(free_count_ > 0);
 
@@ -82,6 +160,7 @@ vm_page_t* PmmArena::AllocPage(paddr_t* pa) {
     DEBUG_ASSERT(page_is_free(page));
 
     page->state = VM_PAGE_STATE_ALLOC;
+    bitmap_mark_allocated((size_t)(page - page_array_));
 #if PMM_ENABLE_FREE_FILL
     CheckFreeFill(page);
 #endif
@@ -105,6 +184,8 @@ vm_page_t* PmmArena::AllocSpecific(paddr_t pa) {
 
     DEBUG_ASSERT(index < size() / PAGE_SIZE);
 
+    Materialize(index + 1);
+
     vm_page_t* page = get_page(index);
     if (!page_is_free(page)) {
         /* we hit an allocated page */
@@ -114,6 +195,7 @@ vm_page_t* PmmArena::AllocSpecific(paddr_t pa) {
     list_delete(&page->free.node);
 
     page->state = VM_PAGE_STATE_ALLOC;
+    bitmap_mark_allocated(index);
 
     DEBUG_ASSERT(free_count_ > 0);
 
@@ -127,8 +209,12 @@ size_t PmmArena::AllocPages(size_t count, list_node* list) {
 
     while (allocated < count) {
         vm_page_t* page = list_remove_head_type(&free_list_, vm_page_t, free.node);
-        if (!page)
-            return allocated;
+        if (!page) {
+            if (materialized_ >= size() / PAGE_SIZE)
+                return allocated;
+            Materialize(materialized_ + 1);
+            continue;
+        }
 
         LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page_address_from_arena(page));
 
@@ -142,6 +228,7 @@ size_t PmmArena::AllocPages(size_t count, list_node* list) {
 #endif
 
         page->state = VM_PAGE_STATE_ALLOC;
+        bitmap_mark_allocated((size_t)(page - page_array_));
         list_add_tail(list, &page->free.node);
 
         allocated++;
@@ -151,7 +238,7 @@ size_t PmmArena::AllocPages(size_t count, list_node* list) {
 }
 
 size_t PmmArena::AllocContiguous(size_t count, uint8_t alignment_log2, paddr_t* pa, struct list_node* list) {
-    /* walk the list starting at alignment boundaries.
+    /* walk the free bitmap a word at a time starting at alignment boundaries.
      * calculate the starting offset into this arena, based on the
      * base address of the arena to handle the case where the arena
      * is not aligned on the same boundary requested.
@@ -162,37 +249,49 @@ size_t PmmArena::AllocContiguous(size_t count, uint8_t alignment_log2, paddr_t*
 
     paddr_t aligned_offset = (rounded_base - base()) / PAGE_SIZE;
     paddr_t start = aligned_offset;
+    size_t align_pages = 1UL << (alignment_log2 - PAGE_SIZE_SHIFT);
+    size_t page_count = size() / PAGE_SIZE;
     LTRACEF("starting search at aligned offset %#" PRIxPTR "\n", start);
     LTRACEF("arena base %#" PRIxPTR " size %zu\n", base(), size());
 
-retry:
     /* search while we're still within the arena and have a chance of finding a slot
        (start + count < end of arena) */
-    while ((start < size() / PAGE_SIZE) && ((start + count) <= size() / PAGE_SIZE)) {
-        vm_page_t* p = &page_array_[start];
-        for (uint i = 0; i < count; i++) {
-            if (!page_is_free(p)) {
-                /* this run is broken, break out of the inner loop.
-                 * start over at the next alignment boundary
-                 */
-                start = ROUNDUP(start - aligned_offset + i + 1, 1UL << (alignment_log2 - PAGE_SIZE_SHIFT)) +
-                        aligned_offset;
-                goto retry;
-            }
-            p++;
+    while ((start < page_count) && ((start + count) <= page_count)) {
+        /* skip over any allocated region in front of us, then realign */
+        size_t next_free = bitmap_find_free(start);
+        if (next_free >= page_count)
+            return 0;
+        if (next_free != start) {
+            start = ROUNDUP(next_free - aligned_offset, align_pages) + aligned_offset;
+            continue;
+        }
+
+        /* check the candidate run for an allocated page */
+        size_t broken = bitmap_find_allocated(start, start + count);
+        if (broken != start + count) {
+            /* this run is broken, start over at the next alignment boundary
+             * past the allocated page */
+            start = ROUNDUP(broken + 1 - aligned_offset, align_pages) + aligned_offset;
+            continue;
         }
 
         /* we found a run */
         LTRACEF("found run from pn %" PRIuPTR " to %" PRIuPTR "\n", start, start + count);
 
+        /* the bitmap covers unmaterialized pages, so make sure the structs
+         * for the whole run exist before touching them
+         */
+        Materialize(start + count);
+
         /* remove the pages from the run out of the free list */
         for (paddr_t i = start; i < start + count; i++) {
-            p = &page_array_[i];
+            vm_page_t* p = &page_array_[i];
             DEBUG_ASSERT(page_is_free(p));
             DEBUG_ASSERT(list_in_list(&p->free.node));
 
             list_delete(&p->free.node);
             p->state = VM_PAGE_STATE_ALLOC;
+            bitmap_mark_allocated(i);
 
             DEBUG_ASSERT(free_count_ > 0);
 
@@ -225,6 +324,7 @@ status_t PmmArena::FreePage(vm_page_t* page) {
 #endif
 
     page->state = VM_PAGE_STATE_FREE;
+    bitmap_mark_free((size_t)(page - page_array_));
 
     list_add_head(&free_list_, &page->free.node);
     free_count_++;
@@ -232,20 +332,23 @@ status_t PmmArena::FreePage(vm_page_t* page) {
 }
 
 void PmmArena::CountStates(size_t state_count[_VM_PAGE_STATE_COUNT]) const {
-    for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
+    for (size_t i = 0; i < materialized_; i++) {
         state_count[page_array_[i].state]++;
     }
+    /* unmaterialized pages are free by definition */
+    state_count[VM_PAGE_STATE_FREE] += size() / PAGE_SIZE - materialized_;
 }
 
 void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
     char pbuf[16];
-    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x\n", this, name(), base(),
-           format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags());
-    printf("\tpage_array %p, free_count %zu\n", page_array_, free_count_);
+    printf("arena %p: name '%s' base %#" PRIxPTR " size %s (0x%zx) priority %u flags 0x%x node %u\n", this, name(), base(),
+           format_size(pbuf, sizeof(pbuf), size()), size(), priority(), flags(), node());
+    printf("\tpage_array %p, free_count %zu, materialized %zu/%zu\n", page_array_, free_count_,
+           materialized_, size() / PAGE_SIZE);
 
-    /* dump all of the pages */
+    /* dump all of the materialized pages */
     if (dump_pages) {
-        for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
+        for (size_t i = 0; i < materialized_; i++) {
             dump_page(&page_array_[i]);
         }
     }
@@ -265,7 +368,7 @@ void PmmArena::Dump(bool dump_pages, bool dump_free_ranges) {
         printf("\tfree ranges:\n");
         ssize_t last = -1;
         for (size_t i = 0; i < size() / PAGE_SIZE; i++) {
-            if (page_is_free(&page_array_[i])) {
+            if (i >= materialized_ || page_is_free(&page_array_[i])) {
                 if (last == -1) {
                     last = i;
                 }
@@ -37,6 +37,8 @@ public:
     size_t size() const { return info_.size; }
     unsigned int flags() const { return info_.flags; }
     unsigned int priority() const { return info_.priority; }
+    unsigned int node() const { return node_; }
+    void set_node(unsigned int node) { node_ = node; }
     size_t free_count() const { return free_count_; };
 
     // Counts the number of pages in every state. For each page in the arena,
@@ -79,12 +81,39 @@ private:
     void CheckFreeFill(vm_page_t* page);
 #endif
 
+    // Initializes page structs up to at least |up_to_index| (rounded up to
+    // a chunk) and appends them to the free list. See BootAllocArray.
+    // Called with the arena lock held via the allocation paths.
+    void Materialize(size_t up_to_index);
+
+    // free page bitmap manipulation; one bit per page, set == free
+    void bitmap_mark_free(size_t index) { free_bitmap_[index / 64] |= (1ULL << (index % 64)); }
+    void bitmap_mark_allocated(size_t index) { free_bitmap_[index / 64] &= ~(1ULL << (index % 64)); }
+
+    // word-at-a-time scans over the free bitmap
+    size_t bitmap_find_free(size_t start) const;
+    size_t bitmap_find_allocated(size_t start, size_t end) const;
+
     const pmm_arena_info_t info_;
+
+    // numa node the arena's memory belongs to; set via pmm_set_node() once
+    // the platform has read the topology, 0 everywhere else.
+    unsigned int node_ = 0;
+
     vm_page_t* page_array_ = nullptr;
 
+    // one bit per page in the arena, set bits are free pages. used to
+    // accelerate contiguous run searches without touching the page array.
+    uint64_t* free_bitmap_ = nullptr;
+
     size_t free_count_ = 0;
     list_node free_list_ = LIST_INITIAL_VALUE(free_list_);
 
+    // index of the first page struct that has not been materialized yet.
+    // pages at or past this index are free (and counted in free_count_),
+    // but their structs are uninitialized and not on the free list.
+    size_t materialized_ = 0;
+
 #if PMM_ENABLE_FREE_FILL
     bool enforce_fill_ = false;
 #endif
@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/auto_lock.h>
 #include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <mxtl/auto_call.h>
@@ -30,7 +31,7 @@ VmAddressRegionOrMapping::VmAddressRegionOrMapping(
 status_t VmAddressRegionOrMapping::Destroy() {
     canary_.Assert();
 
-    AutoLock guard(aspace_->lock());
+    AutoWriteLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return ERR_BAD_STATE;
     }
@@ -50,7 +51,7 @@ VmAddressRegionOrMapping::~VmAddressRegionOrMapping() {
 
 bool VmAddressRegionOrMapping::IsAliveLocked() const {
     canary_.Assert();
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(rwlock_held(aspace_->lock()));
     return state_ == LifeCycleState::ALIVE;
 }
 
@@ -84,7 +85,7 @@ bool VmAddressRegionOrMapping::is_valid_mapping_flags(uint arch_mmu_flags) {
 }
 
 size_t VmAddressRegionOrMapping::AllocatedPages() const {
-    AutoLock guard(aspace_->lock());
+    AutoReadLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return 0;
     }
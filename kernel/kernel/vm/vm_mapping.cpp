@@ -10,6 +10,7 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/auto_lock.h>
 #include <kernel/vm.h>
 #include <kernel/vm/fault.h>
 #include <kernel/vm/vm_aspace.h>
@@ -40,7 +41,7 @@ VmMapping::~VmMapping() {
 
 size_t VmMapping::AllocatedPagesLocked() const {
     canary_.Assert();
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(rwlock_held(aspace_->lock()));
 
     if (state_ != LifeCycleState::ALIVE) {
         return 0;
@@ -79,7 +80,7 @@ status_t VmMapping::Protect(vaddr_t base, size_t size, uint new_arch_mmu_flags)
 
     size = ROUNDUP(size, PAGE_SIZE);
 
-    AutoLock guard(aspace_->lock());
+    AutoWriteLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return ERR_BAD_STATE;
     }
@@ -92,7 +93,7 @@ status_t VmMapping::Protect(vaddr_t base, size_t size, uint new_arch_mmu_flags)
 }
 
 status_t VmMapping::ProtectLocked(vaddr_t base, size_t size, uint new_arch_mmu_flags) {
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(is_rwlock_write_held(aspace_->lock()));
     DEBUG_ASSERT(size != 0 && IS_PAGE_ALIGNED(base) && IS_PAGE_ALIGNED(size));
 
     // Do not allow changing caching
@@ -216,7 +217,7 @@ status_t VmMapping::Unmap(vaddr_t base, size_t size) {
         return ERR_BAD_STATE;
     }
 
-    AutoLock guard(aspace->lock());
+    AutoWriteLock guard(aspace->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return ERR_BAD_STATE;
     }
@@ -235,7 +236,7 @@ status_t VmMapping::Unmap(vaddr_t base, size_t size) {
 
 status_t VmMapping::UnmapLocked(vaddr_t base, size_t size) {
     canary_.Assert();
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(is_rwlock_write_held(aspace_->lock()));
     DEBUG_ASSERT(size != 0 && IS_PAGE_ALIGNED(size) && IS_PAGE_ALIGNED(base));
     DEBUG_ASSERT(base >= base_ && base - base_ < size_);
     DEBUG_ASSERT(size_ - (base - base_) >= size);
@@ -373,7 +374,7 @@ status_t VmMapping::UnmapVmoRangeLocked(uint64_t offset, uint64_t len) const {
 status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
     canary_.Assert();
 
-    AutoLock guard(aspace_->lock());
+    AutoWriteLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return ERR_BAD_STATE;
     }
@@ -398,8 +399,32 @@ status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
     currently_faulting_ = true;
     auto ac = mxtl::MakeAutoCall([&]() { currently_faulting_ = false; });
 
-    // iterate through the range, grabbing a page from the underlying object and
-    // mapping it in
+    // iterate through the range, grabbing pages from the underlying object and
+    // handing runs of physically contiguous pages to the arch code in one
+    // call, so that suitably aligned runs can be mapped with large pages
+    vaddr_t run_va = 0;
+    paddr_t run_pa = 0;
+    size_t run_pages = 0;
+
+    auto map_run = [&]() {
+        if (run_pages == 0)
+            return;
+
+        LTRACEF_LEVEL(2, "mapping pa %#" PRIxPTR " to va %#" PRIxPTR ", %zu pages\n", run_pa,
+                      run_va, run_pages);
+
+        size_t mapped;
+        auto ret = arch_mmu_map(&aspace_->arch_aspace(), run_va, run_pa, run_pages,
+                                arch_mmu_flags_, &mapped);
+        if (ret < 0) {
+            TRACEF("error %d mapping %zu pages at va %#" PRIxPTR " pa %#" PRIxPTR "\n", ret,
+                   run_pages, run_va, run_pa);
+        }
+
+        DEBUG_ASSERT(ret < 0 || mapped == run_pages);
+        run_pages = 0;
+    };
+
     size_t o;
     for (o = offset; o < offset + len; o += PAGE_SIZE) {
         uint64_t vmo_offset = object_offset_ + o;
@@ -408,7 +433,8 @@ status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
         paddr_t pa;
         status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &pa);
         if (status < 0) {
-            // no page to map
+            // no page to map; flush the run accumulated so far
+            map_run();
             if (commit) {
                 // fail when we can't commit every requested page
                 return status;
@@ -418,17 +444,17 @@ status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
             }
         }
 
-        vaddr_t va = base_ + o;
-        LTRACEF_LEVEL(2, "mapping pa %#" PRIxPTR " to va %#" PRIxPTR "\n", pa, va);
-
-        size_t mapped;
-        auto ret = arch_mmu_map(&aspace_->arch_aspace(), va, pa, 1, arch_mmu_flags_, &mapped);
-        if (ret < 0) {
-            TRACEF("error %d mapping page at va %#" PRIxPTR " pa %#" PRIxPTR "\n", ret, va, pa);
+        if (run_pages != 0 && pa == run_pa + run_pages * PAGE_SIZE) {
+            // extends the current contiguous run
+            run_pages++;
+        } else {
+            map_run();
+            run_va = base_ + o;
+            run_pa = pa;
+            run_pages = 1;
         }
-
-        DEBUG_ASSERT(mapped == 1);
     }
+    map_run();
 
     return NO_ERROR;
 }
@@ -439,7 +465,7 @@ status_t VmMapping::DecommitRange(size_t offset, size_t len,
     LTRACEF("%p [%#zx+%#zx], offset %#zx, len %#zx\n",
             this, base_, size_, offset, len);
 
-    AutoLock guard(aspace_->lock());
+    AutoWriteLock guard(aspace_->lock());
     if (state_ != LifeCycleState::ALIVE) {
         return ERR_BAD_STATE;
     }
@@ -453,7 +479,7 @@ status_t VmMapping::DecommitRange(size_t offset, size_t len,
 
 status_t VmMapping::DestroyLocked() {
     canary_.Assert();
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(is_rwlock_write_held(aspace_->lock()));
     LTRACEF("%p\n", this);
 
     // Take a reference to ourself, so that we do not get destructed after
@@ -503,7 +529,7 @@ status_t VmMapping::DestroyLocked() {
 
 status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     canary_.Assert();
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(rwlock_held(aspace_->lock()));
 
     DEBUG_ASSERT(va >= base_ && va <= base_ + size_ - 1);
 
@@ -562,6 +588,11 @@ status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
     }
 
+    // we only hold the aspace lock for read, so serialize the page table
+    // query/update sequence against other faults in this aspace ourselves;
+    // region tree mutators hold the aspace lock for write and can't race us
+    AutoLock mmu_guard(aspace_->arch_mmu_lock());
+
     // see if something is mapped here now
     // this may happen if we are one of multiple threads racing on a single address
     uint page_flags;
@@ -647,7 +678,7 @@ status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
 // function.
 void VmMapping::ActivateLocked() TA_NO_THREAD_SAFETY_ANALYSIS {
     DEBUG_ASSERT(state_ == LifeCycleState::NOT_READY);
-    DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
+    DEBUG_ASSERT(is_rwlock_write_held(aspace_->lock()));
     DEBUG_ASSERT(object_->lock()->IsHeld());
     DEBUG_ASSERT(parent_);
 
@@ -25,6 +25,7 @@
 
 VmObject::VmObject(mxtl::RefPtr<VmObject> parent)
     : lock_(parent ? parent->lock_ref() : local_lock_),
+      fault_shards_(parent ? parent->fault_shards_ : local_fault_shards_),
       parent_(mxtl::move(parent)) {
     LTRACEF("%p\n", this);
 }
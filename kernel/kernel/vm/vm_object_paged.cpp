@@ -13,11 +13,14 @@
 #include <err.h>
 #include <inttypes.h>
 #include <kernel/auto_lock.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
 #include <kernel/vm.h>
 #include <kernel/vm/fault.h>
 #include <kernel/vm/vm_address_region.h>
 #include <lib/console.h>
 #include <lib/user_copy.h>
+#include <lk/init.h>
 #include <mxalloc/new.h>
 #include <safeint/safe_math.h>
 #include <stdlib.h>
@@ -42,6 +45,25 @@ void ZeroPage(vm_page_t* p) {
 
 } // namespace
 
+// Registry of vmos carrying MX_VMO_OP_DONT_NEED hinted pages, kept in hint
+// order so the evictor reclaims the longest-hinted vmo first.
+//
+// Lock ordering: the registry lock is only ever taken with no vmo lock held;
+// the evictor acquires a vmo's lock while holding the registry lock, never
+// the reverse. Holding the registry lock across the eviction also keeps the
+// registry's raw pointers alive, since ~VmObjectPaged unregisters under the
+// same lock before freeing anything.
+static mutex_t discard_list_lock = MUTEX_INITIAL_VALUE(discard_list_lock);
+static mxtl::DoublyLinkedList<VmObjectPaged*, VmObjectPaged::DiscardListTraits>
+    discard_list TA_GUARDED(discard_list_lock);
+static event_t evictor_event =
+    EVENT_INITIAL_VALUE(evictor_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+// The pmm kicks the evictor when free memory falls below its low water mark;
+// eviction then runs until this fraction of total memory is free again, which
+// keeps the evictor from thrashing right at the pmm's threshold.
+#define EVICT_FREE_TARGET_DIVISOR 16u
+
 VmObjectPaged::VmObjectPaged(uint32_t pmm_alloc_flags, mxtl::RefPtr<VmObject> parent)
     : VmObject(mxtl::move(parent)), pmm_alloc_flags_(pmm_alloc_flags) {
     LTRACEF("%p\n", this);
@@ -52,6 +74,13 @@ VmObjectPaged::~VmObjectPaged() {
 
     LTRACEF("%p\n", this);
 
+    // drop out of the evictor's registry before the pages go away
+    {
+        AutoLock a(&discard_list_lock);
+        if (discard_node_state_.InContainer())
+            discard_list.erase(*this);
+    }
+
     // free all of the pages attached to us
     page_list_.FreeAllPages();
 }
@@ -141,14 +170,17 @@ size_t VmObjectPaged::AllocatedPagesInRange(uint64_t offset, uint64_t len) const
     if (!TrimRange(offset, len, size_, &new_len)) {
         return 0;
     }
+    // whole-object queries (the common case for memory attribution) are
+    // answered from the counter without walking the page list
+    if (offset == 0 && new_len == size_) {
+        return committed_pages_;
+    }
     size_t count = 0;
     // TODO: Figure out what to do with our parent's pages. If we're a clone,
     // page_list_ only contains pages that we've made copies of.
-    page_list_.ForEveryPage(
-        [&count, offset, new_len](const auto p, uint64_t off) {
-            if (off >= offset && off < offset + new_len) {
-                count++;
-            }
+    page_list_.ForEveryPageInRange(offset, offset + new_len,
+        [&count](const auto p, uint64_t off) {
+            count++;
         });
     return count;
 }
@@ -173,6 +205,7 @@ status_t VmObjectPaged::AddPageLocked(vm_page_t* p, uint64_t offset) {
     status_t err = page_list_.AddPage(p, offset);
     if (err != NO_ERROR)
         return err;
+    committed_pages_++;
 
     // other mappings may have covered this offset into the vmo, so unmap those ranges
     RangeChangeUpdateLocked(offset, PAGE_SIZE);
@@ -233,6 +266,7 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, vm_page_t*
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
 
+retry:
     if (offset >= size_)
         return ERR_OUT_OF_RANGE;
 
@@ -277,11 +311,23 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, vm_page_t*
                 return NO_ERROR;
             }
 
-            // if we're write faulting, we need to clone it and return the new page
+            // if we're write faulting, we need to clone it and return the new page.
+            // do the allocation and copy outside the shared clone tree lock so
+            // that faults on disjoint offsets of the tree can copy in parallel;
+            // faults on the same page serialize on an offset shard, so at most
+            // one of them does the copy. lock_ must be dropped before taking
+            // the shard to keep the acquisition order consistent.
+            Mutex* shard = fault_shard(offset);
+            lock_.Release();
+            shard->Acquire();
+
             paddr_t pa_clone;
             vm_page_t* p_clone = pmm_alloc_page(pmm_alloc_flags_, &pa_clone);
-            if (!p_clone)
+            if (!p_clone) {
+                shard->Release();
+                lock_.Acquire();
                 return ERR_NO_MEMORY;
+            }
 
             p_clone->state = VM_PAGE_STATE_OBJECT;
 
@@ -293,6 +339,23 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, vm_page_t*
 
             memcpy(dst, src, PAGE_SIZE);
 
+            lock_.Acquire();
+            shard->Release();
+
+            // the world may have moved while we copied: another fault may have
+            // populated this offset, the vmo may have shrunk, or the parent's
+            // page may have been replaced. revalidate and retry from the top,
+            // discarding our copy, if anything changed.
+            vm_page_t* p_check;
+            paddr_t pa_check;
+            if (offset >= size_ || page_list_.GetPage(offset) ||
+                parent_->GetPageLocked(parent_offset.ValueOrDie(), parent_pf_flags, &p_check,
+                                       &pa_check) != NO_ERROR ||
+                pa_check != pa) {
+                pmm_free_page(p_clone);
+                goto retry;
+            }
+
             // add the new page and return it
             status = AddPageLocked(p_clone, offset);
             DEBUG_ASSERT(status == NO_ERROR);
@@ -324,16 +387,13 @@ status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, vm_page_t*
         return NO_ERROR;
     }
 
-    // allocate a page
-    p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+    // allocate a pre-zeroed page so the fault path doesn't scrub inline
+    p = pmm_alloc_page(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZERO, &pa);
     if (!p)
         return ERR_NO_MEMORY;
 
     p->state = VM_PAGE_STATE_OBJECT;
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
     status_t status = AddPageLocked(p, offset);
     DEBUG_ASSERT(status == NO_ERROR);
 
@@ -372,12 +432,15 @@ status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* com
     uint64_t end = ROUNDUP_PAGE_SIZE(offset + new_len);
     DEBUG_ASSERT(end > offset);
 
-    // make a pass through the list, counting the number of pages we need to allocate
-    size_t count = 0;
-    for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
-        if (!page_list_.GetPage(o))
-            count++;
-    }
+    // count the pages already populating the range, skipping over any gaps,
+    // and derive the number we need to allocate from it
+    uint64_t aligned_start = ROUNDDOWN(offset, PAGE_SIZE);
+    size_t populated = 0;
+    page_list_.ForEveryPageInRange(aligned_start, end,
+        [&populated](const auto p, uint64_t off) {
+            populated++;
+        });
+    size_t count = (end - aligned_start) / PAGE_SIZE - populated;
     if (count == 0)
         return NO_ERROR;
 
@@ -411,6 +474,7 @@ status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* com
 
         status_t status = page_list_.AddPage(p, o);
         DEBUG_ASSERT(status == NO_ERROR);
+        committed_pages_++;
 
         if (committed)
             *committed += PAGE_SIZE;
@@ -448,11 +512,13 @@ status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len, uin
     DEBUG_ASSERT(end > offset);
 
     // make a pass through the list, making sure we have an empty run on the object
-    size_t count = 0;
-    for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
-        if (!page_list_.GetPage(o))
-            count++;
-    }
+    uint64_t aligned_start = ROUNDDOWN(offset, PAGE_SIZE);
+    size_t populated = 0;
+    page_list_.ForEveryPageInRange(aligned_start, end,
+        [&populated](const auto p, uint64_t off) {
+            populated++;
+        });
+    size_t count = (end - aligned_start) / PAGE_SIZE - populated;
 
     DEBUG_ASSERT(count == new_len / PAGE_SIZE);
 
@@ -484,6 +550,7 @@ status_t VmObjectPaged::CommitRangeContiguous(uint64_t offset, uint64_t len, uin
 
         auto status = page_list_.AddPage(p, o);
         DEBUG_ASSERT(status == NO_ERROR);
+        committed_pages_++;
 
         if (committed)
             *committed += PAGE_SIZE;
@@ -523,21 +590,385 @@ status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t* d
     LTRACEF("start offset %#" PRIx64 ", end %#" PRIx64 ", page_aliged_len %#" PRIx64 "\n", start, end,
             page_aligned_len);
 
+    // refuse to free pinned pages; they may be targets of in-flight DMA
+    bool pinned = false;
+    page_list_.ForEveryPageInRange(start, end,
+        [&pinned](const auto p, uint64_t off) {
+            if (p->pin_count > 0)
+                pinned = true;
+        });
+    if (pinned)
+        return ERR_BUSY;
+
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(start, page_aligned_len);
 
-    // iterate through the pages, freeing them
-    while (start < end) {
-        auto status = page_list_.FreePage(start);
-        if (status == NO_ERROR && decommitted) {
-            *decommitted += PAGE_SIZE;
+    // free all of the pages in the range back to the pmm in one batch
+    size_t freed = page_list_.FreePagesInRange(start, end);
+    DEBUG_ASSERT(committed_pages_ >= freed);
+    committed_pages_ -= freed;
+    if (decommitted) {
+        *decommitted = freed * PAGE_SIZE;
+    }
+
+    return NO_ERROR;
+}
+
+status_t VmObjectPaged::TransferRange(mxtl::RefPtr<VmObject> dest, uint64_t offset,
+                                      uint64_t dest_offset, uint64_t len,
+                                      uint64_t* transferred) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 " dest_offset %#" PRIx64 " len %#" PRIx64 "\n",
+            offset, dest_offset, len);
+
+    if (transferred)
+        *transferred = 0;
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(dest_offset) || !IS_PAGE_ALIGNED(len))
+        return ERR_INVALID_ARGS;
+
+    if (!dest || !dest->is_paged())
+        return ERR_NOT_SUPPORTED;
+
+    auto dst = static_cast<VmObjectPaged*>(dest.get());
+    if (dst == this)
+        return ERR_INVALID_ARGS;
+
+    // members of a clone tree share one lock, so a transfer inside a tree
+    // would self-deadlock; moving pages out from under a COW parent or
+    // child would also change what the relatives see, so only standalone
+    // vmos qualify
+    if (&lock_ == &dst->lock_)
+        return ERR_NOT_SUPPORTED;
+
+    // lock both objects in a fixed order so transfers running in opposite
+    // directions cannot deadlock against each other
+    Mutex* lock_first = &lock_;
+    Mutex* lock_second = &dst->lock_;
+    if (lock_second < lock_first) {
+        lock_first = lock_second;
+        lock_second = &lock_;
+    }
+    AutoLock a(lock_first);
+    AutoLock b(lock_second);
+
+    if (parent_ || dst->parent_ || children_list_len_ > 0 || dst->children_list_len_ > 0)
+        return ERR_NOT_SUPPORTED;
+
+    if (offset > size_ || len > size_ - offset)
+        return ERR_OUT_OF_RANGE;
+    if (dest_offset > dst->size_ || len > dst->size_ - dest_offset)
+        return ERR_OUT_OF_RANGE;
+
+    if (len == 0)
+        return NO_ERROR;
+
+    // refuse to move or overwrite pinned pages; they may be targets of
+    // in-flight DMA
+    bool pinned = false;
+    page_list_.ForEveryPageInRange(offset, offset + len,
+        [&pinned](const auto p, uint64_t off) {
+            if (p->pin_count > 0)
+                pinned = true;
+        });
+    dst->page_list_.ForEveryPageInRange(dest_offset, dest_offset + len,
+        [&pinned](const auto p, uint64_t off) {
+            if (p->pin_count > 0)
+                pinned = true;
+        });
+    if (pinned)
+        return ERR_BUSY;
+
+    // unmap both ranges on all mapping regions; the source pages are
+    // leaving and the destination range's contents are being replaced
+    RangeChangeUpdateLocked(offset, len);
+    dst->RangeChangeUpdateLocked(dest_offset, len);
+
+    // whatever the destination range held makes way for the source pages
+    size_t freed = dst->page_list_.FreePagesInRange(dest_offset, dest_offset + len);
+    DEBUG_ASSERT(dst->committed_pages_ >= freed);
+    dst->committed_pages_ -= freed;
+
+    // splice the pages across one page of metadata at a time; no bytes
+    // are copied. gaps in the source stay gaps in the destination.
+    // VmPageList::AddPage clears the page flags, so DONT_NEED hints do
+    // not follow the page to its new owner.
+    uint64_t moved = 0;
+    for (uint64_t src_off = offset; src_off < offset + len; src_off += PAGE_SIZE) {
+        vm_page_t* p = page_list_.RemovePage(src_off);
+        if (!p)
+            continue;
+        DEBUG_ASSERT(committed_pages_ > 0);
+        committed_pages_--;
+
+        status_t status = dst->page_list_.AddPage(p, dest_offset + (src_off - offset));
+        if (status != NO_ERROR) {
+            // the page already left the source; free it rather than leak
+            // it, and report how far the transfer got
+            pmm_free_page(p);
+            if (transferred)
+                *transferred = moved * PAGE_SIZE;
+            return status;
         }
-        start += PAGE_SIZE;
+        dst->committed_pages_++;
+        moved++;
+    }
+
+    if (transferred)
+        *transferred = moved * PAGE_SIZE;
+
+    return NO_ERROR;
+}
+
+status_t VmObjectPaged::Pin(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    // commit the range first; the pages are pinned under the lock below, so
+    // anything racing to decommit in between simply fails the pin
+    status_t status = CommitRange(offset, len, nullptr);
+    if (status != NO_ERROR)
+        return status;
+
+    AutoLock a(&lock_);
+
+    // trim the size
+    uint64_t new_len;
+    if (!TrimRange(offset, len, size_, &new_len))
+        return ERR_OUT_OF_RANGE;
+
+    // was in range, just zero length
+    if (new_len == 0)
+        return NO_ERROR;
+
+    uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + new_len);
+
+    // every page must still be present and have pin head-room
+    size_t expected = (end - start) / PAGE_SIZE;
+    size_t pinnable = 0;
+    page_list_.ForEveryPageInRange(start, end,
+        [&pinnable](const auto p, uint64_t off) {
+            if (p->pin_count < VM_PAGE_PIN_MAX)
+                pinnable++;
+        });
+    if (pinnable != expected)
+        return ERR_UNAVAILABLE;
+
+    uint64_t unflagged = 0;
+    page_list_.ForEveryPageInRange(start, end,
+        [&unflagged](const auto p, uint64_t off) {
+            p->pin_count++;
+            // a pinned page is no longer a reclaim candidate
+            if (p->flags & VM_PAGE_FLAG_DONT_NEED) {
+                p->flags &= ~VM_PAGE_FLAG_DONT_NEED;
+                unflagged++;
+            }
+        });
+    dont_need_pages_ -= (unflagged < dont_need_pages_) ? unflagged : dont_need_pages_;
+
+    return NO_ERROR;
+}
+
+status_t VmObjectPaged::Unpin(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    AutoLock a(&lock_);
+
+    // trim the size
+    uint64_t new_len;
+    if (!TrimRange(offset, len, size_, &new_len))
+        return ERR_OUT_OF_RANGE;
+
+    // was in range, just zero length
+    if (new_len == 0)
+        return NO_ERROR;
+
+    uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + new_len);
+
+    // the range must be entirely pinned for the unpin to balance
+    size_t expected = (end - start) / PAGE_SIZE;
+    size_t pinned = 0;
+    page_list_.ForEveryPageInRange(start, end,
+        [&pinned](const auto p, uint64_t off) {
+            if (p->pin_count > 0)
+                pinned++;
+        });
+    if (pinned != expected)
+        return ERR_INVALID_ARGS;
+
+    page_list_.ForEveryPageInRange(start, end,
+        [](const auto p, uint64_t off) {
+            p->pin_count--;
+        });
+
+    return NO_ERROR;
+}
+
+status_t VmObjectPaged::DontNeedRange(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    uint64_t flagged = 0;
+    {
+        AutoLock a(&lock_);
+
+        // trim the size
+        uint64_t new_len;
+        if (!TrimRange(offset, len, size_, &new_len))
+            return ERR_OUT_OF_RANGE;
+
+        // was in range, just zero length
+        if (new_len == 0)
+            return NO_ERROR;
+
+        // only whole pages inside the range are candidates
+        uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+        uint64_t end = ROUNDUP_PAGE_SIZE(offset + new_len);
+
+        page_list_.ForEveryPageInRange(start, end,
+            [&flagged](const auto p, uint64_t off) {
+                // pinned pages cannot be reclaimed, so don't flag them
+                if (p->pin_count == 0 && !(p->flags & VM_PAGE_FLAG_DONT_NEED)) {
+                    p->flags |= VM_PAGE_FLAG_DONT_NEED;
+                    flagged++;
+                }
+            });
+        dont_need_pages_ += flagged;
     }
 
+    if (flagged > 0) {
+        // (re)register with the evictor; re-hinting moves us to the back of
+        // the line so the oldest hints are the first to be reclaimed
+        AutoLock a(&discard_list_lock);
+        if (discard_node_state_.InContainer())
+            discard_list.erase(*this);
+        discard_list.push_back(this);
+    }
+
+    return NO_ERROR;
+}
+
+status_t VmObjectPaged::WillNeedRange(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    AutoLock a(&lock_);
+
+    // trim the size
+    uint64_t new_len;
+    if (!TrimRange(offset, len, size_, &new_len))
+        return ERR_OUT_OF_RANGE;
+
+    // was in range, just zero length
+    if (new_len == 0)
+        return NO_ERROR;
+
+    uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + new_len);
+
+    uint64_t cleared = 0;
+    page_list_.ForEveryPageInRange(start, end,
+        [&cleared](const auto p, uint64_t off) {
+            if (p->flags & VM_PAGE_FLAG_DONT_NEED) {
+                p->flags &= ~VM_PAGE_FLAG_DONT_NEED;
+                cleared++;
+            }
+        });
+    dont_need_pages_ -= (cleared < dont_need_pages_) ? cleared : dont_need_pages_;
+
+    // pages already reclaimed are not repopulated here; the caller can
+    // commit the range if it wants to avoid the zero fill faults
     return NO_ERROR;
 }
 
+size_t VmObjectPaged::EvictDontNeedPages(size_t target) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    size_t evicted = 0;
+    uint64_t scan = 0;
+    while (evicted < target && dont_need_pages_ > 0) {
+        // gather a batch of flagged offsets; freeing mutates the page list,
+        // so it cannot happen inside the iteration. everything below |scan|
+        // was already freed or unflagged, so later passes skip it.
+        uint64_t offsets[64];
+        size_t n = 0;
+        page_list_.ForEveryPageInRange(scan, ROUNDUP_PAGE_SIZE(size_),
+            [&offsets, &n](const auto p, uint64_t off) {
+                if (n < countof(offsets) && (p->flags & VM_PAGE_FLAG_DONT_NEED) &&
+                    p->pin_count == 0)
+                    offsets[n++] = off;
+            });
+        if (n == 0) {
+            // decommit or resize freed the flagged pages out from under the
+            // counter; resync it
+            dont_need_pages_ = 0;
+            break;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            // unmap the page everywhere before it goes back to the pmm
+            RangeChangeUpdateLocked(offsets[i], PAGE_SIZE);
+            page_list_.FreePage(offsets[i]);
+        }
+        scan = offsets[n - 1] + PAGE_SIZE;
+
+        DEBUG_ASSERT(committed_pages_ >= n);
+        committed_pages_ -= n;
+        dont_need_pages_ -= (n < dont_need_pages_) ? n : dont_need_pages_;
+        evicted += n;
+    }
+
+    return evicted;
+}
+
+void vmo_evictor_kick() {
+    event_signal(&evictor_event, false);
+}
+
+static int vmo_evictor_thread(void* arg) {
+    for (;;) {
+        event_wait(&evictor_event);
+
+        // reclaim hinted pages, oldest hint first, until a comfortable
+        // amount of memory is free or the candidates run out
+        size_t target = pmm_count_total_bytes() / PAGE_SIZE / EVICT_FREE_TARGET_DIVISOR;
+        for (;;) {
+            size_t free_pages = pmm_count_free_pages();
+            if (free_pages >= target)
+                break;
+
+            AutoLock a(&discard_list_lock);
+            if (discard_list.is_empty())
+                break;
+
+            VmObjectPaged* vmo = &discard_list.front();
+            size_t want = target - free_pages;
+            size_t evicted = vmo->EvictDontNeedPages(want);
+
+            // drained vmos drop off the registry; ones with more to give
+            // rotate to the back so a single large vmo doesn't absorb all
+            // of the pressure
+            discard_list.erase(*vmo);
+            if (evicted == want)
+                discard_list.push_back(vmo);
+        }
+    }
+    return 0;
+}
+
+static void vmo_evictor_init(uint level) {
+    thread_t* t = thread_create("vmo-evictor", vmo_evictor_thread, nullptr, LOW_PRIORITY,
+                                DEFAULT_STACK_SIZE);
+    if (t)
+        thread_resume(t);
+}
+LK_INIT_HOOK_PARALLEL(vmo_evictor, vmo_evictor_init, LK_INIT_LEVEL_THREADING);
+
 status_t VmObjectPaged::ResizeLocked(uint64_t s) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
@@ -558,14 +989,24 @@ status_t VmObjectPaged::ResizeLocked(uint64_t s) {
 
         // we're only worried about whole pages to be removed
         if (page_aligned_len > 0) {
+            // pinned pages in the cut range may be targets of in-flight DMA;
+            // refuse to free them out from under the pinner
+            bool pinned = false;
+            page_list_.ForEveryPageInRange(start, end,
+                [&pinned](const auto p, uint64_t off) {
+                    if (p->pin_count > 0)
+                        pinned = true;
+                });
+            if (pinned)
+                return ERR_BUSY;
+
             // unmap all of the pages in this range on all the mapping regions
             RangeChangeUpdateLocked(start, page_aligned_len);
 
-            // iterate through the pages, freeing them
-            while (start < end) {
-                page_list_.FreePage(start);
-                start += PAGE_SIZE;
-            }
+            // free all of the pages in the cut range back to the pmm in one batch
+            size_t freed = page_list_.FreePagesInRange(start, end);
+            DEBUG_ASSERT(committed_pages_ >= freed);
+            committed_pages_ -= freed;
         }
     } else if (s > size_) {
         // expanding
@@ -82,6 +82,30 @@ status_t VmObjectPhysical::GetPageLocked(uint64_t offset, uint pf_flags, vm_page
     return NO_ERROR;
 }
 
+status_t VmObjectPhysical::Pin(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    // the underlying memory is not pmm-managed and can never be freed out
+    // from under the pinner, so only the range needs validating
+    if (unlikely(!InRange(offset, len, size_)))
+        return ERR_OUT_OF_RANGE;
+
+    return NO_ERROR;
+}
+
+status_t VmObjectPhysical::Unpin(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    if (unlikely(!InRange(offset, len, size_)))
+        return ERR_OUT_OF_RANGE;
+
+    return NO_ERROR;
+}
+
 status_t VmObjectPhysical::LookupUser(uint64_t offset, uint64_t len, user_ptr<paddr_t> buffer,
                                       size_t buffer_size) {
     canary_.Assert();
@@ -75,6 +75,10 @@ status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
     LTRACEF_LEVEL(2, "%p page %p, offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, p, offset,
                   node_offset, index);
 
+    // the flags only have meaning while the page is in a list, and the
+    // previous owner's hints must not carry over to this one
+    p->flags = 0;
+
     // lookup the tree node that holds this page
     auto pln = list_.find(node_offset);
     if (!pln.IsValid()) {
@@ -112,6 +116,29 @@ vm_page* VmPageList::GetPage(uint64_t offset) {
     return pln->GetPage(index);
 }
 
+vm_page* VmPageList::RemovePage(uint64_t offset) {
+    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+    size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
+
+    LTRACEF_LEVEL(2, "%p offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, offset,
+                  node_offset, index);
+
+    // lookup the tree node that holds this page
+    auto pln = list_.find(node_offset);
+    if (!pln.IsValid()) {
+        return nullptr;
+    }
+
+    // take the page out without freeing it
+    auto page = pln->RemovePage(index);
+    if (page && pln->IsEmpty()) {
+        LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
+        list_.erase(*pln);
+    }
+
+    return page;
+}
+
 status_t VmPageList::FreePage(uint64_t offset) {
     uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
@@ -140,6 +167,46 @@ status_t VmPageList::FreePage(uint64_t offset) {
     return NO_ERROR;
 }
 
+size_t VmPageList::FreePagesInRange(uint64_t start_offset, uint64_t end_offset) {
+    LTRACEF("%p start %#" PRIx64 " end %#" PRIx64 "\n", this, start_offset, end_offset);
+
+    list_node list;
+    list_initialize(&list);
+
+    size_t count = 0;
+
+    // seek to the first node that could overlap the range and walk forward,
+    // pulling pages out of each node that falls inside it
+    const uint64_t node_span = PAGE_SIZE * VmPageListNode::kPageFanOut;
+    auto it = list_.lower_bound(start_offset & ~(node_span - 1));
+    while (it.IsValid() && it->offset() < end_offset) {
+        it->ForEveryPage([&](vm_page*& p, uint64_t off) {
+            if (off >= start_offset && off < end_offset) {
+                list_add_tail(&list, &p->free.node);
+                p = nullptr;
+                count++;
+            }
+        });
+
+        // if the node emptied out, drop it from the tree
+        if (it->IsEmpty()) {
+            auto doomed = it;
+            ++it;
+            list_.erase(*doomed);
+        } else {
+            ++it;
+        }
+    }
+
+    // return all the pages to the pmm at once
+    if (count > 0) {
+        __UNUSED auto freed = pmm_free(&list);
+        DEBUG_ASSERT(freed == count);
+    }
+
+    return count;
+}
+
 size_t VmPageList::FreeAllPages() {
     LTRACEF("%p\n", this);
 
@@ -71,6 +71,25 @@ static bool pmm_oversized_alloc_test(void* context) {
     END_TEST;
 }
 
+// Allocates a contiguous run of pages and frees it. With
+// kernel.pmm.contig-reserve-mb set this exercises the reserve path.
+static bool pmm_contiguous_alloc_test(void* context) {
+    BEGIN_TEST;
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    static const size_t alloc_count = 8;
+
+    paddr_t pa;
+    auto count = pmm_alloc_contiguous(alloc_count, 0, PAGE_SIZE_SHIFT + 1, &pa, &list);
+    EXPECT_EQ(alloc_count, count, "pmm_alloc_contiguous count");
+    EXPECT_EQ(alloc_count, list_length(&list), "pmm_alloc_contiguous list count");
+    EXPECT_EQ(0u, pa % (2 * PAGE_SIZE), "pmm_alloc_contiguous alignment");
+
+    auto ret = pmm_free(&list);
+    EXPECT_EQ(alloc_count, ret, "pmm_free on contiguous run");
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -621,6 +640,46 @@ static bool vmo_read_write_smoke_test(void* context) {
     END_TEST;
 }
 
+// Creates two vm objects and moves pages between them, verifying that
+// the pages move rather than being copied.
+static bool vmo_transfer_test(void* context) {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    auto src = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size);
+    REQUIRE_NONNULL(src, "vmobject creation\n");
+    auto dst = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size);
+    REQUIRE_NONNULL(dst, "vmobject creation\n");
+
+    uint32_t pattern = 0x73570000;
+    size_t bytes_written;
+    auto err = src->Write(&pattern, 0, sizeof(pattern), &bytes_written);
+    EXPECT_EQ(NO_ERROR, err, "writing to object\n");
+
+    EXPECT_EQ(1u, src->AllocatedPages(), "pages committed in source\n");
+    EXPECT_EQ(0u, dst->AllocatedPages(), "pages committed in dest\n");
+
+    // misaligned arguments are rejected
+    err = src->TransferRange(dst, 1, 0, PAGE_SIZE, nullptr);
+    EXPECT_EQ(ERR_INVALID_ARGS, err, "misaligned transfer\n");
+
+    // move the whole range across; only one page is committed, so only
+    // one page's worth should move
+    uint64_t transferred;
+    err = src->TransferRange(dst, 0, 0, alloc_size, &transferred);
+    EXPECT_EQ(NO_ERROR, err, "transferring pages\n");
+    EXPECT_EQ((uint64_t)PAGE_SIZE, transferred, "bytes transferred\n");
+
+    EXPECT_EQ(0u, src->AllocatedPages(), "pages left in source\n");
+    EXPECT_EQ(1u, dst->AllocatedPages(), "pages landed in dest\n");
+
+    uint32_t check = 0;
+    size_t bytes_read;
+    err = dst->Read(&check, 0, sizeof(check), &bytes_read);
+    EXPECT_EQ(NO_ERROR, err, "reading from dest\n");
+    EXPECT_EQ(pattern, check, "moved page carries its contents\n");
+    END_TEST;
+}
+
 bool vmo_cache_test(void* context) {
     BEGIN_TEST;
 
@@ -692,6 +751,7 @@ UNITTEST_START_TESTCASE(vm_tests)
 VM_UNITTEST(pmm_smoke_test)
 VM_UNITTEST(pmm_large_alloc_test)
 VM_UNITTEST(pmm_oversized_alloc_test)
+VM_UNITTEST(pmm_contiguous_alloc_test)
 VM_UNITTEST(vmm_alloc_smoke_test)
 VM_UNITTEST(vmm_alloc_contiguous_smoke_test)
 VM_UNITTEST(multiple_regions_test)
@@ -711,6 +771,7 @@ VM_UNITTEST(vmo_dropped_ref_test)
 VM_UNITTEST(vmo_remap_test)
 VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
+VM_UNITTEST(vmo_transfer_test)
 VM_UNITTEST(vmo_cache_test)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
@@ -17,6 +17,7 @@
 #include <kernel/vm/vm_address_region.h>
 #include <kernel/vm/vm_aspace.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <string.h>
 #include <trace.h>
@@ -42,11 +43,15 @@ void vmm_context_switch(vmm_aspace_t* oldspace, vmm_aspace_t* newaspace) {
 
 void DumpProcessMemoryUsage(const char* prefix, size_t min_pages);
 
+KCOUNTER(vmm_page_faults, "kernel.vm.page_faults");
+
 status_t vmm_page_fault_handler(vaddr_t addr, uint flags) {
 
     // hardware fault, mark it as such
     flags |= VMM_PF_FLAG_HW_FAULT;
 
+    kcounter_add(&vmm_page_faults, 1);
+
 #if TRACE_PAGE_FAULT || LOCAL_TRACE
     thread_t* current_thread = get_current_thread();
     TRACEF("thread %s va %#" PRIxPTR ", flags 0x%x\n", current_thread->name, addr, flags);
@@ -0,0 +1,93 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/counters.h>
+
+#include <arch/defines.h>
+#include <assert.h>
+#include <debug.h>
+#include <err.h>
+#include <kernel/mp.h>
+#include <kernel/vm/vm_address_region.h>
+#include <kernel/vm/vm_aspace.h>
+#include <kernel/vm/vm_object_paged.h>
+#include <lk/init.h>
+#include <magenta/kcounter.h>
+#include <mxtl/ref_ptr.h>
+#include <string.h>
+
+int64_t* kcounters_arena;
+size_t kcounters_arena_stride;
+
+static mxtl::RefPtr<VmObject> kcounters_vmo;
+static mxtl::RefPtr<VmMapping> kcounters_mapping;
+
+mxtl::RefPtr<VmObject> kcounters_get_vmo() {
+    return kcounters_vmo;
+}
+
+static void counters_init(uint level) {
+    size_t num = kcounter_index(__stop_kcountdesc);
+    if (num == 0)
+        return;
+
+    // Pad each cpu's row of slots out to a cache line multiple so no two
+    // cpus ever write the same line.
+    size_t stride =
+        ROUNDUP(num * sizeof(int64_t), MAX_CACHE_LINE) / sizeof(int64_t);
+    size_t arena_offset = ROUNDUP(
+        sizeof(mx_kcounter_header_t) + num * MX_KCOUNTER_NAME_LEN, PAGE_SIZE);
+    size_t size = arena_offset + SMP_MAX_CPUS * stride * sizeof(int64_t);
+
+    auto vmo = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, size);
+    if (!vmo) {
+        dprintf(INFO, "counters: no memory for %zu counters\n", num);
+        return;
+    }
+
+    // Map the whole thing in the kernel address space and commit the
+    // pages up front so the hot-path increments never fault.
+    mxtl::RefPtr<VmMapping> mapping;
+    status_t status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0 /* ignored */, size, 0 /* align pow2 */, 0 /* vmar flags */,
+        vmo, 0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE,
+        "kcounters", &mapping);
+    if (status != NO_ERROR) {
+        dprintf(INFO, "counters: cannot map arena: %d\n", status);
+        return;
+    }
+    status = mapping->MapRange(0, size, true);
+    if (status != NO_ERROR) {
+        dprintf(INFO, "counters: cannot commit arena: %d\n", status);
+        mapping->Destroy();
+        return;
+    }
+
+    // Fill in the header and name table; the arena itself starts out as
+    // freshly committed zero pages, which is exactly what we want.
+    uintptr_t base = mapping->base();
+    auto hdr = reinterpret_cast<mx_kcounter_header_t*>(base);
+    hdr->magic = MX_KCOUNTER_MAGIC;
+    hdr->version = MX_KCOUNTER_VERSION;
+    hdr->num_counters = num;
+    hdr->max_cpus = SMP_MAX_CPUS;
+    hdr->arena_offset = arena_offset;
+    hdr->arena_stride = stride;
+    char* names = reinterpret_cast<char*>(hdr + 1);
+    for (size_t i = 0; i < num; ++i) {
+        strlcpy(names + i * MX_KCOUNTER_NAME_LEN,
+                __start_kcountdesc[i].name, MX_KCOUNTER_NAME_LEN);
+    }
+
+    kcounters_vmo = mxtl::move(vmo);
+    kcounters_mapping = mxtl::move(mapping);
+
+    // Publish the arena last; kcounter_add gates on the pointer alone.
+    kcounters_arena_stride = stride;
+    kcounters_arena = reinterpret_cast<int64_t*>(base + arena_offset);
+}
+
+LK_INIT_HOOK(kcounters, counters_init, LK_INIT_LEVEL_THREADING);
@@ -6,13 +6,16 @@
 
 #include <lib/crypto/global_prng.h>
 
+#include <arch/ops.h>
 #include <assert.h>
 #include <ctype.h>
 #include <dev/hw_rng.h>
 #include <err.h>
 #include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
+#include <kernel/mp.h>
 #include <kernel/mutex.h>
+#include <kernel/spinlock.h>
 #include <lib/crypto/cryptolib.h>
 #include <lib/crypto/prng.h>
 #include <mxcpp/new.h>
@@ -31,6 +34,65 @@ PRNG* GetInstance() {
     return kGlobalPrng;
 }
 
+// Per-cpu PRNG instances fronting the global one. Draws run on the local
+// instance with interrupts disabled (the same discipline as the pmm's
+// per-cpu page caches), so the common path never touches the shared lock.
+// Each instance mixes fresh entropy from the global PRNG back in after
+// kReseedBytes of output.
+static PRNG* per_cpu_prng[SMP_MAX_CPUS];
+static size_t per_cpu_drawn[SMP_MAX_CPUS];
+
+// Largest draw served from the local instance; interrupts stay off for the
+// duration, and requests bigger than this are rare.
+static constexpr size_t kMaxLocalDrawLen = 256;
+
+// Output each instance may generate before it is reseeded.
+static constexpr size_t kReseedBytes = 64 * 1024;
+
+void Draw(void* out, size_t size) {
+    if (unlikely(size > kMaxLocalDrawLen)) {
+        GetInstance()->Draw(out, size);
+        return;
+    }
+
+    // Fetch any due reseed before entering the interrupt-off section, since
+    // drawing from the global instance takes its lock and may block. The
+    // unlocked counter read is racy, but that only makes a reseed a little
+    // early or late; which instance gets the seed is decided below.
+    uint8_t seed[PRNG::kMinEntropy];
+    bool have_seed = false;
+    uint cpu = arch_curr_cpu_num();
+    if (likely(per_cpu_prng[cpu] != nullptr) &&
+        unlikely(per_cpu_drawn[cpu] >= kReseedBytes)) {
+        GetInstance()->Draw(seed, sizeof(seed));
+        have_seed = true;
+    }
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    cpu = arch_curr_cpu_num();
+    PRNG* prng = per_cpu_prng[cpu];
+    if (unlikely(prng == nullptr)) {
+        // early boot; the per-cpu instances aren't up yet
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+        GetInstance()->Draw(out, size);
+        return;
+    }
+
+    if (unlikely(have_seed)) {
+        prng->AddEntropy(seed, sizeof(seed));
+        per_cpu_drawn[cpu] = 0;
+    }
+    prng->Draw(out, size);
+    per_cpu_drawn[cpu] += size;
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    if (have_seed)
+        memset(seed, 0, sizeof(seed));
+}
+
 // TODO(security): Remove this in favor of virtio-rng once it is available and
 // we decide we don't need it for getting entropy from elsewhere.
 static size_t IntegrateCmdlineEntropy() {
@@ -114,6 +176,25 @@ static void BecomeThreadSafe(uint level) {
     GetInstance()->BecomeThreadSafe();
 }
 
+// Bring up the per-cpu instances, each seeded from the (by now thread-safe)
+// global PRNG. Until this runs, Draw() falls through to the global instance.
+static void PerCpuSeed(uint level) {
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        uint8_t seed[PRNG::kMinEntropy];
+        GetInstance()->Draw(seed, sizeof(seed));
+
+        AllocChecker ac;
+        PRNG* prng = new (&ac) PRNG(seed, sizeof(seed), PRNG::NonThreadSafeTag());
+        ASSERT(ac.check());
+        memset(seed, 0, sizeof(seed));
+
+        // make sure the instance is fully constructed before other cpus can
+        // observe the pointer
+        smp_mb();
+        per_cpu_prng[i] = prng;
+    }
+}
+
 } //namespace GlobalPRNG
 
 } // namespace crypto
@@ -123,3 +204,6 @@ LK_INIT_HOOK(global_prng_seed, crypto::GlobalPRNG::EarlyBootSeed,
 
 LK_INIT_HOOK(global_prng_thread_safe, crypto::GlobalPRNG::BecomeThreadSafe,
              LK_INIT_LEVEL_THREADING - 1)
+
+LK_INIT_HOOK(global_prng_per_cpu, crypto::GlobalPRNG::PerCpuSeed,
+             LK_INIT_LEVEL_THREADING)
@@ -7,6 +7,7 @@
 #include <lib/crypto/global_prng.h>
 
 #include <stdint.h>
+#include <string.h>
 #include <unittest.h>
 
 namespace crypto {
@@ -24,10 +25,30 @@ bool identical(void*) {
     END_TEST;
 }
 
+bool per_cpu_draw(void*) {
+    BEGIN_TEST;
+
+    // draws served by the per-cpu path should produce distinct output
+    uint8_t buf1[16] = {0};
+    uint8_t buf2[16] = {0};
+    GlobalPRNG::Draw(buf1, sizeof(buf1));
+    GlobalPRNG::Draw(buf2, sizeof(buf2));
+    EXPECT_NEQ(memcmp(buf1, buf2, sizeof(buf1)), 0, "");
+
+    // oversized draws fall back to the global instance
+    static uint8_t big[512];
+    static uint8_t zero[512];
+    GlobalPRNG::Draw(big, sizeof(big));
+    EXPECT_NEQ(memcmp(big, zero, sizeof(big)), 0, "");
+
+    END_TEST;
+}
+
 } // namespace
 
 UNITTEST_START_TESTCASE(global_prng_tests)
 UNITTEST("Identical", identical)
+UNITTEST("PerCpuDraw", per_cpu_draw)
 UNITTEST_END_TESTCASE(global_prng_tests, "global_prng",
                       "Validate global PRNG singleton",
                       nullptr, nullptr);
@@ -16,6 +16,12 @@ namespace GlobalPRNG {
 // guaranteed to be non-null.
 PRNG* GetInstance();
 
+// Draws |size| bytes of pseudo-random data from the calling cpu's PRNG
+// instance, which periodically reseeds itself from the global singleton.
+// The common path touches no shared lock.  Large requests and requests
+// made before the per-cpu instances are up are served by the singleton.
+void Draw(void* out, size_t size);
+
 } //namespace GlobalPRNG
 
 } // namespace crypto
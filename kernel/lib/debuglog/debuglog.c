@@ -10,6 +10,7 @@
 #include <dev/udisplay.h>
 #include <kernel/spinlock.h>
 #include <kernel/thread.h>
+#include <magenta/atomic.h>
 #include <lib/user_copy.h>
 #include <lib/io.h>
 #include <lib/version.h>
@@ -27,8 +28,8 @@ static_assert((DLOG_MAX_RECORD & 3) == 0, "E_DONT_DO_THAT");
 static uint8_t DLOG_DATA[DLOG_SIZE];
 
 static dlog_t DLOG = {
-    .lock = SPIN_LOCK_INITIAL_VALUE,
     .head = 0,
+    .head_reserve = 0,
     .tail = 0,
     .data = DLOG_DATA,
     .event = EVENT_INITIAL_VALUE(DLOG.event, 0, EVENT_FLAG_AUTOUNSIGNAL),
@@ -46,7 +47,7 @@ static dlog_t DLOG = {
 // or body may wrap but the initial header word never does).
 //
 // The ring buffer position is maintained by continuously incrementing
-// head and tail pointers (type size_t, so uint64_t on 64bit systems),
+// 64bit head and tail pointers.
 //
 // This allows readers to trivial compute if their local tail
 // pointer has "fallen out" of the fifo (an entire fifo's worth
@@ -62,6 +63,14 @@ static dlog_t DLOG = {
 //       T                     T
 //  [....XXXX....]  [XX........XX]
 //           H         H
+//
+// Writers do not serialize through a lock.  A writer claims space by
+// advancing head_reserve with a compare and swap (discarding records at
+// tail first if the fifo is full), copies its record into the claimed
+// region concurrently with writers on other cpus, then publishes it by
+// advancing head once all earlier reservations have committed.  Readers
+// only trust data below head, and revalidate against tail after copying
+// a record out in case a writer lapped them mid copy.
 
 
 #define ALIGN4(n) (((n) + 3) & (~3))
@@ -97,17 +106,42 @@ status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
         hdr.tid = 0;
     }
 
+    // interrupts are disabled from reserve to commit so that a writer on
+    // this cpu (including one in interrupt context) can never spin behind
+    // an uncommitted reservation made underneath it
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-    // Discard records at tail until there is enough
-    // space for the new record.
-    while ((log->head - log->tail) > (DLOG_SIZE - wiresize)) {
-        uint32_t header = *((uint32_t*) (log->data + (log->tail & DLOG_MASK)));
-        log->tail += DLOG_HDR_GET_FIFOLEN(header);
+    // reserve space for the record by advancing head_reserve,
+    // discarding records at tail if the fifo is full
+    uint64_t reserve;
+    for (;;) {
+        reserve = atomic_load_u64(&log->head_reserve);
+        uint64_t tail = atomic_load_u64(&log->tail);
+
+        if ((reserve - tail) > (DLOG_SIZE - wiresize)) {
+            uint64_t commit = atomic_load_u64(&log->head);
+            if (tail == commit) {
+                // all space between tail and our would-be reservation is
+                // uncommitted; wait for other writers to finish copying
+                arch_spinloop_pause();
+                continue;
+            }
+            // discard the oldest committed record.  if another writer beats
+            // us to it the cmpxchg fails and we simply reevaluate.
+            uint32_t header = *((uint32_t*) (log->data + (tail & DLOG_MASK)));
+            atomic_cmpxchg_u64(&log->tail, &tail, tail + DLOG_HDR_GET_FIFOLEN(header));
+            continue;
+        }
+
+        if (atomic_cmpxchg_u64(&log->head_reserve, &reserve, reserve + wiresize)) {
+            break;
+        }
     }
 
-    size_t offset = (log->head & DLOG_MASK);
+    // copy the record into the reserved region, possibly concurrently
+    // with writers on other cpus filling their own reservations
+    size_t offset = (reserve & DLOG_MASK);
 
     size_t fifospace = DLOG_SIZE - offset;
 
@@ -128,7 +162,15 @@ status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
         memcpy(log->data + offset, ptr, fifospace);
         memcpy(log->data, ptr + fifospace, len - fifospace);
     }
-    log->head += wiresize;
+
+    // commit in reservation order: wait for earlier reservations to land,
+    // then publish ours by advancing head past it
+    while (atomic_load_u64(&log->head) != reserve) {
+        arch_spinloop_pause();
+    }
+    atomic_store_u64(&log->head, reserve + wiresize);
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     // if we happen to be called from within the global thread lock, use a
     // special version of event signal
@@ -138,13 +180,15 @@ status_t dlog_write(uint32_t flags, const void* ptr, size_t len) {
         event_signal(&log->event, false);
     }
 
-    spin_unlock_irqrestore(&log->lock, state);
-
     return NO_ERROR;
 }
 
-// TODO: support reading multiple messages at a time
 // TODO: filter with flags
+//
+// Copies out as many whole records as fit in len, each one starting on a
+// uint32_t boundary so callers can walk the batch by advancing past
+// ALIGN4(DLOG_MIN_RECORD + datalen) per record.  Returns the total bytes
+// copied (the final record is not padded).
 status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, size_t* _actual) {
     // must be room for worst-case read
     if (len < DLOG_MAX_RECORD) {
@@ -152,46 +196,78 @@ status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* ptr, size_t len, si
     }
 
     dlog_t* log = rdr->log;
-    status_t status = ERR_SHOULD_WAIT;
+    size_t total = 0;
+    uint64_t rtail = rdr->tail;
 
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
-
-    size_t rtail = rdr->tail;
+    for (;;) {
+        uint64_t head = atomic_load_u64(&log->head);
+        uint64_t tail = atomic_load_u64(&log->tail);
+
+        // If the read-tail is not within the range of log-tail..log-head
+        // this reader has been lapped by a writer and we reset our read-tail
+        // to the current log-tail.
+        //
+        if ((head - tail) < (head - rtail)) {
+            rtail = tail;
+        }
 
-    // If the read-tail is not within the range of log-tail..log-head
-    // this reader has been lapped by a writer and we reset our read-tail
-    // to the current log-tail.
-    //
-    if ((log->head - log->tail) < (log->head - rtail)) {
-        rtail = log->tail;
-    }
+        if (rtail == head) {
+            break;
+        }
 
-    if (rtail != log->head) {
         size_t offset = (rtail & DLOG_MASK);
         uint32_t header = *((uint32_t*) (log->data + offset));
 
         size_t actual = DLOG_HDR_GET_READLEN(header);
+        size_t fifolen = DLOG_HDR_GET_FIFOLEN(header);
+
+        // a header that doesn't describe a plausible record means a writer
+        // lapped us and overwrote it between the checks above and the read;
+        // resync to the current log-tail and retry
+        if ((fifolen < DLOG_MIN_RECORD) || (fifolen > DLOG_MAX_RECORD) ||
+            (actual < DLOG_MIN_RECORD) || (actual > fifolen)) {
+            rtail = atomic_load_u64(&log->tail);
+            continue;
+        }
+
+        // records after the first start on the next uint32_t boundary so
+        // their header word can be read whole; zero the pad bytes
+        size_t woff = ALIGN4(total);
+
+        // stop once the next record no longer fits in the caller's buffer
+        if ((woff > len) || (actual > (len - woff))) {
+            break;
+        }
+
         size_t fifospace = DLOG_SIZE - offset;
 
         if (fifospace >= actual) {
-            memcpy(ptr, log->data + offset, actual);
+            memcpy(ptr + woff, log->data + offset, actual);
         } else {
-            memcpy(ptr, log->data + offset, fifospace);
-            memcpy(ptr + fifospace, log->data, actual - fifospace);
+            memcpy(ptr + woff, log->data + offset, fifospace);
+            memcpy(ptr + woff + fifospace, log->data, actual - fifospace);
         }
 
-        *_actual = actual;
-        status = NO_ERROR;
+        // if log-tail passed this record while we were copying, the copy
+        // may be torn; discard it and resync to the current log-tail
+        if (atomic_load_u64(&log->tail) > rtail) {
+            rtail = atomic_load_u64(&log->tail);
+            continue;
+        }
 
-        rtail += DLOG_HDR_GET_FIFOLEN(header);
+        memset(ptr + total, 0, woff - total);
+        total = woff + actual;
+        rtail += fifolen;
     }
 
     rdr->tail = rtail;
 
-    spin_unlock_irqrestore(&log->lock, state);
+    if (total == 0) {
+        return ERR_SHOULD_WAIT;
+    }
 
-    return status;
+    *_actual = total;
+    return NO_ERROR;
 }
 
 void dlog_reader_init(dlog_reader_t* rdr, void (*notify)(void*), void* cookie) {
@@ -204,13 +280,8 @@ void dlog_reader_init(dlog_reader_t* rdr, void (*notify)(void*), void* cookie) {
     mutex_acquire(&log->readers_lock);
     list_add_tail(&log->readers, &rdr->node);
 
-    bool do_notify = false;
-
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&log->lock, state);
-    rdr->tail = log->tail;
-    do_notify = (log->tail != log->head);
-    spin_unlock_irqrestore(&log->lock, state);
+    rdr->tail = atomic_load_u64(&log->tail);
+    bool do_notify = (rdr->tail != atomic_load_u64(&log->head));
 
     // simulate notify callback for events that arrived
     // before we were initialized
@@ -36,10 +36,13 @@ typedef struct dlog_record dlog_record_t;
 typedef struct dlog_reader dlog_reader_t;
 
 struct dlog {
-    spin_lock_t lock;
-
-    size_t head;
-    size_t tail;
+    // monotonically increasing fifo positions; writers reserve space by
+    // advancing head_reserve, commit it in order by advancing head, and
+    // make room by advancing tail.  all three are only touched with the
+    // atomic_*_u64 helpers, there is no writer lock.
+    uint64_t head;
+    uint64_t head_reserve;
+    uint64_t tail;
 
     void* data;
 
@@ -55,7 +58,7 @@ struct dlog_reader {
     struct list_node node;
 
     dlog_t* log;
-    size_t tail;
+    uint64_t tail;
 
     void (*notify)(void* cookie);
     void *cookie;
@@ -9,20 +9,57 @@
 #include <assert.h>
 #include <err.h>
 #include <list.h>
+#include <stdio.h>
 #include <trace.h>
 
+#include <arch/ops.h>
 #include <kernel/event.h>
 #include <kernel/spinlock.h>
 #include <lk/init.h>
 
+/* each cpu has its own dpc queues and a worker pinned to it, so dpcs queued
+ * from a cpu run locally and bulk work on one cpu does not delay the others.
+ * a single lock covers every queue; it is only held for list manipulation,
+ * and keeping it global means dpc_cancel does not need to know which cpu a
+ * dpc was queued on.
+ */
+struct dpc_cpu_queue {
+    struct list_node list[DPC_NUM_PRI];
+    event_t event;
+    thread_t *thread;   // NULL until this cpu's worker is running
+    bool initialized;
+};
+
 static spin_lock_t dpc_lock = SPIN_LOCK_INITIAL_VALUE;
-static struct list_node dpc_list = LIST_INITIAL_VALUE(dpc_list);
-static event_t dpc_event = EVENT_INITIAL_VALUE(dpc_event, false, 0);
+static struct dpc_cpu_queue dpc_queues[SMP_MAX_CPUS];
+
+static void dpc_queue_init_locked(struct dpc_cpu_queue *q)
+{
+    if (!q->initialized) {
+        for (uint i = 0; i < DPC_NUM_PRI; i++)
+            list_initialize(&q->list[i]);
+        event_init(&q->event, false, 0);
+        q->initialized = true;
+    }
+}
+
+static struct dpc_cpu_queue *dpc_get_queue_locked(void)
+{
+    struct dpc_cpu_queue *q = &dpc_queues[arch_curr_cpu_num()];
+
+    // until this cpu's worker is running, let the boot cpu's worker do the work
+    if (!q->thread)
+        q = &dpc_queues[0];
+
+    dpc_queue_init_locked(q);
+    return q;
+}
 
 status_t dpc_queue(dpc_t *dpc, bool reschedule)
 {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
+    DEBUG_ASSERT(dpc->pri < DPC_NUM_PRI);
 
     if (list_in_list(&dpc->node))
         return NO_ERROR;
@@ -30,9 +67,10 @@ status_t dpc_queue(dpc_t *dpc, bool reschedule)
     spin_lock_saved_state_t state;
     spin_lock_irqsave(&dpc_lock, state);
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&dpc_list, &dpc->node);
-    event_signal(&dpc_event, false);
+    // put the dpc at the tail of its priority band and signal the worker
+    struct dpc_cpu_queue *q = dpc_get_queue_locked();
+    list_add_tail(&q->list[dpc->pri], &dpc->node);
+    event_signal(&q->event, false);
 
     spin_unlock_irqrestore(&dpc_lock, state);
 
@@ -47,6 +85,7 @@ status_t dpc_queue_thread_locked(dpc_t *dpc)
 {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
+    DEBUG_ASSERT(dpc->pri < DPC_NUM_PRI);
 
     if (list_in_list(&dpc->node))
         return NO_ERROR;
@@ -54,9 +93,10 @@ status_t dpc_queue_thread_locked(dpc_t *dpc)
     spin_lock_saved_state_t state;
     spin_lock_irqsave(&dpc_lock, state);
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&dpc_list, &dpc->node);
-    event_signal_thread_locked(&dpc_event);
+    // put the dpc at the tail of its priority band and signal the worker
+    struct dpc_cpu_queue *q = dpc_get_queue_locked();
+    list_add_tail(&q->list[dpc->pri], &dpc->node);
+    event_signal_thread_locked(&q->event);
 
     spin_unlock_irqrestore(&dpc_lock, state);
 
@@ -83,20 +123,24 @@ bool dpc_cancel(dpc_t *dpc)
 
 static int dpc_thread(void *arg)
 {
+    struct dpc_cpu_queue *q = (struct dpc_cpu_queue *)arg;
+
     for (;;) {
         // wait for a dpc to fire
-        __UNUSED status_t err = event_wait(&dpc_event);
+        __UNUSED status_t err = event_wait(&q->event);
         DEBUG_ASSERT(err == NO_ERROR);
 
         spin_lock_saved_state_t state;
         spin_lock_irqsave(&dpc_lock, state);
 
-        // pop a dpc off the list
-        dpc_t *dpc = list_remove_head_type(&dpc_list, dpc_t, node);
+        // pop the highest priority pending dpc off this cpu's lists
+        dpc_t *dpc = list_remove_head_type(&q->list[DPC_PRI_HIGH], dpc_t, node);
+        if (!dpc)
+            dpc = list_remove_head_type(&q->list[DPC_PRI_LOW], dpc_t, node);
 
-        // if the list is now empty, unsignal the event so we block until it is
+        // if the lists are now empty, unsignal the event so we block until it is
         if (!dpc)
-            event_unsignal(&dpc_event);
+            event_unsignal(&q->event);
 
         spin_unlock_irqrestore(&dpc_lock, state);
 
@@ -111,8 +155,28 @@ static int dpc_thread(void *arg)
 
 static void dpc_init(unsigned int level)
 {
-    thread_t *t = thread_create("dpc", &dpc_thread, NULL, DPC_THREAD_PRIORITY, DEFAULT_STACK_SIZE);
+    uint cpu = arch_curr_cpu_num();
+    struct dpc_cpu_queue *q = &dpc_queues[cpu];
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&dpc_lock, state);
+    dpc_queue_init_locked(q);
+    spin_unlock_irqrestore(&dpc_lock, state);
+
+    char name[16];
+    snprintf(name, sizeof(name), "dpc-%u", cpu);
+    thread_t *t = thread_create(name, &dpc_thread, q, DPC_THREAD_PRIORITY, DEFAULT_STACK_SIZE);
+    thread_set_pinned_cpu(t, (int)cpu);
+
+    // publish the worker; dpc_queue targets this cpu's queue from here on
+    spin_lock_irqsave(&dpc_lock, state);
+    q->thread = t;
+    spin_unlock_irqrestore(&dpc_lock, state);
+
     thread_detach_and_resume(t);
 }
 
-LK_INIT_HOOK(dpc, dpc_init, LK_INIT_LEVEL_THREADING);
+/* runs on every cpu as it reaches the threading level so each gets its own
+ * pinned worker
+ */
+LK_INIT_HOOK_FLAGS(dpc, dpc_init, LK_INIT_LEVEL_THREADING, LK_INIT_FLAG_ALL_CPUS);
@@ -13,6 +13,14 @@ __BEGIN_CDECLS
 
 #define DPC_THREAD_PRIORITY HIGH_PRIORITY
 
+/* dpc priority bands. high priority dpcs on a cpu always run before any
+ * queued low priority ones, so completion-side work (block, network,
+ * timers) does not wait behind bulk cleanup.
+ */
+#define DPC_PRI_LOW  0
+#define DPC_PRI_HIGH 1
+#define DPC_NUM_PRI  2
+
 struct dpc;
 typedef void (*dpc_func_t)(struct dpc *);
 
@@ -21,6 +29,7 @@ typedef struct dpc {
 
     dpc_func_t func;
     void *arg;
+    uint32_t pri;       /* DPC_PRI_LOW or DPC_PRI_HIGH */
 } dpc_t;
 
 #define DPC_INITIAL_VALUE \
@@ -28,10 +37,12 @@ typedef struct dpc {
     .node = LIST_INITIAL_CLEARED_VALUE, \
     .func = 0, \
     .arg = 0, \
+    .pri = DPC_PRI_LOW, \
 }
 
 /* queue an already filled out dpc, optionally reschedule immediately to run the dpc thread */
-/* the deferred procedure runs in a dedicated thread that runs at DPC_THREAD_PRIORITY */
+/* the deferred procedure runs in a per-cpu worker thread at DPC_THREAD_PRIORITY; dpcs are */
+/* queued to the current cpu's worker, falling back to the boot cpu's until it is running */
 status_t dpc_queue(dpc_t *dpc, bool reschedule);
 
 /* queue a dpc, but must be holding the thread lock */
@@ -43,4 +54,3 @@ status_t dpc_queue_thread_locked(dpc_t *dpc);
 bool dpc_cancel(dpc_t *dpc);
 
 __END_CDECLS
-
@@ -172,38 +172,35 @@ static void putpixel8(gfx_surface *surface, uint x, uint y, uint color)
     *dest = (uint8_t)(surface->translate_color(color));
 }
 
+// Copy a rect one row at a time with memmove, in an order that is safe
+// for overlapping source and destination rects (the scroll case).
+// memmove handles any overlap within a row, and copying the rows
+// bottom-up when the destination is below the source handles overlap
+// between rows. The row routines use the wide copy and store paths the
+// cpu offers, so the per-pixel loops these replace were leaving most
+// of the framebuffer's write bandwidth on the table.
 static void copyrect8(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
 {
-    // copy
     const uint8_t *src = &((const uint8_t *)surface->ptr)[x + y * surface->stride];
     uint8_t *dest = &((uint8_t *)surface->ptr)[x2 + y2 * surface->stride];
-    uint stride_diff = surface->stride - width;
 
     if (dest < src) {
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest += surface->stride;
+            src += surface->stride;
         }
     } else {
-        // copy backwards
-        src += height * surface->stride + width;
-        dest += height * surface->stride + width;
+        // copy bottom-up
+        src += (height - 1) * surface->stride;
+        dest += (height - 1) * surface->stride;
 
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest -= surface->stride;
+            src -= surface->stride;
         }
     }
 }
@@ -211,52 +208,38 @@ static void copyrect8(gfx_surface *surface, uint x, uint y, uint width, uint hei
 static void fillrect8(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
 {
     uint8_t *dest = &((uint8_t *)surface->ptr)[x + y * surface->stride];
-    uint stride_diff = surface->stride - width;
 
     uint8_t color8 = (uint8_t)(surface->translate_color(color));
 
-    uint i, j;
+    uint i;
     for (i=0; i < height; i++) {
-        for (j=0; j < width; j++) {
-            *dest = color8;
-            dest++;
-        }
-        dest += stride_diff;
+        memset(dest, color8, width);
+        dest += surface->stride;
     }
 }
 
 static void copyrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
 {
-    // copy
     const uint16_t *src = &((const uint16_t *)surface->ptr)[x + y * surface->stride];
     uint16_t *dest = &((uint16_t *)surface->ptr)[x2 + y2 * surface->stride];
-    uint stride_diff = surface->stride - width;
 
     if (dest < src) {
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest += surface->stride;
+            src += surface->stride;
         }
     } else {
-        // copy backwards
-        src += height * surface->stride + width;
-        dest += height * surface->stride + width;
+        // copy bottom-up
+        src += (height - 1) * surface->stride;
+        dest += (height - 1) * surface->stride;
 
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest -= surface->stride;
+            src -= surface->stride;
         }
     }
 }
@@ -264,52 +247,45 @@ static void copyrect16(gfx_surface *surface, uint x, uint y, uint width, uint he
 static void fillrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
 {
     uint16_t *dest = &((uint16_t *)surface->ptr)[x + y * surface->stride];
-    uint stride_diff = surface->stride - width;
 
     uint16_t color16 = (uint16_t)(surface->translate_color(color));
 
-    uint i, j;
-    for (i=0; i < height; i++) {
-        for (j=0; j < width; j++) {
-            *dest = color16;
-            dest++;
-        }
-        dest += stride_diff;
+    // fill the first row by pixel, then replicate it with memcpy
+    uint j;
+    for (j=0; j < width; j++) {
+        dest[j] = color16;
+    }
+
+    uint16_t *row = dest;
+    uint i;
+    for (i=1; i < height; i++) {
+        row += surface->stride;
+        memcpy(row, dest, width * sizeof(*dest));
     }
 }
 
 static void copyrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
 {
-    // copy
     const uint32_t *src = &((const uint32_t *)surface->ptr)[x + y * surface->stride];
     uint32_t *dest = &((uint32_t *)surface->ptr)[x2 + y2 * surface->stride];
-    uint stride_diff = surface->stride - width;
 
     if (dest < src) {
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest += surface->stride;
+            src += surface->stride;
         }
     } else {
-        // copy backwards
-        src += height * surface->stride + width;
-        dest += height * surface->stride + width;
+        // copy bottom-up
+        src += (height - 1) * surface->stride;
+        dest += (height - 1) * surface->stride;
 
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest -= surface->stride;
+            src -= surface->stride;
         }
     }
 }
@@ -317,15 +293,18 @@ static void copyrect32(gfx_surface *surface, uint x, uint y, uint width, uint he
 static void fillrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
 {
     uint32_t *dest = &((uint32_t *)surface->ptr)[x + y * surface->stride];
-    uint stride_diff = surface->stride - width;
 
-    uint i, j;
-    for (i=0; i < height; i++) {
-        for (j=0; j < width; j++) {
-            *dest = color;
-            dest++;
-        }
-        dest += stride_diff;
+    // fill the first row by pixel, then replicate it with memcpy
+    uint j;
+    for (j=0; j < width; j++) {
+        dest[j] = color;
+    }
+
+    uint32_t *row = dest;
+    uint i;
+    for (i=1; i < height; i++) {
+        row += surface->stride;
+        memcpy(row, dest, width * sizeof(*dest));
     }
 }
 
@@ -447,20 +426,14 @@ void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, u
         // 16 bit to 16 bit
         const uint16_t *src = (const uint16_t *)source->ptr;
         uint16_t *dest = &((uint16_t *)target->ptr)[destx + desty * target->stride];
-        uint dest_stride_diff = target->stride - width;
-        uint source_stride_diff = source->stride - width;
 
-        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+            memcpy(dest, src, width * sizeof(*dest));
+            dest += target->stride;
+            src += source->stride;
         }
     } else if (source->format == GFX_FORMAT_ARGB_8888 && target->format == GFX_FORMAT_ARGB_8888) {
         // both are 32 bit modes, both alpha
@@ -486,39 +459,27 @@ void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, u
         // both are 32 bit modes, no alpha
         const uint32_t *src = (const uint32_t *)source->ptr;
         uint32_t *dest = &((uint32_t *)target->ptr)[destx + desty * target->stride];
-        uint dest_stride_diff = target->stride - width;
-        uint source_stride_diff = source->stride - width;
 
-        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+            memcpy(dest, src, width * sizeof(*dest));
+            dest += target->stride;
+            src += source->stride;
         }
     } else if (source->format == GFX_FORMAT_MONO && target->format == GFX_FORMAT_MONO) {
         // both are 8 bit modes, no alpha
         const uint8_t *src = (const uint8_t *)source->ptr;
         uint8_t *dest = &((uint8_t *)target->ptr)[destx + desty * target->stride];
-        uint dest_stride_diff = target->stride - width;
-        uint source_stride_diff = source->stride - width;
 
-        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-        uint i, j;
+        uint i;
         for (i=0; i < height; i++) {
-            for (j=0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+            memcpy(dest, src, width * sizeof(*dest));
+            dest += target->stride;
+            src += source->stride;
         }
     } else {
         panic("gfx_surface_blend: unimplemented colorspace combination (source %u target %u)\n", source->format, target->format);
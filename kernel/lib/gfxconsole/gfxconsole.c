@@ -53,14 +53,30 @@ static struct {
 
     uint x, y;
 
+    // span of pixel rows touched since the last flush, and how many
+    // pixel rows the console scrolled up in that time; the print
+    // callback uses these so a multi-line print composites and
+    // flushes each changed region only once
+    uint dirty_y0, dirty_y1;
+    uint scrolled;
+
     uint32_t front_color;
     uint32_t back_color;
 } gfxconsole;
 
+static void mark_dirty(uint y, uint height)
+{
+    if (y < gfxconsole.dirty_y0)
+        gfxconsole.dirty_y0 = y;
+    if (y + height > gfxconsole.dirty_y1)
+        gfxconsole.dirty_y1 = y + height;
+}
+
 static void draw_char(char c)
 {
     font_draw_char(gfxconsole.surface, c, gfxconsole.x * FONT_X, gfxconsole.y * FONT_Y,
                    gfxconsole.front_color, gfxconsole.back_color);
+    mark_dirty(gfxconsole.y * FONT_Y, FONT_Y);
 }
 
 void gfxconsole_putpixel(unsigned x, unsigned y, unsigned color) {
@@ -130,7 +146,16 @@ static bool gfxconsole_putc(char c)
         // clear the bottom line
         gfx_fillrect(gfxconsole.surface, 0, gfxconsole.surface->height - FONT_Y - gfxconsole.extray,
                      gfxconsole.surface->width, FONT_Y, gfxconsole.back_color);
-        gfx_flush(gfxconsole.surface);
+
+        // slide the pending dirty span up with the scroll and add the
+        // freshly cleared line; the print callback replays the scroll
+        // and flushes once for the whole print
+        if (gfxconsole.dirty_y1 > 0) {
+            gfxconsole.dirty_y0 = (gfxconsole.dirty_y0 > FONT_Y) ? gfxconsole.dirty_y0 - FONT_Y : 0;
+            gfxconsole.dirty_y1 -= FONT_Y;
+        }
+        gfxconsole.scrolled += FONT_Y;
+        mark_dirty(gfxconsole.surface->height - FONT_Y - gfxconsole.extray, FONT_Y);
         inval = 1;
     }
     return inval;
@@ -138,28 +163,55 @@ static bool gfxconsole_putc(char c)
 
 static void gfxconsole_print_callback(print_callback_t *cb, const char *str, size_t len)
 {
-    int refresh_full_screen = 0;
     for (size_t i = 0; i < len; i++) {
         if (str[i] == '\n')
             gfxconsole_putc('\r');
-        refresh_full_screen |= gfxconsole_putc(str[i]);
+        gfxconsole_putc(str[i]);
+    }
+
+    uint y0 = gfxconsole.dirty_y0;
+    uint y1 = gfxconsole.dirty_y1;
+    if (y0 >= y1) {
+        // nothing was drawn (cursor movement only)
+        return;
     }
 
-    // blit from the software surface to the hardware
     if (gfxconsole.surface != gfxconsole.hw_surface) {
-        if (refresh_full_screen) {
-            gfx_surface_blend(gfxconsole.hw_surface, gfxconsole.surface, 0, 0);
+        uint visible = gfxconsole.hw_surface->height - gfxconsole.extray;
+        if (gfxconsole.scrolled && gfxconsole.scrolled < visible) {
+            // replay the scroll on the hardware surface as one offset
+            // blit, so only the dirty rows below need recompositing
+            gfx_copyrect(gfxconsole.hw_surface, 0, gfxconsole.scrolled,
+                         gfxconsole.hw_surface->width,
+                         visible - gfxconsole.scrolled, 0, 0);
+        }
+
+        // re-blit only the dirty rows
+        // Since blend only works in whole surfaces, configure a sub-surface
+        // to use as the blend source.
+        gfxconsole.line.ptr = ((uint8_t*) gfxconsole.surface->ptr) +
+            (y0 * gfxconsole.linestride);
+        gfxconsole.line.height = y1 - y0;
+        gfx_surface_blend(gfxconsole.hw_surface, &gfxconsole.line, 0, y0);
+
+        if (gfxconsole.scrolled) {
+            gfx_flush(gfxconsole.hw_surface);
+        } else {
+            gfx_flush_rows(gfxconsole.hw_surface, y0, y1 - 1);
+        }
+    } else {
+        // drawing straight into the hardware surface; just flush what
+        // changed
+        if (gfxconsole.scrolled) {
+            gfx_flush(gfxconsole.surface);
         } else {
-            // Only re-blit the active console line.
-            // Since blend only works in whole surfaces, configure a sub-surface
-            // to use as the blend source.
-            gfxconsole.line.ptr = ((uint8_t*) gfxconsole.surface->ptr) +
-                (gfxconsole.y * gfxconsole.linestride);
-            gfx_surface_blend(gfxconsole.hw_surface, &gfxconsole.line,
-                0, gfxconsole.y * FONT_Y);
+            gfx_flush_rows(gfxconsole.surface, y0, y1 - 1);
         }
-        gfx_flush(gfxconsole.hw_surface);
     }
+
+    gfxconsole.dirty_y0 = gfxconsole.surface->height;
+    gfxconsole.dirty_y1 = 0;
+    gfxconsole.scrolled = 0;
 }
 
 static print_callback_t cb = {
@@ -174,10 +226,15 @@ static void gfxconsole_setup(gfx_surface *surface, gfx_surface *hw_surface)
     gfxconsole.surface = surface;
     gfxconsole.hw_surface = hw_surface;
 
-    // set up line-height sub-surface, for line-only invalidation
+    // set up a sub-surface used to re-blit only the dirty rows
     memcpy(&gfxconsole.line, surface, sizeof(*surface));
     gfxconsole.line.height = FONT_Y;
-    gfxconsole.linestride = surface->stride * surface->pixelsize * FONT_Y;
+    gfxconsole.linestride = surface->stride * surface->pixelsize;
+
+    // nothing dirty yet
+    gfxconsole.dirty_y0 = surface->height;
+    gfxconsole.dirty_y1 = 0;
+    gfxconsole.scrolled = 0;
 
     // calculate how many rows/columns we have
     gfxconsole.rows = surface->height / FONT_Y;
@@ -830,6 +830,16 @@ void *cmpct_memalign(size_t size, size_t alignment)
     return payload;
 }
 
+// Returns the usable payload size of an allocated block, which may be
+// larger than the size originally requested. Takes no lock: the header
+// of an allocated block only changes when it is freed.
+size_t cmpct_usable_size(void *payload)
+{
+    header_t *header = (header_t *)payload - 1;
+    DEBUG_ASSERT(!is_tagged_as_free(header));
+    return header->size - sizeof(header_t);
+}
+
 void cmpct_free(void *payload)
 {
     if (payload == NULL) return;
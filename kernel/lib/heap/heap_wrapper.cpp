@@ -38,6 +38,90 @@ static bool heap_trace = false;
 #define heap_trace (false)
 #endif
 
+/* Per-CPU magazine front end for small allocations.
+ *
+ * cmpctmalloc takes one global lock, so allocation-heavy syscall paths
+ * contend on it from every CPU. Hot small sizes are instead served from
+ * per-CPU stacks of recycled blocks ("magazines"), accessed with
+ * interrupts disabled so no lock is needed. A magazine overflows and
+ * drains back to cmpctmalloc half a magazine at a time; a miss falls
+ * through to cmpctmalloc.
+ *
+ * A freed block is binned by its usable size: class i serves requests up
+ * to magazine_class_size[i] and holds blocks whose usable size is within
+ * the class band, so a cached block always satisfies any request mapped
+ * to its class and oversized blocks are never hoarded.
+ */
+#define MAGAZINE_DEPTH 32u
+#define MAGAZINE_NUM_CLASSES 6u
+
+static const size_t magazine_class_size[MAGAZINE_NUM_CLASSES] = {
+    32u, 64u, 96u, 128u, 192u, 256u,
+};
+
+struct heap_magazine {
+    void *blocks[MAGAZINE_NUM_CLASSES][MAGAZINE_DEPTH];
+    uint32_t count[MAGAZINE_NUM_CLASSES];
+} __CPU_MAX_ALIGN;
+
+static struct heap_magazine magazines[SMP_MAX_CPUS];
+
+static int magazine_class_for_alloc(size_t size)
+{
+    for (uint32_t i = 0u; i < MAGAZINE_NUM_CLASSES; i++) {
+        if (size <= magazine_class_size[i])
+            return (int)i;
+    }
+    return -1;
+}
+
+static int magazine_class_for_free(size_t usable_size)
+{
+    for (uint32_t i = 0u; i < MAGAZINE_NUM_CLASSES; i++) {
+        size_t upper = (i + 1u < MAGAZINE_NUM_CLASSES)
+                           ? magazine_class_size[i + 1u]
+                           : magazine_class_size[i] + 64u;
+        if (usable_size >= magazine_class_size[i] && usable_size < upper)
+            return (int)i;
+    }
+    return -1;
+}
+
+static void *magazine_pop(int cl)
+{
+    void *ptr = NULL;
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    struct heap_magazine *mag = &magazines[arch_curr_cpu_num()];
+    if (mag->count[cl] > 0u)
+        ptr = mag->blocks[cl][--mag->count[cl]];
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return ptr;
+}
+
+/* Pushes |ptr| onto this CPU's magazine for |cl|. If the magazine is
+ * full, half of it is set aside and drained to cmpctmalloc after
+ * interrupts are re-enabled, since cmpct_free() takes the heap lock.
+ */
+static void magazine_push(int cl, void *ptr)
+{
+    void *drain[MAGAZINE_DEPTH / 2u];
+    uint32_t ndrain = 0u;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    struct heap_magazine *mag = &magazines[arch_curr_cpu_num()];
+    if (mag->count[cl] == MAGAZINE_DEPTH) {
+        while (ndrain < MAGAZINE_DEPTH / 2u)
+            drain[ndrain++] = mag->blocks[cl][--mag->count[cl]];
+    }
+    mag->blocks[cl][mag->count[cl]++] = ptr;
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    for (uint32_t i = 0u; i < ndrain; i++)
+        cmpct_free(drain[i]);
+}
+
 void heap_init(void)
 {
     cmpct_init();
@@ -45,6 +129,23 @@ void heap_init(void)
 
 void heap_trim(void)
 {
+    /* Flush this CPU's magazines so trimming can return their memory.
+     * Remote magazines stay put; each holds at most a few tens of KB
+     * and draining them would require cross-CPU calls.
+     */
+    void *drain[MAGAZINE_DEPTH];
+    for (uint32_t cl = 0u; cl < MAGAZINE_NUM_CLASSES; cl++) {
+        uint32_t n = 0u;
+        spin_lock_saved_state_t state;
+        arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+        struct heap_magazine *mag = &magazines[arch_curr_cpu_num()];
+        while (mag->count[cl] > 0u)
+            drain[n++] = mag->blocks[cl][--mag->count[cl]];
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+        for (uint32_t i = 0u; i < n; i++)
+            cmpct_free(drain[i]);
+    }
+
     cmpct_trim();
 }
 
@@ -54,7 +155,19 @@ void *malloc(size_t size)
 
     LTRACEF("size %zu\n", size);
 
-    void *ptr = cmpct_alloc(size);
+    void *ptr;
+    int cl = magazine_class_for_alloc(size);
+    if (likely(cl >= 0)) {
+        ptr = magazine_pop(cl);
+        if (ptr == NULL) {
+            /* Round the request up to the class size so the block can
+             * later be recycled for any allocation in the class.
+             */
+            ptr = cmpct_alloc(magazine_class_size[cl]);
+        }
+    } else {
+        ptr = cmpct_alloc(size);
+    }
     if (unlikely(heap_trace))
         printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
 
@@ -123,6 +236,14 @@ void free(void *ptr)
     if (unlikely(heap_trace))
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
 
+    if (likely(ptr != NULL)) {
+        int cl = magazine_class_for_free(cmpct_usable_size(ptr));
+        if (likely(cl >= 0)) {
+            magazine_push(cl, ptr);
+            return;
+        }
+    }
+
     cmpct_free(ptr);
 }
 
@@ -6,6 +6,7 @@
 
 #include <hypervisor/guest_physical_address_space.h>
 
+#include <assert.h>
 #include <kernel/vm/fault.h>
 #include <mxalloc/new.h>
 
@@ -14,6 +15,9 @@ static const uint kApicMmuFlags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_W
 static const uint kMmuFlags =
     ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE | ARCH_MMU_FLAG_PERM_EXECUTE;
 static const size_t kAddressSpaceSize =  256ul << 30;
+// Size of the block of guest physical memory faulted in per page fault,
+// sized to match a 2MB large page.
+static const size_t kOnDemandMapSize = 2ul << 20;
 
 status_t GuestPhysicalAddressSpace::Create(mxtl::RefPtr<VmObject> guest_phys_mem,
                                            mxtl::unique_ptr<GuestPhysicalAddressSpace>* _gpas) {
@@ -27,10 +31,8 @@ status_t GuestPhysicalAddressSpace::Create(mxtl::RefPtr<VmObject> guest_phys_mem
     if (status != NO_ERROR)
         return status;
 
-    // TODO(abdulla): Figure out how to do this on-demand.
-    status = gpas->MapRange(0, guest_phys_mem->size());
-    if (status != NO_ERROR)
-        return status;
+    // Guest physical memory is populated on demand, from page faults raised
+    // by the arch (EPT violations on x86), rather than mapped up front.
 
     *_gpas = mxtl::move(gpas);
     return NO_ERROR;
@@ -57,12 +59,58 @@ status_t GuestPhysicalAddressSpace::MapApicPage(vaddr_t guest_paddr, paddr_t hos
     return map_page(&paspace_, guest_paddr, host_paddr, kApicMmuFlags);
 }
 
+// Accumulates physically contiguous pages into a single call to
+// guest_mmu_map, so that aligned runs can be mapped with large pages.
+struct MapRun {
+    guest_paspace_t* paspace;
+    vaddr_t vaddr;
+    paddr_t paddr;
+    size_t count;
+
+    status_t Flush() {
+        if (count == 0)
+            return NO_ERROR;
+        size_t mapped;
+        status_t status = guest_mmu_map(paspace, vaddr, paddr, count, kMmuFlags, &mapped);
+        if (status != NO_ERROR)
+            return status;
+        return mapped != count ? ERR_NO_MEMORY : NO_ERROR;
+    }
+};
+
 status_t GuestPhysicalAddressSpace::MapRange(vaddr_t guest_paddr, size_t size) {
+    MapRun run = { &paspace_, 0, 0, 0 };
     auto mmu_map = [](void* context, size_t offset, size_t index, paddr_t pa) -> status_t {
-        guest_paspace_t* paspace = static_cast<guest_paspace_t*>(context);
-        return map_page(paspace, offset, pa, kMmuFlags);
+        MapRun* run = static_cast<MapRun*>(context);
+        if (run->count != 0 &&
+            offset == run->vaddr + run->count * PAGE_SIZE &&
+            pa == run->paddr + run->count * PAGE_SIZE) {
+            run->count++;
+            return NO_ERROR;
+        }
+        status_t status = run->Flush();
+        if (status != NO_ERROR)
+            return status;
+        run->vaddr = offset;
+        run->paddr = pa;
+        run->count = 1;
+        return NO_ERROR;
     };
-    return guest_phys_mem_->Lookup(guest_paddr, size, kPfFlags, mmu_map, &paspace_);
+    status_t status = guest_phys_mem_->Lookup(guest_paddr, size, kPfFlags, mmu_map, &run);
+    if (status != NO_ERROR)
+        return status;
+    return run.Flush();
+}
+
+status_t GuestPhysicalAddressSpace::PageFault(vaddr_t guest_paddr) {
+    DEBUG_ASSERT(guest_paddr < size());
+    // Fault in an aligned block around the faulting address, so that guest
+    // RAM is populated in large-page-sized chunks with a single VM exit each.
+    vaddr_t block = guest_paddr & ~(kOnDemandMapSize - 1);
+    size_t block_size = size() - block;
+    if (block_size > kOnDemandMapSize)
+        block_size = kOnDemandMapSize;
+    return MapRange(block, block_size);
 }
 
 status_t GuestPhysicalAddressSpace::UnmapRange(vaddr_t guest_paddr, size_t size) {
@@ -76,5 +124,14 @@ status_t GuestPhysicalAddressSpace::UnmapRange(vaddr_t guest_paddr, size_t size)
 
 status_t GuestPhysicalAddressSpace::GetPage(vaddr_t guest_paddr, paddr_t* host_paddr) {
     uint mmu_flags;
-    return guest_mmu_query(&paspace_, guest_paddr, host_paddr, &mmu_flags);
+    status_t status = guest_mmu_query(&paspace_, guest_paddr, host_paddr, &mmu_flags);
+    if (status != NO_ERROR && guest_paddr < size()) {
+        // With on-demand population the page may simply not have been
+        // faulted in yet.
+        status = PageFault(guest_paddr);
+        if (status != NO_ERROR)
+            return status;
+        status = guest_mmu_query(&paspace_, guest_paddr, host_paddr, &mmu_flags);
+    }
+    return status;
 }
@@ -24,6 +24,7 @@ public:
 #endif
     status_t UnmapRange(vaddr_t guest_paddr, size_t size);
     status_t GetPage(vaddr_t guest_paddr, paddr_t* host_paddr);
+    status_t PageFault(vaddr_t guest_paddr);
 
 private:
     guest_paspace_t paspace_;
@@ -9,9 +9,12 @@
 #include <platform.h>
 #include <string.h>
 
+#include <arch/defines.h>
 #include <arch/ops.h>
 #include <arch/user_copy.h>
 #include <kernel/cmdline.h>
+#include <kernel/mp.h>
+#include <kernel/spinlock.h>
 #include <kernel/vm/vm_aspace.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
@@ -82,86 +85,320 @@ static void ktrace_report_probes(void) {
     mutex_release(&probe_list_lock);
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+// The trace buffer is carved into fixed size sub-buffers.  Each cpu fills
+// one sub-buffer at a time with plain stores (no cross-cpu contention on
+// the write path), handing it to the completed queue when it fills up and
+// pulling a fresh one off the free stack.
+#define KTRACE_SUBBUF_SIZE (32u * 1024u)
+
+// The last record written to a sub-buffer can overhang its end,
+// so each sub-buffer reserves the max size of a record as slack.
+#define KTRACE_SUBBUF_LIMIT (KTRACE_SUBBUF_SIZE - 256u)
+
+typedef struct ktrace_cpu_state {
+    // base of the sub-buffer this cpu is writing, null when it has none;
+    // only touched by this cpu with interrupts disabled (except for the
+    // stop/rewind paths, which run while tracing is disabled)
+    uint8_t* buffer;
+
+    // write offset within the sub-buffer
+    uint32_t offset;
 
+    // index of the sub-buffer in the pool
+    uint32_t subbuf;
+} __ALIGNED(MAX_CACHE_LINE) ktrace_cpu_state_t;
+
+// a completed sub-buffer and how many payload bytes it holds
+typedef struct ktrace_completed_entry {
+    uint32_t index;
+    uint32_t len;
+} ktrace_completed_entry_t;
+
+// guards the sub-buffer pool bookkeeping in ktrace_state_t
+static spin_lock_t subbuf_lock = SPIN_LOCK_INITIAL_VALUE;
+
+// serializes streaming readers
+static mutex_t drain_lock = MUTEX_INITIAL_VALUE(drain_lock);
+
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // sub-buffer pool bookkeeping, all guarded by subbuf_lock
+    uint8_t* buffer;
+    uint32_t subbuf_count;
+    uint32_t* free_stack;
+    uint32_t free_count;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // fifo of completed sub-buffers, a ring of subbuf_count entries
+    ktrace_completed_entry_t* completed;
+    uint32_t comp_head;
+    uint32_t comp_count;
 
-    // raw trace buffer
-    uint8_t* buffer;
+    // records dropped because no sub-buffer was free
+    uint32_t drops;
+
+    // in streaming mode reads consume completed sub-buffers and return
+    // them to the free stack instead of stopping when the pool runs out
+    bool streaming;
+
+    // read cursor within the head completed entry (streaming mode)
+    uint32_t stream_read_off;
+
+    ktrace_cpu_state_t cpu[SMP_MAX_CPUS];
 } ktrace_state_t;
 
 static ktrace_state_t KTRACE_STATE;
 
+// Retire the cpu's current sub-buffer (if any) to the completed fifo and
+// try to pull a fresh one off the free stack.  Returns false if the pool
+// is exhausted; in one-shot mode that also stops tracing, matching the
+// old stop-at-end-of-buffer behavior.
+static bool ktrace_swap_subbuf(ktrace_state_t* ks, ktrace_cpu_state_t* kcs) TA_REQ(subbuf_lock) {
+    if (kcs->buffer != nullptr) {
+        uint32_t slot = (ks->comp_head + ks->comp_count) % ks->subbuf_count;
+        ks->completed[slot].index = kcs->subbuf;
+        ks->completed[slot].len = kcs->offset;
+        ks->comp_count++;
+        kcs->buffer = nullptr;
+    }
+
+    if (ks->free_count == 0) {
+        if (ks->streaming) {
+            // the drain thread hasn't caught up; drop until it does
+            ks->drops++;
+        } else {
+            atomic_store(&ks->grpmask, 0);
+        }
+        return false;
+    }
+
+    uint32_t index = ks->free_stack[--ks->free_count];
+    kcs->buffer = ks->buffer + (size_t)index * KTRACE_SUBBUF_SIZE;
+    kcs->offset = 0;
+    kcs->subbuf = index;
+    return true;
+}
+
+// Reserve space for a record in the current cpu's sub-buffer.  Interrupts
+// are disabled across the reservation so the offset bump needs no atomics;
+// same-cpu writers (including interrupt handlers) cannot interleave.
+static void* ktrace_reserve(ktrace_state_t* ks, uint32_t len) {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    ktrace_cpu_state_t* kcs = &ks->cpu[arch_curr_cpu_num()];
+    void* ptr = nullptr;
+    if (kcs->buffer == nullptr || kcs->offset + len > KTRACE_SUBBUF_LIMIT) {
+        spin_lock(&subbuf_lock);
+        bool ok = ktrace_swap_subbuf(ks, kcs);
+        spin_unlock(&subbuf_lock);
+        if (!ok) {
+            arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+            return nullptr;
+        }
+    }
+    ptr = kcs->buffer + kcs->offset;
+    kcs->offset += len;
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return ptr;
+}
+
+// Push every cpu's partially filled sub-buffer onto the completed fifo so
+// its records become visible to readers.  Only called while tracing is
+// disabled, so the cpu-local states are quiescent.
+static void ktrace_flush_cpu_buffers(ktrace_state_t* ks) {
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&subbuf_lock, state);
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        ktrace_cpu_state_t* kcs = &ks->cpu[i];
+        if (kcs->buffer != nullptr) {
+            uint32_t slot = (ks->comp_head + ks->comp_count) % ks->subbuf_count;
+            ks->completed[slot].index = kcs->subbuf;
+            ks->completed[slot].len = kcs->offset;
+            ks->comp_count++;
+            kcs->buffer = nullptr;
+        }
+    }
+    spin_unlock_irqrestore(&subbuf_lock, state);
+}
+
+// write the version and ticks-per-ms metadata records
+static void ktrace_write_metadata(ktrace_state_t* ks) {
+    uint64_t n = ktrace_ticks_per_ms();
+    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*)ktrace_reserve(ks, KTRACE_RECSIZE * 2);
+    if (rec != nullptr) {
+        memset(rec, 0, KTRACE_RECSIZE * 2);
+        rec[0].tag = TAG_VERSION;
+        rec[0].a = KTRACE_VERSION;
+        rec[1].tag = TAG_TICKS_PER_MS;
+        rec[1].a = (uint32_t)n;
+        rec[1].b = (uint32_t)(n >> 32);
+    }
+}
+
+// Copy out of the completed fifo in streaming mode, consuming sub-buffers
+// as they are fully read and returning them to the free stack so tracing
+// can continue while the reader drains.
+static int ktrace_read_stream(ktrace_state_t* ks, void* ptr, uint32_t len) {
+    mutex_acquire(&drain_lock);
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&subbuf_lock, state);
+    if (ks->comp_count == 0) {
+        spin_unlock_irqrestore(&subbuf_lock, state);
+        mutex_release(&drain_lock);
+        return 0;
+    }
+    ktrace_completed_entry_t entry = ks->completed[ks->comp_head];
+    uint32_t read_off = ks->stream_read_off;
+    spin_unlock_irqrestore(&subbuf_lock, state);
+
+    // null read is a query for the available byte count
+    if (ptr == nullptr) {
+        mutex_release(&drain_lock);
+        return entry.len - read_off;
+    }
+
+    if (len > entry.len - read_off) {
+        len = entry.len - read_off;
+    }
+    const uint8_t* src = ks->buffer + (size_t)entry.index * KTRACE_SUBBUF_SIZE + read_off;
+    if (arch_copy_to_user(ptr, src, len) != NO_ERROR) {
+        mutex_release(&drain_lock);
+        return ERR_INVALID_ARGS;
+    }
+
+    spin_lock_irqsave(&subbuf_lock, state);
+    if (read_off + len < entry.len) {
+        ks->stream_read_off = read_off + len;
+    } else {
+        // fully drained: recycle the sub-buffer
+        ks->stream_read_off = 0;
+        ks->comp_head = (ks->comp_head + 1) % ks->subbuf_count;
+        ks->comp_count--;
+        ks->free_stack[ks->free_count++] = entry.index;
+    }
+    spin_unlock_irqrestore(&subbuf_lock, state);
+
+    mutex_release(&drain_lock);
+    return len;
+}
+
 int ktrace_read_user(void* ptr, uint32_t off, uint32_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
-        }
+    if (ks->buffer == nullptr) {
+        return (ptr == nullptr) ? 0 : ERR_INVALID_ARGS;
     }
 
+    if (ks->streaming && atomic_load(&ks->grpmask)) {
+        return ktrace_read_stream(ks, ptr, len);
+    }
+
+    // Present the completed sub-buffers as one concatenated stream,
+    // in completion order.  Each one holds only whole records.
+    spin_lock_saved_state_t state;
+    uint32_t total = 0;
+    spin_lock_irqsave(&subbuf_lock, state);
+    for (uint32_t i = 0; i < ks->comp_count; i++) {
+        total += ks->completed[(ks->comp_head + i) % ks->subbuf_count].len;
+    }
+    spin_unlock_irqrestore(&subbuf_lock, state);
+
     // null read is a query for trace buffer size
     if (ptr == nullptr) {
-        return max;
+        return total;
     }
 
     // constrain read to available buffer
-    if (off >= max) {
+    if (off >= total) {
         return 0;
     }
-    if (len > (max - off)) {
-        len = max - off;
+    if (len > (total - off)) {
+        len = total - off;
     }
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != NO_ERROR) {
-        return ERR_INVALID_ARGS;
+    // walk the fifo to the entries overlapping [off, off + len)
+    uint32_t copied = 0;
+    uint32_t pos = 0;
+    for (uint32_t i = 0; copied < len; i++) {
+        spin_lock_irqsave(&subbuf_lock, state);
+        if (i >= ks->comp_count) {
+            spin_unlock_irqrestore(&subbuf_lock, state);
+            break;
+        }
+        ktrace_completed_entry_t entry = ks->completed[(ks->comp_head + i) % ks->subbuf_count];
+        spin_unlock_irqrestore(&subbuf_lock, state);
+
+        if (off + copied < pos + entry.len) {
+            uint32_t entry_off = off + copied - pos;
+            uint32_t chunk = entry.len - entry_off;
+            if (chunk > len - copied) {
+                chunk = len - copied;
+            }
+            const uint8_t* src = ks->buffer + (size_t)entry.index * KTRACE_SUBBUF_SIZE + entry_off;
+            if (arch_copy_to_user((uint8_t*)ptr + copied, src, chunk) != NO_ERROR) {
+                return ERR_INVALID_ARGS;
+            }
+            copied += chunk;
+        }
+        pos += entry.len;
     }
-    return len;
+    return copied;
 }
 
 status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
     ktrace_state_t* ks = &KTRACE_STATE;
     switch (action) {
     case KTRACE_ACTION_START:
+    case KTRACE_ACTION_START_STREAM:
+        if (ks->buffer == nullptr) {
+            return ERR_BAD_STATE;
+        }
+        ks->streaming = (action == KTRACE_ACTION_START_STREAM);
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
         atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_threads();
         break;
     case KTRACE_ACTION_STOP: {
         atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
+        if (ks->buffer != nullptr) {
+            // make the partially filled cpu buffers readable
+            ktrace_flush_cpu_buffers(ks);
+            if (ks->drops != 0) {
+                dprintf(INFO, "ktrace: %u records dropped\n", ks->drops);
+            }
         }
         break;
     }
-    case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
+    case KTRACE_ACTION_REWIND: {
+        if (ks->buffer == nullptr) {
+            break;
+        }
+        // reclaim every sub-buffer; only sound while tracing is stopped
+        atomic_store(&ks->grpmask, 0);
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&subbuf_lock, state);
+        for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+            ks->cpu[i].buffer = nullptr;
+        }
+        for (uint32_t i = 0; i < ks->subbuf_count; i++) {
+            ks->free_stack[i] = ks->subbuf_count - i - 1;
+        }
+        ks->free_count = ks->subbuf_count;
+        ks->comp_head = 0;
+        ks->comp_count = 0;
+        ks->drops = 0;
+        ks->stream_read_off = 0;
+        spin_unlock_irqrestore(&subbuf_lock, state);
+        // re-log the metadata that lived at the buffer start
+        ktrace_write_metadata(ks);
         ktrace_report_syscalls(kt_syscall_info);
         ktrace_report_probes();
         break;
+    }
     case KTRACE_ACTION_NEW_PROBE: {
         ktrace_probe_info_t* probe;
         mutex_acquire(&probe_list_lock);
@@ -201,19 +438,37 @@ void ktrace_init(unsigned level) {
 
     mb *= (1024*1024);
 
+    uint32_t subbuf_count = mb / KTRACE_SUBBUF_SIZE;
+    uint32_t* free_stack = (uint32_t*) calloc(subbuf_count, sizeof(uint32_t));
+    ktrace_completed_entry_t* completed =
+        (ktrace_completed_entry_t*) calloc(subbuf_count, sizeof(ktrace_completed_entry_t));
+    if (free_stack == nullptr || completed == nullptr) {
+        dprintf(INFO, "ktrace: cannot alloc sub-buffer bookkeeping\n");
+        free(free_stack);
+        free(completed);
+        return;
+    }
+
     status_t status;
     VmAspace* aspace = VmAspace::kernel_aspace();
     if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VmAspace::VMM_FLAG_COMMIT,
                                 ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
         dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
+        free(free_stack);
+        free(completed);
         return;
     }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
+    ks->subbuf_count = subbuf_count;
+    ks->free_stack = free_stack;
+    ks->completed = completed;
+    for (uint32_t i = 0; i < subbuf_count; i++) {
+        ks->free_stack[i] = subbuf_count - i - 1;
+    }
+    ks->free_count = subbuf_count;
 
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    dprintf(INFO, "ktrace: buffer at %p (%u bytes, %u sub-buffers)\n",
+            ks->buffer, mb, subbuf_count);
 
     // register all static probes
     ktrace_probe_info_t *probe;
@@ -224,16 +479,9 @@ void ktrace_init(unsigned level) {
     mutex_release(&probe_list_lock);
 
     // write metadata to the first two event slots
-    uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->buffer;
-    rec[0].tag = TAG_VERSION;
-    rec[0].a = KTRACE_VERSION;
-    rec[1].tag = TAG_TICKS_PER_MS;
-    rec[1].a = (uint32_t)n;
-    rec[1].b = (uint32_t)(n >> 32);
+    ktrace_write_metadata(ks);
 
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
     ktrace_report_syscalls(kt_syscall_info);
     ktrace_report_probes();
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
@@ -246,12 +494,8 @@ void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (tag & atomic_load(&ks->grpmask)) {
         tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
+        ktrace_header_t* hdr = (ktrace_header_t*) ktrace_reserve(ks, KTRACE_HDRSIZE);
+        if (hdr != nullptr) {
             hdr->ts = ktrace_timestamp();
             hdr->tag = tag;
             hdr->tid = arg;
@@ -265,14 +509,11 @@ void* ktrace_open(uint32_t tag) {
         return nullptr;
     }
 
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
+    ktrace_header_t* hdr = (ktrace_header_t*) ktrace_reserve(ks, KTRACE_LEN(tag));
+    if (hdr == nullptr) {
         return nullptr;
     }
 
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
     hdr->ts = ktrace_timestamp();
     hdr->tag = tag;
     hdr->tid = (uint32_t)get_current_thread()->user_tid;
@@ -287,12 +528,8 @@ static void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char*
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
+        ktrace_rec_name_t* rec = (ktrace_rec_name_t*) ktrace_reserve(ks, KTRACE_LEN(tag));
+        if (rec != nullptr) {
             rec->tag = tag;
             rec->id = id;
             rec->arg = arg;
@@ -13,6 +13,8 @@
 #include <trace.h>
 
 #include <kernel/event.h>
+#include <kernel/sched.h>
+#include <lib/counters.h>
 #include <platform.h>
 
 #include <magenta/handle.h>
@@ -26,6 +28,8 @@
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(channel_messages, "kernel.channel.messages");
+
 constexpr mx_rights_t kDefaultChannelRights = MX_RIGHT_TRANSFER | MX_RIGHT_READ | MX_RIGHT_WRITE;
 
 // static
@@ -183,6 +187,8 @@ status_t ChannelDispatcher::Write(mxtl::unique_ptr<MessagePacket> msg) {
         other = other_;
     }
 
+    kcounter_add(&channel_messages, 1);
+
     if (other->WriteSelf(mxtl::move(msg)) > 0)
         thread_reschedule();
 
@@ -220,8 +226,13 @@ status_t ChannelDispatcher::Call(mxtl::unique_ptr<MessagePacket> msg,
         waiters_.push_back(waiter);
     }
 
-    // (1) Write outbound message to opposing endpoint.
+    // (1) Write outbound message to opposing endpoint. Wakeups caused by the
+    // write are direct handoffs: we block for the reply just below, at which
+    // point the cpu switches straight to the woken server thread, taking the
+    // remainder of our timeslice with it.
+    sched_handoff_wakeups(true);
     other->WriteSelf(mxtl::move(msg));
+    sched_handoff_wakeups(false);
 
     // Reuse the code from the half-call used for retrying a Call after thread
     // suspend.
@@ -280,8 +291,14 @@ int ChannelDispatcher::WriteSelf(mxtl::unique_ptr<MessagePacket> msg) {
             // Remove waiter from list.
             if (waiter.get_txid() == txid) {
                 waiters_.erase(waiter);
+                // Wake the calling thread with direct handoff: a reply is
+                // the tail of a synchronous round trip and the replier is
+                // typically about to wait for its next message.
+                sched_handoff_wakeups(true);
+                int woken = waiter.Deliver(mxtl::move(msg));
+                sched_handoff_wakeups(false);
                 // we return how many threads have been woken up, or zero.
-                return waiter.Deliver(mxtl::move(msg));
+                return woken;
             }
         }
     }
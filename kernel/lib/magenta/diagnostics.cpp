@@ -72,7 +72,7 @@ static char StateChar(const ProcessDispatcher& pd) {
 }
 
 static const char* ObjectTypeToString(mx_obj_type_t type) {
-    static_assert(MX_OBJ_TYPE_LAST == 24, "need to update switch below");
+    static_assert(MX_OBJ_TYPE_LAST == 25, "need to update switch below");
 
     switch (type) {
         case MX_OBJ_TYPE_PROCESS: return "process";
@@ -96,6 +96,7 @@ static const char* ObjectTypeToString(mx_obj_type_t type) {
         case MX_OBJ_TYPE_HYPERVISOR: return "hypervisor";
         case MX_OBJ_TYPE_GUEST: return "guest";
         case MX_OBJ_TYPE_TIMER: return "timer";
+        case MX_OBJ_TYPE_IORING: return "io-ring";
         default: return "???";
     }
 }
@@ -350,10 +351,7 @@ public:
     bool printed() const { return printed_; }
 
 private:
-    // This is called by JobDispatcher::EnumerateChildren() which acquires JobDispatcher::lock_
-    // first, making it safe to access job->process_count_ etc, but there's no reasonable way to
-    // express this fact via thread safety annotations so we disable the analysis for this function.
-    bool OnJob(JobDispatcher* job) final TA_NO_THREAD_SAFETY_ANALYSIS {
+    bool OnJob(JobDispatcher* job) final {
         printf("- %" PRIu64 " child job (%" PRIu32 " processes)\n",
             job->get_koid(), job->process_count());
         printed_ = true;
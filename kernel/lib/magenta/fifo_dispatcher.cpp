@@ -26,7 +26,7 @@ status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t opti
     // total size must be <= kMaxSizeBytes
     if (!count || !elemsize || (count & (count - 1)) ||
         (count > kMaxSizeBytes) || (elemsize > kMaxSizeBytes) ||
-        ((count * elemsize) > kMaxSizeBytes)) {
+        (((uint64_t)count * elemsize) > kMaxSizeBytes)) {
         return ERR_OUT_OF_RANGE;
     }
     AllocChecker ac;
@@ -53,7 +53,7 @@ status_t FifoDispatcher::Create(uint32_t count, uint32_t elemsize, uint32_t opti
 FifoDispatcher::FifoDispatcher(uint32_t count, uint32_t elem_size, uint32_t /*options*/)
     : elem_count_(count), elem_size_(elem_size), mask_(count - 1),
       peer_koid_(0u), state_tracker_(MX_FIFO_WRITABLE),
-      head_(0u), tail_(0u) {
+      head_(0u), tail_(0u), read_threshold_(1u) {
 }
 
 FifoDispatcher::~FifoDispatcher() {
@@ -153,7 +153,7 @@ mx_status_t FifoDispatcher::WriteSelf(const uint8_t* ptr, size_t bytelen, uint32
     if (avail == 0)
         return ERR_SHOULD_WAIT;
 
-    bool was_empty = (avail == elem_count_);
+    uint32_t old_depth = head_ - tail_;
 
     if (count > avail)
         count = avail;
@@ -181,8 +181,8 @@ mx_status_t FifoDispatcher::WriteSelf(const uint8_t* ptr, size_t bytelen, uint32
         ptr += to_copy * elem_size_;
     }
 
-    // if was empty, we've become readable
-    if (was_empty)
+    // if we've crossed the read threshold, we've become readable
+    if ((old_depth < read_threshold_) && ((head_ - tail_) >= read_threshold_))
         state_tracker_.UpdateState(0u, MX_FIFO_READABLE);
 
     // if now full, we're no longer writable
@@ -244,10 +244,33 @@ mx_status_t FifoDispatcher::Read(uint8_t* ptr, size_t bytelen, uint32_t* actual,
     if (was_full && other_)
         other_->state_tracker_.UpdateState(0u, MX_FIFO_WRITABLE);
 
-    // if we've become empty, we're no longer readable
-    if ((head_ - tail_) == 0)
+    // if we've dropped below the read threshold, we're no longer readable
+    if ((avail >= read_threshold_) && ((head_ - tail_) < read_threshold_))
         state_tracker_.UpdateState(MX_FIFO_READABLE, 0u);
 
     *actual = (tail_ - old_tail);
     return NO_ERROR;
 }
+
+mx_status_t FifoDispatcher::SetReadThreshold(uint32_t count) {
+    canary_.Assert();
+
+    if (count > elem_count_)
+        return ERR_OUT_OF_RANGE;
+
+    AutoLock lock(&lock_);
+    // zero resets to the default of signaling on the first element
+    read_threshold_ = (count == 0u) ? 1u : count;
+    if ((head_ - tail_) >= read_threshold_)
+        state_tracker_.UpdateState(0u, MX_FIFO_READABLE);
+    else
+        state_tracker_.UpdateState(MX_FIFO_READABLE, 0u);
+    return NO_ERROR;
+}
+
+uint32_t FifoDispatcher::ReadThreshold() {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+    return read_threshold_;
+}
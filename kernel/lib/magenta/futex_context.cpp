@@ -9,8 +9,11 @@
 #include <lib/user_copy.h>
 #include <lib/user_copy/user_ptr.h>
 #include <magenta/futex_context.h>
+#include <magenta/process_dispatcher.h>
+#include <magenta/thread_dispatcher.h>
 #include <magenta/user_copy.h>
 #include <magenta/user_thread.h>
+#include <mxtl/type_support.h>
 #include <trace.h>
 
 #define LOCAL_TRACE 0
@@ -24,10 +27,64 @@ FutexContext::~FutexContext() {
 
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+    for (auto& shard : shards_) {
+        DEBUG_ASSERT(shard.futex_table.is_empty());
+    }
+}
+
+// The shard a node belongs to can change underneath us if a concurrent
+// FutexRequeue() moves it to another futex, so loop until the lock we
+// acquired still covers the node's current key.
+FutexContext::Shard& FutexContext::LockShardForNode(FutexNode* node) TA_NO_THREAD_SAFETY_ANALYSIS {
+    for (;;) {
+        size_t index = ShardIndex(node->GetKey());
+        Shard& shard = shards_[index];
+        shard.lock.Acquire();
+        if (ShardIndex(node->GetKey()) == index)
+            return shard;
+        shard.lock.Release();
+    }
 }
 
 status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value, mx_time_t deadline) {
+    return FutexWaitInternal(value_ptr, current_value, false, deadline);
+}
+
+status_t FutexContext::FutexWaitPi(user_ptr<int> value_ptr, int current_value,
+                                   mx_time_t deadline) {
+    // A PI futex's word always names an owner, so a waiter can never be
+    // queued behind the unlocked value.
+    if ((current_value & ~MX_FUTEX_PI_CONTESTED) == 0)
+        return ERR_INVALID_ARGS;
+
+    return FutexWaitInternal(value_ptr, current_value, true, deadline);
+}
+
+// Resolve the owner handle a PI futex word carries.  The handle must refer
+// to a thread of the calling process other than the caller itself; a
+// handle that went stale (the owner exited and the handle was closed)
+// surfaces as ERR_INVALID_ARGS and the caller can fall back to an
+// undonated wait.
+status_t FutexContext::GetPiOwner(int value, mxtl::RefPtr<UserThread>* out) {
+    auto owner_handle = static_cast<mx_handle_t>(value & ~MX_FUTEX_PI_CONTESTED);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    mxtl::RefPtr<ThreadDispatcher> owner_disp;
+    status_t result = up->GetDispatcherWithRights(owner_handle, MX_RIGHT_READ, &owner_disp);
+    if (result != NO_ERROR)
+        return result;
+
+    UserThread* owner = owner_disp->thread();
+    if (owner == UserThread::GetCurrent() || owner->process() != up)
+        return ERR_INVALID_ARGS;
+
+    *out = mxtl::WrapRefPtr(owner);
+    return NO_ERROR;
+}
+
+status_t FutexContext::FutexWaitInternal(user_ptr<int> value_ptr, int current_value,
+                                         bool pi, mx_time_t deadline)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACE_ENTRY;
 
     uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
@@ -42,36 +99,54 @@ status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value, mx_
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    lock_.Acquire();
+    Shard& shard = ShardForKey(futex_key);
+    shard.lock.Acquire();
 
     int value;
     status_t result = value_ptr.copy_from_user(&value);
     if (result != NO_ERROR) {
-        lock_.Release();
+        shard.lock.Release();
         return result;
     }
     if (value != current_value) {
-        lock_.Release();
+        shard.lock.Release();
         return ERR_BAD_STATE;
     }
 
+    // For a PI wait, resolve the owner named by the futex word while the
+    // word is still known to hold that value.
+    mxtl::RefPtr<UserThread> pi_owner;
+    if (pi) {
+        result = GetPiOwner(value, &pi_owner);
+        if (result != NO_ERROR) {
+            shard.lock.Release();
+            return result;
+        }
+    }
+
     UserThread* thread = UserThread::GetCurrent();
     node = thread->futex_node();
     node->set_hash_key(futex_key);
     node->SetAsSingletonList();
 
-    QueueNodesLocked(node);
+    QueueNodesLocked(shard, node);
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
-    result = node->BlockThread(&lock_, deadline);
+    if (pi)
+        node->SetPiDonation(mxtl::move(pi_owner));
+
+    // Block current thread.  This releases the shard lock and does not
+    // reacquire it.
+    result = node->BlockThread(&shard.lock, deadline);
     if (result == NO_ERROR) {
         // Fix/workaround for MG-624:
         // We must re-acquire the lock here to force this thread to wait until
         // the WakeThreads() marks this thread as not in the queue anymore.
         // Otherwise, this thread can exit before it does that, causing
-        // WakeThreads() to scribble on memory.
-        AutoLock lock(&lock_);
+        // WakeThreads() to scribble on memory.  Note that a requeue may have
+        // moved us to a different shard since we went to sleep.
+        Shard& wake_shard = LockShardForNode(node);
         DEBUG_ASSERT(!node->IsInQueue());
+        wake_shard.lock.Release();
         // All the work necessary for removing us from the hash table was done by FutexWake()
         return NO_ERROR;
     }
@@ -82,8 +157,14 @@ status_t FutexContext::FutexWait(user_ptr<int> value_ptr, int current_value, mx_
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    AutoLock lock(&lock_);
-    if (UnqueueNodeLocked(node)) {
+    Shard& unqueue_shard = LockShardForNode(node);
+    bool was_queued = UnqueueNodeLocked(unqueue_shard, node);
+    if (was_queued) {
+        // Nobody woke us, so nobody withdrew our donation either.
+        node->ReleasePiDonation();
+    }
+    unqueue_shard.lock.Release();
+    if (was_queued) {
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -118,9 +199,10 @@ status_t FutexContext::FutexWake(user_ptr<const int> value_ptr,
     if (futex_key % sizeof(int))
         return ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
+    Shard& shard = ShardForKey(futex_key);
+    AutoLock lock(&shard.lock);
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = shard.futex_table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return NO_ERROR;
@@ -133,7 +215,7 @@ status_t FutexContext::FutexWake(user_ptr<const int> value_ptr,
 
     if (node != nullptr) {
         DEBUG_ASSERT(node->GetKey() == futex_key);
-        futex_table_.insert(node);
+        shard.futex_table.insert(node);
     }
 
     // Traversing this list of threads must be done while holding the
@@ -145,69 +227,126 @@ status_t FutexContext::FutexWake(user_ptr<const int> value_ptr,
     return NO_ERROR;
 }
 
-status_t FutexContext::FutexRequeue(user_ptr<int> wake_ptr, uint32_t wake_count, int current_value,
-                                    user_ptr<int> requeue_ptr, uint32_t requeue_count) {
+status_t FutexContext::FutexWakePi(user_ptr<const int> value_ptr, uint32_t count) {
     LTRACE_ENTRY;
 
-    if ((requeue_ptr.get() == nullptr) && requeue_count)
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
         return ERR_INVALID_ARGS;
 
-    AutoLock lock(&lock_);
-
-    int value;
-    status_t result = wake_ptr.copy_from_user(&value);
-    if (result != NO_ERROR) return result;
-    if (value != current_value) return ERR_BAD_STATE;
-
-    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
-    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
-    if (wake_key == requeue_key) return ERR_INVALID_ARGS;
-    if (wake_key % sizeof(int) || requeue_key % sizeof(int))
-        return ERR_INVALID_ARGS;
+    Shard& shard = ShardForKey(futex_key);
+    AutoLock lock(&shard.lock);
 
-    // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
-    // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    FutexNode* node = shard.futex_table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return NO_ERROR;
     }
+    DEBUG_ASSERT(node->GetKey() == futex_key);
 
-    FutexNode* wake_head;
-    if (wake_count == 0) {
-        wake_head = nullptr;
-    } else {
-        wake_head = node;
-        node = FutexNode::RemoveFromHead(node, wake_count, wake_key, 0u);
-    }
+    // The owner is releasing the futex, so its ownership epoch is over:
+    // every waiter's donation to it is withdrawn, woken or not.  Waiters
+    // left queued sleep undonated until the futex is next contended, when
+    // the new waiter names the new owner.
+    FutexNode::ReleaseAllPiDonations(node);
 
-    // node is now the head of wake_ptr futex after possibly removing some threads to wake
-    if (node != nullptr) {
-        if (requeue_count > 0) {
-            // head and tail of list of nodes to requeue
-            FutexNode* requeue_head = node;
-            node = FutexNode::RemoveFromHead(node, requeue_count,
-                                             wake_key, requeue_key);
-
-            // now requeue our nodes to requeue_ptr mutex
-            DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
-        }
+    if (count == 0) {
+        shard.futex_table.insert(node);
+        return NO_ERROR;
     }
 
-    // add any remaining nodes back to wake_key futex
+    FutexNode* wake_head = node;
+    node = FutexNode::RemoveFromHead(node, count, futex_key, 0u);
     if (node != nullptr) {
-        DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
+        DEBUG_ASSERT(node->GetKey() == futex_key);
+        shard.futex_table.insert(node);
     }
 
     FutexNode::WakeThreads(wake_head);
+
     return NO_ERROR;
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.IsHeld());
+status_t FutexContext::FutexRequeue(user_ptr<int> wake_ptr, uint32_t wake_count, int current_value,
+                                    user_ptr<int> requeue_ptr, uint32_t requeue_count)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    LTRACE_ENTRY;
+
+    if ((requeue_ptr.get() == nullptr) && requeue_count)
+        return ERR_INVALID_ARGS;
+
+    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
+    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
+    if (wake_key == requeue_key) return ERR_INVALID_ARGS;
+    if (wake_key % sizeof(int) || requeue_key % sizeof(int))
+        return ERR_INVALID_ARGS;
+
+    // The two futexes may live in different shards; take the locks in
+    // index order so concurrent requeues can't deadlock against us.
+    Shard& wake_shard = ShardForKey(wake_key);
+    Shard& requeue_shard = ShardForKey(requeue_key);
+    if (ShardIndex(wake_key) < ShardIndex(requeue_key)) {
+        wake_shard.lock.Acquire();
+        requeue_shard.lock.Acquire();
+    } else if (ShardIndex(wake_key) > ShardIndex(requeue_key)) {
+        requeue_shard.lock.Acquire();
+        wake_shard.lock.Acquire();
+    } else {
+        wake_shard.lock.Acquire();
+    }
+
+    status_t result = NO_ERROR;
+    int value;
+    result = wake_ptr.copy_from_user(&value);
+    if (result == NO_ERROR && value != current_value)
+        result = ERR_BAD_STATE;
+
+    if (result == NO_ERROR) {
+        // This must happen before RemoveFromHead() calls set_hash_key() on
+        // nodes below, because operations on the futex tables look at the
+        // GetKey field of the list head nodes for wake_key and requeue_key.
+        FutexNode* node = wake_shard.futex_table.erase(wake_key);
+        if (node) {
+            FutexNode* wake_head;
+            if (wake_count == 0) {
+                wake_head = nullptr;
+            } else {
+                wake_head = node;
+                node = FutexNode::RemoveFromHead(node, wake_count, wake_key, 0u);
+            }
+
+            // node is now the head of wake_ptr futex after possibly removing some threads to wake
+            if (node != nullptr) {
+                if (requeue_count > 0) {
+                    // head and tail of list of nodes to requeue
+                    FutexNode* requeue_head = node;
+                    node = FutexNode::RemoveFromHead(node, requeue_count,
+                                                     wake_key, requeue_key);
+
+                    // now requeue our nodes to requeue_ptr mutex
+                    DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
+                    QueueNodesLocked(requeue_shard, requeue_head);
+                }
+            }
+
+            // add any remaining nodes back to wake_key futex
+            if (node != nullptr) {
+                DEBUG_ASSERT(node->GetKey() == wake_key);
+                wake_shard.futex_table.insert(node);
+            }
+
+            FutexNode::WakeThreads(wake_head);
+        }
+    }
+
+    if (&wake_shard != &requeue_shard)
+        requeue_shard.lock.Release();
+    wake_shard.lock.Release();
+    return result;
+}
+
+void FutexContext::QueueNodesLocked(Shard& shard, FutexNode* head) {
+    DEBUG_ASSERT(shard.lock.IsHeld());
 
     FutexNode::HashTable::iterator iter;
 
@@ -215,15 +354,15 @@ void FutexContext::QueueNodesLocked(FutexNode* head) {
     // succeeds, then the current thread is first to block on this futex and we
     // are finished.  If the insert fails, then there is already a thread
     // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+    if (!shard.futex_table.insert_or_find(head, &iter))
         iter->AppendList(head);
 }
 
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.IsHeld());
+bool FutexContext::UnqueueNodeLocked(Shard& shard, FutexNode* node) {
+    DEBUG_ASSERT(shard.lock.IsHeld());
 
     if (!node->IsInQueue())
         return false;
@@ -234,10 +373,10 @@ bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
     // FutexRequeue(), so we need to re-get the hash table key here.
     uintptr_t futex_key = node->GetKey();
 
-    FutexNode* old_head = futex_table_.erase(futex_key);
+    FutexNode* old_head = shard.futex_table.erase(futex_key);
     DEBUG_ASSERT(old_head);
     FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
     if (new_head)
-        futex_table_.insert(new_head);
+        shard.futex_table.insert(new_head);
     return true;
-}
+}
\ No newline at end of file
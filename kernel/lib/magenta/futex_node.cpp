@@ -6,8 +6,11 @@
 
 #include <assert.h>
 #include <err.h>
+#include <kernel/sched.h>
 #include <magenta/futex_node.h>
 #include <magenta/magenta.h>
+#include <magenta/user_thread.h>
+#include <mxtl/type_support.h>
 #include <platform.h>
 #include <trace.h>
 
@@ -133,6 +136,9 @@ void FutexNode::WakeThreads(FutexNode* head) {
     FutexNode* node = head;
     do {
         FutexNode* next = node->queue_next_;
+        // A woken waiter stops donating: it is about to run (and retry the
+        // acquire) on its own priority.
+        node->ReleasePiDonation();
         THREAD_LOCK(state);
         wait_queue_wake_one(&node->wait_queue_, true, NO_ERROR);
         THREAD_UNLOCK(state);
@@ -141,6 +147,54 @@ void FutexNode::WakeThreads(FutexNode* head) {
     } while (node != head);
 }
 
+void FutexNode::SetPiDonation(mxtl::RefPtr<UserThread> owner) {
+    DEBUG_ASSERT(IsInQueue());
+    DEBUG_ASSERT(pi_owner_ == nullptr);
+
+    pi_waiter_thread_ = get_current_thread();
+    pi_owner_ = mxtl::move(owner);
+
+    THREAD_LOCK(state);
+    pi_owner_->futex_donors().push_front(this);
+    RecomputePiLocked(pi_owner_.get());
+    THREAD_UNLOCK(state);
+}
+
+void FutexNode::ReleasePiDonation() {
+    if (pi_owner_ == nullptr)
+        return;
+
+    THREAD_LOCK(state);
+    pi_owner_->futex_donors().erase(*this);
+    RecomputePiLocked(pi_owner_.get());
+    THREAD_UNLOCK(state);
+
+    // Drop the owner reference outside the spinlock: this can be the last
+    // reference to the owner's UserThread.
+    pi_owner_.reset();
+    pi_waiter_thread_ = nullptr;
+}
+
+void FutexNode::ReleaseAllPiDonations(FutexNode* head) {
+    FutexNode* node = head;
+    do {
+        node->ReleasePiDonation();
+        node = node->queue_next_;
+    } while (node != head);
+}
+
+// Recompute the priority |owner| inherits from futex waiters as the max
+// effective priority over its remaining donors.  THREAD_LOCK must be held.
+void FutexNode::RecomputePiLocked(UserThread* owner) {
+    int pri = -1;
+    for (FutexNode& donor : owner->futex_donors()) {
+        int ep = sched_get_effec_priority(donor.pi_waiter_thread_);
+        if (ep > pri)
+            pri = ep;
+    }
+    sched_user_inherit_priority(owner->lk_thread(), pri);
+}
+
 // Set |node1| and |node2|'s list pointers so that |node1| is immediately
 // before |node2| in the linked list.
 void FutexNode::RelinkAsAdjacent(FutexNode* node1, FutexNode* node2) {
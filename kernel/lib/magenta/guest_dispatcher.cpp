@@ -51,6 +51,12 @@ mx_status_t GuestDispatcher::MemTrap(mx_vaddr_t guest_paddr, size_t size) {
     return arch_guest_mem_trap(context_, guest_paddr, size);
 }
 
+mx_status_t GuestDispatcher::Interrupt(uint32_t vector) {
+    canary_.Assert();
+
+    return arch_guest_interrupt(context_, vector);
+}
+
 mx_status_t GuestDispatcher::SetGpr(const mx_guest_gpr_t& guest_gpr) {
     canary_.Assert();
 
@@ -69,6 +75,13 @@ mx_status_t GuestDispatcher::SetApicMem(mxtl::RefPtr<VmObject> apic_mem) {
 
     return x86_guest_set_apic_mem(context_, apic_mem);
 }
+
+mx_status_t GuestDispatcher::SetPortTrap(uint16_t port, uint16_t len,
+                                         mxtl::RefPtr<FifoDispatcher> fifo) {
+    canary_.Assert();
+
+    return x86_guest_set_port_trap(context_, port, len, fifo);
+}
 #endif // ARCH_X86_64
 
 mx_status_t GuestDispatcher::set_ip(uintptr_t guest_ip) {
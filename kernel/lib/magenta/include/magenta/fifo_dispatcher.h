@@ -40,6 +40,11 @@ public:
     mx_status_t WriteFromUser(const uint8_t* src, size_t len, uint32_t* actual);
     mx_status_t ReadToUser(uint8_t* dst, size_t len, uint32_t* actual);
 
+    // MX_FIFO_READABLE is only asserted once at least this many elements
+    // are pending; zero resets to the default of one.
+    mx_status_t SetReadThreshold(uint32_t count);
+    uint32_t ReadThreshold();
+
 private:
     FifoDispatcher(uint32_t elem_count, uint32_t elem_size, uint32_t options);
     mx_status_t Init(mxtl::RefPtr<FifoDispatcher> other);
@@ -63,7 +68,10 @@ private:
     mxtl::RefPtr<FifoDispatcher> other_ TA_GUARDED(lock_);
     uint32_t head_ TA_GUARDED(lock_);
     uint32_t tail_ TA_GUARDED(lock_);
+    uint32_t read_threshold_ TA_GUARDED(lock_);
     uint8_t* data_ TA_GUARDED(lock_);
 
-    static constexpr uint32_t kMaxSizeBytes = PAGE_SIZE;
+    // Deep enough for high-rate producer/consumer pairs (the block and
+    // ethernet fifos) to batch without back-pressure stalls.
+    static constexpr uint32_t kMaxSizeBytes = 16 * PAGE_SIZE;
 };
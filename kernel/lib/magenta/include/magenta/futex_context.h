@@ -38,6 +38,19 @@ public:
     // FutexWake will wake up to |count| number of threads blocked on the |value_ptr| futex.
     status_t FutexWake(user_ptr<const int> value_ptr, uint32_t count);
 
+    // FutexWaitPi is FutexWait for a priority-inheritance futex.  The futex
+    // word holds the owning thread's handle value, with
+    // MX_FUTEX_PI_CONTESTED set once a waiter exists; |current_value| must
+    // name a live thread of this process, and that thread inherits the
+    // caller's effective priority for as long as the caller stays queued.
+    status_t FutexWaitPi(user_ptr<int> value_ptr, int current_value, mx_time_t deadline);
+
+    // FutexWakePi wakes up to |count| threads like FutexWake, but first
+    // ends the current ownership epoch: every queued waiter's donation to
+    // the old owner is withdrawn, woken or not.  Called by the owner when
+    // it releases the futex.
+    status_t FutexWakePi(user_ptr<const int> value_ptr, uint32_t count);
+
     // FutexWait first verifies that the integer pointed to by |wake_ptr|
     // still equals |current_value|. If the test fails, FutexWait returns FAILED_PRECONDITION.
     // Otherwise it will wake up to |wake_count| number of threads blocked on the |wake_ptr| futex.
@@ -51,14 +64,43 @@ private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    // The futexes of a process are sharded by address across several
+    // independently locked hash tables, so operations on unrelated futexes
+    // do not serialize against each other.
+    static constexpr size_t kNumShards = 16u;
+
+    struct Shard {
+        // protects futex_table
+        Mutex lock;
+
+        // Hash table for the futexes falling in this shard.
+        // Key is futex address, value is the FutexNode for the head of futex's
+        // blocked thread list.
+        FutexNode::HashTable futex_table TA_GUARDED(lock);
+    };
+
+    static size_t ShardIndex(uintptr_t futex_key) {
+        // futex keys are int aligned; drop the dead bits before folding
+        return (futex_key >> 2) % kNumShards;
+    }
+    Shard& ShardForKey(uintptr_t futex_key) { return shards_[ShardIndex(futex_key)]; }
+
+    // Acquire the lock of the shard a node's futex currently hashes to,
+    // rechecking after the acquire in case a concurrent requeue moved the
+    // node to a different futex.
+    Shard& LockShardForNode(FutexNode* node);
+
+    // Common implementation of FutexWait and FutexWaitPi.
+    status_t FutexWaitInternal(user_ptr<int> value_ptr, int current_value,
+                               bool pi, mx_time_t deadline);
+
+    // Resolve the owner handle embedded in a PI futex's |value| to a
+    // thread of the calling process.
+    static status_t GetPiOwner(int value, mxtl::RefPtr<UserThread>* out);
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+    static void QueueNodesLocked(Shard& shard, FutexNode* head);
 
-    // protects futex_table_
-    Mutex lock_;
+    static bool UnqueueNodeLocked(Shard& shard, FutexNode* node);
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    Shard shards_[kNumShards];
 };
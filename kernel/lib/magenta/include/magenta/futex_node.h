@@ -11,7 +11,11 @@
 #include <kernel/wait.h>
 #include <list.h>
 #include <magenta/types.h>
+#include <mxtl/intrusive_double_list.h>
 #include <mxtl/intrusive_hash_table.h>
+#include <mxtl/ref_ptr.h>
+
+class UserThread;
 
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a UserThread Instance
@@ -19,6 +23,16 @@ class FutexNode : public mxtl::SinglyLinkedListable<FutexNode*> {
 public:
     using HashTable = mxtl::HashTable<uintptr_t, FutexNode*>;
 
+    // Secondary containment: the list of nodes currently donating their
+    // waiter's priority to one PI futex owner, anchored in the owner's
+    // UserThread.
+    struct PiDonorListTraits {
+        static mxtl::DoublyLinkedListNodeState<FutexNode*>& node_state(FutexNode& node) {
+            return node.pi_donor_node_;
+        }
+    };
+    using PiDonorList = mxtl::DoublyLinkedList<FutexNode*, PiDonorListTraits>;
+
     FutexNode();
     ~FutexNode();
 
@@ -44,6 +58,21 @@ public:
     // wakes the list of threads starting with node |head|
     static void WakeThreads(FutexNode* head);
 
+    // Declare |owner| the holder of the futex this node is queued on, and
+    // donate the calling (waiting) thread's effective priority to it for
+    // as long as the node stays queued.  Must be called by the waiting
+    // thread after queuing, before BlockThread(), with the shard lock held.
+    void SetPiDonation(mxtl::RefPtr<UserThread> owner);
+
+    // Withdraw this node's donation, if any, recomputing what the owner
+    // inherits from its remaining donors.  Called with the shard lock of
+    // the node's current futex held.
+    void ReleasePiDonation();
+
+    // Withdraw the donations of every node on the circular list headed by
+    // |head|; used when a PI futex owner releases the futex.
+    static void ReleaseAllPiDonations(FutexNode* head);
+
     void set_hash_key(uintptr_t key) {
         hash_key_ = key;
     }
@@ -58,6 +87,8 @@ private:
 
     void MarkAsNotInQueue();
 
+    static void RecomputePiLocked(UserThread* owner);
+
     // hash_key_ contains the futex address.  This field has two roles:
     //  * It is used by FutexWait() to determine which queue to remove the
     //    thread from when a wait operation times out.
@@ -76,4 +107,11 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    // While donating, the waiting thread and the owner donated to.
+    // pi_owner_ keeps the owner's UserThread (and thus its thread_t)
+    // alive until the donation is withdrawn.
+    thread_t* pi_waiter_thread_ = nullptr;
+    mxtl::RefPtr<UserThread> pi_owner_;
+    mxtl::DoublyLinkedListNodeState<FutexNode*> pi_donor_node_;
 };
@@ -7,8 +7,10 @@
 #pragma once
 
 #include <kernel/event.h>
+#include <platform.h>
 
 #include <magenta/dispatcher.h>
+#include <magenta/syscalls/object.h>
 #include <mxtl/canary.h>
 #include <sys/types.h>
 
@@ -35,7 +37,27 @@ public:
     virtual status_t UserSignal() = 0;
 
     status_t WaitForInterrupt() {
-        return event_wait_deadline(&event_, INFINITE_TIME, true);
+        status_t status = event_wait_deadline(&event_, INFINITE_TIME, true);
+        if (status == NO_ERROR) {
+            // Charge the time from the hard IRQ to our wakeup against this
+            // vector, so interrupt storms that delay us show up in the stats.
+            mx_time_t signaled = last_signaled_;
+            if (signaled != 0) {
+                mx_duration_t latency = current_time() - signaled;
+                dispatch_latency_total_ += latency;
+                if (latency > dispatch_latency_max_)
+                    dispatch_latency_max_ = latency;
+            }
+        }
+        return status;
+    }
+
+    status_t GetStats(mx_info_irq_stats_t* info) {
+        info->interrupts = interrupts_;
+        info->last_signaled = last_signaled_;
+        info->dispatch_latency_total = dispatch_latency_total_;
+        info->dispatch_latency_max = dispatch_latency_max_;
+        return NO_ERROR;
     }
 
     virtual void on_zero_handles() final {
@@ -48,6 +70,10 @@ protected:
         event_init(&event_, false, 0);
     }
     int signal(bool resched = false) {
+        // The stats are written from IRQ context and read without locking;
+        // they are approximate by design.
+        interrupts_++;
+        last_signaled_ = current_time();
         return event_signal(&event_, resched);
     }
     void unsignal() {
@@ -57,4 +83,8 @@ protected:
 private:
     mxtl::Canary<mxtl::magic("INTD")> canary_;
     event_t event_;
+    uint64_t interrupts_ = 0;
+    mx_time_t last_signaled_ = 0;
+    mx_duration_t dispatch_latency_total_ = 0;
+    mx_duration_t dispatch_latency_max_ = 0;
 };
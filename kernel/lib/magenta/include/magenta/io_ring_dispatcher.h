@@ -0,0 +1,54 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <kernel/mutex.h>
+#include <kernel/vm/vm_object.h>
+
+#include <magenta/dispatcher.h>
+#include <magenta/syscalls/ioring.h>
+#include <mxtl/canary.h>
+#include <mxtl/ref_ptr.h>
+
+#include <sys/types.h>
+
+// Executes one submission, filling in |cqe->status| and |cqe->actual|.
+// |cqe->user_data| is already set. The return value is for errors in the
+// ring machinery itself; per-operation failures belong in |cqe->status|.
+typedef mx_status_t (*ioring_op_fn_t)(void* cookie, const mx_ioring_sqe_t* sqe,
+                                      mx_ioring_cqe_t* cqe);
+
+// Owns the ring VMO and implements the ring protocol described in
+// magenta/syscalls/ioring.h. Opcode dispatch lives in the syscall layer,
+// which passes it in as |op_fn|; the dispatcher only moves entries.
+class IoRingDispatcher final : public Dispatcher {
+public:
+    static status_t Create(uint32_t entries, uint32_t options,
+                           mxtl::RefPtr<Dispatcher>* dispatcher,
+                           mxtl::RefPtr<VmObject>* out_vmo,
+                           mx_rights_t* rights);
+
+    ~IoRingDispatcher() final;
+    mx_obj_type_t get_type() const final { return MX_OBJ_TYPE_IORING; }
+
+    // Consumes every pending submission, calling |op_fn| on each and
+    // posting its completion. Stops early if the completion ring is full.
+    // Returns the number of operations completed in |num_completed|.
+    mx_status_t Submit(ioring_op_fn_t op_fn, void* cookie, uint32_t* num_completed);
+
+private:
+    IoRingDispatcher(mxtl::RefPtr<VmObject> vmo, uint32_t entries);
+
+    mxtl::Canary<mxtl::magic("IORN")> canary_;
+    const uint32_t entries_;
+    const uint32_t mask_;
+
+    Mutex lock_;
+    mxtl::RefPtr<VmObject> vmo_ TA_GUARDED(lock_);
+
+    static constexpr uint32_t kMaxEntries = 4096u;
+};
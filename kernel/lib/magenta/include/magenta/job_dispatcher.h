@@ -74,8 +74,8 @@ public:
     void get_name(char out_name[MX_MAX_NAME_LEN]) const final;
     status_t set_name(const char* name, size_t len) final;
     uint32_t max_height() const { return max_height_; }
-    uint32_t process_count() const TA_REQ(lock_) { return process_count_;}
-    uint32_t job_count() const TA_REQ(lock_) { return job_count_; }
+    uint32_t process_count();
+    uint32_t job_count();
     bool AddChildProcess(ProcessDispatcher* process);
     void RemoveChildProcess(ProcessDispatcher* process);
     void Kill();
@@ -87,7 +87,11 @@ public:
 
     // Walks the job/process tree and invokes |je| methods on each node. If
     // |recurse| is false, only visits direct children of this job. Returns
-    // false if any methods of |je| return false; returns true otherwise.
+    // false if any methods of |je| return false or if the snapshot of the
+    // children cannot be allocated; returns true otherwise.
+    //
+    // The walk runs against a snapshot of the child lists, without
+    // this job's lock held, so it never blocks process or job creation.
     bool EnumerateChildren(JobEnumerator* je, bool recurse);
 
     mxtl::RefPtr<ProcessDispatcher> LookupProcessById(mx_koid_t koid);
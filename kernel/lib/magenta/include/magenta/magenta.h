@@ -8,6 +8,8 @@
 
 #include <stdint.h>
 
+#include <arch/spinlock.h>
+
 #include <magenta/handle.h>
 #include <magenta/types.h>
 
@@ -35,6 +37,18 @@ void DeleteHandle(Handle* handle);
 // Maps an integer obtained by Handle->base_value() back to a Handle.
 Handle* MapU32ToHandle(uint32_t value);
 
+// Lock-free variant of MapU32ToHandle() for the syscall lookup fast path.
+// Disables interrupts and publishes the candidate Handle in this CPU's
+// hazard slot before validating it, so that DeleteHandle() cannot tear the
+// handle down while the caller examines it. Returns nullptr on a miss; a
+// miss can be spurious, so the caller should fall back to the locked path.
+// The caller must call HandleHazardRelease() in both cases and must not
+// block in between.
+Handle* HandleHazardAcquire(uint32_t value, spin_lock_saved_state_t* state);
+
+// Ends the critical section opened by HandleHazardAcquire().
+void HandleHazardRelease(spin_lock_saved_state_t state);
+
 // Set/get the system exception port.
 mx_status_t SetSystemExceptionPort(mxtl::RefPtr<ExceptionPort> eport);
 // Returns true if a port had been set.
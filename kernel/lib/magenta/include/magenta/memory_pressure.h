@@ -0,0 +1,19 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <magenta/dispatcher.h>
+#include <magenta/types.h>
+#include <mxtl/ref_ptr.h>
+
+// Returns the kernel-owned event for one of the MX_MEM_PRESSURE_* levels,
+// creating it on first use. The event is signaled (MX_EVENT_SIGNALED) while
+// the measured memory pressure is at or above the level; the NORMAL event is
+// signaled only while no pressure is present. The returned rights do not
+// allow userspace to signal the event.
+status_t GetMemoryPressureEvent(uint32_t level, mxtl::RefPtr<Dispatcher>* dispatcher,
+                                mx_rights_t* rights);
@@ -51,13 +51,15 @@ private:
     MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles);
     ~MessagePacket();
 
-    static void operator delete(void* ptr) {
-        free(ptr);
-    }
+    static void operator delete(void* ptr);
     friend class mxtl::unique_ptr<MessagePacket>;
 
     bool owns_handles_;
     uint32_t data_size_;
     uint32_t num_handles_;
     Handle** handles_;
+
+    // which per-cpu cache size class this packet's storage came from,
+    // or kCacheClassNone if it came straight from the heap
+    uint32_t cache_class_;
 };
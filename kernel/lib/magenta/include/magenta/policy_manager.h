@@ -70,6 +70,12 @@ public:
     // MX_POL_ACTION_DENY all other failure modes.
     uint32_t QueryBasicPolicy(pol_cookie_t policy, uint32_t condition);
 
+    // Returns a bitmask with bit |condition| set for every condition that
+    // QueryBasicPolicy() would deny under |policy|. Lets callers that only
+    // care about allow-vs-deny (the syscall path) flatten the policy into
+    // a single word and skip the per-query decode.
+    uint32_t ComputeDenyMask(pol_cookie_t policy);
+
 private:
     PolicyManager(uint32_t default_action);
     ~PolicyManager() = default;
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <kernel/mutex.h>
+#include <kernel/spinlock.h>
 
 #include <magenta/dispatcher.h>
 #include <magenta/semaphore.h>
@@ -82,6 +83,9 @@ class PortObserver;
 struct PortPacket final : public mxtl::DoublyLinkedListable<PortPacket*> {
     mx_port_packet_t packet;
     PortObserver* observer;
+    // true for packets carved from their port's preallocated pool, which
+    // return to the pool instead of the heap when consumed
+    bool from_pool;
 
     PortPacket();
     PortPacket(const PortPacket&) = delete;
@@ -104,6 +108,10 @@ public:
     const void* handle() const { return handle_; }
     uint64_t key() const { return key_; }
 
+    // MaybeQueue() only acts on the trigger bits, so signal updates that
+    // don't touch them can skip this observer entirely.
+    mx_signals_t watched_signals() const final { return trigger_; }
+
 private:
     PortObserver(const PortObserver&) = delete;
     PortObserver& operator=(const PortObserver&) = delete;
@@ -139,10 +147,25 @@ public:
 
     void on_zero_handles() final;
 
+    // Upper bound on the packets DeQueueMany() will pop in one call; also
+    // bounds the caller's stack buffers.
+    static constexpr size_t kMaxDeQueueBatch = 16u;
+
+    // User packets preallocated per port at creation; QueueUser() is
+    // allocation-free until this many packets are queued at once, then
+    // falls back to the heap.
+    static constexpr size_t kPacketPoolSize = 32u;
+
     mx_status_t Queue(PortPacket* port_packet, mx_signals_t observed, uint64_t count);
     mx_status_t QueueUser(const mx_port_packet_t& packet);
     mx_status_t DeQueue(mx_time_t deadline, mx_port_packet_t* packet);
 
+    // Like DeQueue() but pops up to |count| packets in a single lock
+    // acquisition. Blocks until at least one packet is available or the
+    // deadline passes; never returns with |*actual| == 0 on NO_ERROR.
+    mx_status_t DeQueueMany(mx_time_t deadline, mx_port_packet_t* packets,
+                            size_t count, size_t* actual);
+
     // Decides who is going to destroy the observer. If it returns |true| it
     // is the duty of the caller. If it is false it is the duty of the port.
     bool CanReap(PortObserver* observer, PortPacket* port_packet);
@@ -156,12 +179,24 @@ public:
     bool CancelQueued(const void* handle, uint64_t key);
 
 private:
-    PortDispatcherV2(uint32_t options);
+    PortDispatcherV2(uint32_t options, mxtl::unique_ptr<PortPacket[]> pool);
     PortObserver* CopyLocked(PortPacket* port_packet, mx_port_packet_t* packet) TA_REQ(lock_);
 
+    // Pop a user packet from the pool, or nullptr when it is exhausted.
+    PortPacket* AllocUserPacket();
+    // Return a consumed user packet to the pool or the heap, depending
+    // on where it came from.
+    void FreeUserPacket(PortPacket* port_packet);
+
     mxtl::Canary<mxtl::magic("POR2")> canary_;
     Mutex lock_;
     Semaphore sema_;
     bool zero_handles_ TA_GUARDED(lock_);
     mxtl::DoublyLinkedList<PortPacket*> packets_ TA_GUARDED(lock_);
+
+    // Preallocated user packet pool; a spin lock guards the free list so
+    // get/put are cheap O(1) operations with no blocking.
+    SpinLock pool_lock_;
+    mxtl::DoublyLinkedList<PortPacket*> free_packets_ TA_GUARDED(pool_lock_);
+    mxtl::unique_ptr<PortPacket[]> packet_pool_;
 };
@@ -24,6 +24,7 @@
 #include <mxtl/array.h>
 #include <mxtl/canary.h>
 #include <mxtl/intrusive_double_list.h>
+#include <mxtl/intrusive_wavl_tree.h>
 #include <mxtl/name.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
@@ -199,10 +200,14 @@ public:
     uint32_t ThreadCount() const;
     size_t PageCount() const;
 
-    // Look up a process given its koid.
+    // Look up a process given its koid. This is an O(log n) search of the
+    // global koid index, not a walk of the job tree.
     // Returns nullptr if not found.
     static mxtl::RefPtr<ProcessDispatcher> LookupProcessById(mx_koid_t koid);
 
+    // Required to live in the global koid index.
+    mx_koid_t GetKey() const { return get_koid(); }
+
     // Look up a thread in this process given its koid.
     // Returns nullptr if not found.
     mxtl::RefPtr<UserThread> LookupThreadById(mx_koid_t koid);
@@ -238,9 +243,16 @@ public:
     }
 
 private:
+    using ProcessIndex = mxtl::WAVLTree<mx_koid_t, ProcessDispatcher*>;
+    friend mxtl::DefaultWAVLTreeTraits<ProcessDispatcher*>;
+
     // compute the vdso code address and store in vdso_code_address_
     uintptr_t cache_vdso_code_address();
 
+    // Removes this process from the global koid index; idempotent, called
+    // from both the -> DEAD transition and the destructor.
+    void RemoveFromIndex();
+
     // The diagnostic code is allow to know about the internals of this code.
     friend void DumpProcessList();
     friend uint32_t BuildHandleStats(const ProcessDispatcher&, uint32_t*, size_t);
@@ -280,6 +292,12 @@ private:
     // Policy set by the Job during Create().
     const pol_cookie_t policy_;
 
+    // Deny bit per MX_POL_xxxxx condition, flattened from |policy_| at
+    // creation so QueryPolicy() is a single load. Never stale: a job's
+    // policy cannot change once it has processes (see JobDispatcher::
+    // SetPolicy), and |policy_| itself is snapshotted at creation.
+    const uint32_t policy_deny_mask_;
+
     // The process can belong to either of these lists independently.
     mxtl::DoublyLinkedListNodeState<ProcessDispatcher*> dll_job_weak_;
     mxtl::SinglyLinkedListNodeState<mxtl::RefPtr<ProcessDispatcher>> dll_job_;
@@ -322,6 +340,13 @@ private:
     // The user-friendly process name. For debug purposes only. That
     // is, there is no mechanism to mint a handle to a process via this name.
     mxtl::Name<MX_MAX_NAME_LEN> name_;
+
+    // Global index of live processes by koid, backing LookupProcessById().
+    // Membership tracks the parent job's weak child list: inserted after
+    // AddChildProcess() succeeds, removed alongside RemoveChildProcess().
+    mxtl::WAVLTreeNodeState<ProcessDispatcher*> wavl_node_state_;
+    static Mutex index_lock_;
+    static ProcessIndex index_ TA_GUARDED(index_lock_);
 };
 
 const char* StateToString(ProcessDispatcher::State state);
@@ -28,6 +28,18 @@ constexpr int kMBufSize = 2048 - 8 - 4 - 4;
 
 constexpr int kSocketSizeMax = 128 * kMBufSize;
 
+static_assert(kMBufSize == MX_SOCKET_MAX_DGRAM_BYTES,
+              "the public datagram size limit must match the MBuf payload size");
+
+// Maximum number of datagrams queued in a MX_SOCKET_DATAGRAM socket.
+// Each datagram occupies a whole MBuf, so the byte-based kSocketSizeMax
+// would overcommit the queue.
+constexpr size_t kSocketDatagramMax = 128;
+
+// Capacity of the ring buffer backing a MX_SOCKET_MAPPED socket.
+// Must be a multiple of PAGE_SIZE.
+constexpr size_t kSocketRingSize = 256 * 1024u;
+
 class SocketDispatcher final : public Dispatcher {
 public:
     static status_t Create(uint32_t flags, mxtl::RefPtr<Dispatcher>* dispatcher0,
@@ -50,6 +62,26 @@ public:
 
     mx_status_t Read(user_ptr<void> dst, size_t len, size_t* nread);
 
+    // For MX_SOCKET_DATAGRAM sockets: writes up to |count| datagrams
+    // described by |msgs|, taking the peer's lock once for the whole
+    // batch. |*nwritten| is the number of datagrams sent.
+    mx_status_t WriteBatch(const mx_iovec_t* msgs, size_t count, size_t* nwritten);
+
+    // For MX_SOCKET_DATAGRAM sockets: reads up to |count| datagrams into
+    // the buffers described by |msgs|, storing each datagram's copied
+    // length in |actuals|. |*nread| is the number of datagrams received.
+    mx_status_t ReadBatch(const mx_iovec_t* msgs, size_t count,
+                          size_t* actuals, size_t* nread);
+
+    // For MX_SOCKET_MAPPED sockets: advances the read cursor by up to
+    // |len| bytes without copying, for consumers that read the payload
+    // through a mapping of the ring VMO.
+    mx_status_t Consume(size_t len, size_t* consumed);
+
+    // For MX_SOCKET_MAPPED sockets: returns the VMO backing this
+    // endpoint's receive ring.
+    mx_status_t GetMappedBuffer(mxtl::RefPtr<VmObject>* out);
+
     void OnPeerZeroHandles();
 
 private:
@@ -67,11 +99,18 @@ private:
     SocketDispatcher(uint32_t flags);
     mx_status_t Init(mxtl::RefPtr<SocketDispatcher> other);
     mx_status_t WriteSelf(user_ptr<const void> src, size_t len, size_t* nwritten);
+    mx_status_t WriteBatchSelf(const mx_iovec_t* msgs, size_t count, size_t* nwritten);
     status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
     status_t HalfCloseOther();
 
+    bool is_datagram() const { return (flags_ & MX_SOCKET_DATAGRAM) != 0; }
+
     size_t WriteMBufs(user_ptr<const void> src, size_t len) TA_REQ(lock_);
     size_t ReadMBufs(user_ptr<void> dst, size_t len) TA_REQ(lock_);
+    mx_status_t WriteDatagram(user_ptr<const void> src, size_t len) TA_REQ(lock_);
+    mx_status_t ReadDatagram(user_ptr<void> dst, size_t len, size_t* nread) TA_REQ(lock_);
+    size_t WriteRing(user_ptr<const void> src, size_t len) TA_REQ(lock_);
+    size_t ReadRing(user_ptr<void> dst, size_t len) TA_REQ(lock_);
     MBuf* AllocMBuf() TA_REQ(lock_);
     void FreeMBuf(MBuf* buf) TA_REQ(lock_);
     bool is_full() const TA_REQ(lock_);
@@ -79,6 +118,7 @@ private:
 
     mxtl::Canary<mxtl::magic("SOCK")> canary_;
 
+    const uint32_t flags_;
     mx_koid_t peer_koid_;
     StateTracker state_tracker_;
 
@@ -88,6 +128,13 @@ private:
     mxtl::SinglyLinkedList<MBuf*> tail_ TA_GUARDED(lock_);
     MBuf* head_ TA_GUARDED(lock_);
     size_t size_ TA_GUARDED(lock_);
+    // MX_SOCKET_DATAGRAM only: number of queued datagrams.
+    size_t dgram_count_ TA_GUARDED(lock_);
+    // MX_SOCKET_MAPPED only: the receive ring VMO and its monotonically
+    // increasing write/read cursors (|size_| == ring_head_ - ring_tail_).
+    mxtl::RefPtr<VmObject> ring_ TA_GUARDED(lock_);
+    uint64_t ring_head_ TA_GUARDED(lock_);
+    uint64_t ring_tail_ TA_GUARDED(lock_);
     mxtl::RefPtr<SocketDispatcher> other_ TA_GUARDED(lock_);
     mxtl::unique_ptr<PortClient> iopc_ TA_GUARDED(lock_);
     // half_closed_[0] is this end and [1] is the other end.
@@ -57,6 +57,12 @@ public:
     // is safe to delete the observer.
     virtual void OnRemoved() {}
 
+    // Returns the set of signals this observer is interested in. StateTracker uses it to skip
+    // OnStateChange() for observers none of whose watched bits changed. Observers whose
+    // OnStateChange() has side effects beyond a fixed trigger set should keep the default of
+    // all signals.
+    virtual mx_signals_t watched_signals() const { return ~0u; }
+
     // Return true to have the observer removed from the state_observer after calling either
     // OnInitialize() OnStateChange() or OnCancel().
     bool remove() const { return remove_; }
@@ -12,6 +12,7 @@
 #include <kernel/spinlock.h>
 #include <magenta/state_observer.h>
 #include <magenta/types.h>
+#include <mxtl/atomic.h>
 #include <mxtl/canary.h>
 #include <mxtl/intrusive_double_list.h>
 
@@ -55,7 +56,7 @@ public:
 
     // Nofity others with MX_SIGNAL_LAST_HANDLE if the value pointed by |count| is 1. This
     // value is allowed to mutate by other threads while this call is executing.
-    void UpdateLastHandleSignal(uint32_t* count);
+    void UpdateLastHandleSignal(const mxtl::atomic<uint32_t>* count);
 
     mx_signals_t GetSignalsState() { return signals_; }
 
@@ -71,7 +72,10 @@ public:
 
 private:
     // Returns true if one of the observers have been signaled. False otherwise.
-    bool UpdateInternalLocked(ObserverList* obs_to_remove, mx_signals_t signals) TA_REQ(lock_);
+    // |changed| is the set of signals that differ from the previously published
+    // state; observers not watching any of those bits are skipped.
+    bool UpdateInternalLocked(ObserverList* obs_to_remove, mx_signals_t signals,
+                              mx_signals_t changed) TA_REQ(lock_);
 
     mxtl::Canary<mxtl::magic("STRK")> canary_;
 
@@ -80,4 +84,8 @@ private:
 
     // Active observers are elements in |observers_|.
     ObserverList observers_ TA_GUARDED(lock_);
+
+    // Union of the observers' watched signals; may over-approximate after
+    // observers are removed by cancellation, which only costs a list walk.
+    mx_signals_t interest_ TA_GUARDED(lock_) = 0u;
 };
@@ -97,11 +97,17 @@ public:
     ThreadDispatcher* dispatcher() { return dispatcher_; }
 
     FutexNode* futex_node() { return &futex_node_; }
+    // Futex waiters donating their priority to this thread while it owns a
+    // PI futex; maintained under the THREAD_LOCK (see FutexNode).
+    FutexNode::PiDonorList& futex_donors() { return futex_donors_; }
+    // The underlying LK thread, for scheduler interactions (futex PI).
+    thread_t* lk_thread() { return &thread_; }
     StateTracker* state_tracker() { return &state_tracker_; }
     const char* name() const { return thread_.name; }
     status_t set_name(const char* name, size_t len);
     void get_name(char out_name[MX_MAX_NAME_LEN]);
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
+    uint64_t queued_ns(uint64_t* max_out) const { return thread_queued_time(&thread_, max_out); }
 
     status_t SetExceptionPort(ThreadDispatcher* td, mxtl::RefPtr<ExceptionPort> eport);
     // Returns true if a port had been set.
@@ -151,6 +157,14 @@ public:
     // privileged and unprivileged fields.
     status_t WriteState(uint32_t state_kind, const void* buffer, uint32_t buffer_len, bool priv);
 
+    // Place the thread in (or, with zero parameters, remove it from) the
+    // deadline scheduling class.
+    status_t SetDeadline(mx_duration_t capacity, mx_duration_t period);
+
+    // Restrict the thread to the given bitmask of cpus.
+    status_t SetCpuAffinity(uint32_t affinity);
+    uint32_t cpu_affinity() const { return thread_.cpu_affinity; }
+
     mx_koid_t get_koid() const { return koid_; }
     void set_dispatcher(ThreadDispatcher* dispatcher);
 
@@ -207,6 +221,11 @@ private:
     // Node for linked list of threads blocked on a futex
     FutexNode futex_node_;
 
+    // Futex waiters currently donating priority to this thread.  Donors
+    // hold a reference on us, so the list is necessarily empty by the time
+    // we can be destroyed.
+    FutexNode::PiDonorList futex_donors_;
+
     StateTracker state_tracker_;
 
     // A thread-level exception port for this thread.
@@ -36,6 +36,8 @@ public:
     mx_status_t SetSize(uint64_t);
     mx_status_t GetSize(uint64_t* size);
     mx_status_t RangeOp(uint32_t op, uint64_t offset, uint64_t size, user_ptr<void> buffer, size_t buffer_size);
+    mx_status_t Transfer(mxtl::RefPtr<VmObjectDispatcher> dest, uint64_t offset,
+                         uint64_t dest_offset, uint64_t length, uint64_t* actual);
     mx_status_t Clone(uint32_t options, uint64_t offset, uint64_t size, bool copy_name, mxtl::RefPtr<VmObject>* clone_vmo);
     mx_status_t SetMappingCachePolicy(uint32_t cache_policy);
 
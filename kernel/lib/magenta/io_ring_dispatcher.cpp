@@ -0,0 +1,120 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <magenta/io_ring_dispatcher.h>
+
+#include <err.h>
+#include <string.h>
+
+#include <kernel/auto_lock.h>
+#include <kernel/vm/vm_object_paged.h>
+#include <mxalloc/new.h>
+
+constexpr mx_rights_t kDefaultIoRingRights =
+    MX_RIGHT_TRANSFER | MX_RIGHT_READ | MX_RIGHT_WRITE;
+
+// static
+status_t IoRingDispatcher::Create(uint32_t entries, uint32_t options,
+                                  mxtl::RefPtr<Dispatcher>* dispatcher,
+                                  mxtl::RefPtr<VmObject>* out_vmo,
+                                  mx_rights_t* rights) {
+    if (options)
+        return ERR_INVALID_ARGS;
+
+    // entries must be a nonzero power of two
+    if (!entries || (entries & (entries - 1)) || (entries > kMaxEntries))
+        return ERR_OUT_OF_RANGE;
+
+    // the rings live in a fresh vmo; pages are zero filled, which leaves
+    // both rings empty
+    mxtl::RefPtr<VmObject> vmo = VmObjectPaged::Create(0, MX_IORING_VMO_SIZE(entries));
+    if (!vmo)
+        return ERR_NO_MEMORY;
+
+    AllocChecker ac;
+    auto disp = mxtl::AdoptRef(new (&ac) IoRingDispatcher(vmo, entries));
+    if (!ac.check())
+        return ERR_NO_MEMORY;
+
+    *rights = kDefaultIoRingRights;
+    *dispatcher = mxtl::RefPtr<Dispatcher>(disp.get());
+    *out_vmo = mxtl::move(vmo);
+    return NO_ERROR;
+}
+
+IoRingDispatcher::IoRingDispatcher(mxtl::RefPtr<VmObject> vmo, uint32_t entries)
+    : entries_(entries), mask_(entries - 1), vmo_(mxtl::move(vmo)) {
+}
+
+IoRingDispatcher::~IoRingDispatcher() {
+}
+
+mx_status_t IoRingDispatcher::Submit(ioring_op_fn_t op_fn, void* cookie,
+                                     uint32_t* num_completed) {
+    canary_.Assert();
+
+    AutoLock al(&lock_);
+
+    mx_ioring_hdr_t hdr;
+    size_t actual;
+    mx_status_t status = vmo_->Read(&hdr, 0u, sizeof(hdr), &actual);
+    if (status != NO_ERROR)
+        return status;
+    if (actual != sizeof(hdr))
+        return ERR_BAD_STATE;
+
+    // the indices are free running, so the producer can be at most a full
+    // ring ahead of the consumer; anything else means userspace scribbled
+    // on the header
+    if ((hdr.sq_tail - hdr.sq_head > entries_) ||
+        (hdr.cq_tail - hdr.cq_head > entries_))
+        return ERR_BAD_STATE;
+
+    uint32_t completed = 0u;
+    while (hdr.sq_head != hdr.sq_tail) {
+        // every submission produces exactly one completion, so stop if
+        // there is no room left for one
+        if (hdr.cq_tail - hdr.cq_head == entries_)
+            break;
+
+        mx_ioring_sqe_t sqe;
+        uint64_t sqe_off = MX_IORING_SQES_OFFSET +
+                           (uint64_t)(hdr.sq_head & mask_) * sizeof(sqe);
+        status = vmo_->Read(&sqe, sqe_off, sizeof(sqe), &actual);
+        if (status != NO_ERROR)
+            return status;
+
+        mx_ioring_cqe_t cqe;
+        memset(&cqe, 0, sizeof(cqe));
+        cqe.user_data = sqe.user_data;
+        status = op_fn(cookie, &sqe, &cqe);
+        if (status != NO_ERROR)
+            return status;
+
+        uint64_t cqe_off = MX_IORING_CQES_OFFSET(entries_) +
+                           (uint64_t)(hdr.cq_tail & mask_) * sizeof(cqe);
+        status = vmo_->Write(&cqe, cqe_off, sizeof(cqe), &actual);
+        if (status != NO_ERROR)
+            return status;
+
+        hdr.sq_head++;
+        hdr.cq_tail++;
+        completed++;
+    }
+
+    // publish the new indices; only our two words, the user owns the others
+    status = vmo_->Write(&hdr.sq_head, offsetof(mx_ioring_hdr_t, sq_head),
+                         sizeof(hdr.sq_head), &actual);
+    if (status != NO_ERROR)
+        return status;
+    status = vmo_->Write(&hdr.cq_tail, offsetof(mx_ioring_hdr_t, cq_tail),
+                         sizeof(hdr.cq_tail), &actual);
+    if (status != NO_ERROR)
+        return status;
+
+    *num_completed = completed;
+    return NO_ERROR;
+}
@@ -172,6 +172,16 @@ pol_cookie_t JobDispatcher::GetPolicy() {
     return policy_;
 }
 
+uint32_t JobDispatcher::process_count() {
+    AutoLock lock(&lock_);
+    return process_count_;
+}
+
+uint32_t JobDispatcher::job_count() {
+    AutoLock lock(&lock_);
+    return job_count_;
+}
+
 void JobDispatcher::Kill() {
     canary_.Assert();
 
@@ -234,21 +244,51 @@ status_t JobDispatcher::SetPolicy(
 bool JobDispatcher::EnumerateChildren(JobEnumerator* je, bool recurse) {
     canary_.Assert();
 
-    AutoLock lock(&lock_);
+    // Snapshot the children into refcounted arrays and run the
+    // callbacks (and any recursion) against the snapshot, with |lock_|
+    // dropped. Holding the lock across a recursive walk would block
+    // process and job creation in every job on the path for the whole
+    // walk, which utilities like ps make painfully long on a loaded
+    // system.
+    mxtl::Array<mxtl::RefPtr<ProcessDispatcher>> procs;
+    mxtl::Array<mxtl::RefPtr<JobDispatcher>> jobs;
+    {
+        AutoLock lock(&lock_);
+        AllocChecker ac;
+        procs.reset(new (&ac) mxtl::RefPtr<ProcessDispatcher>[process_count_],
+                    process_count_);
+        if (!ac.check())
+            return false;
+        jobs.reset(new (&ac) mxtl::RefPtr<JobDispatcher>[job_count_],
+                   job_count_);
+        if (!ac.check())
+            return false;
 
-    for (auto& proc : procs_) {
-        if (!je->OnProcess(&proc)) {
+        size_t i = 0;
+        for (auto& proc : procs_) {
+            procs[i++] = mxtl::RefPtr<ProcessDispatcher>(&proc);
+        }
+        DEBUG_ASSERT(i == process_count_);
+        i = 0;
+        for (auto& job : jobs_) {
+            jobs[i++] = mxtl::RefPtr<JobDispatcher>(&job);
+        }
+        DEBUG_ASSERT(i == job_count_);
+    }
+
+    for (const auto& proc : procs) {
+        if (!je->OnProcess(proc.get())) {
             return false;
         }
     }
 
-    for (auto& job : jobs_) {
-        if (!je->OnJob(&job)) {
+    for (const auto& job : jobs) {
+        if (!je->OnJob(job.get())) {
             return false;
         }
         if (recurse) {
             // TODO(kulakowski): This recursive call can overflow the stack.
-            if (!job.EnumerateChildren(je, /* recurse */ true)) {
+            if (!job->EnumerateChildren(je, /* recurse */ true)) {
                 return false;
             }
         }
@@ -9,7 +9,10 @@
 #include <pow2.h>
 #include <trace.h>
 
+#include <arch/ops.h>
+
 #include <kernel/auto_lock.h>
+#include <kernel/spinlock.h>
 #include <kernel/cmdline.h>
 #include <kernel/mutex.h>
 
@@ -30,6 +33,7 @@
 #include <magenta/io_mapping_dispatcher.h>
 
 #include <mxtl/arena.h>
+#include <mxtl/atomic.h>
 #include <mxtl/intrusive_double_list.h>
 #include <mxtl/type_support.h>
 
@@ -44,14 +48,104 @@ constexpr size_t kMaxHandleCount = 256 * 1024u;
 // there are this many outstanding handles.
 constexpr size_t kHighHandleCount = (kMaxHandleCount * 7) / 8;
 
-// The handle arena and its mutex. It also guards Dispatcher::handle_count_.
+// The handle arena and its mutex. The mutex only guards the arena itself;
+// the common alloc/free paths go through the per-cpu slot caches below and
+// the handle counts are maintained with atomics, so the mutex is only taken
+// on a cache miss or overflow.
 static Mutex handle_mutex;
 static mxtl::Arena TA_GUARDED(handle_mutex) handle_arena;
-static size_t outstanding_handles TA_GUARDED(handle_mutex) = 0u;
+static mxtl::atomic<size_t> outstanding_handles(0u);
+
+// Per-CPU caches of free handle_arena slots, so the common MakeHandle /
+// DeleteHandle paths touch no shared lock. Entries are accessed with
+// interrupts disabled (like the hazard slots below), which pins us to the
+// cpu and keeps the cache private. A miss refills half the cache from the
+// arena in one trip under |handle_mutex|; an overflow spills back the same
+// way. Freed slots keep their stashed base_value, so generation numbering
+// is unaffected by which cache a slot passes through.
+constexpr size_t kHandleCacheCount = 16u;
+constexpr size_t kHandleCacheRefill = kHandleCacheCount / 2;
+struct HandleSlotCache {
+    void* slots[kHandleCacheCount];
+    size_t count;
+} __CPU_MAX_ALIGN;
+static HandleSlotCache handle_slot_caches[SMP_MAX_CPUS];
+
+// Pops a free slot, refilling the current cpu's cache from the arena on a
+// miss. Returns nullptr only when the arena itself is exhausted.
+static void* handle_slot_alloc() {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    HandleSlotCache* cache = &handle_slot_caches[arch_curr_cpu_num()];
+    if (cache->count > 0u) {
+        void* addr = cache->slots[--cache->count];
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+        return addr;
+    }
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    // Miss: grab a batch from the arena. The arena trip happens with
+    // interrupts enabled since it takes |handle_mutex|; we may land the
+    // leftovers on a different cpu's cache if we migrate, which is fine.
+    void* batch[kHandleCacheRefill];
+    size_t n = 0u;
+    {
+        AutoLock lock(&handle_mutex);
+        for (; n < kHandleCacheRefill; ++n) {
+            batch[n] = handle_arena.Alloc();
+            if (batch[n] == nullptr)
+                break;
+        }
+    }
+    if (n == 0u)
+        return nullptr;
+
+    void* addr = batch[--n];
+    if (n > 0u) {
+        arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+        cache = &handle_slot_caches[arch_curr_cpu_num()];
+        while (n > 0u && cache->count < kHandleCacheCount)
+            cache->slots[cache->count++] = batch[--n];
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+        if (n > 0u) {
+            AutoLock lock(&handle_mutex);
+            while (n > 0u)
+                handle_arena.Free(batch[--n]);
+        }
+    }
+    return addr;
+}
+
+// Returns a slot to the current cpu's cache, spilling to the arena when
+// the cache is full.
+static void handle_slot_free(void* addr) {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    HandleSlotCache* cache = &handle_slot_caches[arch_curr_cpu_num()];
+    if (cache->count < kHandleCacheCount) {
+        cache->slots[cache->count++] = addr;
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+        return;
+    }
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
-size_t internal::OutstandingHandles() {
     AutoLock lock(&handle_mutex);
-    return outstanding_handles;
+    handle_arena.Free(addr);
+}
+
+// Per-CPU hazard slots backing the lock-free handle lookup fast path. A
+// reader publishes the candidate Handle here, with interrupts disabled so
+// it can neither migrate nor be preempted, before reading any of the
+// handle's fields. DeleteHandle() spins until no CPU has the dying handle
+// published before running its destructor, so a reader that validated the
+// handle can safely take a reference to its dispatcher.
+struct HandleHazard {
+    Handle* volatile handle;
+} __CPU_MAX_ALIGN;
+static HandleHazard handle_hazards[SMP_MAX_CPUS];
+
+size_t internal::OutstandingHandles() {
+    return outstanding_handles.load(mxtl::memory_order_relaxed);
 }
 
 // The system exception port.
@@ -98,8 +192,11 @@ static_assert(((3 << 30) ^ kHandleGenerationMask ^ kHandleIndexMask) ==
 
 // Returns a new |base_value| based on the value stored in the free
 // |handle_arena| slot pointed to by |addr|. The new value will be different
-// from the last |base_value| used by this slot.
-static uint32_t GetNewHandleBaseValue(void* addr) TA_REQ(handle_mutex) {
+// from the last |base_value| used by this slot. The slot is exclusively
+// owned by the caller (it came out of handle_slot_alloc()), so no lock is
+// needed to read the stashed value, and the arena's start() is fixed
+// after Init().
+static uint32_t GetNewHandleBaseValue(void* addr) TA_NO_THREAD_SAFETY_ANALYSIS {
     // Get the index of this slot within handle_arena.
     auto va = reinterpret_cast<Handle*>(addr) -
               reinterpret_cast<Handle*>(handle_arena.start());
@@ -148,35 +245,26 @@ void internal::TearDownHandle(Handle *handle) TA_EXCL(handle_mutex) {
 
 static void high_handle_count(size_t count) {
     // TODO: Avoid calling this for every handle after kHighHandleCount;
-    // printfs are slow and |handle_mutex| is held by our caller.
+    // printfs are slow.
     printf("WARNING: High handle count: %zu handles\n", count);
 }
 
 Handle* MakeHandle(mxtl::RefPtr<Dispatcher> dispatcher, mx_rights_t rights) {
-    uint32_t* handle_count = nullptr;
-    void* addr;
-    uint32_t base_value;
-
-    {
-        AutoLock lock(&handle_mutex);
-        addr = handle_arena.Alloc();
-        if (addr == nullptr) {
-            const auto oh = outstanding_handles;
-            lock.release();
-            printf("WARNING: Could not allocate new handle (%zu outstanding)\n",
-                   oh);
-            return nullptr;
-        }
-        if (++outstanding_handles > kHighHandleCount)
-            high_handle_count(outstanding_handles);
+    void* addr = handle_slot_alloc();
+    if (addr == nullptr) {
+        printf("WARNING: Could not allocate new handle (%zu outstanding)\n",
+               outstanding_handles.load(mxtl::memory_order_relaxed));
+        return nullptr;
+    }
+    const auto oh = outstanding_handles.fetch_add(1u, mxtl::memory_order_relaxed) + 1u;
+    if (oh > kHighHandleCount)
+        high_handle_count(oh);
 
-        handle_count = dispatcher->get_handle_count_ptr();
-        (*handle_count)++;
-        if (*handle_count != 2u)
-            handle_count = nullptr;
+    auto handle_count = dispatcher->get_handle_count_ptr();
+    if (handle_count->fetch_add(1u, mxtl::memory_order_relaxed) + 1u != 2u)
+        handle_count = nullptr;
 
-        base_value = GetNewHandleBaseValue(addr);
-    }
+    uint32_t base_value = GetNewHandleBaseValue(addr);
 
     auto state_tracker = dispatcher->get_state_tracker();
     if (state_tracker != nullptr)
@@ -187,30 +275,22 @@ Handle* MakeHandle(mxtl::RefPtr<Dispatcher> dispatcher, mx_rights_t rights) {
 
 Handle* DupHandle(Handle* source, mx_rights_t rights, bool is_replace) {
     mxtl::RefPtr<Dispatcher> dispatcher(source->dispatcher());
-    uint32_t* handle_count;
-    void* addr;
-    uint32_t base_value;
 
-    {
-        AutoLock lock(&handle_mutex);
-        addr = handle_arena.Alloc();
-        if (addr == nullptr) {
-            const auto oh = outstanding_handles;
-            lock.release();
-            printf(
-                "WARNING: Could not allocate duplicate handle (%zu outstanding)\n", oh);
-            return nullptr;
-        }
-        if (++outstanding_handles > kHighHandleCount)
-            high_handle_count(outstanding_handles);
+    void* addr = handle_slot_alloc();
+    if (addr == nullptr) {
+        printf("WARNING: Could not allocate duplicate handle (%zu outstanding)\n",
+               outstanding_handles.load(mxtl::memory_order_relaxed));
+        return nullptr;
+    }
+    const auto oh = outstanding_handles.fetch_add(1u, mxtl::memory_order_relaxed) + 1u;
+    if (oh > kHighHandleCount)
+        high_handle_count(oh);
 
-        handle_count = dispatcher->get_handle_count_ptr();
-        (*handle_count)++;
-        if (*handle_count != 2u)
-            handle_count = nullptr;
+    auto handle_count = dispatcher->get_handle_count_ptr();
+    if (handle_count->fetch_add(1u, mxtl::memory_order_relaxed) + 1u != 2u)
+        handle_count = nullptr;
 
-        base_value = GetNewHandleBaseValue(addr);
-    }
+    uint32_t base_value = GetNewHandleBaseValue(addr);
 
     auto state_tracker = dispatcher->get_state_tracker();
     if (!is_replace && (state_tracker != nullptr))
@@ -220,6 +300,21 @@ Handle* DupHandle(Handle* source, mx_rights_t rights, bool is_replace) {
 }
 
 void DeleteHandle(Handle* handle) {
+    // Make sure no lock-free reader can newly match this handle (it is
+    // normally already out of any handle table by now), then wait out any
+    // reader that already published it. Hazards are held only for the
+    // few instructions of a lookup, with interrupts disabled, so this
+    // spin is short and bounded. The barrier pairs with the one in
+    // HandleHazardAcquire(): either we see the reader's hazard, or the
+    // reader sees the cleared process_id and misses.
+    handle->set_process_id(0u);
+    smp_mb();
+    for (uint i = 0u; i < SMP_MAX_CPUS; ++i) {
+        while (handle_hazards[i].handle == handle)
+            arch_spinloop_pause();
+    }
+    smp_mb();
+
     mxtl::RefPtr<Dispatcher> dispatcher(handle->dispatcher());
     auto state_tracker = dispatcher->get_state_tracker();
 
@@ -250,20 +345,15 @@ void DeleteHandle(Handle* handle) {
     internal::TearDownHandle(handle);
 
     bool zero_handles = false;
-    uint32_t* handle_count;
-    {
-        AutoLock lock(&handle_mutex);
-        --outstanding_handles;
-
-        handle_count = dispatcher->get_handle_count_ptr();
-        (*handle_count)--;
-        if (*handle_count == 0u)
-            zero_handles = true;
-        else if (*handle_count != 1u)
-            handle_count = nullptr;
+    auto handle_count = dispatcher->get_handle_count_ptr();
+    const auto hc = handle_count->fetch_sub(1u, mxtl::memory_order_relaxed) - 1u;
+    if (hc == 0u)
+        zero_handles = true;
+    else if (hc != 1u)
+        handle_count = nullptr;
 
-        handle_arena.Free(handle);
-    }
+    outstanding_handles.fetch_sub(1u, mxtl::memory_order_relaxed);
+    handle_slot_free(handle);
 
     if (zero_handles) {
         dispatcher->on_zero_handles();
@@ -291,6 +381,32 @@ Handle* MapU32ToHandle(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
     return handle->base_value() == value ? handle : nullptr;
 }
 
+Handle* HandleHazardAcquire(uint32_t value, spin_lock_saved_state_t* state)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    auto index = value & kHandleIndexMask;
+    auto va = &reinterpret_cast<Handle*>(handle_arena.start())[index];
+
+    arch_interrupt_save(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    handle_hazards[arch_curr_cpu_num()].handle = va;
+    // Order the publication before the validating loads below; pairs with
+    // the barrier between set_process_id(0u) and the hazard scan in
+    // DeleteHandle().
+    smp_mb();
+
+    // The racy in_range() check is safe without |handle_mutex|: the arena's
+    // data pool only ever grows (Arena::Free() keeps freed slots committed
+    // on its free list), so a stale top-of-pool can only produce a spurious
+    // miss, never a dereference of unmapped memory.
+    if (!handle_arena.in_range(va))
+        return nullptr;
+    return va->base_value() == value ? va : nullptr;
+}
+
+void HandleHazardRelease(spin_lock_saved_state_t state) {
+    handle_hazards[arch_curr_cpu_num()].handle = nullptr;
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+}
+
 void internal::DumpHandleTableInfo() {
     AutoLock lock(&handle_mutex);
     handle_arena.Dump();
@@ -0,0 +1,121 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <magenta/memory_pressure.h>
+
+#include <err.h>
+#include <kernel/auto_lock.h>
+#include <kernel/thread.h>
+#include <kernel/vm/pmm.h>
+#include <lk/init.h>
+#include <trace.h>
+
+#include <magenta/event_dispatcher.h>
+#include <magenta/state_tracker.h>
+
+#define LOCAL_TRACE 0
+
+// How often the sampling thread reads the pmm free counts.
+static constexpr lk_time_t kSampleInterval = LK_SEC(1);
+
+// Pressure thresholds as divisors of total memory: below 1/16 free is
+// WARNING, below 1/32 free is CRITICAL. These bracket the thresholds the
+// pmm and the vmo evictor use, so userspace starts shedding caches around
+// the same time the kernel starts reclaiming hinted pages.
+static constexpr size_t kWarningDivisor = 16;
+static constexpr size_t kCriticalDivisor = 32;
+
+static mutex_t pressure_lock = MUTEX_INITIAL_VALUE(pressure_lock);
+
+// one kernel-owned event per MX_MEM_PRESSURE_* level, created on first use
+static mxtl::RefPtr<Dispatcher> pressure_events[MX_MEM_PRESSURE_CRITICAL + 1]
+    TA_GUARDED(pressure_lock);
+
+static uint32_t pressure_level TA_GUARDED(pressure_lock) = MX_MEM_PRESSURE_NORMAL;
+
+// whether the event for |event_level| should be signaled at |level|
+static bool event_signaled_at(uint32_t event_level, uint32_t level) {
+    if (event_level == MX_MEM_PRESSURE_NORMAL)
+        return level == MX_MEM_PRESSURE_NORMAL;
+    return level >= event_level;
+}
+
+status_t GetMemoryPressureEvent(uint32_t level, mxtl::RefPtr<Dispatcher>* dispatcher,
+                                mx_rights_t* rights) {
+    if (level > MX_MEM_PRESSURE_CRITICAL)
+        return ERR_INVALID_ARGS;
+
+    AutoLock lock(&pressure_lock);
+
+    if (!pressure_events[level]) {
+        mxtl::RefPtr<Dispatcher> disp;
+        mx_rights_t def_rights;
+        status_t status = EventDispatcher::Create(0u, &disp, &def_rights);
+        if (status != NO_ERROR)
+            return status;
+
+        if (event_signaled_at(level, pressure_level))
+            disp->get_state_tracker()->UpdateState(0u, MX_EVENT_SIGNALED);
+
+        pressure_events[level] = mxtl::move(disp);
+    }
+
+    *dispatcher = pressure_events[level];
+    // waiters may read, wait and pass the event around, but not signal it
+    *rights = MX_RIGHT_TRANSFER | MX_RIGHT_DUPLICATE | MX_RIGHT_READ;
+    return NO_ERROR;
+}
+
+// Map free memory to a pressure level. A level is only left again after
+// free memory rises a quarter past its entry threshold, so the level (and
+// the events) don't flap when the system hovers right at a boundary.
+static uint32_t compute_level(size_t free_pages, size_t total_pages, uint32_t prev) {
+    size_t critical = total_pages / kCriticalDivisor;
+    size_t warning = total_pages / kWarningDivisor;
+
+    if (free_pages < critical ||
+        (prev == MX_MEM_PRESSURE_CRITICAL && free_pages < critical + critical / 4))
+        return MX_MEM_PRESSURE_CRITICAL;
+    if (free_pages < warning ||
+        (prev >= MX_MEM_PRESSURE_WARNING && free_pages < warning + warning / 4))
+        return MX_MEM_PRESSURE_WARNING;
+    return MX_MEM_PRESSURE_NORMAL;
+}
+
+static int memory_pressure_thread(void* arg) {
+    size_t total_pages = pmm_count_total_bytes() / PAGE_SIZE;
+
+    for (;;) {
+        thread_sleep_relative(kSampleInterval);
+
+        AutoLock lock(&pressure_lock);
+
+        uint32_t level = compute_level(pmm_count_free_pages(), total_pages, pressure_level);
+        if (level == pressure_level)
+            continue;
+
+        LTRACEF("memory pressure level %u -> %u\n", pressure_level, level);
+        pressure_level = level;
+
+        for (uint32_t i = 0; i <= MX_MEM_PRESSURE_CRITICAL; i++) {
+            if (!pressure_events[i])
+                continue;
+            if (event_signaled_at(i, level))
+                pressure_events[i]->get_state_tracker()->UpdateState(0u, MX_EVENT_SIGNALED);
+            else
+                pressure_events[i]->get_state_tracker()->UpdateState(MX_EVENT_SIGNALED, 0u);
+        }
+    }
+    return 0;
+}
+
+static void memory_pressure_init(uint level) {
+    thread_t* t = thread_create("memory-pressure", memory_pressure_thread, nullptr,
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    if (t)
+        thread_resume(t);
+}
+LK_INIT_HOOK(memory_pressure, memory_pressure_init, LK_INIT_LEVEL_THREADING);
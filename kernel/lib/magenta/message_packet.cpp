@@ -7,11 +7,99 @@
 #include <magenta/message_packet.h>
 
 #include <err.h>
+#include <string.h>
+
+#include <arch/ops.h>
+#include <kernel/spinlock.h>
 
 #include <magenta/handle_reaper.h>
 #include <magenta/magenta.h>
 #include <mxcpp/new.h>
 
+// Small packets are carved from per-cpu caches of a few fixed size classes
+// so the channel hot path never touches the global heap. Each cpu keeps a
+// short free list per class; misses fall through to malloc and overflowing
+// frees go back to the heap. Class sizes cover the whole allocation (object
+// header plus handle array plus data).
+namespace {
+
+struct CacheBlock {
+    CacheBlock* next;
+};
+
+constexpr size_t kCacheClassSizes[] = {128u, 256u, 512u, 1024u, 2048u};
+constexpr uint32_t kNumCacheClasses = countof(kCacheClassSizes);
+constexpr uint32_t kCacheClassNone = UINT32_MAX;
+constexpr uint32_t kCacheMaxDepth = 32u;
+
+struct CpuCache {
+    CacheBlock* free_list[kNumCacheClasses];
+    uint32_t depth[kNumCacheClasses];
+} __CPU_MAX_ALIGN;
+
+CpuCache cpu_caches[SMP_MAX_CPUS];
+
+uint32_t SizeToClass(size_t size) {
+    for (uint32_t i = 0u; i < kNumCacheClasses; i++) {
+        if (size <= kCacheClassSizes[i])
+            return i;
+    }
+    return kCacheClassNone;
+}
+
+void* CacheAlloc(size_t size, uint32_t* cache_class) {
+    uint32_t cls = SizeToClass(size);
+    *cache_class = cls;
+    if (cls == kCacheClassNone)
+        return malloc(size);
+
+    CacheBlock* block;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    CpuCache* cache = &cpu_caches[arch_curr_cpu_num()];
+    block = cache->free_list[cls];
+    if (block) {
+        cache->free_list[cls] = block->next;
+        cache->depth[cls]--;
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    if (!block)
+        block = static_cast<CacheBlock*>(malloc(kCacheClassSizes[cls]));
+    return block;
+}
+
+void CacheFree(void* ptr, uint32_t cls) {
+    if (cls == kCacheClassNone) {
+        free(ptr);
+        return;
+    }
+
+    CacheBlock* block = static_cast<CacheBlock*>(ptr);
+    bool cached = false;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    CpuCache* cache = &cpu_caches[arch_curr_cpu_num()];
+    if (cache->depth[cls] < kCacheMaxDepth) {
+        block->next = cache->free_list[cls];
+        cache->free_list[cls] = block;
+        cache->depth[cls]++;
+        cached = true;
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    if (!cached)
+        free(ptr);
+}
+
+} // namespace
+
 // static
 mx_status_t MessagePacket::Create(uint32_t data_size, uint32_t num_handles,
                                   mxtl::unique_ptr<MessagePacket>* msg) {
@@ -22,9 +110,10 @@ mx_status_t MessagePacket::Create(uint32_t data_size, uint32_t num_handles,
 
     // Allocate space for the MessagePacket object followed by num_handles
     // Handle*s followed by data_size bytes.
-    char* ptr = static_cast<char*>(malloc(sizeof(MessagePacket) +
-                                          num_handles * sizeof(Handle*) +
-                                          data_size));
+    uint32_t cache_class;
+    char* ptr = static_cast<char*>(CacheAlloc(sizeof(MessagePacket) +
+                                              num_handles * sizeof(Handle*) +
+                                              data_size, &cache_class));
     if (ptr == nullptr)
         return ERR_NO_MEMORY;
 
@@ -33,6 +122,7 @@ mx_status_t MessagePacket::Create(uint32_t data_size, uint32_t num_handles,
     // fill these arrays immediately after creation of the object.
     msg->reset(new (ptr) MessagePacket(data_size, num_handles,
                                        reinterpret_cast<Handle**>(ptr + sizeof(MessagePacket))));
+    (*msg)->cache_class_ = cache_class;
     return NO_ERROR;
 }
 
@@ -47,3 +137,11 @@ MessagePacket::~MessagePacket() {
 MessagePacket::MessagePacket(uint32_t data_size, uint32_t num_handles, Handle** handles)
     : owns_handles_(false), data_size_(data_size), num_handles_(num_handles), handles_(handles) {
 }
+
+// static
+void MessagePacket::operator delete(void* ptr) {
+    // the destructor has run but the storage is still intact, so the cache
+    // class stashed at creation time is still readable
+    uint32_t cache_class = static_cast<MessagePacket*>(ptr)->cache_class_;
+    CacheFree(ptr, cache_class);
+}
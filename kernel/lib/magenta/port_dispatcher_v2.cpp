@@ -22,7 +22,7 @@
 constexpr mx_rights_t kDefaultIOPortRightsV2 =
     MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_READ | MX_RIGHT_WRITE;
 
-PortPacket::PortPacket() : packet{}, observer(nullptr) {
+PortPacket::PortPacket() : packet{}, observer(nullptr), from_pool(false) {
     // Note that packet is initialized to zeros.
 }
 
@@ -101,7 +101,11 @@ mx_status_t PortDispatcherV2::Create(uint32_t options,
                                      mx_rights_t* rights) {
     DEBUG_ASSERT(options == MX_PORT_OPT_V2);
     AllocChecker ac;
-    auto disp = new (&ac) PortDispatcherV2(options);
+    mxtl::unique_ptr<PortPacket[]> pool(new (&ac) PortPacket[kPacketPoolSize]);
+    if (!ac.check())
+        return ERR_NO_MEMORY;
+
+    auto disp = new (&ac) PortDispatcherV2(options, mxtl::move(pool));
     if (!ac.check())
         return ERR_NO_MEMORY;
 
@@ -110,12 +114,39 @@ mx_status_t PortDispatcherV2::Create(uint32_t options,
     return NO_ERROR;
 }
 
-PortDispatcherV2::PortDispatcherV2(uint32_t /*options*/)
-    : zero_handles_(false) {
+PortDispatcherV2::PortDispatcherV2(uint32_t /*options*/, mxtl::unique_ptr<PortPacket[]> pool)
+    : zero_handles_(false), packet_pool_(mxtl::move(pool)) {
+    for (size_t ix = 0u; ix != kPacketPoolSize; ++ix) {
+        packet_pool_[ix].from_pool = true;
+        free_packets_.push_front(&packet_pool_[ix]);
+    }
 }
 
 PortDispatcherV2::~PortDispatcherV2() {
     DEBUG_ASSERT(zero_handles_);
+    // on_zero_handles() drained the queue, so every pooled packet is
+    // back on the free list; unlink them before the pool goes away.
+    free_packets_.clear();
+}
+
+PortPacket* PortDispatcherV2::AllocUserPacket() {
+    spin_lock_saved_state_t state;
+    pool_lock_.AcquireIrqSave(state);
+    PortPacket* port_packet = free_packets_.is_empty() ? nullptr : free_packets_.pop_front();
+    pool_lock_.ReleaseIrqRestore(state);
+    return port_packet;
+}
+
+void PortDispatcherV2::FreeUserPacket(PortPacket* port_packet) {
+    if (!port_packet->from_pool) {
+        delete port_packet;
+        return;
+    }
+    DEBUG_ASSERT(port_packet->observer == nullptr);
+    spin_lock_saved_state_t state;
+    pool_lock_.AcquireIrqSave(state);
+    free_packets_.push_front(port_packet);
+    pool_lock_.ReleaseIrqRestore(state);
 }
 
 void PortDispatcherV2::on_zero_handles() {
@@ -131,17 +162,21 @@ void PortDispatcherV2::on_zero_handles() {
 mx_status_t PortDispatcherV2::QueueUser(const mx_port_packet_t& packet) {
     canary_.Assert();
 
-    AllocChecker ac;
-    auto port_packet = new (&ac) PortPacket();
-    if (!ac.check())
-        return ERR_NO_MEMORY;
+    PortPacket* port_packet = AllocUserPacket();
+    if (port_packet == nullptr) {
+        // pool exhausted; fall back to the heap rather than dropping
+        AllocChecker ac;
+        port_packet = new (&ac) PortPacket();
+        if (!ac.check())
+            return ERR_NO_MEMORY;
+    }
 
     port_packet->packet = packet;
     port_packet->packet.type = MX_PKT_TYPE_USER;
 
     auto status = Queue(port_packet, 0u, 0u);
     if (status < 0)
-        delete port_packet;
+        FreeUserPacket(port_packet);
     return status;
 }
 
@@ -191,8 +226,8 @@ mx_status_t PortDispatcherV2::DeQueue(mx_time_t deadline, mx_port_packet_t* pack
 
         if (observer)
             delete observer;
-        else if (packet && packet->type == MX_PKT_TYPE_USER)
-            delete port_packet;
+        else if (port_packet->type() == MX_PKT_TYPE_USER)
+            FreeUserPacket(port_packet);
         return NO_ERROR;
 
 wait:
@@ -202,6 +237,42 @@ wait:
     }
 }
 
+mx_status_t PortDispatcherV2::DeQueueMany(mx_time_t deadline, mx_port_packet_t* packets,
+                                          size_t count, size_t* actual) {
+    canary_.Assert();
+    DEBUG_ASSERT((count > 0u) && (count <= kMaxDeQueueBatch));
+
+    PortPacket* port_packets[kMaxDeQueueBatch];
+    PortObserver* observers[kMaxDeQueueBatch];
+
+    while (true) {
+        size_t n = 0u;
+        {
+            AutoLock al(&lock_);
+            while ((n < count) && !packets_.is_empty()) {
+                port_packets[n] = packets_.pop_front();
+                observers[n] = CopyLocked(port_packets[n], &packets[n]);
+                ++n;
+            }
+        }
+
+        if (n > 0u) {
+            for (size_t ix = 0u; ix != n; ++ix) {
+                if (observers[ix])
+                    delete observers[ix];
+                else if (port_packets[ix]->type() == MX_PKT_TYPE_USER)
+                    FreeUserPacket(port_packets[ix]);
+            }
+            *actual = n;
+            return NO_ERROR;
+        }
+
+        status_t st = sema_.Wait(deadline);
+        if (st != NO_ERROR)
+            return st;
+    }
+}
+
 PortObserver* PortDispatcherV2::CopyLocked(PortPacket* port_packet, mx_port_packet_t* packet) {
     if (packet)
         *packet = port_packet->packet;
@@ -43,6 +43,10 @@ static constexpr mx_rights_t kDefaultProcessRights =
         MX_RIGHT_READ  | MX_RIGHT_WRITE | MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER |
         MX_RIGHT_ENUMERATE | MX_RIGHT_DESTROY | MX_RIGHT_GET_PROPERTY | MX_RIGHT_SET_PROPERTY;
 
+// Static storage for the global koid index.
+Mutex ProcessDispatcher::index_lock_;
+ProcessDispatcher::ProcessIndex ProcessDispatcher::index_;
+
 
 static mx_handle_t map_handle_to_value(const Handle* handle, mx_handle_t mixer) {
     // Ensure that the last bit of the result is not zero, and make sure
@@ -73,6 +77,13 @@ mx_status_t ProcessDispatcher::Create(
     if (!job->AddChildProcess(process.get()))
         return ERR_BAD_STATE;
 
+    // Now that the job tree can reach us, make us reachable by koid as well.
+    // Failure paths below destroy |process|, whose destructor unindexes it.
+    {
+        AutoLock lock(&index_lock_);
+        index_.insert(process.get());
+    }
+
     status_t result = process->Initialize();
     if (result != NO_ERROR)
         return result;
@@ -98,14 +109,15 @@ mx_status_t ProcessDispatcher::Create(
 ProcessDispatcher::ProcessDispatcher(mxtl::RefPtr<JobDispatcher> job,
                                      mxtl::StringPiece name,
                                      uint32_t flags)
-  : job_(mxtl::move(job)), policy_(job_->GetPolicy()), state_tracker_(0u),
+  : job_(mxtl::move(job)), policy_(job_->GetPolicy()),
+    policy_deny_mask_(GetSystemPolicyManager()->ComputeDenyMask(policy_)),
+    state_tracker_(0u),
     name_(name.data(), name.length()) {
     LTRACE_ENTRY_OBJ;
 
     // Generate handle XOR mask with top bit and bottom two bits cleared
     uint32_t secret;
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    prng->Draw(&secret, sizeof(secret));
+    crypto::GlobalPRNG::Draw(&secret, sizeof(secret));
 
     // Handle values cannot be negative values, so we mask the high bit.
     handle_rand_ = (secret << 2) & INT_MAX;
@@ -124,10 +136,17 @@ ProcessDispatcher::~ProcessDispatcher() {
     // Remove ourselves from the parent job's weak ref to us. Note that this might
     // have beeen called when transitioning State::DEAD. The Job can handle double calls.
     job_->RemoveChildProcess(this);
+    RemoveFromIndex();
 
     LTRACE_EXIT_OBJ;
 }
 
+void ProcessDispatcher::RemoveFromIndex() {
+    AutoLock lock(&index_lock_);
+    if (wavl_node_state_.InContainer())
+        index_.erase(*this);
+}
+
 void ProcessDispatcher::get_name(char out_name[MX_MAX_NAME_LEN]) const {
     name_.get(MX_MAX_NAME_LEN, out_name);
 }
@@ -361,6 +380,8 @@ void ProcessDispatcher::SetStateLocked(State s) {
         // We remove ourselves from the parent Job weak ref (to us) list early, so
         // the semantics of signaling MX_JOB_NO_PROCESSES match that of MX_TASK_TERMINATED.
         job_->RemoveChildProcess(this);
+        // Dead processes should no longer be reachable by koid either.
+        RemoveFromIndex();
 
         // The PROC_CREATE record currently emits a uint32_t.
         uint32_t koid = static_cast<uint32_t>(get_koid());
@@ -441,6 +462,32 @@ mx_status_t ProcessDispatcher::GetDispatcherWithRightsInternal(mx_handle_t handl
                                                                mx_rights_t desired_rights,
                                                                mxtl::RefPtr<Dispatcher>* dispatcher_out,
                                                                mx_rights_t* out_rights) {
+    // Lock-free fast path. Handle lookup is on every syscall, so threads of
+    // a busy process would otherwise serialize on |handle_table_lock_|. The
+    // hazard published by HandleHazardAcquire() keeps DeleteHandle() from
+    // tearing the handle down between validation and taking the dispatcher
+    // reference; the process_id check is what ties the handle to this
+    // process, exactly as in GetHandleLocked().
+    {
+        spin_lock_saved_state_t state;
+        Handle* handle = HandleHazardAcquire(
+            static_cast<uint32_t>(handle_value ^ handle_rand_) >> 1, &state);
+        if (handle != nullptr && handle->process_id() == get_koid()) {
+            if (!magenta_rights_check(handle, desired_rights)) {
+                HandleHazardRelease(state);
+                return ERR_ACCESS_DENIED;
+            }
+            *dispatcher_out = handle->dispatcher();
+            if (out_rights)
+                *out_rights = handle->rights();
+            HandleHazardRelease(state);
+            return NO_ERROR;
+        }
+        HandleHazardRelease(state);
+    }
+
+    // Slow path: a miss above can be spurious (e.g. a racing read of the
+    // arena bounds), so retry under the lock before reporting failure.
     AutoLock lock(&handle_table_lock_);
     Handle* handle = GetHandleLocked(handle_value);
     if (!handle)
@@ -651,34 +698,11 @@ mxtl::RefPtr<ExceptionPort> ProcessDispatcher::debugger_exception_port() {
     return debugger_exception_port_;
 }
 
-class FindProcessByKoid final : public JobEnumerator {
-public:
-    FindProcessByKoid(mx_koid_t koid) : koid_(koid) {}
-    FindProcessByKoid(const FindProcessByKoid&) = delete;
-
-    // To be called after enumeration.
-    mxtl::RefPtr<ProcessDispatcher> get_pd() { return pd_; }
-
-private:
-    bool OnProcess(ProcessDispatcher* process) final {
-        if (process->get_koid() == koid_) {
-            pd_ = mxtl::WrapRefPtr(process);
-            // Stop the enumeration.
-            return false;
-        }
-        // Keep looking.
-        return true;
-    }
-
-    const mx_koid_t koid_;
-    mxtl::RefPtr<ProcessDispatcher> pd_ = nullptr;
-};
-
 // static
 mxtl::RefPtr<ProcessDispatcher> ProcessDispatcher::LookupProcessById(mx_koid_t koid) {
-    FindProcessByKoid finder(koid);
-    GetRootJobDispatcher()->EnumerateChildren(&finder, /* recurse */ true);
-    return finder.get_pd();
+    AutoLock lock(&index_lock_);
+    auto iter = index_.find(koid);
+    return mxtl::WrapRefPtr(iter.CopyPointer());
 }
 
 mxtl::RefPtr<UserThread> ProcessDispatcher::LookupThreadById(mx_koid_t koid) {
@@ -706,15 +730,15 @@ mx_status_t ProcessDispatcher::set_debug_addr(uintptr_t addr) {
 }
 
 mx_status_t ProcessDispatcher::QueryPolicy(uint32_t condition) const {
-    auto action = GetSystemPolicyManager()->QueryBasicPolicy(policy_, condition);
-    if (action & MX_POL_ACTION_ALARM) {
-        // TODO(cpu): Generate Port packet. Probably need to call up to the
-        // parent job for the actual port.
-        action &= ~MX_POL_ACTION_ALARM;
-    }
+    // The allow/deny answer is precomputed per condition in
+    // |policy_deny_mask_|, so the hot path is a single load and test.
+    // TODO(cpu): Generate Port packet when the policy requests an alarm.
+    // Probably need to call up to the parent job for the actual port.
     // TODO(cpu): check for the MX_POL_KILL bit and return an error code
     // that sysgen understands as termination.
-    return (action & MX_POL_ACTION_DENY) ? ERR_ACCESS_DENIED : NO_ERROR;
+    if (unlikely(condition >= MX_POL_MAX))
+        return ERR_ACCESS_DENIED;
+    return (policy_deny_mask_ & (1u << condition)) ? ERR_ACCESS_DENIED : NO_ERROR;
 }
 
 uintptr_t ProcessDispatcher::cache_vdso_code_address() {
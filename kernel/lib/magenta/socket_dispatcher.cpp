@@ -16,6 +16,7 @@
 #include <lib/user_copy/user_ptr.h>
 
 #include <kernel/auto_lock.h>
+#include <kernel/vm/pmm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
 #include <kernel/vm/vm_object_paged.h>
@@ -37,7 +38,9 @@ size_t SocketDispatcher::MBuf::rem() const {
 }
 
 bool SocketDispatcher::is_full() const {
-    return size_ >= kSocketSizeMax;
+    if (is_datagram())
+        return dgram_count_ >= kSocketDatagramMax;
+    return size_ >= (ring_ ? kSocketRingSize : kSocketSizeMax);
 }
 
 bool SocketDispatcher::is_empty() const {
@@ -72,11 +75,15 @@ status_t SocketDispatcher::Create(uint32_t flags,
     return NO_ERROR;
 }
 
-SocketDispatcher::SocketDispatcher(uint32_t /*flags*/)
-    : peer_koid_(0u),
+SocketDispatcher::SocketDispatcher(uint32_t flags)
+    : flags_(flags),
+      peer_koid_(0u),
       state_tracker_(MX_SOCKET_WRITABLE),
       head_(nullptr),
       size_(0u),
+      dgram_count_(0u),
+      ring_head_(0u),
+      ring_tail_(0u),
       half_closed_{false, false} {
 }
 
@@ -92,6 +99,18 @@ SocketDispatcher::~SocketDispatcher() {
 mx_status_t SocketDispatcher::Init(mxtl::RefPtr<SocketDispatcher> other) TA_NO_THREAD_SAFETY_ANALYSIS {
     other_ = mxtl::move(other);
     peer_koid_ = other_->get_koid();
+    if (flags_ & MX_SOCKET_MAPPED) {
+        // The receive ring is a plain VMO so the consumer can map it and
+        // read payloads in place. Commit it up front: it is long-lived
+        // and the data path should not take page faults.
+        ring_ = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, kSocketRingSize);
+        if (!ring_)
+            return ERR_NO_MEMORY;
+        uint64_t committed;
+        status_t status = ring_->CommitRange(0u, kSocketRingSize, &committed);
+        if (status != NO_ERROR)
+            return status;
+    }
     return NO_ERROR;
 }
 
@@ -229,7 +248,17 @@ mx_status_t SocketDispatcher::WriteSelf(user_ptr<const void> src, size_t len,
 
     bool was_empty = is_empty();
 
-    auto st = WriteMBufs(src, len);
+    size_t st;
+    if (ring_) {
+        st = WriteRing(src, len);
+    } else if (is_datagram()) {
+        mx_status_t status = WriteDatagram(src, len);
+        if (status != NO_ERROR)
+            return status;
+        st = len;
+    } else {
+        st = WriteMBufs(src, len);
+    }
 
     if (st > 0) {
         if (was_empty)
@@ -278,6 +307,94 @@ size_t SocketDispatcher::WriteMBufs(user_ptr<const void> src, size_t len) {
     return pos;
 }
 
+// Queues a single datagram in its own MBuf, so the queued MBufs delimit
+// the datagram boundaries.
+mx_status_t SocketDispatcher::WriteDatagram(user_ptr<const void> src, size_t len) {
+    // A zero-length datagram would be invisible to is_empty().
+    if (len == 0u)
+        return ERR_INVALID_ARGS;
+    if (len > static_cast<size_t>(kMBufSize))
+        return ERR_OUT_OF_RANGE;
+
+    MBuf* buf = AllocMBuf();
+    if (buf == nullptr)
+        return ERR_NO_MEMORY;
+
+    if (src.copy_array_from_user(buf->data_, len) != NO_ERROR) {
+        FreeMBuf(buf);
+        return ERR_INVALID_ARGS;
+    }
+    buf->len_ = static_cast<uint32_t>(len);
+
+    if (head_ == nullptr)
+        tail_.push_front(buf);
+    else
+        tail_.insert_after(tail_.make_iterator(*head_), buf);
+    head_ = buf;
+    size_ += len;
+    dgram_count_++;
+    return NO_ERROR;
+}
+
+mx_status_t SocketDispatcher::WriteBatch(const mx_iovec_t* msgs, size_t count,
+                                         size_t* nwritten) {
+    canary_.Assert();
+
+    if (!is_datagram())
+        return ERR_NOT_SUPPORTED;
+
+    mxtl::RefPtr<SocketDispatcher> other;
+    {
+        AutoLock lock(&lock_);
+        if (!other_)
+            return ERR_PEER_CLOSED;
+        if (half_closed_[0])
+            return ERR_BAD_STATE;
+        other = other_;
+    }
+
+    return other->WriteBatchSelf(msgs, count, nwritten);
+}
+
+mx_status_t SocketDispatcher::WriteBatchSelf(const mx_iovec_t* msgs, size_t count,
+                                             size_t* nwritten) {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+
+    bool was_empty = is_empty();
+
+    size_t sent = 0u;
+    size_t bytes = 0u;
+    mx_status_t status = NO_ERROR;
+    for (size_t i = 0u; i < count; i++) {
+        if (is_full()) {
+            status = ERR_SHOULD_WAIT;
+            break;
+        }
+        status = WriteDatagram(user_ptr<const void>(msgs[i].buffer),
+                               msgs[i].capacity);
+        if (status != NO_ERROR)
+            break;
+        sent++;
+        bytes += msgs[i].capacity;
+    }
+
+    if (sent > 0u) {
+        if (was_empty)
+            state_tracker_.UpdateState(0u, MX_SOCKET_READABLE);
+        if (iopc_)
+            iopc_->Signal(MX_SOCKET_READABLE, bytes, &lock_);
+    }
+
+    if (is_full())
+        other_->state_tracker_.UpdateState(MX_SOCKET_WRITABLE, 0u);
+
+    *nwritten = sent;
+    // Partial progress wins over the condition that stopped the batch.
+    return (sent > 0u) ? NO_ERROR : status;
+}
+
 mx_status_t SocketDispatcher::Read(user_ptr<void> dst, size_t len,
                                    size_t* nread) {
     canary_.Assert();
@@ -297,7 +414,15 @@ mx_status_t SocketDispatcher::Read(user_ptr<void> dst, size_t len,
 
     bool was_full = is_full();
 
-    auto st = ReadMBufs(dst, len);
+    size_t st;
+    if (ring_) {
+        st = ReadRing(dst, len);
+    } else if (is_datagram()) {
+        if (ReadDatagram(dst, len, &st) != NO_ERROR)
+            st = 0u;
+    } else {
+        st = ReadMBufs(dst, len);
+    }
 
     if (is_empty())
         state_tracker_.UpdateState(MX_SOCKET_READABLE, 0u);
@@ -332,6 +457,142 @@ size_t SocketDispatcher::ReadMBufs(user_ptr<void> dst, size_t len) {
     return pos;
 }
 
+// Dequeues a single datagram, truncating it to |len| bytes; the tail of
+// a truncated datagram is discarded, as with UDP.
+mx_status_t SocketDispatcher::ReadDatagram(user_ptr<void> dst, size_t len,
+                                           size_t* nread) {
+    DEBUG_ASSERT(!tail_.is_empty());
+    MBuf& cur = tail_.front();
+    size_t copy_len = MIN(cur.len_, len);
+    if (dst.copy_array_to_user(cur.data_, copy_len) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    size_ -= cur.len_;
+    dgram_count_--;
+    if (head_ == &cur)
+        head_ = nullptr;
+    FreeMBuf(tail_.pop_front());
+    *nread = copy_len;
+    return NO_ERROR;
+}
+
+mx_status_t SocketDispatcher::ReadBatch(const mx_iovec_t* msgs, size_t count,
+                                        size_t* actuals, size_t* nread) {
+    canary_.Assert();
+
+    if (!is_datagram())
+        return ERR_NOT_SUPPORTED;
+
+    AutoLock lock(&lock_);
+
+    bool closed = half_closed_[1] || !other_;
+
+    if (is_empty())
+        return closed ? ERR_PEER_CLOSED : ERR_SHOULD_WAIT;
+
+    bool was_full = is_full();
+
+    size_t received = 0u;
+    mx_status_t status = NO_ERROR;
+    for (size_t i = 0u; i < count; i++) {
+        if (is_empty())
+            break;
+        status = ReadDatagram(user_ptr<void>(msgs[i].buffer),
+                              msgs[i].capacity, &actuals[i]);
+        if (status != NO_ERROR)
+            break;
+        received++;
+    }
+
+    if (is_empty())
+        state_tracker_.UpdateState(MX_SOCKET_READABLE, 0u);
+
+    if (!closed && was_full && (received > 0u))
+        other_->state_tracker_.UpdateState(0u, MX_SOCKET_WRITABLE);
+
+    *nread = received;
+    // Partial progress wins over the condition that stopped the batch.
+    return (received > 0u) ? NO_ERROR : status;
+}
+
+size_t SocketDispatcher::WriteRing(user_ptr<const void> src, size_t len) {
+    size_t pos = 0u;
+    while (pos < len) {
+        size_t avail = kSocketRingSize - size_;
+        if (avail == 0u)
+            break;
+        uint64_t off = ring_head_ % kSocketRingSize;
+        // Clamp each copy at the end of the ring so it never wraps.
+        size_t copy_len = MIN(MIN(len - pos, avail), kSocketRingSize - off);
+        size_t nwritten;
+        if (ring_->WriteUser(src.byte_offset(pos), off, copy_len, &nwritten) != NO_ERROR)
+            return pos;
+        pos += nwritten;
+        ring_head_ += nwritten;
+        size_ += nwritten;
+        if (nwritten != copy_len)
+            break;
+    }
+    return pos;
+}
+
+size_t SocketDispatcher::ReadRing(user_ptr<void> dst, size_t len) {
+    size_t pos = 0u;
+    while (pos < len) {
+        if (size_ == 0u)
+            break;
+        uint64_t off = ring_tail_ % kSocketRingSize;
+        size_t copy_len = MIN(MIN(len - pos, size_), kSocketRingSize - off);
+        size_t nread;
+        if (ring_->ReadUser(dst.byte_offset(pos), off, copy_len, &nread) != NO_ERROR)
+            return pos;
+        pos += nread;
+        ring_tail_ += nread;
+        size_ -= nread;
+        if (nread != copy_len)
+            break;
+    }
+    return pos;
+}
+
+mx_status_t SocketDispatcher::Consume(size_t len, size_t* consumed) {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+
+    if (!ring_)
+        return ERR_NOT_SUPPORTED;
+
+    bool closed = half_closed_[1] || !other_;
+
+    if (is_empty())
+        return closed ? ERR_PEER_CLOSED : ERR_SHOULD_WAIT;
+
+    bool was_full = is_full();
+
+    size_t n = MIN(len, size_);
+    ring_tail_ += n;
+    size_ -= n;
+
+    if (is_empty())
+        state_tracker_.UpdateState(MX_SOCKET_READABLE, 0u);
+
+    if (!closed && was_full && (n > 0u))
+        other_->state_tracker_.UpdateState(0u, MX_SOCKET_WRITABLE);
+
+    *consumed = n;
+    return NO_ERROR;
+}
+
+mx_status_t SocketDispatcher::GetMappedBuffer(mxtl::RefPtr<VmObject>* out) {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+    if (!ring_)
+        return ERR_NOT_SUPPORTED;
+    *out = ring_;
+    return NO_ERROR;
+}
+
 SocketDispatcher::MBuf* SocketDispatcher::AllocMBuf() {
     if (freelist_.is_empty()) {
         AllocChecker ac;
@@ -49,8 +49,16 @@ void StateTracker::AddObserver(StateObserver* observer, const StateObserver::Cou
         AutoLock lock(&lock_);
 
         awoke_threads = observer->OnInitialize(signals_, cinfo);
-        if (!observer->remove())
+        if (!observer->remove()) {
+            // rebuild the interest mask from scratch when the list was empty so
+            // removals don't leave it sticking at all-ones forever
+            if (observers_.is_empty()) {
+                interest_ = observer->watched_signals();
+            } else {
+                interest_ |= observer->watched_signals();
+            }
             observers_.push_front(observer);
+        }
     }
     if (awoke_threads)
         thread_reschedule();
@@ -62,6 +70,8 @@ void StateTracker::RemoveObserver(StateObserver* observer) {
     AutoLock lock(&lock_);
     DEBUG_ASSERT(observer != nullptr);
     observers_.erase(*observer);
+    if (observers_.is_empty())
+        interest_ = 0u;
 }
 
 bool StateTracker::Cancel(Handle* handle) {
@@ -96,7 +106,8 @@ void StateTracker::UpdateState(mx_signals_t clear_mask,
         if (previous_signals == signals_)
             return;
 
-        awoke_threads = UpdateInternalLocked(&obs_to_remove, signals_);
+        awoke_threads = UpdateInternalLocked(&obs_to_remove, signals_,
+                                             previous_signals ^ signals_);
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -117,7 +128,8 @@ void StateTracker::StrobeState(mx_signals_t notify_mask) {
         AutoLock lock(&lock_);
         // include currently active signals as well
         notify_mask |= signals_;
-        awoke_threads = UpdateInternalLocked(&obs_to_remove, notify_mask);
+        // every bit in the mask counts as freshly asserted for a strobe
+        awoke_threads = UpdateInternalLocked(&obs_to_remove, notify_mask, notify_mask);
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -128,7 +140,7 @@ void StateTracker::StrobeState(mx_signals_t notify_mask) {
         thread_reschedule();
 }
 
-void StateTracker::UpdateLastHandleSignal(uint32_t* count) {
+void StateTracker::UpdateLastHandleSignal(const mxtl::atomic<uint32_t>* count) {
     canary_.Assert();
 
     if (count == nullptr)
@@ -144,13 +156,14 @@ void StateTracker::UpdateLastHandleSignal(uint32_t* count) {
 
         // We assume here that the value pointed by |count| can mutate by
         // other threads.
-        signals_ = (*count == 1u) ?
+        signals_ = (count->load(mxtl::memory_order_relaxed) == 1u) ?
             signals_ | MX_SIGNAL_LAST_HANDLE : signals_ & ~MX_SIGNAL_LAST_HANDLE;
 
         if (previous_signals == signals_)
             return;
 
-        awoke_threads = UpdateInternalLocked(&obs_to_remove, signals_);
+        awoke_threads = UpdateInternalLocked(&obs_to_remove, signals_,
+                                             MX_SIGNAL_LAST_HANDLE);
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -205,10 +218,19 @@ mx_status_t StateTracker::InvalidateCookie(CookieJar* cookiejar) {
     return NO_ERROR;
 }
 
-bool StateTracker::UpdateInternalLocked(ObserverList* obs_to_remove, mx_signals_t signals) {
+bool StateTracker::UpdateInternalLocked(ObserverList* obs_to_remove, mx_signals_t signals,
+                                        mx_signals_t changed) {
     bool awoke_threads = false;
 
+    // nobody on the list cares about the bits that changed
+    if ((changed & interest_) == 0u)
+        return false;
+
     for (auto it = observers_.begin(); it != observers_.end();) {
+        if ((it->watched_signals() & changed) == 0u) {
+            ++it;
+            continue;
+        }
         awoke_threads = it->OnStateChange(signals) || awoke_threads;
         if (it->remove()) {
             auto to_remove = it;
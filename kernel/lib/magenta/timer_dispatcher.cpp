@@ -50,7 +50,7 @@ mx_status_t TimerDispatcher::Create(uint32_t options,
 }
 
 TimerDispatcher::TimerDispatcher(uint32_t /*options*/)
-    : timer_dpc_({LIST_INITIAL_CLEARED_VALUE, &dpc_callback, this}),
+    : timer_dpc_({LIST_INITIAL_CLEARED_VALUE, &dpc_callback, this, DPC_PRI_HIGH}),
       deadline_(0u), period_(0u),
       timer_(TIMER_INITIAL_VALUE(timer_)) {
 }
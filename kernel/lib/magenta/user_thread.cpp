@@ -59,6 +59,8 @@ UserThread::~UserThread() {
     LTRACE_ENTRY_OBJ;
 
     DEBUG_ASSERT(&thread_ != get_current_thread());
+    // Futex PI donors hold a reference on us, so none can remain.
+    DEBUG_ASSERT(futex_donors_.is_empty());
 
     switch (state_) {
     case State::DEAD: {
@@ -840,6 +842,7 @@ void UserThread::GetStatsForUserspace(mx_info_thread_stats_t* info) {
     *info = {};
 
     info->total_runtime = runtime_ns();
+    info->total_queued_time = queued_ns(&info->max_queued_time);
 }
 
 status_t UserThread::GetExceptionReport(mx_exception_report_t* report) {
@@ -914,6 +917,22 @@ status_t UserThread::WriteState(uint32_t state_kind, const void* buffer, uint32_
     }
 }
 
+status_t UserThread::SetDeadline(mx_duration_t capacity, mx_duration_t period) {
+    canary_.Assert();
+
+    LTRACE_ENTRY_OBJ;
+
+    return thread_set_deadline(&thread_, capacity, period);
+}
+
+status_t UserThread::SetCpuAffinity(uint32_t affinity) {
+    canary_.Assert();
+
+    LTRACE_ENTRY_OBJ;
+
+    return thread_set_cpu_affinity(&thread_, affinity);
+}
+
 void magenta_thread_process_name(void* user_thread, char out_name[MX_MAX_NAME_LEN]) {
     UserThread* ut = reinterpret_cast<UserThread*>(user_thread);
     ut->process()->get_name(out_name);
@@ -112,10 +112,28 @@ mx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             auto status = vmo_->DecommitRange(offset, size, nullptr);
             return status;
         }
-        case MX_VMO_OP_LOCK:
+        case MX_VMO_OP_DONT_NEED:
+            return vmo_->DontNeedRange(offset, size);
+        case MX_VMO_OP_WILL_NEED:
+            return vmo_->WillNeedRange(offset, size);
+        case MX_VMO_OP_LOCK: {
+            auto status = vmo_->Pin(offset, size);
+            if (status != NO_ERROR)
+                return status;
+
+            // if the caller provided a buffer, also return the physical
+            // addresses of the pinned pages, saving a separate LOOKUP
+            if (buffer) {
+                static_assert(sizeof(mx_paddr_t) == sizeof(paddr_t), "");
+                status = vmo_->LookupUser(offset, size, buffer.reinterpret<paddr_t>(),
+                                          buffer_size);
+                if (status != NO_ERROR)
+                    vmo_->Unpin(offset, size);
+            }
+            return status;
+        }
         case MX_VMO_OP_UNLOCK:
-            // TODO: handle
-            return ERR_NOT_SUPPORTED;
+            return vmo_->Unpin(offset, size);
         case MX_VMO_OP_LOOKUP:
             // we will be using the user pointer
             if (!buffer)
@@ -138,6 +156,17 @@ mx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
     }
 }
 
+mx_status_t VmObjectDispatcher::Transfer(mxtl::RefPtr<VmObjectDispatcher> dest,
+                                         uint64_t offset, uint64_t dest_offset,
+                                         uint64_t length, uint64_t* actual) {
+    canary_.Assert();
+
+    LTRACEF("offset %#" PRIx64 " dest_offset %#" PRIx64 " length %#" PRIx64 "\n",
+            offset, dest_offset, length);
+
+    return vmo_->TransferRange(dest->vmo(), offset, dest_offset, length, actual);
+}
+
 mx_status_t VmObjectDispatcher::SetMappingCachePolicy(uint32_t cache_policy) {
     return vmo_->SetMappingCachePolicy(cache_policy);
 }
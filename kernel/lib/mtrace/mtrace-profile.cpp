@@ -0,0 +1,299 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+// A simple sampling profiler: a periodic timer on each cpu records the
+// running thread and a frame-pointer walk of its kernel stack into a
+// per-cpu buffer. Unlike IPT this is not arch specific, so the whole
+// thing lives here. In the spirit of the rest of mtrace the goal is KISS:
+// buffers are plain kernel heap, collection stops per cpu when its buffer
+// fills, and buffers may only be read back while sampling is stopped.
+
+#include <inttypes.h>
+
+#include <arch/ops.h>
+#include <arch/user_copy.h>
+#include <err.h>
+#include <kernel/mp.h>
+#include <kernel/mutex.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/vm.h>
+#include <stdlib.h>
+#include <string.h>
+#include <trace.h>
+
+#include "lib/mtrace.h"
+
+#include <magenta/mtrace.h>
+#include <magenta/thread_annotations.h>
+
+#define LOCAL_TRACE 0
+
+// Don't allow periods so short that sampling overhead swamps the system.
+// 10us is ~2 orders of magnitude above the cost of taking one sample.
+#define PROFILE_MIN_PERIOD LK_USEC(10)
+
+// Cap the per-cpu buffer at a size that is clearly a configuration error
+// rather than a long trace (1M records is ~112MB of samples per cpu).
+#define PROFILE_MAX_RECORDS (1u << 20)
+
+struct profile_cpu_state_t {
+    mx_profile_record_t* records;
+    uint32_t capacity;
+    // written from the timer callback on the owning cpu, read while stopped
+    volatile uint32_t count;
+    timer_t timer;
+};
+
+static Mutex profile_lock;
+
+static profile_cpu_state_t* profile_cpu_state TA_GUARDED(profile_lock);
+
+static lk_time_t profile_period TA_GUARDED(profile_lock);
+
+static bool profile_active TA_GUARDED(profile_lock) = false;
+
+// Walk the frame pointer chain of the interrupted thread; timer callbacks
+// run on the interrupted thread's kernel stack so the chain leads through
+// the interrupt glue into the frames we care about. The innermost entries
+// belong to the timer machinery and this function itself; readers trim
+// them after symbolizing. Bounds checks mirror thread_read_stack().
+static uint32_t profile_backtrace(thread_t* t, uint64_t* pc) {
+    void* fp = __GET_FRAME(0);
+    uint32_t n = 0;
+    while (n < MX_PROFILE_MAX_FRAMES) {
+        if (!is_kernel_address((uintptr_t)fp) ||
+            fp < t->stack ||
+            fp > (void*)((char*)t->stack + t->stack_size - 2 * sizeof(void*))) {
+            break;
+        }
+        void** frame = static_cast<void**>(fp);
+        pc[n++] = (uint64_t)(uintptr_t)frame[1];
+        fp = frame[0];
+    }
+    return n;
+}
+
+// Runs in interrupt context on the sampled cpu.
+static enum handler_return profile_timer_callback(timer_t* timer, lk_time_t now,
+                                                  void* arg) {
+    profile_cpu_state_t* state = reinterpret_cast<profile_cpu_state_t*>(arg);
+
+    uint32_t idx = state->count;
+    if (idx >= state->capacity)
+        return INT_NO_RESCHEDULE;
+
+    thread_t* t = get_current_thread();
+    mx_profile_record_t* rec = &state->records[idx];
+    rec->timestamp = now;
+    rec->pid = t->user_pid;
+    rec->tid = t->user_tid;
+    rec->cpu = arch_curr_cpu_num();
+    rec->num_frames = profile_backtrace(t, rec->pc);
+    state->count = idx + 1;
+    return INT_NO_RESCHEDULE;
+}
+
+// These are invoked via mp_sync_exec which thread safety analysis cannot follow.
+static void profile_start_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(profile_active && raw_context);
+
+    profile_cpu_state_t* context = reinterpret_cast<profile_cpu_state_t*>(raw_context);
+    profile_cpu_state_t* state = &context[arch_curr_cpu_num()];
+
+    state->count = 0;
+    timer_set_periodic(&state->timer, profile_period, profile_timer_callback, state);
+}
+
+static void profile_stop_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(raw_context);
+
+    profile_cpu_state_t* context = reinterpret_cast<profile_cpu_state_t*>(raw_context);
+    profile_cpu_state_t* state = &context[arch_curr_cpu_num()];
+
+    timer_cancel(&state->timer);
+}
+
+static status_t profile_alloc(const mx_profile_config_t* config) {
+    AutoLock al(&profile_lock);
+
+    if (profile_active)
+        return ERR_BAD_STATE;
+    if (profile_cpu_state)
+        return ERR_BAD_STATE;
+    if (config->sample_period_ns < PROFILE_MIN_PERIOD)
+        return ERR_INVALID_ARGS;
+    if (config->num_records == 0 || config->num_records > PROFILE_MAX_RECORDS)
+        return ERR_INVALID_ARGS;
+    if (config->reserved != 0)
+        return ERR_INVALID_ARGS;
+
+    uint32_t num_cpus = arch_max_num_cpus();
+    profile_cpu_state =
+        reinterpret_cast<profile_cpu_state_t*>(calloc(num_cpus,
+                                                      sizeof(*profile_cpu_state)));
+    if (!profile_cpu_state)
+        return ERR_NO_MEMORY;
+
+    for (uint32_t cpu = 0; cpu < num_cpus; ++cpu) {
+        profile_cpu_state_t* state = &profile_cpu_state[cpu];
+        state->records =
+            reinterpret_cast<mx_profile_record_t*>(calloc(config->num_records,
+                                                          sizeof(*state->records)));
+        if (!state->records) {
+            while (cpu-- > 0)
+                free(profile_cpu_state[cpu].records);
+            free(profile_cpu_state);
+            profile_cpu_state = nullptr;
+            return ERR_NO_MEMORY;
+        }
+        state->capacity = config->num_records;
+        timer_initialize(&state->timer);
+    }
+
+    profile_period = config->sample_period_ns;
+    return NO_ERROR;
+}
+
+static status_t profile_start() {
+    AutoLock al(&profile_lock);
+
+    if (profile_active)
+        return ERR_BAD_STATE;
+    if (!profile_cpu_state)
+        return ERR_BAD_STATE;
+
+    TRACEF("Enabling profiler, period %" PRIu64 " ns\n", profile_period);
+
+    profile_active = true;
+    mp_sync_exec(MP_CPU_ALL, profile_start_cpu_task, profile_cpu_state);
+    return NO_ERROR;
+}
+
+// This can be called while not active, so the caller doesn't have to care
+// during any cleanup.
+static status_t profile_stop() {
+    AutoLock al(&profile_lock);
+
+    if (!profile_cpu_state)
+        return ERR_BAD_STATE;
+
+    TRACEF("Disabling profiler\n");
+
+    mp_sync_exec(MP_CPU_ALL, profile_stop_cpu_task, profile_cpu_state);
+    profile_active = false;
+    return NO_ERROR;
+}
+
+static status_t profile_free() {
+    AutoLock al(&profile_lock);
+
+    if (profile_active)
+        return ERR_BAD_STATE;
+    if (!profile_cpu_state)
+        return NO_ERROR;
+
+    uint32_t num_cpus = arch_max_num_cpus();
+    for (uint32_t cpu = 0; cpu < num_cpus; ++cpu)
+        free(profile_cpu_state[cpu].records);
+    free(profile_cpu_state);
+    profile_cpu_state = nullptr;
+    return NO_ERROR;
+}
+
+static status_t profile_get_num_records(uint32_t cpu, uint32_t* count) {
+    AutoLock al(&profile_lock);
+
+    if (profile_active)
+        return ERR_BAD_STATE;
+    if (!profile_cpu_state)
+        return ERR_BAD_STATE;
+    if (cpu >= arch_max_num_cpus())
+        return ERR_INVALID_ARGS;
+
+    *count = profile_cpu_state[cpu].count;
+    return NO_ERROR;
+}
+
+static status_t profile_read(uint32_t cpu, void* arg, uint32_t size) {
+    AutoLock al(&profile_lock);
+
+    if (profile_active)
+        return ERR_BAD_STATE;
+    if (!profile_cpu_state)
+        return ERR_BAD_STATE;
+    if (cpu >= arch_max_num_cpus())
+        return ERR_INVALID_ARGS;
+
+    profile_cpu_state_t* state = &profile_cpu_state[cpu];
+    uint32_t bytes = state->count * (uint32_t)sizeof(*state->records);
+    if (size < bytes)
+        return ERR_BUFFER_TOO_SMALL;
+    if (bytes == 0)
+        return NO_ERROR;
+    if (arch_copy_to_user(arg, state->records, bytes) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    return NO_ERROR;
+}
+
+status_t mtrace_profile_control(uint32_t action, uint32_t options,
+                                void* arg, uint32_t size) {
+    TRACEF("action %u, options 0x%x, arg %p, size 0x%x\n",
+           action, options, arg, size);
+
+    switch (action) {
+    case MTRACE_PROFILE_ALLOC: {
+        mx_profile_config_t config;
+        if (options != 0)
+            return ERR_INVALID_ARGS;
+        if (size != sizeof(config))
+            return ERR_INVALID_ARGS;
+        if (arch_copy_from_user(&config, arg, size) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        return profile_alloc(&config);
+    }
+
+    case MTRACE_PROFILE_START:
+        if (options != 0 || size != 0)
+            return ERR_INVALID_ARGS;
+        return profile_start();
+    case MTRACE_PROFILE_STOP:
+        if (options != 0 || size != 0)
+            return ERR_INVALID_ARGS;
+        return profile_stop();
+    case MTRACE_PROFILE_FREE:
+        if (options != 0 || size != 0)
+            return ERR_INVALID_ARGS;
+        return profile_free();
+
+    case MTRACE_PROFILE_GET_NUM_RECORDS: {
+        uint32_t count;
+        if (size != sizeof(count))
+            return ERR_INVALID_ARGS;
+        uint32_t cpu = MTRACE_PROFILE_OPTIONS_CPU(options);
+        if ((options & ~MTRACE_PROFILE_OPTIONS_CPU_MASK) != 0)
+            return ERR_INVALID_ARGS;
+        auto status = profile_get_num_records(cpu, &count);
+        if (status != NO_ERROR)
+            return status;
+        if (arch_copy_to_user(arg, &count, size) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        return NO_ERROR;
+    }
+
+    case MTRACE_PROFILE_READ: {
+        uint32_t cpu = MTRACE_PROFILE_OPTIONS_CPU(options);
+        if ((options & ~MTRACE_PROFILE_OPTIONS_CPU_MASK) != 0)
+            return ERR_INVALID_ARGS;
+        return profile_read(cpu, arg, size);
+    }
+
+    default:
+        return ERR_INVALID_ARGS;
+    }
+}
@@ -25,6 +25,8 @@ status_t mtrace_control(uint32_t kind, uint32_t action, uint32_t options,
     case MTRACE_KIND_IPT:
         return mtrace_ipt_control(action, options, arg, size);
 #endif
+    case MTRACE_KIND_PROFILE:
+        return mtrace_profile_control(action, options, arg, size);
     default:
         return ERR_INVALID_ARGS;
     }
@@ -10,6 +10,7 @@ MODULE := $(LOCAL_DIR)
 
 MODULE_SRCS += \
 	$(LOCAL_DIR)/mtrace.cpp \
-	$(LOCAL_DIR)/mtrace-ipt.cpp
+	$(LOCAL_DIR)/mtrace-ipt.cpp \
+	$(LOCAL_DIR)/mtrace-profile.cpp
 
 include make/module.mk
@@ -0,0 +1,118 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_CDECLS
+
+/**
+ * A wait-free single-producer/single-consumer byte ring.
+ *
+ * Unlike cbuf, spsc_buf takes no locks and signals no events; the single
+ * producer (typically an interrupt handler) and the single consumer may run
+ * concurrently on different cpus without ever blocking each other.  Reads and
+ * writes move whole runs of bytes with at most two memcpys, so per-byte
+ * producers should stage bytes locally and publish them in one call.  Callers
+ * which need to block until data arrives layer their own event on top and
+ * signal it once per batch, not once per byte.
+ *
+ * head and tail are free-running counters (they are masked only when indexing
+ * the data buffer), so the full power-of-two capacity is usable.  head is
+ * written only by the producer; tail is written only by the consumer.
+ */
+typedef struct spsc_buf {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t len_pow2;
+    char *buf;
+} spsc_buf_t;
+
+/**
+ * spsc_buf_initialize
+ *
+ * Initialize an spsc_buf structure, mallocing the underlying data buffer in
+ * the process.  len must be a power of two.
+ *
+ * @param[in] spsc A pointer to the spsc_buf structure to initialize.
+ * @param[in] len The size of the underlying data buffer, in bytes.
+ */
+void spsc_buf_initialize(spsc_buf_t *spsc, size_t len);
+
+/**
+ * spsc_buf_initialize_etc
+ *
+ * Initialize an spsc_buf structure using the supplied buffer for internal
+ * storage.  len must be a power of two.
+ *
+ * @param[in] spsc A pointer to the spsc_buf structure to initialize.
+ * @param[in] len The size of the supplied buffer, in bytes.
+ * @param[in] buf A pointer to the memory to be used for internal storage.
+ */
+void spsc_buf_initialize_etc(spsc_buf_t *spsc, size_t len, void *buf);
+
+/**
+ * spsc_buf_write
+ *
+ * Write up to len bytes from the supplied buffer into the ring.  May only be
+ * called from the producer side.
+ *
+ * @return The number of bytes which were written; less than len (possibly 0)
+ * if the ring did not have room for everything.
+ */
+size_t spsc_buf_write(spsc_buf_t *spsc, const void *buf, size_t len);
+
+/**
+ * spsc_buf_read
+ *
+ * Read up to len bytes from the ring into the supplied buffer.  May only be
+ * called from the consumer side.
+ *
+ * @return The number of bytes which were read; 0 if the ring was empty.
+ */
+size_t spsc_buf_read(spsc_buf_t *spsc, void *buf, size_t len);
+
+/**
+ * spsc_buf_space_avail
+ *
+ * @return The number of bytes which can currently be written.  Exact from the
+ * producer side; a lower bound from anywhere else.
+ */
+size_t spsc_buf_space_avail(const spsc_buf_t *spsc);
+
+/**
+ * spsc_buf_space_used
+ *
+ * @return The number of bytes which can currently be read.  Exact from the
+ * consumer side; a lower bound from anywhere else.
+ */
+size_t spsc_buf_space_used(const spsc_buf_t *spsc);
+
+/**
+ * spsc_buf_size
+ *
+ * @return The size of the ring's underlying data buffer.
+ */
+static inline size_t spsc_buf_size(const spsc_buf_t *spsc)
+{
+    return (1UL << spsc->len_pow2);
+}
+
+/* special cases for dealing with a single char of data */
+static inline size_t spsc_buf_write_char(spsc_buf_t *spsc, char c)
+{
+    return spsc_buf_write(spsc, &c, 1);
+}
+
+static inline size_t spsc_buf_read_char(spsc_buf_t *spsc, char *c)
+{
+    return spsc_buf_read(spsc, c, 1);
+}
+
+__END_CDECLS
@@ -0,0 +1,110 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/spsc_buf.h>
+
+#include <assert.h>
+#include <magenta/atomic.h>
+#include <pow2.h>
+#include <stdlib.h>
+#include <string.h>
+
+void spsc_buf_initialize(spsc_buf_t *spsc, size_t len)
+{
+    spsc_buf_initialize_etc(spsc, len, malloc(len));
+}
+
+void spsc_buf_initialize_etc(spsc_buf_t *spsc, size_t len, void *buf)
+{
+    DEBUG_ASSERT(spsc);
+    DEBUG_ASSERT(len > 0);
+    DEBUG_ASSERT(ispow2(len));
+
+    spsc->head = 0;
+    spsc->tail = 0;
+    spsc->len_pow2 = log2_uint_floor(len);
+    spsc->buf = buf;
+}
+
+size_t spsc_buf_space_avail(const spsc_buf_t *spsc)
+{
+    uint32_t head = atomic_load_u32_relaxed((volatile uint32_t *)&spsc->head);
+    uint32_t tail = atomic_load_u32_relaxed((volatile uint32_t *)&spsc->tail);
+    return spsc_buf_size(spsc) - (size_t)(uint32_t)(head - tail);
+}
+
+size_t spsc_buf_space_used(const spsc_buf_t *spsc)
+{
+    uint32_t head = atomic_load_u32_relaxed((volatile uint32_t *)&spsc->head);
+    uint32_t tail = atomic_load_u32_relaxed((volatile uint32_t *)&spsc->tail);
+    return (size_t)(uint32_t)(head - tail);
+}
+
+size_t spsc_buf_write(spsc_buf_t *spsc, const void *_buf, size_t len)
+{
+    const char *buf = (const char *)_buf;
+
+    DEBUG_ASSERT(spsc);
+    DEBUG_ASSERT(spsc->buf);
+    DEBUG_ASSERT(buf);
+
+    // head is only ever written by us (the producer); the acquire load of
+    // tail pairs with the consumer's release store and guarantees that the
+    // consumer is completely done with the bytes we are about to overwrite.
+    uint32_t head = spsc->head;
+    uint32_t tail = atomic_load_u32_acquire(&spsc->tail);
+
+    size_t size  = spsc_buf_size(spsc);
+    size_t avail = size - (size_t)(uint32_t)(head - tail);
+    if (len > avail)
+        len = avail;
+    if (len == 0)
+        return 0;
+
+    // Copy in at most two contiguous runs (the write may wrap the ring).
+    size_t offset = modpow2(head, spsc->len_pow2);
+    size_t first  = MIN(len, size - offset);
+    memcpy(spsc->buf + offset, buf, first);
+    if (first < len)
+        memcpy(spsc->buf, buf + first, len - first);
+
+    // Publish the new bytes; pairs with the consumer's acquire load of head.
+    atomic_store_u32_release(&spsc->head, head + (uint32_t)len);
+    return len;
+}
+
+size_t spsc_buf_read(spsc_buf_t *spsc, void *_buf, size_t len)
+{
+    char *buf = (char *)_buf;
+
+    DEBUG_ASSERT(spsc);
+    DEBUG_ASSERT(spsc->buf);
+    DEBUG_ASSERT(buf);
+
+    // tail is only ever written by us (the consumer); the acquire load of
+    // head pairs with the producer's release store and guarantees that the
+    // bytes it published are visible before we copy them out.
+    uint32_t tail = spsc->tail;
+    uint32_t head = atomic_load_u32_acquire(&spsc->head);
+
+    size_t used = (size_t)(uint32_t)(head - tail);
+    if (len > used)
+        len = used;
+    if (len == 0)
+        return 0;
+
+    // Copy out at most two contiguous runs (the read may wrap the ring).
+    size_t size   = spsc_buf_size(spsc);
+    size_t offset = modpow2(tail, spsc->len_pow2);
+    size_t first  = MIN(len, size - offset);
+    memcpy(buf, spsc->buf + offset, first);
+    if (first < len)
+        memcpy(buf + first, spsc->buf, len - first);
+
+    // Retire the bytes; pairs with the producer's acquire load of tail.
+    atomic_store_u32_release(&spsc->tail, tail + (uint32_t)len);
+    return len;
+}
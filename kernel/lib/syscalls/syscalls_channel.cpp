@@ -20,6 +20,7 @@
 #include <magenta/process_dispatcher.h>
 #include <magenta/syscalls/policy.h>
 #include <magenta/user_copy.h>
+#include <magenta/vm_object_dispatcher.h>
 
 #include <mxtl/algorithm.h>
 #include <mxtl/ref_ptr.h>
@@ -141,6 +142,90 @@ mx_status_t sys_channel_read(mx_handle_t handle_value, uint32_t options,
     return result;
 }
 
+// Copy in and validate an iovec array for the vectored channel calls,
+// returning the total byte count spanned by the fragments.
+static mx_status_t msg_copy_iovecs(user_ptr<const mx_iovec_t> _iovecs, uint32_t num_iovecs,
+                                   mx_iovec_t* iovecs, uint32_t* total_bytes) {
+    if (num_iovecs == 0u || num_iovecs > MX_CHANNEL_MAX_MSG_IOVECS)
+        return ERR_OUT_OF_RANGE;
+
+    if (_iovecs.copy_array_from_user(iovecs, num_iovecs) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    uint64_t total = 0u;
+    for (uint32_t i = 0u; i < num_iovecs; ++i) {
+        total += iovecs[i].capacity;
+    }
+    if (total > kMaxMessageSize)
+        return ERR_OUT_OF_RANGE;
+
+    *total_bytes = static_cast<uint32_t>(total);
+    return NO_ERROR;
+}
+
+mx_status_t sys_channel_read_v(mx_handle_t handle_value, uint32_t options,
+                               user_ptr<const mx_iovec_t> _iovecs, uint32_t num_iovecs,
+                               user_ptr<mx_handle_t> _handles, uint32_t num_handles,
+                               user_ptr<uint32_t> _num_bytes, user_ptr<uint32_t> _num_handles) {
+    LTRACEF("handle %d iovecs %p num_iovecs %u\n", handle_value, _iovecs.get(), num_iovecs);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<ChannelDispatcher> channel;
+    mx_status_t result = up->GetDispatcherWithRights(handle_value, MX_RIGHT_READ, &channel);
+    if (result != NO_ERROR)
+        return result;
+
+    // Currently MAY_DISCARD is the only allowable option.
+    if (options & ~MX_CHANNEL_READ_MAY_DISCARD)
+        return ERR_NOT_SUPPORTED;
+
+    mx_iovec_t iovecs[MX_CHANNEL_MAX_MSG_IOVECS];
+    uint32_t num_bytes;
+    result = msg_copy_iovecs(_iovecs, num_iovecs, iovecs, &num_bytes);
+    if (result != NO_ERROR)
+        return result;
+
+    mxtl::unique_ptr<MessagePacket> msg;
+    result = channel->Read(&num_bytes, &num_handles, &msg,
+                           options & MX_CHANNEL_READ_MAY_DISCARD);
+    if (result != NO_ERROR && result != ERR_BUFFER_TOO_SMALL)
+        return result;
+
+    if (_num_bytes) {
+        if (_num_bytes.copy_to_user(num_bytes) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+    }
+    if (_num_handles) {
+        if (_num_handles.copy_to_user(num_handles) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+    }
+    if (result == ERR_BUFFER_TOO_SMALL)
+        return result;
+
+    // scatter the message payload across the user fragments in order
+    const char* src = static_cast<const char*>(msg->data());
+    uint32_t remaining = num_bytes;
+    for (uint32_t i = 0u; i < num_iovecs && remaining > 0u; ++i) {
+        uint32_t chunk = static_cast<uint32_t>(mxtl::min<uint64_t>(iovecs[i].capacity, remaining));
+        if (chunk == 0u)
+            continue;
+        if (make_user_ptr(iovecs[i].buffer).copy_array_to_user(src, chunk) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        src += chunk;
+        remaining -= chunk;
+    }
+
+    // The documented public API states that that writing to the handles buffer
+    // must happen after writing to the data buffer.
+    if (num_handles > 0u) {
+        msg_get_handles(up, msg.get(), _handles, num_handles);
+    }
+
+    ktrace(TAG_CHANNEL_READ, (uint32_t)channel->get_koid(), num_bytes, num_handles, 0);
+    return result;
+}
+
 static mx_status_t msg_put_handles(ProcessDispatcher* up, MessagePacket* msg, mx_handle_t* handles,
                                    user_ptr<const mx_handle_t> _handles, uint32_t num_handles,
                                    Dispatcher* channel) {
@@ -238,6 +323,139 @@ mx_status_t sys_channel_write(mx_handle_t handle_value, uint32_t options,
     return result;
 }
 
+mx_status_t sys_channel_write_vmo(mx_handle_t handle_value, uint32_t options,
+                                  mx_handle_t vmo_handle, uint64_t offset, uint64_t length) {
+    LTRACEF("handle %d vmo %d offset %#" PRIx64 " length %#" PRIx64 " options 0x%x\n",
+            handle_value, vmo_handle, offset, length, options);
+
+    if (options)
+        return ERR_INVALID_ARGS;
+    if (length == 0u)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<ChannelDispatcher> channel;
+    mx_status_t result = up->GetDispatcherWithRights(handle_value, MX_RIGHT_WRITE, &channel);
+    if (result != NO_ERROR)
+        return result;
+
+    // Send the payload range as a copy-on-write clone, so the transfer
+    // cost is independent of |length|. This is not a snapshot: as with
+    // mx_vmo_clone(), a page is only copied when the *clone* is written,
+    // while sender writes land in the shared page and stay visible
+    // through the clone. A receiver that must not observe later sender
+    // writes has to copy the payload out before acting on it.
+    mxtl::RefPtr<VmObject> clone_vmo;
+    mx_rights_t in_rights;
+    {
+        mxtl::RefPtr<VmObjectDispatcher> vmo;
+        result = up->GetDispatcherWithRights(vmo_handle, MX_RIGHT_DUPLICATE | MX_RIGHT_READ,
+                                             &vmo, &in_rights);
+        if (result != NO_ERROR)
+            return result;
+
+        result = vmo->Clone(MX_VMO_CLONE_COPY_ON_WRITE, offset, length,
+                            in_rights & MX_RIGHT_GET_PROPERTY, &clone_vmo);
+        if (result != NO_ERROR)
+            return result;
+    }
+
+    mxtl::RefPtr<Dispatcher> clone_dispatcher;
+    mx_rights_t default_rights;
+    result = VmObjectDispatcher::Create(mxtl::move(clone_vmo), &clone_dispatcher,
+                                        &default_rights);
+    if (result != NO_ERROR)
+        return result;
+
+    mxtl::unique_ptr<MessagePacket> msg;
+    result = MessagePacket::Create(sizeof(mx_channel_vmo_msg_t), 1u, &msg);
+    if (result != NO_ERROR)
+        return result;
+
+    auto vmo_msg = static_cast<mx_channel_vmo_msg_t*>(msg->mutable_data());
+    vmo_msg->tag = MX_CHANNEL_VMO_MSG_TAG;
+    vmo_msg->reserved = 0u;
+    vmo_msg->offset = 0u;       // the clone starts at the payload
+    vmo_msg->length = length;
+
+    // Like sys_vmo_clone(), a COW clone is writable regardless of the
+    // rights on the source handle.
+    mx_rights_t rights = in_rights | MX_RIGHT_WRITE |
+                         MX_RIGHT_GET_PROPERTY | MX_RIGHT_SET_PROPERTY;
+    Handle* clone_handle = MakeHandle(mxtl::move(clone_dispatcher), rights);
+    if (!clone_handle)
+        return ERR_NO_MEMORY;
+
+    msg->mutable_handles()[0] = clone_handle;
+    // The clone handle was never in our handle table; if the write fails
+    // the message reaps it on destruction.
+    msg->set_owns_handles(true);
+
+    result = channel->Write(mxtl::move(msg));
+
+    ktrace(TAG_CHANNEL_WRITE, (uint32_t)channel->get_koid(), 0, 1, 0);
+    return result;
+}
+
+mx_status_t sys_channel_write_v(mx_handle_t handle_value, uint32_t options,
+                                user_ptr<const mx_iovec_t> _iovecs, uint32_t num_iovecs,
+                                user_ptr<const mx_handle_t> _handles, uint32_t num_handles) {
+    LTRACEF("handle %d iovecs %p num_iovecs %u handles %p num_handles %u options 0x%x\n",
+            handle_value, _iovecs.get(), num_iovecs, _handles.get(), num_handles, options);
+
+    if (options)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<ChannelDispatcher> channel;
+    mx_status_t result = up->GetDispatcherWithRights(handle_value, MX_RIGHT_WRITE, &channel);
+    if (result != NO_ERROR)
+        return result;
+
+    mx_iovec_t iovecs[MX_CHANNEL_MAX_MSG_IOVECS];
+    uint32_t num_bytes;
+    result = msg_copy_iovecs(_iovecs, num_iovecs, iovecs, &num_bytes);
+    if (result != NO_ERROR)
+        return result;
+
+    mxtl::unique_ptr<MessagePacket> msg;
+    result = MessagePacket::Create(num_bytes, num_handles, &msg);
+    if (result != NO_ERROR)
+        return result;
+
+    // gather the user fragments straight into the message payload
+    char* dst = static_cast<char*>(msg->mutable_data());
+    for (uint32_t i = 0u; i < num_iovecs; ++i) {
+        if (iovecs[i].capacity == 0u)
+            continue;
+        if (make_user_ptr<const void>(iovecs[i].buffer).copy_array_from_user(dst, iovecs[i].capacity) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        dst += iovecs[i].capacity;
+    }
+
+    mx_handle_t handles[kMaxMessageHandles];
+    if (num_handles > 0u) {
+        result = msg_put_handles(up, msg.get(), handles, _handles, num_handles,
+                                 static_cast<Dispatcher*>(channel.get()));
+        if (result)
+            return result;
+    }
+
+    result = channel->Write(mxtl::move(msg));
+    if (result != NO_ERROR) {
+        // Write failed, put back the handles into this process.
+        AutoLock lock(up->handle_table_lock());
+        for (size_t ix = 0; ix != num_handles; ++ix) {
+            up->UndoRemoveHandleLocked(handles[ix]);
+        }
+    }
+
+    ktrace(TAG_CHANNEL_WRITE, (uint32_t)channel->get_koid(), num_bytes, num_handles, 0);
+    return result;
+}
+
 mx_status_t sys_channel_call(mx_handle_t handle_value, uint32_t options,
                              mx_time_t deadline, user_ptr<const mx_channel_call_args_t> _args,
                              user_ptr<uint32_t> actual_bytes, user_ptr<uint32_t> actual_handles,
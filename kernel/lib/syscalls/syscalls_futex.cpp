@@ -26,6 +26,21 @@ mx_status_t sys_futex_wake(user_ptr<const mx_futex_t> value_ptr, uint32_t count)
         value_ptr, count);
 }
 
+mx_status_t sys_futex_wait_pi(user_ptr<mx_futex_t> value_ptr, int current_value,
+                              mx_time_t deadline) {
+    LTRACEF("futex %p current %d\n", value_ptr.get(), current_value);
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWaitPi(
+        value_ptr, current_value, deadline);
+}
+
+mx_status_t sys_futex_wake_pi(user_ptr<const mx_futex_t> value_ptr, uint32_t count) {
+    LTRACEF("futex %p count %" PRIu32 "\n", value_ptr.get(), count);
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWakePi(
+        value_ptr, count);
+}
+
 mx_status_t sys_futex_requeue(user_ptr<mx_futex_t> wake_ptr, uint32_t wake_count, int current_value,
                               user_ptr<mx_futex_t> requeue_ptr, uint32_t requeue_count) {
     LTRACEF("futex %p wake_count %" PRIu32 "current_value %d "
@@ -11,9 +11,12 @@
 #include <kernel/auto_lock.h>
 
 #include <magenta/handle_owner.h>
+#include <magenta/handle_reaper.h>
 #include <magenta/magenta.h>
 #include <magenta/process_dispatcher.h>
 
+#include <mxtl/intrusive_double_list.h>
+
 #include "syscalls_priv.h"
 
 #define LOCAL_TRACE 0
@@ -27,6 +30,47 @@ mx_status_t sys_handle_close(mx_handle_t handle_value) {
     return NO_ERROR;
 }
 
+// Handles are closed in batches of this size, so a large count costs one
+// handle table lock acquisition and one pass over the reaper list per batch
+// rather than per handle.
+constexpr size_t kCloseManyBatchSize = 64u;
+
+mx_status_t sys_handle_close_many(user_ptr<const mx_handle_t> _handles, size_t count) {
+    LTRACEF("count %zu\n", count);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mx_status_t result = NO_ERROR;
+    for (size_t done = 0; done < count; done += kCloseManyBatchSize) {
+        mx_handle_t values[kCloseManyBatchSize];
+        size_t n = count - done;
+        if (n > kCloseManyBatchSize)
+            n = kCloseManyBatchSize;
+        if (_handles.copy_array_from_user(values, n, done) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+
+        // Pull the whole batch out of the handle table in one acquisition and
+        // leave the destruction of the handles to the reaper.
+        mxtl::DoublyLinkedList<Handle*> to_reap;
+        {
+            AutoLock lock(up->handle_table_lock());
+            for (size_t i = 0; i < n; ++i) {
+                HandleOwner handle(up->RemoveHandleLocked(values[i]));
+                if (!handle) {
+                    // keep closing the rest; the caller can do nothing useful
+                    // with a partially closed batch
+                    result = ERR_BAD_HANDLE;
+                    continue;
+                }
+                to_reap.push_back(handle.release());
+            }
+        }
+        if (!to_reap.is_empty())
+            ReapHandles(&to_reap);
+    }
+    return result;
+}
+
 static mx_status_t handle_dup_replace(
     bool is_replace, mx_handle_t handle_value, mx_rights_t rights, user_ptr<mx_handle_t> _out) {
     LTRACEF("handle %d\n", handle_value);
@@ -102,6 +102,17 @@ static mx_status_t guest_mem_trap(mx_handle_t handle, mx_vaddr_t guest_paddr, si
     return guest->MemTrap(guest_paddr, size);
 }
 
+static mx_status_t guest_interrupt(mx_handle_t handle, uint32_t vector) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<GuestDispatcher> guest;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_WRITE, &guest);
+    if (status != NO_ERROR)
+        return status;
+
+    return guest->Interrupt(vector);
+}
+
 static mx_status_t guest_set_gpr(mx_handle_t handle, const mx_guest_gpr_t& guest_gpr) {
     auto up = ProcessDispatcher::GetCurrent();
 
@@ -163,6 +174,23 @@ static mx_status_t guest_set_apic_mem(mx_handle_t handle, mx_handle_t apic_mem_h
 
     return guest->SetApicMem(apic_mem->vmo());
 }
+
+static mx_status_t guest_set_port_trap(mx_handle_t handle, uint16_t port, uint16_t len,
+                                       mx_handle_t fifo_handle) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<GuestDispatcher> guest;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_WRITE, &guest);
+    if (status != NO_ERROR)
+        return status;
+
+    mxtl::RefPtr<FifoDispatcher> fifo;
+    status = up->GetDispatcherWithRights(fifo_handle, MX_RIGHT_WRITE, &fifo);
+    if (status != NO_ERROR)
+        return status;
+
+    return guest->SetPortTrap(port, len, fifo);
+}
 #endif
 
  mx_status_t sys_hypervisor_op(mx_handle_t handle, uint32_t opcode, user_ptr<const void> args,
@@ -221,6 +249,14 @@ static mx_status_t guest_set_apic_mem(mx_handle_t handle, mx_handle_t apic_mem_h
             return ERR_INVALID_ARGS;
         return guest_set_ip(handle, guest_ip);
     }
+    case MX_HYPERVISOR_OP_GUEST_INTERRUPT: {
+        uint32_t vector;
+        if (args_len != sizeof(vector))
+            return ERR_INVALID_ARGS;
+        if (args.copy_array_from_user(&vector, sizeof(vector)) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        return guest_interrupt(handle, vector);
+    }
 #if ARCH_X86_64
     case MX_HYPERVISOR_OP_GUEST_SET_ENTRY_CR3: {
         uintptr_t guest_cr3;
@@ -238,6 +274,14 @@ static mx_status_t guest_set_apic_mem(mx_handle_t handle, mx_handle_t apic_mem_h
             return ERR_INVALID_ARGS;
         return guest_set_apic_mem(handle, apic_mem);
     }
+    case MX_HYPERVISOR_OP_GUEST_SET_PORT_TRAP: {
+        mx_guest_port_trap_args_t trap_args;
+        if (args_len != sizeof(trap_args))
+            return ERR_INVALID_ARGS;
+        if (args.copy_array_from_user(&trap_args, sizeof(trap_args)) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        return guest_set_port_trap(handle, trap_args.port, trap_args.len, trap_args.fifo);
+    }
 #endif // ARCH_X86_64
     default:
         return ERR_INVALID_ARGS;
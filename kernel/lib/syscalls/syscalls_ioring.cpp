@@ -0,0 +1,204 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <trace.h>
+
+#include <lib/user_copy.h>
+#include <lib/user_copy/user_ptr.h>
+
+#include <magenta/channel_dispatcher.h>
+#include <magenta/handle_owner.h>
+#include <magenta/io_ring_dispatcher.h>
+#include <magenta/magenta.h>
+#include <magenta/message_packet.h>
+#include <magenta/process_dispatcher.h>
+#include <magenta/socket_dispatcher.h>
+#include <magenta/syscalls/ioring.h>
+#include <magenta/syscalls/policy.h>
+#include <magenta/vm_object_dispatcher.h>
+
+#include <mxtl/ref_ptr.h>
+
+#include "syscalls_priv.h"
+
+#define LOCAL_TRACE 0
+
+mx_status_t sys_ioring_create(uint32_t entries, uint32_t options,
+                              user_ptr<mx_handle_t> _out_ioring,
+                              user_ptr<mx_handle_t> _out_vmo) {
+    LTRACEF("entries %u options 0x%x\n", entries, options);
+
+    auto up = ProcessDispatcher::GetCurrent();
+    // the rings are backed by a new vmo, so gate on the vmo policy
+    mx_status_t res = up->QueryPolicy(MX_POL_NEW_VMO);
+    if (res < 0)
+        return res;
+
+    mxtl::RefPtr<Dispatcher> dispatcher;
+    mxtl::RefPtr<VmObject> vmo;
+    mx_rights_t rights;
+    mx_status_t result = IoRingDispatcher::Create(entries, options,
+                                                  &dispatcher, &vmo, &rights);
+    if (result != NO_ERROR)
+        return result;
+
+    mxtl::RefPtr<Dispatcher> vmo_dispatcher;
+    mx_rights_t vmo_rights;
+    result = VmObjectDispatcher::Create(mxtl::move(vmo), &vmo_dispatcher, &vmo_rights);
+    if (result != NO_ERROR)
+        return result;
+
+    HandleOwner ioring_handle(MakeHandle(mxtl::move(dispatcher), rights));
+    if (!ioring_handle)
+        return ERR_NO_MEMORY;
+    HandleOwner vmo_handle(MakeHandle(mxtl::move(vmo_dispatcher), vmo_rights));
+    if (!vmo_handle)
+        return ERR_NO_MEMORY;
+
+    if (_out_ioring.copy_to_user(up->MapHandleToValue(ioring_handle)) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    if (_out_vmo.copy_to_user(up->MapHandleToValue(vmo_handle)) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    up->AddHandle(mxtl::move(ioring_handle));
+    up->AddHandle(mxtl::move(vmo_handle));
+
+    return NO_ERROR;
+}
+
+// Runs one submission in the context of the submitting process. Handle and
+// buffer validation errors are reported through the completion entry, so a
+// bad operation fails alone instead of failing the whole batch.
+static mx_status_t ioring_do_op(void* cookie, const mx_ioring_sqe_t* sqe,
+                                mx_ioring_cqe_t* cqe) {
+    auto up = static_cast<ProcessDispatcher*>(cookie);
+    mx_status_t status;
+
+    if (sqe->options != 0u || sqe->reserved != 0u) {
+        cqe->status = ERR_INVALID_ARGS;
+        return NO_ERROR;
+    }
+
+    switch (sqe->opcode) {
+    case MX_IORING_OP_NOP: {
+        cqe->status = NO_ERROR;
+        break;
+    }
+    case MX_IORING_OP_CHANNEL_WRITE: {
+        if (sqe->length > UINT32_MAX) {
+            cqe->status = ERR_OUT_OF_RANGE;
+            break;
+        }
+        mxtl::RefPtr<ChannelDispatcher> channel;
+        status = up->GetDispatcherWithRights(sqe->handle, MX_RIGHT_WRITE, &channel);
+        if (status != NO_ERROR) {
+            cqe->status = status;
+            break;
+        }
+        uint32_t num_bytes = static_cast<uint32_t>(sqe->length);
+        mxtl::unique_ptr<MessagePacket> msg;
+        status = MessagePacket::Create(num_bytes, 0u, &msg);
+        if (status != NO_ERROR) {
+            cqe->status = status;
+            break;
+        }
+        if (num_bytes > 0u) {
+            auto bytes = make_user_ptr(
+                reinterpret_cast<const void*>(static_cast<uintptr_t>(sqe->buffer)));
+            if (bytes.copy_array_from_user(msg->mutable_data(), num_bytes) != NO_ERROR) {
+                cqe->status = ERR_INVALID_ARGS;
+                break;
+            }
+        }
+        status = channel->Write(mxtl::move(msg));
+        if (status == NO_ERROR)
+            cqe->actual = num_bytes;
+        cqe->status = status;
+        break;
+    }
+    case MX_IORING_OP_SOCKET_WRITE: {
+        mxtl::RefPtr<SocketDispatcher> socket;
+        status = up->GetDispatcherWithRights(sqe->handle, MX_RIGHT_WRITE, &socket);
+        if (status != NO_ERROR) {
+            cqe->status = status;
+            break;
+        }
+        auto data = make_user_ptr(
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(sqe->buffer)));
+        size_t written = 0u;
+        status = socket->Write(data, sqe->length, &written);
+        if (status == NO_ERROR)
+            cqe->actual = static_cast<uint32_t>(written);
+        cqe->status = status;
+        break;
+    }
+    case MX_IORING_OP_VMO_READ: {
+        mxtl::RefPtr<VmObjectDispatcher> vmo;
+        status = up->GetDispatcherWithRights(sqe->handle, MX_RIGHT_READ, &vmo);
+        if (status != NO_ERROR) {
+            cqe->status = status;
+            break;
+        }
+        auto data = make_user_ptr(
+            reinterpret_cast<void*>(static_cast<uintptr_t>(sqe->buffer)));
+        size_t bytes_read = 0u;
+        status = vmo->Read(data, sqe->length, sqe->offset, &bytes_read);
+        if (status == NO_ERROR)
+            cqe->actual = static_cast<uint32_t>(bytes_read);
+        cqe->status = status;
+        break;
+    }
+    case MX_IORING_OP_VMO_WRITE: {
+        mxtl::RefPtr<VmObjectDispatcher> vmo;
+        status = up->GetDispatcherWithRights(sqe->handle, MX_RIGHT_WRITE, &vmo);
+        if (status != NO_ERROR) {
+            cqe->status = status;
+            break;
+        }
+        auto data = make_user_ptr(
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(sqe->buffer)));
+        size_t bytes_written = 0u;
+        status = vmo->Write(data, sqe->length, sqe->offset, &bytes_written);
+        if (status == NO_ERROR)
+            cqe->actual = static_cast<uint32_t>(bytes_written);
+        cqe->status = status;
+        break;
+    }
+    default:
+        cqe->status = ERR_NOT_SUPPORTED;
+        break;
+    }
+
+    return NO_ERROR;
+}
+
+mx_status_t sys_ioring_submit(mx_handle_t handle, uint32_t options,
+                              user_ptr<uint32_t> _num_completed) {
+    LTRACEF("handle %d options 0x%x\n", handle, options);
+
+    if (options)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<IoRingDispatcher> ioring;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_WRITE, &ioring);
+    if (status != NO_ERROR)
+        return status;
+
+    uint32_t num_completed = 0u;
+    status = ioring->Submit(&ioring_do_op, up, &num_completed);
+    if (status != NO_ERROR)
+        return status;
+
+    if (_num_completed.copy_to_user(num_completed) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    return NO_ERROR;
+}
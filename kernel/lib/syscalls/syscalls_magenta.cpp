@@ -25,6 +25,7 @@
 #include <magenta/handle_owner.h>
 #include <magenta/log_dispatcher.h>
 #include <magenta/magenta.h>
+#include <magenta/memory_pressure.h>
 #include <magenta/process_dispatcher.h>
 #include <magenta/syscalls/log.h>
 #include <magenta/syscalls/policy.h>
@@ -34,6 +35,7 @@
 
 #include <mxalloc/new.h>
 #include <mxtl/atomic.h>
+#include <mxtl/inline_array.h>
 #include <mxtl/ref_ptr.h>
 
 #include "syscalls_priv.h"
@@ -45,6 +47,10 @@ constexpr size_t kMaxCPRNGSeed = MX_CPRNG_ADD_ENTROPY_MAX_LEN;
 
 constexpr uint32_t kMaxWaitSetWaitResults = 1024u;
 
+// Covers the common select-style loops without heap allocation; larger
+// result arrays fall back to the heap.
+constexpr size_t kWaitSetWaitInlineCount = 8u;
+
 mx_status_t sys_nanosleep(mx_time_t deadline) {
     LTRACEF("nseconds %" PRIu64 "\n", deadline);
 
@@ -123,6 +129,28 @@ mx_status_t sys_event_create(uint32_t options, user_ptr<mx_handle_t> _out) {
     return NO_ERROR;
 }
 
+mx_status_t sys_system_get_memory_pressure_event(uint32_t level, user_ptr<mx_handle_t> _out) {
+    LTRACEF("level %u\n", level);
+
+    mxtl::RefPtr<Dispatcher> dispatcher;
+    mx_rights_t rights;
+
+    status_t result = GetMemoryPressureEvent(level, &dispatcher, &rights);
+    if (result != NO_ERROR)
+        return result;
+
+    HandleOwner handle(MakeHandle(mxtl::move(dispatcher), rights));
+    if (!handle)
+        return ERR_NO_MEMORY;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    if (_out.copy_to_user(up->MapHandleToValue(handle)) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    up->AddHandle(mxtl::move(handle));
+    return NO_ERROR;
+}
+
 mx_status_t sys_eventpair_create(uint32_t options,
                                  user_ptr<mx_handle_t> _out0, user_ptr<mx_handle_t> _out1) {
     LTRACEF("entry out_handles %p,%p\n", _out0.get(), _out1.get());
@@ -229,9 +257,12 @@ mx_status_t sys_log_read(mx_handle_t log_handle, uint32_t len, user_ptr<void> _p
     if (status != NO_ERROR)
         return status;
 
-    char buf[DLOG_MAX_RECORD];
+    // read a batch of records per syscall; dlog_read packs as many whole
+    // records as fit, each one starting on a uint32_t boundary
+    char buf[DLOG_MAX_RECORD * 4];
+    size_t readlen = len < sizeof(buf) ? len : sizeof(buf);
     size_t actual;
-    if ((status = log->Read(options, buf, DLOG_MAX_RECORD, &actual)) < 0)
+    if ((status = log->Read(options, buf, readlen, &actual)) < 0)
         return status;
 
     if (_ptr.copy_array_to_user(buf, actual) != NO_ERROR)
@@ -246,9 +277,8 @@ mx_status_t sys_cprng_draw(user_ptr<void> _buffer, size_t len, user_ptr<size_t>
 
     uint8_t kernel_buf[kMaxCPRNGDraw];
 
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    ASSERT(prng->is_thread_safe());
-    prng->Draw(kernel_buf, static_cast<int>(len));
+    // served by the calling cpu's PRNG instance; no shared lock taken
+    crypto::GlobalPRNG::Draw(kernel_buf, len);
 
     if (_buffer.copy_array_to_user(kernel_buf, len) != NO_ERROR)
         return ERR_INVALID_ARGS;
@@ -361,19 +391,15 @@ mx_status_t sys_waitset_wait(mx_handle_t ws_handle,
     if (_count.copy_from_user(&count) != NO_ERROR)
         return ERR_INVALID_ARGS;
 
-    //TODO: use inline array here
-    mxtl::unique_ptr<mx_waitset_result_t[]> results;
-    if (count > 0u) {
-        if (count > kMaxWaitSetWaitResults)
-            return ERR_OUT_OF_RANGE;
-
-        // TODO(vtl): It kind of sucks that we always have to allocate the indicated maximum size
-        // here (namely, |count|).
-        AllocChecker ac;
-        results.reset(new (&ac) mx_waitset_result_t[count]);
-        if (!ac.check())
-            return ERR_NO_MEMORY;
-    }
+    if (count > kMaxWaitSetWaitResults)
+        return ERR_OUT_OF_RANGE;
+
+    // TODO(vtl): It kind of sucks that we always have to allocate the indicated maximum size
+    // here (namely, |count|).
+    AllocChecker ac;
+    mxtl::InlineArray<mx_waitset_result_t, kWaitSetWaitInlineCount> results(&ac, count);
+    if (!ac.check())
+        return ERR_NO_MEMORY;
 
     auto up = ProcessDispatcher::GetCurrent();
 
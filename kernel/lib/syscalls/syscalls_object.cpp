@@ -12,7 +12,9 @@
 #include <kernel/stats.h>
 #include <platform.h>
 
+#include <magenta/fifo_dispatcher.h>
 #include <magenta/handle_owner.h>
+#include <magenta/interrupt_dispatcher.h>
 #include <magenta/job_dispatcher.h>
 #include <magenta/magenta.h>
 #include <magenta/process_dispatcher.h>
@@ -72,6 +74,50 @@ private:
     size_t count_ = 0;
     size_t avail_ = 0;
 };
+
+// Gathers koid, parent koid, type and name for every job and process
+// below a job, so tools like ps can snapshot the whole task tree with
+// one syscall instead of a get_info/get_child/get_property sequence
+// per object.
+class JobTreeEnumerator final : public JobEnumerator {
+public:
+    JobTreeEnumerator(user_ptr<mx_info_job_tree_entry_t> ptr, size_t max)
+        : ptr_(ptr), max_(max) {}
+
+    size_t get_avail() const { return avail_; }
+    size_t get_count() const { return count_; }
+
+private:
+    bool OnJob(JobDispatcher* job) override {
+        return RecordEntry(job, MX_OBJ_TYPE_JOB);
+    }
+
+    bool OnProcess(ProcessDispatcher* proc) override {
+        return RecordEntry(proc, MX_OBJ_TYPE_PROCESS);
+    }
+
+    bool RecordEntry(Dispatcher* task, uint32_t type) {
+        avail_++;
+        if (count_ < max_) {
+            mx_info_job_tree_entry_t entry = {};
+            entry.koid = task->get_koid();
+            entry.parent_koid = task->get_related_koid();
+            entry.type = type;
+            task->get_name(entry.name);
+            if (ptr_.copy_array_to_user(&entry, 1, count_) != NO_ERROR) {
+                return false;
+            }
+            count_++;
+        }
+        return true;
+    }
+
+    const user_ptr<mx_info_job_tree_entry_t> ptr_;
+    const size_t max_;
+
+    size_t count_ = 0;
+    size_t avail_ = 0;
+};
 } // namespace
 
 // actual is an optional return parameter for the number of records returned
@@ -214,6 +260,27 @@ mx_status_t sys_object_get_info(mx_handle_t handle, uint32_t topic,
                 return ERR_INVALID_ARGS;
             return NO_ERROR;
         }
+        case MX_INFO_JOB_TREE: {
+            mxtl::RefPtr<JobDispatcher> job;
+            auto error = up->GetDispatcherWithRights(handle, MX_RIGHT_ENUMERATE, &job);
+            if (error < 0)
+                return error;
+
+            size_t max = buffer_size / sizeof(mx_info_job_tree_entry_t);
+            auto entries = _buffer.reinterpret<mx_info_job_tree_entry_t>();
+            JobTreeEnumerator jte(entries, max);
+
+            if (!job->EnumerateChildren(&jte, /* recurse */ true)) {
+                // Either the walk couldn't snapshot a child list or
+                // the enumerator couldn't write to the user pointer.
+                return ERR_INVALID_ARGS;
+            }
+            if (_actual && (_actual.copy_to_user(jte.get_count()) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            if (_avail && (_avail.copy_to_user(jte.get_avail()) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            return NO_ERROR;
+        }
         case MX_INFO_RESOURCE_CHILDREN:
         case MX_INFO_RESOURCE_RECORDS: {
             mxtl::RefPtr<ResourceDispatcher> resource;
@@ -481,6 +548,35 @@ mx_status_t sys_object_get_info(mx_handle_t handle, uint32_t topic,
                 return ERR_INVALID_ARGS;
             return NO_ERROR;
         }
+        case MX_INFO_IRQ_STATS: {
+            size_t actual = (buffer_size < sizeof(mx_info_irq_stats_t)) ? 0 : 1;
+            size_t avail = 1;
+
+            // grab a reference to the dispatcher
+            mxtl::RefPtr<InterruptDispatcher> interrupt;
+            auto error = up->GetDispatcherWithRights(handle, MX_RIGHT_READ, &interrupt);
+            if (error < 0)
+                return error;
+
+            if (actual > 0) {
+                // build the info structure
+                mx_info_irq_stats_t info = {};
+
+                auto err = interrupt->GetStats(&info);
+                if (err != NO_ERROR)
+                    return err;
+
+                if (_buffer.copy_array_to_user(&info, sizeof(info)) != NO_ERROR)
+                    return ERR_INVALID_ARGS;
+            }
+            if (_actual && (_actual.copy_to_user(actual) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            if (_avail && (_avail.copy_to_user(avail) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            if (actual == 0)
+                return ERR_BUFFER_TOO_SMALL;
+            return NO_ERROR;
+        }
         default:
             return ERR_NOT_SUPPORTED;
     }
@@ -547,6 +643,24 @@ mx_status_t sys_object_get_property(mx_handle_t handle_value, uint32_t property,
             uint32_t value = job->max_height();
             return _value.reinterpret<uint32_t>().copy_to_user(value);
         }
+        case MX_PROP_THREAD_CPU_AFFINITY: {
+            if (size < sizeof(uint32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return ERR_WRONG_TYPE;
+            uint32_t value = thread->thread()->cpu_affinity();
+            return _value.reinterpret<uint32_t>().copy_to_user(value);
+        }
+        case MX_PROP_FIFO_READ_THRESHOLD: {
+            if (size < sizeof(uint32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto fifo = DownCastDispatcher<FifoDispatcher>(&dispatcher);
+            if (!fifo)
+                return ERR_WRONG_TYPE;
+            uint32_t value = fifo->ReadThreshold();
+            return _value.reinterpret<uint32_t>().copy_to_user(value);
+        }
         default:
             return ERR_INVALID_ARGS;
     }
@@ -611,6 +725,28 @@ mx_status_t sys_object_set_property(mx_handle_t handle_value, uint32_t property,
                 return ERR_INVALID_ARGS;
             return process->set_debug_addr(value);
         }
+        case MX_PROP_THREAD_CPU_AFFINITY: {
+            if (size < sizeof(uint32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return ERR_WRONG_TYPE;
+            uint32_t affinity;
+            if (_value.reinterpret<const uint32_t>().copy_from_user(&affinity) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            return thread->thread()->SetCpuAffinity(affinity);
+        }
+        case MX_PROP_FIFO_READ_THRESHOLD: {
+            if (size < sizeof(uint32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto fifo = DownCastDispatcher<FifoDispatcher>(&dispatcher);
+            if (!fifo)
+                return ERR_WRONG_TYPE;
+            uint32_t count;
+            if (_value.reinterpret<const uint32_t>().copy_from_user(&count) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            return fifo->SetReadThreshold(count);
+        }
     }
 
     return ERR_INVALID_ARGS;
@@ -123,6 +123,39 @@ mx_status_t sys_port_wait2(mx_handle_t handle, mx_time_t deadline, user_ptr<void
     return NO_ERROR;
 }
 
+mx_status_t sys_port_wait_many(mx_handle_t handle, mx_time_t deadline,
+                               user_ptr<mx_port_packet_t> _packets, size_t count,
+                               user_ptr<size_t> _actual) {
+    LTRACEF("handle %d\n", handle);
+
+    if (!_packets || !_actual || (count == 0u))
+        return ERR_INVALID_ARGS;
+
+    // Dequeue "up to |count|" packets, so a larger buffer than the batch
+    // limit is not an error; it just gets drained in batch-sized bites.
+    if (count > PortDispatcherV2::kMaxDeQueueBatch)
+        count = PortDispatcherV2::kMaxDeQueueBatch;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<PortDispatcherV2> port;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_WRITE, &port);
+    if (status != NO_ERROR)
+        return status;
+
+    mx_port_packet_t pp[PortDispatcherV2::kMaxDeQueueBatch];
+    size_t actual = 0u;
+    mx_status_t st = port->DeQueueMany(deadline, pp, count, &actual);
+    if (st != NO_ERROR)
+        return st;
+
+    if (_packets.copy_array_to_user(pp, actual) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    if (_actual.copy_to_user(actual) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    return NO_ERROR;
+}
+
 mx_status_t sys_port_wait(mx_handle_t handle, mx_time_t deadline,
                           user_ptr<void> _packet, size_t size) {
     LTRACEF("handle %d\n", handle);
@@ -19,7 +19,9 @@
 #include <magenta/handle_owner.h>
 #include <magenta/process_dispatcher.h>
 #include <magenta/socket_dispatcher.h>
+#include <magenta/magenta.h>
 #include <magenta/syscalls/policy.h>
+#include <magenta/vm_object_dispatcher.h>
 
 #include <mxtl/ref_ptr.h>
 
@@ -30,7 +32,11 @@
 mx_status_t sys_socket_create(uint32_t options, user_ptr<mx_handle_t> _out0, user_ptr<mx_handle_t> _out1) {
     LTRACEF("entry out_handles %p, %p\n", _out0.get(), _out1.get());
 
-    if (options != 0u)
+    if (options & ~(MX_SOCKET_MAPPED | MX_SOCKET_DATAGRAM))
+        return ERR_INVALID_ARGS;
+
+    // The ring transport is a byte stream; it has no datagram framing.
+    if ((options & MX_SOCKET_MAPPED) && (options & MX_SOCKET_DATAGRAM))
         return ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -104,10 +110,10 @@ mx_status_t sys_socket_read(mx_handle_t handle, uint32_t options,
                             user_ptr<size_t> _actual) {
     LTRACEF("handle %d\n", handle);
 
-    if (options)
+    if (options & ~MX_SOCKET_CONSUME)
         return ERR_INVALID_ARGS;
 
-    if (!_buffer && size > 0)
+    if (!_buffer && size > 0 && !(options & MX_SOCKET_CONSUME))
         return ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -117,6 +123,16 @@ mx_status_t sys_socket_read(mx_handle_t handle, uint32_t options,
     if (status != NO_ERROR)
         return status;
 
+    if (options & MX_SOCKET_CONSUME) {
+        // The consumer read the payload through its mapping of the ring;
+        // just retire |size| bytes.
+        size_t consumed;
+        status = socket->Consume(size, &consumed);
+        if (status == NO_ERROR && _actual)
+            status = _actual.copy_to_user(consumed);
+        return status;
+    }
+
     size_t nread;
     status = socket->Read(_buffer, size, &nread);
 
@@ -126,3 +142,118 @@ mx_status_t sys_socket_read(mx_handle_t handle, uint32_t options,
 
     return status;
 }
+
+mx_status_t sys_socket_write_batch(mx_handle_t handle, uint32_t options,
+                                   user_ptr<const mx_iovec_t> _msgs, uint32_t count,
+                                   user_ptr<size_t> _actual) {
+    LTRACEF("handle %d count %u\n", handle, count);
+
+    if (options)
+        return ERR_INVALID_ARGS;
+
+    if (count == 0u || count > MX_SOCKET_MAX_BATCH)
+        return ERR_OUT_OF_RANGE;
+
+    mx_iovec_t msgs[MX_SOCKET_MAX_BATCH];
+    if (_msgs.copy_array_from_user(msgs, count) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<SocketDispatcher> socket;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_WRITE, &socket);
+    if (status != NO_ERROR)
+        return status;
+
+    size_t nwritten;
+    status = socket->WriteBatch(msgs, count, &nwritten);
+
+    // Caller may ignore results if desired.
+    if (status == NO_ERROR && _actual)
+        status = _actual.copy_to_user(nwritten);
+
+    return status;
+}
+
+mx_status_t sys_socket_read_batch(mx_handle_t handle, uint32_t options,
+                                  user_ptr<const mx_iovec_t> _msgs, uint32_t count,
+                                  user_ptr<size_t> _actuals,
+                                  user_ptr<size_t> _actual) {
+    LTRACEF("handle %d count %u\n", handle, count);
+
+    if (options)
+        return ERR_INVALID_ARGS;
+
+    if (count == 0u || count > MX_SOCKET_MAX_BATCH)
+        return ERR_OUT_OF_RANGE;
+
+    if (!_actuals)
+        return ERR_INVALID_ARGS;
+
+    mx_iovec_t msgs[MX_SOCKET_MAX_BATCH];
+    if (_msgs.copy_array_from_user(msgs, count) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<SocketDispatcher> socket;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_READ, &socket);
+    if (status != NO_ERROR)
+        return status;
+
+    size_t actuals[MX_SOCKET_MAX_BATCH];
+    size_t nread;
+    status = socket->ReadBatch(msgs, count, actuals, &nread);
+    if (status != NO_ERROR)
+        return status;
+
+    if (_actuals.copy_array_to_user(actuals, nread) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    // Caller may ignore results if desired.
+    if (_actual)
+        status = _actual.copy_to_user(nread);
+
+    return status;
+}
+
+mx_status_t sys_socket_get_buffer(mx_handle_t handle, uint32_t options,
+                                  user_ptr<mx_handle_t> _out) {
+    LTRACEF("handle %d\n", handle);
+
+    if (options)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<SocketDispatcher> socket;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_READ, &socket);
+    if (status != NO_ERROR)
+        return status;
+
+    mxtl::RefPtr<VmObject> ring;
+    status = socket->GetMappedBuffer(&ring);
+    if (status != NO_ERROR)
+        return status;
+
+    mxtl::RefPtr<Dispatcher> dispatcher;
+    mx_rights_t default_rights;
+    status = VmObjectDispatcher::Create(mxtl::move(ring), &dispatcher, &default_rights);
+    if (status != NO_ERROR)
+        return status;
+
+    // The kernel fills the ring on behalf of the peer; the mapping
+    // endpoint only ever reads it.
+    mx_rights_t rights = MX_RIGHT_READ | MX_RIGHT_MAP | MX_RIGHT_DUPLICATE |
+                         MX_RIGHT_TRANSFER | MX_RIGHT_GET_PROPERTY;
+
+    HandleOwner vmo_handle(MakeHandle(mxtl::move(dispatcher), rights));
+    if (!vmo_handle)
+        return ERR_NO_MEMORY;
+
+    if (_out.copy_to_user(up->MapHandleToValue(vmo_handle)) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    up->AddHandle(mxtl::move(vmo_handle));
+    return NO_ERROR;
+}
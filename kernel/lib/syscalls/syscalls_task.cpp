@@ -197,6 +197,21 @@ mx_status_t sys_thread_write_state(mx_handle_t handle, uint32_t state_kind,
     return status;
 }
 
+mx_status_t sys_thread_set_deadline(mx_handle_t handle, mx_duration_t capacity,
+                                    mx_duration_t period) {
+    LTRACEF("handle %d, capacity %" PRIu64 ", period %" PRIu64 "\n",
+            handle, capacity, period);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<ThreadDispatcher> thread;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_WRITE, &thread);
+    if (status != NO_ERROR)
+        return status;
+
+    return thread->thread()->SetDeadline(capacity, period);
+}
+
 mx_status_t sys_task_suspend(mx_handle_t task_handle) {
     LTRACE_ENTRY;
 
@@ -28,6 +28,10 @@
 
 #define LOCAL_TRACE 0
 
+// cap on the number of entries accepted by sys_vmar_map_batch; large enough
+// for a loader's worth of segments while keeping the arrays on the stack
+static constexpr uint32_t kMaxVmarMapBatch = 16;
+
 mx_status_t sys_vmar_allocate(mx_handle_t parent_vmar_handle,
                     size_t offset, size_t size, uint32_t map_flags,
                     user_ptr<mx_handle_t> _child_vmar, user_ptr<uintptr_t> _child_addr) {
@@ -91,22 +95,18 @@ mx_status_t sys_vmar_destroy(mx_handle_t vmar_handle) {
     return vmar->Destroy();
 }
 
-mx_status_t sys_vmar_map(mx_handle_t vmar_handle, size_t vmar_offset,
-                    mx_handle_t vmo_handle, uint64_t vmo_offset, size_t len, uint32_t map_flags,
-                    user_ptr<uintptr_t> _mapped_addr) {
-    auto up = ProcessDispatcher::GetCurrent();
-
-    // lookup the VMAR dispatcher from handle
-    mxtl::RefPtr<VmAddressRegionDispatcher> vmar;
-    mx_rights_t vmar_rights;
-    mx_status_t status = up->GetDispatcherAndRights(vmar_handle, &vmar, &vmar_rights);
-    if (status != NO_ERROR)
-        return status;
-
+// Establish one mapping; the shared guts of sys_vmar_map and
+// sys_vmar_map_batch.  On success the caller owns the returned mapping and
+// is responsible for destroying it if the rest of its work fails.
+static mx_status_t vmar_map_common(ProcessDispatcher* up,
+                                   const mxtl::RefPtr<VmAddressRegionDispatcher>& vmar,
+                                   mx_rights_t vmar_rights, size_t vmar_offset,
+                                   mx_handle_t vmo_handle, uint64_t vmo_offset, size_t len,
+                                   uint32_t map_flags, mxtl::RefPtr<VmMapping>* out_mapping) {
     // lookup the VMO dispatcher from handle
     mxtl::RefPtr<VmObjectDispatcher> vmo;
     mx_rights_t vmo_rights;
-    status = up->GetDispatcherAndRights(vmo_handle, &vmo, &vmo_rights);
+    mx_status_t status = up->GetDispatcherAndRights(vmo_handle, &vmo, &vmo_rights);
     if (status != NO_ERROR)
         return status;
 
@@ -123,6 +123,12 @@ mx_status_t sys_vmar_map(mx_handle_t vmar_handle, size_t vmar_offset,
         map_flags &= ~MX_VM_FLAG_MAP_RANGE;
     }
 
+    bool do_populate = false;
+    if (map_flags & MX_VM_FLAG_POPULATE) {
+        do_populate = true;
+        map_flags &= ~MX_VM_FLAG_POPULATE;
+    }
+
     // Usermode is not allowed to specify these flags on mappings, though we may
     // set them below.
     if (map_flags & (MX_VM_FLAG_CAN_MAP_READ | MX_VM_FLAG_CAN_MAP_WRITE | MX_VM_FLAG_CAN_MAP_EXECUTE)) {
@@ -142,6 +148,10 @@ mx_status_t sys_vmar_map(mx_handle_t vmar_handle, size_t vmar_offset,
     if ((map_flags & MX_VM_FLAG_PERM_EXECUTE) && !can_exec)
         return ERR_ACCESS_DENIED;
 
+    // Populating commits pages, which needs write access to the VMO.
+    if (do_populate && !(vmo_rights & MX_RIGHT_WRITE))
+        return ERR_ACCESS_DENIED;
+
     // If a permission is allowed by both the VMO and the VMAR, add it to the
     // flags for the new mapping, so that the VMO's rights as of now can be used
     // to constrain future permission changes via Protect().
@@ -162,6 +172,18 @@ mx_status_t sys_vmar_map(mx_handle_t vmar_handle, size_t vmar_offset,
         vm_mapping->Destroy();
     });
 
+    if (do_populate) {
+        // Commit the whole range through the VMO in one pass, so the pages are
+        // allocated in bulk rather than one soft fault at a time, then let
+        // MapRange below wire them up in physically contiguous runs.
+        uint64_t committed;
+        status = vmo->vmo()->CommitRange(vmo_offset, len, &committed);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        do_map_range = true;
+    }
+
     if (do_map_range) {
         status = vm_mapping->MapRange(vmo_offset, len, false);
         if (status != NO_ERROR) {
@@ -169,7 +191,77 @@ mx_status_t sys_vmar_map(mx_handle_t vmar_handle, size_t vmar_offset,
         }
     }
 
-    if (_mapped_addr.copy_to_user(vm_mapping->base()) != NO_ERROR)
+    cleanup_handler.cancel();
+    *out_mapping = mxtl::move(vm_mapping);
+    return NO_ERROR;
+}
+
+mx_status_t sys_vmar_map(mx_handle_t vmar_handle, size_t vmar_offset,
+                    mx_handle_t vmo_handle, uint64_t vmo_offset, size_t len, uint32_t map_flags,
+                    user_ptr<uintptr_t> _mapped_addr) {
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the VMAR dispatcher from handle
+    mxtl::RefPtr<VmAddressRegionDispatcher> vmar;
+    mx_rights_t vmar_rights;
+    mx_status_t status = up->GetDispatcherAndRights(vmar_handle, &vmar, &vmar_rights);
+    if (status != NO_ERROR)
+        return status;
+
+    mxtl::RefPtr<VmMapping> vm_mapping;
+    status = vmar_map_common(up, vmar, vmar_rights, vmar_offset, vmo_handle, vmo_offset,
+                             len, map_flags, &vm_mapping);
+    if (status != NO_ERROR)
+        return status;
+
+    if (_mapped_addr.copy_to_user(vm_mapping->base()) != NO_ERROR) {
+        vm_mapping->Destroy();
+        return ERR_INVALID_ARGS;
+    }
+
+    return NO_ERROR;
+}
+
+mx_status_t sys_vmar_map_batch(mx_handle_t vmar_handle, user_ptr<const mx_vmar_map_entry_t> _entries,
+                               uint32_t count, user_ptr<uintptr_t> _mapped_addrs) {
+    if (count == 0 || count > kMaxVmarMapBatch)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the VMAR dispatcher from handle
+    mxtl::RefPtr<VmAddressRegionDispatcher> vmar;
+    mx_rights_t vmar_rights;
+    mx_status_t status = up->GetDispatcherAndRights(vmar_handle, &vmar, &vmar_rights);
+    if (status != NO_ERROR)
+        return status;
+
+    mx_vmar_map_entry_t entries[kMaxVmarMapBatch];
+    if (_entries.copy_array_from_user(entries, count) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    // The batch is all-or-nothing: if any entry fails, every mapping made so
+    // far is torn down again.
+    mxtl::RefPtr<VmMapping> mappings[kMaxVmarMapBatch];
+    uintptr_t mapped_addrs[kMaxVmarMapBatch];
+
+    auto cleanup_handler = mxtl::MakeAutoCall([&mappings, count]() {
+        for (uint32_t i = 0; i < count; i++) {
+            if (mappings[i])
+                mappings[i]->Destroy();
+        }
+    });
+
+    for (uint32_t i = 0; i < count; i++) {
+        status = vmar_map_common(up, vmar, vmar_rights, entries[i].vmar_offset,
+                                 entries[i].vmo, entries[i].vmo_offset, entries[i].len,
+                                 entries[i].map_flags, &mappings[i]);
+        if (status != NO_ERROR)
+            return status;
+        mapped_addrs[i] = mappings[i]->base();
+    }
+
+    if (_mapped_addrs.copy_array_to_user(mapped_addrs, count) != NO_ERROR)
         return ERR_INVALID_ARGS;
 
     cleanup_handler.cancel();
@@ -203,6 +203,38 @@ mx_status_t sys_vmo_op_range(mx_handle_t handle, uint32_t op, uint64_t offset, u
     return vmo->RangeOp(op, offset, size, _buffer, buffer_size);
 }
 
+mx_status_t sys_vmo_transfer(mx_handle_t handle, uint64_t offset, uint64_t length,
+                             mx_handle_t dest, uint64_t dest_offset,
+                             user_ptr<uint64_t> _actual) {
+    LTRACEF("handle %d offset %#" PRIx64 " length %#" PRIx64
+            " dest %d dest_offset %#" PRIx64 "\n",
+            handle, offset, length, dest, dest_offset);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // the source loses its pages and their contents become readable
+    // through the destination, so moving them needs both rights
+    mxtl::RefPtr<VmObjectDispatcher> src_vmo;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_READ | MX_RIGHT_WRITE,
+                                                     &src_vmo);
+    if (status != NO_ERROR)
+        return status;
+
+    mxtl::RefPtr<VmObjectDispatcher> dest_vmo;
+    status = up->GetDispatcherWithRights(dest, MX_RIGHT_WRITE, &dest_vmo);
+    if (status != NO_ERROR)
+        return status;
+
+    uint64_t actual = 0;
+    status = src_vmo->Transfer(mxtl::move(dest_vmo), offset, dest_offset, length, &actual);
+
+    // Caller may ignore results if desired.
+    if (status == NO_ERROR && _actual)
+        status = _actual.copy_to_user(actual);
+
+    return status;
+}
+
 mx_status_t sys_vmo_set_cache_policy(mx_handle_t handle, uint32_t cache_policy) {
     mxtl::RefPtr<VmObjectDispatcher> vmo;
     mx_status_t status = NO_ERROR;
@@ -13,7 +13,9 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/userboot.cpp \
     $(LOCAL_DIR)/userboot-image.S \
 
-MODULE_DEPS := kernel/lib/vdso
+MODULE_DEPS := \
+    kernel/lib/counters \
+    kernel/lib/vdso
 
 userboot-filename := $(BUILDDIR)/system/core/userboot/libuserboot.so
 
@@ -18,6 +18,7 @@
 #include <kernel/vm/vm_object_paged.h>
 
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lib/vdso.h>
 #include <lk/init.h>
 
@@ -176,6 +177,7 @@ enum bootstrap_handle_index {
     BOOTSTRAP_VDSO,
     BOOTSTRAP_VDSO_LAST_VARIANT = BOOTSTRAP_VDSO + VDso::variants() - 1,
     BOOTSTRAP_RAMDISK,
+    BOOTSTRAP_KCOUNTERS,
     BOOTSTRAP_RESOURCE_ROOT,
     BOOTSTRAP_STACK,
     BOOTSTRAP_PROC,
@@ -218,6 +220,9 @@ static mxtl::unique_ptr<MessagePacket> prepare_bootstrap_message() {
         case BOOTSTRAP_RAMDISK:
             info = PA_HND(PA_VMO_BOOTDATA, 0);
             break;
+        case BOOTSTRAP_KCOUNTERS:
+            info = PA_HND(PA_VMO_KCOUNTERS, 0);
+            break;
         case BOOTSTRAP_RESOURCE_ROOT:
             info = PA_HND(PA_RESOURCE, 0);
             break;
@@ -270,6 +275,9 @@ static int attempt_userboot() {
     if (status == NO_ERROR)
         status = get_vmo_handle(stack_vmo, false, &stack_vmo_dispatcher,
                                 &handles[BOOTSTRAP_STACK]);
+    if (status == NO_ERROR)
+        status = get_vmo_handle(kcounters_get_vmo(), true, nullptr,
+                                &handles[BOOTSTRAP_KCOUNTERS]);
     if (status == NO_ERROR)
         status = get_resource_handle(&handles[BOOTSTRAP_RESOURCE_ROOT]);
 
@@ -11,7 +11,7 @@
 // environments.  It must use only the basic types so that struct
 // layouts match exactly in both contexts.
 
-#define VDSO_CONSTANTS_SIZE (2 * 4 + 2 * 8)
+#define VDSO_CONSTANTS_SIZE (6 * 4 + 2 * 8)
 #define VDSO_CONSTANTS_ALIGN 8
 
 #ifndef ASSEMBLY
@@ -31,6 +31,15 @@ struct vdso_constants {
     // Number of bytes in a data cache line.
     uint32_t dcache_line_size;
 
+    // Fixed point factor converting raw hardware ticks to monotonic
+    // nanoseconds, in the kernel's fp_32_64 word layout {l0, l32, l64}
+    // (see lib/fixed_point.h).  All zero when the monotonic clock cannot
+    // be computed from usermode and mx_time_get must enter the kernel.
+    uint32_t ticks_to_mono_ratio[3];
+
+    // Explicit padding so the layout is the same in both contexts.
+    uint32_t padding1;
+
     // Conversion factor for mx_ticks_get return values to seconds.
     uint64_t ticks_per_second;
 
@@ -7,6 +7,7 @@
 #include <lib/vdso.h>
 #include <lib/vdso-constants.h>
 
+#include <arch/ops.h>
 #include <kernel/cmdline.h>
 #include <kernel/vm.h>
 #include <kernel/vm/pmm.h>
@@ -220,6 +221,11 @@ const VDso* VDso::Create() {
         "vDSO constants", vdso->vmo()->vmo(), VDSO_DATA_CONSTANTS);
     uint64_t per_second = ticks_per_second();
 
+    // Ask the platform whether usermode can compute the monotonic clock
+    // from the raw tick counter itself; the ratio stays zero when not.
+    uint32_t ticks_to_mono_ratio[3] = {};
+    bool usermode_mono = platform_usermode_get_mono_ratio(ticks_to_mono_ratio);
+
     // Initialize the constants that should be visible to the vDSO.
     // Rather than assigning each member individually, do this with
     // struct assignment and a compound literal so that the compiler
@@ -227,6 +233,8 @@ const VDso* VDso::Create() {
     *constants_window.data() = (vdso_constants) {
         arch_max_num_cpus(),
         arch_dcache_line_size(),
+        { ticks_to_mono_ratio[0], ticks_to_mono_ratio[1], ticks_to_mono_ratio[2] },
+        0,
         per_second,
         pmm_count_total_bytes(),
     };
@@ -237,11 +245,35 @@ const VDso* VDso::Create() {
         // Make mx_ticks_per_second return nanoseconds per second.
         constants_window.data()->ticks_per_second = MX_SEC(1);
 
+        // The hardware counter is unusable, so the monotonic clock cannot
+        // be computed from it either.
+        constants_window.data()->ticks_to_mono_ratio[0] = 0;
+        constants_window.data()->ticks_to_mono_ratio[1] = 0;
+        constants_window.data()->ticks_to_mono_ratio[2] = 0;
+        usermode_mono = false;
+
         // Adjust the mx_ticks_get entry point to be soft_ticks_get.
         VDsoDynSymWindow dynsym_window(vdso->vmo()->vmo());
         REDIRECT_SYSCALL(dynsym_window, mx_ticks_get, soft_ticks_get);
     }
 
+    // When usermode can read the same counter the monotonic clock is built
+    // from, route mx_time_get through the in-vDSO implementation so
+    // MX_CLOCK_MONOTONIC reads never enter the kernel.
+    if (usermode_mono) {
+        VDsoDynSymWindow dynsym_window(vdso->vmo()->vmo());
+        REDIRECT_SYSCALL(dynsym_window, mx_time_get, time_get_via_ticks);
+    }
+
+    // When the hardware gives usermode no way to read the current cpu
+    // number (x86 without rdtscp), make mx_system_get_cpu_num report
+    // cpu 0 rather than fault.
+    if (!arch_usermode_can_get_cpu_num()) {
+        VDsoDynSymWindow dynsym_window(vdso->vmo()->vmo());
+        REDIRECT_SYSCALL(dynsym_window, mx_system_get_cpu_num,
+                         soft_system_get_cpu_num);
+    }
+
     for (size_t v = static_cast<size_t>(Variant::FULL) + 1;
          v < static_cast<size_t>(Variant::COUNT);
          ++v)
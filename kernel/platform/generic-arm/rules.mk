@@ -22,7 +22,6 @@ ARCH := arm64
 ARM_CPU := cortex-a53
 
 MODULE_DEPS += \
-	kernel/lib/cbuf \
 	kernel/lib/mdi \
 	kernel/lib/memory_limit \
 	kernel/dev/bcm28xx \
@@ -39,3 +39,8 @@ __WEAK void *platform_get_ramdisk(size_t *size)
     *size = 0;
     return NULL;
 }
+
+__WEAK bool platform_usermode_get_mono_ratio(uint32_t ratio[3])
+{
+    return false;
+}
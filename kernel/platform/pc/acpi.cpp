@@ -15,6 +15,9 @@
 #include <lk/init.h>
 
 #include <arch/x86/apic.h>
+#include <arch/x86/mp.h>
+#include <kernel/numa.h>
+#include <kernel/vm/pmm.h>
 #include <platform/pc/acpi.h>
 
 #define LOCAL_TRACE 0
@@ -307,3 +310,94 @@ status_t platform_find_hpet(struct acpi_hpet_descriptor *hpet)
 
     return NO_ERROR;
 }
+
+/* Map a SRAT proximity domain to a dense node number, in order of first
+ * appearance.  Domains are sparse 32-bit values; any beyond what the
+ * kernel can track collapse to node 0. */
+static uint srat_domain_to_node(uint32_t domain)
+{
+    static uint32_t domains[NUMA_MAX_NODES];
+    static uint num_domains = 0;
+
+    for (uint i = 0; i < num_domains; ++i) {
+        if (domains[i] == domain) {
+            return i;
+        }
+    }
+    if (num_domains == NUMA_MAX_NODES) {
+        TRACEF("SRAT has more than %u proximity domains\n", NUMA_MAX_NODES);
+        return 0;
+    }
+    domains[num_domains] = domain;
+    return num_domains++;
+}
+
+/* @brief Record the NUMA topology described by the ACPI SRAT
+ *
+ * Tags the pmm arenas with the node their memory belongs to and registers
+ * each cpu's node in the kernel topology registry.  Must be called after
+ * x86_init_smp() so apic ids can be mapped to cpu numbers.  A no-op on
+ * machines with no SRAT.
+ */
+void platform_init_numa(void)
+{
+    ACPI_TABLE_HEADER *table = NULL;
+    ACPI_STATUS status = AcpiGetTable((char *)ACPI_SIG_SRAT, 1, &table);
+    if (status != AE_OK) {
+        return;
+    }
+
+    uintptr_t records_start = ((uintptr_t)table) + sizeof(ACPI_TABLE_SRAT);
+    uintptr_t records_end = ((uintptr_t)table) + table->Length;
+
+    uintptr_t addr;
+    ACPI_SUBTABLE_HEADER *record_hdr;
+    for (addr = records_start; addr < records_end; addr += record_hdr->Length) {
+        record_hdr = (ACPI_SUBTABLE_HEADER *)addr;
+        switch (record_hdr->Type) {
+            case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+                ACPI_SRAT_CPU_AFFINITY *cpu = (ACPI_SRAT_CPU_AFFINITY *)record_hdr;
+                if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED)) {
+                    break;
+                }
+                uint32_t domain = cpu->ProximityDomainLo |
+                        ((uint32_t)cpu->ProximityDomainHi[0] << 8) |
+                        ((uint32_t)cpu->ProximityDomainHi[1] << 16) |
+                        ((uint32_t)cpu->ProximityDomainHi[2] << 24);
+                int cpu_num = x86_apic_id_to_cpu_num(cpu->ApicId);
+                if (cpu_num < 0) {
+                    /* an apic id we chose not to bring up (smp.ht etc) */
+                    break;
+                }
+                numa_register_cpu((uint)cpu_num, srat_domain_to_node(domain));
+                break;
+            }
+            case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+                ACPI_SRAT_X2APIC_CPU_AFFINITY *cpu =
+                        (ACPI_SRAT_X2APIC_CPU_AFFINITY *)record_hdr;
+                if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED)) {
+                    break;
+                }
+                int cpu_num = x86_apic_id_to_cpu_num(cpu->ApicId);
+                if (cpu_num < 0) {
+                    break;
+                }
+                numa_register_cpu((uint)cpu_num,
+                                  srat_domain_to_node(cpu->ProximityDomain));
+                break;
+            }
+            case ACPI_SRAT_TYPE_MEMORY_AFFINITY: {
+                ACPI_SRAT_MEM_AFFINITY *mem = (ACPI_SRAT_MEM_AFFINITY *)record_hdr;
+                if (!(mem->Flags & ACPI_SRAT_MEM_ENABLED)) {
+                    break;
+                }
+                pmm_set_node(mem->BaseAddress, mem->Length,
+                             srat_domain_to_node(mem->ProximityDomain));
+                break;
+            }
+        }
+    }
+    if (addr != records_end) {
+        TRACEF("malformed SRAT\n");
+    }
+}
@@ -37,6 +37,7 @@ status_t platform_enumerate_interrupt_source_overrides(
         uint32_t len,
         uint32_t *num_isos);
 status_t platform_find_hpet(struct acpi_hpet_descriptor *hpet);
+void platform_init_numa(void);
 
 __END_CDECLS
 
@@ -16,8 +16,11 @@
 #include <arch/x86.h>
 #include <arch/x86/interrupts.h>
 #include <arch/x86/apic.h>
+#include <arch/x86/mp.h>
 #include <lk/init.h>
+#include <kernel/mp.h>
 #include <kernel/spinlock.h>
+#include <magenta/atomic.h>
 #include "platform_p.h"
 #include <platform/pc.h>
 #include <platform/pc/acpi.h>
@@ -288,6 +291,32 @@ void shutdown_interrupts(void) {
 }
 
 #ifdef WITH_DEV_PCIE
+/* Rotation counter used to spread MSI blocks across the online CPUs.  Without
+ * this, every block would target the local APIC of whichever CPU happened to
+ * be configuring devices (in practice, the boot CPU), and all device
+ * interrupts in the system would land on CPU 0. */
+static volatile int x86_msi_next_cpu;
+
+static uint32_t x86_msi_target_apic_id(void) {
+    mp_cpu_mask_t online = mp_get_online_mask();
+    uint online_count = (uint)__builtin_popcount(online);
+    if (online_count < 2)
+        return apic_local_id();
+
+    uint nth = (uint)atomic_add(&x86_msi_next_cpu, 1) % online_count;
+    uint cpu = 0;
+    while (true) {
+        if (online & (1u << cpu)) {
+            if (!nth)
+                break;
+            nth--;
+        }
+        cpu++;
+    }
+
+    return (cpu == 0) ? bp_percpu.apic_id : ap_percpus[cpu - 1].apic_id;
+}
+
 status_t x86_alloc_msi_block(uint requested_irqs,
                              bool can_target_64bit,
                              bool is_msix,
@@ -311,15 +340,17 @@ status_t x86_alloc_msi_block(uint requested_irqs,
         // See section 10.11.1 of the Intel 64 and IA-32 Architectures Software
         // Developer's Manual Volume 3A.
         //
-        // TODO(johngro) : don't just bind this block to the Local APIC of the
-        // processor which is active when calling alloc_msi_block.  Instead,
-        // there should either be a system policy (like, always send to any
-        // processor, or just processor 0, or something), or the decision of
-        // which CPUs to bind to should be left to the caller.
-        uint32_t tgt_addr = 0xFEE00000;                 // base addr
-        tgt_addr |= ((uint32_t)apic_local_id()) << 12;  // Dest ID == our local APIC ID
-        tgt_addr |= 0x08;                               // Redir hint == 1
-        tgt_addr &= ~0x04;                              // Dest Mode == Physical
+        // Successive blocks rotate round-robin through the online CPUs so
+        // that device interrupts are spread across the system by default.
+        //
+        // TODO(johngro) : all of the IRQs in a block share one target
+        // address, so they all land on the same CPU.  Per-vector targeting
+        // (needed for proper MSI-X affinity) requires letting the caller
+        // choose a target for each vector.
+        uint32_t tgt_addr = 0xFEE00000;                     // base addr
+        tgt_addr |= x86_msi_target_apic_id() << 12;         // Dest ID
+        tgt_addr |= 0x08;                                   // Redir hint == 1
+        tgt_addr &= ~0x04;                                  // Dest Mode == Physical
 
         // Compute the target data.
         // See section 10.11.2 of the Intel 64 and IA-32 Architectures Software
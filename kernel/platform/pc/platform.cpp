@@ -472,6 +472,10 @@ static void platform_init_smp(void)
 
     x86_init_smp(apic_ids, num_cpus);
 
+    // Now that the percpu structures exist, apic ids can be mapped to cpu
+    // numbers; record the NUMA topology before the APs start scheduling.
+    platform_init_numa();
+
     for (uint i = 0; i < num_cpus - 1; ++i) {
         if (apic_ids[i] == bsp_apic_id) {
             apic_ids[i] = apic_ids[num_cpus - 1];
@@ -492,6 +496,11 @@ status_t platform_mp_prep_cpu_unplug(uint cpu_id)
 
 void platform_init(void)
 {
+    // Start the APs first, so they are already online to run the parallel
+    // platform-level init hooks (PCIe bus enumeration in particular) that
+    // follow platform_init.
+    platform_init_smp();
+
     platform_init_debug();
 
     platform_init_crashlog();
@@ -499,6 +508,4 @@ void platform_init(void)
 #if NO_USER_KEYBOARD
     platform_init_keyboard(&console_input_buf);
 #endif
-
-    platform_init_smp();
 }
@@ -133,6 +133,8 @@ static void x86_pcie_init_hook(uint level) {
     }
 }
 
-LK_INIT_HOOK(x86_pcie_init, x86_pcie_init_hook, LK_INIT_LEVEL_PLATFORM);
+// Bus enumeration only touches PCIe state, so it can overlap any other
+// platform-level init.
+LK_INIT_HOOK_PARALLEL(x86_pcie_init, x86_pcie_init_hook, LK_INIT_LEVEL_PLATFORM);
 
 #endif  // WITH_DEV_PCIE
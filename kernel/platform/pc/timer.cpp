@@ -165,6 +165,19 @@ lk_time_t ticks_to_nanos(uint64_t ticks) {
     return u64_mul_u64_fp32_64(ticks, ns_per_tsc);
 }
 
+bool platform_usermode_get_mono_ratio(uint32_t ratio[3])
+{
+    // usermode reads the TSC directly, so it can only compute the monotonic
+    // clock itself when that's the counter the kernel derives it from
+    if (wall_clock != CLOCK_TSC)
+        return false;
+
+    ratio[0] = ns_per_tsc.l0;
+    ratio[1] = ns_per_tsc.l32;
+    ratio[2] = ns_per_tsc.l64;
+    return true;
+}
+
 // The PIT timer will keep track of wall time if we aren't using the TSC
 static enum handler_return pit_timer_tick(void *arg)
 {
@@ -0,0 +1,12 @@
+# Copyright 2017 The Fuchsia Authors
+#
+# Use of this source code is governed by a MIT-style
+# license that can be found in the LICENSE file or at
+# https://opensource.org/licenses/MIT
+
+# Fast-release build of the standard PC project: clang ThinLTO across the
+# kernel and user space, with DEBUG_ASSERT compiled out.  The toolchain and
+# debug knobs live in options/magenta-pc-x86-64-release-lto.mk, which
+# make/engine.mk includes before acting on them.
+
+include kernel/project/magenta-pc-x86-64.mk
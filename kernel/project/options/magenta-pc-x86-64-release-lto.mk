@@ -0,0 +1,16 @@
+# Copyright 2017 The Fuchsia Authors
+#
+# Use of this source code is governed by a MIT-style
+# license that can be found in the LICENSE file or at
+# https://opensource.org/licenses/MIT
+
+# Options for the magenta-pc-x86-64-release-lto project; included by
+# make/engine.mk before the toolchain defaults are evaluated.
+
+# release build: DEBUG_ASSERT and debug prints compile out
+DEBUG := 0
+
+# ThinLTO requires the clang/lld toolchain
+USE_CLANG := true
+USE_LTO := true
+USE_THINLTO := true
@@ -12,6 +12,7 @@ KERNEL_DEFINES += WITH_DEBUG_LINEBUFFER=1
 MODULES += \
     kernel/lib/syscalls \
     kernel/lib/userboot \
+    kernel/lib/counters \
     kernel/lib/debuglog \
     kernel/lib/ktrace \
     kernel/lib/mtrace \
@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <magenta/compiler.h>
 #include <debug.h>
+#include <kernel/thread.h>
 #include <trace.h>
 
 #define LOCAL_TRACE 0
@@ -28,64 +29,90 @@
 extern const struct lk_init_struct __start_lk_init[] __WEAK;
 extern const struct lk_init_struct __stop_lk_init[] __WEAK;
 
+/* most hooks marked LK_INIT_FLAG_PARALLEL at one level we are prepared to
+ * run concurrently; any beyond this just run inline
+ */
+#define INIT_MAX_PARALLEL 8
+
+static void trace_hook(const struct lk_init_struct *ptr)
+{
+#if TRACE_INIT
+    if (ptr->level >= EARLIEST_TRACE_LEVEL) {
+        printf("INIT: cpu %u, calling hook %p (%s) at level %#x, flags %#x\n",
+               arch_curr_cpu_num(), ptr->hook, ptr->name, ptr->level, ptr->flags);
+    }
+#endif
+}
+
+static int parallel_hook_thread(void *arg)
+{
+    const struct lk_init_struct *ptr = arg;
+    trace_hook(ptr);
+    ptr->hook(ptr->level);
+    return 0;
+}
+
 void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop_level)
 {
     LTRACEF("flags %#x, start_level %#x, stop_level %#x\n",
             required_flag, start_level, stop_level);
 
     ASSERT(start_level > 0);
+
+    /* parallel hooks need the scheduler, and only make sense on the normal
+     * primary cpu boot path
+     */
+    bool can_parallel = (required_flag == LK_INIT_FLAG_PRIMARY_CPU) &&
+                        (start_level >= LK_INIT_LEVEL_THREADING);
+
     uint last_called_level = start_level - 1;
-    const struct lk_init_struct *last = NULL;
     for (;;) {
-        /* search for the lowest uncalled hook to call */
-        LTRACEF("last %p, last_called_level %#x\n", last, last_called_level);
+        /* search for the lowest level in range with uncalled hooks */
+        LTRACEF("last_called_level %#x\n", last_called_level);
 
-        const struct lk_init_struct *found = NULL;
-        bool seen_last = false;
+        uint level = 0;
         for (const struct lk_init_struct *ptr = __start_lk_init; ptr != __stop_lk_init; ptr++) {
-            LTRACEF("looking at %p (%s) level %#x, flags %#x, seen_last %d\n", ptr, ptr->name, ptr->level, ptr->flags, seen_last);
-
-            if (ptr == last)
-                seen_last = true;
-
-            /* reject the easy ones */
             if (!(ptr->flags & required_flag))
                 continue;
-            if (ptr->level > stop_level)
-                continue;
-            if (ptr->level < last_called_level)
-                continue;
-            if (found && found->level <= ptr->level)
+            if (ptr->level > stop_level || ptr->level <= last_called_level)
                 continue;
+            if (level == 0 || ptr->level < level)
+                level = ptr->level;
+        }
+        if (level == 0)
+            break;
 
-            /* keep the lowest one we haven't called yet */
-            if (ptr->level >= start_level && ptr->level > last_called_level) {
-                found = ptr;
+        /* run every hook at this level: parallel-flagged ones on worker
+         * threads, the rest inline in link order. all of them complete
+         * before we move to the next level.
+         */
+        thread_t *workers[INIT_MAX_PARALLEL];
+        uint num_workers = 0;
+        for (const struct lk_init_struct *ptr = __start_lk_init; ptr != __stop_lk_init; ptr++) {
+            if (!(ptr->flags & required_flag) || ptr->level != level)
                 continue;
-            }
 
-            /* if we're at the same level as the last one we called and we've
-             * already passed over it this time around, we can mark this one
-             * and early terminate the loop.
-             */
-            if (ptr->level == last_called_level && ptr != last && seen_last) {
-                found = ptr;
-                break;
+            if (can_parallel && (ptr->flags & LK_INIT_FLAG_PARALLEL) &&
+                num_workers < countof(workers)) {
+                thread_t *t = thread_create(ptr->name, parallel_hook_thread,
+                                            (void *)ptr, DEFAULT_PRIORITY,
+                                            DEFAULT_STACK_SIZE);
+                if (t) {
+                    thread_resume(t);
+                    workers[num_workers++] = t;
+                    continue;
+                }
+                /* fall through and run it inline */
             }
-        }
-
-        if (!found)
-            break;
 
-#if TRACE_INIT
-        if (found->level >= EARLIEST_TRACE_LEVEL) {
-            printf("INIT: cpu %u, calling hook %p (%s) at level %#x, flags %#x\n",
-                   arch_curr_cpu_num(), found->hook, found->name, found->level, found->flags);
+            trace_hook(ptr);
+            ptr->hook(ptr->level);
         }
-#endif
-        found->hook(found->level);
-        last_called_level = found->level;
-        last = found;
+        for (uint i = 0; i < num_workers; i++) {
+            thread_join(workers[i], NULL, INFINITE_TIME);
+        }
+
+        last_called_level = level;
     }
 }
 
@@ -14,6 +14,12 @@ LOCAL_MAKEFILE:=$(MAKEFILE_LIST)
 -include local.mk
 include make/macros.mk
 
+# If the project has an options fragment, include it now, before the option
+# defaults below are acted on.  This lets a project pin toolchain and debug
+# knobs (DEBUG, USE_CLANG, USE_THINLTO, ...) that are otherwise command line
+# or environment arguments.
+-include kernel/project/options/$(firstword $(PROJECT) $(DEFAULT_PROJECT)).mk
+
 # various command line and environment arguments
 # default them to something so when they're referenced in the make instance they're not undefined
 BUILDROOT ?= .
@@ -173,6 +179,8 @@ ifeq ($(call TOBOOL,$(USE_LTO)),true)
 # can be removed when https://bugs.llvm.org/show_bug.cgi?id=33306 is fixed.
 KERNEL_LDFLAGS += -mllvm -code-model=kernel
 ifeq ($(call TOBOOL,$(USE_THINLTO)),true)
+KERNEL_COMPILEFLAGS += -flto=thin
+KERNEL_LDFLAGS += --thinlto-jobs=8 --thinlto-cache-dir=$(BUILDDIR)/thinlto-cache-kernel
 USER_COMPILEFLAGS += -flto=thin
 USER_LDFLAGS += --thinlto-jobs=8 --thinlto-cache-dir=$(BUILDDIR)/thinlto-cache
 else
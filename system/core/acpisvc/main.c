@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <stdio.h>
+#include <threads.h>
 
 #include <acpica/acpi.h>
 #include <magenta/process.h>
@@ -19,9 +20,27 @@
 
 static ACPI_STATUS set_apic_irq_mode(void);
 static ACPI_STATUS init(void);
+static int full_init_thread(void* arg);
 
 mx_handle_t root_resource_handle;
 
+// Deferred initialization state.  The expensive part of namespace
+// initialization (AcpiInitializeObjects runs every _STA/_INI in the
+// tree) happens on a background thread while we begin serving
+// enumeration requests, which only need the loaded tables.  Handlers
+// that evaluate namespace objects wait on this first.
+static mtx_t init_lock = MTX_INIT;
+static cnd_t init_cond;
+static bool full_init_done;
+
+void acpi_full_init_wait(void) {
+    mtx_lock(&init_lock);
+    while (!full_init_done) {
+        cnd_wait(&init_cond, &init_lock);
+    }
+    mtx_unlock(&init_lock);
+}
+
 int main(int argc, char** argv) {
     root_resource_handle = mx_get_startup_handle(PA_HND(PA_USER0, 0));
     if (root_resource_handle <= 0) {
@@ -74,9 +93,31 @@ int main(int argc, char** argv) {
         return 5;
     }
 
+    // Finish the expensive initialization off the critical path;
+    // enumeration requests can be served from the loaded tables
+    // immediately.
+    cnd_init(&init_cond);
+    thrd_t init_thrd;
+    if (thrd_create_with_name(&init_thrd, full_init_thread, NULL,
+                              "acpi-full-init") != thrd_success) {
+        // fall back to initializing inline
+        full_init_thread(NULL);
+    } else {
+        thrd_detach(init_thrd);
+    }
+
+    return begin_processing(acpi_root);
+}
+
+static int full_init_thread(void* arg) {
+    ACPI_STATUS status = AcpiInitializeObjects(ACPI_FULL_INITIALIZATION);
+    if (status != AE_OK) {
+        printf("WARNING: could not initialize ACPI objects\n");
+    }
+
     ec_init();
 
-    mx_status = install_powerbtn_handlers();
+    mx_status_t mx_status = install_powerbtn_handlers();
     if (mx_status != NO_ERROR) {
         printf("Failed to install powerbtn handler\n");
     }
@@ -86,7 +127,11 @@ int main(int argc, char** argv) {
         printf("WARNING: ACPI failed to report all current resources!\n");
     }
 
-    return begin_processing(acpi_root);
+    mtx_lock(&init_lock);
+    full_init_done = true;
+    cnd_broadcast(&init_cond);
+    mtx_unlock(&init_lock);
+    return 0;
 }
 
 static ACPI_STATUS init(void) {
@@ -122,11 +167,8 @@ static ACPI_STATUS init(void) {
         return status;
     }
 
-    status = AcpiInitializeObjects(ACPI_FULL_INITIALIZATION);
-    if (status != AE_OK) {
-        printf("WARNING: could not initialize ACPI objects\n");
-        return status;
-    }
+    // AcpiInitializeObjects is deferred to full_init_thread(); the
+    // namespace is already walkable once the tables are loaded.
 
     status = set_apic_irq_mode();
     if (status == AE_NOT_FOUND) {
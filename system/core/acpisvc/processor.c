@@ -450,6 +450,9 @@ static mx_status_t cmd_get_pci_init_arg(mx_handle_t h, acpi_handle_ctx_t* ctx, v
         return send_error(h, cmd->hdr.request_id, ERR_INVALID_ARGS);
     }
 
+    // requires fully initialized namespace objects
+    acpi_full_init_wait();
+
     ACPI_DEVICE_INFO* info = NULL;
     ACPI_STATUS acpi_status = AcpiGetObjectInfo(ctx->ns_node, &info);
     if (acpi_status == AE_NO_MEMORY) {
@@ -504,6 +507,8 @@ static mx_status_t cmd_s_state_transition(mx_handle_t h, acpi_handle_ctx_t* ctx,
         return send_error(h, cmd->hdr.request_id, ERR_ACCESS_DENIED);
     }
 
+    acpi_full_init_wait();
+
     switch (cmd->target_state) {
     case ACPI_S_STATE_REBOOT:
         reboot();
@@ -528,6 +533,8 @@ static mx_status_t cmd_ps0(mx_handle_t h, acpi_handle_ctx_t* ctx, void* _cmd) {
         return send_error(h, cmd->hdr.request_id, ERR_ACCESS_DENIED);
     }
 
+    acpi_full_init_wait();
+
     cmd->name[sizeof(cmd->name) - 1] = '\0';
     ACPI_HANDLE dev;
     ACPI_STATUS status = AcpiGetHandle(NULL, cmd->name, &dev);
@@ -563,6 +570,8 @@ static mx_status_t cmd_bst(mx_handle_t h, acpi_handle_ctx_t* ctx, void* _cmd) {
         .Length = ACPI_ALLOCATE_BUFFER,
         .Pointer = NULL,
     };
+    acpi_full_init_wait();
+
     mx_status_t status = AcpiEvaluateObject(ctx->ns_node, (char*)"_BST", NULL, &buffer);
     if (status != AE_OK) {
         printf("Failed to find object's BST method\n");
@@ -608,6 +617,8 @@ static mx_status_t cmd_bif(mx_handle_t h, acpi_handle_ctx_t* ctx, void* _cmd) {
         .Length = ACPI_ALLOCATE_BUFFER,
         .Pointer = NULL,
     };
+    acpi_full_init_wait();
+
     mx_status_t status = AcpiEvaluateObject(ctx->ns_node, (char*)"_BIF", NULL, &buffer);
     if (status != AE_OK) {
         printf("Failed to find object's BIF method\n");
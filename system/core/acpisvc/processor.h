@@ -7,3 +7,9 @@
 #include <magenta/types.h>
 
 mx_status_t begin_processing(mx_handle_t acpi_root);
+
+// Block until the deferred portion of ACPI initialization (object
+// initialization, EC, power button, PCI resources) has completed.
+// Namespace enumeration does not require it; anything that evaluates
+// namespace objects does.
+void acpi_full_init_wait(void);
@@ -118,6 +118,10 @@ struct dc_driver {
     uint32_t flags;
     struct list_node node;
     const char* libname;
+    // protocol id the bind program requires, per dc_binding_protocol(),
+    // or 0 if this driver must be considered for every device
+    uint32_t bind_protocol;
+    struct list_node pnode; // in the coordinator's protocol index
 };
 
 #define DRIVER_NAME_LEN_MAX 64
@@ -136,6 +140,9 @@ bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     mx_device_prop_t* props, size_t prop_count,
                     bool autobind);
 
+uint32_t dc_binding_protocol(const mx_bind_inst_t* binding,
+                             uint32_t binding_size);
+
 #define DC_MAX_DATA 4096
 
 // The first two fields of devcoordinator messages align
@@ -174,6 +181,12 @@ typedef struct {
 #define DC_OP_BIND_DEVICE        0x80000013
 #define DC_OP_GET_TOPO_PATH      0x80000014
 
+// Same as ADD_DEVICE, but the devhost does not block in channel_call
+// waiting for the result.  The coordinator sends the status back as a
+// DC_OP_STATUS message on the parent channel, so a devhost enumerating
+// a busful of devices can stream the adds back to back.
+#define DC_OP_ADD_DEVICE_PIPELINED 0x80000015
+
 // Host->Coord Ops for DmCtl
 #define DC_OP_DM_COMMAND         0x80000020
 #define DC_OP_DM_OPEN_VIRTCON    0x80000021
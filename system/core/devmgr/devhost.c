@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <driver/driver-api.h>
@@ -47,6 +48,75 @@ static iostate_t root_ios = {
 
 static list_node_t dh_drivers = LIST_INITIAL_VALUE(dh_drivers);
 
+// Device adds are pipelined: devhost_add sends the request and returns
+// without waiting, and the coordinator's answer comes back later as a
+// DC_OP_STATUS message on the same channel the add went out on.  Each
+// add in flight is recorded here; since the coordinator answers a
+// channel's adds in the order it read them, the oldest record for a
+// given channel is always the one a status message is answering.
+//
+// devhost_add runs on driver threads and the status messages arrive on
+// the port thread, hence the lock.
+typedef struct {
+    list_node_t node;
+    mx_device_t* dev;   // child awaiting confirmation
+    mx_handle_t rpc;    // parent channel the add was sent on
+} add_pending_t;
+
+static list_node_t add_pending_list = LIST_INITIAL_VALUE(add_pending_list);
+static mtx_t add_pending_lock = MTX_INIT;
+
+static add_pending_t* dh_add_pending_pop(mx_handle_t rpc) {
+    add_pending_t* pending;
+    mtx_lock(&add_pending_lock);
+    list_for_every_entry(&add_pending_list, pending, add_pending_t, node) {
+        if (pending->rpc == rpc) {
+            list_delete(&pending->node);
+            mtx_unlock(&add_pending_lock);
+            return pending;
+        }
+    }
+    mtx_unlock(&add_pending_lock);
+    return NULL;
+}
+
+// A pipelined add failed, so the coordinator never published this
+// device and closed its end of the device channel.  The channel was
+// never registered with the port (that only happens on success), so
+// close our end and free the iostate directly.  Any adds the driver
+// already queued on the dead channel will never be answered; their
+// devices are abandoned the same way.
+static void dh_add_abandoned(mx_device_t* child) {
+    list_node_t doomed = LIST_INITIAL_VALUE(doomed);
+
+    for (;;) {
+        iostate_t* ios = child->ios;
+        child->ios = NULL;
+        child->rpc = MX_HANDLE_INVALID;
+        if (ios != NULL) {
+            add_pending_t* pending;
+            add_pending_t* temp;
+            mtx_lock(&add_pending_lock);
+            list_for_every_entry_safe(&add_pending_list, pending, temp,
+                                      add_pending_t, node) {
+                if (pending->rpc == ios->ph.handle) {
+                    list_delete(&pending->node);
+                    list_add_tail(&doomed, &pending->node);
+                }
+            }
+            mtx_unlock(&add_pending_lock);
+            mx_handle_close(ios->ph.handle);
+            free(ios);
+        }
+        add_pending_t* next = list_remove_head_type(&doomed, add_pending_t, node);
+        if (next == NULL) {
+            return;
+        }
+        child = next->dev;
+        free(next);
+    }
+}
+
 static const char* mkdevpath(mx_device_t* dev, char* path, size_t max) {
     if (dev == NULL) {
         return "";
@@ -145,6 +215,69 @@ done:
     return drv->status;
 }
 
+static void dh_send_bind_status(mx_handle_t h, mx_status_t status) {
+    dc_msg_t reply = {
+        .txid = 0,
+        .op = DC_OP_STATUS,
+        .status = status,
+    };
+    mx_channel_write(h, 0, &reply, sizeof(reply), NULL, 0);
+}
+
+typedef struct {
+    mx_driver_t* drv;
+    iostate_t* ios;
+    mx_handle_t h;
+} bind_work_t;
+
+static void dh_run_bind(mx_driver_t* drv, iostate_t* ios, mx_handle_t h) {
+    mx_status_t r;
+    if (drv->ops->bind) {
+        r = drv->ops->bind(drv->ctx, ios->dev, &ios->dev->owner_cookie);
+    } else {
+        r = ERR_NOT_SUPPORTED;
+    }
+    if (r < 0) {
+        log(ERROR, "devhost: bind driver '%s' failed: %d\n", drv->libname, r);
+    } else {
+        //TODO: best behaviour for multibind? maybe retire "owner"?
+        ios->dev->owner = drv;
+    }
+    dh_send_bind_status(h, r);
+}
+
+static int dh_bind_thread(void* arg) {
+    bind_work_t* work = arg;
+    dh_run_bind(work->drv, work->ios, work->h);
+    free(work);
+    return 0;
+}
+
+// Run a driver's bind hook on its own thread, so a driver which does
+// slow device bring-up (usb enumeration, disk probing, etc) does not
+// stall this devhost's rpc loop or any binds the coordinator dispatches
+// behind it. Drivers already call back into the device API from their
+// own threads, so bind runs under the same devhost api lock rules as
+// always. The DC_OP_STATUS reply is sent when the bind finishes.
+static void dh_spawn_bind(mx_driver_t* drv, iostate_t* ios, mx_handle_t h) {
+    bind_work_t* work = malloc(sizeof(bind_work_t));
+    if (work == NULL) {
+        // no memory for a thread either; bind inline
+        dh_run_bind(drv, ios, h);
+        return;
+    }
+    work->drv = drv;
+    work->ios = ios;
+    work->h = h;
+
+    thrd_t t;
+    if (thrd_create_with_name(&t, dh_bind_thread, work, "driver-bind") != thrd_success) {
+        dh_bind_thread(work);
+    } else {
+        thrd_detach(t);
+    }
+}
+
 static void dh_handle_open(mxrio_msg_t* msg, size_t len,
                            mx_handle_t h, iostate_t* ios) {
     if ((msg->hcount != 1) ||
@@ -310,27 +443,37 @@ static mx_status_t dh_handle_rpc_read(mx_handle_t h, iostate_t* ios) {
         mx_driver_t* drv;
         if ((r = dh_find_driver(name, hin[0], &drv)) < 0) {
             log(ERROR, "devhost[%s] driver load failed: %d\n", path, r);
+            dh_send_bind_status(h, r);
         } else {
-            if (drv->ops->bind) {
-                r = drv->ops->bind(drv->ctx, ios->dev, &ios->dev->owner_cookie);
-            } else {
-                r = ERR_NOT_SUPPORTED;
-            }
-            if (r < 0) {
-                log(ERROR, "devhost[%s] bind driver '%s' failed: %d\n", path, name, r);
-            } else {
-                //TODO: best behaviour for multibind? maybe retire "owner"?
-                ios->dev->owner = drv;
-            }
+            dh_spawn_bind(drv, ios, h);
         }
-        dc_msg_t reply = {
-            .txid = 0,
-            .op = DC_OP_STATUS,
-            .status = r,
-        };
-        mx_channel_write(h, 0, &reply, sizeof(reply), NULL, 0);
         return NO_ERROR;
 
+    case DC_OP_STATUS: {
+        if (hcount != 0) {
+            r = ERR_INVALID_ARGS;
+            goto fail;
+        }
+        // Answer to the oldest pipelined add-device on this channel.
+        add_pending_t* pending = dh_add_pending_pop(h);
+        if (pending == NULL) {
+            log(ERROR, "devhost[%s] spurious status message\n", path);
+            return NO_ERROR;
+        }
+        mx_device_t* child = pending->dev;
+        free(pending);
+        if (msg.status < 0) {
+            log(ERROR, "devhost[%s] add '%s' failed: %d\n",
+                path, child->name, msg.status);
+            dh_add_abandoned(child);
+        } else if ((r = port_wait(&dh_port, &child->ios->ph)) < 0) {
+            log(ERROR, "devhost[%s] add '%s': port_wait failed: %d\n",
+                path, child->name, r);
+            dh_add_abandoned(child);
+        }
+        return NO_ERROR;
+    }
+
     default:
         log(ERROR, "devhost[%s] invalid rpc op %08x\n", path, msg.op);
         r = ERR_NOT_SUPPORTED;
@@ -421,6 +564,14 @@ static void devhost_io_init(void) {
 
 // Send message to devcoordinator asking to add child device to
 // parent device.  Called under devhost api lock.
+//
+// The add is pipelined: this returns as soon as the message is
+// written, so enumerating a bus costs one channel write per device
+// instead of a blocking round trip each.  The child's channel is
+// usable immediately -- messages just queue until the coordinator
+// gets to them, and it reads a channel's messages in order, so it
+// always processes this add before anything sent on the new channel.
+// The coordinator's status answer is handled by dh_handle_rpc_read.
 mx_status_t devhost_add(mx_device_t* parent, mx_device_t* child,
                         const char* businfo, mx_handle_t resource,
                         const mx_device_prop_t* props, uint32_t prop_count) {
@@ -434,11 +585,16 @@ mx_status_t devhost_add(mx_device_t* parent, mx_device_t* child,
     snprintf(name, namelen, "%s,%s", libname, child->name);
 
     mx_status_t r;
+    add_pending_t* pending = NULL;
     iostate_t* ios = calloc(1, sizeof(*ios));
     if (ios == NULL) {
         r = ERR_NO_MEMORY;
         goto fail;
     }
+    if ((pending = malloc(sizeof(*pending))) == NULL) {
+        r = ERR_NO_MEMORY;
+        goto fail;
+    }
 
     dc_msg_t msg;
     uint32_t msglen;
@@ -447,7 +603,8 @@ mx_status_t devhost_add(mx_device_t* parent, mx_device_t* child,
                          name, businfo)) < 0) {
         goto fail;
     }
-    msg.op = DC_OP_ADD_DEVICE;
+    msg.txid = 0;
+    msg.op = DC_OP_ADD_DEVICE_PIPELINED;
     msg.protocol_id = child->protocol_id;
 
     // handles: remote endpoint, resource (optional)
@@ -457,31 +614,43 @@ mx_status_t devhost_add(mx_device_t* parent, mx_device_t* child,
     }
     handle[1] = resource;
 
-    dc_status_t rsp;
-    if ((r = dc_msg_rpc(parent->rpc, &msg, msglen,
-                        handle, (resource != MX_HANDLE_INVALID) ? 2 : 1,
-                        &rsp, sizeof(rsp))) < 0) {
+    if ((r = mx_channel_write(parent->rpc, 0, &msg, msglen,
+                              handle, (resource != MX_HANDLE_INVALID) ? 2 : 1)) < 0) {
         log(ERROR, "devhost[%s] add '%s': rpc failed: %d\n", path, child->name, r);
-    } else {
-        ios->dev = child;
-        ios->ph.handle = hrpc;
-        ios->ph.waitfor = MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED;
-        ios->ph.func = dh_handle_dc_rpc;
-        if ((r = port_wait(&dh_port, &ios->ph)) == NO_ERROR) {
-            child->rpc = hrpc;
-            child->ios = ios;
-            return NO_ERROR;
+        mx_handle_close(handle[0]);
+        if (resource != MX_HANDLE_INVALID) {
+            mx_handle_close(handle[1]);
         }
-
+        mx_handle_close(hrpc);
+        free(pending);
+        free(ios);
+        return r;
     }
-    mx_handle_close(hrpc);
-    free(ios);
-    return r;
+
+    // The channel is not registered with the port until the success
+    // status arrives; registering it now would make a coordinator-side
+    // rejection (which closes the far end) look like a fatal
+    // coordinator disconnect.
+    ios->dev = child;
+    ios->ph.handle = hrpc;
+    ios->ph.waitfor = MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED;
+    ios->ph.func = dh_handle_dc_rpc;
+
+    pending->dev = child;
+    pending->rpc = parent->rpc;
+    mtx_lock(&add_pending_lock);
+    list_add_tail(&add_pending_list, &pending->node);
+    mtx_unlock(&add_pending_lock);
+
+    child->rpc = hrpc;
+    child->ios = ios;
+    return NO_ERROR;
 
 fail:
     if (resource != MX_HANDLE_INVALID) {
         mx_handle_close(resource);
     }
+    free(pending);
     free(ios);
     return r;
 }
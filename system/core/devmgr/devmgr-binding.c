@@ -138,6 +138,41 @@ next_instruction:
     return false;
 }
 
+// Determine, statically, the protocol id a bind program requires of
+// any device it could match, so the coordinator can index drivers by
+// protocol instead of evaluating every program against every device.
+// Returns 0 when the requirement cannot be determined; such drivers
+// are evaluated against all devices, as before.
+uint32_t dc_binding_protocol(const mx_bind_inst_t* binding,
+                             uint32_t binding_size) {
+    const mx_bind_inst_t* ip = binding;
+    const mx_bind_inst_t* end = ip + (binding_size / sizeof(mx_bind_inst_t));
+
+    // skip the prologue of abort-if-not-equal tests almost every
+    // program opens with; one keyed on the protocol pins it down
+    while (ip < end) {
+        uint32_t inst = ip->op;
+        if ((BINDINST_CC(inst) != COND_NE) || (BINDINST_OP(inst) != OP_ABORT)) {
+            break;
+        }
+        if (BINDINST_PB(inst) == BIND_PROTOCOL) {
+            return ip->arg;
+        }
+        ip++;
+    }
+
+    // the other common shape: a program which is nothing but a single
+    // match-if-protocol-equals instruction
+    if ((ip + 1 == end) &&
+        (BINDINST_CC(ip->op) == COND_EQ) &&
+        (BINDINST_OP(ip->op) == OP_MATCH) &&
+        (BINDINST_PB(ip->op) == BIND_PROTOCOL)) {
+        return ip->arg;
+    }
+
+    return 0;
+}
+
 bool dc_is_bindable(driver_t* drv, uint32_t protocol_id,
                     mx_device_prop_t* props, size_t prop_count,
                     bool autobind) {
@@ -123,6 +123,19 @@ static mx_handle_t devhost_job;
 port_t dc_port;
 static list_node_t list_drivers = LIST_INITIAL_VALUE(list_drivers);
 
+// Drivers indexed by the protocol their bind program requires, so
+// publishing a device only evaluates plausible candidates instead of
+// every driver loaded. Drivers whose requirement cannot be determined
+// statically live on the wildcard list and are always evaluated.
+#define DRIVER_PROTO_BUCKETS 32
+static list_node_t driver_index[DRIVER_PROTO_BUCKETS];
+static list_node_t list_wildcard_drivers = LIST_INITIAL_VALUE(list_wildcard_drivers);
+
+static list_node_t* driver_bucket(uint32_t protocol_id) {
+    uint32_t h = protocol_id ^ (protocol_id >> 8) ^ (protocol_id >> 16);
+    return &driver_index[h % DRIVER_PROTO_BUCKETS];
+}
+
 static driver_t* libname_to_driver(const char* libname) {
     driver_t* drv;
     list_for_every_entry(&list_drivers, drv, driver_t, node) {
@@ -773,6 +786,27 @@ static mx_status_t dc_handle_device_read(device_t* dev) {
         }
         break;
 
+    case DC_OP_ADD_DEVICE_PIPELINED: {
+        log(RPC_IN, "devcoord: rpc: add-device '%s' args='%s' (pipelined)\n", name, args);
+        if ((r = dc_add_device(dev, hin, hcount, &msg, name, args, data)) < 0) {
+            while (hcount > 0) {
+                mx_handle_close(hin[--hcount]);
+            }
+        }
+        // The devhost is not blocked in channel_call for this op.
+        // The status goes back as its own message, which the devhost
+        // matches against its adds in flight on this channel.
+        dc_msg_t reply;
+        uint32_t rlen;
+        if (dc_msg_pack(&reply, &rlen, NULL, 0, NULL, NULL) == NO_ERROR) {
+            reply.txid = 0;
+            reply.op = DC_OP_STATUS;
+            reply.status = r;
+            mx_channel_write(dev->hrpc, 0, &reply, rlen, NULL, 0);
+        }
+        return NO_ERROR;
+    }
+
     case DC_OP_REMOVE_DEVICE:
         if (hcount != 0) {
             goto fail_hcount;
@@ -1092,10 +1126,22 @@ static mx_status_t dc_attempt_bind(driver_t* drv, device_t* dev) {
     return dh_bind_driver(dev->shadow, drv->libname);
 }
 
-static void dc_handle_new_device(device_t* dev) {
-    driver_t* drv;
+// the protocol the bind programs will observe for this device:
+// an explicit BIND_PROTOCOL property wins over the device's own id
+static uint32_t dev_bind_protocol(device_t* dev) {
+    for (uint32_t i = 0; i < dev->prop_count; i++) {
+        if (dev->props[i].id == BIND_PROTOCOL) {
+            return dev->props[i].value;
+        }
+    }
+    return dev->protocol_id;
+}
 
-    list_for_every_entry(&list_drivers, drv, driver_t, node) {
+// returns true if binding is finished (a driver bound to a
+// device which does not accept further binds)
+static bool dc_bind_candidates(device_t* dev, list_node_t* list) {
+    driver_t* drv;
+    list_for_every_entry(list, drv, driver_t, pnode) {
         if (dc_is_bindable(drv, dev->protocol_id,
                            dev->props, dev->prop_count, true)) {
             log(INFO, "devcoord: drv='%s' bindable to dev='%s'\n",
@@ -1103,10 +1149,20 @@ static void dc_handle_new_device(device_t* dev) {
 
             dc_attempt_bind(drv, dev);
             if (!(dev->flags & DEV_CTX_MULTI_BIND)) {
-                break;
+                return true;
             }
         }
     }
+    return false;
+}
+
+static void dc_handle_new_device(device_t* dev) {
+    // consult the index: drivers keyed to this device's protocol first,
+    // then the few whose programs could match anything
+    if (dc_bind_candidates(dev, driver_bucket(dev_bind_protocol(dev)))) {
+        return;
+    }
+    dc_bind_candidates(dev, &list_wildcard_drivers);
 }
 
 // device binding program that pure (parentless)
@@ -1136,12 +1192,17 @@ static bool is_platform_bus_driver(driver_t* drv) {
 }
 
 void coordinator_new_driver(driver_t* drv, const char* version) {
+    drv->bind_protocol = dc_binding_protocol(drv->binding, drv->binding_size);
+    list_node_t* bucket = drv->bind_protocol ? driver_bucket(drv->bind_protocol)
+                                             : &list_wildcard_drivers;
     if (version[0] == '!') {
         // debugging / development hack
         // prioritize drivers with version "!..." over others
         list_add_head(&list_drivers, &drv->node);
+        list_add_head(bucket, &drv->pnode);
     } else {
         list_add_tail(&list_drivers, &drv->node);
+        list_add_tail(bucket, &drv->pnode);
     }
 }
 
@@ -1154,6 +1215,10 @@ device_t* coordinator_init(mx_handle_t root_job) {
     }
     mx_object_set_property(devhost_job, MX_PROP_NAME, "magenta-drivers", 15);
 
+    for (size_t i = 0; i < DRIVER_PROTO_BUCKETS; i++) {
+        list_initialize(&driver_index[i]);
+    }
+
     port_init(&dc_port);
 
     return &root_device;
@@ -269,17 +269,43 @@ static void setup_bootfs(void) {
             case BOOTDATA_BOOTFS_SYSTEM: {
                 const char* errmsg;
                 mx_handle_t bootfs_vmo;
-                printf("devmgr: decompressing bootfs #%u\n", idx);
-                status = decompress_bootdata(mx_vmar_root_self(), vmo,
-                                             off, bootdata.length + sizeof(bootdata),
-                                             &bootfs_vmo, &errmsg);
-                if (status < 0) {
-                    printf("devmgr: failed to decompress bootdata: %s\n", errmsg);
+                if (bootdata.flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED) {
+                    printf("devmgr: decompressing bootfs #%u\n", idx);
+                    status = decompress_bootdata(mx_vmar_root_self(), vmo,
+                                                 off, bootdata.length + sizeof(bootdata),
+                                                 &bootfs_vmo, &errmsg);
+                    if (status < 0) {
+                        printf("devmgr: failed to decompress bootdata: %s\n", errmsg);
+                        break;
+                    }
+                } else if ((bootdata.flags & BOOTDATA_BOOTFS_FLAG_ALIGNED) &&
+                           ((off & (PAGE_SIZE - 1)) == 0)) {
+                    // The image is page aligned within the container, so its
+                    // files can be served as clones straight out of this VMO
+                    // without copying the data anywhere.
+                    size_t clone_len = (sizeof(bootdata) + bootdata.length + PAGE_SIZE - 1) &
+                                       ~(size_t)(PAGE_SIZE - 1);
+                    status = mx_vmo_clone(vmo, MX_VMO_CLONE_COPY_ON_WRITE, off,
+                                          clone_len, &bootfs_vmo);
+                    if (status < 0) {
+                        printf("devmgr: failed to clone bootfs: %d\n", status);
+                        break;
+                    }
                 } else {
-                    setup_bootfs_vmo(idx++, bootdata.type, bootfs_vmo);
+                    // Old unaligned image; copying it out is the only option.
+                    status = copy_vmo(vmo, off, sizeof(bootdata) + bootdata.length,
+                                      &bootfs_vmo);
+                    if (status < 0) {
+                        printf("devmgr: failed to copy bootfs: %d\n", status);
+                        break;
+                    }
                 }
+                setup_bootfs_vmo(idx++, bootdata.type, bootfs_vmo);
                 break;
             }
+            case BOOTDATA_IGNORE:
+                // alignment padding
+                break;
             case BOOTDATA_LAST_CRASHLOG:
                 setup_last_crashlog(vmo, off + sizeof(bootdata), bootdata.length);
                 break;
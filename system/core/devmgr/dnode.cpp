@@ -17,6 +17,15 @@
 
 namespace memfs {
 
+// FNV-1a over the child's name.
+size_t Dnode::GetHash(const NameKey& key) {
+    size_t n = 14695981039346656037ULL;
+    for (size_t i = 0; i < key.len; i++) {
+        n = (n ^ static_cast<uint8_t>(key.name[i])) * 1099511628211ULL;
+    }
+    return n;
+}
+
 // Create a new dnode and attach it to a vnode
 mxtl::RefPtr<Dnode> Dnode::Create(const char* name, size_t len, mxtl::RefPtr<VnodeMemfs> vn) {
     if ((len > kDnodeNameMax) || (len < 1)) {
@@ -44,6 +53,9 @@ void Dnode::RemoveFromParent() {
 
     // Detach from parent
     if (parent_) {
+        if (parent_->child_index_ != nullptr) {
+            parent_->child_index_->erase(GetKey());
+        }
         parent_->children_.erase(*this);
         if (IsDirectory()) {
             // '..' no longer references parent.
@@ -93,7 +105,25 @@ void Dnode::AddChild(mxtl::RefPtr<Dnode> parent, mxtl::RefPtr<Dnode> child) {
     } else {
         child->ordering_token_ = parent->children_.back().ordering_token_ + 1;
     }
+    Dnode* rawchild = child.get();
     parent->children_.push_back(mxtl::move(child));
+
+    if (parent->child_index_ == nullptr) {
+        // First child (or an earlier index allocation failed); index every
+        // child currently in the list, so the index is always either
+        // complete or absent.
+        AllocChecker ac;
+        mxtl::unique_ptr<ChildIndex> index(new (&ac) ChildIndex());
+        if (!ac.check()) {
+            return;
+        }
+        for (auto& dn : parent->children_) {
+            index->insert(&dn);
+        }
+        parent->child_index_ = mxtl::move(index);
+    } else {
+        parent->child_index_->insert(rawchild);
+    }
 }
 
 mx_status_t Dnode::Lookup(const char* name, size_t len, mxtl::RefPtr<Dnode>* out) const {
@@ -115,6 +145,17 @@ mx_status_t Dnode::Lookup(const char* name, size_t len, mxtl::RefPtr<Dnode>* out
         return NO_ERROR;
     }
 
+    if (child_index_ != nullptr) {
+        auto iter = child_index_->find(NameKey{name, len});
+        if (!iter.IsValid()) {
+            return ERR_NOT_FOUND;
+        }
+        if (out != nullptr) {
+            *out = mxtl::RefPtr<Dnode>(iter.CopyPointer());
+        }
+        return NO_ERROR;
+    }
+
     auto dn = children_.find_if([&name, &len](const Dnode& elem) -> bool {
         return elem.NameMatch(name, len);
     });
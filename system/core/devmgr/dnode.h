@@ -10,6 +10,8 @@
 #include <fs/vfs.h>
 #include <mxio/vfs.h>
 #include <mxtl/intrusive_double_list.h>
+#include <mxtl/intrusive_hash_table.h>
+#include <mxtl/intrusive_single_list.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
 #include <mxtl/unique_ptr.h>
@@ -25,11 +27,28 @@ static_assert(NAME_MAX == 255, "NAME_MAX must be 255");
 static_assert(((kDnodeNameMax + 1) & kDnodeNameMax) == 0,
               "Expected kDnodeNameMax to be one less than a power of two");
 
-class Dnode : public mxtl::RefCounted<Dnode> {
+class Dnode : public mxtl::RefCounted<Dnode>,
+              public mxtl::SinglyLinkedListable<Dnode*> {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Dnode);
     using NodeState = mxtl::DoublyLinkedListNodeState<mxtl::RefPtr<Dnode>>;
 
+    // Key identifying a child within its parent directory by name.
+    struct NameKey {
+        const char* name;
+        size_t len;
+
+        bool operator==(const NameKey& other) const {
+            return (len == other.len) && (memcmp(name, other.name, len) == 0);
+        }
+        bool operator<(const NameKey& other) const {
+            int cmp = memcmp(name, other.name, (len < other.len) ? len : other.len);
+            return (cmp < 0) || ((cmp == 0) && (len < other.len));
+        }
+    };
+    NameKey GetKey() const { return NameKey{name_.get(), NameLen()}; }
+    static size_t GetHash(const NameKey& key);
+
     // ChildTraits is the state used for a Dnode to appear as the child
     // of another dnode.
     struct TypeChildTraits { static NodeState& node_state(Dnode& dn) { return dn.type_child_state_; }};
@@ -42,6 +61,11 @@ public:
     using ChildList = mxtl::DoublyLinkedList<mxtl::RefPtr<Dnode>, Dnode::TypeChildTraits>;
     using DeviceList = mxtl::DoublyLinkedList<mxtl::RefPtr<Dnode>, Dnode::TypeDeviceTraits>;
 
+    // Unowned index of a directory's children by name, so lookup in large
+    // directories (such as /dev/class/...) does not walk the child list.
+    // The ordered ChildList remains authoritative (and drives readdir).
+    using ChildIndex = mxtl::HashTable<NameKey, Dnode*>;
+
     // Allocates a dnode, attached to a vnode
     static mxtl::RefPtr<Dnode> Create(const char* name, size_t len, mxtl::RefPtr<VnodeMemfs> vn);
 
@@ -109,6 +133,9 @@ private:
     // Used to impose an absolute order on dnodes within a directory.
     size_t ordering_token_;
     ChildList children_;
+    // Allocated on the first AddChild; absent (on allocation failure, or
+    // for leaf dnodes) lookup falls back to walking 'children_'.
+    mxtl::unique_ptr<ChildIndex> child_index_;
     uint32_t flags_;
     mxtl::unique_ptr<char[]> name_;
 };
@@ -68,6 +68,7 @@ private:
     ssize_t Write(const void* data, size_t len, size_t off) final;
     mx_status_t Truncate(size_t len) final;
     mx_status_t Getattr(vnattr_t* a) final;
+    mx_status_t Mmap(int flags, size_t len, size_t* off, mx_handle_t* out) final;
 
     mx_handle_t vmo_;
     mx_off_t length_;
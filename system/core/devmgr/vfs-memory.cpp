@@ -202,6 +202,41 @@ ssize_t VnodeFile::Write(const void* data, size_t len, size_t off) {
     return actual;
 }
 
+mx_status_t VnodeFile::Mmap(int flags, size_t len, size_t* off, mx_handle_t* out) {
+    if (flags & MXIO_MMAP_FLAG_WRITE) {
+        // Updates through a shared writable mapping could not be observed
+        // by the filesystem, so only read mappings are supported.
+        return ERR_ACCESS_DENIED;
+    }
+    mx_status_t status;
+    if (vmo_ == MX_HANDLE_INVALID) {
+        // First access to the file? Allocate it.
+        if ((status = mx_vmo_create(0, 0, &vmo_)) != NO_ERROR) {
+            return status;
+        }
+    }
+
+    mx_rights_t rights = MX_RIGHT_TRANSFER | MX_RIGHT_MAP |
+                         MX_RIGHT_DUPLICATE | MX_RIGHT_GET_PROPERTY;
+    rights |= (flags & MXIO_MMAP_FLAG_READ) ? MX_RIGHT_READ : 0;
+    rights |= (flags & MXIO_MMAP_FLAG_EXEC) ? MX_RIGHT_EXECUTE : 0;
+
+    // Return a copy-on-write clone of the backing VMO, so consumers see a
+    // snapshot of the file: later writes to the file do not alter the
+    // mapping, and the mapping cannot alter the file.
+    mx_handle_t vmo;
+    if ((status = mx_vmo_clone(vmo_, MX_VMO_CLONE_COPY_ON_WRITE,
+                               0, length_, &vmo)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = mx_handle_replace(vmo, rights, out)) != NO_ERROR) {
+        mx_handle_close(vmo);
+        return status;
+    }
+    *off = 0;
+    return NO_ERROR;
+}
+
 bool VnodeDir::IsRemote() const { return remoter_.IsRemote(); }
 mx_handle_t VnodeDir::DetachRemote() { return remoter_.DetachRemote(flags_); }
 mx_handle_t VnodeDir::WaitForRemote() { return remoter_.WaitForRemote(flags_); }
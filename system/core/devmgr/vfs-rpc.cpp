@@ -9,6 +9,7 @@
 #include <threads.h>
 
 #include <fs/mxio-dispatcher.h>
+#include <fs/vfs-dispatcher.h>
 #include <fs/vfs.h>
 #include <magenta/device/device.h>
 #include <magenta/device/vfs.h>
@@ -31,6 +32,8 @@
 
 namespace memfs {
 
+static const unsigned kPoolSize = 4;
+
 static VnodeMemfs* global_vfs_root;
 
 void VnodeDir::NotifyAdd(const char* name, size_t len) { watcher_.NotifyAdd(name, len); }
@@ -64,7 +67,11 @@ mx_handle_t vfs_create_root_handle(VnodeMemfs* vn) {
 // Initialize the global root VFS node and dispatcher
 void vfs_global_init(VnodeDir* root) {
     memfs::global_vfs_root = root;
-    fs::MxioDispatcher::Create(&memfs::memfs_global_dispatcher);
+    if (fs::VfsDispatcher::Create(mxrio_handler, memfs::kPoolSize,
+                                  &memfs::memfs_global_dispatcher) != NO_ERROR) {
+        // fall back to the single-threaded dispatcher
+        fs::MxioDispatcher::Create(&memfs::memfs_global_dispatcher);
+    }
 }
 
 // Return a RIO handle to the global root
@@ -121,23 +121,23 @@ err:
 
 void netfile_read(uint32_t cookie, uint32_t arg,
                   const ip6_addr_t* saddr, uint16_t sport, uint16_t dport) {
-    netfilemsg m;
-    m.hdr.magic = NB_MAGIC;
-    m.hdr.cookie = cookie;
-    m.hdr.cmd = NB_ACK;
+    nbmsg hdr;
+    hdr.magic = NB_MAGIC;
+    hdr.cookie = cookie;
+    hdr.cmd = NB_ACK;
 
     if (netfile.fd < 0) {
         printf("netsvc: read, but no open file\n");
-        m.hdr.arg = -EBADF;
-        udp6_send(&m.hdr, sizeof(m.hdr), saddr, sport, dport);
+        hdr.arg = -EBADF;
+        udp6_send(&hdr, sizeof(hdr), saddr, sport, dport);
         return;
     }
     if (arg == (netfile.blocknum - 1)) {
         // repeat of last block read, probably due to dropped packet
         // unless cookie doesn't match, in which case it's an error
         if (cookie != netfile.cookie) {
-            m.hdr.arg = -EIO;
-            udp6_send(&m.hdr, sizeof(m.hdr), saddr, sport, dport);
+            hdr.arg = -EIO;
+            udp6_send(&hdr, sizeof(hdr), saddr, sport, dport);
             return;
         }
     } else if (arg != netfile.blocknum) {
@@ -148,10 +148,10 @@ void netfile_read(uint32_t cookie, uint32_t arg,
         if (n < 0) {
             n = 0;
             printf("netsvc: error reading '%s': %d\n", netfile.filename, errno);
-            m.hdr.arg = -errno;
+            hdr.arg = -errno;
             close(netfile.fd);
             netfile.fd = -1;
-            udp6_send(&m.hdr, sizeof(m.hdr), saddr, sport, dport);
+            udp6_send(&hdr, sizeof(hdr), saddr, sport, dport);
             return;
         }
         netfile.datasize = n;
@@ -159,9 +159,17 @@ void netfile_read(uint32_t cookie, uint32_t arg,
         netfile.cookie = cookie;
     }
 
-    m.hdr.arg = arg;
-    memcpy(m.data, netfile.data, netfile.datasize);
-    udp6_send(&m, sizeof(m.hdr) + netfile.datasize, saddr, sport, dport);
+    // compose the reply directly in a transmit buffer so the block
+    // is copied once, not staged through a stack message first
+    netfilemsg* m;
+    eth_buffer_t* ethbuf;
+    if (udp6_get_buffer((void**)&m, &ethbuf)) {
+        return;
+    }
+    hdr.arg = arg;
+    m->hdr = hdr;
+    memcpy(m->data, netfile.data, netfile.datasize);
+    udp6_send_from(ethbuf, m, sizeof(m->hdr) + netfile.datasize, saddr, sport, dport);
 }
 
 void netfile_write(const char* data, size_t len, uint32_t cookie, uint32_t arg,
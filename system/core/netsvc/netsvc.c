@@ -33,22 +33,33 @@ static mx_handle_t loghandle;
 
 static bool netbootloader = false;
 
+// the kernel packs as many whole records as fit per read, each record
+// after the first starting on a 4 byte boundary; draining a batch per
+// syscall keeps up with boot-time log floods
+static char logbatch[MX_LOG_RECORD_MAX * 4];
+static size_t logbatch_len = 0;
+static size_t logbatch_off = 0;
+
 int get_log_line(char* out) {
-    char buf[MX_LOG_RECORD_MAX + 1];
-    mx_log_record_t* rec = (mx_log_record_t*)buf;
-    if (mx_log_read(loghandle, MX_LOG_RECORD_MAX, rec, 0) > 0) {
-        if (rec->datalen && (rec->data[rec->datalen - 1] == '\n')) {
-            rec->datalen--;
+    if (logbatch_off >= logbatch_len) {
+        mx_status_t status = mx_log_read(loghandle, sizeof(logbatch), logbatch, 0);
+        if (status <= 0) {
+            return 0;
         }
-        rec->data[rec->datalen] = 0;
-        snprintf(out, MAX_LOG_LINE, "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %s\n",
-                 (int)(rec->timestamp / 1000000000ULL),
-                 (int)((rec->timestamp / 1000000ULL) % 1000ULL),
-                 rec->pid, rec->tid, rec->data);
-        return strlen(out);
-    } else {
-        return 0;
+        logbatch_len = status;
+        logbatch_off = 0;
+    }
+    mx_log_record_t* rec = (mx_log_record_t*)(logbatch + logbatch_off);
+    logbatch_off += (sizeof(mx_log_record_t) + rec->datalen + 3) & ~3ul;
+    unsigned datalen = rec->datalen;
+    if (datalen && (rec->data[datalen - 1] == '\n')) {
+        datalen--;
     }
+    snprintf(out, MAX_LOG_LINE, "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %.*s\n",
+             (int)(rec->timestamp / 1000000000ULL),
+             (int)((rec->timestamp / 1000000ULL) % 1000ULL),
+             rec->pid, rec->tid, (int)datalen, rec->data);
+    return strlen(out);
 }
 
 static volatile uint32_t seqno = 1;
@@ -169,8 +180,8 @@ void udp6_recv(void* data, size_t len,
     }
 }
 
-void netifc_recv(void* data, size_t len) {
-    eth_recv(data, len);
+void netifc_recv(void* data, size_t len, uint32_t flags) {
+    eth_recv(data, len, flags);
 }
 
 int main(int argc, char** argv) {
@@ -258,7 +258,29 @@ static void vc_tc_copy_lines(void* cookie, int y_dest, int y_src, int line_count
 
         vc_status_update();
         vc_gfx_invalidate_status();
-        vc_invalidate_lines(vc, 0, vc_rows(vc));
+        if (vc_gfx_copy_region(vc, 0, y_src * vc->charh,
+                               vc_gfx->width, line_count * vc->charh,
+                               0, y_dest * vc->charh) == NO_ERROR) {
+            // The 2D engine moved the band on the display itself, so it
+            // needs no flush; only lines that were already out of sync
+            // (and their moved images) still do.  The lines the scroll
+            // exposes are invalidated by the caller when it clears them.
+            if (vc->invy1 >= 0) {
+                int delta = y_dest - y_src;
+                int y0 = MAX(vc->invy0 + delta, 0);
+                int y1 = MIN(vc->invy1 + delta, vc_rows(vc));
+                if (y1 > y0) {
+                    vc_invalidate_lines(vc, y0, y1 - y0);
+                }
+            }
+        } else {
+            // Only the band of lines the blit moved changed on screen;
+            // the lines the scroll exposes are invalidated by the caller
+            // when it clears them.
+            int y0 = MIN(y_dest, y_src);
+            int y1 = MAX(y_dest, y_src) + line_count;
+            vc_invalidate_lines(vc, y0, y1 - y0);
+        }
     }
 }
 
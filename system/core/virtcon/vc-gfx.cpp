@@ -89,6 +89,12 @@ void vc_gfx_invalidate_region(vc_t* vc, unsigned x, unsigned y, unsigned w, unsi
         gfx_blend(vc_test_gfx, vc_gfx, x, y, w, h, x, desty);
     }
 }
+
+mx_status_t vc_gfx_copy_region(vc_t*, unsigned, unsigned, unsigned, unsigned,
+                               unsigned, unsigned) {
+    // no display under test; force the invalidate path
+    return ERR_NOT_SUPPORTED;
+}
 #else
 static int vc_gfx_fd = -1;
 static mx_handle_t vc_gfx_vmo = 0;
@@ -188,6 +194,31 @@ void vc_gfx_invalidate_region(vc_t* vc, unsigned x, unsigned y, unsigned w, unsi
     }
 }
 
+// pixel coords, relative to the main surface
+mx_status_t vc_gfx_copy_region(vc_t* vc, unsigned x, unsigned y, unsigned w, unsigned h,
+                               unsigned dest_x, unsigned dest_y) {
+    static bool hw_copy = true;
+    if (!hw_copy || !vc->active) {
+        return ERR_NOT_SUPPORTED;
+    }
+    mx_display_blit_t args = {
+        .src_x = x,
+        .src_y = vc->charh + y,
+        .dest_x = dest_x,
+        .dest_y = vc->charh + dest_y,
+        .width = w,
+        .height = h,
+        .color = 0,
+        .flags = 0,
+    };
+    ssize_t r = ioctl_display_copy_rect(vc_gfx_fd, &args);
+    if (r == ERR_NOT_SUPPORTED) {
+        // no 2D engine behind this display; stop asking
+        hw_copy = false;
+    }
+    return (r < 0) ? (mx_status_t)r : NO_ERROR;
+}
+
 // text coords
 void vc_gfx_invalidate(vc_t* vc, unsigned x, unsigned y, unsigned w, unsigned h) {
     if (vc->active) {
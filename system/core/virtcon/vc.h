@@ -137,6 +137,13 @@ void vc_gfx_invalidate_status();
 void vc_gfx_invalidate(vc_t* vc, unsigned x, unsigned y, unsigned w, unsigned h);
 // invalidates a region in pixels
 void vc_gfx_invalidate_region(vc_t* vc, unsigned x, unsigned y, unsigned w, unsigned h);
+// copies a region (in pixels, relative to the main surface) on the
+// display itself with the 2D engine; the caller must have applied the
+// same copy to the shadow surface and flushed the source region.
+// Returns ERR_NOT_SUPPORTED when there is no 2D engine and the caller
+// must invalidate instead.
+mx_status_t vc_gfx_copy_region(vc_t* vc, unsigned x, unsigned y, unsigned w, unsigned h,
+                               unsigned dest_x, unsigned dest_y);
 void vc_gfx_draw_char(vc_t* vc, vc_char_t ch, unsigned x, unsigned y,
                       bool invert);
 
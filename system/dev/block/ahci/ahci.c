@@ -60,6 +60,7 @@ typedef struct ahci_port {
     mtx_t lock;
 
     uint32_t running;   // bitmask of running commands
+    uint32_t issuing;   // bitmask of slots reserved but not yet issued to hardware
     uint32_t completed; // bitmask of completed commands
     iotxn_t* commands[AHCI_MAX_COMMANDS]; // commands in flight
 
@@ -204,8 +205,10 @@ static bool cmd_is_queued(uint8_t cmd) {
 
 static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, mx_status_t status) {
     mtx_lock(&port->lock);
-    uint32_t sact = ahci_read(&port->regs->sact);
-    uint32_t running = port->running;
+    // ignore slots that are reserved but not yet issued to hardware; they
+    // will raise their own interrupt once they actually complete
+    uint32_t sact = ahci_read(&port->regs->sact) & ~port->issuing;
+    uint32_t running = port->running & ~port->issuing;
     uint32_t done = sact ^ running;
     // assert if a channel without an outstanding transaction is active
     MX_DEBUG_ASSERT(!(done & sact));
@@ -215,16 +218,30 @@ static void ahci_port_complete_txn(ahci_device_t* dev, ahci_port_t* port, mx_sta
     completion_signal(&dev->worker_completion);
 }
 
+// release a slot reserved by the worker thread and fail its txn
+static mx_status_t ahci_abort_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
+                                  iotxn_t* txn, mx_status_t status) {
+    mtx_lock(&port->lock);
+    port->running &= ~(1 << slot);
+    port->issuing &= ~(1 << slot);
+    port->commands[slot] = NULL;
+    mtx_unlock(&port->lock);
+    iotxn_complete(txn, status, 0);
+    completion_signal(&dev->worker_completion);
+    return status;
+}
+
+// builds and issues the command for a slot already reserved by the worker
+// thread; runs without the port lock held so submission does not serialize
+// against completion processing
 static mx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot, iotxn_t* txn) {
     assert(slot < AHCI_MAX_COMMANDS);
-    assert(!ahci_port_cmd_busy(port, slot));
+    assert(port->commands[slot] == txn);
 
     sata_pdata_t* pdata = sata_iotxn_pdata(txn);
     mx_status_t status = iotxn_physmap(txn);
     if (status != NO_ERROR) {
-        iotxn_complete(txn, status, 0);
-        completion_signal(&dev->worker_completion);
-        return status;
+        return ahci_abort_txn(dev, port, slot, txn, status);
     }
     iotxn_phys_iter_t iter;
     iotxn_phys_iter_init(&iter, txn, AHCI_PRD_MAX_SIZE);
@@ -286,16 +303,10 @@ static mx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
             break;
         } else if (length > AHCI_PRD_MAX_SIZE) {
             printf("ahci.%d: chunk size > %zu is unsupported\n", port->nr, length);
-            status = ERR_NOT_SUPPORTED;
-            iotxn_complete(txn, status, 0);
-            completion_signal(&dev->worker_completion);
-            return status;
+            return ahci_abort_txn(dev, port, slot, txn, ERR_NOT_SUPPORTED);
         } else if (cl->prdtl == AHCI_MAX_PRDS) {
             printf("ahci.%d: txn with more than %d chunks is unsupported\n", port->nr, cl->prdtl);
-            status = ERR_NOT_SUPPORTED;
-            iotxn_complete(txn, status, 0);
-            completion_signal(&dev->worker_completion);
-            return status;
+            return ahci_abort_txn(dev, port, slot, txn, ERR_NOT_SUPPORTED);
         }
 
         prd->dba = LO32(paddr);
@@ -305,18 +316,17 @@ static mx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
         prd += 1;
     }
 
-    port->running |= (1 << slot);
-    port->commands[slot] = txn;
-
-    // start command
+    // start the command; clearing the issuing bit and hitting the hardware
+    // must happen atomically with respect to the irq path or a completion
+    // could be lost
+    mtx_lock(&port->lock);
+    port->issuing &= ~(1 << slot);
     if (cmd_is_queued(pdata->cmd)) {
         ahci_write(&port->regs->sact, (1 << slot));
     }
     ahci_write(&port->regs->ci, (1 << slot));
+    mtx_unlock(&port->lock);
 
-    // set the watchdog
-    // TODO: general timeout mechanism
-    pdata->timeout = mx_time_get(MX_CLOCK_MONOTONIC) + MX_SEC(1);
     completion_signal(&dev->watchdog_completion);
     return NO_ERROR;
 }
@@ -480,39 +490,49 @@ static int ahci_worker_thread(void* arg) {
                 }
             }
 
-            if (port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) {
-                goto next;
-            }
+            // keep issuing queued commands until the slots are full
+            while (!(port->flags & AHCI_PORT_FLAG_SYNC_PAUSED)) {
+                txn = list_peek_head_type(&port->txn_list, iotxn_t, node);
+                if (!txn) {
+                    break;
+                }
 
-            txn = list_peek_head_type(&port->txn_list, iotxn_t, node);
-            if (!txn) {
-                goto next;
-            }
+                // if IOTXN_SYNC_BEFORE, pause the port if there are transactions in flight
+                if ((txn->flags & IOTXN_SYNC_BEFORE) && port->running) {
+                    port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                    break;
+                }
 
-            // if IOTXN_SYNC_BEFORE, pause the port if there are transactions in flight
-            if ((txn->flags & IOTXN_SYNC_BEFORE) && port->running) {
-                port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
-                goto next;
-            }
+                // find a free command tag
+                sata_pdata_t* pdata = sata_iotxn_pdata(txn);
+                int max = MIN(pdata->max_cmd, (int)((dev->cap >> 8) & 0x1f));
+                int slot = 0;
+                for (slot = 0; slot <= max; slot++) {
+                    if (!ahci_port_cmd_busy(port, slot)) break;
+                }
+                if (slot > max) {
+                    break;
+                }
 
-            // find a free command tag
-            sata_pdata_t* pdata = sata_iotxn_pdata(txn);
-            int max = MIN(pdata->max_cmd, (int)((dev->cap >> 8) & 0x1f));
-            int i = 0;
-            for (i = 0; i <= max; i++) {
-                if (!ahci_port_cmd_busy(port, i)) break;
-            }
-            if (i > max) {
-                goto next;
-            }
+                list_delete(&txn->node);
+                // if IOTXN_SYNC_AFTER, pause the port until this command is complete
+                if (txn->flags & IOTXN_SYNC_AFTER) {
+                    port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                }
 
-            list_delete(&txn->node);
-            // if IOTXN_SYNC_AFTER, pause the port until this command is complete
-            if (txn->flags & IOTXN_SYNC_AFTER) {
-                port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                // reserve the slot so the command can be built without
+                // holding the port lock
+                port->running |= (1 << slot);
+                port->issuing |= (1 << slot);
+                port->commands[slot] = txn;
+                // set the watchdog
+                // TODO: general timeout mechanism
+                pdata->timeout = mx_time_get(MX_CLOCK_MONOTONIC) + MX_SEC(1);
+
+                mtx_unlock(&port->lock);
+                ahci_do_txn(dev, port, slot, txn);
+                mtx_lock(&port->lock);
             }
-            // run the command
-            ahci_do_txn(dev, port, i, txn);
 next:
             mtx_unlock(&port->lock);
         }
@@ -8,6 +8,7 @@
 #include <ddk/protocol/block.h>
 
 #include <magenta/process.h>
+#include <magenta/syscalls.h>
 #include <magenta/types.h>
 #include <sys/param.h>
 #include <assert.h>
@@ -27,6 +28,12 @@ typedef struct blkdev {
 
     mtx_t lock;
     BlockServer* bs;
+
+    // Performance counters for the iotxn path. The fifo path is counted
+    // by the blockserver, and folded in when the stats are read.
+    mtx_t statlock;
+    block_stats_t stats;
+    uint32_t pending;
 } blkdev_t;
 
 static int blockserver_thread(void* arg) {
@@ -154,6 +161,24 @@ done:
     return status;
 }
 
+static mx_status_t blkdev_get_stats(blkdev_t* bdev, void* out_buf, size_t out_len) {
+    if (out_len < sizeof(block_stats_t)) {
+        return ERR_INVALID_ARGS;
+    }
+
+    block_stats_t* out = out_buf;
+    mtx_lock(&bdev->statlock);
+    memcpy(out, &bdev->stats, sizeof(block_stats_t));
+    mtx_unlock(&bdev->statlock);
+
+    mtx_lock(&bdev->lock);
+    if (bdev->bs != NULL) {
+        blockserver_get_stats(bdev->bs, out);
+    }
+    mtx_unlock(&bdev->lock);
+    return sizeof(block_stats_t);
+}
+
 static mx_status_t blkdev_fifo_close(blkdev_t* bdev) {
     mtx_lock(&bdev->lock);
     if (bdev->bs != NULL) {
@@ -183,14 +208,54 @@ static mx_status_t blkdev_ioctl(void* ctx, uint32_t op, const void* cmd,
         return blkdev_free_txn(blkdev, cmd, cmdlen);
     case IOCTL_BLOCK_FIFO_CLOSE:
         return blkdev_fifo_close(blkdev);
+    case IOCTL_BLOCK_GET_STATS:
+        return blkdev_get_stats(blkdev, reply, max);
     default:
         return device_op_ioctl(blkdev->parent, op, cmd, cmdlen, reply, max, out_actual);
     }
 }
 
+static void blkdev_iotxn_complete(iotxn_t* clone, void* cookie) {
+    iotxn_t* txn = cookie;
+    blkdev_t* blkdev = (blkdev_t*)(uintptr_t)clone->extra[0];
+    uint64_t now = mx_time_get(MX_CLOCK_MONOTONIC);
+
+    mtx_lock(&blkdev->statlock);
+    block_stats_complete(&blkdev->stats, clone->opcode == IOTXN_OP_WRITE,
+                         clone->status, clone->actual, blkdev->pending,
+                         now - clone->extra[1]);
+    blkdev->pending--;
+    mtx_unlock(&blkdev->statlock);
+
+    mx_status_t status = clone->status;
+    mx_off_t actual = clone->actual;
+    iotxn_release(clone);
+    iotxn_complete(txn, status, actual);
+}
+
 static void blkdev_iotxn_queue(void* ctx, iotxn_t* txn) {
     blkdev_t* blkdev = ctx;
-    iotxn_queue(blkdev->parent, txn);
+
+    // Interpose on completion with a clone so request latency and queue
+    // depth can be recorded. The clone shares the payload vmo, so no data
+    // is copied, and clones are recycled through the iotxn free list.
+    iotxn_t* clone = NULL;
+    if (iotxn_clone(txn, &clone) != NO_ERROR) {
+        iotxn_queue(blkdev->parent, txn);
+        return;
+    }
+    clone->complete_cb = blkdev_iotxn_complete;
+    clone->cookie = txn;
+    clone->extra[0] = (uintptr_t)blkdev;
+    clone->extra[1] = mx_time_get(MX_CLOCK_MONOTONIC);
+
+    mtx_lock(&blkdev->statlock);
+    if (++blkdev->pending > blkdev->stats.max_depth) {
+        blkdev->stats.max_depth = blkdev->pending;
+    }
+    mtx_unlock(&blkdev->statlock);
+
+    iotxn_queue(blkdev->parent, clone);
 }
 
 static mx_off_t blkdev_get_size(void* ctx) {
@@ -224,6 +289,7 @@ static mx_status_t block_driver_bind(void* ctx, mx_device_t* dev, void** cookie)
         return ERR_NO_MEMORY;
     }
     mtx_init(&bdev->lock, mtx_plain);
+    mtx_init(&bdev->statlock, mtx_plain);
     bdev->parent = dev;
 
     mx_status_t status;
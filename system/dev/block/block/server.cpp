@@ -17,10 +17,13 @@
 
 #include "server.h"
 
+// Reads as many queued requests as fit in one call, so a client which
+// batched its writes costs one wakeup per batch rather than one per request.
 static mx_status_t do_read(mx_handle_t fifo, block_fifo_request_t* requests, uint32_t* count) {
     mx_status_t status;
     while (true) {
-        status = mx_fifo_read(fifo, requests, sizeof(block_fifo_request_t), count);
+        status = mx_fifo_read(fifo, requests,
+                              sizeof(block_fifo_request_t) * BLOCK_FIFO_MAX_DEPTH, count);
         if (status == ERR_SHOULD_WAIT) {
             mx_signals_t signals;
             if ((status = mx_object_wait_one(fifo,
@@ -160,6 +163,39 @@ mx_status_t BlockServer::AttachVmo(mx::vmo vmo, vmoid_t* out) {
     return NO_ERROR;
 }
 
+void BlockServer::GetStats(block_stats_t* out) {
+    mxtl::AutoLock stat_lock(&stat_lock_);
+    out->reads += stats_.reads;
+    out->writes += stats_.writes;
+    out->errors += stats_.errors;
+    out->bytes_read += stats_.bytes_read;
+    out->bytes_written += stats_.bytes_written;
+    if (stats_.max_depth > out->max_depth) {
+        out->max_depth = stats_.max_depth;
+    }
+    for (size_t i = 0; i < BLOCK_STATS_LATENCY_BUCKETS; i++) {
+        out->latency[i] += stats_.latency[i];
+    }
+    for (size_t i = 0; i < BLOCK_STATS_DEPTH_BUCKETS; i++) {
+        out->depth[i] += stats_.depth[i];
+    }
+}
+
+void BlockServer::TxnQueued() {
+    mxtl::AutoLock stat_lock(&stat_lock_);
+    if (++pending_ > stats_.max_depth) {
+        stats_.max_depth = pending_;
+    }
+}
+
+void BlockServer::TxnComplete(block_msg_t* msg, mx_status_t status) {
+    uint64_t now = mx_time_get(MX_CLOCK_MONOTONIC);
+    mxtl::AutoLock stat_lock(&stat_lock_);
+    block_stats_complete(&stats_, msg->write, status, msg->length,
+                         pending_, now - msg->submit_time);
+    pending_--;
+}
+
 mx_status_t BlockServer::AllocateTxn(txnid_t* out) {
     mxtl::AutoLock server_lock(&server_lock_);
     for (size_t i = 0; i < countof(txns_); i++) {
@@ -210,6 +246,7 @@ void blockserver_fifo_complete(void* cookie, mx_status_t status) {
     // and is not discarded underneath the block device driver.
     MX_DEBUG_ASSERT(msg->iobuf != nullptr);
     MX_DEBUG_ASSERT(msg->txn != nullptr);
+    msg->server->TxnComplete(msg, status);
     // Hold an extra copy of the 'txn' refptr; if we don't, and 'msg->txn' is
     // the last copy, then when we nullify 'msg->txn' in Complete we end up
     // trying to unlock a lock in a deleted BlockTxn.
@@ -274,6 +311,11 @@ mx_status_t BlockServer::Serve(mx_device_t* dev, block_ops_t* ops) {
                 msg->txn = txns_[txnid];
                 MX_DEBUG_ASSERT(msg->iobuf == nullptr);
                 msg->iobuf = iobuf.CopyPointer();
+                msg->server = this;
+                msg->submit_time = mx_time_get(MX_CLOCK_MONOTONIC);
+                msg->length = requests[i].length;
+                msg->write = (requests[i].opcode & BLOCKIO_OP_MASK) == BLOCKIO_WRITE;
+                TxnQueued();
 
                 // Hack to ensure that the vmo is valid.
                 // In the future, this code will be responsible for pinning VMO pages,
@@ -314,7 +356,9 @@ mx_status_t BlockServer::Serve(mx_device_t* dev, block_ops_t* ops) {
     }
 }
 
-BlockServer::BlockServer() : last_id(0) {}
+BlockServer::BlockServer() : last_id(0), pending_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+}
 BlockServer::~BlockServer() {
     ShutDown();
 }
@@ -349,3 +393,6 @@ mx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out) {
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid) {
     return bs->FreeTxn(txnid);
 }
+void blockserver_get_stats(BlockServer* bs, block_stats_t* out) {
+    bs->GetStats(out);
+}
@@ -50,9 +50,15 @@ constexpr uint32_t kTxnFlagRespond = 0x00000001; // Should a reponse be sent whe
 
 class BlockTransaction;
 
+class BlockServer;
+
 typedef struct {
     mxtl::RefPtr<BlockTransaction> txn;
     mxtl::RefPtr<IoBuffer> iobuf;
+    BlockServer* server;
+    uint64_t submit_time;
+    uint64_t length;
+    bool write;
 } block_msg_t;
 
 class BlockTransaction : public mxtl::RefCounted<BlockTransaction> {
@@ -91,6 +97,11 @@ public:
     mx_status_t AllocateTxn(txnid_t* out);
     void FreeTxn(txnid_t txnid);
 
+    // Accumulate this server's counters into 'out'
+    void GetStats(block_stats_t* out);
+    void TxnQueued();
+    void TxnComplete(block_msg_t* msg, mx_status_t status);
+
     void ShutDown();
 
     ~BlockServer();
@@ -105,6 +116,10 @@ private:
     mxtl::WAVLTree<vmoid_t, mxtl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
     mxtl::RefPtr<BlockTransaction> txns_[MAX_TXN_COUNT] TA_GUARDED(server_lock_);
     vmoid_t last_id TA_GUARDED(server_lock_);
+
+    mxtl::Mutex stat_lock_;
+    block_stats_t stats_ TA_GUARDED(stat_lock_);
+    uint32_t pending_ TA_GUARDED(stat_lock_);
 };
 
 #else
@@ -116,6 +131,40 @@ typedef struct BlockServer BlockServer;
 
 __BEGIN_CDECLS
 
+// Record one completed request in 'stats'. 'depth' is the number of
+// requests outstanding when it completed (including itself) and
+// 'latency' the time from queue to completion.
+static inline void block_stats_complete(block_stats_t* stats, bool write,
+                                        mx_status_t status, uint64_t bytes,
+                                        uint32_t depth, uint64_t latency_ns) {
+    if (write) {
+        stats->writes++;
+    } else {
+        stats->reads++;
+    }
+    if (status != NO_ERROR) {
+        stats->errors++;
+    } else if (write) {
+        stats->bytes_written += bytes;
+    } else {
+        stats->bytes_read += bytes;
+    }
+
+    uint64_t usec = latency_ns / 1000;
+    unsigned bucket = 0;
+    while ((usec >>= 1) && (bucket < BLOCK_STATS_LATENCY_BUCKETS - 1)) {
+        bucket++;
+    }
+    stats->latency[bucket]++;
+
+    if (depth > BLOCK_STATS_DEPTH_BUCKETS) {
+        depth = BLOCK_STATS_DEPTH_BUCKETS;
+    }
+    if (depth > 0) {
+        stats->depth[depth - 1]++;
+    }
+}
+
 // Allocate a new blockserver + FIFO combo
 mx_status_t blockserver_create(mx_handle_t* fifo_out, BlockServer** out);
 
@@ -135,4 +184,7 @@ mx_status_t blockserver_attach_vmo(BlockServer* bs, mx_handle_t vmo, vmoid_t* ou
 mx_status_t blockserver_allocate_txn(BlockServer* bs, txnid_t* out);
 void blockserver_free_txn(BlockServer* bs, txnid_t txnid);
 
+// Accumulate the blockserver's performance counters into 'out'
+void blockserver_get_stats(BlockServer* bs, block_stats_t* out);
+
 __END_CDECLS
@@ -316,10 +316,13 @@ static int gpt_bind_thread(void* arg) {
 
     completion_t completion = COMPLETION_INIT;
 
-    // read partition table header synchronously (LBA1)
+    // read the partition table header synchronously (LBA1). in the common
+    // layout the entry table immediately follows the header, so read enough
+    // to cover both and save a second round trip to the disk
     txn->opcode = IOTXN_OP_READ;
     txn->offset = block_info.block_size;
-    txn->length = block_info.block_size;
+    txn->length = MIN(TXN_SIZE,
+                      (block_info.block_count - 1) * block_info.block_size);
     txn->complete_cb = gpt_read_sync_complete;
     txn->cookie = &completion;
 
@@ -353,20 +356,38 @@ static int gpt_bind_thread(void* arg) {
         // enough to read the entries that actually contain valid data
         table_sz = TXN_SIZE;
     }
-    txn->opcode = IOTXN_OP_READ;
-    txn->offset = header.entries * block_info.block_size;
-    txn->length = table_sz;
-    txn->complete_cb = gpt_read_sync_complete;
-    txn->cookie = &completion;
-
-    completion_reset(&completion);
-    iotxn_queue(dev, txn);
-    completion_wait(&completion, MX_TIME_INFINITE);
 
     uint8_t entries[TXN_SIZE];
-    iotxn_copyfrom(txn, entries, txn->actual, 0);
+    size_t table_read;
+    uint64_t entries_offset = header.entries * block_info.block_size;
+    if (entries_offset >= (uint64_t)block_info.block_size &&
+        (entries_offset - block_info.block_size) + table_sz <= txn->actual) {
+        // the header read already covers the entry table
+        table_read = table_sz;
+        iotxn_copyfrom(txn, entries, table_read,
+                       entries_offset - block_info.block_size);
+    } else {
+        // the entry table lives somewhere the first read did not reach
+        txn->opcode = IOTXN_OP_READ;
+        txn->offset = entries_offset;
+        txn->length = table_sz;
+        txn->complete_cb = gpt_read_sync_complete;
+        txn->cookie = &completion;
+
+        completion_reset(&completion);
+        iotxn_queue(dev, txn);
+        completion_wait(&completion, MX_TIME_INFINITE);
+
+        if (txn->status != NO_ERROR) {
+            xprintf("gpt: error %d reading partition entries\n", txn->status);
+            goto unbind;
+        }
+
+        table_read = txn->actual;
+        iotxn_copyfrom(txn, entries, table_read, 0);
+    }
 
-    uint32_t crc = crc32(0, (const unsigned char*)entries, txn->actual);
+    uint32_t crc = crc32(0, (const unsigned char*)entries, table_read);
     if (crc != header.entries_crc) {
         xprintf("gpt: entries crc invalid\n");
         goto unbind;
@@ -375,7 +396,7 @@ static int gpt_bind_thread(void* arg) {
     uint64_t dev_block_count = block_info.block_count;
 
     for (partitions = 0; partitions < header.entries_count; partitions++) {
-        if (partitions * header.entries_sz > txn->actual) break;
+        if (partitions * header.entries_sz > table_read) break;
 
         // skip over entries that look invalid
         gpt_entry_t* entry = (gpt_entry_t*)(entries + (partitions * sizeof(gpt_entry_t)));
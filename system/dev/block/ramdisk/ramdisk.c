@@ -137,6 +137,20 @@ static mx_status_t ramdisk_ioctl(void* ctx, uint32_t op, const void* cmd,
     case IOCTL_BLOCK_RR_PART: {
         return device_rebind(ramdev->mxdev);
     }
+    case IOCTL_BLOCK_GET_MAPPABLE_VMO: {
+        mx_handle_t* out = reply;
+        if (max < sizeof(*out)) {
+            return ERR_BUFFER_TOO_SMALL;
+        }
+        // The ramdisk is nothing but its backing VMO; hand the client
+        // a duplicate so aligned I/O can bypass the driver entirely.
+        mx_status_t status = mx_handle_duplicate(ramdev->vmo, MX_RIGHT_SAME_RIGHTS, out);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        *out_actual = sizeof(*out);
+        return NO_ERROR;
+    }
     case IOCTL_DEVICE_SYNC: {
         // Wow, we sync so quickly!
         return NO_ERROR;
@@ -31,6 +31,10 @@
 #define USB_REQ_RESET               0xFF
 #define USB_REQ_GET_MAX_LUN         0xFE
 
+// interface protocols
+#define UMS_PROTOCOL_BOT            0x50    // Bulk-Only Transport
+#define UMS_PROTOCOL_UAS            0x62    // USB Attached SCSI
+
 // fs = feature selector, don't really know much about control requests,
 // so not sure what that means
 #define FS_ENDPOINT_HALT            0x00
@@ -73,13 +73,7 @@ static void ums_send_cbw(ums_t* ums, uint8_t lun, uint32_t transfer_length, uint
     ums_queue_request(ums, txn);
 }
 
-static mx_status_t ums_read_csw(ums_t* ums, uint32_t* out_residue) {
-    completion_t completion = COMPLETION_INIT;
-    iotxn_t* csw_request = ums->csw_iotxn;
-    csw_request->cookie = &completion;
-    ums_queue_request(ums, csw_request);
-    completion_wait(&completion, MX_TIME_INFINITE);
-
+static mx_status_t ums_interpret_csw(ums_t* ums, iotxn_t* csw_request, uint32_t* out_residue) {
     csw_status_t csw_error = ums_verify_csw(ums, csw_request, out_residue);
 
     if (csw_error == CSW_SUCCESS) {
@@ -95,6 +89,16 @@ static mx_status_t ums_read_csw(ums_t* ums, uint32_t* out_residue) {
     }
 }
 
+static mx_status_t ums_read_csw(ums_t* ums, uint32_t* out_residue) {
+    completion_t completion = COMPLETION_INIT;
+    iotxn_t* csw_request = ums->csw_iotxn;
+    csw_request->cookie = &completion;
+    ums_queue_request(ums, csw_request);
+    completion_wait(&completion, MX_TIME_INFINITE);
+
+    return ums_interpret_csw(ums, csw_request, out_residue);
+}
+
 static csw_status_t ums_verify_csw(ums_t* ums, iotxn_t* csw_request, uint32_t* out_residue) {
     ums_csw_t csw;
     iotxn_copyfrom(csw_request, &csw, sizeof(csw), 0);
@@ -237,8 +241,12 @@ static mx_status_t ums_mode_sense6(ums_t* ums, uint8_t lun, scsi_mode_sense_6_da
     return status;
 }
 
-static mx_status_t ums_data_transfer(ums_t* ums, iotxn_t* txn, mx_off_t offset, size_t length,
-                                     uint8_t ep_address) {
+// Queues the data stage and the CSW read back to back so the controller can
+// start the status stage as soon as the data stage drains, instead of paying
+// a completion callback round trip between the two. BOT only allows one
+// command in flight, so this is as deep as the pipeline can get without UAS.
+static mx_status_t ums_data_transfer_csw(ums_t* ums, iotxn_t* txn, mx_off_t offset, size_t length,
+                                         uint8_t ep_address, uint32_t* out_residue) {
     iotxn_t* clone = NULL;
     mx_status_t status = iotxn_clone_partial(txn, txn->vmo_offset + offset, length, &clone);
     if (status != NO_ERROR) {
@@ -250,18 +258,28 @@ static mx_status_t ums_data_transfer(ums_t* ums, iotxn_t* txn, mx_off_t offset,
     memset(pdata, 0, sizeof(*pdata));
     pdata->ep_address = ep_address;
 
-    completion_t completion = COMPLETION_INIT;
-    clone->cookie = &completion;
+    // the device serializes the data and status stages, so it is enough to
+    // wait for the CSW. by the time it completes the data stage is done too.
+    clone->cookie = NULL;
     ums_queue_request(ums, clone);
+
+    completion_t completion = COMPLETION_INIT;
+    iotxn_t* csw_request = ums->csw_iotxn;
+    csw_request->cookie = &completion;
+    ums_queue_request(ums, csw_request);
     completion_wait(&completion, MX_TIME_INFINITE);
 
     status = clone->status;
     if (status == NO_ERROR && clone->actual != length) {
         status = ERR_IO;
     }
-
     iotxn_release(clone);
-    return status;
+
+    mx_status_t csw_status = ums_interpret_csw(ums, csw_request, out_residue);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    return csw_status;
 }
 
 static ssize_t ums_read(ums_block_t* dev, iotxn_t* txn) {
@@ -316,13 +334,12 @@ static ssize_t ums_read(ums_block_t* dev, iotxn_t* txn) {
             ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
         }
 
-        status = ums_data_transfer(ums, txn, blocks_transferred * dev->block_size, length,
-                                   ums->bulk_in_addr);
+        // data stage and CSW, queued together
+        uint32_t residue = 0;
+        status = ums_data_transfer_csw(ums, txn, blocks_transferred * dev->block_size, length,
+                                       ums->bulk_in_addr, &residue);
         blocks_transferred += blocks;
 
-        // receive CSW
-        uint32_t residue;
-        status = ums_read_csw(ums, &residue);
         if (status == NO_ERROR && residue) {
             printf("unexpected residue in ums_read\n");
             status = ERR_IO;
@@ -387,13 +404,12 @@ static ssize_t ums_write(ums_block_t* dev, iotxn_t* txn) {
             ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
         }
 
-        status = ums_data_transfer(ums, txn, blocks_transferred * dev->block_size, length,
-                                   ums->bulk_out_addr);
+        // data stage and CSW, queued together
+        uint32_t residue = 0;
+        status = ums_data_transfer_csw(ums, txn, blocks_transferred * dev->block_size, length,
+                                       ums->bulk_out_addr, &residue);
         blocks_transferred += blocks;
 
-        // receive CSW
-        uint32_t residue;
-        status = ums_read_csw(ums, &residue);
         if (status == NO_ERROR && residue) {
             printf("unexpected residue in ums_write\n");
             status = ERR_IO;
@@ -693,6 +709,19 @@ static mx_status_t ums_bind(void* ctx, mx_device_t* device, void** cookie) {
         }
         endp = usb_desc_iter_next_endpoint(&iter);
     }
+
+    // USB3 drives commonly expose a UAS (USB Attached SCSI) alternate setting
+    // with command queuing on stream endpoints. We can't use it until xhci
+    // grows bulk stream support, so note it and stay on Bulk-Only Transport.
+    usb_desc_iter_reset(&iter);
+    usb_interface_descriptor_t* alt = usb_desc_iter_next_interface(&iter, false);
+    while (alt) {
+        if (alt->bInterfaceProtocol == UMS_PROTOCOL_UAS) {
+            printf("UMS: device supports UAS, falling back to Bulk-Only Transport\n");
+            break;
+        }
+        alt = usb_desc_iter_next_interface(&iter, false);
+    }
     usb_desc_iter_release(&iter);
 
     if (!bulk_in_addr || !bulk_out_addr) {
@@ -152,10 +152,33 @@ static mx_status_t bochs_vbe_get_framebuffer(mx_device_t* dev, void** framebuffe
     return NO_ERROR;
 }
 
+static mx_status_t bochs_vbe_get_framebuffer_vmo(mx_device_t* dev, mx_handle_t* out_vmo) {
+    assert(out_vmo);
+    bochs_vbe_device_t* vdev = dev->ctx;
+    return mx_handle_duplicate(vdev->framebuffer_handle, MX_RIGHT_SAME_RIGHTS, out_vmo);
+}
+
+static mx_status_t bochs_vbe_flip(mx_device_t* dev, mx_off_t offset) {
+    bochs_vbe_device_t* vdev = dev->ctx;
+    int bpp = mx_display_format_to_bpp(vdev->info.format);
+    assert(bpp >= 0);
+    uint32_t linesize = vdev->info.stride * ((bpp + 7) / 8);
+    if ((offset % linesize) ||
+        (offset + (uint64_t)vdev->info.height * linesize > vdev->framebuffer_size)) {
+        return ERR_INVALID_ARGS;
+    }
+    // The dispi interface scans out from a line offset into the virtual
+    // framebuffer, so a flip is a single register write.
+    bochs_vbe_dispi_write(vdev->regs, BOCHS_VBE_DISPI_Y_OFFSET, offset / linesize);
+    return NO_ERROR;
+}
+
 static mx_display_protocol_t bochs_vbe_display_proto = {
     .set_mode = bochs_vbe_set_mode,
     .get_mode = bochs_vbe_get_mode,
     .get_framebuffer = bochs_vbe_get_framebuffer,
+    .get_framebuffer_vmo = bochs_vbe_get_framebuffer_vmo,
+    .flip = bochs_vbe_flip,
 };
 
 // implement device protocol
@@ -39,6 +39,13 @@ struct fb {
     // event to notify which group is active
     mx_handle_t event;
 
+    // page flipping state; frame_count is 1 when the display cannot
+    // flip, and the scanout vmo and vsync event only exist when it can
+    uint32_t frame_count;
+    uint32_t frame;
+    mx_handle_t fb_vmo;
+    mx_handle_t vsync;
+
     // only one fullscreen client may exist at a time
     // and we keep track of it here
     fbi_t* fullscreen;
@@ -61,6 +68,16 @@ struct fbi {
     uint32_t group;
 };
 
+static void fb_flip_locked(fb_t* fb, uint32_t frame) {
+    mx_object_signal(fb->vsync, MX_USER_SIGNAL_0, 0);
+    if (fb->dpy->flip(fb->dpydev, (mx_off_t)frame * fb->bufsz) == NO_ERROR) {
+        fb->frame = frame;
+    }
+    // Our displays flip immediately; a driver with a real vblank
+    // interrupt would signal from its interrupt handler instead.
+    mx_object_signal(fb->vsync, 0, MX_USER_SIGNAL_0);
+}
+
 void fb_callback(bool acquired, void* cookie) {
     fb_t* fb = cookie;
     mtx_lock(&fb->lock);
@@ -144,6 +161,42 @@ static mx_status_t fbi_ioctl(void* ctx, uint32_t op,
         mtx_unlock(&fb->lock);
         return NO_ERROR;
 
+    case IOCTL_DISPLAY_FILL_RECT:
+    case IOCTL_DISPLAY_COPY_RECT: {
+        if (in_len != sizeof(mx_display_blit_t)) {
+            return ERR_INVALID_ARGS;
+        }
+        mx_status_t (*blit)(mx_device_t* dev, const mx_display_blit_t* args) =
+            (op == IOCTL_DISPLAY_COPY_RECT) ? fb->dpy->copy_rect : fb->dpy->fill_rect;
+        if (blit == NULL) {
+            return ERR_NOT_SUPPORTED;
+        }
+        const mx_display_blit_t* args = in_buf;
+        if ((args->dest_x >= fb->info.width) ||
+            (args->width > (fb->info.width - args->dest_x)) ||
+            (args->dest_y >= fb->info.height) ||
+            (args->height > (fb->info.height - args->dest_y))) {
+            return ERR_OUT_OF_RANGE;
+        }
+        if ((op == IOCTL_DISPLAY_COPY_RECT) &&
+            ((args->src_x >= fb->info.width) ||
+             (args->width > (fb->info.width - args->src_x)) ||
+             (args->src_y >= fb->info.height) ||
+             (args->height > (fb->info.height - args->src_y)))) {
+            return ERR_OUT_OF_RANGE;
+        }
+        mtx_lock(&fb->lock);
+        // like FLUSH_FB, blits from an inactive client are dropped;
+        // the client repaints in full when it becomes active again
+        if (fb->active == fbi->group) {
+            r = blit(fb->dpydev, args);
+        } else {
+            r = NO_ERROR;
+        }
+        mtx_unlock(&fb->lock);
+        return r;
+    }
+
     case IOCTL_DISPLAY_GET_FB: {
         if ((fbi->group == GROUP_FULLSCREEN) && FB_HAS_GPU(fb)) {
             printf("fb: fullscreen soft framebuffer not supported (GPU)\n");
@@ -189,6 +242,10 @@ static mx_status_t fbi_ioctl(void* ctx, uint32_t op,
         mtx_lock(&fb->lock);
         if ((*n == GROUP_VIRTCON) || (fb->fullscreen == NULL)) {
             fb->active = GROUP_VIRTCON;
+            if ((fb->frame_count > 1) && (fb->frame != 0)) {
+                // virtcon renders via the frame 0 shadow copy path
+                fb_flip_locked(fb, 0);
+            }
             mx_object_signal(fb->event, MX_USER_SIGNAL_1, MX_USER_SIGNAL_0);
         } else {
             fb->active = GROUP_FULLSCREEN;
@@ -203,6 +260,58 @@ static mx_status_t fbi_ioctl(void* ctx, uint32_t op,
         mtx_unlock(&fb->lock);
         return NO_ERROR;
     }
+    case IOCTL_DISPLAY_GET_FLIP_FB: {
+        if (out_len < sizeof(ioctl_display_get_flip_fb_t)) {
+            return ERR_BUFFER_TOO_SMALL;
+        }
+        if ((fb->frame_count < 2) || (fbi->group != GROUP_FULLSCREEN)) {
+            return ERR_NOT_SUPPORTED;
+        }
+        ioctl_display_get_flip_fb_t* out = out_buf;
+        memcpy(&out->info, &fb->info, sizeof(mx_display_info_t));
+        out->info.flags = 0;
+        out->frame_count = fb->frame_count;
+        out->frame_size = (uint32_t)fb->bufsz;
+        if ((r = mx_handle_duplicate(fb->fb_vmo, MX_RIGHT_SAME_RIGHTS, &out->vmo)) < 0) {
+            return r;
+        }
+        *out_actual = sizeof(ioctl_display_get_flip_fb_t);
+        return NO_ERROR;
+    }
+    case IOCTL_DISPLAY_FLIP_FB: {
+        if (in_len != sizeof(uint32_t)) {
+            return ERR_INVALID_ARGS;
+        }
+        if (fb->frame_count < 2) {
+            return ERR_NOT_SUPPORTED;
+        }
+        uint32_t frame = *((const uint32_t*)in_buf);
+        if (frame >= fb->frame_count) {
+            return ERR_OUT_OF_RANGE;
+        }
+        mtx_lock(&fb->lock);
+        // like FLUSH_FB, flips from an inactive client are dropped
+        if (fb->active == fbi->group) {
+            fb_flip_locked(fb, frame);
+        }
+        mtx_unlock(&fb->lock);
+        return NO_ERROR;
+    }
+    case IOCTL_DISPLAY_GET_VSYNC_EVENT: {
+        if (out_len != sizeof(mx_handle_t)) {
+            return ERR_INVALID_ARGS;
+        }
+        if (fb->frame_count < 2) {
+            return ERR_NOT_SUPPORTED;
+        }
+        mx_handle_t* out = (mx_handle_t*) out_buf;
+        if ((r = mx_handle_duplicate(fb->vsync, MX_RIGHT_READ | MX_RIGHT_TRANSFER | MX_RIGHT_DUPLICATE, out)) < 0) {
+            return r;
+        } else {
+            *out_actual = sizeof(mx_handle_t);
+            return NO_ERROR;
+        }
+    }
     case IOCTL_DISPLAY_GET_OWNERSHIP_CHANGE_EVENT: {
         if (out_len != sizeof(mx_handle_t)) {
             return ERR_INVALID_ARGS;
@@ -233,6 +342,9 @@ static void fbi_release(void* ctx) {
         fb->fullscreen = NULL;
         if (fb->active == GROUP_FULLSCREEN) {
             fb->active = GROUP_VIRTCON;
+            if ((fb->frame_count > 1) && (fb->frame != 0)) {
+                fb_flip_locked(fb, 0);
+            }
             mx_object_signal(fb->event, MX_USER_SIGNAL_1, MX_USER_SIGNAL_0);
         }
     }
@@ -314,6 +426,10 @@ static mx_status_t fb_open(void* ctx, mx_device_t** out, uint32_t flags) {
 static void fb_release(void* ctx) {
     fb_t* fb = ctx;
     mx_handle_close(fb->event);
+    if (fb->fb_vmo != MX_HANDLE_INVALID) {
+        mx_handle_close(fb->fb_vmo);
+        mx_handle_close(fb->vsync);
+    }
     free(fb);
 }
 
@@ -375,11 +491,33 @@ static mx_status_t fb_bind(void* ctx, mx_device_t* dev, void** cookie) {
 
     fb->bufsz = fb->info.pixelsize * fb->info.stride * fb->info.height;
 
-    printf("fb: %u x %u (stride=%u pxlsz=%u format=%u): %zu bytes @ %p%s\n",
+    // If the display can flip and its scanout memory holds more than one
+    // frame, enable page flipping: clients render directly into scanout
+    // frames and present with a register write instead of a full copy.
+    fb->frame_count = 1;
+    if (fb->dpy->flip && fb->dpy->get_framebuffer_vmo &&
+        (fb->dpy->get_framebuffer_vmo(dev, &fb->fb_vmo) == NO_ERROR)) {
+        uint64_t fbsz = 0;
+        mx_vmo_get_size(fb->fb_vmo, &fbsz);
+        uint64_t frames = fbsz / fb->bufsz;
+        if (frames > 3) {
+            // triple buffering is plenty
+            frames = 3;
+        }
+        if ((frames < 2) || (mx_event_create(0, &fb->vsync) < 0)) {
+            mx_handle_close(fb->fb_vmo);
+            fb->fb_vmo = MX_HANDLE_INVALID;
+        } else {
+            fb->frame_count = (uint32_t)frames;
+        }
+    }
+
+    printf("fb: %u x %u (stride=%u pxlsz=%u format=%u): %zu bytes @ %p%s%s\n",
            fb->info.width, fb->info.height,
            fb->info.stride, fb->info.pixelsize, fb->info.format, fb->bufsz,
            fb->buffer,
-           FB_HAS_GPU(fb) ? " GPU" : " SW");
+           FB_HAS_GPU(fb) ? " GPU" : " SW",
+           (fb->frame_count > 1) ? " FLIP" : "");
 
     mtx_init(&fb->lock, mtx_plain);
 
@@ -403,6 +541,10 @@ static mx_status_t fb_bind(void* ctx, mx_device_t* dev, void** cookie) {
 
 fail:
     mx_handle_close(fb->event);
+    if (fb->fb_vmo != MX_HANDLE_INVALID) {
+        mx_handle_close(fb->fb_vmo);
+        mx_handle_close(fb->vsync);
+    }
     free(fb);
     return r;
 }
@@ -25,6 +25,25 @@
 #define BACKLIGHT_CTRL_OFFSET (0xc8250)
 #define BACKLIGHT_CTRL_BIT ((uint32_t)(1u << 31))
 
+// blitter (BCS) command ring registers
+#define BCS_RING_TAIL (0x22030)
+#define BCS_RING_HEAD (0x22034)
+#define BCS_RING_START (0x22038)
+#define BCS_RING_CTL (0x2203c)
+
+#define BCS_RING_SIZE (4096u)
+
+// blitter commands
+#define XY_COLOR_BLT ((0x2u << 29) | (0x50 << 22))
+#define XY_SRC_COPY_BLT ((0x2u << 29) | (0x53 << 22))
+#define BLT_WRITE_ALPHA_RGB (0x3 << 20)
+#define BLT_ROP_FILL (0xf0 << 16)
+#define BLT_ROP_COPY (0xcc << 16)
+#define BLT_DEPTH_565 (0x1 << 24)
+#define BLT_DEPTH_8888 (0x3 << 24)
+#define MI_FLUSH_DW ((0x26u << 23) | 3)
+#define MI_NOOP (0u)
+
 #define TRACE 0
 
 #if TRACE
@@ -47,9 +66,18 @@ typedef struct intel_i915_device {
 
     mx_display_info_t info;
     uint32_t flags;
+
+    // 2D blitter engine state; the ring page lives in the aperture
+    // just past the visible framebuffer
+    void* blt_ring;
+    uint32_t blt_tail;
+    uint32_t blt_pitch; // framebuffer pitch in bytes
+    uint32_t blt_depth; // BR13 color depth field
+    uint32_t blt_wmask; // DW0 write-mask bits (32bpp only)
 } intel_i915_device_t;
 
 #define FLAGS_BACKLIGHT 1
+#define FLAGS_BLT_RING 2
 
 static void intel_i915_enable_backlight(intel_i915_device_t* dev, bool enable) {
     if (dev->flags & FLAGS_BACKLIGHT) {
@@ -65,8 +93,134 @@ static void intel_i915_enable_backlight(intel_i915_device_t* dev, bool enable) {
     }
 }
 
+// 2D blitter engine
+//
+// Commands are written into a single-page ring and kicked by advancing
+// the tail register; blits are serialized by our caller (the framebuffer
+// core), so no locking is needed here.
+
+static inline void* intel_i915_reg(intel_i915_device_t* dev, uint32_t offset) {
+    return (uint8_t*)dev->regs + offset;
+}
+
+static inline void intel_i915_blt_emit(intel_i915_device_t* dev, uint32_t dw) {
+    ((volatile uint32_t*)dev->blt_ring)[dev->blt_tail / 4] = dw;
+    dev->blt_tail = (dev->blt_tail + 4) & (BCS_RING_SIZE - 1);
+}
+
+// flush the preceding blits and wait for the engine to go idle
+static mx_status_t intel_i915_blt_wait(intel_i915_device_t* dev) {
+    intel_i915_blt_emit(dev, MI_FLUSH_DW);
+    intel_i915_blt_emit(dev, 0);
+    intel_i915_blt_emit(dev, 0);
+    intel_i915_blt_emit(dev, 0);
+    intel_i915_blt_emit(dev, 0);
+    if (dev->blt_tail & 0x7) {
+        // the tail may only be advanced to a qword boundary
+        intel_i915_blt_emit(dev, MI_NOOP);
+    }
+    __sync_synchronize();
+    pcie_write32(intel_i915_reg(dev, BCS_RING_TAIL), dev->blt_tail);
+
+    mx_time_t deadline = mx_time_get(MX_CLOCK_MONOTONIC) + MX_MSEC(100);
+    while ((pcie_read32(intel_i915_reg(dev, BCS_RING_HEAD)) & (BCS_RING_SIZE - 1)) !=
+           dev->blt_tail) {
+        if (mx_time_get(MX_CLOCK_MONOTONIC) > deadline) {
+            // engine wedged; disable acceleration rather than hanging clients
+            printf("i915: blitter timeout, disabling 2D engine\n");
+            dev->flags &= ~FLAGS_BLT_RING;
+            return ERR_TIMED_OUT;
+        }
+    }
+    return NO_ERROR;
+}
+
+static void intel_i915_blt_emit_copy(intel_i915_device_t* dev,
+                                     uint32_t src_x, uint32_t src_y,
+                                     uint32_t dest_x, uint32_t dest_y,
+                                     uint32_t width, uint32_t height) {
+    // the scanout surface lives at GGTT offset 0
+    intel_i915_blt_emit(dev, XY_SRC_COPY_BLT | dev->blt_wmask | (10 - 2));
+    intel_i915_blt_emit(dev, BLT_ROP_COPY | dev->blt_depth | dev->blt_pitch);
+    intel_i915_blt_emit(dev, (dest_y << 16) | dest_x);
+    intel_i915_blt_emit(dev, ((dest_y + height) << 16) | (dest_x + width));
+    intel_i915_blt_emit(dev, 0);
+    intel_i915_blt_emit(dev, 0);
+    intel_i915_blt_emit(dev, (src_y << 16) | src_x);
+    intel_i915_blt_emit(dev, dev->blt_pitch);
+    intel_i915_blt_emit(dev, 0);
+    intel_i915_blt_emit(dev, 0);
+}
+
 // implement display protocol
 
+static mx_status_t intel_i915_fill_rect(mx_device_t* dev, const mx_display_blit_t* args) {
+    intel_i915_device_t* device = dev->ctx;
+    if (!(device->flags & FLAGS_BLT_RING) || (args->flags != 0)) {
+        return ERR_NOT_SUPPORTED;
+    }
+    if ((args->width == 0) || (args->height == 0)) {
+        return NO_ERROR;
+    }
+    intel_i915_blt_emit(device, XY_COLOR_BLT | device->blt_wmask | (7 - 2));
+    intel_i915_blt_emit(device, BLT_ROP_FILL | device->blt_depth | device->blt_pitch);
+    intel_i915_blt_emit(device, (args->dest_y << 16) | args->dest_x);
+    intel_i915_blt_emit(device, ((args->dest_y + args->height) << 16) |
+                                (args->dest_x + args->width));
+    intel_i915_blt_emit(device, 0);
+    intel_i915_blt_emit(device, 0);
+    intel_i915_blt_emit(device, args->color);
+    return intel_i915_blt_wait(device);
+}
+
+static mx_status_t intel_i915_copy_rect(mx_device_t* dev, const mx_display_blit_t* args) {
+    intel_i915_device_t* device = dev->ctx;
+    if (!(device->flags & FLAGS_BLT_RING)) {
+        return ERR_NOT_SUPPORTED;
+    }
+    if (args->flags != 0) {
+        // this blitter generation has no colorkey mode
+        return ERR_NOT_SUPPORTED;
+    }
+    if ((args->width == 0) || (args->height == 0) ||
+        ((args->src_x == args->dest_x) && (args->src_y == args->dest_y))) {
+        return NO_ERROR;
+    }
+
+    bool x_overlap = (args->dest_x < (args->src_x + args->width)) &&
+                     (args->src_x < (args->dest_x + args->width));
+    if ((args->dest_y == args->src_y) && x_overlap && (args->dest_x > args->src_x)) {
+        // within a row the engine reads left to right, so a rightward
+        // overlapping copy would read pixels it has already written
+        return ERR_NOT_SUPPORTED;
+    }
+    if ((args->dest_y > args->src_y) && (args->dest_y < (args->src_y + args->height)) &&
+        x_overlap) {
+        // The engine copies rows top to bottom, so an overlapping copy to
+        // a lower position would read rows it has already overwritten.
+        // Copy in bands no taller than the row gap, bottom band first.
+        uint32_t gap = args->dest_y - args->src_y;
+        uint32_t left = args->height;
+        while (left > 0) {
+            uint32_t band = (left < gap) ? left : gap;
+            intel_i915_blt_emit_copy(device, args->src_x, args->src_y + left - band,
+                                     args->dest_x, args->dest_y + left - band,
+                                     args->width, band);
+            left -= band;
+            // waiting per band keeps the single-page ring from overflowing
+            mx_status_t status = intel_i915_blt_wait(device);
+            if (status != NO_ERROR) {
+                return status;
+            }
+        }
+        return NO_ERROR;
+    }
+
+    intel_i915_blt_emit_copy(device, args->src_x, args->src_y,
+                             args->dest_x, args->dest_y, args->width, args->height);
+    return intel_i915_blt_wait(device);
+}
+
 static mx_status_t intel_i915_set_mode(mx_device_t* dev, mx_display_info_t* info) {
     return ERR_NOT_SUPPORTED;
 }
@@ -89,6 +243,8 @@ static mx_display_protocol_t intel_i915_display_proto = {
     .set_mode = intel_i915_set_mode,
     .get_mode = intel_i915_get_mode,
     .get_framebuffer = intel_i915_get_framebuffer,
+    .fill_rect = intel_i915_fill_rect,
+    .copy_rect = intel_i915_copy_rect,
 };
 
 // implement device protocol
@@ -107,6 +263,11 @@ static void intel_i915_release(void* ctx) {
     intel_i915_device_t* device = ctx;
     intel_i915_enable_backlight(device, false);
 
+    if (device->flags & FLAGS_BLT_RING) {
+        device->flags &= ~FLAGS_BLT_RING;
+        pcie_write32(intel_i915_reg(device, BCS_RING_CTL), 0);
+    }
+
     if (device->regs) {
         mx_handle_close(device->regs_handle);
         device->regs_handle = -1;
@@ -190,6 +351,50 @@ static mx_status_t intel_i915_bind(void* ctx, mx_device_t* dev, void** cookie) {
     }
     di->flags = MX_DISPLAY_FLAG_HW_FRAMEBUFFER;
 
+    // Set up the BCS command ring for 2D blits.  The ring page is carved
+    // out of the aperture just past the visible framebuffer, relying on
+    // the bootloader's GGTT mapping of stolen memory covering it along
+    // with the framebuffer itself; if the engine does not come up we
+    // simply fall back to software blits.
+    uint32_t pixelsize = 0;
+    switch (di->format) {
+    case MX_PIXEL_FORMAT_RGB_565:
+        pixelsize = 2;
+        device->blt_depth = BLT_DEPTH_565;
+        device->blt_wmask = 0;
+        break;
+    case MX_PIXEL_FORMAT_RGB_x888:
+    case MX_PIXEL_FORMAT_ARGB_8888:
+        pixelsize = 4;
+        device->blt_depth = BLT_DEPTH_8888;
+        device->blt_wmask = BLT_WRITE_ALPHA_RGB;
+        break;
+    default:
+        // formats the blitter cannot express; leave acceleration off
+        break;
+    }
+    if (pixelsize != 0) {
+        uint64_t ring_offset =
+            (((uint64_t)di->stride * di->height * pixelsize) + 0xfff) & ~0xfffull;
+        if ((ring_offset + BCS_RING_SIZE) <= device->framebuffer_size) {
+            device->blt_ring = (uint8_t*)device->framebuffer + ring_offset;
+            device->blt_pitch = di->stride * pixelsize;
+            memset(device->blt_ring, 0, BCS_RING_SIZE);
+
+            pcie_write32(intel_i915_reg(device, BCS_RING_CTL), 0);
+            pcie_write32(intel_i915_reg(device, BCS_RING_HEAD), 0);
+            pcie_write32(intel_i915_reg(device, BCS_RING_TAIL), 0);
+            pcie_write32(intel_i915_reg(device, BCS_RING_START), (uint32_t)ring_offset);
+            pcie_write32(intel_i915_reg(device, BCS_RING_CTL),
+                         (((BCS_RING_SIZE / 4096) - 1) << 12) | 1);
+            if (pcie_read32(intel_i915_reg(device, BCS_RING_CTL)) & 1) {
+                device->flags |= FLAGS_BLT_RING;
+            } else {
+                printf("i915: blitter ring did not enable, 2D engine disabled\n");
+            }
+        }
+    }
+
     // TODO remove when the gfxconsole moves to user space
     intel_i915_enable_backlight(device, true);
     mx_set_framebuffer(get_root_resource(), device->framebuffer, device->framebuffer_size,
@@ -84,6 +84,12 @@ typedef struct ethdev {
     mx_handle_t rx_fifo;
     uint32_t rx_depth;
 
+    // rx buffer entries read from the client in bulk, so a burst of
+    // inbound frames does not cost a fifo syscall per frame
+    eth_fifo_entry_t rx_entries[32];
+    uint32_t rx_entry_count;
+    uint32_t rx_entry_next;
+
     // io buffer
     mx_handle_t io_vmo;
     void* io_buf;
@@ -102,23 +108,29 @@ typedef struct ethdev {
 #define FAIL_REPORT_RATE 50
 
 static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
-    eth_fifo_entry_t e;
     mx_status_t status;
     uint32_t count;
 
-    // TODO: read multiple and cache locally to reduce syscalls
-    if ((status = mx_fifo_read(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
-        if (status == ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
-                printf("eth [%s]: no rx buffers available (%u times)\n",
-                    edev->name, edev->fail_rx_read);
+    if (edev->rx_entry_next == edev->rx_entry_count) {
+        // out of cached buffers; read the next batch from the client
+        status = mx_fifo_read(edev->rx_fifo, edev->rx_entries,
+                              sizeof(edev->rx_entries), &count);
+        if (status < 0) {
+            if (status == ERR_SHOULD_WAIT) {
+                if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
+                    printf("eth [%s]: no rx buffers available (%u times)\n",
+                        edev->name, edev->fail_rx_read);
+                }
+            } else {
+                // Fatal, should force teardown
+                printf("eth [%s]: rx fifo read failed %d\n", edev->name, status);
             }
-        } else {
-            // Fatal, should force teardown
-            printf("eth [%s]: rx fifo read failed %d\n", edev->name, status);
+            return;
         }
-        return;
+        edev->rx_entry_count = count;
+        edev->rx_entry_next = 0;
     }
+    eth_fifo_entry_t e = edev->rx_entries[edev->rx_entry_next++];
 
     if ((e.offset >= edev->io_size) || ((e.length > (edev->io_size - e.offset)))) {
         // invalid offset/length. report error. drop packet
@@ -157,10 +169,12 @@ static void eth0_status(void* cookie, uint32_t status) {
 static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
     ethdev0_t* edev0 = cookie;
 
+    uint32_t extra = (flags & ETHMAC_RX_CSUM_OK) ? ETH_FIFO_RX_CSUM_OK : 0;
+
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_handle_rx(edev, data, len, 0);
+        eth_handle_rx(edev, data, len, extra);
     }
     mtx_unlock(&edev0->lock);
 }
@@ -240,8 +254,22 @@ static int eth_tx_thread(void* arg) {
         for (eth_fifo_entry_t* e = entries; count-- > 0; e++) {
             if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
                 e->flags = ETH_FIFO_INVALID;
+            } else if ((e->flags & (ETH_FIFO_TX_CSUM_UDP6 | ETH_FIFO_TX_CSUM_ICMP6)) &&
+                       !(edev0->info.features & ETHMAC_FEATURE_TX_CSUM)) {
+                // the checksum field only holds the pseudo-header seed,
+                // so the frame must not go out as-is
+                e->flags = ETH_FIFO_INVALID;
             } else {
-                edev0->macops->send(edev0->mac, 0, edev->io_buf + e->offset, e->length);
+                // translate the protocol-level checksum request into
+                // frame offsets; ethernet (14) + ipv6 (40) headers put
+                // the L4 header at byte 54
+                uint32_t options = 0;
+                if (e->flags & ETH_FIFO_TX_CSUM_UDP6) {
+                    options = ETHMAC_TX_CSUM_META(54, 54 + 6);
+                } else if (e->flags & ETH_FIFO_TX_CSUM_ICMP6) {
+                    options = ETHMAC_TX_CSUM_META(54, 54 + 2);
+                }
+                edev0->macops->send(edev0->mac, options, edev->io_buf + e->offset, e->length);
                 e->flags = ETH_FIFO_TX_OK;
                 if (edev->state & ETHDEV_TX_LOOPBACK) {
                     eth_tx_echo(edev0, edev->io_buf + e->offset, e->length);
@@ -428,6 +456,12 @@ static mx_status_t eth_ioctl(void* ctx, uint32_t op,
             if (edev->edev0->info.features & ETHMAC_FEATURE_WLAN) {
                 info->features |= ETH_FEATURE_WLAN;
             }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_TX_CSUM) {
+                info->features |= ETH_FEATURE_TX_CSUM;
+            }
+            if (edev->edev0->info.features & ETHMAC_FEATURE_RX_CSUM) {
+                info->features |= ETH_FEATURE_RX_CSUM;
+            }
             info->mtu = edev->edev0->info.mtu;
             *out_actual = sizeof(*info);
             status = NO_ERROR;
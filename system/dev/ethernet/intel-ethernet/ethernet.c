@@ -55,12 +55,23 @@ static int irq_thread(void* arg) {
             void* data;
             size_t len;
 
-            while (eth_rx(&edev->eth, &data, &len) == NO_ERROR) {
-                if (edev->ifc) {
-                    edev->ifc->recv(edev->cookie, data, len, 0);
+            // poll-mode receive: mask the rx interrupt and drain the ring,
+            // so a burst of traffic costs one interrupt rather than one
+            // per packet
+            unsigned rx_flags;
+            do {
+                eth_rx_irq_mask(&edev->eth);
+                while (eth_rx(&edev->eth, &data, &len, &rx_flags) == NO_ERROR) {
+                    if (edev->ifc) {
+                        uint32_t flags = (rx_flags & ETH_RX_CSUM_OK) ? ETHMAC_RX_CSUM_OK : 0;
+                        edev->ifc->recv(edev->cookie, data, len, flags);
+                    }
+                    eth_rx_ack(&edev->eth);
                 }
-                eth_rx_ack(&edev->eth);
-            }
+                eth_rx_irq_unmask(&edev->eth);
+                // recheck after unmasking; a packet that landed in the
+                // window above may not raise a fresh interrupt
+            } while (eth_rx(&edev->eth, &data, &len, &rx_flags) == NO_ERROR);
         }
         mtx_unlock(&edev->lock);
 
@@ -78,6 +89,7 @@ static mx_status_t eth_query(mx_device_t* dev, uint32_t options, ethmac_info_t*
     }
 
     memset(info, 0, sizeof(*info));
+    info->features = ETHMAC_FEATURE_TX_CSUM | ETHMAC_FEATURE_RX_CSUM;
     info->mtu = ETH_RXBUF_SIZE; //TODO: not actually the mtu!
     memcpy(info->mac, edev->eth.mac, sizeof(edev->eth.mac));
 
@@ -109,7 +121,13 @@ static mx_status_t eth_start(mx_device_t* dev, ethmac_ifc_t* ifc, void* cookie)
 
 static void eth_send(mx_device_t* dev, uint32_t options, void* data, size_t length) {
     ethernet_device_t* edev = dev->ctx;
-    eth_tx(&edev->eth, data, length);
+    unsigned csum_start = 0;
+    unsigned csum_offset = 0;
+    if (options & ETHMAC_TX_CSUM) {
+        csum_start = ETHMAC_TX_CSUM_START(options);
+        csum_offset = ETHMAC_TX_CSUM_OFFSET(options);
+    }
+    eth_tx(&edev->eth, data, length, csum_start, csum_offset);
 }
 
 static ethmac_protocol_t ethmac_ops = {
@@ -111,6 +111,10 @@
 #define IE_TCTL_COLD_FD   (0x40 << 12) // Collision Distance Full Duplex
 #define IE_TCTL_SWXOFF    (1 << 22) // XOFF TX (self-clearing)
 
+#define IE_RXCSUM_PCSS(n) ((n) & 0xFF) // Packet Checksum Start
+#define IE_RXCSUM_IPOFLD  (1 << 8) // IP Checksum Offload Enable
+#define IE_RXCSUM_TUOFLD  (1 << 9) // TCP/UDP Checksum Offload Enable
+
 
 typedef struct ie_rxd {
     uint64_t addr;
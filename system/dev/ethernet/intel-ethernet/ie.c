@@ -45,7 +45,15 @@ unsigned eth_handle_irq(ethdev_t* eth) {
     return readl(IE_ICR);
 }
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
+void eth_rx_irq_mask(ethdev_t* eth) {
+    writel(IE_INT_RXT0, IE_IMC);
+}
+
+void eth_rx_irq_unmask(ethdev_t* eth) {
+    writel(IE_INT_RXT0, IE_IMS);
+}
+
+status_t eth_rx(ethdev_t* eth, void** data, size_t* len, unsigned* flags) {
     uint32_t n = eth->rx_rd_ptr;
     uint64_t info = eth->rxd[n].info;
 
@@ -59,6 +67,13 @@ status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
     *data = eth->rxb + ETH_RXBUF_SIZE * n;
     *len = r;
 
+    // report a verified TCP/UDP checksum, unless the hw tells us to
+    // disregard the checksum status bits for this packet
+    *flags = 0;
+    if ((info & IE_RXD_TCPCS) && !(info & (IE_RXD_IXSM | IE_RXD_TCPE))) {
+        *flags |= ETH_RX_CSUM_OK;
+    }
+
     return NO_ERROR;
 }
 
@@ -72,7 +87,8 @@ void eth_rx_ack(ethdev_t* eth) {
     eth->rx_rd_ptr = n;
 }
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
+status_t eth_tx(ethdev_t* eth, const void* data, size_t len,
+                unsigned csum_start, unsigned csum_offset) {
     if ((len < 60) || (len > ETH_TXBUF_DSIZE)) {
         return ERR_INVALID_ARGS;
     }
@@ -110,6 +126,12 @@ status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
     memcpy(frame->data, data, len);
     eth->txd[n].addr = frame->phys;
     eth->txd[n].info = IE_TXD_LEN(len) | IE_TXD_EOP | IE_TXD_IFCS | IE_TXD_RS;
+    if (csum_offset != 0) {
+        // legacy descriptors can insert a checksum computed from
+        // csum_start to the end of the frame; the seeded field at
+        // csum_offset is included in the sum
+        eth->txd[n].info |= IE_TXD_IC | IE_TXD_CSS(csum_start) | IE_TXD_CSO(csum_offset);
+    }
     list_add_tail(&eth->busy_frames, &frame->node);
 
     // inform hw of buffer availability
@@ -151,9 +173,10 @@ void eth_init_hw(ethdev_t* eth) {
     //TODO: TCTL COLD should be based on link state
     //TODO: use address filtering for multicast
 
-    // setup rx ring
+    // setup rx ring; have the hw verify TCP/UDP checksums so the stack
+    // doesn't have to
     eth->rx_rd_ptr = 0;
-    writel(0, IE_RXCSUM);
+    writel(IE_RXCSUM_PCSS(14) | IE_RXCSUM_IPOFLD | IE_RXCSUM_TUOFLD, IE_RXCSUM);
     writel((4 << 0) | (1 << 8) | (1 << 16) | (1 << 24), IE_RXDCTL);
     writel(eth->rxd_phys, IE_RDBAL);
     writel(eth->rxd_phys >> 32, IE_RDBAH);
@@ -65,10 +65,22 @@ void eth_init_hw(ethdev_t* eth);
 
 void eth_dump_regs(ethdev_t* eth);
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len);
+// flags returned by eth_rx()
+#define ETH_RX_CSUM_OK 1 // hardware verified the TCP/UDP checksum
+
+status_t eth_rx(ethdev_t* eth, void** data, size_t* len, unsigned* flags);
 void eth_rx_ack(ethdev_t* eth);
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len);
+// if csum_offset is nonzero the hardware computes a checksum over the
+// frame starting at csum_start and inserts it at csum_offset; the field
+// there must be seeded with the pseudo-header sum
+status_t eth_tx(ethdev_t* eth, const void* data, size_t len,
+                unsigned csum_start, unsigned csum_offset);
 
 #define ETH_IRQ_RX IE_INT_RXT0
 unsigned eth_handle_irq(ethdev_t* eth);
+
+// mask/unmask the rx interrupt at the controller, so the rx ring can be
+// polled without taking an interrupt per packet
+void eth_rx_irq_mask(ethdev_t* eth);
+void eth_rx_irq_unmask(ethdev_t* eth);
@@ -11,8 +11,11 @@
 
 #include <magenta/assert.h>
 #include <magenta/listnode.h>
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,6 +33,10 @@
 #define foreach_instance(base, instance) \
     list_for_every_entry(&base->instance_list, instance, hid_instance_t, node)
 #define bits_to_bytes(n) (((n) + 7) / 8)
+#define hid_align(n, a) (((n) + ((a) - 1)) & ~((a) - 1))
+
+// Record slots in a shared-memory report ring (IOCTL_INPUT_GET_REPORT_RING)
+#define HID_RING_SLOTS 256
 
 // Until we do full HID parsing, we put mouse and keyboard devices into boot
 // protocol mode. In particular, a mouse will always send 3 byte reports (see
@@ -83,6 +90,15 @@ typedef struct hid_instance {
 
     mx_hid_fifo_t fifo;
 
+    // Shared-memory report ring (IOCTL_INPUT_GET_REPORT_RING).  When
+    // 'ring' is non-NULL, reports are delivered here rather than
+    // through the fifo.  The pointer is published with release
+    // semantics; hid_io_queue() loads it with acquire.
+    input_ring_hdr_t* ring;
+    size_t ring_size;
+    mx_handle_t ring_vmo;
+    mx_handle_t ring_event;
+
     struct list_node node;
 } hid_instance_t;
 
@@ -273,6 +289,72 @@ static mx_status_t hid_set_report(hid_device_t* hid, const void* in_buf, size_t
 }
 
 
+static mx_status_t hid_get_report_ring(hid_instance_t* hid, void* out_buf, size_t out_len,
+                                       size_t* out_actual) {
+    if (out_len < sizeof(input_ring_t)) return ERR_INVALID_ARGS;
+    if (hid->ring != NULL) return ERR_ALREADY_BOUND;
+
+    input_report_size_t max_rpt_size = 0;
+    size_t actual = 0;
+    mx_status_t status = hid_get_max_input_reportsize(hid->base, &max_rpt_size,
+                                                      sizeof(max_rpt_size), &actual);
+    if (status != NO_ERROR) {
+        return status;
+    }
+
+    uint32_t stride = hid_align(sizeof(input_ring_record_t) + max_rpt_size, 8);
+    size_t size = hid_align(sizeof(input_ring_hdr_t) + HID_RING_SLOTS * stride, PAGE_SIZE);
+
+    mx_handle_t vmo;
+    if ((status = mx_vmo_create(size, 0, &vmo)) < 0) {
+        return status;
+    }
+    input_ring_hdr_t* hdr;
+    if ((status = mx_vmar_map(mx_vmar_root_self(), 0, vmo, 0, size,
+                              MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE,
+                              (uintptr_t*)&hdr)) < 0) {
+        mx_handle_close(vmo);
+        return status;
+    }
+    mx_handle_t event;
+    if ((status = mx_event_create(0, &event)) < 0) {
+        goto fail_unmap;
+    }
+
+    input_ring_t* reply = out_buf;
+    if ((status = mx_handle_duplicate(vmo, MX_RIGHT_SAME_RIGHTS, &reply->vmo)) < 0) {
+        goto fail_close_event;
+    }
+    if ((status = mx_handle_duplicate(event, MX_RIGHT_SAME_RIGHTS, &reply->event)) < 0) {
+        mx_handle_close(reply->vmo);
+        goto fail_close_event;
+    }
+    reply->stride = stride;
+    reply->capacity = HID_RING_SLOTS;
+
+    hdr->stride = stride;
+    hdr->capacity = HID_RING_SLOTS;
+    hdr->wr = 0;
+    hdr->rd = 0;
+    hdr->dropped = 0;
+
+    hid->ring_size = size;
+    hid->ring_vmo = vmo;
+    hid->ring_event = event;
+    // publish last, so hid_io_queue() never sees a half-built ring
+    __atomic_store_n(&hid->ring, hdr, __ATOMIC_RELEASE);
+
+    *out_actual = sizeof(*reply);
+    return NO_ERROR;
+
+fail_close_event:
+    mx_handle_close(event);
+fail_unmap:
+    mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)hdr, size);
+    mx_handle_close(vmo);
+    return status;
+}
+
 static mx_status_t hid_read_instance(void* ctx, void* buf, size_t count, mx_off_t off,
                                      size_t* actual) {
     hid_instance_t* hid = ctx;
@@ -344,6 +426,8 @@ static mx_status_t hid_ioctl_instance(void* ctx, uint32_t op,
         return hid_get_report(hid->base, in_buf, in_len, out_buf, out_len, out_actual);
     case IOCTL_INPUT_SET_REPORT:
         return hid_set_report(hid->base, in_buf, in_len);
+    case IOCTL_INPUT_GET_REPORT_RING:
+        return hid_get_report_ring(hid, out_buf, out_len, out_actual);
     }
     return ERR_NOT_SUPPORTED;
 }
@@ -362,6 +446,11 @@ static void hid_release_reassembly_buffer(hid_device_t* dev);
 
 static void hid_release_instance(void* ctx) {
     hid_instance_t* hid = ctx;
+    if (hid->ring != NULL) {
+        mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)hid->ring, hid->ring_size);
+        mx_handle_close(hid->ring_vmo);
+        mx_handle_close(hid->ring_event);
+    }
     free(hid);
 }
 
@@ -724,8 +813,35 @@ mx_protocol_device_t hid_device_proto = {
     .release = hid_release_device,
 };
 
+// Deliver a report into an instance's shared-memory ring.  The ring is
+// single-producer (this thread) / single-consumer; 'wr' is published
+// with release semantics and the client publishes 'rd' the same way.
+// The event is asserted only when the ring goes from empty to
+// non-empty, so a client draining a batch takes one wakeup no matter
+// how many reports arrived.
+static void hid_ring_deliver(hid_instance_t* hid, input_ring_hdr_t* hdr,
+                             mx_time_t now, const uint8_t* rpt, size_t len) {
+    uint64_t wr = hdr->wr;
+    uint64_t rd = __atomic_load_n(&hdr->rd, __ATOMIC_ACQUIRE);
+    if ((wr - rd >= hdr->capacity) ||
+        (len > hdr->stride - sizeof(input_ring_record_t))) {
+        __atomic_store_n(&hdr->dropped, hdr->dropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    input_ring_record_t* rec = (input_ring_record_t*)
+        ((uint8_t*)(hdr + 1) + (wr % hdr->capacity) * hdr->stride);
+    rec->timestamp = now;
+    rec->len = len;
+    memcpy(rec->data, rpt, len);
+    __atomic_store_n(&hdr->wr, wr + 1, __ATOMIC_RELEASE);
+    if (wr == rd) {
+        mx_object_signal(hid->ring_event, 0, MX_USER_SIGNAL_0);
+    }
+}
+
 void hid_io_queue(void* cookie, const uint8_t* buf, size_t len) {
     hid_device_t* hid = cookie;
+    mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
 
     mtx_lock(&hid->instance_lock);
 
@@ -797,6 +913,11 @@ void hid_io_queue(void* cookie, const uint8_t* buf, size_t len) {
 
         hid_instance_t* instance;
         foreach_instance(hid, instance) {
+            input_ring_hdr_t* ring = __atomic_load_n(&instance->ring, __ATOMIC_ACQUIRE);
+            if (ring != NULL) {
+                hid_ring_deliver(instance, ring, now, rbuf, rlen);
+                continue;
+            }
             mtx_lock(&instance->fifo.lock);
             bool was_empty = mx_hid_fifo_size(&instance->fifo) == 0;
             ssize_t wrote = mx_hid_fifo_write(&instance->fifo, rbuf, rlen);
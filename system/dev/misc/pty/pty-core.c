@@ -53,12 +53,14 @@ static mx_status_t pty_client_read(void* ctx, void* buf, size_t count, mx_off_t
     pty_server_t* ps = pc->srv;
 
     mtx_lock(&ps->lock);
-    bool was_full = pty_fifo_is_full(&pc->fifo);
+    bool was_above = pty_fifo_free(&pc->fifo) < PTY_FIFO_WATERMARK;
     size_t length = pty_fifo_read(&pc->fifo, buf, count);
     if (pty_fifo_is_empty(&pc->fifo)) {
         device_state_clr(pc->mxdev, DEV_STATE_READABLE);
     }
-    if (was_full && length) {
+    // wake the writer once per drain cycle, when a useful amount of
+    // space opens up, rather than after every small read
+    if (was_above && (pty_fifo_free(&pc->fifo) >= PTY_FIFO_WATERMARK)) {
         device_state_set(ps->mxdev, DEV_STATE_WRITABLE);
     }
     mtx_unlock(&ps->lock);
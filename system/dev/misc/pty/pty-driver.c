@@ -53,7 +53,7 @@ static mx_status_t psd_read(void* ctx, void* buf, size_t count, mx_off_t off, si
     bool eof = false;
 
     mtx_lock(&psd->srv.lock);
-    bool was_full = pty_fifo_is_full(&psd->fifo);
+    bool was_above = pty_fifo_free(&psd->fifo) < PTY_FIFO_WATERMARK;
     size_t length = pty_fifo_read(&psd->fifo, buf, count);
     if (pty_fifo_is_empty(&psd->fifo)) {
         if (list_is_empty(&psd->srv.clients)) {
@@ -62,7 +62,8 @@ static mx_status_t psd_read(void* ctx, void* buf, size_t count, mx_off_t off, si
             device_state_clr(psd->srv.mxdev, DEV_STATE_READABLE);
         }
     }
-    if (was_full && length) {
+    // resume the writer once per drain cycle (see pty_client_read)
+    if (was_above && (pty_fifo_free(&psd->fifo) >= PTY_FIFO_WATERMARK)) {
         pty_server_resume_locked(&psd->srv);
     }
     mtx_unlock(&psd->srv.lock);
@@ -12,7 +12,13 @@
 
 __BEGIN_CDECLS;
 
-#define PTY_FIFO_SIZE (4096)
+// Large enough that a chatty writer can stream full mxio chunks
+// without stalling on the reader every few writes.
+#define PTY_FIFO_SIZE (65536)
+
+// Writers blocked on a full fifo are woken once this much space has
+// drained, rather than after every small read.
+#define PTY_FIFO_WATERMARK (PTY_FIFO_SIZE / 2)
 
 typedef struct pty_fifo {
     uint32_t head;
@@ -31,4 +37,8 @@ static inline bool pty_fifo_is_full(pty_fifo_t* fifo) {
     return (fifo->head - fifo->tail) == PTY_FIFO_SIZE;
 }
 
+static inline size_t pty_fifo_free(pty_fifo_t* fifo) {
+    return PTY_FIFO_SIZE - (fifo->head - fifo->tail);
+}
+
 __END_CDECLS;
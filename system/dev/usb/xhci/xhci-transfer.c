@@ -305,22 +305,27 @@ static mx_status_t xhci_continue_transfer_locked(xhci_t* xhci, xhci_endpoint_t*
         state->needs_data_event = false;
     }
 
-    // if we get here, then we are ready to ring the doorbell
-    // update dequeue_ptr to TRB following this transaction
+    // if we get here, the transaction is fully queued.
+    // update dequeue_ptr to TRB following this transaction.
+    // the doorbell is rung by our caller, once per burst of transactions.
     txn->context = (void *)ring->current;
 
-    XHCI_WRITE32(&xhci->doorbells[proto_data->device_id], ep_index + 1);
-
     return NO_ERROR;
 }
 
 static void xhci_process_transactions_locked(xhci_t* xhci, xhci_endpoint_t* ep,
                                              list_node_t* completed_txns) {
+    // ring the doorbell once per burst rather than once per transaction,
+    // after everything that fits has been queued on the transfer ring
+    bool ring_doorbell = false;
+    uint32_t device_id = 0;
+    uint8_t ep_index = 0;
+
     // loop until we fill our transfer ring or run out of iotxns to process
     while (1) {
         if (xhci_transfer_ring_free_trbs(&ep->transfer_ring) == 0) {
             // no available TRBs - need to wait for some complete
-            return;
+            break;
         }
 
         while (!ep->current_txn) {
@@ -328,7 +333,7 @@ static void xhci_process_transactions_locked(xhci_t* xhci, xhci_endpoint_t* ep,
             iotxn_t* txn = list_remove_head_type(&ep->queued_txns, iotxn_t, node);
             if (!txn) {
                 // nothing to do
-                return;
+                goto out;
             }
 
             mx_status_t status = xhci_start_transfer_locked(xhci, ep, txn);
@@ -345,9 +350,15 @@ static void xhci_process_transactions_locked(xhci_t* xhci, xhci_endpoint_t* ep,
         if (ep->current_txn) {
             iotxn_t* txn = ep->current_txn;
             mx_status_t status = xhci_continue_transfer_locked(xhci, ep, txn);
+            if (status == NO_ERROR) {
+                usb_protocol_data_t* proto_data = iotxn_pdata(txn, usb_protocol_data_t);
+                ring_doorbell = true;
+                device_id = proto_data->device_id;
+                ep_index = xhci_endpoint_index(proto_data->ep_address);
+            }
             if (status == ERR_SHOULD_WAIT) {
                 // no available TRBs - need to wait for some complete
-                return;
+                break;
             } else {
                 if (status != NO_ERROR) {
                     txn->status = status;
@@ -358,6 +369,11 @@ static void xhci_process_transactions_locked(xhci_t* xhci, xhci_endpoint_t* ep,
             }
         }
     }
+
+out:
+    if (ring_doorbell) {
+        XHCI_WRITE32(&xhci->doorbells[device_id], ep_index + 1);
+    }
 }
 
 mx_status_t xhci_queue_transfer(xhci_t* xhci, iotxn_t* txn) {
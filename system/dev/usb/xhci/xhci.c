@@ -394,6 +394,9 @@ static void xhci_interruptor_init(xhci_t* xhci, int interruptor) {
 
     xhci_update_erdp(xhci, interruptor);
 
+    // moderate interrupts so a burst of transfer completions is handled with
+    // a single pass over the event ring
+    XHCI_SET32(&intr_regs->imod, IMOD_IMODI_MASK, XHCI_IMODI_DEFAULT);
     XHCI_SET32(&intr_regs->iman, IMAN_IE, IMAN_IE);
     XHCI_SET32(&intr_regs->erstsz, ERSTSZ_MASK, ERST_ARRAY_SIZE);
     XHCI_WRITE64(&intr_regs->erstba, xhci->erst_arrays_phys[interruptor]);
@@ -535,8 +538,11 @@ static void xhci_handle_events(xhci_t* xhci, int interruptor) {
             er->current = er->start;
             er->ccs ^= TRB_C;
         }
-        xhci_update_erdp(xhci, interruptor);
     }
+
+    // advance the event ring dequeue pointer (and clear EHB) once per batch
+    // of events rather than once per TRB
+    xhci_update_erdp(xhci, interruptor);
 }
 
 void xhci_handle_interrupt(xhci_t* xhci, bool legacy) {
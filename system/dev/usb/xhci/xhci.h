@@ -27,6 +27,9 @@
 #define EVENT_RING_SIZE (PAGE_SIZE / sizeof(xhci_trb_t))
 #define ERST_ARRAY_SIZE 1
 
+// interrupt moderation interval, in 250ns increments (40us)
+#define XHCI_IMODI_DEFAULT 160
+
 #define XHCI_RH_USB_2 0 // index of USB 2.0 virtual root hub device
 #define XHCI_RH_USB_3 1 // index of USB 2.0 virtual root hub device
 #define XHCI_RH_COUNT 2 // number of virtual root hub devices
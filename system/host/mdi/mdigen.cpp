@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include <vector>
@@ -50,7 +51,24 @@ static bool run(std::vector<std::string>& in_paths, const char* out_path,
         out_file.write((const char *)&header, sizeof(header));
 
         // write the nodes
-        root.serialize(out_file);
+        std::vector<mdi_index_entry_t> index;
+        root.serialize(out_file, 2 * sizeof(bootdata_t), index);
+
+        // append the lookup index, sorted for binary search.
+        // stable sort keeps duplicate ids under one parent in tree order,
+        // so an indexed lookup matches what a linear walk would find.
+        std::stable_sort(index.begin(), index.end(),
+                         [](const mdi_index_entry_t& a, const mdi_index_entry_t& b) {
+                             if (a.parent_offset != b.parent_offset) {
+                                 return a.parent_offset < b.parent_offset;
+                             }
+                             return a.id < b.id;
+                         });
+        mdi_index_t index_header;
+        index_header.magic = MDI_INDEX_MAGIC;
+        index_header.count = index.size();
+        out_file.write((const char *)&index_header, sizeof(index_header));
+        out_file.write((const char *)index.data(), index.size() * sizeof(index[0]));
 
         size_t total_len = out_file.tellp();
 
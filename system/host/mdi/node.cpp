@@ -137,10 +137,13 @@ void Node::compute_node_length() {
     }
 }
 
-bool Node::serialize(std::ofstream& out_file) {
+bool Node::serialize(std::ofstream& out_file, uint32_t base_offset,
+                     std::vector<mdi_index_entry_t>& index) {
     mdi_node_t node;
     static_assert(sizeof(node) == MDI_ALIGN(sizeof(node)), "");
 
+    uint32_t node_offset = (uint32_t)out_file.tellp() - base_offset;
+
     memset(&node, 0, sizeof(node));
     node.id = id;
     node.length = serialized_length;
@@ -187,8 +190,16 @@ bool Node::serialize(std::ofstream& out_file) {
         pad_length = strlen;
     } else if (type == MDI_LIST) {
         // children are recursively written following node
+        uint32_t remaining = child_count;
         for (auto iter = children.begin(); iter != children.end(); iter++) {
-            iter->serialize(out_file);
+            remaining--;
+            mdi_index_entry_t entry;
+            entry.parent_offset = node_offset;
+            entry.id = iter->id;
+            entry.node_offset = (uint32_t)out_file.tellp() - base_offset;
+            entry.siblings_count = remaining;
+            index.push_back(entry);
+            iter->serialize(out_file, base_offset, index);
         }
     } else if (type == MDI_ARRAY) {
         // array element values are written immediately after the mdi_node_t
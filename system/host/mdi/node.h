@@ -38,7 +38,11 @@ public:
     }
 
     void compute_node_length();
-    bool serialize(std::ofstream& out_file);
+    // Serializes this node and its subtree, recording a lookup index entry
+    // for every list child. Offsets are relative to base_offset, the file
+    // position of the root node.
+    bool serialize(std::ofstream& out_file, uint32_t base_offset,
+                   std::vector<mdi_index_entry_t>& index);
 
 private:
     void print_indent(int depth);
@@ -635,7 +635,8 @@ fail:
                 BOOTDATA_BOOTFS_SYSTEM : BOOTDATA_BOOTFS_BOOT,
         .length = wrote,
         .extra = compressed ? item->outsize : wrote,
-        .flags = compressed ? BOOTDATA_BOOTFS_FLAG_COMPRESSED : 0
+        .flags = compressed ? BOOTDATA_BOOTFS_FLAG_COMPRESSED
+                            : BOOTDATA_BOOTFS_FLAG_ALIGNED
     };
     if (writex(fd, &boothdr, sizeof(boothdr)) < 0) {
         return -1;
@@ -649,10 +650,44 @@ fail:
     return 0;
 }
 
-int write_bootdata(const char* fn, item_t* item) {
-    //TODO: re-enable for debugging someday
-    bool compressed = true;
+// Pad the output with an IGNORE item so the next item's bootdata header
+// lands on a page boundary. Uncompressed bootfs items are placed this way
+// (and tagged ALIGNED) so consumers can serve their file payloads as VMO
+// clones straight out of the container.
+int pad_align_page(int fd) {
+    off_t pos = lseek(fd, 0, SEEK_CUR);
+    if (pos < 0) {
+        return -1;
+    }
+    size_t pad = PAGEFILL(pos);
+    if (pad == 0) {
+        return 0;
+    }
+    if (pad < sizeof(bootdata_t)) {
+        // Not enough room for the IGNORE header; spill into the next page.
+        pad += 4096;
+    }
+    bootdata_t hdr = {
+        .type = BOOTDATA_IGNORE,
+        .length = pad - sizeof(bootdata_t),
+        .extra = 0,
+        .flags = 0,
+    };
+    if (writex(fd, &hdr, sizeof(hdr)) < 0) {
+        return -1;
+    }
+    pad -= sizeof(bootdata_t);
+    while (pad > 0) {
+        size_t xfer = (pad > sizeof(fill)) ? sizeof(fill) : pad;
+        if (writex(fd, fill, xfer) < 0) {
+            return -1;
+        }
+        pad -= xfer;
+    }
+    return 0;
+}
 
+int write_bootdata(const char* fn, item_t* item, bool compressed) {
     int fd;
     const io_ops* op = compressed ? &io_compressed : &io_plain;
 
@@ -714,6 +749,9 @@ int write_bootdata(const char* fn, item_t* item) {
         }
         case ITEM_BOOTFS_BOOT:
         case ITEM_BOOTFS_SYSTEM:
+            if (!compressed) {
+                CHECK(pad_align_page(fd));
+            }
             CHECK(write_bootfs(fd, op, item, compressed));
             break;
         default:
@@ -801,6 +839,9 @@ int dump_bootdata(const char* fn) {
         case BOOTDATA_CMDLINE:
             printf("%08zx: %08x CMDLINE\n", off, hdr.length);
             break;
+        case BOOTDATA_IGNORE:
+            printf("%08zx: %08x IGNORE (alignment)\n", off, hdr.length);
+            break;
         default:
             printf("%08zx: %08x UNKNOWN (type=%08x)\n", off, hdr.length, hdr.type);
             break;
@@ -989,5 +1030,5 @@ int main(int argc, char **argv) {
         }
     }
 
-    return write_bootdata(output_file, first_item);
+    return write_bootdata(output_file, first_item, compressed);
 }
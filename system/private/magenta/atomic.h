@@ -175,4 +175,26 @@ static inline void atomic_store_u64(volatile uint64_t *ptr, uint64_t newval)
     __atomic_store_n(ptr, newval, __ATOMIC_SEQ_CST);
 }
 
+// 32-bit unsigned versions with explicit memory order, for lock-free
+// producer/consumer rings and similar hand-rolled protocols.
+static inline uint32_t atomic_load_u32_relaxed(volatile uint32_t *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t atomic_load_u32_acquire(volatile uint32_t *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_store_u32_relaxed(volatile uint32_t *ptr, uint32_t newval)
+{
+    __atomic_store_n(ptr, newval, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_store_u32_release(volatile uint32_t *ptr, uint32_t newval)
+{
+    __atomic_store_n(ptr, newval, __ATOMIC_RELEASE);
+}
+
 __END_CDECLS
@@ -42,6 +42,12 @@
 // Flag indicating that the bootfs is compressed.
 #define BOOTDATA_BOOTFS_FLAG_COMPRESSED  (1 << 0)
 
+// Flag indicating that an uncompressed bootfs item's header begins on a
+// page boundary within its container. File offsets inside a bootfs image
+// are page aligned relative to that header, so the files of an ALIGNED
+// image can be served as VMO clones of the container without copying.
+#define BOOTDATA_BOOTFS_FLAG_ALIGNED     (1 << 1)
+
 
 // These items are for passing from bootloader to kernel
 
@@ -42,6 +42,15 @@
 // otherwise, closing the client fifo is sufficient to shut down the server.
 #define IOCTL_BLOCK_FIFO_CLOSE \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 10)
+// Get performance counters for the block device
+#define IOCTL_BLOCK_GET_STATS \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 11)
+// Get the backing VMO of a memory-backed block device, if it has one.
+// The entire device contents are directly readable and writable
+// through the returned VMO, so aligned I/O needs no copies at all.
+// Devices not backed by plain memory return ERR_NOT_SUPPORTED.
+#define IOCTL_BLOCK_GET_MAPPABLE_VMO \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_BLOCK, 12)
 
 // Block Core ioctls (specific to each block device):
 
@@ -59,6 +68,35 @@ typedef struct {
 // ssize_t ioctl_block_get_info(int fd, block_info_t* out);
 IOCTL_WRAPPER_OUT(ioctl_block_get_info, IOCTL_BLOCK_GET_INFO, block_info_t);
 
+// Performance counters maintained by the block core and updated at each
+// request completion. Counters are cumulative since the device bound;
+// tools interested in an interval read the stats twice and subtract.
+//
+// latency[n] counts requests which completed in [2^n, 2^(n+1)) microseconds,
+// with the first and last buckets absorbing the out-of-range tails.
+// depth[n] counts requests which completed while n+1 requests were
+// outstanding (including themselves), with the last bucket absorbing
+// anything deeper.
+#define BLOCK_STATS_LATENCY_BUCKETS 16
+#define BLOCK_STATS_DEPTH_BUCKETS 16
+
+typedef struct {
+    uint64_t reads; // Read requests completed
+    uint64_t writes; // Write requests completed
+    uint64_t errors; // Requests completed with an error status
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t max_depth; // Most requests ever outstanding at once
+    uint64_t latency[BLOCK_STATS_LATENCY_BUCKETS];
+    uint64_t depth[BLOCK_STATS_DEPTH_BUCKETS];
+} block_stats_t;
+
+// ssize_t ioctl_block_get_stats(int fd, block_stats_t* out);
+IOCTL_WRAPPER_OUT(ioctl_block_get_stats, IOCTL_BLOCK_GET_STATS, block_stats_t);
+
+// ssize_t ioctl_block_get_mappable_vmo(int fd, mx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_block_get_mappable_vmo, IOCTL_BLOCK_GET_MAPPABLE_VMO, mx_handle_t);
+
 // ssize_t ioctl_block_get_type_guid(int fd, void* out, size_t out_len);
 IOCTL_WRAPPER_VAROUT(ioctl_block_get_type_guid, IOCTL_BLOCK_GET_TYPE_GUID, void);
 
@@ -20,6 +20,23 @@ typedef struct mx_display_info {
     uint32_t flags;
 } mx_display_info_t;
 
+// Source pixels equal to color are not copied.
+#define MX_DISPLAY_BLIT_FLAG_COLORKEY (1 << 0)
+
+// Arguments for 2D engine operations.  All coordinates are in pixels
+// within the visible framebuffer; color is a raw pixel value in the
+// framebuffer's format, used as the fill value or as the colorkey.
+typedef struct mx_display_blit {
+    uint32_t src_x;
+    uint32_t src_y;
+    uint32_t dest_x;
+    uint32_t dest_y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t color;
+    uint32_t flags;
+} mx_display_blit_t;
+
 // Return the framebuffer
 //   in: none
 //   out: ioctl_display_get_fb_t
@@ -59,6 +76,54 @@ typedef struct mx_display_info {
 #define IOCTL_DISPLAY_SET_OWNER \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 6)
 
+// Return the scanout memory for page flipping, as a vmo holding
+// frame_count frames of frame_size bytes each.  Only supported for
+// fullscreen clients of displays whose hardware can flip; others
+// get ERR_NOT_SUPPORTED and must use the shadow buffer from
+// IOCTL_DISPLAY_GET_FB.
+//   in: none
+//   out: ioctl_display_get_flip_fb_t
+#define IOCTL_DISPLAY_GET_FLIP_FB \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_DISPLAY, 7)
+
+// Scan out from the given frame of the flip framebuffer.  The vsync
+// event is signaled once the flip has taken effect.  Ignored while
+// another client owns the display.
+//   in: uint32_t frame
+//   out: none
+#define IOCTL_DISPLAY_FLIP_FB \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 8)
+
+// Get an event signaled with USER_SIGNAL_0 each time a flip takes
+// effect.
+//   in: none
+//   out: mx_handle_t
+#define IOCTL_DISPLAY_GET_VSYNC_EVENT \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_DISPLAY, 9)
+
+// Fill a rectangle of the visible framebuffer with a solid color
+// using the display's 2D engine.  src_x/src_y are ignored; color is
+// a raw pixel value in the framebuffer's format.  Only supported for
+// displays with a 2D engine; others get ERR_NOT_SUPPORTED and must
+// fill the shadow buffer and flush.  The caller is responsible for
+// applying the same fill to its shadow buffer.
+//   in: mx_display_blit_t
+//   out: none
+#define IOCTL_DISPLAY_FILL_RECT \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 10)
+
+// Copy a rectangle of the visible framebuffer to another position
+// using the display's 2D engine.  The source rectangle must be up to
+// date on the display (flushed); the caller is responsible for
+// applying the same copy to its shadow buffer.  With
+// MX_DISPLAY_BLIT_FLAG_COLORKEY set, source pixels equal to color
+// are not copied.  Displays without a 2D engine (or without colorkey
+// support) return ERR_NOT_SUPPORTED.
+//   in: mx_display_blit_t
+//   out: none
+#define IOCTL_DISPLAY_COPY_RECT \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_DISPLAY, 11)
+
 typedef struct {
     mx_handle_t vmo;
     mx_display_info_t info;
@@ -71,6 +136,13 @@ typedef struct {
     uint32_t height;
 } ioctl_display_region_t;
 
+typedef struct {
+    mx_handle_t vmo;
+    mx_display_info_t info;
+    uint32_t frame_count;
+    uint32_t frame_size;
+} ioctl_display_get_flip_fb_t;
+
 // ssize_t ioctl_display_get_fb(int fd, ioctl_display_get_fb_t* out);
 IOCTL_WRAPPER_OUT(ioctl_display_get_fb, IOCTL_DISPLAY_GET_FB, ioctl_display_get_fb_t);
 
@@ -87,4 +159,19 @@ IOCTL_WRAPPER_IN(ioctl_display_set_fullscreen, IOCTL_DISPLAY_SET_FULLSCREEN, uin
 IOCTL_WRAPPER_OUT(ioctl_display_get_ownership_change_event, IOCTL_DISPLAY_GET_OWNERSHIP_CHANGE_EVENT, mx_handle_t);
 
 // ssize_t ioctl_display_set_owner(int fd, uint32_t owner);
-IOCTL_WRAPPER_IN(ioctl_display_set_owner, IOCTL_DISPLAY_SET_OWNER, uint32_t)
\ No newline at end of file
+IOCTL_WRAPPER_IN(ioctl_display_set_owner, IOCTL_DISPLAY_SET_OWNER, uint32_t)
+
+// ssize_t ioctl_display_get_flip_fb(int fd, ioctl_display_get_flip_fb_t* out);
+IOCTL_WRAPPER_OUT(ioctl_display_get_flip_fb, IOCTL_DISPLAY_GET_FLIP_FB, ioctl_display_get_flip_fb_t);
+
+// ssize_t ioctl_display_flip_fb(int fd, uint32_t frame);
+IOCTL_WRAPPER_IN(ioctl_display_flip_fb, IOCTL_DISPLAY_FLIP_FB, uint32_t);
+
+// ssize_t ioctl_display_get_vsync_event(int fd, mx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_display_get_vsync_event, IOCTL_DISPLAY_GET_VSYNC_EVENT, mx_handle_t);
+
+// ssize_t ioctl_display_fill_rect(int fd, const mx_display_blit_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_fill_rect, IOCTL_DISPLAY_FILL_RECT, mx_display_blit_t);
+
+// ssize_t ioctl_display_copy_rect(int fd, const mx_display_blit_t* in);
+IOCTL_WRAPPER_IN(ioctl_display_copy_rect, IOCTL_DISPLAY_COPY_RECT, mx_display_blit_t);
\ No newline at end of file
@@ -25,7 +25,9 @@ typedef struct eth_info_t {
     uint32_t reserved[12];
 } eth_info_t;
 
-#define ETH_FEATURE_WLAN 1
+#define ETH_FEATURE_WLAN    (1u)
+#define ETH_FEATURE_TX_CSUM (2u) // device inserts tx checksums on request
+#define ETH_FEATURE_RX_CSUM (4u) // device may verify rx checksums
 
 // Get the fifos to submit tx and rx operations
 //   in: none
@@ -87,14 +89,19 @@ typedef struct eth_fifos_t {
 // of each fifo for each outstanding tx or rx request.  The fifo sizes
 // are returned along with the fifo handles in the eth_fifos_t.
 
-// flags values for request messages
-// - none -
+// flags values for request messages (tx)
+// Only valid when ETH_FEATURE_TX_CSUM was reported.  The frame must be
+// IPv6 with no extension headers and the L4 checksum field must hold
+// the pseudo-header sum; the device computes and inserts the rest.
+#define ETH_FIFO_TX_CSUM_UDP6   (8u)  // insert the UDP checksum
+#define ETH_FIFO_TX_CSUM_ICMP6 (16u)  // insert the ICMPv6 checksum
 
 // flags values for response messages
 #define ETH_FIFO_RX_OK   (1u)   // packet received okay
 #define ETH_FIFO_TX_OK   (1u)   // packet transmitted okay
 #define ETH_FIFO_INVALID (2u)   // offset+length not within io_vmo bounds
 #define ETH_FIFO_RX_TX   (4u)   // received our own tx packet (when TX_LISTEN)
+#define ETH_FIFO_RX_CSUM_OK (8u) // device verified the packet's checksums
 
 typedef struct eth_fifo_entry {
     // offset from start of io_vmo to packet data
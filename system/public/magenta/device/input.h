@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <magenta/device/ioctl.h>
 #include <magenta/device/ioctl-wrapper.h>
+#include <magenta/types.h>
 
 #define IOCTL_INPUT_GET_PROTOCOL \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 0)
@@ -26,6 +27,8 @@
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 7)
 #define IOCTL_INPUT_SET_REPORT \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_INPUT, 8)
+#define IOCTL_INPUT_GET_REPORT_RING \
+    IOCTL(IOCTL_KIND_GET_TWO_HANDLES, IOCTL_FAMILY_INPUT, 9)
 
 enum {
     INPUT_PROTO_NONE = 0,
@@ -59,6 +62,44 @@ typedef struct input_set_report {
     uint8_t data[];
 } input_set_report_t;
 
+// Shared-memory report delivery.
+//
+// IOCTL_INPUT_GET_REPORT_RING maps input reports into a ring buffer
+// shared with the client instead of delivering them through read().
+// The vmo contains an input_ring_hdr_t followed by 'capacity' record
+// slots of 'stride' bytes each; slot (n % capacity) holds record n.
+// The driver appends records and publishes 'wr' with release
+// semantics; the client consumes records and publishes 'rd' the same
+// way.  Reports arriving while the ring is full are counted in
+// 'dropped'.
+//
+// Wakeups are edge-style: the driver asserts MX_USER_SIGNAL_0 on the
+// event only when the ring transitions from empty to non-empty and
+// never deasserts it.  A client should clear the signal, then drain
+// records until rd == wr -- one wakeup per batch of reports, not one
+// per report.
+typedef struct input_ring_hdr {
+    uint32_t stride;   // bytes per record slot
+    uint32_t capacity; // record slots in the ring
+    uint64_t wr;       // slots produced; written by the driver
+    uint64_t rd;       // slots consumed; written by the client
+    uint64_t dropped;  // reports dropped while the ring was full
+} input_ring_hdr_t;
+
+typedef struct input_ring_record {
+    uint64_t timestamp; // MX_CLOCK_MONOTONIC time of delivery
+    uint16_t len;       // report length in bytes
+    uint16_t reserved[3];
+    uint8_t data[];     // the report, including any report id prefix
+} input_ring_record_t;
+
+typedef struct input_ring {
+    mx_handle_t vmo;   // ring memory; see input_ring_hdr_t
+    mx_handle_t event; // asserts MX_USER_SIGNAL_0 per batch
+    uint32_t stride;
+    uint32_t capacity;
+} input_ring_t;
+
 typedef struct boot_kbd_report {
     uint8_t modifier;
     uint8_t reserved;
@@ -103,3 +144,6 @@ IOCTL_WRAPPER_IN_VAROUT(ioctl_input_get_report, IOCTL_INPUT_GET_REPORT,
 
 // ssize_t ioctl_input_set_report(int fd, const input_set_report_t* in, size_t in_len);
 IOCTL_WRAPPER_VARIN(ioctl_input_set_report, IOCTL_INPUT_SET_REPORT, input_set_report_t);
+
+// ssize_t ioctl_input_get_report_ring(int fd, input_ring_t* out);
+IOCTL_WRAPPER_OUT(ioctl_input_get_report_ring, IOCTL_INPUT_GET_REPORT_RING, input_ring_t);
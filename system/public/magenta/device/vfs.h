@@ -29,8 +29,8 @@
 // Watch a directory for changes
 //   in: none
 //   out: handle to channel to get notified on.
-//        Notification messages are as for V2 but only
-//        ever have a single event per message.
+//        Notification messages are as for V2, including
+//        the packing of multiple events per message.
 #define IOCTL_VFS_WATCH_DIR \
     IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_VFS, 7)
 
@@ -47,6 +47,20 @@
 #define IOCTL_VFS_WATCH_DIR_V2 \
     IOCTL(IOCTL_KIND_SET_HANDLE, IOCTL_FAMILY_VFS, 8)
 
+// Create a copy-on-write snapshot of the filesystem.
+//   in: none
+//   out: handle to a vmo holding the frozen metadata region of the volume.
+// Data blocks referenced by the snapshot are pinned on the device until the
+// snapshot is released; live writes to them are redirected to fresh blocks.
+// Reading the vmo followed by the device's data region yields a
+// crash-consistent image of the volume as of the snapshot.
+#define IOCTL_VFS_SNAPSHOT_CREATE \
+    IOCTL(IOCTL_KIND_GET_HANDLE, IOCTL_FAMILY_VFS, 9)
+
+// Release the active snapshot, unpinning its blocks.
+#define IOCTL_VFS_SNAPSHOT_RELEASE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 10)
+
 typedef struct {
     mx_handle_t channel;  // Channel to which watch events will be sent
     uint32_t mask;        // Bitmask of desired events (1 << WATCH_EVT_*)
@@ -83,6 +97,11 @@ typedef struct {
 
 #define VFS_WATCH_NAME_MAX 255
 
+// Maximum number of bytes a single watch message may carry.  Servers may
+// pack events into messages up to this size; clients must read with a
+// buffer at least this large.
+#define VFS_WATCH_MSG_MAX 8192
+
 // ssize_t ioctl_vfs_mount_fs(int fd, mx_handle_t* in);
 IOCTL_WRAPPER_IN(ioctl_vfs_mount_fs, IOCTL_VFS_MOUNT_FS, mx_handle_t);
 
@@ -107,6 +126,12 @@ IOCTL_WRAPPER_OUT(ioctl_vfs_watch_dir, IOCTL_VFS_WATCH_DIR, mx_handle_t);
 // ssize_t ioctl_vfs_watch_dir_v2(int fd, vfs_watch_dir_t* in;
 IOCTL_WRAPPER_IN(ioctl_vfs_watch_dir_v2, IOCTL_VFS_WATCH_DIR_V2, vfs_watch_dir_t);
 
+// ssize_t ioctl_vfs_snapshot_create(int fd, mx_handle_t* out);
+IOCTL_WRAPPER_OUT(ioctl_vfs_snapshot_create, IOCTL_VFS_SNAPSHOT_CREATE, mx_handle_t);
+
+// ssize_t ioctl_vfs_snapshot_release(int fd);
+IOCTL_WRAPPER(ioctl_vfs_snapshot_release, IOCTL_VFS_SNAPSHOT_RELEASE);
+
 #define MOUNT_MKDIR_FLAG_REPLACE 1
 
 typedef struct mount_mkdir_config {
@@ -115,5 +140,24 @@ typedef struct mount_mkdir_config {
     char name[]; // Null-terminator required
 } mount_mkdir_config_t;
 
+// Resident filesystem server control protocol.
+//
+// A filesystem binary launched in 'service' mode stays resident and reads
+// these requests from the control channel passed as PA_USER0, replying with
+// an mx_status_t after each one. VFS_SERVICE_OP_MOUNT carries the mountee
+// channel as the first handle, followed by the handles of the block device
+// (as produced by mxio_transfer_fd); the server signals MX_USER_SIGNAL_0 on
+// the mountee channel once the filesystem is ready to serve requests, like a
+// freshly launched server. Unmounting uses the normal unmount signal on the
+// mount channel and leaves the server resident, so state validated for a
+// device may be reused when it is mounted again.
+#define VFS_SERVICE_OP_MOUNT    1
+#define VFS_SERVICE_OP_SHUTDOWN 2
+
+typedef struct vfs_service_request {
+    uint32_t op;       // VFS_SERVICE_OP_*
+    uint32_t reserved; // Must be zero.
+} vfs_service_request_t;
+
 // ssize_t ioctl_vfs_mount_mkdir_fs(int fd, mount_mkdir_config_t* in, size_t in_len);
 IOCTL_WRAPPER_VARIN(ioctl_vfs_mount_mkdir_fs, IOCTL_VFS_MOUNT_MKDIR_FS, mount_mkdir_config_t);
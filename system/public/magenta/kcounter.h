@@ -0,0 +1,35 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <magenta/compiler.h>
+
+__BEGIN_CDECLS
+
+// Layout of the kernel counters VMO handed to userboot as PA_VMO_KCOUNTERS.
+//
+// The VMO begins with an mx_kcounter_header_t, immediately followed by
+// the counter name table: num_counters entries of MX_KCOUNTER_NAME_LEN
+// bytes each, NUL padded.  The live counter arena starts at arena_offset
+// (page aligned) and holds max_cpus rows of arena_stride 64-bit slots;
+// the value of counter i is the sum of slot i across all rows.  The
+// kernel bumps the slots in place, so a tool that maps the VMO can
+// sample any counter at zero syscall cost by rereading the arena.
+
+#define MX_KCOUNTER_MAGIC        0x4b434e54u // 'KCNT'
+#define MX_KCOUNTER_VERSION      1u
+#define MX_KCOUNTER_NAME_LEN     56
+
+typedef struct mx_kcounter_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_counters;
+    uint64_t max_cpus;
+    uint64_t arena_offset;      // bytes from the start of the VMO
+    uint64_t arena_stride;      // 64-bit slots per cpu row
+} mx_kcounter_header_t;
+
+__END_CDECLS
@@ -89,4 +89,9 @@ enum {
 #define KTRACE_ACTION_REWIND    3 // options ignored
 #define KTRACE_ACTION_NEW_PROBE 4 // options ignored, ptr = name
 
+// Like START, but completed trace sub-buffers are consumed and recycled
+// as they are read, so tracing can run continuously while a reader
+// drains; records are dropped (and counted) if the reader falls behind.
+#define KTRACE_ACTION_START_STREAM 5 // options = grpmask, 0 = all
+
 __END_CDECLS
@@ -70,4 +70,29 @@ typedef struct {
 } mdi_node_t;
 static_assert(sizeof(mdi_node_t) == 16, "");
 
+// An optional lookup index may follow the root node within the MDI payload
+// (indicated by the bootdata length being larger than the root node length).
+// It maps (parent node offset, child id) to child node offset so readers can
+// binary search for a child instead of walking its siblings.
+// All offsets are relative to the start of the root node.
+// Readers that predate the index ignore the trailing bytes, since the root
+// node's length covers only the tree.
+#define MDI_INDEX_MAGIC 0x5849444d  // "MDIX"
+
+typedef struct {
+    uint32_t magic;                 // MDI_INDEX_MAGIC
+    uint32_t count;                 // number of mdi_index_entry_t following
+} mdi_index_t;
+
+// Index entries are sorted by (parent_offset, id). Entries with the same id
+// under the same parent remain in tree order, so the first match found by a
+// binary search is the same node a linear walk would return.
+typedef struct {
+    uint32_t    parent_offset;      // offset of the parent list node
+    mdi_id_t    id;                 // id of the child node
+    uint32_t    node_offset;        // offset of the child node
+    uint32_t    siblings_count;     // children of parent following this child
+} mdi_index_entry_t;
+static_assert(sizeof(mdi_index_entry_t) == 16, "");
+
 __END_CDECLS;
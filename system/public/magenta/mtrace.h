@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 __BEGIN_CDECLS
 
 // mtrace_control() can operate on a range of features, for now just IPT.
@@ -45,4 +47,54 @@ __BEGIN_CDECLS
 
 #define MTRACE_IPT_OPTIONS_CPU(options) ((options) & MTRACE_IPT_OPTIONS_CPU_MASK)
 
+// The sampling profiler: a periodic timer on each cpu records the running
+// thread and its kernel stack into a per-cpu buffer.
+
+#define MTRACE_KIND_PROFILE 1
+
+// Actions for the sampling profiler
+
+// Allocate the per-cpu sample buffers, arg = mx_profile_config_t.
+#define MTRACE_PROFILE_ALLOC 0
+
+// Start sampling on all cpus.
+#define MTRACE_PROFILE_START 1
+
+// Stop sampling. Buffers may only be read while sampling is stopped.
+#define MTRACE_PROFILE_STOP 2
+
+// Free the sample buffers.
+#define MTRACE_PROFILE_FREE 3
+
+// Fetch the number of records collected for a CPU, arg = uint32_t.
+#define MTRACE_PROFILE_GET_NUM_RECORDS 4
+
+// Fetch the records collected for a CPU, arg = mx_profile_record_t array.
+#define MTRACE_PROFILE_READ 5
+
+// The cpu number is encoded in options the same way as for IPT.
+#define MTRACE_PROFILE_OPTIONS_CPU_MASK 0x3f
+#define MTRACE_PROFILE_OPTIONS(cpu) (((cpu) & MTRACE_PROFILE_OPTIONS_CPU_MASK) + 0)
+
+#define MTRACE_PROFILE_OPTIONS_CPU(options) ((options) & MTRACE_PROFILE_OPTIONS_CPU_MASK)
+
+// Maximum number of pcs recorded per sample.
+#define MX_PROFILE_MAX_FRAMES 8
+
+typedef struct mx_profile_config {
+    uint64_t sample_period_ns; // time between samples on each cpu
+    uint32_t num_records;      // per-cpu buffer capacity, in records
+    uint32_t reserved;         // must be zero
+} mx_profile_config_t;
+
+// One stack sample. A cpu stops collecting samples once its buffer is full.
+typedef struct mx_profile_record {
+    uint64_t timestamp;
+    uint64_t pid;        // user process the thread belongs to, 0 for kernel threads
+    uint64_t tid;
+    uint32_t cpu;
+    uint32_t num_frames; // number of valid entries in |pc|
+    uint64_t pc[MX_PROFILE_MAX_FRAMES]; // kernel pcs, innermost first
+} mx_profile_record_t;
+
 __END_CDECLS
@@ -115,6 +115,13 @@ struct mx_proc_args {
 // VM object handle for the main executable file
 #define PA_VMO_EXECUTABLE        0x14
 
+// Handle to the VMO through which the kernel publishes its event
+// counters; see magenta/kcounter.h for the layout.  The handle is
+// readable and mappable but not writable.  The kernel keeps updating
+// the counters in place for the life of the system, so mapping the VMO
+// once is enough to sample them forever without further syscalls.
+#define PA_VMO_KCOUNTERS         0x15
+
 // Used by kernel and userboot during startup
 #define PA_VMO_BOOTDATA          0x1A
 
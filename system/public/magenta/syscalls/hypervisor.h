@@ -25,8 +25,13 @@ __BEGIN_CDECLS
 #if __x86_64__
 #define MX_HYPERVISOR_OP_GUEST_SET_ENTRY_CR3    7u
 #define MX_HYPERVISOR_OP_GUEST_SET_APIC_MEM     8u
+#define MX_HYPERVISOR_OP_GUEST_SET_PORT_TRAP    9u
 #endif // __x86_64__
 
+// Signal the given interrupt vector to the guest. Where the hardware supports
+// posted interrupts, the vector is delivered without forcing a VM exit.
+#define MX_HYPERVISOR_OP_GUEST_INTERRUPT        10u
+
 typedef struct mx_guest_gpr {
 #if __aarch64__
     uint64_t r[31];
@@ -51,6 +56,17 @@ typedef struct mx_guest_gpr {
 #endif
 } mx_guest_gpr_t;
 
+// Arguments for MX_HYPERVISOR_OP_GUEST_SET_PORT_TRAP. Guest writes to the
+// registered port range complete in the kernel: each write is queued to the
+// given FIFO as a MX_GUEST_PKT_TYPE_PORT_OUT packet and the guest resumes
+// without a round trip through the control FIFO. If the FIFO is full, the
+// packet is sent over the control FIFO instead.
+typedef struct mx_guest_port_trap_args {
+    uint16_t port;
+    uint16_t len;
+    mx_handle_t fifo;
+} mx_guest_port_trap_args_t;
+
 // Packets for communication over the control FIFO.
 
 #define MX_GUEST_PKT_TYPE_PORT_IN               1u
@@ -0,0 +1,67 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/types.h>
+
+__BEGIN_CDECLS
+
+// An ioring is a pair of single-producer single-consumer rings shared
+// between a process and the kernel. Userspace fills submission entries
+// describing operations on its own handles and bumps |sq_tail|; a single
+// mx_ioring_submit() call makes the kernel consume every pending entry and
+// post one completion entry per operation, so a batch of operations costs
+// one user/kernel transition instead of one per operation.
+//
+// Both rings live in the VMO returned by mx_ioring_create(), laid out as:
+//
+//   [0, 64)                        mx_ioring_hdr_t (remainder reserved)
+//   [64, ...)                      |entries| mx_ioring_sqe_t
+//   [MX_IORING_CQES_OFFSET, ...)   |entries| mx_ioring_cqe_t
+//
+// Ring indices are free running; an index taken modulo |entries| names a
+// slot. The kernel advances sq_head and cq_tail, userspace advances sq_tail
+// and cq_head. All completions for consumed entries are posted before
+// mx_ioring_submit() returns.
+
+typedef struct mx_ioring_hdr {
+    uint32_t sq_head;       // next submission the kernel will consume
+    uint32_t sq_tail;       // one past the last submission userspace filled
+    uint32_t cq_head;       // next completion userspace will consume
+    uint32_t cq_tail;       // one past the last completion the kernel posted
+} mx_ioring_hdr_t;
+
+#define MX_IORING_HDR_SIZE          ((uint64_t)64)
+#define MX_IORING_SQES_OFFSET       MX_IORING_HDR_SIZE
+#define MX_IORING_CQES_OFFSET(entries) \
+    (MX_IORING_SQES_OFFSET + (uint64_t)(entries) * sizeof(mx_ioring_sqe_t))
+#define MX_IORING_VMO_SIZE(entries) \
+    (MX_IORING_CQES_OFFSET(entries) + (uint64_t)(entries) * sizeof(mx_ioring_cqe_t))
+
+// operations
+#define MX_IORING_OP_NOP            ((uint32_t)0u)
+#define MX_IORING_OP_CHANNEL_WRITE  ((uint32_t)1u)   // data only, no handles
+#define MX_IORING_OP_SOCKET_WRITE   ((uint32_t)2u)
+#define MX_IORING_OP_VMO_READ       ((uint32_t)3u)
+#define MX_IORING_OP_VMO_WRITE      ((uint32_t)4u)
+
+typedef struct mx_ioring_sqe {
+    uint32_t opcode;        // MX_IORING_OP_*
+    uint32_t options;       // must be zero
+    mx_handle_t handle;     // operand handle in the submitting process
+    uint32_t reserved;      // must be zero
+    uint64_t buffer;        // user address of the data buffer
+    uint64_t length;        // bytes to transfer
+    uint64_t offset;        // byte offset, vmo operations only
+    uint64_t user_data;     // opaque, echoed in the completion
+} mx_ioring_sqe_t;
+
+typedef struct mx_ioring_cqe {
+    uint64_t user_data;     // copied from the submission
+    mx_status_t status;     // result of the operation
+    uint32_t actual;        // bytes transferred on success
+} mx_ioring_cqe_t;
+
+__END_CDECLS
@@ -29,6 +29,8 @@ typedef enum {
     MX_INFO_PROCESS_MAPS               = 13, // mx_info_maps_t[n]
     MX_INFO_THREAD_STATS               = 14, // mx_info_thread_stats_t[1]
     MX_INFO_CPU_STATS                  = 15, // mx_info_cpu_stats_t[n]
+    MX_INFO_JOB_TREE                   = 16, // mx_info_job_tree_entry_t[n]
+    MX_INFO_IRQ_STATS                  = 17, // mx_info_irq_stats_t[1]
     MX_INFO_LAST
 } mx_object_info_topic_t;
 
@@ -55,6 +57,7 @@ typedef enum {
     MX_OBJ_TYPE_HYPERVISOR          = 21,
     MX_OBJ_TYPE_GUEST               = 22,
     MX_OBJ_TYPE_TIMER               = 23,
+    MX_OBJ_TYPE_IORING              = 24,
     MX_OBJ_TYPE_LAST
 } mx_obj_type_t;
 
@@ -114,6 +117,12 @@ typedef struct mx_info_thread {
 typedef struct mx_info_thread_stats {
     // Total accumulated running time of the thread.
     mx_time_t total_runtime;
+
+    // Total accumulated time the thread has spent runnable, waiting for a
+    // cpu, and the longest single such wait.  Together with |total_runtime|
+    // this makes scheduling delay measurable in production.
+    mx_time_t total_queued_time;
+    mx_time_t max_queued_time;
 } mx_info_thread_stats_t;
 
 // Statistics about resources (e.g., memory) used by a task. Can be relatively
@@ -228,6 +237,37 @@ typedef struct mx_info_cpu_stats {
 
 #define MX_INFO_CPU_STATS_FLAG_ONLINE       (1u<<0)
 
+// Statistics for one interrupt handle, as returned by MX_INFO_IRQ_STATS.
+// Dispatch latency is measured from the hard IRQ firing to the waiting
+// handler thread being released from mx_interrupt_wait(), which is the
+// delay an interrupt storm on another vector inflicts on this one.
+typedef struct mx_info_irq_stats {
+    // number of times the interrupt has been signaled
+    uint64_t interrupts;
+    // time the interrupt last fired, on the MX_CLOCK_MONOTONIC timeline
+    mx_time_t last_signaled;
+    // accumulated and worst-case dispatch latency
+    mx_duration_t dispatch_latency_total;
+    mx_duration_t dispatch_latency_max;
+} mx_info_irq_stats_t;
+
+// One job or process in a job subtree, as returned by MX_INFO_JOB_TREE.
+// The topic walks the whole subtree depth-first, so tools can snapshot
+// the task tree in one syscall rather than querying each object.
+typedef struct mx_info_job_tree_entry {
+    // The koid of the job or process.
+    mx_koid_t koid;
+
+    // The koid of the job it belongs to.
+    mx_koid_t parent_koid;
+
+    // MX_OBJ_TYPE_JOB or MX_OBJ_TYPE_PROCESS.
+    uint32_t type;
+
+    // The object's name, as set by MX_PROP_NAME; null-terminated.
+    char name[MX_MAX_NAME_LEN];
+} mx_info_job_tree_entry_t;
+
 // Object properties.
 
 // Argument is a uint32_t.
@@ -257,6 +297,17 @@ typedef struct mx_info_cpu_stats {
 // does not affect the creation of processes.
 #define MX_PROP_JOB_MAX_HEIGHT              7u
 
+// Argument is a uint32_t bitmask of the cpus a thread may run on. The mask
+// must include at least one online cpu. Settable and gettable on thread
+// handles.
+#define MX_PROP_THREAD_CPU_AFFINITY         8u
+
+// Argument is a uint32_t element count. The fifo endpoint only asserts
+// MX_FIFO_READABLE once at least this many elements are pending, so a
+// consumer can batch its wakeups; zero resets to the default of one.
+// Settable and gettable on fifo handles.
+#define MX_PROP_FIFO_READ_THRESHOLD         9u
+
 // Values for mx_info_thread_t.state.
 #define MX_THREAD_STATE_NEW                 0u
 #define MX_THREAD_STATE_RUNNING             1u
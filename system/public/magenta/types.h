@@ -177,6 +177,12 @@ typedef struct {
     uint32_t rd_num_handles;
 } mx_channel_call_args_t;
 
+// Scatter/gather element for mx_channel_write_v/mx_channel_read_v.
+typedef struct {
+    void* buffer;
+    size_t capacity;
+} mx_iovec_t;
+
 // Structure for mx_object_wait_many():
 typedef struct {
     mx_handle_t handle;
@@ -218,6 +224,8 @@ typedef uint32_t mx_rights_t;
 #define MX_VMO_OP_CACHE_INVALIDATE       7u
 #define MX_VMO_OP_CACHE_CLEAN            8u
 #define MX_VMO_OP_CACHE_CLEAN_INVALIDATE 9u
+#define MX_VMO_OP_DONT_NEED              10u
+#define MX_VMO_OP_WILL_NEED              11u
 
 // VM Object clone flags
 #define MX_VMO_CLONE_COPY_ON_WRITE       1u
@@ -234,6 +242,23 @@ typedef uint32_t mx_rights_t;
 #define MX_VM_FLAG_CAN_MAP_WRITE      (1u << 8)
 #define MX_VM_FLAG_CAN_MAP_EXECUTE    (1u << 9)
 #define MX_VM_FLAG_MAP_RANGE          (1u << 10)
+#define MX_VM_FLAG_POPULATE           (1u << 11)
+
+// Structure for mx_vmar_map_batch():
+typedef struct mx_vmar_map_entry {
+    size_t vmar_offset;
+    mx_handle_t vmo;
+    uint32_t map_flags;
+    uint64_t vmo_offset;
+    size_t len;
+} mx_vmar_map_entry_t;
+
+// Memory pressure levels for mx_system_get_memory_pressure_event().
+// The event for a level is signaled while measured pressure is at or above
+// that level; the NORMAL event is signaled only while no pressure is present.
+#define MX_MEM_PRESSURE_NORMAL    (0u)
+#define MX_MEM_PRESSURE_WARNING   (1u)
+#define MX_MEM_PRESSURE_CRITICAL  (2u)
 
 // clock ids
 #define MX_CLOCK_MONOTONIC        (0u)
@@ -265,9 +290,43 @@ typedef int64_t mx_rel_off_t;
 
 #define MX_CHANNEL_MAX_MSG_BYTES            65536u
 #define MX_CHANNEL_MAX_MSG_HANDLES          64u
+#define MX_CHANNEL_MAX_MSG_IOVECS           16u
+
+// Message payload written by mx_channel_write_vmo(). The message carries
+// exactly one handle: a copy-on-write clone of the sender's VMO covering
+// |offset|..|offset + length|, so bulk payloads transfer without copying
+// the bytes through the channel. The clone shares pages with the
+// sender's VMO and is not a snapshot: as with mx_vmo_clone(), writes by
+// the sender stay visible through the clone until the receiver itself
+// writes the page. Receivers validating untrusted payloads must copy
+// them out first.
+#define MX_CHANNEL_VMO_MSG_TAG              ((uint32_t)0x564d4f30u) // 'VMO0'
+
+typedef struct mx_channel_vmo_msg {
+    uint32_t tag;                   // MX_CHANNEL_VMO_MSG_TAG
+    uint32_t reserved;
+    uint64_t offset;                // offset of the payload within the clone
+    uint64_t length;                // payload length in bytes
+} mx_channel_vmo_msg_t;
 
 // Socket options and limits.
 #define MX_SOCKET_HALF_CLOSE                1u
+// Create option: back the socket with a mappable ring VMO, obtainable
+// via mx_socket_get_buffer(), for in-place payload consumption.
+#define MX_SOCKET_MAPPED                    2u
+// Read option (MX_SOCKET_MAPPED only): advance the read cursor without
+// copying any data out.
+#define MX_SOCKET_CONSUME                   4u
+// Create option: preserve message boundaries. Each write queues one
+// datagram and each read returns at most one, truncating datagrams that
+// do not fit the supplied buffer.
+#define MX_SOCKET_DATAGRAM                  8u
+
+// Largest datagram a MX_SOCKET_DATAGRAM socket accepts.
+#define MX_SOCKET_MAX_DGRAM_BYTES           2032u
+// Most datagrams a single mx_socket_write_batch() or
+// mx_socket_read_batch() call can move.
+#define MX_SOCKET_MAX_BATCH                 16u
 
 // Flags which can be used to to control cache policy for APIs which map memory.
 typedef enum {
@@ -304,4 +363,10 @@ typedef atomic_int mx_futex_t;
 #endif
 #endif
 
+// A priority-inheritance futex word (see mx_futex_wait_pi) holds the
+// owning thread's handle value, with this bit set once a waiter exists.
+// Handle values never carry this bit, so the owner and the contested
+// state can share the word.
+#define MX_FUTEX_PI_CONTESTED ((int)0x80000000)
+
 __END_CDECLS
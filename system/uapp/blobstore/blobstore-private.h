@@ -8,6 +8,7 @@
 
 #include <bitmap/raw-bitmap.h>
 #include <merkle/digest.h>
+#include <merkle/tree.h>
 #include <mx/event.h>
 #include <mx/vmo.h>
 #include <mxtl/algorithm.h>
@@ -42,8 +43,14 @@ constexpr BlobFlags kBlobStateMask        = 0x00FF0000;
 constexpr BlobFlags kBlobFlagSync         = 0x01000000; // The blob is being written to disk
 constexpr BlobFlags kBlobFlagDeletable    = 0x02000000; // This node should be unlinked when closed
 constexpr BlobFlags kBlobFlagDirectory    = 0x04000000; // This node represents the root directory
+constexpr BlobFlags kBlobFlagVerified     = 0x08000000; // Blob data matches the merkle root
 constexpr BlobFlags kBlobOtherMask        = 0xFF000000;
 
+// Budget for the cache of verified blobs kept in memory after their last
+// handle closes (see Blobstore::CacheBlob). Exceeding the budget -- or
+// system-wide memory pressure -- evicts blobs in LRU order.
+constexpr uint64_t kBlobCacheMaxBytes = (64ULL << 20);
+
 static_assert(((kBlobStateMask | kBlobOtherMask) & V_FLAG_RESERVED_MASK) == 0,
               "Blobstore flags conflict with VFS-reserved flags");
 
@@ -54,10 +61,16 @@ public:
     struct TypeWavlTraits {
         static WAVLTreeNodeState& node_state(VnodeBlob& b) { return b.type_wavl_state_; }
     };
+    using CacheNodeState = mxtl::DoublyLinkedListNodeState<mxtl::RefPtr<VnodeBlob>>;
+    struct CacheLruTraits {
+        static CacheNodeState& node_state(VnodeBlob& b) { return b.cache_lru_state_; }
+    };
     const uint8_t* GetKey() const {
         return &digest_[0];
     };
 
+    bool InBlobCache() const { return cache_lru_state_.InContainer(); }
+
     BlobFlags GetState() const {
         return flags_ & kBlobStateMask;
     }
@@ -93,6 +106,7 @@ public:
 
 private:
     friend struct TypeWavlTraits;
+    friend struct CacheLruTraits;
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VnodeBlob);
 
@@ -146,6 +160,20 @@ private:
     // the contents of a VMO into memory when it is opened.
     mx_status_t InitVmos();
 
+    // Reads the chunk index and compressed extents of an LZ4 blob and
+    // inflates them chunk by chunk into the data VMO. The chunks are
+    // independent, so a pager could decompress only the chunks a read
+    // touches; until then the whole blob is inflated up front, like
+    // InitVmos does for raw blobs.
+    mx_status_t InitCompressed(const blobstore_inode_t* inode);
+
+    // Writes the fully-buffered blob data to disk, after the Merkle tree.
+    // The data is LZ4 compressed chunk by chunk if that saves at least one
+    // block beyond the cost of the chunk index, and stored raw otherwise;
+    // either way the unused tail of the original allocation is returned to
+    // the block map.
+    mx_status_t WriteData(blobstore_inode_t* inode);
+
     mx_status_t WriteShared(size_t start, size_t len, uint64_t maxlen,
                             mx_handle_t vmo, uint64_t start_block);
     // Called by Blob once the last write has completed, updating the
@@ -153,6 +181,7 @@ private:
     mx_status_t WriteMetadata();
 
     WAVLTreeNodeState type_wavl_state_;
+    CacheNodeState cache_lru_state_;
 
     const mxtl::RefPtr<Blobstore> blobstore_;
     mxtl::unique_ptr<MappedVmo> merkle_tree_;
@@ -161,6 +190,10 @@ private:
     mx::event readable_event_;
     uint64_t bytes_written_;
 
+    // Builds the Merkle tree incrementally as data is written, so hashing
+    // overlaps with downloading instead of happening in one pass at the end.
+    merkle::Tree merkle_builder_;
+
     BlobFlags flags_;
     uint8_t digest_[merkle::Digest::kLength];
 
@@ -218,6 +251,20 @@ private:
     Blobstore(int fd, const blobstore_info_t* info);
     mx_status_t LoadBitmaps();
 
+    // Retains a reference to a verified blob so that it outlives its open
+    // handles; a repeat open is then served by the "quick lookup" map with
+    // its data VMO still resident -- no disk I/O, no re-hashing. Touches
+    // the blob in the LRU if it is already cached.
+    void CacheBlob(mxtl::RefPtr<VnodeBlob> vn);
+
+    // Drops a blob from the verified-blob cache, if present. Called before
+    // unlinking, so deleted blobs cannot be resurrected by a cache hit.
+    void EvictBlob(VnodeBlob* vn);
+
+    // Evicts cached blobs (LRU first) until the cache fits its budget; the
+    // budget drops to zero while the system reports memory pressure.
+    void TrimCache();
+
     // Finds space for a block in memory. Does not update disk.
     mx_status_t AllocateBlocks(size_t nblocks, size_t* blkno_out);
     void FreeBlocks(size_t nblocks, size_t blkno);
@@ -246,6 +293,14 @@ private:
                                             VnodeBlob::TypeWavlTraits>;
     WAVLTreeByMerkle hash_; // Map of all 'in use' blobs
 
+    // Verified blobs with no open handles, most-recently-used first. The
+    // references held here keep the blobs in 'hash_' as well.
+    using BlobCacheList = mxtl::DoublyLinkedList<mxtl::RefPtr<VnodeBlob>,
+                                                 VnodeBlob::CacheLruTraits>;
+    BlobCacheList cache_;
+    uint64_t cache_bytes_;
+    mx_handle_t pressure_event_;
+
     RawBitmap block_map_;
     mxtl::unique_ptr<blobstore_inode_t[]> node_map_;
 };
@@ -257,4 +312,9 @@ mx_status_t blobstore_mount(mxtl::RefPtr<VnodeBlob>* out, int blockfd);
 mx_status_t readblk(int fd, uint64_t bno, void* data);
 mx_status_t writeblk(int fd, uint64_t bno, const void* data);
 
+// Ranged variants; transfer |count| consecutive blocks in one device
+// operation.
+mx_status_t readblks(int fd, uint64_t bno, uint64_t count, void* data);
+mx_status_t writeblks(int fd, uint64_t bno, uint64_t count, const void* data);
+
 } // namespace blobstore
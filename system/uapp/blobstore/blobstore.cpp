@@ -11,6 +11,7 @@
 #include <sys/stat.h>
 
 #include <fs/mxio-dispatcher.h>
+#include <lz4/lz4.h>
 #include <magenta/process.h>
 #include <magenta/syscalls.h>
 #include <mxalloc/new.h>
@@ -61,43 +62,78 @@ inline void* get_raw_bitmap_data(const RawBitmap& bm, uint64_t n) {
                    (uintptr_t)(kBlobstoreBlockSize * n));
 }
 
-// Read data from disk at block 'bno', into the 'nth' logical block of the vmo.
-mx_status_t vn_fill_block(int fd, mx_handle_t vmo, uint64_t n, uint64_t bno) {
+// The bounce buffer used to transfer between vmos and the block device
+// holds up to this many blocks, so extents move in large sequential device
+// operations rather than one block at a time.
+constexpr uint64_t kBlobstoreMaxXferBlocks = 32;
+
+// Read 'count' blocks of data from disk starting at block 'bno', into the
+// vmo starting at its 'nth' logical block.
+mx_status_t vn_fill_blocks(int fd, mx_handle_t vmo, uint64_t n, uint64_t count,
+                           uint64_t bno) {
     // TODO(smklein): read directly from block device into vmo; no need to copy
     // into an intermediate buffer.
-    char bdata[kBlobstoreBlockSize];
-    if (blobstore::readblk(fd, bno, bdata) != NO_ERROR) {
-        return ERR_IO;
+    AllocChecker ac;
+    uint64_t xfer = mxtl::min(count, kBlobstoreMaxXferBlocks);
+    mxtl::unique_ptr<char[]> bdata(new (&ac) char[xfer * kBlobstoreBlockSize]);
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
     }
-    mx_status_t status = vmo_write_exact(vmo, bdata, n * kBlobstoreBlockSize, kBlobstoreBlockSize);
-    if (status != NO_ERROR) {
-        return status;
+    while (count > 0) {
+        uint64_t c = mxtl::min(count, xfer);
+        if (blobstore::readblks(fd, bno, c, bdata.get()) != NO_ERROR) {
+            return ERR_IO;
+        }
+        mx_status_t status = vmo_write_exact(vmo, bdata.get(), n * kBlobstoreBlockSize,
+                                             c * kBlobstoreBlockSize);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        n += c;
+        bno += c;
+        count -= c;
     }
     return NO_ERROR;
 }
 
-// Write data to disk at block 'bno', from the 'nth' logical block of the vmo.
-mx_status_t vn_dump_block(int fd, mx_handle_t vmo, uint64_t n, uint64_t bno, bool partial) {
-    // TODO(smklein): read directly into block device from vmo; no need to copy
+// Write 'count' blocks of data to disk starting at block 'bno', from the
+// vmo starting at its 'nth' logical block.  If 'partial' is set, the vmo
+// may end mid-way through the final block; the remainder is zero-filled.
+mx_status_t vn_dump_blocks(int fd, mx_handle_t vmo, uint64_t n, uint64_t count,
+                           uint64_t bno, bool partial) {
+    // TODO(smklein): write directly from vmo into block device; no need to copy
     // into an intermediate buffer.
-    char bdata[kBlobstoreBlockSize];
-    size_t actual;
-    mx_status_t status = mx_vmo_read(vmo, bdata, n * kBlobstoreBlockSize,
-                                     kBlobstoreBlockSize, &actual);
-    if (status != NO_ERROR) {
-        return status;
-    }
-
-    if (partial)  {
-        // It's okay to read a partial block -- set the rest to 'zero'.
-        memset(bdata + actual, 0, sizeof(bdata) - actual);
-    } else if (actual != kBlobstoreBlockSize) {
-        // We should have been able to read the whole block.
-        return ERR_IO;
+    AllocChecker ac;
+    uint64_t xfer = mxtl::min(count, kBlobstoreMaxXferBlocks);
+    mxtl::unique_ptr<char[]> bdata(new (&ac) char[xfer * kBlobstoreBlockSize]);
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
     }
-
-    if (blobstore::writeblk(fd, bno, bdata) != NO_ERROR) {
-        return ERR_IO;
+    while (count > 0) {
+        uint64_t c = mxtl::min(count, xfer);
+        size_t len = c * kBlobstoreBlockSize;
+        size_t actual;
+        mx_status_t status = mx_vmo_read(vmo, bdata.get(), n * kBlobstoreBlockSize,
+                                         len, &actual);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        if (actual != len) {
+            if (partial && c == count) {
+                // It's okay to read a partial final block -- set the rest
+                // to 'zero'.
+                memset(bdata.get() + actual, 0, len - actual);
+            } else {
+                // We should have been able to read everything.
+                return ERR_IO;
+            }
+        }
+        if (blobstore::writeblks(fd, bno, c, bdata.get()) != NO_ERROR) {
+            return ERR_IO;
+        }
+        n += c;
+        bno += c;
+        count -= c;
     }
     return NO_ERROR;
 }
@@ -151,32 +187,42 @@ void* Blobstore::GetNodemapData(uint64_t n) const {
     return (void*)((uintptr_t)(node_map_.get()) + (uintptr_t)(kBlobstoreBlockSize * n));
 }
 
-mx_status_t readblk(int fd, uint64_t bno, void* data) {
+mx_status_t readblks(int fd, uint64_t bno, uint64_t count, void* data) {
     off_t off = bno * kBlobstoreBlockSize;
+    ssize_t len = count * kBlobstoreBlockSize;
     if (lseek(fd, off, SEEK_SET) < 0) {
         fprintf(stderr, "blobstore: cannot seek to block %lu\n", bno);
         return ERR_IO;
     }
-    if (read(fd, data, kBlobstoreBlockSize) != kBlobstoreBlockSize) {
-        fprintf(stderr, "blobstore: cannot read block %lu\n", bno);
+    if (read(fd, data, len) != len) {
+        fprintf(stderr, "blobstore: cannot read %lu blocks at %lu\n", count, bno);
         return ERR_IO;
     }
     return NO_ERROR;
 }
 
-mx_status_t writeblk(int fd, uint64_t bno, const void* data) {
+mx_status_t writeblks(int fd, uint64_t bno, uint64_t count, const void* data) {
     off_t off = bno * kBlobstoreBlockSize;
+    ssize_t len = count * kBlobstoreBlockSize;
     if (lseek(fd, off, SEEK_SET) < 0) {
         fprintf(stderr, "blobstore: cannot seek to block %lu\n", bno);
         return ERR_IO;
     }
-    if (write(fd, data, kBlobstoreBlockSize) != kBlobstoreBlockSize) {
-        fprintf(stderr, "blobstore: cannot write block %lu\n", bno);
+    if (write(fd, data, len) != len) {
+        fprintf(stderr, "blobstore: cannot write %lu blocks at %lu\n", count, bno);
         return ERR_IO;
     }
     return NO_ERROR;
 }
 
+mx_status_t readblk(int fd, uint64_t bno, void* data) {
+    return readblks(fd, bno, 1, data);
+}
+
+mx_status_t writeblk(int fd, uint64_t bno, const void* data) {
+    return writeblks(fd, bno, 1, data);
+}
+
 mx_status_t VnodeBlob::InitVmos() {
     if (blob_ != nullptr) {
         return NO_ERROR;
@@ -194,12 +240,11 @@ mx_status_t VnodeBlob::InitVmos() {
             goto fail;
         }
 
-        for (uint64_t n = 0; n < MerkleTreeBlocks(*inode); n++) {
-            uint64_t bno = inode->start_block + n;
-            if ((status = vn_fill_block(fd, merkle_tree_->GetVmo(), n, bno)) != NO_ERROR) {
-                FS_TRACE_ERROR("Failed to fill bno\n");
-                goto fail;
-            }
+        if ((status = vn_fill_blocks(fd, merkle_tree_->GetVmo(), 0,
+                                     MerkleTreeBlocks(*inode),
+                                     inode->start_block)) != NO_ERROR) {
+            FS_TRACE_ERROR("Failed to fill merkle tree\n");
+            goto fail;
         }
     }
 
@@ -208,12 +253,15 @@ mx_status_t VnodeBlob::InitVmos() {
         goto fail;
     }
 
-    for (uint64_t n = 0; n < BlobDataBlocks(*inode); n++) {
-        uint64_t bno = inode->start_block + n + MerkleTreeBlocks(*inode);
-        if ((status = vn_fill_block(fd, blob_->GetVmo(), n, bno)) != NO_ERROR) {
-            FS_TRACE_ERROR("Failed to fill bno\n");
+    if (inode->flags & kBlobstoreInodeFlagLZ4) {
+        if ((status = InitCompressed(inode)) != NO_ERROR) {
+            FS_TRACE_ERROR("Failed to inflate data\n");
             goto fail;
         }
+    } else if ((status = vn_fill_blocks(fd, blob_->GetVmo(), 0, BlobDataBlocks(*inode),
+                                        inode->start_block + MerkleTreeBlocks(*inode))) != NO_ERROR) {
+        FS_TRACE_ERROR("Failed to fill data\n");
+        goto fail;
     }
 
     return NO_ERROR;
@@ -222,6 +270,52 @@ fail:
     return status;
 }
 
+mx_status_t VnodeBlob::InitCompressed(const blobstore_inode_t* inode) {
+    int fd = blobstore_->blockfd_;
+    uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    uint64_t index_blocks = LZ4IndexBlocks(inode->blob_size);
+    uint64_t compressed_blocks = inode->num_blocks - merkle_blocks - index_blocks;
+
+    AllocChecker ac;
+    size_t buf_size = (index_blocks + compressed_blocks) * kBlobstoreBlockSize;
+    mxtl::unique_ptr<char[]> buf(new (&ac) char[buf_size]);
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    if (readblks(fd, inode->start_block + merkle_blocks,
+                 index_blocks + compressed_blocks, buf.get()) != NO_ERROR) {
+        return ERR_IO;
+    }
+
+    auto index = reinterpret_cast<const blobstore_lz4_index_t*>(buf.get());
+    const char* cdata = buf.get() + index_blocks * kBlobstoreBlockSize;
+    if ((index->chunk_count != LZ4Chunks(inode->blob_size)) ||
+        (index->compressed_length > compressed_blocks * kBlobstoreBlockSize)) {
+        FS_TRACE_ERROR("blobstore: bad chunk index\n");
+        return ERR_IO;
+    }
+
+    char* out = static_cast<char*>(blob_->GetData());
+    for (uint64_t n = 0; n < index->chunk_count; n++) {
+        uint64_t c_off = index->chunk_offset[n];
+        uint64_t c_end = (n + 1 < index->chunk_count) ? index->chunk_offset[n + 1]
+                                                      : index->compressed_length;
+        size_t out_size = mxtl::min<uint64_t>(kBlobstoreLZ4ChunkSize,
+                                              inode->blob_size - n * kBlobstoreLZ4ChunkSize);
+        if ((c_off > c_end) || (c_end > index->compressed_length)) {
+            FS_TRACE_ERROR("blobstore: bad chunk index\n");
+            return ERR_IO;
+        }
+        if (LZ4_decompress_safe(cdata + c_off, out + n * kBlobstoreLZ4ChunkSize,
+                                static_cast<int>(c_end - c_off),
+                                static_cast<int>(out_size)) != static_cast<int>(out_size)) {
+            FS_TRACE_ERROR("blobstore: chunk %lu failed to decompress\n", n);
+            return ERR_IO;
+        }
+    }
+    return NO_ERROR;
+}
+
 uint64_t VnodeBlob::SizeData() const {
     if (GetState() == kBlobStateReadable) {
         auto inode = &blobstore_->node_map_[map_index_];
@@ -246,6 +340,7 @@ VnodeBlob::VnodeBlob(mxtl::RefPtr<Blobstore> bs) :
 void VnodeBlob::BlobCloseHandles() {
     merkle_tree_ = nullptr;
     blob_ = nullptr;
+    flags_ &= ~kBlobFlagVerified; // Verification covered the dropped VMO.
     readable_event_.reset();
 }
 
@@ -267,6 +362,9 @@ mx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
     blobstore_inode_t* inode = &blobstore_->node_map_[map_index_];
     memset(inode->merkle_root_hash, 0, merkle::Digest::kLength);
     inode->blob_size = size_data;
+    inode->flags = 0;
+    // Worst case allocation; if the data compresses, the unused tail is
+    // returned to the block map once the compressed size is known.
     inode->num_blocks = MerkleTreeBlocks(*inode) + BlobDataBlocks(*inode);
 
     // Open VMOs, so we can begin writing after allocate succeeds.
@@ -279,6 +377,9 @@ mx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
     if ((status = MappedVmo::Create(size_data, &blob_)) != NO_ERROR) {
         goto fail;
     }
+    if ((status = merkle_builder_.CreateInit(size_data, size_merkle)) != NO_ERROR) {
+        goto fail;
+    }
 
     // Allocate space for the blob
     if ((status = blobstore_->AllocateBlocks(inode->num_blocks, &inode->start_block)) != NO_ERROR) {
@@ -298,30 +399,84 @@ fail:
 // to both (1) The containing VMO, and (2) disk.
 mx_status_t VnodeBlob::WriteShared(size_t start, size_t len, uint64_t maxlen,
                                    mx_handle_t vmo, uint64_t start_block) {
-    // Write as many 'entire blocks' as possible
+    // Write as many 'entire blocks' as possible, plus the partial block at
+    // the very end (if any), as one run of sequential device operations.
     uint64_t n = start / kBlobstoreBlockSize;
     uint64_t n_end = (start + len) / kBlobstoreBlockSize;
-    mx_status_t status;
-    while (n < n_end) {
-        status = vn_dump_block(blobstore_->blockfd_, vmo, n, n + start_block, false);
-        if (status != NO_ERROR) {
-            return status;
-        }
-        n++;
+    bool partial = (start + len == maxlen) && (maxlen % kBlobstoreBlockSize != 0);
+    uint64_t count = n_end - n + (partial ? 1 : 0);
+    assert(start + len <= maxlen);
+    if (count == 0) {
+        return NO_ERROR;
     }
+    return vn_dump_blocks(blobstore_->blockfd_, vmo, n, count, n + start_block,
+                          partial);
+}
 
-    // Special case: We've written all the 'whole blocks', but we're missing
-    // a partial block at the very end.
-    if ((start + len == maxlen) &&
-        (maxlen % kBlobstoreBlockSize != 0)) {
-        status = vn_dump_block(blobstore_->blockfd_, vmo, n, n + start_block, true);
-        if (status != NO_ERROR) {
-            return status;
+mx_status_t VnodeBlob::WriteData(blobstore_inode_t* inode) {
+    uint64_t merkle_blocks = MerkleTreeBlocks(*inode);
+    uint64_t data_blocks = BlobDataBlocks(*inode);
+    uint64_t index_blocks = LZ4IndexBlocks(inode->blob_size);
+    uint64_t chunks = LZ4Chunks(inode->blob_size);
+
+    // Compression must save at least one block once the chunk index is paid
+    // for, or the raw bytes are stored instead.
+    if (index_blocks + 1 < data_blocks) {
+        AllocChecker ac;
+        size_t index_size = index_blocks * kBlobstoreBlockSize;
+        size_t climit = (data_blocks - index_blocks - 1) * kBlobstoreBlockSize;
+        mxtl::unique_ptr<char[]> buf(new (&ac) char[index_size + climit]);
+        if (ac.check()) {
+            memset(buf.get(), 0, index_size);
+            auto index = reinterpret_cast<blobstore_lz4_index_t*>(buf.get());
+            char* cdata = buf.get() + index_size;
+            const char* data = static_cast<const char*>(blob_->GetData());
+            uint64_t c_off = 0;
+            uint64_t n;
+            for (n = 0; n < chunks; n++) {
+                size_t in_size = mxtl::min<uint64_t>(kBlobstoreLZ4ChunkSize,
+                                                     inode->blob_size - n * kBlobstoreLZ4ChunkSize);
+                // LZ4_compress_default returns zero when the output won't
+                // fit, which here means compression is not worth it.
+                int c_size = LZ4_compress_default(data + n * kBlobstoreLZ4ChunkSize,
+                                                  cdata + c_off, static_cast<int>(in_size),
+                                                  static_cast<int>(climit - c_off));
+                if (c_size <= 0) {
+                    break;
+                }
+                index->chunk_offset[n] = c_off;
+                c_off += c_size;
+            }
+            if (n == chunks) {
+                index->compressed_length = c_off;
+                index->chunk_count = chunks;
+                uint64_t compressed_blocks = mxtl::roundup(c_off, kBlobstoreBlockSize) /
+                        kBlobstoreBlockSize;
+                uint64_t new_blocks = merkle_blocks + index_blocks + compressed_blocks;
+                uint64_t old_blocks = inode->num_blocks;
+                // Zero the slack in the final block
+                memset(cdata + c_off, 0, compressed_blocks * kBlobstoreBlockSize - c_off);
+                if (writeblks(blobstore_->blockfd_, inode->start_block + merkle_blocks,
+                              index_blocks + compressed_blocks, buf.get()) != NO_ERROR) {
+                    return ERR_IO;
+                }
+                // Give back the blocks compression saved. The bitmap write
+                // must span the original allocation so the cleared tail is
+                // persisted; WriteMetadata only covers the new extent.
+                blobstore_->FreeBlocks(old_blocks - new_blocks,
+                                       inode->start_block + new_blocks);
+                inode->num_blocks = new_blocks;
+                inode->flags |= kBlobstoreInodeFlagLZ4;
+                if (blobstore_->WriteBitmap(old_blocks, inode->start_block) != NO_ERROR) {
+                    return ERR_IO;
+                }
+                return NO_ERROR;
+            }
         }
+        // Allocation failure or incompressible data; fall back to raw.
     }
-
-    assert(start + len <= maxlen);
-    return NO_ERROR;
+    return WriteShared(0, inode->blob_size, inode->blob_size, blob_->GetVmo(),
+                       inode->start_block + merkle_blocks);
 }
 
 mx_status_t VnodeBlob::WriteMetadata() {
@@ -382,9 +537,10 @@ mx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             return status;
         }
 
-        status = WriteShared(bytes_written_, len, inode->blob_size,
-                             blob_->GetVmo(),
-                             inode->start_block + MerkleTreeBlocks(*inode));
+        // Hash the chunk as it arrives, so the Merkle tree is nearly
+        // complete by the time the last byte is written.
+        void* merkle_data = (merkle_tree_ != nullptr) ? merkle_tree_->GetData() : nullptr;
+        status = merkle_builder_.CreateUpdate(data, to_write, merkle_data);
         if (status != NO_ERROR) {
             SetState(kBlobStateError);
             return status;
@@ -398,22 +554,25 @@ mx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             return NO_ERROR;
         }
 
-        // TODO(smklein): As an optimization, use the CreateInit/Update/Final
-        // methods to create the merkle tree as we write data, rather than
-        // waiting until the data is fully downloaded to create the tree.
+        merkle::Digest digest;
+        if (merkle_builder_.CreateFinal(merkle_data, &digest) != NO_ERROR) {
+            SetState(kBlobStateError);
+            return status;
+        } else if (digest != digest_) {
+            // Downloaded blob did not match provided digest
+            SetState(kBlobStateError);
+            return status;
+        }
+
+        // The data was buffered in the VMO; now that all of it has arrived
+        // (and hashed correctly), compress and write it out in one pass.
+        if ((status = WriteData(inode)) != NO_ERROR) {
+            SetState(kBlobStateError);
+            return status;
+        }
+
         size_t merkle_size = merkle::Tree::GetTreeLength(inode->blob_size);
         if (merkle_size > 0) {
-            merkle::Digest digest;
-            if (merkle::Tree::Create(blob_->GetData(), inode->blob_size, merkle_tree_->GetData(),
-                                     merkle_size, &digest) != NO_ERROR) {
-                SetState(kBlobStateError);
-                return status;
-            } else if (digest != digest_) {
-                // Downloaded blob did not match provided digest
-                SetState(kBlobStateError);
-                return status;
-            }
-
             status = WriteShared(0, merkle_size, merkle_size, merkle_tree_->GetVmo(),
                                  inode->start_block);
             if (status != NO_ERROR) {
@@ -427,6 +586,11 @@ mx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             SetState(kBlobStateError);
             return status;
         }
+
+        // The data was hashed in full as it arrived and matched the name,
+        // so the blob can enter the verified-blob cache right away.
+        flags_ |= kBlobFlagVerified;
+        blobstore_->CacheBlob(mxtl::RefPtr<VnodeBlob>(this));
         return NO_ERROR;
     }
 
@@ -461,24 +625,37 @@ mx_status_t VnodeBlob::CopyVmo(mx_rights_t rights, mx_handle_t* out) {
         return status;
     }
 
-    // TODO(smklein): We could lazily verify more of the VMO if:
-    // 1) We could fault in pages on-demand, or
-    // 2) We could create a COW subsection of the original VMO.
-    //
-    // For now, we aggressively verify the entire VMO up front.
-    merkle::Digest d;
-    d = ((const uint8_t*) &digest_[0]);
     auto inode = &blobstore_->node_map_[map_index_];
-    uint64_t size_merkle = merkle::Tree::GetTreeLength(inode->blob_size);
-    const void* merkle_data = (merkle_tree_ != nullptr) ? merkle_tree_->GetData() : nullptr;
-    status = merkle::Tree::Verify(blob_->GetData(), inode->blob_size,
-                                  merkle_data, size_merkle,
-                                  0, inode->blob_size, d);
+    if (!(flags_ & kBlobFlagVerified)) {
+        // TODO(smklein): We could lazily verify more of the VMO if
+        // we could fault in pages on-demand.
+        //
+        // For now, we aggressively verify the entire VMO up front -- but
+        // only once per in-memory copy of the data; afterwards the blob is
+        // marked verified and cached, so repeat opens skip this entirely.
+        merkle::Digest d;
+        d = ((const uint8_t*) &digest_[0]);
+        uint64_t size_merkle = merkle::Tree::GetTreeLength(inode->blob_size);
+        const void* merkle_data = (merkle_tree_ != nullptr) ? merkle_tree_->GetData() : nullptr;
+        status = merkle::Tree::Verify(blob_->GetData(), inode->blob_size,
+                                      merkle_data, size_merkle,
+                                      0, inode->blob_size, d);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        flags_ |= kBlobFlagVerified;
+    }
+    blobstore_->CacheBlob(mxtl::RefPtr<VnodeBlob>(this));
+
+    // Hand out a copy-on-write clone rather than the blob's own VMO, so
+    // clients can never alter the cached (verified) pages.
+    mx_handle_t clone;
+    status = mx_vmo_clone(blob_->GetVmo(), MX_VMO_CLONE_COPY_ON_WRITE, 0,
+                          BlobDataBlocks(*inode) * kBlobstoreBlockSize, &clone);
     if (status != NO_ERROR) {
         return status;
     }
-
-    return mx_handle_duplicate(blob_->GetVmo(), rights, out);
+    return mx_handle_replace(clone, rights, out);
 }
 
 mx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t* actual) {
@@ -491,8 +668,6 @@ mx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         return status;
     }
 
-    merkle::Digest d;
-    d = ((const uint8_t*) &digest_[0]);
     auto inode = &blobstore_->node_map_[map_index_];
     if (off >= inode->blob_size) {
         *actual = 0;
@@ -502,13 +677,17 @@ mx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         len = inode->blob_size - off;
     }
 
-    uint64_t size_merkle = merkle::Tree::GetTreeLength(inode->blob_size);
-    const void* merkle_data = (merkle_tree_ != nullptr) ? merkle_tree_->GetData() : nullptr;
-    status = merkle::Tree::Verify(blob_->GetData(), inode->blob_size,
-                                  merkle_data, size_merkle,
-                                  off, len, d);
-    if (status != NO_ERROR) {
-        return status;
+    if (!(flags_ & kBlobFlagVerified)) {
+        merkle::Digest d;
+        d = ((const uint8_t*) &digest_[0]);
+        uint64_t size_merkle = merkle::Tree::GetTreeLength(inode->blob_size);
+        const void* merkle_data = (merkle_tree_ != nullptr) ? merkle_tree_->GetData() : nullptr;
+        status = merkle::Tree::Verify(blob_->GetData(), inode->blob_size,
+                                      merkle_data, size_merkle,
+                                      off, len, d);
+        if (status != NO_ERROR) {
+            return status;
+        }
     }
 
     return mx_vmo_read(blob_->GetVmo(), data, off, len, actual);
@@ -516,6 +695,9 @@ mx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
 
 void VnodeBlob::QueueUnlink() {
     flags_ |= kBlobFlagDeletable;
+    // A deleted blob must not be resurrected by a cache hit. The caller
+    // holds a reference, so dropping the cache's cannot destroy us here.
+    blobstore_->EvictBlob(this);
 }
 
 // Allocates Blocks IN MEMORY
@@ -556,6 +738,10 @@ void Blobstore::FreeNode(size_t node_index) {
 }
 
 mx_status_t Blobstore::Unmount() {
+    // Cached blobs hold references back to this Blobstore; empty the cache
+    // so those cycles are broken and everything can be released.
+    cache_.clear();
+    cache_bytes_ = 0;
     close(blockfd_);
     return NO_ERROR;
 }
@@ -565,12 +751,12 @@ mx_status_t Blobstore::WriteBitmap(uint64_t nblocks, uint64_t start_block) {
     uint64_t bbm_end_block = mxtl::roundup(start_block + nblocks, kBlobstoreBlockBits) /
             kBlobstoreBlockBits;
 
-    // Write back the block allocation bitmap
-    for (uint64_t b = bbm_start_block; b < bbm_end_block; b++) {
-        void* data = GetBlockmapData(b);
-        if (writeblk(blockfd_, BlockMapStartBlock() + b, data) != NO_ERROR) {
-            return ERR_IO;
-        }
+    // Write back the affected region of the block allocation bitmap in a
+    // single device operation; the bitmap is contiguous in memory.
+    if (writeblks(blockfd_, BlockMapStartBlock() + bbm_start_block,
+                  bbm_end_block - bbm_start_block,
+                  GetBlockmapData(bbm_start_block)) != NO_ERROR) {
+        return ERR_IO;
     }
     return NO_ERROR;
 }
@@ -708,11 +894,58 @@ mx_status_t Blobstore::LookupBlob(const merkle::Digest& digest, mxtl::RefPtr<Vno
     return ERR_NOT_FOUND;
 }
 
-Blobstore::Blobstore(int fd, const blobstore_info_t* info) : blockfd_(fd) {
+void Blobstore::CacheBlob(mxtl::RefPtr<VnodeBlob> vn) {
+    if (vn->DeletionQueued()) {
+        return;
+    }
+    if (vn->InBlobCache()) {
+        // Already cached; move to the front of the LRU.
+        mxtl::RefPtr<VnodeBlob> ref = cache_.erase(*vn);
+        cache_.push_front(mxtl::move(ref));
+        TrimCache();
+        return;
+    }
+    cache_bytes_ += vn->SizeData();
+    cache_.push_front(mxtl::move(vn));
+    TrimCache();
+}
+
+void Blobstore::EvictBlob(VnodeBlob* vn) {
+    if (!vn->InBlobCache()) {
+        return;
+    }
+    cache_bytes_ -= vn->SizeData();
+    cache_.erase(*vn);
+}
+
+void Blobstore::TrimCache() {
+    uint64_t budget = kBlobCacheMaxBytes;
+    if (pressure_event_ != MX_HANDLE_INVALID) {
+        mx_signals_t pending = 0;
+        mx_object_wait_one(pressure_event_, MX_EVENT_SIGNALED, 0u, &pending);
+        if (pending & MX_EVENT_SIGNALED) {
+            // The system is short on memory; cached blobs are the first
+            // thing to go.
+            budget = 0;
+        }
+    }
+    while ((cache_bytes_ > budget) && !cache_.is_empty()) {
+        mxtl::RefPtr<VnodeBlob> vn = cache_.pop_back();
+        cache_bytes_ -= vn->SizeData();
+        // If no other handles remain, dropping 'vn' releases the blob.
+    }
+}
+
+Blobstore::Blobstore(int fd, const blobstore_info_t* info) :
+    blockfd_(fd), cache_bytes_(0), pressure_event_(MX_HANDLE_INVALID) {
     memcpy(&info_, info, sizeof(blobstore_info_t));
 }
 
-Blobstore::~Blobstore() {}
+Blobstore::~Blobstore() {
+    if (pressure_event_ != MX_HANDLE_INVALID) {
+        mx_handle_close(pressure_event_);
+    }
+}
 
 mx_status_t Blobstore::Create(int fd, const blobstore_info_t* info, mxtl::RefPtr<VnodeBlob>* out) {
     uint64_t blocks = info->block_count;
@@ -752,6 +985,13 @@ mx_status_t Blobstore::Create(int fd, const blobstore_info_t* info, mxtl::RefPtr
         return status;
     }
 
+    // Failure just means cached blobs are only trimmed by the byte budget,
+    // never proactively; not fatal.
+    if (mx_system_get_memory_pressure_event(MX_MEM_PRESSURE_WARNING,
+                                            &fs->pressure_event_) != NO_ERROR) {
+        fs->pressure_event_ = MX_HANDLE_INVALID;
+    }
+
     *out = mxtl::AdoptRef(new (&ac) VnodeBlob(mxtl::move(fs)));
     if (!ac.check()) {
         return ERR_NO_MEMORY;
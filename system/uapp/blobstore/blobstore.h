@@ -84,12 +84,16 @@ constexpr uint64_t kStartBlockFree     = 0;
 constexpr uint64_t kStartBlockReserved = 1;
 constexpr uint64_t kStartBlockMinimum  = 2; // Smallest 'data' block possible
 
+// Inode flags
+constexpr uint32_t kBlobstoreInodeFlagLZ4 = 0x00000001; // Data is LZ4 compressed
+
 typedef struct {
     uint8_t  merkle_root_hash[merkle::Digest::kLength];
     uint64_t start_block;
     uint64_t num_blocks;
     uint64_t blob_size;
-    uint64_t reserved;
+    uint32_t flags;
+    uint32_t reserved;
 } blobstore_inode_t;
 
 static_assert(sizeof(blobstore_inode_t) == kBlobstoreInodeSize,
@@ -102,5 +106,33 @@ constexpr uint64_t BlobDataBlocks(const blobstore_inode_t& blobNode) {
     return mxtl::roundup(blobNode.blob_size, kBlobstoreBlockSize) / kBlobstoreBlockSize;
 }
 
+// Compressed blobs are divided into independently compressed chunks of this
+// many uncompressed bytes (a multiple of the block size), so a read only
+// needs to decompress the chunks it touches.
+constexpr uint32_t kBlobstoreLZ4ChunkSize = 65536;
+
+static_assert(kBlobstoreLZ4ChunkSize % kBlobstoreBlockSize == 0,
+              "LZ4 chunk size should be a multiple of the blobstore block size");
+
+// On-disk chunk index for a compressed blob, stored in whole blocks between
+// the Merkle tree and the compressed data. The Merkle tree itself is never
+// compressed, and always covers the uncompressed bytes.
+typedef struct {
+    uint64_t compressed_length; // Total compressed data bytes
+    uint64_t chunk_count;
+    uint64_t chunk_offset[];    // Byte offset of each chunk's compressed data
+} blobstore_lz4_index_t;
+
+constexpr uint64_t LZ4Chunks(uint64_t blob_size) {
+    return (blob_size + kBlobstoreLZ4ChunkSize - 1) / kBlobstoreLZ4ChunkSize;
+}
+
+// Number of blocks reserved for the chunk index of a compressed blob
+constexpr uint64_t LZ4IndexBlocks(uint64_t blob_size) {
+    return mxtl::roundup(sizeof(blobstore_lz4_index_t) +
+                         LZ4Chunks(blob_size) * sizeof(uint64_t),
+                         kBlobstoreBlockSize) / kBlobstoreBlockSize;
+}
+
 void* GetBlock(const RawBitmap& bitmap, uint32_t blkno);
 void* GetBitBlock(const RawBitmap& bitmap, uint32_t* blkno_out, uint32_t bitno);
@@ -20,26 +20,32 @@ int main(int argc, char** argv) {
         printf("dlog: cannot open log\n");
     }
 
-    char buf[MX_LOG_RECORD_MAX];
-    mx_log_record_t* rec = (mx_log_record_t*)buf;
+    // the kernel packs as many whole records as fit per read, each
+    // record after the first starting on a 4 byte boundary
+    char buf[MX_LOG_RECORD_MAX * 4];
     for (;;) {
         mx_status_t status;
-        if ((status = mx_log_read(h, MX_LOG_RECORD_MAX, rec, 0)) < 0) {
+        if ((status = mx_log_read(h, sizeof(buf), buf, 0)) < 0) {
             if ((status == ERR_SHOULD_WAIT) && tail) {
                 mx_object_wait_one(h, MX_LOG_READABLE, MX_TIME_INFINITE, NULL);
                 continue;
             }
             break;
         }
-        char tmp[32];
-        size_t len = snprintf(tmp, sizeof(tmp), "[%05d.%03d] %c ",
-                            (int)(rec->timestamp / 1000000000ULL),
-                            (int)((rec->timestamp / 1000000ULL) % 1000ULL),
-                            (rec->flags & MX_LOG_FLAG_KERNEL) ? 'K' : 'U');
-        write(1, tmp, (len > sizeof(tmp) ? sizeof(tmp) : len));
-        write(1, rec->data, rec->datalen);
-        if ((rec->datalen == 0) || (rec->data[rec->datalen - 1] != '\n')) {
-            write(1, "\n", 1);
+        size_t off = 0;
+        while (off < (size_t)status) {
+            mx_log_record_t* rec = (mx_log_record_t*)(buf + off);
+            char tmp[32];
+            size_t len = snprintf(tmp, sizeof(tmp), "[%05d.%03d] %c ",
+                                (int)(rec->timestamp / 1000000000ULL),
+                                (int)((rec->timestamp / 1000000ULL) % 1000ULL),
+                                (rec->flags & MX_LOG_FLAG_KERNEL) ? 'K' : 'U');
+            write(1, tmp, (len > sizeof(tmp) ? sizeof(tmp) : len));
+            write(1, rec->data, rec->datalen);
+            if ((rec->datalen == 0) || (rec->data[rec->datalen - 1] != '\n')) {
+                write(1, "\n", 1);
+            }
+            off += (sizeof(mx_log_record_t) + rec->datalen + 3) & ~3ul;
         }
     }
     return 0;
@@ -0,0 +1,475 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/hypervisor.h>
+
+#include "block.h"
+
+/* Queue size reported through QUEUE_SIZE. */
+#define QUEUE_SIZE                          128u
+
+/* Alignment of the used ring within a queue, from Virtio 1.0, Section 2.4.2. */
+#define QUEUE_ALIGN                         4096u
+
+/* Virtio feature bits. */
+#define VIRTIO_RING_F_EVENT_IDX             (1u << 29)
+
+/* Virtio ISR status bits. */
+#define VIRTIO_ISR_QUEUE                    (1u << 0)
+
+/* Virtio descriptor flags. */
+#define VRING_DESC_F_NEXT                   (1u << 0)
+#define VRING_DESC_F_WRITE                  (1u << 1)
+
+/* Virtio available ring flags. */
+#define VRING_AVAIL_F_NO_INTERRUPT          (1u << 0)
+
+/* Virtio block request types. */
+#define VIRTIO_BLK_T_IN                     0u
+#define VIRTIO_BLK_T_OUT                    1u
+#define VIRTIO_BLK_T_FLUSH                  4u
+
+/* Virtio block request status codes. */
+#define VIRTIO_BLK_S_OK                     0u
+#define VIRTIO_BLK_S_IOERR                  1u
+#define VIRTIO_BLK_S_UNSUPP                 2u
+
+#define SECTOR_SIZE                         512u
+
+struct vring_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __PACKED;
+
+struct vring_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __PACKED;
+
+struct vring_used_elem {
+    uint32_t id;
+    uint32_t len;
+} __PACKED;
+
+struct vring_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct vring_used_elem ring[];
+} __PACKED;
+
+typedef struct virtio_blk_req {
+    uint32_t type;
+    uint32_t ioprio;
+    uint64_t sector;
+} __PACKED virtio_blk_req_t;
+
+mx_status_t block_init(block_dev_t* dev, const char* path, uintptr_t guest_physmem_addr,
+                       size_t guest_physmem_size) {
+    memset(dev, 0, sizeof(*dev));
+    dev->guest_physmem_addr = guest_physmem_addr;
+    dev->guest_physmem_size = guest_physmem_size;
+    dev->notify_fifo = MX_HANDLE_INVALID;
+    int ret = mtx_init(&dev->mutex, mtx_plain);
+    if (ret != thrd_success)
+        return ERR_INTERNAL;
+
+    dev->fd = open(path, O_RDWR);
+    if (dev->fd < 0) {
+        fprintf(stderr, "Failed to open block image \"%s\"\n", path);
+        return ERR_IO;
+    }
+    off_t size = lseek(dev->fd, 0, SEEK_END);
+    if (size < 0) {
+        fprintf(stderr, "Failed to read size of block image \"%s\"\n", path);
+        return ERR_IO;
+    }
+    dev->size = size;
+    return NO_ERROR;
+}
+
+/* Translate a guest physical range into a host pointer. */
+static void* guest_paddr_to_ptr(block_dev_t* dev, uint64_t addr, uint32_t len) {
+    if (addr > dev->guest_physmem_size || len > dev->guest_physmem_size - addr)
+        return NULL;
+    return (void*)(dev->guest_physmem_addr + addr);
+}
+
+static void queue_configure(block_dev_t* dev, uint32_t pfn) {
+    virtio_queue_t* queue = &dev->queue;
+    queue->pfn = pfn;
+    queue->size = QUEUE_SIZE;
+    queue->index = 0;
+    queue->desc = NULL;
+    queue->avail = NULL;
+    queue->avail_event = NULL;
+    queue->used = NULL;
+    queue->used_event = NULL;
+    if (pfn == 0)
+        return;
+
+    // Layout of a legacy queue, from Virtio 1.0, Section 2.4.2. The event
+    // indices directly follow the rings within the structures they notify
+    // about changes to.
+    uint64_t desc_paddr = (uint64_t)pfn * PAGE_SIZE;
+    uint32_t desc_size = QUEUE_SIZE * sizeof(struct vring_desc);
+    uint32_t avail_size = sizeof(struct vring_avail) + (QUEUE_SIZE + 1) * sizeof(uint16_t);
+    uint64_t used_paddr = (desc_paddr + desc_size + avail_size + QUEUE_ALIGN - 1) &
+                          ~(uint64_t)(QUEUE_ALIGN - 1);
+    uint32_t used_size = sizeof(struct vring_used) +
+                         QUEUE_SIZE * sizeof(struct vring_used_elem) + sizeof(uint16_t);
+
+    struct vring_desc* desc = guest_paddr_to_ptr(dev, desc_paddr, desc_size + avail_size);
+    struct vring_used* used = guest_paddr_to_ptr(dev, used_paddr, used_size);
+    if (desc == NULL || used == NULL) {
+        fprintf(stderr, "Queue PFN %#x is outside of guest physical memory\n", pfn);
+        queue->pfn = 0;
+        return;
+    }
+    queue->desc = desc;
+    queue->avail = (struct vring_avail*)((uintptr_t)desc + desc_size);
+    queue->used_event = &queue->avail->ring[QUEUE_SIZE];
+    queue->used = used;
+    queue->avail_event = (volatile uint16_t*)&queue->used->ring[QUEUE_SIZE];
+}
+
+mx_status_t block_handle_port_in(block_dev_t* dev, uint16_t offset, uint8_t access_size,
+                                 mx_guest_port_in_ret_t* port_in_ret) {
+    mtx_lock(&dev->mutex);
+    mx_status_t status = NO_ERROR;
+    switch (offset) {
+    case VIRTIO_PCI_DEVICE_FEATURES:
+        if (access_size != 4) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        port_in_ret->u32 = VIRTIO_RING_F_EVENT_IDX;
+        break;
+    case VIRTIO_PCI_QUEUE_PFN:
+        if (access_size != 4) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        port_in_ret->u32 = dev->queue_select == 0 ? dev->queue.pfn : 0;
+        break;
+    case VIRTIO_PCI_QUEUE_SIZE:
+        if (access_size != 2) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        port_in_ret->u16 = dev->queue_select == 0 ? QUEUE_SIZE : 0;
+        break;
+    case VIRTIO_PCI_DEVICE_STATUS:
+        if (access_size != 1) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        port_in_ret->u8 = dev->status;
+        break;
+    case VIRTIO_PCI_ISR_STATUS:
+        if (access_size != 1) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        // Reading the ISR status register clears it.
+        port_in_ret->u8 = dev->isr_status;
+        dev->isr_status = 0;
+        break;
+    default: {
+        // Device configuration space: the capacity in sectors.
+        uint16_t config_offset = offset - VIRTIO_PCI_CONFIG_OFFSET;
+        uint64_t capacity = dev->size / SECTOR_SIZE;
+        if (offset < VIRTIO_PCI_CONFIG_OFFSET ||
+            config_offset + access_size > sizeof(capacity)) {
+            status = ERR_NOT_SUPPORTED;
+            break;
+        }
+        memcpy(&port_in_ret->data, (uint8_t*)&capacity + config_offset, access_size);
+        break;
+    }}
+    mtx_unlock(&dev->mutex);
+    return status;
+}
+
+mx_status_t block_handle_port_out(block_dev_t* dev, uint16_t offset,
+                                  const mx_guest_port_out_t* port_out) {
+    mtx_lock(&dev->mutex);
+    mx_status_t status = NO_ERROR;
+    switch (offset) {
+    default:
+        status = ERR_NOT_SUPPORTED;
+        break;
+    case VIRTIO_PCI_DRIVER_FEATURES:
+        if (port_out->access_size != 4) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        dev->driver_features = port_out->u32;
+        break;
+    case VIRTIO_PCI_QUEUE_PFN:
+        if (port_out->access_size != 4) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        if (dev->queue_select == 0)
+            queue_configure(dev, port_out->u32);
+        break;
+    case VIRTIO_PCI_QUEUE_SELECT:
+        if (port_out->access_size != 2) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        dev->queue_select = port_out->u16;
+        break;
+    case VIRTIO_PCI_QUEUE_NOTIFY:
+        // Notify writes are trapped in the kernel and arrive on the notify
+        // FIFO. A write can only reach us here as the control FIFO fallback
+        // when the notify FIFO is full — in which case a wakeup is already
+        // pending and the device thread will drain the entire ring anyway,
+        // so the notification can be dropped.
+        break;
+    case VIRTIO_PCI_DEVICE_STATUS:
+        if (port_out->access_size != 1) {
+            status = ERR_IO_DATA_INTEGRITY;
+            break;
+        }
+        dev->status = port_out->u8;
+        // Writing zero to the status register resets the device.
+        if (port_out->u8 == 0) {
+            dev->driver_features = 0;
+            dev->isr_status = 0;
+            queue_configure(dev, 0);
+        }
+        break;
+    }
+    mtx_unlock(&dev->mutex);
+    return status;
+}
+
+/* Perform a block request against the backing file.
+ *
+ * Walks a descriptor chain of a header descriptor, zero or more data
+ * descriptors, and a status descriptor, and returns the number of bytes
+ * written to device-writable descriptors.
+ */
+static uint32_t block_handle_request(block_dev_t* dev, uint16_t head) {
+    virtio_queue_t* queue = &dev->queue;
+    uint32_t used_len = 0;
+    uint8_t blk_status = VIRTIO_BLK_S_OK;
+    uint8_t* status_ptr = NULL;
+
+    struct vring_desc* desc = &queue->desc[head % queue->size];
+    virtio_blk_req_t* req = guest_paddr_to_ptr(dev, desc->addr, desc->len);
+    if (req == NULL || desc->len != sizeof(virtio_blk_req_t))
+        return 0;
+    off_t off = req->sector * SECTOR_SIZE;
+
+    while (desc->flags & VRING_DESC_F_NEXT) {
+        desc = &queue->desc[desc->next % queue->size];
+        void* data = guest_paddr_to_ptr(dev, desc->addr, desc->len);
+        if (data == NULL) {
+            blk_status = VIRTIO_BLK_S_IOERR;
+            continue;
+        }
+        // The final device-writable descriptor of the chain holds the
+        // one-byte status, not data.
+        if (!(desc->flags & VRING_DESC_F_NEXT) && (desc->flags & VRING_DESC_F_WRITE) &&
+            desc->len >= sizeof(uint8_t)) {
+            status_ptr = (uint8_t*)data;
+            continue;
+        }
+        if (blk_status != VIRTIO_BLK_S_OK)
+            continue;
+        switch (req->type) {
+        case VIRTIO_BLK_T_IN:
+            if (!(desc->flags & VRING_DESC_F_WRITE) ||
+                pread(dev->fd, data, desc->len, off) != desc->len) {
+                blk_status = VIRTIO_BLK_S_IOERR;
+                break;
+            }
+            off += desc->len;
+            used_len += desc->len;
+            break;
+        case VIRTIO_BLK_T_OUT:
+            if ((desc->flags & VRING_DESC_F_WRITE) ||
+                pwrite(dev->fd, data, desc->len, off) != desc->len) {
+                blk_status = VIRTIO_BLK_S_IOERR;
+                break;
+            }
+            off += desc->len;
+            break;
+        case VIRTIO_BLK_T_FLUSH:
+            if (fsync(dev->fd) != 0)
+                blk_status = VIRTIO_BLK_S_IOERR;
+            break;
+        default:
+            blk_status = VIRTIO_BLK_S_UNSUPP;
+            break;
+        }
+    }
+
+    if (status_ptr != NULL) {
+        *status_ptr = blk_status;
+        used_len += sizeof(uint8_t);
+    }
+    return used_len;
+}
+
+/* Returns whether the driver asked to be interrupted for this batch.
+ *
+ * From Virtio 1.0, Section 2.4.7.2.
+ */
+static bool queue_needs_interrupt(virtio_queue_t* queue, uint32_t driver_features,
+                                  uint16_t new_idx, uint16_t old_idx) {
+    if (driver_features & VIRTIO_RING_F_EVENT_IDX) {
+        uint16_t event = *queue->used_event;
+        return (uint16_t)(new_idx - event - 1) < (uint16_t)(new_idx - old_idx);
+    }
+    return !(queue->avail->flags & VRING_AVAIL_F_NO_INTERRUPT);
+}
+
+/* Drain the available ring completely.
+ *
+ * All chains present in the ring are processed before any used entries are
+ * published, so a batch of requests costs a single used index update and at
+ * most one interrupt. While the device is draining, the available event
+ * index is left behind the driver's position, which suppresses further
+ * QUEUE_NOTIFY exits under VIRTIO_RING_F_EVENT_IDX; it is moved forward
+ * only once the ring is empty and the device goes back to sleep.
+ */
+static mx_status_t block_queue_drain(block_dev_t* dev) {
+    mtx_lock(&dev->mutex);
+    virtio_queue_t* queue = &dev->queue;
+    if (queue->desc == NULL) {
+        mtx_unlock(&dev->mutex);
+        return NO_ERROR;
+    }
+
+    uint16_t old_used_idx = queue->used->idx;
+    uint16_t batch = 0;
+    while (true) {
+        uint16_t avail_idx = queue->avail->idx;
+        if (queue->index == avail_idx) {
+            if (!(dev->driver_features & VIRTIO_RING_F_EVENT_IDX))
+                break;
+            // Ask to be notified about the next chain, then re-check the
+            // available index to close the race with a driver that added a
+            // chain before it saw the updated event index.
+            *queue->avail_event = avail_idx;
+            atomic_thread_fence(memory_order_seq_cst);
+            if (queue->avail->idx == avail_idx)
+                break;
+            continue;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        while (queue->index != avail_idx) {
+            uint16_t head = queue->avail->ring[queue->index % queue->size];
+            uint32_t used_len = block_handle_request(dev, head);
+            struct vring_used_elem* used =
+                &queue->used->ring[(old_used_idx + batch) % queue->size];
+            used->id = head;
+            used->len = used_len;
+            queue->index++;
+            batch++;
+        }
+    }
+
+    if (batch != 0) {
+        // Publish the batch with a single used index update.
+        atomic_thread_fence(memory_order_release);
+        queue->used->idx = old_used_idx + batch;
+        atomic_thread_fence(memory_order_seq_cst);
+        if (queue_needs_interrupt(queue, dev->driver_features, old_used_idx + batch,
+                                  old_used_idx)) {
+            // TODO(abdulla): Inject an interrupt once the local APIC
+            // supports it; until then drivers observe completion through
+            // the used ring.
+            dev->isr_status |= VIRTIO_ISR_QUEUE;
+        }
+    }
+    mtx_unlock(&dev->mutex);
+    return NO_ERROR;
+}
+
+static mx_status_t block_wait(mx_handle_t notify_fifo) {
+    mx_signals_t observed = 0;
+    while (!(observed & MX_FIFO_READABLE)) {
+        mx_status_t status = mx_object_wait_one(notify_fifo,
+                                                MX_FIFO_READABLE | MX_FIFO_PEER_CLOSED,
+                                                MX_TIME_INFINITE, &observed);
+        if (status != NO_ERROR)
+            return status;
+        if (observed & MX_FIFO_PEER_CLOSED)
+            return ERR_PEER_CLOSED;
+    }
+    return NO_ERROR;
+}
+
+static int block_loop(void* arg) {
+    block_dev_t* dev = arg;
+    mx_guest_packet_t packet[PAGE_SIZE / MX_GUEST_MAX_PKT_SIZE];
+    while (true) {
+        mx_status_t status = block_wait(dev->notify_fifo);
+        if (status != NO_ERROR) {
+            fprintf(stderr, "Failed to wait for readable on the block queue: %d\n", status);
+            return thrd_error;
+        }
+
+        // Any number of pending notifications coalesce into one drain of the
+        // entire available ring.
+        uint32_t num_packets;
+        status = mx_fifo_read(dev->notify_fifo, &packet, sizeof(packet), &num_packets);
+        if (status != NO_ERROR)
+            return thrd_error;
+
+        status = block_queue_drain(dev);
+        if (status != NO_ERROR) {
+            fprintf(stderr, "Failed to drain the block queue: %d\n", status);
+            return thrd_error;
+        }
+    }
+}
+
+mx_status_t block_start(block_dev_t* dev, mx_handle_t guest, uint16_t notify_port) {
+#if !__x86_64__
+    // Notify traps are only available on x86.
+    return ERR_NOT_SUPPORTED;
+#else
+    const uint32_t count = PAGE_SIZE / MX_GUEST_MAX_PKT_SIZE;
+    const uint32_t size = sizeof(mx_guest_packet_t);
+    mx_handle_t kernel_notify_fifo;
+    mx_status_t status = mx_fifo_create(count, size, 0, &kernel_notify_fifo, &dev->notify_fifo);
+    if (status != NO_ERROR)
+        return status;
+
+    mx_guest_port_trap_args_t trap_args;
+    memset(&trap_args, 0, sizeof(trap_args));
+    trap_args.port = notify_port;
+    trap_args.len = sizeof(uint16_t);
+    trap_args.fifo = kernel_notify_fifo;
+    status = mx_hypervisor_op(guest, MX_HYPERVISOR_OP_GUEST_SET_PORT_TRAP,
+                              &trap_args, sizeof(trap_args), NULL, 0);
+    if (status != NO_ERROR)
+        return status;
+
+    thrd_t thread;
+    int ret = thrd_create(&thread, block_loop, dev);
+    if (ret != thrd_success)
+        return ERR_INTERNAL;
+    ret = thrd_detach(thread);
+    if (ret != thrd_success)
+        return ERR_INTERNAL;
+    return NO_ERROR;
+#endif // __x86_64__
+}
@@ -0,0 +1,79 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <threads.h>
+
+#include <magenta/types.h>
+#include <magenta/syscalls/hypervisor.h>
+
+/* Legacy virtio register offsets, relative to BAR 0. */
+#define VIRTIO_PCI_DEVICE_FEATURES          0x00    // uint32_t
+#define VIRTIO_PCI_DRIVER_FEATURES          0x04    // uint32_t
+#define VIRTIO_PCI_QUEUE_PFN                0x08    // uint32_t
+#define VIRTIO_PCI_QUEUE_SIZE               0x0c    // uint16_t
+#define VIRTIO_PCI_QUEUE_SELECT             0x0e    // uint16_t
+#define VIRTIO_PCI_QUEUE_NOTIFY             0x10    // uint16_t
+#define VIRTIO_PCI_DEVICE_STATUS            0x12    // uint8_t
+#define VIRTIO_PCI_ISR_STATUS               0x13    // uint8_t
+#define VIRTIO_PCI_CONFIG_OFFSET            0x14
+
+/* Stores the virtio ring of a queue, mapped into guest physical memory. */
+typedef struct virtio_queue {
+    // Number of entries in the ring, as reported through QUEUE_SIZE.
+    uint16_t size;
+    // PFN written to QUEUE_PFN, or 0 if the queue is not configured.
+    uint32_t pfn;
+    // Next available ring entry to process.
+    uint16_t index;
+
+    struct vring_desc* desc;
+    struct vring_avail* avail;
+    // Written by the device to tell the driver when to notify; only valid
+    // when VIRTIO_RING_F_EVENT_IDX has been negotiated.
+    volatile uint16_t* avail_event;
+    struct vring_used* used;
+    // Written by the driver to tell the device when to interrupt; only
+    // valid when VIRTIO_RING_F_EVENT_IDX has been negotiated.
+    volatile uint16_t* used_event;
+} virtio_queue_t;
+
+/* Stores the state of a virtio block device. */
+typedef struct block_dev {
+    mtx_t mutex;
+    // Mapped address and size of guest physical memory.
+    uintptr_t guest_physmem_addr;
+    size_t guest_physmem_size;
+    // File descriptor backing the block device.
+    int fd;
+    // Size of the device, in bytes.
+    uint64_t size;
+
+    // Features negotiated with the driver.
+    uint32_t driver_features;
+    // Common configuration registers.
+    uint16_t queue_select;
+    uint8_t status;
+    uint8_t isr_status;
+    virtio_queue_t queue;
+
+    // FIFO that receives QUEUE_NOTIFY writes trapped in the kernel.
+    mx_handle_t notify_fifo;
+} block_dev_t;
+
+mx_status_t block_init(block_dev_t* dev, const char* path, uintptr_t guest_physmem_addr,
+                       size_t guest_physmem_size);
+
+/* Register the QUEUE_NOTIFY port trap and start the device thread.
+ *
+ * notify_port is the absolute IO port of the QUEUE_NOTIFY register.
+ */
+mx_status_t block_start(block_dev_t* dev, mx_handle_t guest, uint16_t notify_port);
+
+mx_status_t block_handle_port_in(block_dev_t* dev, uint16_t offset, uint8_t access_size,
+                                 mx_guest_port_in_ret_t* port_in_ret);
+
+mx_status_t block_handle_port_out(block_dev_t* dev, uint16_t offset,
+                                  const mx_guest_port_out_t* port_out);
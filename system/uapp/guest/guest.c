@@ -15,6 +15,7 @@
 #include <magenta/syscalls.h>
 #include <magenta/syscalls/hypervisor.h>
 
+#include "block.h"
 #include "magenta.h"
 #include "linux.h"
 #include "vcpu.h"
@@ -54,7 +55,7 @@ static int is_elf(const int fd, bool* result) {
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        fprintf(stderr, "usage: %s kernel.bin [ramdisk.bin]\n", basename(argv[0]));
+        fprintf(stderr, "usage: %s kernel.bin [ramdisk.bin [block.img]]\n", basename(argv[0]));
         return ERR_INVALID_ARGS;
     }
 
@@ -112,6 +113,22 @@ int main(int argc, char** argv) {
         return status;
     }
 
+    block_dev_t block_dev;
+    if (argc >= 4) {
+        status = block_init(&block_dev, argv[3], addr, kVmoSize);
+        if (status != NO_ERROR) {
+            fprintf(stderr, "Failed to create block device\n");
+            return status;
+        }
+        uint16_t notify_port = guest_state.pci_device_state[1].bar[0] + VIRTIO_PCI_QUEUE_NOTIFY;
+        status = block_start(&block_dev, context.guest, notify_port);
+        if (status != NO_ERROR) {
+            fprintf(stderr, "Failed to start block device\n");
+            return status;
+        }
+        guest_state.block_dev = &block_dev;
+    }
+
     uintptr_t pt_end_off;
     status = guest_create_page_table(addr, kVmoSize, &pt_end_off);
     if (status != NO_ERROR) {
@@ -12,6 +12,7 @@ MODULE_CFLAGS += \
     -Ithird_party/lib/acpica/source/include
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/block.c \
     $(LOCAL_DIR)/guest.c \
     $(LOCAL_DIR)/linux.c \
     $(LOCAL_DIR)/magenta.c \
@@ -19,6 +19,7 @@
 #include <acpica/actypes.h>
 #endif // __x86_64__
 
+#include "block.h"
 #include "vcpu.h"
 
 /* Memory-mapped device physical addresses. */
@@ -119,9 +120,24 @@
 #define PCI_BAR_SIZE_ROOT_COMPLEX               0x10
 #define PCI_BAR_SIZE_VIRTIO_BLOCK               0x40
 
+/* PCI device numbers. */
+#define PCI_DEVICE_NUMBER_VIRTIO_BLOCK          1u
+
 #define PCI_DEVICE(addr)                        (((addr - PCI_PHYS_BASE(0, 0, 0)) >> 15) & 0xff)
 #define PCI_BAR(offset)                         ((offset - PCI_REGISTER_BAR_0) / sizeof(uint32_t))
 
+/* Returns whether a port access falls within the virtio block BAR, and the
+ * offset of the register within it. */
+static bool virtio_block_port(guest_state_t* guest_state, uint16_t port, uint16_t* offset) {
+    if (guest_state->block_dev == NULL)
+        return false;
+    uint32_t bar0 = guest_state->pci_device_state[PCI_DEVICE_NUMBER_VIRTIO_BLOCK].bar[0] & ~0x3u;
+    if (port < bar0 || port >= bar0 + PCI_BAR_SIZE_VIRTIO_BLOCK)
+        return false;
+    *offset = port - bar0;
+    return true;
+}
+
 mx_status_t handle_rtc(uint8_t rtc_index, uint8_t* value) {
     time_t now = time(NULL);
     struct tm tm;
@@ -164,6 +180,16 @@ static mx_status_t handle_port_in(vcpu_context_t* context, const mx_guest_port_i
     memset(&packet, 0, sizeof(packet));
     packet.type = MX_GUEST_PKT_TYPE_PORT_IN;
 
+    uint16_t block_offset;
+    if (virtio_block_port(context->guest_state, port_in->port, &block_offset)) {
+        mx_status_t status = block_handle_port_in(context->guest_state->block_dev, block_offset,
+                                                  port_in->access_size, &packet.port_in_ret);
+        if (status != NO_ERROR)
+            return status;
+        uint32_t num_packets;
+        return mx_fifo_write(context->vcpu_fifo, &packet, sizeof(packet), &num_packets);
+    }
+
     io_port_state_t* io_port_state = &context->guest_state->io_port_state;
     switch (port_in->port) {
     default:
@@ -206,6 +232,10 @@ static mx_status_t handle_port_in(vcpu_context_t* context, const mx_guest_port_i
 }
 
 static mx_status_t handle_port_out(vcpu_context_t* context, const mx_guest_port_out_t* port_out) {
+    uint16_t block_offset;
+    if (virtio_block_port(context->guest_state, port_out->port, &block_offset))
+        return block_handle_port_out(context->guest_state->block_dev, block_offset, port_out);
+
     io_port_state_t* io_port_state = &context->guest_state->io_port_state;
     switch (port_out->port) {
     default:
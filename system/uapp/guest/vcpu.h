@@ -8,6 +8,8 @@
 
 #include <magenta/types.h>
 
+typedef struct block_dev block_dev_t;
+
 #define IO_APIC_REDIRECT_OFFSETS    128u
 #define IO_BUFFER_SIZE              512u
 #define PCI_MAX_DEVICES             2u
@@ -58,6 +60,8 @@ typedef struct guest_state {
     io_apic_state_t io_apic_state;
     io_port_state_t io_port_state;
     pci_device_state_t pci_device_state[PCI_MAX_DEVICES];
+    // Virtio block device backend, or NULL if no block image was given.
+    block_dev_t* block_dev;
 } guest_state_t;
 
 typedef struct vcpu_context {
@@ -4,9 +4,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <magenta/syscalls.h>
@@ -51,6 +54,33 @@ void bytes_per_second(uint64_t bytes, uint64_t nanos) {
     fprintf(stderr, "%g %s/s\n", rate, unit);
 }
 
+// Snapshot the device's counters so the run can be reported as a delta.
+// Quietly does nothing if the target is not a block device.
+void stats_begin(int fd, block_stats_t* before) {
+    if (ioctl_block_get_stats(fd, before) != sizeof(block_stats_t)) {
+        memset(before, 0, sizeof(block_stats_t));
+    }
+}
+
+void stats_end(int fd, block_stats_t* before) {
+    block_stats_t after;
+    if (ioctl_block_get_stats(fd, &after) != sizeof(block_stats_t)) {
+        return;
+    }
+    fprintf(stderr, "device: %" PRIu64 " reads, %" PRIu64 " writes, %" PRIu64
+            " errors, max depth %" PRIu64 "\n",
+            after.reads - before->reads, after.writes - before->writes,
+            after.errors - before->errors, after.max_depth);
+    fprintf(stderr, "latency:");
+    for (unsigned n = 0; n < BLOCK_STATS_LATENCY_BUCKETS; n++) {
+        uint64_t count = after.latency[n] - before->latency[n];
+        if (count) {
+            fprintf(stderr, " [<%uus]=%" PRIu64, 2u << n, count);
+        }
+    }
+    fprintf(stderr, "\n");
+}
+
 int usage(void);
 
 int iotime_lread(int argc, char** argv) {
@@ -72,6 +102,9 @@ int iotime_lread(int argc, char** argv) {
         return -1;
     }
 
+    block_stats_t stats;
+    stats_begin(fd, &stats);
+
     mx_time_t t0 = mx_time_get(MX_CLOCK_MONOTONIC);
     size_t n = total;
     while (n > 0) {
@@ -91,6 +124,7 @@ int iotime_lread(int argc, char** argv) {
 
     fprintf(stderr, "read %zu bytes in %zu ns: ", total, t1 - t0);
     bytes_per_second(total, t1 - t0);
+    stats_end(fd, &stats);
     return 0;
 }
 
@@ -153,6 +187,9 @@ int iotime_bread(int argc, char** argv) {
         }
     }
 
+    block_stats_t stats;
+    stats_begin(fd, &stats);
+
     mx_time_t t0 = mx_time_get(MX_CLOCK_MONOTONIC);
     size_t n = total;
     while (n > 0) {
@@ -172,6 +209,7 @@ int iotime_bread(int argc, char** argv) {
 
     fprintf(stderr, "read %zu bytes in %zu ns: ", total, t1 - t0);
     bytes_per_second(total, t1 - t0);
+    stats_end(fd, &stats);
     return 0;
 }
 
@@ -224,6 +262,9 @@ int iotime_fread(int argc, char** argv) {
         return -1;
     }
 
+    block_stats_t stats;
+    stats_begin(fd, &stats);
+
     mx_time_t t0 = mx_time_get(MX_CLOCK_MONOTONIC);
     size_t n = total;
     while (n > 0) {
@@ -246,6 +287,285 @@ int iotime_fread(int argc, char** argv) {
 
     fprintf(stderr, "read %zu bytes in %zu ns: ", total, t1 - t0);
     bytes_per_second(total, t1 - t0);
+    stats_end(fd, &stats);
+    return 0;
+}
+
+// fio-style configurable benchmark over the block FIFO interface. The FIFO
+// path goes straight to the block device with no posix buffering in between,
+// so this doubles as the raw-device mode. Each worker thread drives its own
+// transaction at a fixed queue depth; latency is measured per FIFO
+// transaction (i.e. per batch of <depth> requests).
+
+#define BENCH_LATENCY_BUCKETS 32
+
+typedef struct {
+    int fd;
+    fifo_client_t* client;
+    uint64_t area;       // working set size in bytes
+    size_t bufsz;        // bytes per request
+    uint32_t depth;      // requests per transaction
+    uint32_t write_pct;  // percentage of transactions that are writes
+    bool random;
+    mx_time_t deadline;
+} bench_config_t;
+
+typedef struct {
+    const bench_config_t* cfg;
+    thrd_t thread;
+    uint32_t index;
+    uint64_t seed;
+    txnid_t txnid;
+    vmoid_t vmoid;
+    // results
+    uint64_t ops;
+    uint64_t bytes;
+    uint64_t errors;
+    uint64_t latency[BENCH_LATENCY_BUCKETS];
+} bench_worker_t;
+
+static uint64_t rand64(uint64_t* seed) {
+    uint64_t x = *seed;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *seed = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static void latency_record(uint64_t* buckets, uint64_t nanos) {
+    uint64_t us = nanos / 1000;
+    unsigned n = 0;
+    while (((uint64_t)2 << n) <= us && n < BENCH_LATENCY_BUCKETS - 1) {
+        n++;
+    }
+    buckets[n]++;
+}
+
+static int bench_worker(void* arg) {
+    bench_worker_t* w = arg;
+    const bench_config_t* cfg = w->cfg;
+
+    uint64_t blocks = cfg->area / cfg->bufsz;
+    uint64_t next = (blocks / (w->index + 1)) % blocks; // stagger sequential workers
+    block_fifo_request_t requests[MAX_TXN_MESSAGES];
+
+    while (mx_time_get(MX_CLOCK_MONOTONIC) < cfg->deadline) {
+        for (uint32_t i = 0; i < cfg->depth; i++) {
+            uint64_t blk;
+            if (cfg->random) {
+                blk = rand64(&w->seed) % blocks;
+            } else {
+                blk = next;
+                next = (next + 1) % blocks;
+            }
+            bool write = cfg->write_pct && (rand64(&w->seed) % 100) < cfg->write_pct;
+            requests[i] = (block_fifo_request_t){
+                .txnid = w->txnid,
+                .vmoid = w->vmoid,
+                .opcode = write ? BLOCKIO_WRITE : BLOCKIO_READ,
+                .length = cfg->bufsz,
+                .vmo_offset = i * cfg->bufsz,
+                .dev_offset = blk * cfg->bufsz,
+            };
+        }
+
+        mx_time_t t0 = mx_time_get(MX_CLOCK_MONOTONIC);
+        mx_status_t status = block_fifo_txn(cfg->client, requests, cfg->depth);
+        mx_time_t t1 = mx_time_get(MX_CLOCK_MONOTONIC);
+
+        if (status != NO_ERROR) {
+            w->errors++;
+            continue;
+        }
+        latency_record(w->latency, t1 - t0);
+        w->ops += cfg->depth;
+        w->bytes += cfg->depth * cfg->bufsz;
+    }
+    return 0;
+}
+
+static void latency_report(const uint64_t* buckets, uint64_t total) {
+    if (total == 0) {
+        return;
+    }
+    fprintf(stderr, "latency (per txn):");
+    for (unsigned n = 0; n < BENCH_LATENCY_BUCKETS; n++) {
+        if (buckets[n]) {
+            fprintf(stderr, " [<%" PRIu64 "us]=%" PRIu64, (uint64_t)2 << n, buckets[n]);
+        }
+    }
+    fprintf(stderr, "\n");
+
+    static const struct { const char* name; uint64_t permille; } pcts[] = {
+        {"p50", 500}, {"p99", 990}, {"p99.9", 999},
+    };
+    for (unsigned p = 0; p < sizeof(pcts) / sizeof(pcts[0]); p++) {
+        uint64_t want = (total * pcts[p].permille) / 1000;
+        uint64_t seen = 0;
+        for (unsigned n = 0; n < BENCH_LATENCY_BUCKETS; n++) {
+            seen += buckets[n];
+            if (seen > want) {
+                fprintf(stderr, "%s%s<%" PRIu64 "us", p ? ", " : "",
+                        pcts[p].name, (uint64_t)2 << n);
+                break;
+            }
+        }
+    }
+    fprintf(stderr, "\n");
+}
+
+int iotime_bench(int argc, char** argv) {
+    if (argc < 3) {
+        return usage();
+    }
+
+    bench_config_t cfg = {
+        .area = 0,
+        .bufsz = 4096,
+        .depth = 1,
+        .write_pct = 0,
+        .random = false,
+    };
+    uint32_t threads = 1;
+    uint32_t seconds = 10;
+
+    for (int i = 3; i < argc; i++) {
+        if (!strcmp(argv[i], "-r")) {
+            cfg.random = true;
+        } else if (i + 1 < argc && !strcmp(argv[i], "-t")) {
+            threads = number(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-q")) {
+            cfg.depth = number(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-b")) {
+            cfg.bufsz = number(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-s")) {
+            cfg.area = number(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-d")) {
+            seconds = number(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-w")) {
+            cfg.write_pct = number(argv[++i]);
+        } else {
+            return usage();
+        }
+    }
+    if (threads == 0 || threads > MAX_TXN_COUNT || cfg.depth == 0 ||
+        cfg.depth > MAX_TXN_MESSAGES || cfg.write_pct > 100 ||
+        (cfg.bufsz % 4096)) {
+        fprintf(stderr, "error: invalid benchmark parameters\n");
+        return -1;
+    }
+
+    int fd;
+    if (!strcmp(argv[2], "--ramdisk")) {
+        if (cfg.area == 0) {
+            cfg.area = 64 * 1024 * 1024;
+        }
+        if ((fd = make_ramdisk(cfg.area)) < 0) {
+            fprintf(stderr, "error: cannot create %" PRIu64 "-byte ramdisk\n", cfg.area);
+            return -1;
+        }
+    } else {
+        if ((fd = open(argv[2], O_RDWR)) < 0) {
+            fprintf(stderr, "error: cannot open '%s'\n", argv[2]);
+            return -1;
+        }
+    }
+
+    block_info_t info;
+    if (ioctl_block_get_info(fd, &info) != sizeof(info)) {
+        fprintf(stderr, "error: cannot get info for '%s'\n", argv[2]);
+        return -1;
+    }
+    uint64_t devsize = info.block_count * info.block_size;
+    if (cfg.area == 0 || cfg.area > devsize) {
+        cfg.area = devsize;
+    }
+    if (cfg.area < cfg.bufsz * cfg.depth) {
+        fprintf(stderr, "error: working set smaller than one transaction\n");
+        return -1;
+    }
+
+    mx_handle_t fifo;
+    if (ioctl_block_get_fifos(fd, &fifo) != sizeof(fifo)) {
+        fprintf(stderr, "error: cannot get fifo for '%s'\n", argv[2]);
+        return -1;
+    }
+    if (block_fifo_create_client(fifo, &cfg.client) != NO_ERROR) {
+        fprintf(stderr, "error: cannot create block client for '%s'\n", argv[2]);
+        return -1;
+    }
+    cfg.fd = fd;
+
+    bench_worker_t* workers = calloc(threads, sizeof(bench_worker_t));
+    if (workers == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        return -1;
+    }
+
+    // Per-worker resources: a txn for queueing, and a vmo wide enough to
+    // back |depth| in-flight requests.
+    for (uint32_t n = 0; n < threads; n++) {
+        bench_worker_t* w = &workers[n];
+        w->cfg = &cfg;
+        w->index = n;
+        w->seed = 0x9e3779b97f4a7c15ULL * (n + 1);
+        if (ioctl_block_alloc_txn(fd, &w->txnid) != sizeof(txnid_t)) {
+            fprintf(stderr, "error: cannot allocate txn\n");
+            return -1;
+        }
+        mx_handle_t vmo, dup;
+        if (mx_vmo_create(cfg.bufsz * cfg.depth, 0, &vmo) != NO_ERROR ||
+            mx_handle_duplicate(vmo, MX_RIGHT_SAME_RIGHTS, &dup) != NO_ERROR) {
+            fprintf(stderr, "error: cannot create vmo\n");
+            return -1;
+        }
+        if (ioctl_block_attach_vmo(fd, &dup, &w->vmoid) != sizeof(vmoid_t)) {
+            fprintf(stderr, "error: cannot attach vmo\n");
+            return -1;
+        }
+    }
+
+    block_stats_t stats;
+    stats_begin(fd, &stats);
+    cfg.deadline = mx_time_get(MX_CLOCK_MONOTONIC) + MX_SEC(seconds);
+
+    mx_time_t t0 = mx_time_get(MX_CLOCK_MONOTONIC);
+    for (uint32_t n = 0; n < threads; n++) {
+        if (thrd_create(&workers[n].thread, bench_worker, &workers[n]) != thrd_success) {
+            fprintf(stderr, "error: cannot create worker thread\n");
+            return -1;
+        }
+    }
+
+    uint64_t ops = 0, bytes = 0, txns = 0, errors = 0;
+    uint64_t latency[BENCH_LATENCY_BUCKETS] = {};
+    for (uint32_t n = 0; n < threads; n++) {
+        thrd_join(workers[n].thread, NULL);
+        ops += workers[n].ops;
+        bytes += workers[n].bytes;
+        errors += workers[n].errors;
+        for (unsigned b = 0; b < BENCH_LATENCY_BUCKETS; b++) {
+            txns += workers[n].latency[b];
+            latency[b] += workers[n].latency[b];
+        }
+    }
+    mx_time_t t1 = mx_time_get(MX_CLOCK_MONOTONIC);
+
+    fprintf(stderr, "%s %s, %u thread(s), depth %u, %zu-byte bufs, %u%% writes\n",
+            cfg.random ? "random" : "sequential",
+            cfg.write_pct == 0 ? "read" : (cfg.write_pct == 100 ? "write" : "mixed"),
+            threads, cfg.depth, cfg.bufsz, cfg.write_pct);
+    double s = (double)(t1 - t0) / 1000000000.0;
+    fprintf(stderr, "%" PRIu64 " ops (%" PRIu64 " errors) in %.3fs: %.0f IOPS, ",
+            ops, errors, s, (double)ops / s);
+    bytes_per_second(bytes, t1 - t0);
+    latency_report(latency, txns);
+    stats_end(fd, &stats);
+
+    block_fifo_release_client(cfg.client);
+    free(workers);
+    close(fd);
     return 0;
 }
 
@@ -254,7 +574,16 @@ int usage(void) {
             "usage: iotime <op>...\n\n"
             "   op: lread <device> <bytes> <bufsize>   posix linear read\n"
             "       bread <device> <bytes> <bufsize>   block linear read\n"
-            "       fread <device> <bytes> <bufsize>   fifo linear read\n");
+            "       fread <device> <bytes> <bufsize>   fifo linear read\n"
+            "       bench <device>|--ramdisk [opts]    fifo benchmark\n"
+            "\n"
+            "   bench opts: -t <threads>  worker threads (default 1)\n"
+            "               -q <depth>    requests per transaction (default 1)\n"
+            "               -b <bytes>    bytes per request (default 4096)\n"
+            "               -s <bytes>    working set size (default device size)\n"
+            "               -d <seconds>  duration (default 10)\n"
+            "               -w <pct>      percentage of writes (default 0)\n"
+            "               -r            random offsets (default sequential)\n");
     return -1;
 }
 
@@ -269,6 +598,8 @@ int main(int argc, char** argv) {
         return iotime_bread(argc, argv);
     } else if (!strcmp(argv[1], "fread")) {
         return iotime_fread(argc, argv);
+    } else if (!strcmp(argv[1], "bench")) {
+        return iotime_bench(argc, argv);
     } else {
         return usage();
     }
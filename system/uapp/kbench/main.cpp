@@ -0,0 +1,494 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Microbenchmarks for the hot kernel paths: syscall entry, channel
+// write/read/call, futex wake and ping-pong, port queue/wait, vmo
+// read/write/fault, thread and process spawn. Each benchmark times
+// individual operations so we can report percentiles rather than a
+// single throughput number; pass -m for machine-readable CSV so lab
+// scripts can diff runs against each other when bisecting.
+
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <launchpad/launchpad.h>
+#include <magenta/compiler.h>
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/port.h>
+#include <mxtl/unique_ptr.h>
+
+namespace {
+
+const char* self_path;
+
+// ---------------------------------------------------------------------------
+// Harness
+
+struct Bench {
+    const char* name;
+    uint32_t default_iters;
+    void* (*setup)(uint32_t total_iters);
+    void (*op)(void* state);
+    void (*teardown)(void* state);
+};
+
+int compare_u64(const void* a, const void* b) {
+    uint64_t lhs = *static_cast<const uint64_t*>(a);
+    uint64_t rhs = *static_cast<const uint64_t*>(b);
+    if (lhs < rhs)
+        return -1;
+    return lhs > rhs ? 1 : 0;
+}
+
+// |samples| must be sorted. |permille| is the percentile in tenths of a
+// percent, so p99.9 is 999.
+uint64_t percentile(const uint64_t* samples, uint32_t count, uint32_t permille) {
+    uint32_t idx = static_cast<uint32_t>((static_cast<uint64_t>(count) * permille) / 1000u);
+    if (idx >= count)
+        idx = count - 1;
+    return samples[idx];
+}
+
+void run_bench(const Bench& bench, uint32_t warmup, uint32_t iters, bool machine) {
+    void* state = bench.setup ? bench.setup(warmup + iters) : nullptr;
+
+    for (uint32_t i = 0; i < warmup; i++)
+        bench.op(state);
+
+    mxtl::unique_ptr<uint64_t[]> samples(new uint64_t[iters]);
+    for (uint32_t i = 0; i < iters; i++) {
+        uint64_t start = mx_ticks_get();
+        bench.op(state);
+        samples[i] = mx_ticks_get() - start;
+    }
+
+    if (bench.teardown)
+        bench.teardown(state);
+
+    qsort(samples.get(), iters, sizeof(uint64_t), compare_u64);
+
+    double scale = 1000000000.0 / static_cast<double>(mx_ticks_per_second());
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < iters; i++)
+        total += samples[i];
+
+    double mean = static_cast<double>(total) * scale / iters;
+    double min = static_cast<double>(samples[0]) * scale;
+    double max = static_cast<double>(samples[iters - 1]) * scale;
+    double p50 = static_cast<double>(percentile(samples.get(), iters, 500)) * scale;
+    double p99 = static_cast<double>(percentile(samples.get(), iters, 990)) * scale;
+    double p999 = static_cast<double>(percentile(samples.get(), iters, 999)) * scale;
+
+    if (machine) {
+        printf("%s,%" PRIu32 ",%.0f,%.0f,%.0f,%.0f,%.0f,%.0f\n",
+               bench.name, iters, min, p50, p99, p999, max, mean);
+    } else {
+        printf("%-20s %8" PRIu32 " iters: min %8.0f  p50 %8.0f  p99 %8.0f"
+               "  p99.9 %8.0f  max %9.0f  mean %8.0f ns\n",
+               bench.name, iters, min, p50, p99, p999, max, mean);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// syscall-null: cheapest possible trip through the syscall layer.
+
+void syscall_null_op(void*) {
+    mx_handle_close(MX_HANDLE_INVALID);
+}
+
+// ---------------------------------------------------------------------------
+// channel-write-read: one message through a channel, same thread.
+
+constexpr uint32_t kMsgSize = 64;
+
+struct channel_state_t {
+    mx_handle_t mp[2];
+    uint8_t buf[kMsgSize];
+};
+
+void* channel_setup(uint32_t) {
+    channel_state_t* s = new channel_state_t;
+    __UNUSED mx_status_t status = mx_channel_create(0u, &s->mp[0], &s->mp[1]);
+    assert(status == NO_ERROR);
+    memset(s->buf, 0, sizeof(s->buf));
+    return s;
+}
+
+void channel_write_read_op(void* state) {
+    channel_state_t* s = static_cast<channel_state_t*>(state);
+    __UNUSED mx_status_t status;
+    status = mx_channel_write(s->mp[0], 0u, s->buf, kMsgSize, nullptr, 0u);
+    assert(status == NO_ERROR);
+    uint32_t r_size = kMsgSize;
+    status = mx_channel_read(s->mp[1], 0u, s->buf, nullptr, r_size, 0u, &r_size, nullptr);
+    assert(status == NO_ERROR);
+}
+
+void channel_teardown(void* state) {
+    channel_state_t* s = static_cast<channel_state_t*>(state);
+    mx_handle_close(s->mp[0]);
+    mx_handle_close(s->mp[1]);
+    delete s;
+}
+
+// ---------------------------------------------------------------------------
+// channel-call: full synchronous round trip against an echo thread.
+
+struct call_state_t {
+    mx_handle_t client;
+    thrd_t server;
+    mx_txid_t txid;
+};
+
+int call_server(void* arg) {
+    mx_handle_t ch = static_cast<mx_handle_t>(reinterpret_cast<uintptr_t>(arg));
+    for (;;) {
+        mx_signals_t pending;
+        mx_status_t status = mx_object_wait_one(
+            ch, MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED, MX_TIME_INFINITE, &pending);
+        if (status != NO_ERROR)
+            break;
+        if (pending & MX_CHANNEL_READABLE) {
+            uint8_t buf[kMsgSize];
+            uint32_t size = kMsgSize;
+            status = mx_channel_read(ch, 0u, buf, nullptr, size, 0u, &size, nullptr);
+            if (status != NO_ERROR)
+                break;
+            // Echo the message back, txid and all.
+            status = mx_channel_write(ch, 0u, buf, size, nullptr, 0u);
+            if (status != NO_ERROR)
+                break;
+        } else {
+            break;
+        }
+    }
+    mx_handle_close(ch);
+    return 0;
+}
+
+void* call_setup(uint32_t) {
+    call_state_t* s = new call_state_t;
+    mx_handle_t server_ch;
+    __UNUSED mx_status_t status = mx_channel_create(0u, &s->client, &server_ch);
+    assert(status == NO_ERROR);
+    s->txid = 1;
+    __UNUSED int ret = thrd_create(
+        &s->server, call_server,
+        reinterpret_cast<void*>(static_cast<uintptr_t>(server_ch)));
+    assert(ret == thrd_success);
+    return s;
+}
+
+void channel_call_op(void* state) {
+    call_state_t* s = static_cast<call_state_t*>(state);
+    uint8_t buf[kMsgSize] = {};
+    memcpy(buf, &s->txid, sizeof(s->txid));
+    s->txid++;
+
+    mx_channel_call_args_t args = {};
+    args.wr_bytes = buf;
+    args.wr_num_bytes = kMsgSize;
+    args.rd_bytes = buf;
+    args.rd_num_bytes = kMsgSize;
+
+    uint32_t actual_bytes, actual_handles;
+    mx_status_t read_status;
+    __UNUSED mx_status_t status = mx_channel_call(
+        s->client, 0u, MX_TIME_INFINITE, &args, &actual_bytes, &actual_handles, &read_status);
+    assert(status == NO_ERROR);
+}
+
+void call_teardown(void* state) {
+    call_state_t* s = static_cast<call_state_t*>(state);
+    mx_handle_close(s->client);
+    thrd_join(s->server, nullptr);
+    delete s;
+}
+
+// ---------------------------------------------------------------------------
+// futex-wake: wake with no waiters, the uncontended fast path.
+
+mx_futex_t uncontended_futex;
+
+void futex_wake_op(void*) {
+    __UNUSED mx_status_t status = mx_futex_wake(&uncontended_futex, 1u);
+    assert(status == NO_ERROR);
+}
+
+// ---------------------------------------------------------------------------
+// futex-pingpong: full wake + wait round trip against a partner thread.
+
+struct pingpong_state_t {
+    mx_futex_t ping;
+    mx_futex_t pong;
+    int round;
+    thrd_t partner;
+};
+
+int pingpong_partner(void* arg) {
+    pingpong_state_t* s = static_cast<pingpong_state_t*>(arg);
+    for (int i = 1;; i++) {
+        while (__atomic_load_n(&s->ping, __ATOMIC_SEQ_CST) != i) {
+            if (__atomic_load_n(&s->ping, __ATOMIC_SEQ_CST) < 0)
+                return 0;
+            mx_futex_wait(&s->ping, i - 1, MX_TIME_INFINITE);
+        }
+        __atomic_store_n(&s->pong, i, __ATOMIC_SEQ_CST);
+        mx_futex_wake(&s->pong, 1u);
+    }
+}
+
+void* pingpong_setup(uint32_t) {
+    pingpong_state_t* s = new pingpong_state_t;
+    s->ping = 0;
+    s->pong = 0;
+    s->round = 0;
+    __UNUSED int ret = thrd_create(&s->partner, pingpong_partner, s);
+    assert(ret == thrd_success);
+    return s;
+}
+
+void futex_pingpong_op(void* state) {
+    pingpong_state_t* s = static_cast<pingpong_state_t*>(state);
+    int round = ++s->round;
+    __atomic_store_n(&s->ping, round, __ATOMIC_SEQ_CST);
+    mx_futex_wake(&s->ping, 1u);
+    while (__atomic_load_n(&s->pong, __ATOMIC_SEQ_CST) != round)
+        mx_futex_wait(&s->pong, round - 1, MX_TIME_INFINITE);
+}
+
+void pingpong_teardown(void* state) {
+    pingpong_state_t* s = static_cast<pingpong_state_t*>(state);
+    __atomic_store_n(&s->ping, -1, __ATOMIC_SEQ_CST);
+    mx_futex_wake(&s->ping, 1u);
+    thrd_join(s->partner, nullptr);
+    delete s;
+}
+
+// ---------------------------------------------------------------------------
+// port-queue-wait: queue a user packet and immediately dequeue it.
+
+void* port_setup(uint32_t) {
+    mx_handle_t port;
+    __UNUSED mx_status_t status = mx_port_create(MX_PORT_OPT_V2, &port);
+    assert(status == NO_ERROR);
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(port));
+}
+
+void port_queue_wait_op(void* state) {
+    mx_handle_t port = static_cast<mx_handle_t>(reinterpret_cast<uintptr_t>(state));
+    mx_port_packet_t packet = {};
+    packet.type = MX_PKT_TYPE_USER;
+    __UNUSED mx_status_t status = mx_port_queue(port, &packet, sizeof(packet));
+    assert(status == NO_ERROR);
+    status = mx_port_wait(port, MX_TIME_INFINITE, &packet, sizeof(packet));
+    assert(status == NO_ERROR);
+}
+
+void port_teardown(void* state) {
+    mx_handle_close(static_cast<mx_handle_t>(reinterpret_cast<uintptr_t>(state)));
+}
+
+// ---------------------------------------------------------------------------
+// vmo-read/vmo-write: one page to/from a committed vmo.
+
+constexpr size_t kPageSize = 4096;
+
+struct vmo_state_t {
+    mx_handle_t vmo;
+    uint8_t buf[kPageSize];
+};
+
+void* vmo_setup(uint32_t) {
+    vmo_state_t* s = new vmo_state_t;
+    __UNUSED mx_status_t status = mx_vmo_create(kPageSize, 0u, &s->vmo);
+    assert(status == NO_ERROR);
+    memset(s->buf, 0x5a, sizeof(s->buf));
+    // Commit the page so the steady-state path is measured.
+    size_t actual;
+    status = mx_vmo_write(s->vmo, s->buf, 0u, kPageSize, &actual);
+    assert(status == NO_ERROR && actual == kPageSize);
+    return s;
+}
+
+void vmo_write_op(void* state) {
+    vmo_state_t* s = static_cast<vmo_state_t*>(state);
+    size_t actual;
+    __UNUSED mx_status_t status = mx_vmo_write(s->vmo, s->buf, 0u, kPageSize, &actual);
+    assert(status == NO_ERROR && actual == kPageSize);
+}
+
+void vmo_read_op(void* state) {
+    vmo_state_t* s = static_cast<vmo_state_t*>(state);
+    size_t actual;
+    __UNUSED mx_status_t status = mx_vmo_read(s->vmo, s->buf, 0u, kPageSize, &actual);
+    assert(status == NO_ERROR && actual == kPageSize);
+}
+
+void vmo_teardown(void* state) {
+    vmo_state_t* s = static_cast<vmo_state_t*>(state);
+    mx_handle_close(s->vmo);
+    delete s;
+}
+
+// ---------------------------------------------------------------------------
+// vmo-fault: first touch of an uncommitted mapped page.
+
+struct fault_state_t {
+    mx_handle_t vmo;
+    uintptr_t addr;
+    size_t len;
+    size_t next;
+};
+
+void* fault_setup(uint32_t total_iters) {
+    fault_state_t* s = new fault_state_t;
+    s->len = static_cast<size_t>(total_iters) * kPageSize;
+    s->next = 0;
+    __UNUSED mx_status_t status = mx_vmo_create(s->len, 0u, &s->vmo);
+    assert(status == NO_ERROR);
+    status = mx_vmar_map(mx_vmar_root_self(), 0u, s->vmo, 0u, s->len,
+                         MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE, &s->addr);
+    assert(status == NO_ERROR);
+    return s;
+}
+
+void vmo_fault_op(void* state) {
+    fault_state_t* s = static_cast<fault_state_t*>(state);
+    assert(s->next * kPageSize < s->len);
+    volatile uint8_t* p = reinterpret_cast<uint8_t*>(s->addr + s->next * kPageSize);
+    *p = 1u;
+    s->next++;
+}
+
+void fault_teardown(void* state) {
+    fault_state_t* s = static_cast<fault_state_t*>(state);
+    mx_vmar_unmap(mx_vmar_root_self(), s->addr, s->len);
+    mx_handle_close(s->vmo);
+    delete s;
+}
+
+// ---------------------------------------------------------------------------
+// thread-spawn: create and join a trivial thread.
+
+int noop_thread(void*) {
+    return 0;
+}
+
+void thread_spawn_op(void*) {
+    thrd_t t;
+    __UNUSED int ret = thrd_create(&t, noop_thread, nullptr);
+    assert(ret == thrd_success);
+    thrd_join(t, nullptr);
+}
+
+// ---------------------------------------------------------------------------
+// process-spawn: launch ourselves in child mode and wait for exit.
+
+void process_spawn_op(void*) {
+    const char* child_argv[] = {self_path, "child"};
+
+    launchpad_t* lp;
+    launchpad_create(0u, "kbench-child", &lp);
+    launchpad_load_from_file(lp, self_path);
+    launchpad_clone(lp, LP_CLONE_ALL);
+    launchpad_set_args(lp, 2, child_argv);
+
+    mx_handle_t proc;
+    const char* errmsg;
+    __UNUSED mx_status_t status = launchpad_go(lp, &proc, &errmsg);
+    assert(status == NO_ERROR);
+    status = mx_object_wait_one(proc, MX_PROCESS_TERMINATED, MX_TIME_INFINITE, nullptr);
+    assert(status == NO_ERROR);
+    mx_handle_close(proc);
+}
+
+// ---------------------------------------------------------------------------
+
+constexpr Bench benches[] = {
+    {"syscall-null", 100000, nullptr, syscall_null_op, nullptr},
+    {"channel-write-read", 100000, channel_setup, channel_write_read_op, channel_teardown},
+    {"channel-call", 50000, call_setup, channel_call_op, call_teardown},
+    {"futex-wake", 100000, nullptr, futex_wake_op, nullptr},
+    {"futex-pingpong", 50000, pingpong_setup, futex_pingpong_op, pingpong_teardown},
+    {"port-queue-wait", 100000, port_setup, port_queue_wait_op, port_teardown},
+    {"vmo-write", 50000, vmo_setup, vmo_write_op, vmo_teardown},
+    {"vmo-read", 50000, vmo_setup, vmo_read_op, vmo_teardown},
+    {"vmo-fault", 10000, fault_setup, vmo_fault_op, fault_teardown},
+    {"thread-spawn", 10000, nullptr, thread_spawn_op, nullptr},
+    {"process-spawn", 100, nullptr, process_spawn_op, nullptr},
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    self_path = argv[0];
+
+    // Internal: exit immediately when relaunched by process-spawn.
+    if (argc == 2 && !strcmp(argv[1], "child"))
+        return EXIT_SUCCESS;
+
+    static constexpr char help[] =
+        "Usage: %s [options ...]\n"
+        "\n"
+        "Options:\n"
+        "  -h    show help (this)\n"
+        "  -m    machine-readable output (CSV)\n"
+        "  -b S  only run benchmarks whose name contains S\n"
+        "  -n N  override per-benchmark iteration count\n"
+        "  -w N  set warmup iteration count (default: 100)\n";
+
+    bool machine = false;
+    const char* filter = nullptr;
+    uint32_t iters_override = 0;
+    uint32_t warmup = 100;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+hmb:n:w:")) != -1) {
+        switch (opt) {
+            case 'h':
+                printf(help, argv[0]);
+                return EXIT_SUCCESS;
+            case 'm':
+                machine = true;
+                break;
+            case 'b':
+                filter = optarg;
+                break;
+            case 'n':
+                iters_override = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+                break;
+            case 'w':
+                warmup = static_cast<uint32_t>(strtoul(optarg, nullptr, 10));
+                break;
+            default:  // '?'
+                fprintf(stderr, "%s: invalid option\nRun with -h for help.\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc) {
+        fprintf(stderr, "%s: unexpected positional argument\nRun with -h for help.\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (machine)
+        printf("benchmark,iterations,min_ns,p50_ns,p99_ns,p999_ns,max_ns,mean_ns\n");
+
+    for (size_t i = 0; i < countof(benches); i++) {
+        if (filter && !strstr(benches[i].name, filter))
+            continue;
+        uint32_t iters = iters_override ? iters_override : benches[i].default_iters;
+        run_bench(benches[i], warmup, iters, machine);
+    }
+
+    return EXIT_SUCCESS;
+}
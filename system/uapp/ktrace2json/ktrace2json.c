@@ -0,0 +1,542 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Streams ktrace records out of the kernel and converts them to Chrome
+// trace-event JSON (chrome://tracing) while the capture runs.
+//
+// 1. Capture and convert:  magenta> ktrace2json -t 10 -o /tmp/trace.json
+// 2. Grab the result:      host> netcp :/tmp/trace.json trace.json
+// 3. Load trace.json in chrome://tracing (or use scripts/ktrace2json to
+//    convert a raw dump grabbed with netcp :/dev/misc/ktrace instead).
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/ktrace.h>
+#include <magenta/ktrace.h>
+#include <magenta/syscalls.h>
+
+// Synthetic pids used to group the per-cpu timelines; real process koids
+// are allocated well above this range.
+#define PID_CPU     1
+#define PID_SYSCALL 2
+#define PID_IRQ     3
+#define PID_UNKNOWN 4
+
+#define MAX_CPUS 32
+
+typedef struct name_entry {
+    uint32_t id;
+    uint32_t arg;
+    char name[32];
+} name_entry_t;
+
+typedef struct name_table {
+    name_entry_t* entries;
+    size_t count;
+    size_t capacity;
+} name_table_t;
+
+// thread names double as the tid -> pid mapping (arg == pid)
+static name_table_t threads;
+static name_table_t kthreads;
+static name_table_t procs;
+static name_table_t syscalls;
+static name_table_t irqs;
+static name_table_t probes;
+
+static FILE* out;
+static bool first_event = true;
+
+// timestamp scaling, from the TAG_TICKS_PER_MS metadata record
+static double ticks_per_us = 1000.0;
+
+// per-cpu open-slice bookkeeping so we never emit an unmatched end event
+static bool cpu_slice_open[MAX_CPUS];
+static int syscall_depth[MAX_CPUS];
+static int irq_depth[MAX_CPUS];
+
+static name_entry_t* name_find(name_table_t* table, uint32_t id) {
+    for (size_t i = 0; i < table->count; i++) {
+        if (table->entries[i].id == id) {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void name_add(name_table_t* table, uint32_t id, uint32_t arg, const char* name) {
+    name_entry_t* entry = name_find(table, id);
+    if (entry == NULL) {
+        if (table->count == table->capacity) {
+            size_t capacity = table->capacity ? table->capacity * 2 : 64;
+            name_entry_t* entries = realloc(table->entries, capacity * sizeof(name_entry_t));
+            if (entries == NULL) {
+                return;
+            }
+            table->entries = entries;
+            table->capacity = capacity;
+        }
+        entry = &table->entries[table->count++];
+        entry->id = id;
+    }
+    entry->arg = arg;
+    strlcpy(entry->name, name, sizeof(entry->name));
+}
+
+// escape a (short, mostly ascii) name for use in a JSON string
+static void json_escape(const char* in, char* out_buf, size_t out_len) {
+    size_t o = 0;
+    for (; *in && (o + 2) < out_len; in++) {
+        unsigned char c = (unsigned char)*in;
+        if ((c == '"') || (c == '\\')) {
+            out_buf[o++] = '\\';
+            out_buf[o++] = (char)c;
+        } else if (c < 0x20) {
+            out_buf[o++] = '?';
+        } else {
+            out_buf[o++] = (char)c;
+        }
+    }
+    out_buf[o] = 0;
+}
+
+static void event_begin(void) {
+    if (first_event) {
+        first_event = false;
+        fprintf(out, "[\n");
+    } else {
+        fprintf(out, ",\n");
+    }
+}
+
+static void emit_meta(const char* what, uint32_t pid, uint32_t tid,
+                      bool has_tid, const char* name) {
+    char esc[64];
+    json_escape(name, esc, sizeof(esc));
+    event_begin();
+    fprintf(out, "{\"ph\":\"M\",\"name\":\"%s\",\"pid\":%u", what, pid);
+    if (has_tid) {
+        fprintf(out, ",\"tid\":%u", tid);
+    }
+    fprintf(out, ",\"args\":{\"name\":\"%s\"}}", esc);
+}
+
+static void emit_duration(char phase, uint32_t pid, uint32_t tid,
+                          double ts, const char* name) {
+    event_begin();
+    fprintf(out, "{\"ph\":\"%c\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f", phase, pid, tid, ts);
+    if (name != NULL) {
+        char esc[64];
+        json_escape(name, esc, sizeof(esc));
+        fprintf(out, ",\"name\":\"%s\"", esc);
+    }
+    fprintf(out, "}");
+}
+
+// instant event; |args| is pre-rendered JSON ("{...}") or NULL
+static void emit_instant(uint32_t pid, uint32_t tid, double ts,
+                         const char* name, const char* args) {
+    event_begin();
+    fprintf(out, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"name\":\"%s\"",
+            pid, tid, ts, name);
+    if (args != NULL) {
+        fprintf(out, ",\"args\":%s", args);
+    }
+    fprintf(out, "}");
+}
+
+static uint32_t pid_of(uint32_t tid) {
+    name_entry_t* entry = name_find(&threads, tid);
+    return entry != NULL ? entry->arg : PID_UNKNOWN;
+}
+
+// name an incoming thread for the cpu timeline
+static const char* thread_label(uint32_t tid, uint32_t kt, char* buf, size_t len) {
+    name_entry_t* entry;
+    if (tid != 0 && (entry = name_find(&threads, tid)) != NULL) {
+        return entry->name;
+    }
+    if ((entry = name_find(&kthreads, kt)) != NULL) {
+        return entry->name;
+    }
+    snprintf(buf, len, tid != 0 ? "tid %u" : "kt %08x", tid != 0 ? tid : kt);
+    return buf;
+}
+
+static void handle_name(const ktrace_rec_name_t* rec) {
+    uint32_t event = KTRACE_EVENT(rec->tag);
+    switch (event) {
+    case KTRACE_EVENT(TAG_KTHREAD_NAME):
+        name_add(&kthreads, rec->id, 0, rec->name);
+        break;
+    case KTRACE_EVENT(TAG_THREAD_NAME):
+        name_add(&threads, rec->id, rec->arg, rec->name);
+        emit_meta("thread_name", rec->arg, rec->id, true, rec->name);
+        break;
+    case KTRACE_EVENT(TAG_PROC_NAME):
+        name_add(&procs, rec->id, 0, rec->name);
+        emit_meta("process_name", rec->id, 0, false, rec->name);
+        break;
+    case KTRACE_EVENT(TAG_SYSCALL_NAME):
+        name_add(&syscalls, rec->id, 0, rec->name);
+        break;
+    case KTRACE_EVENT(TAG_IRQ_NAME):
+        name_add(&irqs, rec->id, 0, rec->name);
+        break;
+    case KTRACE_EVENT(TAG_PROBE_NAME):
+        name_add(&probes, rec->id, 0, rec->name);
+        break;
+    }
+}
+
+// B/E slices keyed by (n << 8) | cpu tiny-record payloads
+static void handle_enter_exit(name_table_t* names, const char* prefix,
+                              uint32_t pid, int* depth, uint32_t arg,
+                              double ts, bool enter) {
+    uint32_t cpu = arg & 0xFF;
+    uint32_t num = arg >> 8;
+    if (cpu >= MAX_CPUS) {
+        return;
+    }
+    if (enter) {
+        char buf[48];
+        name_entry_t* entry = name_find(names, num);
+        if (entry != NULL) {
+            emit_duration('B', pid, cpu, ts, entry->name);
+        } else {
+            snprintf(buf, sizeof(buf), "%s %u", prefix, num);
+            emit_duration('B', pid, cpu, ts, buf);
+        }
+        depth[cpu]++;
+    } else if (depth[cpu] > 0) {
+        depth[cpu]--;
+        emit_duration('E', pid, cpu, ts, NULL);
+    }
+}
+
+static void handle_context_switch(const ktrace_rec_32b_t* rec, double ts) {
+    uint32_t cpu = rec->b & 0xFFFF;
+    if (cpu >= MAX_CPUS) {
+        return;
+    }
+    if (cpu_slice_open[cpu]) {
+        emit_duration('E', PID_CPU, cpu, ts, NULL);
+    }
+    char buf[32];
+    emit_duration('B', PID_CPU, cpu, ts, thread_label(rec->a, rec->d, buf, sizeof(buf)));
+    cpu_slice_open[cpu] = true;
+}
+
+static void handle_probe(const ktrace_header_t* hdr, double ts) {
+    uint32_t num = KTRACE_EVENT(hdr->tag) & 0x7FF;
+    char buf[32];
+    const char* name;
+    name_entry_t* entry = name_find(&probes, num);
+    if (entry != NULL) {
+        name = entry->name;
+    } else {
+        snprintf(buf, sizeof(buf), "probe %u", num);
+        name = buf;
+    }
+    char args[64];
+    const char* argp = NULL;
+    if (KTRACE_LEN(hdr->tag) >= 24) {
+        const uint32_t* data = (const uint32_t*)(hdr + 1);
+        snprintf(args, sizeof(args), "{\"arg0\":%u,\"arg1\":%u}", data[0], data[1]);
+        argp = args;
+    }
+    emit_instant(pid_of(hdr->tid), hdr->tid, ts, name, argp);
+}
+
+// name and argument rendering for the 32-byte fixed-format events
+static void handle_event(const ktrace_rec_32b_t* rec, double ts) {
+    if (KTRACE_LEN(rec->tag) < KTRACE_RECSIZE) {
+        return;
+    }
+    char args[128];
+    const char* name;
+    // match on everything but the size nibble, which varies for name records
+    switch (rec->tag & 0xFFFFFF00) {
+    case TAG_OBJECT_DELETE & 0xFFFFFF00:
+        name = "object_delete";
+        snprintf(args, sizeof(args), "{\"id\":%u}", rec->a);
+        break;
+    case TAG_THREAD_CREATE & 0xFFFFFF00:
+        name = "thread_create";
+        snprintf(args, sizeof(args), "{\"tid\":%u,\"pid\":%u}", rec->a, rec->b);
+        break;
+    case TAG_THREAD_START & 0xFFFFFF00:
+        name = "thread_start";
+        snprintf(args, sizeof(args), "{\"tid\":%u}", rec->a);
+        break;
+    case TAG_THREAD_EXIT & 0xFFFFFF00:
+        name = "thread_exit";
+        args[0] = 0;
+        break;
+    case TAG_PROC_CREATE & 0xFFFFFF00:
+        name = "proc_create";
+        snprintf(args, sizeof(args), "{\"pid\":%u}", rec->a);
+        break;
+    case TAG_PROC_START & 0xFFFFFF00:
+        name = "proc_start";
+        snprintf(args, sizeof(args), "{\"tid\":%u,\"pid\":%u}", rec->a, rec->b);
+        break;
+    case TAG_PROC_EXIT & 0xFFFFFF00:
+        name = "proc_exit";
+        snprintf(args, sizeof(args), "{\"pid\":%u}", rec->a);
+        break;
+    case TAG_CHANNEL_CREATE & 0xFFFFFF00:
+        name = "channel_create";
+        snprintf(args, sizeof(args), "{\"id0\":%u,\"id1\":%u,\"flags\":%u}",
+                 rec->a, rec->b, rec->c);
+        break;
+    case TAG_CHANNEL_WRITE & 0xFFFFFF00:
+        name = "channel_write";
+        snprintf(args, sizeof(args), "{\"id\":%u,\"bytes\":%u,\"handles\":%u}",
+                 rec->a, rec->b, rec->c);
+        break;
+    case TAG_CHANNEL_READ & 0xFFFFFF00:
+        name = "channel_read";
+        snprintf(args, sizeof(args), "{\"id\":%u,\"bytes\":%u,\"handles\":%u}",
+                 rec->a, rec->b, rec->c);
+        break;
+    case TAG_PORT_WAIT & 0xFFFFFF00:
+        name = "port_wait";
+        snprintf(args, sizeof(args), "{\"id\":%u}", rec->a);
+        break;
+    case TAG_PORT_WAIT_DONE & 0xFFFFFF00:
+        name = "port_wait_done";
+        snprintf(args, sizeof(args), "{\"id\":%u,\"status\":%u}", rec->a, rec->b);
+        break;
+    case TAG_PORT_CREATE & 0xFFFFFF00:
+        name = "port_create";
+        snprintf(args, sizeof(args), "{\"id\":%u}", rec->a);
+        break;
+    case TAG_PORT_QUEUE & 0xFFFFFF00:
+        name = "port_queue";
+        snprintf(args, sizeof(args), "{\"id\":%u,\"size\":%u}", rec->a, rec->b);
+        break;
+    case TAG_WAIT_ONE & 0xFFFFFF00:
+        name = "wait_one";
+        snprintf(args, sizeof(args), "{\"id\":%u,\"signals\":%u}", rec->a, rec->b);
+        break;
+    case TAG_WAIT_ONE_DONE & 0xFFFFFF00:
+        name = "wait_one_done";
+        snprintf(args, sizeof(args), "{\"id\":%u,\"status\":%u,\"pending\":%u}",
+                 rec->a, rec->b, rec->c);
+        break;
+    case TAG_PAGE_FAULT & 0xFFFFFF00:
+        name = "page_fault";
+        snprintf(args, sizeof(args), "{\"vaddr\":\"0x%08x%08x\",\"flags\":%u}",
+                 rec->a, rec->b, rec->c);
+        break;
+    default:
+        return;
+    }
+    emit_instant(pid_of(rec->tid), rec->tid, ts,
+                 name, args[0] != 0 ? args : NULL);
+}
+
+// Process one record; returns its length, or 0 if |len| does not yet hold
+// a complete record.
+static size_t process_record(const uint8_t* data, size_t len) {
+    if (len < sizeof(uint32_t)) {
+        return 0;
+    }
+    uint32_t tag = *(const uint32_t*)data;
+    size_t rec_len = KTRACE_LEN(tag);
+    if (rec_len == 0) {
+        // padding or a corrupt record; there is no length to skip by,
+        // so resynchronizing is not possible
+        return 0;
+    }
+    if (len < rec_len) {
+        return 0;
+    }
+
+    if (KTRACE_GROUP(tag) == KTRACE_GRP_META && KTRACE_EVENT(tag) >= 0x20) {
+        handle_name((const ktrace_rec_name_t*)data);
+        return rec_len;
+    }
+
+    const ktrace_header_t* hdr = (const ktrace_header_t*)data;
+    double ts = (double)hdr->ts / ticks_per_us;
+
+    switch (tag & 0xFFFFFF00) {
+    case TAG_TICKS_PER_MS & 0xFFFFFF00: {
+        const ktrace_rec_32b_t* rec = (const ktrace_rec_32b_t*)data;
+        uint64_t ticks_per_ms = ((uint64_t)rec->b << 32) | rec->a;
+        if (ticks_per_ms != 0) {
+            ticks_per_us = (double)ticks_per_ms / 1000.0;
+        }
+        break;
+    }
+    case TAG_VERSION & 0xFFFFFF00:
+        break;
+    case TAG_IRQ_ENTER & 0xFFFFFF00:
+        handle_enter_exit(&irqs, "irq", PID_IRQ, irq_depth, hdr->tid, ts, true);
+        break;
+    case TAG_IRQ_EXIT & 0xFFFFFF00:
+        handle_enter_exit(&irqs, "irq", PID_IRQ, irq_depth, hdr->tid, ts, false);
+        break;
+    case TAG_SYSCALL_ENTER & 0xFFFFFF00:
+        handle_enter_exit(&syscalls, "syscall", PID_SYSCALL, syscall_depth,
+                          hdr->tid, ts, true);
+        break;
+    case TAG_SYSCALL_EXIT & 0xFFFFFF00:
+        handle_enter_exit(&syscalls, "syscall", PID_SYSCALL, syscall_depth,
+                          hdr->tid, ts, false);
+        break;
+    case TAG_CONTEXT_SWITCH & 0xFFFFFF00:
+        handle_context_switch((const ktrace_rec_32b_t*)data, ts);
+        break;
+    default:
+        if (KTRACE_GROUP(tag) & KTRACE_GRP_PROBE) {
+            handle_probe(hdr, ts);
+        } else {
+            handle_event((const ktrace_rec_32b_t*)data, ts);
+        }
+        break;
+    }
+    return rec_len;
+}
+
+// feed a chunk of raw trace into the converter, returning the number of
+// bytes consumed (whole records only)
+static size_t process_chunk(const uint8_t* data, size_t len) {
+    size_t off = 0;
+    for (;;) {
+        size_t used = process_record(data + off, len - off);
+        if (used == 0) {
+            return off;
+        }
+        off += used;
+    }
+}
+
+static int usage(void) {
+    fprintf(stderr,
+            "usage: ktrace2json [options]\n"
+            "   -g <groups>   trace group mask (default 0xfff)\n"
+            "   -t <seconds>  capture duration (default 10)\n"
+            "   -o <path>     output file ('-' for stdout, default /tmp/trace.json)\n");
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    uint32_t grpmask = KTRACE_GRP_ALL;
+    uint32_t seconds = 10;
+    const char* path = "/tmp/trace.json";
+
+    while (argc > 2) {
+        if (!strcmp(argv[1], "-g")) {
+            grpmask = (uint32_t)strtoul(argv[2], NULL, 0);
+        } else if (!strcmp(argv[1], "-t")) {
+            seconds = (uint32_t)strtoul(argv[2], NULL, 0);
+        } else if (!strcmp(argv[1], "-o")) {
+            path = argv[2];
+        } else {
+            return usage();
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc != 1) {
+        return usage();
+    }
+
+    int fd;
+    if ((fd = open("/dev/misc/ktrace", O_RDWR)) < 0) {
+        fprintf(stderr, "ktrace2json: cannot open trace device\n");
+        return -1;
+    }
+    mx_handle_t handle;
+    if (ioctl_ktrace_get_handle(fd, &handle) < 0) {
+        fprintf(stderr, "ktrace2json: cannot get ktrace handle\n");
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    if (!strcmp(path, "-")) {
+        out = stdout;
+    } else if ((out = fopen(path, "w")) == NULL) {
+        fprintf(stderr, "ktrace2json: cannot open '%s' for writing\n", path);
+        return -1;
+    }
+
+    // name the synthetic timeline processes
+    emit_meta("process_name", PID_CPU, 0, false, "cpu");
+    emit_meta("process_name", PID_SYSCALL, 0, false, "syscalls");
+    emit_meta("process_name", PID_IRQ, 0, false, "irqs");
+
+    // restart tracing in streaming mode and drain as the capture runs
+    mx_ktrace_control(handle, KTRACE_ACTION_STOP, 0, NULL);
+    mx_ktrace_control(handle, KTRACE_ACTION_REWIND, 0, NULL);
+    mx_status_t status = mx_ktrace_control(handle, KTRACE_ACTION_START_STREAM, grpmask, NULL);
+    if (status != NO_ERROR) {
+        fprintf(stderr, "ktrace2json: cannot start tracing: %d\n", status);
+        return -1;
+    }
+
+    static uint8_t buf[64 * 1024];
+    size_t pending = 0;
+    mx_time_t deadline = mx_time_get(MX_CLOCK_MONOTONIC) + MX_SEC(seconds);
+    bool stopped = false;
+
+    // While tracing runs, reads consume from the stream and the offset is
+    // ignored; once stopped, the leftover completed sub-buffers are exposed
+    // as a flat buffer and the offset walks through them.
+    uint32_t off = 0;
+
+    for (;;) {
+        uint32_t actual;
+        status = mx_ktrace_read(handle, buf + pending, off,
+                                (uint32_t)(sizeof(buf) - pending), &actual);
+        if (status != NO_ERROR) {
+            fprintf(stderr, "ktrace2json: trace read failed: %d\n", status);
+            break;
+        }
+        if (actual == 0) {
+            if (stopped) {
+                break;
+            }
+            if (mx_time_get(MX_CLOCK_MONOTONIC) >= deadline) {
+                // The stream is drained, so stopping here cannot leave a
+                // partially read sub-buffer behind; anything the cpus were
+                // still filling becomes readable via offset reads below.
+                mx_ktrace_control(handle, KTRACE_ACTION_STOP, 0, NULL);
+                stopped = true;
+                continue;
+            }
+            mx_nanosleep(mx_deadline_after(MX_MSEC(10)));
+            continue;
+        }
+
+        if (stopped) {
+            off += actual;
+        }
+        pending += actual;
+        size_t used = process_chunk(buf, pending);
+        if (used == 0 && pending == sizeof(buf)) {
+            fprintf(stderr, "ktrace2json: cannot parse trace, giving up\n");
+            break;
+        }
+        memmove(buf, buf + used, pending - used);
+        pending -= used;
+    }
+
+    if (!first_event) {
+        fprintf(out, "\n]\n");
+    }
+    if (out != stdout) {
+        fclose(out);
+        printf("ktrace2json: wrote %s\n", path);
+    }
+    return 0;
+}
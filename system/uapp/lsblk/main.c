@@ -136,6 +136,55 @@ out:
     return 0;
 }
 
+static int cmd_stats_blk(const char* dev) {
+    int fd = open(dev, O_RDONLY);
+    if (fd < 0) {
+        printf("Error opening %s\n", dev);
+        return fd;
+    }
+
+    block_stats_t stats;
+    ssize_t rc = ioctl_block_get_stats(fd, &stats);
+    close(fd);
+    if (rc < 0) {
+        printf("Error getting stats for %s\n", dev);
+        return rc;
+    }
+
+    printf("reads:     %" PRIu64 " (%" PRIu64 " bytes)\n",
+           stats.reads, stats.bytes_read);
+    printf("writes:    %" PRIu64 " (%" PRIu64 " bytes)\n",
+           stats.writes, stats.bytes_written);
+    printf("errors:    %" PRIu64 "\n", stats.errors);
+    printf("max depth: %" PRIu64 "\n", stats.max_depth);
+
+    printf("latency (usec):\n");
+    for (unsigned n = 0; n < BLOCK_STATS_LATENCY_BUCKETS; n++) {
+        if (stats.latency[n] == 0) {
+            continue;
+        }
+        if (n == BLOCK_STATS_LATENCY_BUCKETS - 1) {
+            printf("  %6u+     : %" PRIu64 "\n", 1u << n, stats.latency[n]);
+        } else {
+            printf("  %6u-%-6u: %" PRIu64 "\n", n ? 1u << n : 0, (2u << n) - 1,
+                   stats.latency[n]);
+        }
+    }
+
+    printf("queue depth:\n");
+    for (unsigned n = 0; n < BLOCK_STATS_DEPTH_BUCKETS; n++) {
+        if (stats.depth[n] == 0) {
+            continue;
+        }
+        if (n == BLOCK_STATS_DEPTH_BUCKETS - 1) {
+            printf("  %6u+     : %" PRIu64 "\n", n + 1, stats.depth[n]);
+        } else {
+            printf("  %6u      : %" PRIu64 "\n", n + 1, stats.depth[n]);
+        }
+    }
+    return 0;
+}
+
 static int cmd_read_blk(const char* dev, off_t offset, size_t count) {
     int fd = open(dev, O_RDONLY);
     if (fd < 0) {
@@ -198,6 +247,9 @@ int main(int argc, const char** argv) {
         } else if (!strcmp(cmd, "read")) {
             if (argc < 5) goto usage;
             rc = cmd_read_blk(argv[2], strtoul(argv[3], NULL, 10), strtoull(argv[4], NULL, 10));
+        } else if (!strcmp(cmd, "stats")) {
+            if (argc < 3) goto usage;
+            rc = cmd_stats_blk(argv[2]);
         } else {
             printf("Unrecognized command %s!\n", cmd);
             goto usage;
@@ -210,5 +262,6 @@ usage:
     printf("Usage:\n");
     printf("%s\n", argv[0]);
     printf("%s read <blkdev> <offset> <count>\n", argv[0]);
+    printf("%s stats <blkdev>\n", argv[0]);
     return 0;
 }
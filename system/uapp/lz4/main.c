@@ -4,6 +4,8 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <magenta/syscalls.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -17,14 +19,19 @@
 
 #define BLOCK_SIZE 65536
 
+// Upper bound on -t; each worker costs one in-flight block plus the two
+// extra ring slots used for read-ahead.
+#define MAX_WORKERS 8
+
 #define WR_NEWFILE O_WRONLY | O_CREAT | O_TRUNC
 #define PERM_644 S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH
 
 static void usage(const char* arg0) {
-    printf("usage: %s [-1|-9] [-d] <input file> <output file>\n", arg0);
+    printf("usage: %s [-1|-9] [-d] [-t threads] <input file> <output file>\n", arg0);
     printf("   -1  fast compression (default)\n");
     printf("   -9  high compression (slower)\n");
     printf("   -d  decompress\n");
+    printf("   -t  compression worker threads (default: one per cpu)\n");
 }
 
 static int do_decompress(const char* infile, const char* outfile) {
@@ -123,8 +130,82 @@ done:
     return 0;
 }
 
-static int do_compress(const char* infile, const char* outfile, int clevel) {
+// Parallel compression pipeline. Each BLOCK_SIZE chunk of input becomes an
+// independent LZ4 frame (the decompressor above already consumes
+// concatenated frames), so blocks can be compressed out of order on a pool
+// of workers. Blocks move through a ring of slots:
+//
+//   EMPTY --(main reads input)--> FILLED --(worker)--> COMPRESSED
+//     ^                                                    |
+//     +-----------------(main writes output)---------------+
+//
+// The ring holds two more slots than there are workers, so the main thread
+// keeps reading ahead while every worker is busy and writes frames back
+// out strictly in input order.
+enum slot_state {
+    SLOT_EMPTY,
+    SLOT_FILLED,
+    SLOT_BUSY,
+    SLOT_COMPRESSED,
+};
+
+typedef struct {
+    enum slot_state state;
+    uint8_t inbuf[BLOCK_SIZE];
+    size_t insz;
+    uint8_t* outbuf;
+    size_t outsz;   // compressed frame size, or an LZ4F error code
+} work_slot_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work_cv;   // signaled when a slot becomes FILLED
+    pthread_cond_t done_cv;   // signaled when a slot becomes COMPRESSED
+    work_slot_t* slots;
+    int num_slots;
+    bool input_done;
+    const LZ4F_preferences_t* prefs;
+    size_t outbuf_size;
+} pipeline_t;
+
+static void* compress_worker(void* arg) {
+    pipeline_t* pl = arg;
+
+    pthread_mutex_lock(&pl->lock);
+    for (;;) {
+        work_slot_t* slot = NULL;
+        for (int i = 0; i < pl->num_slots; i++) {
+            if (pl->slots[i].state == SLOT_FILLED) {
+                slot = &pl->slots[i];
+                break;
+            }
+        }
+        if (slot == NULL) {
+            if (pl->input_done) {
+                break;
+            }
+            pthread_cond_wait(&pl->work_cv, &pl->lock);
+            continue;
+        }
+
+        slot->state = SLOT_BUSY;
+        pthread_mutex_unlock(&pl->lock);
+
+        slot->outsz = LZ4F_compressFrame(slot->outbuf, pl->outbuf_size,
+                                         slot->inbuf, slot->insz, pl->prefs);
+
+        pthread_mutex_lock(&pl->lock);
+        slot->state = SLOT_COMPRESSED;
+        pthread_cond_broadcast(&pl->done_cv);
+    }
+    pthread_mutex_unlock(&pl->lock);
+    return NULL;
+}
+
+static int do_compress(const char* infile, const char* outfile, int clevel,
+                       int num_workers) {
     int infd, outfd;
+    int ret = -1;
 
     infd = open(infile, O_RDONLY);
     if (infd < 0) {
@@ -143,51 +224,132 @@ static int do_compress(const char* infile, const char* outfile, int clevel) {
     memset(&prefs, 0, sizeof(prefs));
     prefs.compressionLevel = clevel;
 
-    uint8_t inbuf[BLOCK_SIZE];
-    size_t outsize = LZ4F_compressFrameBound(BLOCK_SIZE, &prefs);
-    uint8_t* outbuf = malloc(outsize);
-    if (!outbuf) {
+    pipeline_t pl = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .work_cv = PTHREAD_COND_INITIALIZER,
+        .done_cv = PTHREAD_COND_INITIALIZER,
+        .num_slots = num_workers + 2,
+        .input_done = false,
+        .prefs = &prefs,
+        .outbuf_size = LZ4F_compressFrameBound(BLOCK_SIZE, &prefs),
+    };
+
+    pl.slots = calloc(pl.num_slots, sizeof(work_slot_t));
+    if (!pl.slots) {
         fprintf(stderr, "out of memory\n");
         close(outfd);
         close(infd);
         return ENOMEM;
     }
+    for (int i = 0; i < pl.num_slots; i++) {
+        pl.slots[i].outbuf = malloc(pl.outbuf_size);
+        if (!pl.slots[i].outbuf) {
+            fprintf(stderr, "out of memory\n");
+            for (int j = 0; j < i; j++) {
+                free(pl.slots[j].outbuf);
+            }
+            free(pl.slots);
+            close(outfd);
+            close(infd);
+            return ENOMEM;
+        }
+    }
 
-    // TODO: do the whole file in one frame, using the LZ4F begin/update/end
-    // functions.
-    ssize_t nr = 0;
-    while ((nr = read(infd, inbuf, BLOCK_SIZE)) > 0) {
-        ssize_t csz = LZ4F_compressFrame(outbuf, outsize, inbuf, nr, &prefs);
-        if (LZ4F_isError(csz)) {
-            fprintf(stderr, "error compressing %s: %s\n", infile, LZ4F_getErrorName(csz));
-            goto done;
+    pthread_t workers[MAX_WORKERS];
+    int started = 0;
+    for (; started < num_workers; started++) {
+        if (pthread_create(&workers[started], NULL, compress_worker, &pl) != 0) {
+            break;
         }
+    }
+    if (started == 0) {
+        fprintf(stderr, "could not start compression workers\n");
+        goto done;
+    }
 
-        ssize_t nw = write(outfd, outbuf, csz);
-        if (nw != csz) {
-            fprintf(stderr, "could not write to %s", outfile);
-            if (nw < 0) {
-                fprintf(stderr, ": %s", strerror(errno));
+    // Main loop: keep the ring as full of reads as possible, then retire
+    // the oldest block so output frames stay in input order. Reads overlap
+    // with the workers chewing on earlier blocks.
+    uint64_t rd = 0;    // blocks read so far
+    uint64_t wr = 0;    // blocks written so far
+    bool eof = false;
+    bool failed = false;
+    while (!failed && (!eof || wr < rd)) {
+        while (!eof && rd - wr < (uint64_t)pl.num_slots) {
+            work_slot_t* slot = &pl.slots[rd % pl.num_slots];
+            ssize_t nr = read(infd, slot->inbuf, BLOCK_SIZE);
+            if (nr < 0) {
+                fprintf(stderr, "error reading %s: %s\n", infile, strerror(errno));
+                failed = true;
+                break;
+            }
+            if (nr == 0) {
+                eof = true;
+                break;
             }
-            fprintf(stderr, "\n");
-            goto done;
+            slot->insz = nr;
+            pthread_mutex_lock(&pl.lock);
+            slot->state = SLOT_FILLED;
+            pthread_cond_signal(&pl.work_cv);
+            pthread_mutex_unlock(&pl.lock);
+            rd++;
+        }
+
+        if (!failed && wr < rd) {
+            work_slot_t* slot = &pl.slots[wr % pl.num_slots];
+            pthread_mutex_lock(&pl.lock);
+            while (slot->state != SLOT_COMPRESSED) {
+                pthread_cond_wait(&pl.done_cv, &pl.lock);
+            }
+            pthread_mutex_unlock(&pl.lock);
+
+            if (LZ4F_isError(slot->outsz)) {
+                fprintf(stderr, "error compressing %s: %s\n", infile,
+                        LZ4F_getErrorName(slot->outsz));
+                failed = true;
+                break;
+            }
+            ssize_t nw = write(outfd, slot->outbuf, slot->outsz);
+            if (nw != (ssize_t)slot->outsz) {
+                fprintf(stderr, "could not write to %s", outfile);
+                if (nw < 0) {
+                    fprintf(stderr, ": %s", strerror(errno));
+                }
+                fprintf(stderr, "\n");
+                failed = true;
+                break;
+            }
+            slot->state = SLOT_EMPTY;
+            wr++;
         }
     }
 
-    if (nr < 0) {
-        fprintf(stderr, "error reading %s: %s\n", infile, strerror(errno));
-        goto done;
+    if (!failed) {
+        ret = 0;
     }
 
 done:
-    free(outbuf);
+    // Wake the workers up so they notice there is nothing left to do.
+    pthread_mutex_lock(&pl.lock);
+    pl.input_done = true;
+    pthread_cond_broadcast(&pl.work_cv);
+    pthread_mutex_unlock(&pl.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    for (int i = 0; i < pl.num_slots; i++) {
+        free(pl.slots[i].outbuf);
+    }
+    free(pl.slots);
     close(outfd);
     close(infd);
-    return 0;
+    return ret;
 }
 
 int main(int argc, char* argv[]) {
     int clevel = 1;
+    int num_workers = 0;
     bool decompress = false;
     const char* infile = NULL;
     const char* outfile = NULL;
@@ -201,6 +363,14 @@ int main(int argc, char* argv[]) {
             clevel = 9;
             continue;
         }
+        if (!strcmp("-t", argv[i])) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return -1;
+            }
+            num_workers = atoi(argv[++i]);
+            continue;
+        }
         if (!strcmp("-h", argv[i])) {
             usage(argv[0]);
             return 0;
@@ -237,6 +407,15 @@ int main(int argc, char* argv[]) {
     if (decompress) {
         return do_decompress(infile, outfile);
     } else {
-        return do_compress(infile, outfile, clevel);
+        if (num_workers < 1) {
+            num_workers = mx_system_get_num_cpus();
+        }
+        if (num_workers < 1) {
+            num_workers = 1;
+        }
+        if (num_workers > MAX_WORKERS) {
+            num_workers = MAX_WORKERS;
+        }
+        return do_compress(infile, outfile, clevel, num_workers);
     }
 }
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <fs/trace.h>
@@ -12,29 +13,62 @@
 #include <mxalloc/new.h>
 #include <mxtl/ref_ptr.h>
 #include <mxtl/unique_ptr.h>
+#ifdef __Fuchsia__
+#include <magenta/syscalls.h>
+#include <mxtl/auto_lock.h>
+#endif
 
 #include "minfs.h"
 #include "minfs-private.h"
 
 namespace minfs {
 
-mx_status_t Bcache::Readblk(uint32_t bno, void* data) {
+#ifdef __Fuchsia__
+// How long dirty blocks may sit in the cache before the background flush
+// thread writes them back.
+constexpr time_t kMinfsFlushIntervalSec = 5;
+#endif
+
+BlockNode::BlockNode(uint32_t bno) : bno_(bno), dirty_(false) {}
+
+mx_status_t BlockNode::Create(uint32_t bno, mxtl::unique_ptr<BlockNode>* out) {
+    AllocChecker ac;
+    mxtl::unique_ptr<BlockNode> blk(new (&ac) BlockNode(bno));
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    uint8_t* data = new (&ac) uint8_t[kMinfsBlockSize];
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    blk->data_.reset(data);
+    *out = mxtl::move(blk);
+    return NO_ERROR;
+}
+
+mx_status_t Bcache::RawRead(uint32_t bno, uint32_t count, void* data) {
     off_t off = bno * kMinfsBlockSize;
-    FS_TRACE(IO, "readblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
+    size_t len = count * kMinfsBlockSize;
+    FS_TRACE(IO, "rawread() bno=%u count=%u off=%#llx\n", bno, count,
+             (unsigned long long)off);
     if (lseek(fd_, off, SEEK_SET) < 0) {
         FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
         return ERR_IO;
     }
-    if (read(fd_, data, kMinfsBlockSize) != kMinfsBlockSize) {
-        FS_TRACE_ERROR("minfs: cannot read block %u\n", bno);
+    if (read(fd_, data, len) != (ssize_t)len) {
+        FS_TRACE_ERROR("minfs: cannot read %u blocks at %u\n", count, bno);
         return ERR_IO;
     }
     return NO_ERROR;
 }
 
-mx_status_t Bcache::Writeblk(uint32_t bno, const void* data) {
+mx_status_t Bcache::RawReadblk(uint32_t bno, void* data) {
+    return RawRead(bno, 1, data);
+}
+
+mx_status_t Bcache::RawWriteblk(uint32_t bno, const void* data) {
     off_t off = bno * kMinfsBlockSize;
-    FS_TRACE(IO, "writeblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
+    FS_TRACE(IO, "rawwriteblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
     if (lseek(fd_, off, SEEK_SET) < 0) {
         FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
         return ERR_IO;
@@ -46,7 +80,190 @@ mx_status_t Bcache::Writeblk(uint32_t bno, const void* data) {
     return NO_ERROR;
 }
 
+void Bcache::LruTouchLocked(BlockNode* blk) {
+    // Qualified: BlockNode is also SinglyLinkedListable for the hash table.
+    if (blk->mxtl::DoublyLinkedListable<BlockNode*>::InContainer()) {
+        lru_.erase(*blk);
+    }
+    lru_.push_front(blk);
+}
+
+mx_status_t Bcache::CacheEvictLocked() {
+    BlockNode* blk = &lru_.back();
+    if (blk->dirty_) {
+        mx_status_t status = RawWriteblk(blk->bno_, blk->data_.get());
+        if (status != NO_ERROR) {
+            return status;
+        }
+        blk->dirty_ = false;
+    }
+    lru_.erase(*blk);
+    cache_.erase(*blk);
+    cache_count_--;
+    return NO_ERROR;
+}
+
+mx_status_t Bcache::CacheInsertLocked(uint32_t bno, BlockNode** out) {
+    mx_status_t status;
+    while (cache_count_ >= kMinfsBlockCacheSize) {
+        if ((status = CacheEvictLocked()) != NO_ERROR) {
+            return status;
+        }
+    }
+    mxtl::unique_ptr<BlockNode> blk;
+    if ((status = BlockNode::Create(bno, &blk)) != NO_ERROR) {
+        return status;
+    }
+    *out = blk.get();
+    cache_.insert(mxtl::move(blk));
+    lru_.push_front(*out);
+    cache_count_++;
+    return NO_ERROR;
+}
+
+mx_status_t Bcache::CacheFetchLocked(uint32_t bno, BlockNode** out) {
+    auto iter = cache_.find(bno);
+    if (iter.IsValid()) {
+        *out = &*iter;
+        LruTouchLocked(*out);
+        return NO_ERROR;
+    }
+
+    // Miss: read a run of contiguous blocks in one device operation and
+    // populate the cache with all of them, so directory scans and
+    // sequential reads pay for one seek instead of one per block.
+    uint32_t count = 1;
+    if ((bno < blockmax_) && (blockmax_ - bno > 1)) {
+        count = blockmax_ - bno;
+        if (count > kMinfsReadaheadBlocks) {
+            count = kMinfsReadaheadBlocks;
+        }
+    }
+    mx_status_t status;
+    if (count < 2 ||
+        (status = RawRead(bno, count, readahead_.get())) != NO_ERROR) {
+        count = 1;
+        if ((status = RawRead(bno, 1, readahead_.get())) != NO_ERROR) {
+            return status;
+        }
+    }
+    *out = nullptr;
+    for (uint32_t i = 0; i < count; i++) {
+        if ((i > 0) && cache_.find(bno + i).IsValid()) {
+            continue;
+        }
+        BlockNode* blk;
+        if (CacheInsertLocked(bno + i, &blk) != NO_ERROR) {
+            break;
+        }
+        memcpy(blk->data_.get(), readahead_.get() + i * kMinfsBlockSize,
+               kMinfsBlockSize);
+        if (i == 0) {
+            *out = blk;
+        }
+    }
+    return (*out != nullptr) ? NO_ERROR : ERR_NO_MEMORY;
+}
+
+mx_status_t Bcache::Readblk(uint32_t bno, void* data) {
+    FS_TRACE(IO, "readblk() bno=%u\n", bno);
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&cache_lock_);
+#endif
+    BlockNode* blk;
+    mx_status_t status = CacheFetchLocked(bno, &blk);
+    if (status == ERR_NO_MEMORY) {
+        // The cache could not hold the block; fall back to uncached IO.
+        return RawReadblk(bno, data);
+    } else if (status != NO_ERROR) {
+        return status;
+    }
+    memcpy(data, blk->data_.get(), kMinfsBlockSize);
+    return NO_ERROR;
+}
+
+mx_status_t Bcache::Writeblk(uint32_t bno, const void* data) {
+    FS_TRACE(IO, "writeblk() bno=%u\n", bno);
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&cache_lock_);
+#endif
+    BlockNode* blk;
+    auto iter = cache_.find(bno);
+    if (iter.IsValid()) {
+        blk = &*iter;
+        LruTouchLocked(blk);
+    } else if (CacheInsertLocked(bno, &blk) != NO_ERROR) {
+        // The whole block is being overwritten, so there is no need to
+        // read it first; if it cannot be cached, write it through.
+        return RawWriteblk(bno, data);
+    }
+    memcpy(blk->data_.get(), data, kMinfsBlockSize);
+    // Write back on eviction, Flush(), or teardown.  Image population
+    // rewrites the same bitmap, inode table, and directory blocks over and
+    // over; keeping them dirty in the cache turns those into one write
+    // apiece.  The host tool flushes before exiting (and ~Bcache flushes
+    // as a backstop), so nothing is lost to the lack of an unmount.
+    blk->dirty_ = true;
+    return NO_ERROR;
+}
+
+mx_status_t Bcache::FlushLocked() {
+    mx_status_t status = NO_ERROR;
+    for (BlockNode& blk : lru_) {
+        if (!blk.dirty_) {
+            continue;
+        }
+        if ((status = RawWriteblk(blk.bno_, blk.data_.get())) != NO_ERROR) {
+            return status;
+        }
+        blk.dirty_ = false;
+    }
+    return status;
+}
+
+mx_status_t Bcache::Flush() {
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&cache_lock_);
+#endif
+    return FlushLocked();
+}
+
+#ifdef __Fuchsia__
+int Bcache::FlushThread(void* arg) {
+    Bcache* bc = static_cast<Bcache*>(arg);
+    mtx_lock(&bc->cache_lock_);
+    while (bc->flush_running_) {
+        struct timespec due;
+        clock_gettime(CLOCK_REALTIME, &due);
+        due.tv_sec += kMinfsFlushIntervalSec;
+        cnd_timedwait(&bc->flush_cnd_, &bc->cache_lock_, &due);
+        bc->FlushLocked();
+        bc->ShrinkOnPressureLocked();
+    }
+    mtx_unlock(&bc->cache_lock_);
+    return 0;
+}
+
+void Bcache::ShrinkOnPressureLocked() {
+    if (pressure_event_ == MX_HANDLE_INVALID) {
+        return;
+    }
+    mx_signals_t pending = 0;
+    mx_object_wait_one(pressure_event_, MX_EVENT_SIGNALED, 0u, &pending);
+    if (!(pending & MX_EVENT_SIGNALED)) {
+        return;
+    }
+    // The flush above left the cache clean, so eviction is pure frees.
+    while (cache_count_ > kMinfsBlockCacheSize / 8) {
+        if (CacheEvictLocked() != NO_ERROR) {
+            break;
+        }
+    }
+}
+#endif
+
 int Bcache::Sync() {
+    Flush();
     return fsync(fd_);
 }
 
@@ -56,6 +273,11 @@ mx_status_t Bcache::Create(mxtl::unique_ptr<Bcache>* out, int fd, uint32_t block
     if (!ac.check()) {
         return ERR_NO_MEMORY;
     }
+    uint8_t* readahead = new (&ac) uint8_t[kMinfsReadaheadBlocks * kMinfsBlockSize];
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    bc->readahead_.reset(readahead);
 #ifdef __Fuchsia__
     mx_status_t status;
     mx_handle_t fifo;
@@ -71,6 +293,20 @@ mx_status_t Bcache::Create(mxtl::unique_ptr<Bcache>* out, int fd, uint32_t block
         mx_handle_close(fifo);
         return status;
     }
+
+    // Failure just means we never shrink proactively; not fatal.
+    if (mx_system_get_memory_pressure_event(MX_MEM_PRESSURE_WARNING,
+                                            &bc->pressure_event_) != NO_ERROR) {
+        bc->pressure_event_ = MX_HANDLE_INVALID;
+    }
+
+    // Without the flush thread, dirty blocks are still written back on
+    // Flush(), Sync(), and eviction, so failure here is not fatal.
+    cnd_init(&bc->flush_cnd_);
+    bc->flush_running_ = true;
+    if (thrd_create(&bc->flush_thread_, FlushThread, bc.get()) != thrd_success) {
+        bc->flush_running_ = false;
+    }
 #endif
 
     *out = mxtl::move(bc);
@@ -94,10 +330,25 @@ mx_status_t Bcache::AttachVmo(mx_handle_t vmo, vmoid_t* out) {
 #endif
 
 Bcache::Bcache(int fd, uint32_t blockmax) :
-    fd_(fd), blockmax_(blockmax) {}
+    fd_(fd), blockmax_(blockmax), journal_(nullptr), cache_count_(0) {}
 
 Bcache::~Bcache() {
 #ifdef __Fuchsia__
+    if (flush_running_) {
+        mtx_lock(&cache_lock_);
+        flush_running_ = false;
+        cnd_signal(&flush_cnd_);
+        mtx_unlock(&cache_lock_);
+        thrd_join(flush_thread_, nullptr);
+    }
+#endif
+    FlushLocked();
+    lru_.clear();
+    cache_.clear();
+#ifdef __Fuchsia__
+    if (pressure_event_ != MX_HANDLE_INVALID) {
+        mx_handle_close(pressure_event_);
+    }
     if (fifo_client_ != nullptr) {
         ioctl_block_free_txn(fd_, &txnid_);
         ioctl_block_fifo_close(fd_);
@@ -10,6 +10,7 @@
 
 #include <fs/vfs.h>
 
+#include "journal.h"
 #include "minfs.h"
 #include "misc.h"
 
@@ -88,6 +89,18 @@ private:
 
 template <bool Write>
 inline mx_status_t BlockTxn<vmoid_t, Write>::Flush() {
+    Journal* journal = Write ? bc_->GetJournal() : nullptr;
+    if (journal != nullptr && count_ != 0) {
+        // Metadata writes are group-committed through the journal; their
+        // home locations are updated when the journal flushes. Requests
+        // against unregistered vmos (file data) remain in the array and
+        // are written directly below.
+        mx_status_t status = journal->LogTxn(requests_, &count_);
+        if (status != NO_ERROR) {
+            count_ = 0;
+            return status;
+        }
+    }
     for (size_t i = 0; i < count_; i++) {
         requests_[i].opcode = Write ? BLOCKIO_WRITE : BLOCKIO_READ;
         requests_[i].vmo_offset *= kMinfsBlockSize;
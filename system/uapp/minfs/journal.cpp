@@ -0,0 +1,224 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fs/trace.h>
+#include <mxalloc/new.h>
+#ifdef __Fuchsia__
+#include <mxtl/auto_lock.h>
+#endif
+
+#include "journal.h"
+
+namespace minfs {
+
+Journal::Journal(Bcache* bc) : bc_(bc) {
+    memset(&header_, 0, sizeof(header_));
+    header_.magic = kJournalMagic;
+#ifdef __Fuchsia__
+    vmo_count_ = 0;
+#endif
+}
+
+Journal::~Journal() {
+    Flush();
+}
+
+mx_status_t Journal::Create(Bcache* bc, mxtl::unique_ptr<Journal>* out) {
+    AllocChecker ac;
+    mxtl::unique_ptr<Journal> journal(new (&ac) Journal(bc));
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    uint8_t* entry = new (&ac) uint8_t[kJournalEntryBlocks * kMinfsBlockSize];
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    journal->entry_.reset(entry);
+    *out = mxtl::move(journal);
+    return NO_ERROR;
+}
+
+mx_status_t Journal::WriteHeader(journal_header_t* header) {
+    char blk[kMinfsBlockSize];
+    memset(blk, 0, sizeof(blk));
+    header->checksum = 0;
+    header->checksum = journal_checksum(header);
+    memcpy(blk, header, sizeof(*header));
+    mx_status_t status = bc_->Writeblk(kJournalStartBlock, blk);
+    if (status != NO_ERROR) {
+        return status;
+    }
+    // The header orders the writes around it (images before commit, home
+    // locations before retirement), so force it out of the block cache.
+    return bc_->Flush();
+}
+
+mx_status_t Journal::Replay(Bcache* bc) {
+    char blk[kMinfsBlockSize];
+    mx_status_t status;
+    if ((status = bc->Readblk(kJournalStartBlock, blk)) != NO_ERROR) {
+        return status;
+    }
+    journal_header_t header;
+    memcpy(&header, blk, sizeof(header));
+
+    // A header which does not validate -- wrong magic (a pre-journal image),
+    // a torn write, or an empty log -- means there is nothing to replay.
+    uint32_t checksum = header.checksum;
+    header.checksum = 0;
+    if ((header.magic != kJournalMagic) ||
+        (journal_checksum(&header) != checksum) ||
+        (header.count > kJournalEntryBlocks)) {
+        return NO_ERROR;
+    }
+
+    if (header.count > 0) {
+        FS_TRACE(MINFS, "minfs: replaying journal entry seq=%llu count=%u\n",
+                 (unsigned long long)header.seq, header.count);
+        for (uint32_t i = 0; i < header.count; i++) {
+            if ((status = bc->Readblk(kJournalStartBlock + 1 + i, blk)) != NO_ERROR) {
+                return status;
+            }
+            if ((status = bc->Writeblk(header.target[i], blk)) != NO_ERROR) {
+                return status;
+            }
+        }
+    }
+
+    // Retire the entry, after the home locations have landed.
+    if ((status = bc->Flush()) != NO_ERROR) {
+        return status;
+    }
+    uint64_t seq = header.seq + 1;
+    memset(&header, 0, sizeof(header));
+    header.magic = kJournalMagic;
+    header.seq = seq;
+    header.checksum = journal_checksum(&header);
+    memset(blk, 0, sizeof(blk));
+    memcpy(blk, &header, sizeof(header));
+    return bc->Writeblk(kJournalStartBlock, blk);
+}
+
+mx_status_t Journal::Log(uint32_t bno, const void* data) {
+    // Update in place if this block is already part of the open entry.
+    for (uint32_t i = 0; i < header_.count; i++) {
+        if (header_.target[i] == bno) {
+            memcpy(&entry_[i * kMinfsBlockSize], data, kMinfsBlockSize);
+            return NO_ERROR;
+        }
+    }
+
+    if (header_.count == kJournalEntryBlocks) {
+        mx_status_t status = FlushLocked();
+        if (status != NO_ERROR) {
+            return status;
+        }
+    }
+
+    uint32_t i = header_.count++;
+    header_.target[i] = bno;
+    memcpy(&entry_[i * kMinfsBlockSize], data, kMinfsBlockSize);
+    return NO_ERROR;
+}
+
+#ifdef __Fuchsia__
+
+mx_status_t Journal::RegisterVmo(vmoid_t id, const void* base) {
+    if (vmo_count_ == kMaxVmos) {
+        return ERR_NO_RESOURCES;
+    }
+    vmos_[vmo_count_].id = id;
+    vmos_[vmo_count_].base = base;
+    vmo_count_++;
+    return NO_ERROR;
+}
+
+mx_status_t Journal::LogTxn(block_fifo_request_t* requests, size_t* count) {
+    mxtl::AutoLock lock(&lock_);
+    size_t remaining = 0;
+    mx_status_t status = NO_ERROR;
+    for (size_t i = 0; i < *count; i++) {
+        const void* base = nullptr;
+        for (size_t v = 0; v < vmo_count_; v++) {
+            if (vmos_[v].id == requests[i].vmoid) {
+                base = vmos_[v].base;
+                break;
+            }
+        }
+        if (base == nullptr) {
+            // Not a journaled vmo (file data); leave the request for the
+            // caller to write directly.
+            requests[remaining++] = requests[i];
+            continue;
+        }
+        for (uint64_t b = 0; b < requests[i].length; b++) {
+            const void* data = (const void*)((uintptr_t)base +
+                (uintptr_t)((requests[i].vmo_offset + b) * kMinfsBlockSize));
+            uint32_t bno = static_cast<uint32_t>(requests[i].dev_offset + b);
+            if ((status = Log(bno, data)) != NO_ERROR) {
+                return status;
+            }
+        }
+    }
+    *count = remaining;
+    return status;
+}
+
+#endif // __Fuchsia__
+
+mx_status_t Journal::Flush() {
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&lock_);
+#endif
+    return FlushLocked();
+}
+
+mx_status_t Journal::FlushLocked() {
+    if (header_.count == 0) {
+        return NO_ERROR;
+    }
+
+    // Write the block images sequentially into the log...
+    mx_status_t status;
+    for (uint32_t i = 0; i < header_.count; i++) {
+        if ((status = bc_->Writeblk(kJournalStartBlock + 1 + i,
+                                    &entry_[i * kMinfsBlockSize])) != NO_ERROR) {
+            return status;
+        }
+    }
+
+    // ...and force them to the device before the commit record.
+    if ((status = bc_->Flush()) != NO_ERROR) {
+        return status;
+    }
+
+    // ...then commit by writing the header. Once this lands, a crash
+    // replays the entry instead of leaving a partial update behind.
+    if ((status = WriteHeader(&header_)) != NO_ERROR) {
+        return status;
+    }
+
+    // Write back the home locations, and make sure they land before the
+    // entry is retired.
+    for (uint32_t i = 0; i < header_.count; i++) {
+        if ((status = bc_->Writeblk(header_.target[i],
+                                    &entry_[i * kMinfsBlockSize])) != NO_ERROR) {
+            return status;
+        }
+    }
+    if ((status = bc_->Flush()) != NO_ERROR) {
+        return status;
+    }
+
+    // Retire the entry.
+    uint64_t seq = header_.seq + 1;
+    memset(&header_, 0, sizeof(header_));
+    header_.magic = kJournalMagic;
+    header_.seq = seq;
+    return WriteHeader(&header_);
+}
+
+} // namespace minfs
@@ -0,0 +1,126 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __Fuchsia__
+#include <threads.h>
+#endif
+
+#include <mxtl/macros.h>
+#include <mxtl/unique_ptr.h>
+
+#include "minfs.h"
+
+namespace minfs {
+
+// The journal occupies the reserved blocks between the info block and the
+// inode bitmap (with the standard layout, blocks 1 through 7). The first
+// block of the region holds the commit header; the remaining blocks hold
+// images of metadata blocks which have not yet been written back to their
+// home locations.
+//
+// Writers fill the image blocks first and write the header last; the header
+// is the commit record. On mount, a header which validates is replayed by
+// copying each image to its home location, making a group of metadata
+// updates atomic with respect to crashes.
+constexpr uint32_t kJournalStartBlock = 1;
+constexpr uint32_t kJournalBlocks     = 7;
+constexpr uint32_t kJournalEntryBlocks = kJournalBlocks - 1;
+
+constexpr uint64_t kJournalMagic = (0x6c616e72756f6a6dULL); // 'mjournal'
+
+typedef struct {
+    uint64_t magic;
+    uint64_t seq;                          // commit sequence number
+    uint32_t count;                        // number of valid block images
+    uint32_t checksum;                     // see journal_checksum()
+    uint32_t target[kJournalEntryBlocks];  // home block numbers of the images
+} journal_header_t;
+
+static_assert(sizeof(journal_header_t) <= kMinfsBlockSize,
+              "minfs journal header must fit in one block");
+
+// Checksum over the header with the checksum field itself zeroed (FNV-1a).
+// This protects replay against a torn header write: a header which does not
+// validate is treated as an empty log.
+constexpr uint32_t kJournalChecksumSeed = 2166136261u;
+
+inline uint32_t journal_checksum(const journal_header_t* header) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(header);
+    size_t skip_off = offsetof(journal_header_t, checksum);
+    uint32_t n = kJournalChecksumSeed;
+    for (size_t i = 0; i < sizeof(journal_header_t); i++) {
+        uint8_t c = ((i - skip_off) < sizeof(uint32_t)) ? 0 : data[i];
+        n = (n ^ c) * 16777619u;
+    }
+    return n;
+}
+
+class Journal {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Journal);
+
+    static mx_status_t Create(Bcache* bc, mxtl::unique_ptr<Journal>* out);
+
+    // Replay a committed entry left behind by a crash (if any), then reset
+    // the log. Uses raw block IO only; called before the bitmaps and inode
+    // table are read at mount time.
+    static mx_status_t Replay(Bcache* bc);
+
+    // Flushes any open entry on teardown.
+    ~Journal();
+
+#ifdef __Fuchsia__
+    // Make 'base' available as the source of images for blocks enqueued
+    // against vmoid 'id' (i.e. the mapping of the vmo attached as 'id').
+    mx_status_t RegisterVmo(vmoid_t id, const void* base);
+
+    // Copy the current images of all blocks covered by requests against
+    // registered vmoids into the open entry, removing those requests from
+    // the array (and updating *count). Requests against unregistered
+    // vmoids -- file data -- are left for the caller to write directly.
+    // Requests must still be described in block units.
+    mx_status_t LogTxn(block_fifo_request_t* requests, size_t* count);
+#endif
+
+    // Group commit: write the open entry sequentially to the log region,
+    // then write the images to their home locations and retire the entry.
+    mx_status_t Flush();
+
+private:
+    Journal(Bcache* bc);
+
+    // Flush() with lock_ held (on Fuchsia).
+    mx_status_t FlushLocked();
+
+    // Add a single block image to the open entry, flushing first if the
+    // entry is full. Updates the image in place if 'bno' is already logged.
+    mx_status_t Log(uint32_t bno, const void* data);
+
+    // Write 'header' to the header block of the log region.
+    mx_status_t WriteHeader(journal_header_t* header);
+
+    Bcache* bc_;
+    journal_header_t header_;
+    mxtl::unique_ptr<uint8_t[]> entry_;  // kJournalEntryBlocks block images
+
+#ifdef __Fuchsia__
+    // Serializes the open entry across dispatcher threads.
+    mtx_t lock_ = MTX_INIT;
+
+    // Mappings for the vmoids whose writes are journaled (block bitmap,
+    // inode bitmap, inode table).
+    static constexpr size_t kMaxVmos = 4;
+    struct {
+        vmoid_t id;
+        const void* base;
+    } vmos_[kMaxVmos];
+    size_t vmo_count_;
+#endif
+};
+
+} // namespace minfs
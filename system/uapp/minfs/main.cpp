@@ -4,6 +4,7 @@
 
 // for S_IF*
 #define _XOPEN_SOURCE
+#include <ctype.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <stdarg.h>
@@ -18,6 +19,17 @@
 #include <magenta/processargs.h>
 #include <mxtl/unique_ptr.h>
 
+#ifdef __Fuchsia__
+#include <magenta/device/vfs.h>
+#include <magenta/syscalls.h>
+#include <mxalloc/new.h>
+#include <mxio/dispatcher.h>
+#include <mxio/remoteio.h>
+#include <mxio/util.h>
+#include <mxtl/intrusive_double_list.h>
+#include <threads.h>
+#endif
+
 #include "minfs-private.h"
 #ifndef __Fuchsia__
 #include "host.h"
@@ -57,6 +69,198 @@ int do_minfs_mount(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
     vfs_rpc_server(h, vn);
     return 0;
 }
+
+off_t get_size(int fd);
+
+// A filesystem parked by the resident server across an unmount, so that a
+// later remount of the same device can skip loading and verifying the
+// superblock and bitmaps.
+struct ParkedFs : public mxtl::DoublyLinkedListable<mxtl::unique_ptr<ParkedFs>> {
+    ~ParkedFs() {
+        if (fs != nullptr) {
+            root.reset();
+            fs->Unmount();
+        }
+    }
+
+    minfs::Minfs* fs = nullptr;
+    mxtl::RefPtr<minfs::VnodeMinfs> root;
+};
+
+// Parked filesystems, oldest first. The retain hook may run on a dispatcher
+// thread while the control loop is mounting, so the list is locked.
+constexpr size_t kMaxParkedFs = 4;
+mtx_t parked_lock = MTX_INIT;
+mxtl::DoublyLinkedList<mxtl::unique_ptr<ParkedFs>> parked_fs;
+size_t parked_count = 0;
+
+mx_status_t park_fs(minfs::Minfs* fs, mxtl::RefPtr<minfs::VnodeMinfs> root) {
+    AllocChecker ac;
+    mxtl::unique_ptr<ParkedFs> entry(new (&ac) ParkedFs());
+    if (!ac.check()) {
+        // No memory to park the filesystem; tear it down as usual.
+        root.reset();
+        return fs->Unmount();
+    }
+    entry->fs = fs;
+    entry->root = mxtl::move(root);
+    mxtl::unique_ptr<ParkedFs> evicted;
+    mtx_lock(&parked_lock);
+    if (parked_count == kMaxParkedFs) {
+        evicted = parked_fs.pop_front();
+    } else {
+        parked_count++;
+    }
+    parked_fs.push_back(mxtl::move(entry));
+    mtx_unlock(&parked_lock);
+    // The evicted filesystem is destroyed outside the lock; unmounting it
+    // blocks until its dispatcher threads have been joined.
+    return NO_ERROR;
+}
+
+mx_status_t do_service_mount(mxio_dispatcher_t* dispatcher,
+                             mx_handle_t* hnd, uint32_t hcount) {
+    if ((hcount < 2) || (hcount > 3)) {
+        for (uint32_t i = 0; i < hcount; i++) {
+            mx_handle_close(hnd[i]);
+        }
+        return ERR_INVALID_ARGS;
+    }
+    mx_handle_t mountee = hnd[0];
+    mxio_t* io = mxio_remote_create(hnd[1], (hcount == 3) ? hnd[2] : 0);
+    if (io == nullptr) {
+        for (uint32_t i = 0; i < hcount; i++) {
+            mx_handle_close(hnd[i]);
+        }
+        return ERR_NO_RESOURCES;
+    }
+    int fd = mxio_bind_to_fd(io, -1, 0);
+    if (fd < 0) {
+        mx_handle_close(mountee);
+        return ERR_NO_RESOURCES;
+    }
+
+    char blk[minfs::kMinfsBlockSize];
+    if (pread(fd, blk, sizeof(blk), 0) != (ssize_t)sizeof(blk)) {
+        close(fd);
+        mx_handle_close(mountee);
+        return ERR_IO;
+    }
+
+    // Reuse a parked filesystem whose superblock matches the device exactly;
+    // the parked bitmaps and block cache are only valid if nothing has
+    // written the device since it was unmounted, and any write changes the
+    // allocation counts stored in the superblock.
+    mxtl::unique_ptr<ParkedFs> match;
+    mtx_lock(&parked_lock);
+    for (auto iter = parked_fs.begin(); iter != parked_fs.end(); ++iter) {
+        if (!memcmp(&iter->fs->info_, blk, sizeof(minfs::minfs_info_t))) {
+            match = parked_fs.erase(iter);
+            parked_count--;
+            break;
+        }
+    }
+    mtx_unlock(&parked_lock);
+
+    mx_status_t status;
+    if (match != nullptr) {
+        // The parked filesystem still owns its own device connection.
+        close(fd);
+        status = vfs_rpc_serve_root(dispatcher, mountee, match->root);
+        if (status != NO_ERROR) {
+            // ~ParkedFs unmounts.
+            mx_handle_close(mountee);
+            return status;
+        }
+        // Ownership returns to the active mount.
+        match->fs = nullptr;
+        match->root.reset();
+        return NO_ERROR;
+    }
+
+    off_t size = get_size(fd) / minfs::kMinfsBlockSize;
+    mxtl::unique_ptr<minfs::Bcache> bc;
+    if (minfs::Bcache::Create(&bc, fd, (uint32_t)size) < 0) {
+        close(fd);
+        mx_handle_close(mountee);
+        return ERR_NO_MEMORY;
+    }
+    mxtl::RefPtr<minfs::VnodeMinfs> vn;
+    if ((status = minfs_mount(&vn, mxtl::move(bc))) != NO_ERROR) {
+        mx_handle_close(mountee);
+        return status;
+    }
+    // Serve the root on the service's own dispatcher rather than the per-fs
+    // pool, so teardown on unmount never runs on a thread it must join.
+    if ((status = vfs_rpc_serve_root(dispatcher, mountee, mxtl::move(vn))) != NO_ERROR) {
+        mx_handle_close(mountee);
+        return status;
+    }
+    return NO_ERROR;
+}
+
+// Run as a resident filesystem server, reading mount and shutdown requests
+// from the control channel. Mount latency is dominated by process launch and
+// superblock/bitmap loading; a resident server pays the launch cost once and
+// parks recently unmounted filesystems for reuse.
+int do_minfs_service() {
+    mx_handle_t control = mx_get_startup_handle(PA_HND(PA_USER0, 0));
+    if (control == MX_HANDLE_INVALID) {
+        FS_TRACE_ERROR("minfs: Could not access service control channel\n");
+        return ERR_BAD_STATE;
+    }
+
+    // Unmount tears down one filesystem instead of exiting the process, and
+    // parks it for reuse instead of destroying it.
+    vfs_set_exit_on_unmount(false);
+    minfs::minfs_retain_hook = park_fs;
+
+    mxio_dispatcher_t* dispatcher;
+    mx_status_t status;
+    if ((status = mxio_dispatcher_create(&dispatcher, mxrio_handler)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = mxio_dispatcher_start(dispatcher, "minfs-service")) != NO_ERROR) {
+        return status;
+    }
+
+    for (;;) {
+        mx_object_wait_one(control, MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED,
+                           MX_TIME_INFINITE, nullptr);
+        vfs_service_request_t req;
+        mx_handle_t hnd[3];
+        uint32_t dsize = sizeof(req);
+        uint32_t hcount = countof(hnd);
+        status = mx_channel_read(control, 0, &req, hnd, dsize, hcount,
+                                 &dsize, &hcount);
+        if (status != NO_ERROR) {
+            // Control channel closed; shut down as if requested.
+            break;
+        }
+        if ((dsize != sizeof(req)) || (req.op == VFS_SERVICE_OP_SHUTDOWN)) {
+            for (uint32_t i = 0; i < hcount; i++) {
+                mx_handle_close(hnd[i]);
+            }
+            break;
+        }
+        if (req.op == VFS_SERVICE_OP_MOUNT) {
+            status = do_service_mount(dispatcher, hnd, hcount);
+        } else {
+            for (uint32_t i = 0; i < hcount; i++) {
+                mx_handle_close(hnd[i]);
+            }
+            status = ERR_INVALID_ARGS;
+        }
+        mx_channel_write(control, 0, &status, sizeof(status), nullptr, 0);
+    }
+
+    mtx_lock(&parked_lock);
+    parked_fs.clear();
+    parked_count = 0;
+    mtx_unlock(&parked_lock);
+    mx_handle_close(control);
+    return 0;
+}
 #else
 int io_setup(mxtl::unique_ptr<minfs::Bcache> bc) {
     mxtl::RefPtr<minfs::VnodeMinfs> vn;
@@ -74,23 +278,15 @@ int do_minfs_test(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
     return run_fs_tests(argc, argv);
 }
 
-int do_cp(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
-    if (argc != 2) {
-        fprintf(stderr, "cp requires two arguments\n");
-        return -1;
-    }
-
-    if (io_setup(mxtl::move(bc))) {
-        return -1;
-    }
-
+int cp_file(const char* src, const char* dst) {
     int fdi, fdo;
-    if ((fdi = emu_open(argv[0], O_RDONLY, 0)) < 0) {
-        fprintf(stderr, "error: cannot open '%s'\n", argv[0]);
+    if ((fdi = emu_open(src, O_RDONLY, 0)) < 0) {
+        fprintf(stderr, "error: cannot open '%s'\n", src);
         return -1;
     }
-    if ((fdo = emu_open(argv[1], O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
-        fprintf(stderr, "error: cannot open '%s'\n", argv[1]);
+    if ((fdo = emu_open(dst, O_WRONLY | O_CREAT | O_EXCL, 0644)) < 0) {
+        fprintf(stderr, "error: cannot open '%s'\n", dst);
+        emu_close(fdi);
         return -1;
     }
 
@@ -98,7 +294,7 @@ int do_cp(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
     ssize_t r;
     for (;;) {
         if ((r = emu_read(fdi, buffer, sizeof(buffer))) < 0) {
-            fprintf(stderr, "error: reading from '%s'\n", argv[0]);
+            fprintf(stderr, "error: reading from '%s'\n", src);
             break;
         } else if (r == 0) {
             break;
@@ -107,7 +303,7 @@ int do_cp(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
         ssize_t len = r;
         while (len > 0) {
             if ((r = emu_write(fdo, ptr, len)) < 0) {
-                fprintf(stderr, "error: writing to '%s'\n", argv[1]);
+                fprintf(stderr, "error: writing to '%s'\n", dst);
                 goto done;
             }
             ptr = (void*)((uintptr_t)ptr + r);
@@ -117,7 +313,93 @@ int do_cp(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
 done:
     emu_close(fdi);
     emu_close(fdo);
-    return r;
+    return static_cast<int>(r);
+}
+
+int do_cp(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "cp requires two arguments\n");
+        return -1;
+    }
+
+    if (io_setup(mxtl::move(bc))) {
+        return -1;
+    }
+
+    return cp_file(argv[0], argv[1]);
+}
+
+char* trim(char* str) {
+    char* end;
+    while (isspace(*str)) {
+        str++;
+    }
+    end = str + strlen(str);
+    while (end > str) {
+        end--;
+        if (isspace(*end)) {
+            *end = 0;
+        } else {
+            break;
+        }
+    }
+    return str;
+}
+
+// Populate the image from a mkbootfs-style manifest ("dst=src" lines) in a
+// single invocation, rather than mounting, copying one file, and tearing
+// down once per file.
+int do_manifest(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
+    if (argc != 1) {
+        fprintf(stderr, "manifest requires one argument\n");
+        return -1;
+    }
+
+    if (io_setup(mxtl::move(bc))) {
+        return -1;
+    }
+
+    FILE* fp = fopen(argv[0], "r");
+    if (fp == nullptr) {
+        fprintf(stderr, "error: cannot open '%s'\n", argv[0]);
+        return -1;
+    }
+
+    int lineno = 0;
+    char line[4096];
+    char dst[4096];
+    while (fgets(line, sizeof(line), fp) != nullptr) {
+        lineno++;
+        char* eq = strchr(line, '=');
+        if (eq == nullptr) {
+            continue;
+        }
+        *eq++ = 0;
+        char* dstfn = trim(line);
+        char* srcfn = trim(eq);
+        if (snprintf(dst, sizeof(dst), "%s%s", PATH_PREFIX, dstfn) >=
+            (int)sizeof(dst)) {
+            fprintf(stderr, "error: %s:%d: name too long\n", argv[0], lineno);
+            fclose(fp);
+            return -1;
+        }
+        // Create any missing parent directories.  emu_mkdir fails if the
+        // directory already exists; real problems surface when the file
+        // itself is opened.
+        for (char* p = dst + PREFIX_SIZE; (p = strchr(p, '/')) != nullptr; p++) {
+            *p = 0;
+            emu_mkdir(dst, 0);
+            *p = '/';
+        }
+        if (cp_file(srcfn, dst) < 0) {
+            fprintf(stderr, "error: %s:%d: cannot copy '%s'\n",
+                    argv[0], lineno, srcfn);
+            fclose(fp);
+            return -1;
+        }
+    }
+    fclose(fp);
+    return 0;
 }
 
 int do_mkdir(mxtl::unique_ptr<minfs::Bcache> bc, int argc, char** argv) {
@@ -246,6 +528,7 @@ struct {
 #else
     {"test", do_minfs_test, O_RDWR, "run tests against filesystem"},
     {"cp", do_cp, O_RDWR, "copy to/from fs"},
+    {"manifest", do_manifest, O_RDWR, "add files from manifest (dst=src lines)"},
     {"mkdir", do_mkdir, O_RDWR, "create directory"},
     {"rm", do_unlink, O_RDWR, "delete file or directory"},
     {"unlink", do_unlink, O_RDWR, "delete file or directory"},
@@ -272,6 +555,10 @@ int usage() {
         fprintf(stderr, "%9s %-10s %s\n", n ? "" : "commands:",
                 CMDS[n].name, CMDS[n].help);
     }
+#ifdef __Fuchsia__
+    fprintf(stderr, "%9s %-10s %s\n", "", "service",
+            "run resident server; mounts arrive via control channel");
+#endif
     fprintf(stderr, "\n");
     return -1;
 }
@@ -309,6 +596,11 @@ int main(int argc, char** argv) {
         return usage();
     }
     char* cmd = argv[1];
+    // The resident service receives block devices over the control channel
+    // rather than at startup, so dispatch it before creating the block cache.
+    if (!strcmp(cmd, "service")) {
+        return do_minfs_service();
+    }
 #else
     // Block device passed by path
     if (argc < 3) {
@@ -385,7 +677,16 @@ found:
 
     for (unsigned i = 0; i < countof(CMDS); i++) {
         if (!strcmp(cmd, CMDS[i].name)) {
-            return CMDS[i].func(mxtl::move(bc), argc - 3, argv + 3);
+            int r = CMDS[i].func(mxtl::move(bc), argc - 3, argv + 3);
+#ifndef __Fuchsia__
+            // The host tool exits without unmounting; write back whatever
+            // the command left dirty in the block cache.  mkfs and fsck
+            // consume the bcache without mounting and flush on teardown.
+            if (fake_root != nullptr) {
+                fake_root->fs_->bc_->Flush();
+            }
+#endif
+            return r;
         }
     }
     return -1;
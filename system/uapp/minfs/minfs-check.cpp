@@ -7,6 +7,8 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <mxalloc/new.h>
+
 #include "minfs-private.h"
 #include "minfs.h"
 
@@ -197,7 +199,121 @@ mx_status_t MinfsChecker::CheckDirectory(minfs_inode_t* inode, uint32_t ino,
     return NO_ERROR;
 }
 
-const char* MinfsChecker::CheckDataBlock(uint32_t bno) {
+// Validates the hashed directory index against the dirent stream: the header
+// must be sane, the slot counts must match it, and every live dirent must be
+// findable through the index exactly as lookup would find it. A stale index
+// (seq_num behind the inode's) is legal -- an older driver modified the
+// directory -- and is skipped, since the driver ignores and rebuilds it.
+mx_status_t MinfsChecker::CheckDirIndex(minfs_inode_t* inode, uint32_t ino) {
+    mx_status_t status;
+    mxtl::RefPtr<VnodeMinfs> vn;
+    if ((status = VnodeMinfs::AllocateHollow(fs_.get(), &vn)) != NO_ERROR) {
+        return status;
+    }
+    memcpy(&vn->inode_, inode, kMinfsInodeSize);
+    vn->ino_ = ino;
+
+    minfs_dir_index_t hdr;
+    if ((status = vn->ReadExactInternal(&hdr, sizeof(hdr),
+                                        kMinfsDirIndexOffset)) != NO_ERROR) {
+        FS_TRACE_WARN("check: ino#%u: could not read directory index header\n", ino);
+        conforming_ = false;
+        return NO_ERROR;
+    }
+    if ((hdr.magic != kMinfsDirIndexMagic) ||
+        (hdr.version != kMinfsDirIndexVersion)) {
+        FS_TRACE_WARN("check: ino#%u: bad directory index header\n", ino);
+        conforming_ = false;
+        return NO_ERROR;
+    }
+    if (hdr.seq_num != inode->seq_num) {
+        FS_TRACE_INFO("ino#%u: directory index is stale (seq %u != %u); skipping\n",
+             ino, hdr.seq_num, inode->seq_num);
+        return NO_ERROR;
+    }
+    if (inode->size < kMinfsDirIndexEnd) {
+        FS_TRACE_WARN("check: ino#%u: directory size %u too small for its index\n",
+              ino, inode->size);
+        conforming_ = false;
+        return NO_ERROR;
+    }
+    if (hdr.entries != inode->dirent_count) {
+        FS_TRACE_WARN("check: ino#%u: index entries %u != dirent_count %u\n",
+              ino, hdr.entries, inode->dirent_count);
+        conforming_ = false;
+    }
+
+    const size_t slot_base = kMinfsDirIndexOffset + sizeof(minfs_dir_index_t);
+    uint32_t live = 0;
+    uint32_t dead = 0;
+    for (uint32_t n = 0; n < kMinfsDirIndexSlots; n++) {
+        uint32_t slot;
+        if ((status = vn->ReadExactInternal(&slot, sizeof(slot),
+                slot_base + n * sizeof(uint32_t))) != NO_ERROR) {
+            return status;
+        }
+        if (slot == kMinfsDirIndexSlotDead) {
+            dead++;
+        } else if (slot != kMinfsDirIndexSlotFree) {
+            live++;
+            size_t off = DirIndexSlotOffset(slot);
+            if (off + MINFS_DIRENT_SIZE >= kMinfsMaxDirectorySize) {
+                FS_TRACE_WARN("check: ino#%u: index slot %u: bad offset %zu\n",
+                      ino, n, off);
+                conforming_ = false;
+            }
+        }
+    }
+    if ((live != hdr.entries) || (dead != hdr.tombstones)) {
+        FS_TRACE_WARN("check: ino#%u: index slot counts %u/%u != header %u/%u\n",
+              ino, live, dead, hdr.entries, hdr.tombstones);
+        conforming_ = false;
+    }
+
+    size_t off = 0;
+    while (off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+        char data[kMinfsMaxDirentSize];
+        minfs_dirent_t* de = reinterpret_cast<minfs_dirent_t*>(data);
+        size_t actual;
+        status = vn->ReadInternal(data, kMinfsMaxDirentSize, off, &actual);
+        if ((status != NO_ERROR) || (actual < MINFS_DIRENT_SIZE)) {
+            // CheckDirectory already complained about the dirent stream.
+            return status < 0 ? status : ERR_IO;
+        }
+        if (de->ino != 0) {
+            uint32_t hash = fnv1a32(de->name, de->namelen);
+            uint32_t want = DirIndexSlot(hash, off);
+            bool found = false;
+            for (uint32_t i = 0; i < kMinfsDirIndexSlots; i++) {
+                size_t n = (hash + i) & (kMinfsDirIndexSlots - 1);
+                uint32_t slot;
+                if ((status = vn->ReadExactInternal(&slot, sizeof(slot),
+                        slot_base + n * sizeof(uint32_t))) != NO_ERROR) {
+                    return status;
+                }
+                if (slot == kMinfsDirIndexSlotFree) {
+                    break;
+                }
+                if (slot == want) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                FS_TRACE_WARN("check: ino#%u: '%.*s' missing from directory index\n",
+                      ino, de->namelen, de->name);
+                conforming_ = false;
+            }
+        }
+        if (de->reclen & kMinfsReclenLast) {
+            break;
+        }
+        off += MinfsReclen(de, off);
+    }
+    return NO_ERROR;
+}
+
+const char* MinfsChecker::CheckDataBlock(uint32_t bno, RawBitmap* shard) {
     if (bno < fs_->info_.dat_block) {
         return "in metadata area";
     }
@@ -207,14 +323,17 @@ const char* MinfsChecker::CheckDataBlock(uint32_t bno) {
     if (!fs_->block_map_.Get(bno, bno + 1)) {
         return "not allocated";
     }
-    if (checked_blocks_.Get(bno, bno + 1)) {
+    // Only catches a double reference within this shard; references
+    // spanning shards are caught when DrainWorkers() merges them.
+    if (shard->Get(bno, bno + 1)) {
         return "double-allocated";
     }
-    checked_blocks_.Set(bno, bno + 1);
+    shard->Set(bno, bno + 1);
     return nullptr;
 }
 
-mx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, uint32_t ino) {
+mx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, uint32_t ino,
+                                    RawBitmap* shard, bool* conforming) {
     FS_TRACE_INFO("Direct blocks: \n");
     for (unsigned n = 0; n < kMinfsDirect; n++) {
         FS_TRACE_INFO(" %d,", inode->dnum[n]);
@@ -227,10 +346,10 @@ mx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, uint32_t ino) {
     for (unsigned n = 0; n < kMinfsIndirect; n++) {
         if (inode->inum[n]) {
             const char* msg;
-            if ((msg = CheckDataBlock(inode->inum[n])) != nullptr) {
+            if ((msg = CheckDataBlock(inode->inum[n], shard)) != nullptr) {
                FS_TRACE_WARN("check: ino#%u: indirect block %u(@%u): %s\n",
                      ino, n, inode->inum[n], msg);
-                conforming_ = false;
+                *conforming = false;
             }
             blocks++;
         }
@@ -252,9 +371,9 @@ mx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, uint32_t ino) {
         if (bno) {
             blocks++;
             const char* msg;
-            if ((msg = CheckDataBlock(bno)) != nullptr) {
+            if ((msg = CheckDataBlock(bno, shard)) != nullptr) {
                FS_TRACE_WARN("check: ino#%u: block %u(@%u): %s\n", ino, n, bno, msg);
-                conforming_ = false;
+                *conforming = false;
             }
             blocks_allocated = n + 1;
         }
@@ -263,17 +382,140 @@ mx_status_t MinfsChecker::CheckFile(minfs_inode_t* inode, uint32_t ino) {
         unsigned max_blocks = mxtl::roundup(inode->size, kMinfsBlockSize) / kMinfsBlockSize;
         if (blocks_allocated > max_blocks) {
            FS_TRACE_WARN("check: ino#%u: filesize too small\n", ino);
-            conforming_ = false;
+            *conforming = false;
         }
     }
     if (blocks != inode->block_count) {
        FS_TRACE_WARN("check: ino#%u: block count %u, actual blocks %u\n",
              ino, inode->block_count, blocks);
-        conforming_ = false;
+        *conforming = false;
     }
     return NO_ERROR;
 }
 
+int MinfsChecker::WorkerThread(void* arg) {
+    CheckWorker* w = static_cast<CheckWorker*>(arg);
+    MinfsChecker* chk = w->chk;
+
+    mtx_lock(&chk->queue_lock_);
+    for (;;) {
+        if (chk->queue_.is_empty()) {
+            if (chk->queue_done_) {
+                break;
+            }
+            cnd_wait(&chk->queue_work_cnd_, &chk->queue_lock_);
+            continue;
+        }
+        mxtl::unique_ptr<CheckJob> job = chk->queue_.pop_front();
+        chk->queue_len_--;
+        cnd_signal(&chk->queue_space_cnd_);
+        mtx_unlock(&chk->queue_lock_);
+
+        mx_status_t status = chk->CheckFile(&job->inode, job->ino,
+                                            &w->shard, &w->conforming);
+        if ((status != NO_ERROR) && (w->status == NO_ERROR)) {
+            w->status = status;
+        }
+
+        mtx_lock(&chk->queue_lock_);
+    }
+    mtx_unlock(&chk->queue_lock_);
+    return 0;
+}
+
+mx_status_t MinfsChecker::StartWorkers(uint32_t block_count) {
+    cnd_init(&queue_work_cnd_);
+    cnd_init(&queue_space_cnd_);
+    for (int i = 0; i < kNumCheckWorkers; i++) {
+        CheckWorker* w = &workers_[i];
+        w->chk = this;
+        w->conforming = true;
+        w->status = NO_ERROR;
+        mx_status_t status;
+        if ((status = w->shard.Reset(block_count)) != NO_ERROR) {
+            return status;
+        }
+        if (thrd_create(&w->thread, WorkerThread, w) != thrd_success) {
+            break;
+        }
+        w->running = true;
+        num_workers_++;
+    }
+    // Running with fewer workers (or none: QueueCheckFile checks inline
+    // on the calling thread) is slower, not wrong.
+    return NO_ERROR;
+}
+
+mx_status_t MinfsChecker::QueueCheckFile(minfs_inode_t* inode, uint32_t ino) {
+    if (num_workers_ == 0) {
+        return CheckFile(inode, ino, &checked_blocks_, &conforming_);
+    }
+
+    AllocChecker ac;
+    mxtl::unique_ptr<CheckJob> job(new (&ac) CheckJob());
+    if (!ac.check()) {
+        return CheckFile(inode, ino, &checked_blocks_, &conforming_);
+    }
+    job->inode = *inode;
+    job->ino = ino;
+
+    mtx_lock(&queue_lock_);
+    while (queue_len_ >= kCheckQueueLimit) {
+        cnd_wait(&queue_space_cnd_, &queue_lock_);
+    }
+    queue_.push_back(mxtl::move(job));
+    queue_len_++;
+    cnd_signal(&queue_work_cnd_);
+    mtx_unlock(&queue_lock_);
+    return NO_ERROR;
+}
+
+mx_status_t MinfsChecker::DrainWorkers() {
+    if (num_workers_ == 0) {
+        return NO_ERROR;
+    }
+
+    mtx_lock(&queue_lock_);
+    queue_done_ = true;
+    cnd_broadcast(&queue_work_cnd_);
+    mtx_unlock(&queue_lock_);
+
+    mx_status_t status = NO_ERROR;
+    constexpr size_t kBitsPerWord = sizeof(size_t) * CHAR_BIT;
+    size_t* merged = static_cast<size_t*>(checked_blocks_.StorageUnsafe()->GetData());
+    size_t nwords = (checked_blocks_.size() + kBitsPerWord - 1) / kBitsPerWord;
+
+    for (int i = 0; i < num_workers_; i++) {
+        CheckWorker* w = &workers_[i];
+        thrd_join(w->thread, nullptr);
+        w->running = false;
+        if ((w->status != NO_ERROR) && (status == NO_ERROR)) {
+            status = w->status;
+        }
+        if (!w->conforming) {
+            conforming_ = false;
+        }
+
+        // Fold the shard in; any bit already present was referenced by
+        // an inode checked on a different shard.
+        const size_t* src =
+            static_cast<const size_t*>(w->shard.StorageUnsafe()->GetData());
+        for (size_t n = 0; n < nwords; n++) {
+            size_t overlap = merged[n] & src[n];
+            merged[n] |= src[n];
+            while (overlap != 0) {
+                size_t bit = __builtin_ctzl(overlap);
+                overlap &= overlap - 1;
+                FS_TRACE_WARN("check: block %zu: double-allocated\n",
+                      n * kBitsPerWord + bit);
+                conforming_ = false;
+            }
+        }
+    }
+    num_workers_ = 0;
+    return status;
+}
+
 mx_status_t MinfsChecker::CheckInode(uint32_t ino, uint32_t parent, bool dot_or_dotdot) {
     minfs_inode_t inode;
     mx_status_t status;
@@ -309,19 +551,28 @@ mx_status_t MinfsChecker::CheckInode(uint32_t ino, uint32_t parent, bool dot_or_
     if (inode.magic == kMinfsMagicDir) {
         FS_TRACE_INFO("ino#%u: DIR blks=%u links=%u\n",
              ino, inode.block_count, inode.link_count);
-        if ((status = CheckFile(&inode, ino)) < 0) {
+        if ((status = QueueCheckFile(&inode, ino)) < 0) {
             return status;
         }
         if ((status = CheckDirectory(&inode, ino, parent, CD_DUMP)) < 0) {
             return status;
         }
+        if (inode.flags & kMinfsInodeDirIndex) {
+            if ((status = CheckDirIndex(&inode, ino)) < 0) {
+                return status;
+            }
+        }
         if ((status = CheckDirectory(&inode, ino, parent, CD_RECURSE)) < 0) {
             return status;
         }
     } else {
         FS_TRACE_INFO("ino#%u: FILE blks=%u links=%u size=%u\n",
              ino, inode.block_count, inode.link_count, inode.size);
-        if ((status = CheckFile(&inode, ino)) < 0) {
+        if (inode.flags & kMinfsInodeDirIndex) {
+            FS_TRACE_WARN("check: ino#%u: file carries the directory index flag\n", ino);
+            conforming_ = false;
+        }
+        if ((status = QueueCheckFile(&inode, ino)) < 0) {
             return status;
         }
     }
@@ -382,6 +633,14 @@ mx_status_t MinfsChecker::CheckLinkCounts() const {
 MinfsChecker::MinfsChecker()
     : conforming_(true), fs_(nullptr), links_(){};
 
+MinfsChecker::~MinfsChecker() {
+    // If the traversal bailed out early the workers are still parked on
+    // the queue; shut them down before the object goes away under them.
+    if (num_workers_ != 0) {
+        DrainWorkers();
+    }
+}
+
 mx_status_t MinfsChecker::Init(mxtl::unique_ptr<Bcache> bc, const minfs_info_t* info) {
     links_.reset(new int32_t[info->inode_count]{0}, info->inode_count);
     links_[0] = -1;
@@ -398,6 +657,9 @@ mx_status_t MinfsChecker::Init(mxtl::unique_ptr<Bcache> bc, const minfs_info_t*
         return status;
     }
     fs_.reset(fs);
+    if ((status = StartWorkers(info->block_count)) < 0) {
+        return status;
+    }
     return NO_ERROR;
 }
 
@@ -430,6 +692,8 @@ mx_status_t minfs_check(mxtl::unique_ptr<Bcache> bc) {
 
     // Save an error if it occurs, but check for subsequent errors
     // anyway.
+    r = chk.DrainWorkers();
+    status |= (status != NO_ERROR) ? 0 : r;
     r = chk.CheckForUnusedBlocks();
     status |= (status != NO_ERROR) ? 0 : r;
     r = chk.CheckForUnusedInodes();
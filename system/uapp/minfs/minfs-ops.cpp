@@ -17,6 +17,7 @@
 #ifdef __Fuchsia__
 #include <magenta/syscalls.h>
 #include <mxio/vfs.h>
+#include <mxtl/auto_lock.h>
 #endif
 
 #include "minfs-private.h"
@@ -81,9 +82,8 @@ void VnodeMinfs::InodeSync(WriteTxn* txn, uint32_t flags) {
 // the file. Does not update mtime/atime.
 mx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, uint32_t start) {
 #ifdef __Fuchsia__
-    auto bbm_id = fs_->block_map_vmoid_;
-#else
-    auto bbm_id = fs_->block_map_.StorageUnsafe()->GetData();
+    // Clears bits in the shared block bitmap.
+    mxtl::AutoLock lock(&fs_->lock_);
 #endif
 
     bool doSync = false;
@@ -95,9 +95,7 @@ mx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, uint32_t start) {
         }
         fs_->ValidateBno(inode_.dnum[bno]);
 
-        fs_->block_map_.Clear(inode_.dnum[bno], inode_.dnum[bno] + 1);
-        uint32_t bitblock = inode_.dnum[bno] / kMinfsBlockBits;
-        txn->Enqueue(bbm_id, bitblock, fs_->info_.abm_block + bitblock, 1);
+        fs_->BlockFree(txn, inode_.dnum[bno]);
         inode_.dnum[bno] = 0;
         inode_.block_count--;
         doSync = true;
@@ -141,9 +139,7 @@ mx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, uint32_t start) {
                 continue;
             }
 
-            fs_->block_map_.Clear(entry[direct], entry[direct] + 1);
-            uint32_t bitblock = entry[direct] / kMinfsBlockBits;
-            txn->Enqueue(bbm_id, bitblock, fs_->info_.abm_block + bitblock, 1);
+            fs_->BlockFree(txn, entry[direct]);
             entry[direct] = 0;
             dirty = true;
             inode_.block_count--;
@@ -152,7 +148,16 @@ mx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, uint32_t start) {
         if (dirty) {
             doSync = true;
 #ifdef __Fuchsia__
-            txn->Enqueue(vmoid_indirect_, indirect, inode_.inum[indirect], 1);
+            // If a snapshot froze the indirect block, rewrite it elsewhere
+            // rather than in place; its full contents are resident in
+            // vmo_indirect_.
+            uint32_t ibno = inode_.inum[indirect];
+            mx_status_t status;
+            if ((status = fs_->BlockCowLocked(txn, &ibno)) != NO_ERROR) {
+                return status;
+            }
+            inode_.inum[indirect] = ibno;
+            txn->Enqueue(vmoid_indirect_, indirect, ibno, 1);
 #else
             fs_->bc_->Writeblk(inode_.inum[indirect], entry);
 #endif
@@ -160,9 +165,7 @@ mx_status_t VnodeMinfs::BlocksShrink(WriteTxn *txn, uint32_t start) {
 
         if (delete_indirect)  {
             // release the direct block itself
-            fs_->block_map_.Clear(inode_.inum[indirect], inode_.inum[indirect] + 1);
-            uint32_t bitblock = inode_.inum[indirect] / kMinfsBlockBits;
-            txn->Enqueue(bbm_id, bitblock, fs_->info_.abm_block + bitblock, 1);
+            fs_->BlockFree(txn, inode_.inum[indirect]);
             inode_.inum[indirect] = 0;
             inode_.block_count--;
             doSync = true;
@@ -205,12 +208,11 @@ mx_status_t VnodeMinfs::InitIndirectVmo() {
 }
 
 // Since we cannot yet register the filesystem as a paging service (and cleanly
-// fault on pages when they are actually needed), we currently read an entire
-// file to a VMO when a file's data block are accessed.
-//
-// TODO(smklein): Even this hack can be optimized; a bitmap could be used to
-// track all 'empty/read/dirty' blocks for each vnode, rather than reading
-// the entire file.
+// fault on pages when they are actually needed), vmo_ caches the file
+// contents, populated from the block cache one block range at a time (see
+// InitVmoRange) as the file is actually accessed.  InitVmo itself only
+// creates the (fully uncommitted) vmo, so opening a large file costs no
+// I/O or memory up front.
 mx_status_t VnodeMinfs::InitVmo() {
     if (vmo_.is_valid()) {
         return NO_ERROR;
@@ -223,49 +225,54 @@ mx_status_t VnodeMinfs::InitVmo() {
         return status;
     }
 
-    if ((status = fs_->bc_->AttachVmo(vmo_.get(), &vmoid_)) != NO_ERROR) {
+    // Size the validity bitmap for the largest representable file, so it
+    // never needs to be reallocated (and cleared) when the file grows.
+    if ((status = vmo_valid_.Reset(kMinfsMaxFileBlock)) != NO_ERROR) {
         vmo_.reset();
         return status;
     }
-    ReadTxn txn(fs_->bc_.get());
 
-    // Initialize all direct blocks
-    uint32_t bno;
-    for (uint32_t d = 0; d < kMinfsDirect; d++) {
-        if ((bno = inode_.dnum[d]) != 0) {
-            fs_->ValidateBno(bno);
-            txn.Enqueue(vmoid_, d, bno, 1);
-        }
+    if ((status = fs_->bc_->AttachVmo(vmo_.get(), &vmoid_)) != NO_ERROR) {
+        vmo_.reset();
+        return status;
     }
+    return NO_ERROR;
+}
 
-    // Initialize all indirect blocks
-    for (uint32_t i = 0; i < kMinfsIndirect; i++) {
-        uint32_t ibno;
-        if ((ibno = inode_.inum[i]) != 0) {
-            fs_->ValidateBno(ibno);
-
-            // Only initialize the indirect vmo if it is being used.
-            if ((status = InitIndirectVmo()) != NO_ERROR) {
-                vmo_.reset();
-                return status;
-            }
-
-            MX_DEBUG_ASSERT(vmo_indirect_ != nullptr);
-            uintptr_t iaddr = reinterpret_cast<uintptr_t>(vmo_indirect_->GetData());
-            uint32_t* ientry = reinterpret_cast<uint32_t*>(iaddr + kMinfsBlockSize * i);
+mx_status_t VnodeMinfs::InitVmoRange(uint32_t n, uint32_t count) {
+    uint32_t nmax = n + count;
+    if (nmax > kMinfsMaxFileBlock) {
+        nmax = static_cast<uint32_t>(kMinfsMaxFileBlock);
+    }
+    if ((n >= nmax) || vmo_valid_.Get(n, nmax)) {
+        return NO_ERROR;
+    }
 
-            constexpr uint32_t direct_per_indirect = kMinfsBlockSize / sizeof(uint32_t);
-            for (uint32_t j = 0; j < direct_per_indirect; j++) {
-                if ((bno = ientry[j]) != 0) {
-                    fs_->ValidateBno(bno);
-                    uint32_t n = kMinfsDirect + i * direct_per_indirect + j;
-                    txn.Enqueue(vmoid_, n, bno, 1);
-                }
-            }
+    mx_status_t status;
+    const uint32_t start = n;
+    ReadTxn txn(fs_->bc_.get());
+    for (; n < nmax; n++) {
+        if (vmo_valid_.Get(n, n + 1)) {
+            continue;
+        }
+        uint32_t bno;
+        if ((status = GetBno(nullptr, n, &bno)) != NO_ERROR) {
+            vmo_valid_.Clear(start, nmax);
+            return status;
+        }
+        if (bno != 0) {
+            fs_->ValidateBno(bno);
+            txn.Enqueue(vmoid_, n, bno, 1);
         }
+        // An unallocated block reads as zeroes, which is exactly what the
+        // untouched vmo contains; either way the block is now valid.
+        vmo_valid_.Set(n, n + 1);
     }
-
-    return txn.Flush();
+    if ((status = txn.Flush()) != NO_ERROR) {
+        vmo_valid_.Clear(start, nmax);
+        return status;
+    }
+    return NO_ERROR;
 }
 #endif
 
@@ -282,6 +289,18 @@ mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
             inode_.dnum[n] = *bno;
             inode_.block_count++;
         }
+#ifdef __Fuchsia__
+        else if ((txn != nullptr) && (*bno != 0)) {
+            // The caller is about to rewrite this block; if a snapshot froze
+            // it, redirect the write to a fresh block (copy-on-first-write).
+            // The caller writes the full block, so no data copy is needed.
+            mx_status_t status = fs_->BlockCow(txn, bno);
+            if (status != NO_ERROR) {
+                return status;
+            }
+            inode_.dnum[n] = *bno;
+        }
+#endif
         fs_->ValidateBno(*bno);
         return NO_ERROR;
     }
@@ -354,10 +373,30 @@ mx_status_t VnodeMinfs::GetBno(WriteTxn* txn, uint32_t n, uint32_t* bno) {
         ientry[j] = *bno;
         dirty = true;
     }
+#ifdef __Fuchsia__
+    else if ((txn != nullptr) && (*bno != 0)) {
+        // Copy-on-first-write: a snapshot-frozen data block is replaced
+        // rather than rewritten in place.
+        uint32_t obno = *bno;
+        if ((status = fs_->BlockCow(txn, bno)) != NO_ERROR) {
+            return status;
+        }
+        if (*bno != obno) {
+            ientry[j] = *bno;
+            dirty = true;
+        }
+    }
+#endif
 
     if (dirty) {
         // Write back the indirect block if requested
 #ifdef __Fuchsia__
+        // The indirect block gets the same copy-on-first-write treatment as
+        // the data blocks; its full contents are resident in vmo_indirect_.
+        if ((status = fs_->BlockCow(txn, &ibno)) != NO_ERROR) {
+            return status;
+        }
+        inode_.inum[i] = ibno;
         txn->Enqueue(vmoid_indirect_, i, ibno, 1);
 #else
         fs_->bc_->Writeblk(ibno, ientry);
@@ -506,9 +545,17 @@ mx_status_t VnodeMinfs::UnlinkChild(WriteTxn* txn,
         return status;
     }
 
-    if (de->reclen & kMinfsReclenLast) {
+    if (DirIndexActive()) {
+        // The name bytes beyond the written header are still in 'de'.
+        if (DirIndexErase(txn, de->name, de->namelen, offs->off) != NO_ERROR) {
+            DirIndexDisable(txn);
+        } else if (off < dir_index_.free_hint) {
+            dir_index_.free_hint = static_cast<uint32_t>(off);
+        }
+    } else if (de->reclen & kMinfsReclenLast) {
         // Truncating the directory merely removed unused space; if it fails,
-        // the directory contents are still valid.
+        // the directory contents are still valid. (With an index present the
+        // tail must stay put -- the index lives past the dirent region.)
         TruncateInternal(txn, off + MINFS_DIRENT_SIZE);
     }
 
@@ -653,6 +700,21 @@ static mx_status_t add_dirent(mxtl::RefPtr<VnodeMinfs> vndir,
     if (status != NO_ERROR) {
         return status;
     }
+    if (vndir->DirIndexActive()) {
+        if (vndir->DirIndexInsert(args->txn, args->name, args->len, off) != NO_ERROR) {
+            vndir->DirIndexDisable(args->txn);
+        } else {
+            // The scan that got us here started at the old hint and consumed
+            // this record entirely, so the next free space is the first free
+            // record it skipped -- or, failing that, whatever follows this
+            // entry (the last record can always be subdivided, so it counts).
+            size_t hint = args->free_off;
+            if (hint == 0) {
+                hint = (de->reclen & kMinfsReclenLast) ? off : off + MinfsReclen(de, off);
+            }
+            vndir->dir_index_.free_hint = static_cast<uint32_t>(hint);
+        }
+    }
     vndir->inode_.dirent_count++;
     if (args->type == kMinfsTypeDir) {
         // Child directory has '..' which will point to parent directory
@@ -667,6 +729,10 @@ static mx_status_t cb_dir_append(mxtl::RefPtr<VnodeMinfs> vndir, minfs_dirent_t*
     if (de->ino == 0) {
         // empty entry, do we fit?
         if (args->reclen > reclen) {
+            if (args->free_off == 0) {
+                // too small for us, but remember it for the free-space hint
+                args->free_off = offs->off;
+            }
             return do_next_dirent(de, offs);
         }
         return add_dirent(mxtl::move(vndir), de, args, offs->off);
@@ -715,8 +781,8 @@ mx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     char data[kMinfsMaxDirentSize];
     minfs_dirent_t* de = (minfs_dirent_t*) data;
     DirectoryOffset offs = {
-        .off = 0,
-        .off_prev = 0,
+        .off = args->start,
+        .off_prev = args->start,
     };
     while (offs.off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
         FS_TRACE(MINFS, "Reading dirent at offset %zd\n", offs.off);
@@ -732,6 +798,9 @@ mx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
         case DIR_CB_NEXT:
             break;
         case DIR_CB_SAVE_SYNC:
+            if (DirIndexActive()) {
+                DirIndexSync(args->txn);
+            }
             inode_.seq_num++;
             InodeSync(args->txn, kMxFsSyncMtime);
             return NO_ERROR;
@@ -743,6 +812,271 @@ mx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     return ERR_NOT_FOUND;
 }
 
+// Hashed directory index (see minfs.h for the on-disk layout).
+//
+// All index paths are best-effort: any failure leaves the dirent stream
+// intact, and callers react by disabling the index or falling back to a
+// linear scan.
+
+namespace {
+
+uint32_t dir_index_hash(const char* name, size_t len) {
+    return fnv1a32(name, len);
+}
+
+// Directory offset of the nth index slot.
+size_t dir_index_slot_off(size_t n) {
+    return kMinfsDirIndexOffset + sizeof(minfs_dir_index_t) + n * sizeof(uint32_t);
+}
+
+} // namespace
+
+mx_status_t VnodeMinfs::DirIndexLoad() {
+    if (dir_index_loaded_) {
+        return NO_ERROR;
+    }
+    mx_status_t status;
+    if ((status = ReadExactInternal(&dir_index_, sizeof(dir_index_),
+                                    kMinfsDirIndexOffset)) != NO_ERROR) {
+        return status;
+    }
+    if ((dir_index_.magic != kMinfsDirIndexMagic) ||
+        (dir_index_.version != kMinfsDirIndexVersion) ||
+        (dir_index_.seq_num != inode_.seq_num) ||
+        (dir_index_.entries != inode_.dirent_count) ||
+        (dir_index_.tombstones > kMinfsDirIndexSlots) ||
+        (dir_index_.free_hint > kMinfsMaxDirectorySize) ||
+        (dir_index_.free_hint & 3) ||
+        (inode_.size < kMinfsDirIndexEnd)) {
+        // Stale (the directory was modified by a driver without index
+        // support) or corrupt; either way, unusable.
+        return ERR_BAD_STATE;
+    }
+    dir_index_loaded_ = true;
+    return NO_ERROR;
+}
+
+mx_status_t VnodeMinfs::DirIndexLookup(const char* name, size_t len,
+                                       uint32_t* ino, size_t* off) {
+    mx_status_t status;
+    if ((status = DirIndexLoad()) != NO_ERROR) {
+        return status;
+    }
+    uint32_t hash = dir_index_hash(name, len);
+    for (uint32_t i = 0; i < kMinfsDirIndexSlots; i++) {
+        size_t n = (hash + i) & (kMinfsDirIndexSlots - 1);
+        uint32_t slot;
+        if ((status = ReadExactInternal(&slot, sizeof(slot),
+                                        dir_index_slot_off(n))) != NO_ERROR) {
+            return status;
+        }
+        if (slot == kMinfsDirIndexSlotFree) {
+            return ERR_NOT_FOUND;
+        }
+        if ((slot == kMinfsDirIndexSlotDead) ||
+            ((slot >> 19) != (hash >> 19))) {
+            continue;
+        }
+        // Fingerprint match; confirm against the dirent itself.
+        size_t de_off = DirIndexSlotOffset(slot);
+        char data[kMinfsMaxDirentSize];
+        minfs_dirent_t* de = (minfs_dirent_t*) data;
+        size_t actual;
+        if ((status = ReadInternal(data, kMinfsMaxDirentSize, de_off, &actual)) != NO_ERROR) {
+            return status;
+        }
+        if ((validate_dirent(de, actual, de_off) != NO_ERROR) || (de->ino == 0)) {
+            // The slot points at garbage; force a fallback.
+            return ERR_BAD_STATE;
+        }
+        if ((de->namelen == len) && (!memcmp(de->name, name, len))) {
+            if (ino != nullptr) {
+                *ino = de->ino;
+            }
+            if (off != nullptr) {
+                *off = de_off;
+            }
+            return NO_ERROR;
+        }
+        // Full fingerprint collision with a different name; keep probing.
+    }
+    return ERR_BAD_STATE;
+}
+
+mx_status_t VnodeMinfs::DirIndexInsert(WriteTxn* txn, const char* name,
+                                       size_t len, size_t off) {
+    mx_status_t status;
+    if ((status = DirIndexLoad()) != NO_ERROR) {
+        return status;
+    }
+    if (dir_index_.entries + dir_index_.tombstones >= kMinfsDirIndexSlots / 2) {
+        // Tombstones have degraded the table; rebuild it. The new entry is
+        // already in the dirent stream, so the rebuild picks it up.
+        return DirIndexBuild(txn);
+    }
+    uint32_t hash = dir_index_hash(name, len);
+    for (uint32_t i = 0; i < kMinfsDirIndexSlots; i++) {
+        size_t n = (hash + i) & (kMinfsDirIndexSlots - 1);
+        uint32_t slot;
+        if ((status = ReadExactInternal(&slot, sizeof(slot),
+                                        dir_index_slot_off(n))) != NO_ERROR) {
+            return status;
+        }
+        if ((slot != kMinfsDirIndexSlotFree) && (slot != kMinfsDirIndexSlotDead)) {
+            continue;
+        }
+        uint32_t enc = DirIndexSlot(hash, off);
+        if ((status = WriteExactInternal(txn, &enc, sizeof(enc),
+                                         dir_index_slot_off(n))) != NO_ERROR) {
+            return status;
+        }
+        if (slot == kMinfsDirIndexSlotDead) {
+            dir_index_.tombstones--;
+        }
+        dir_index_.entries++;
+        return NO_ERROR;
+    }
+    return ERR_BAD_STATE;
+}
+
+mx_status_t VnodeMinfs::DirIndexErase(WriteTxn* txn, const char* name,
+                                      size_t len, size_t off) {
+    mx_status_t status;
+    if ((status = DirIndexLoad()) != NO_ERROR) {
+        return status;
+    }
+    uint32_t hash = dir_index_hash(name, len);
+    uint32_t want = DirIndexSlot(hash, off);
+    for (uint32_t i = 0; i < kMinfsDirIndexSlots; i++) {
+        size_t n = (hash + i) & (kMinfsDirIndexSlots - 1);
+        uint32_t slot;
+        if ((status = ReadExactInternal(&slot, sizeof(slot),
+                                        dir_index_slot_off(n))) != NO_ERROR) {
+            return status;
+        }
+        if (slot == kMinfsDirIndexSlotFree) {
+            // The entry was never indexed: the index is inconsistent.
+            return ERR_BAD_STATE;
+        }
+        if (slot != want) {
+            continue;
+        }
+        uint32_t enc = kMinfsDirIndexSlotDead;
+        if ((status = WriteExactInternal(txn, &enc, sizeof(enc),
+                                         dir_index_slot_off(n))) != NO_ERROR) {
+            return status;
+        }
+        dir_index_.entries--;
+        dir_index_.tombstones++;
+        return NO_ERROR;
+    }
+    return ERR_BAD_STATE;
+}
+
+mx_status_t VnodeMinfs::DirIndexSync(WriteTxn* txn) {
+    mx_status_t status;
+    if ((status = DirIndexLoad()) != NO_ERROR) {
+        DirIndexDisable(txn);
+        return status;
+    }
+    minfs_dir_index_t hdr = dir_index_;
+    // The enclosing directory operation bumps seq_num right after this.
+    hdr.seq_num = inode_.seq_num + 1;
+    if ((status = WriteExactInternal(txn, &hdr, sizeof(hdr),
+                                     kMinfsDirIndexOffset)) != NO_ERROR) {
+        DirIndexDisable(txn);
+        return status;
+    }
+    dir_index_.seq_num = hdr.seq_num;
+    return NO_ERROR;
+}
+
+void VnodeMinfs::DirIndexDisable(WriteTxn* txn) {
+    if (!DirIndexActive()) {
+        return;
+    }
+    FS_TRACE_WARN("minfs: dropping directory index on ino#%u\n", ino_);
+    inode_.flags &= ~kMinfsInodeDirIndex;
+    dir_index_loaded_ = false;
+    InodeSync(txn, kMxFsSyncDefault);
+}
+
+mx_status_t VnodeMinfs::DirIndexBuild(WriteTxn* txn) {
+    // Stage the whole table in memory, fill it from the dirent stream, and
+    // write it out in one pass.
+    constexpr size_t kIndexSize = kMinfsDirIndexEnd - kMinfsDirIndexOffset;
+    AllocChecker ac;
+    mxtl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[kIndexSize]);
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    memset(buf.get(), 0, kIndexSize);
+    minfs_dir_index_t* hdr = reinterpret_cast<minfs_dir_index_t*>(buf.get());
+    uint32_t* slots = reinterpret_cast<uint32_t*>(buf.get() + sizeof(minfs_dir_index_t));
+
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    size_t off = 0;
+    size_t free_hint = 0; // offset 0 holds '.', so 0 doubles as "unset"
+    uint32_t entries = 0;
+    mx_status_t status;
+    while (off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+        size_t actual;
+        if ((status = ReadInternal(data, kMinfsMaxDirentSize, off, &actual)) != NO_ERROR) {
+            return status;
+        }
+        if ((status = validate_dirent(de, actual, off)) != NO_ERROR) {
+            return status;
+        }
+        if (de->ino != 0) {
+            uint32_t hash = dir_index_hash(de->name, de->namelen);
+            uint32_t i = 0;
+            size_t n;
+            // The table has two slots per minimum-size dirent, so a free
+            // slot always exists.
+            while (slots[n = ((hash + i) & (kMinfsDirIndexSlots - 1))] !=
+                   kMinfsDirIndexSlotFree) {
+                i++;
+            }
+            slots[n] = DirIndexSlot(hash, off);
+            entries++;
+        } else if (free_hint == 0) {
+            free_hint = off;
+        }
+        if (de->reclen & kMinfsReclenLast) {
+            if (free_hint == 0) {
+                // The last record is live, but can still be subdivided.
+                free_hint = off;
+            }
+            break;
+        }
+        off += MinfsReclen(de, off);
+    }
+    // Refuse to index a directory that disagrees with its inode. A rebuild
+    // in the middle of an append sees one dirent the inode has not counted
+    // yet (add_dirent bumps dirent_count after updating the index).
+    if ((entries != inode_.dirent_count) && (entries != inode_.dirent_count + 1)) {
+        return ERR_BAD_STATE;
+    }
+
+    hdr->magic = kMinfsDirIndexMagic;
+    hdr->version = kMinfsDirIndexVersion;
+    hdr->seq_num = inode_.seq_num;
+    hdr->entries = entries;
+    hdr->tombstones = 0;
+    hdr->free_hint = static_cast<uint32_t>(free_hint);
+
+    if ((status = WriteExactInternal(txn, buf.get(), kIndexSize,
+                                     kMinfsDirIndexOffset)) != NO_ERROR) {
+        return status;
+    }
+    inode_.flags |= kMinfsInodeDirIndex;
+    InodeSync(txn, kMxFsSyncDefault);
+    memcpy(&dir_index_, hdr, sizeof(dir_index_));
+    dir_index_loaded_ = true;
+    return NO_ERROR;
+}
+
 VnodeMinfs::~VnodeMinfs() {
     if (inode_.link_count == 0) {
 #ifdef __Fuchsia__
@@ -802,7 +1136,14 @@ mx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
 #ifdef __Fuchsia__
     if ((status = InitVmo()) != NO_ERROR) {
         return status;
-    } else if ((status = vmo_.read(data, off, len, actual)) != NO_ERROR) {
+    }
+    uint32_t n = static_cast<uint32_t>(off / kMinfsBlockSize);
+    uint32_t count = static_cast<uint32_t>((off % kMinfsBlockSize + len +
+                                            kMinfsBlockSize - 1) / kMinfsBlockSize);
+    if ((status = InitVmoRange(n, count)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = vmo_.read(data, off, len, actual)) != NO_ERROR) {
         return status;
     }
 #else
@@ -888,6 +1229,14 @@ mx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
 
 #ifdef __Fuchsia__
         size_t xfer_off = n * kMinfsBlockSize + adjust;
+        // A partial block write flushes the whole block from the vmo to
+        // disk, so the bytes around the write must be resident first.
+        if (((adjust != 0) || (xfer < kMinfsBlockSize)) &&
+            ((uint64_t)n * kMinfsBlockSize < inode_.size)) {
+            if ((status = InitVmoRange(n, 1)) != NO_ERROR) {
+                goto done;
+            }
+        }
         if ((xfer_off + xfer) > inode_.size) {
             size_t new_size = xfer_off + xfer;
             if ((status = vmo_.set_size(mxtl::roundup(new_size, kMinfsBlockSize))) != NO_ERROR) {
@@ -908,6 +1257,7 @@ mx_status_t VnodeMinfs::WriteInternal(WriteTxn* txn, const void* data,
         }
         assert(bno != 0);
         txn->Enqueue(vmoid_, n, bno, 1);
+        vmo_valid_.Set(n, n + 1);
 #else
         uint32_t bno;
         if ((status = GetBno(txn, n, &bno)) != NO_ERROR) {
@@ -949,6 +1299,54 @@ done:
     return NO_ERROR;
 }
 
+#ifdef __Fuchsia__
+mx_status_t VnodeMinfs::Mmap(int flags, size_t len, size_t* off, mx_handle_t* out) {
+    FS_TRACE(MINFS, "minfs_mmap() vn=%p(#%u) flags=%d len=%zd\n", this, ino_, flags, len);
+    if (IsDirectory()) {
+        return ERR_ACCESS_DENIED;
+    }
+    if (flags & MXIO_MMAP_FLAG_WRITE) {
+        // Updates through a shared writable mapping could not be kept
+        // coherent with the backing store, so only read mappings are
+        // supported.
+        return ERR_ACCESS_DENIED;
+    }
+
+    mx_status_t status;
+    if ((status = InitVmo()) != NO_ERROR) {
+        return status;
+    }
+    // A clone of a partially resident vmo would read zeroes for the missing
+    // blocks, so the whole file must be brought in before handing one out.
+    // The cost is paid at most once per vnode: later mappings (and reads)
+    // are served from the already-resident pages.
+    uint32_t count = static_cast<uint32_t>((inode_.size + kMinfsBlockSize - 1)
+                                           / kMinfsBlockSize);
+    if ((status = InitVmoRange(0, count)) != NO_ERROR) {
+        return status;
+    }
+
+    mx_rights_t rights = MX_RIGHT_TRANSFER | MX_RIGHT_MAP |
+                         MX_RIGHT_DUPLICATE | MX_RIGHT_GET_PROPERTY;
+    rights |= (flags & MXIO_MMAP_FLAG_READ) ? MX_RIGHT_READ : 0;
+    rights |= (flags & MXIO_MMAP_FLAG_EXEC) ? MX_RIGHT_EXECUTE : 0;
+
+    // Return a copy-on-write clone of the cached vmo, so the mapping is a
+    // snapshot of the file: later writes to the file do not alter the
+    // mapping, and the mapping cannot alter the file.
+    mx::vmo clone;
+    if ((status = vmo_.clone(MX_VMO_CLONE_COPY_ON_WRITE, 0, inode_.size,
+                             &clone)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = mx_handle_replace(clone.release(), rights, out)) != NO_ERROR) {
+        return status;
+    }
+    *off = 0;
+    return NO_ERROR;
+}
+#endif
+
 mx_status_t VnodeMinfs::Lookup(mxtl::RefPtr<fs::Vnode>* out, const char* name, size_t len) {
     FS_TRACE(MINFS, "minfs_lookup() vn=%p(#%u) name='%.*s'\n", this, ino_, (int)len, name);
     assert(len <= kMinfsMaxNameSize);
@@ -974,9 +1372,18 @@ mx_status_t VnodeMinfs::LookupInternal(mxtl::RefPtr<fs::Vnode>* out,
     DirArgs args = DirArgs();
     args.name = name;
     args.len = len;
-    mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
-        return status;
+    mx_status_t status = ERR_BAD_STATE;
+    if (DirIndexActive()) {
+        status = DirIndexLookup(name, len, &args.ino, nullptr);
+        if (status == ERR_NOT_FOUND) {
+            return ERR_NOT_FOUND;
+        }
+    }
+    if (status != NO_ERROR) {
+        // No index, or one we cannot use: scan the dirents.
+        if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
+            return status;
+        }
     }
     mxtl::RefPtr<VnodeMinfs> vn;
     if ((status = fs_->VnodeGet(&vn, args.ino)) < 0) {
@@ -1097,9 +1504,9 @@ fail:
 
 #ifdef __Fuchsia__
 VnodeMinfs::VnodeMinfs(Minfs* fs) :
-    fs_(fs), vmo_(MX_HANDLE_INVALID), vmo_indirect_(nullptr) {}
+    fs_(fs), dir_index_loaded_(false), vmo_(MX_HANDLE_INVALID), vmo_indirect_(nullptr) {}
 #else
-VnodeMinfs::VnodeMinfs(Minfs* fs) : fs_(fs) {}
+VnodeMinfs::VnodeMinfs(Minfs* fs) : fs_(fs), dir_index_loaded_(false) {}
 #endif
 
 bool VnodeMinfs::IsRemote() const { return remoter_.IsRemote(); }
@@ -1145,9 +1552,18 @@ mx_status_t VnodeMinfs::Create(mxtl::RefPtr<fs::Vnode>* out, const char* name, s
     args.name = name;
     args.len = len;
     // ensure file does not exist
-    mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) != ERR_NOT_FOUND) {
-        return ERR_ALREADY_EXISTS;
+    mx_status_t status = ERR_BAD_STATE;
+    if (DirIndexActive()) {
+        status = DirIndexLookup(name, len, nullptr, nullptr);
+        if (status == NO_ERROR) {
+            return ERR_ALREADY_EXISTS;
+        }
+    }
+    if (status != ERR_NOT_FOUND) {
+        // No index, or one we cannot use: scan the dirents.
+        if ((status = ForEachDirent(&args, cb_dir_find)) != ERR_NOT_FOUND) {
+            return ERR_ALREADY_EXISTS;
+        }
     }
 
     // creating a directory?
@@ -1177,10 +1593,19 @@ mx_status_t VnodeMinfs::Create(mxtl::RefPtr<fs::Vnode>* out, const char* name, s
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(len)));
     args.txn = &txn;
+    if (DirIndexActive() && (DirIndexLoad() == NO_ERROR)) {
+        // No free dirent space exists before the hint; skip straight to it.
+        args.start = dir_index_.free_hint;
+    }
     if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
         return status;
     }
 
+    // Index the directory once it is large enough for linear scans to hurt.
+    if (!DirIndexActive() && (inode_.dirent_count >= kMinfsDirIndexMinEntries)) {
+        DirIndexBuild(&txn); // best effort; lookups stay linear on failure
+    }
+
     *out = mxtl::move(vn);
     return NO_ERROR;
 }
@@ -1197,11 +1622,42 @@ ssize_t VnodeMinfs::Ioctl(uint32_t op, const void* in_buf, size_t in_len, void*
             strcpy(static_cast<char*>(out_buf), kFsName);
             return strlen(kFsName);
         }
+#ifdef __Fuchsia__
+        case IOCTL_VFS_SNAPSHOT_CREATE: {
+            if (out_len < sizeof(mx_handle_t)) {
+                return ERR_INVALID_ARGS;
+            }
+            mx::vmo vmo;
+            mx_status_t status = fs_->SnapshotCreate(&vmo);
+            if (status != NO_ERROR) {
+                return status;
+            }
+            *(reinterpret_cast<mx_handle_t*>(out_buf)) = vmo.release();
+            return sizeof(mx_handle_t);
+        }
+        case IOCTL_VFS_SNAPSHOT_RELEASE: {
+            return fs_->SnapshotRelease();
+        }
+#endif
         case IOCTL_VFS_UNMOUNT_FS: {
+#ifdef __Fuchsia__
+            // Abandoning a snapshot at unmount would leak its pinned blocks
+            // in the on-disk bitmap.
+            if (fs_->SnapshotActive()) {
+                fs_->SnapshotRelease();
+            }
+#endif
             mx_status_t status = Sync();
             if (status != NO_ERROR) {
                 FS_TRACE_ERROR("minfs unmount failed to sync; unmounting anyway: %d\n", status);
             }
+#ifdef __Fuchsia__
+            if (minfs_retain_hook != nullptr) {
+                // Resident service mode: park the filesystem for reuse on a
+                // later remount of the same device.
+                return minfs_retain_hook(fs_, mxtl::RefPtr<VnodeMinfs>(this));
+            }
+#endif
             // 'fs_' is deleted after Unmount is called.
             return fs_->Unmount();
         }
@@ -1230,6 +1686,44 @@ mx_status_t VnodeMinfs::Unlink(const char* name, size_t len, bool must_be_dir) {
     args.len = len;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
     args.txn = &txn;
+    if (DirIndexActive()) {
+        size_t off;
+        mx_status_t status = DirIndexLookup(name, len, nullptr, &off);
+        if (status == ERR_NOT_FOUND) {
+            return ERR_NOT_FOUND;
+        }
+        if (status == NO_ERROR) {
+            char data[kMinfsMaxDirentSize];
+            minfs_dirent_t* de = (minfs_dirent_t*) data;
+            size_t actual;
+            if ((ReadInternal(data, kMinfsMaxDirentSize, off, &actual) == NO_ERROR) &&
+                (validate_dirent(de, actual, off) == NO_ERROR)) {
+                // Feed the located dirent straight to the unlink callback.
+                // The previous record is unknown, so UnlinkChild skips
+                // merging backwards; that only costs a little free-space
+                // fragmentation, which a later rebuild cleans up.
+                DirectoryOffset offs = {
+                    .off = off,
+                    .off_prev = off,
+                };
+                status = cb_dir_unlink(mxtl::RefPtr<VnodeMinfs>(this), de, &args, &offs);
+                if (status == DIR_CB_SAVE_SYNC) {
+                    if (DirIndexActive()) {
+                        DirIndexSync(&txn);
+                    }
+                    inode_.seq_num++;
+                    InodeSync(&txn, kMxFsSyncMtime);
+                    return NO_ERROR;
+                }
+                if (status != DIR_CB_NEXT) {
+                    // A real failure: wrong type, non-empty directory, I/O error.
+                    return status;
+                }
+                // DIR_CB_NEXT: the index pointed at the wrong entry; rescan.
+            }
+        }
+        // Index unusable; fall back to the linear scan.
+    }
     return ForEachDirent(&args, cb_dir_unlink);
 }
 
@@ -1250,8 +1744,6 @@ mx_status_t VnodeMinfs::Truncate(size_t len) {
 mx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
     mx_status_t r = 0;
 #ifdef __Fuchsia__
-    // TODO(smklein): We should only init up to 'len'; no need
-    // to read in the portion of a large file we plan on deleting.
     if (InitVmo() != NO_ERROR) {
         return ERR_IO;
     }
@@ -1285,6 +1777,10 @@ mx_status_t VnodeMinfs::TruncateInternal(WriteTxn* txn, size_t len) {
             if (bno != 0) {
                 size_t adjust = len % kMinfsBlockSize;
 #ifdef __Fuchsia__
+                if ((r = InitVmoRange(static_cast<uint32_t>(len / kMinfsBlockSize),
+                                      1)) != NO_ERROR) {
+                    return ERR_IO;
+                }
                 if ((r = VmoReadExact(bdata, len - adjust, adjust)) != NO_ERROR) {
                     return ERR_IO;
                 }
@@ -1471,6 +1967,10 @@ mx_status_t VnodeMinfs::Link(const char* name, size_t len, mxtl::RefPtr<fs::Vnod
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(len)));
     args.txn = &txn;
+    if (DirIndexActive() && (DirIndexLoad() == NO_ERROR)) {
+        // No free dirent space exists before the hint; skip straight to it.
+        args.start = dir_index_.free_hint;
+    }
     if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
         return status;
     }
@@ -1483,6 +1983,13 @@ mx_status_t VnodeMinfs::Link(const char* name, size_t len, mxtl::RefPtr<fs::Vnod
 }
 
 mx_status_t VnodeMinfs::Sync() {
+#ifdef __Fuchsia__
+    // Push group-committed metadata to its home locations first.
+    mx_status_t status = fs_->journal_->Flush();
+    if (status != NO_ERROR) {
+        return status;
+    }
+#endif
     return fs_->bc_->Sync();
 }
 
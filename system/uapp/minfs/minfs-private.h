@@ -70,6 +70,36 @@ public:
     // Allocate a new data block.
     mx_status_t BlockNew(WriteTxn* txn, uint32_t hint, uint32_t* out_bno);
 
+    // Free data block 'bno', enqueueing the dirtied bitmap block. While an
+    // active snapshot references 'bno' the free is deferred -- the bit stays
+    // set so the block cannot be reallocated and the snapshot keeps reading
+    // stable contents -- until SnapshotRelease(). Callers hold lock_.
+    void BlockFree(WriteTxn* txn, uint32_t bno);
+
+#ifdef __Fuchsia__
+    bool SnapshotActive() const { return snapshot_active_; }
+
+    // Create a copy-on-write snapshot. 'out' receives a vmo holding a
+    // verbatim image of the metadata region (blocks [0, dat_block)) copied
+    // from the in-memory superblock, bitmaps and inode table; data region
+    // blocks referenced by the snapshot are frozen on the device until
+    // SnapshotRelease(). Reading the vmo followed by the device's data
+    // region therefore yields a crash-consistent filesystem image, with no
+    // I/O spent on unchanged data.
+    mx_status_t SnapshotCreate(mx::vmo* out);
+
+    // Release the active snapshot, applying the frees it deferred.
+    mx_status_t SnapshotRelease();
+
+    // If an active snapshot references '*bno', allocate a replacement block
+    // and defer-free the original (copy-on-first-write). '*bno' is updated
+    // in place; the caller must then rewrite the full block contents at the
+    // new location and update the pointer that referenced the old one.
+    mx_status_t BlockCow(WriteTxn* txn, uint32_t* bno);
+    // As BlockCow, for callers already holding lock_.
+    mx_status_t BlockCowLocked(WriteTxn* txn, uint32_t* bno);
+#endif
+
     // free ino in inode bitmap, release all blocks held by inode
     mx_status_t InoFree(
 #ifdef __Fuchsia__
@@ -92,7 +122,19 @@ public:
         MX_DEBUG_ASSERT(bno < info_.block_count);
     }
 
+#ifdef __Fuchsia__
+    // Serializes access to the allocation bitmaps and the vnode hash, which
+    // are shared by all connections; individual vnodes are serialized by
+    // their connection locks (see vfs_handler).
+    mtx_t lock_ = MTX_INIT;
+#endif
+
     mxtl::unique_ptr<Bcache> bc_;
+#ifdef __Fuchsia__
+    // Journal for metadata writes; declared after bc_ so its teardown
+    // flush happens while the bcache is still alive.
+    mxtl::unique_ptr<Journal> journal_;
+#endif
     RawBitmap block_map_;
 #ifdef __Fuchsia__
     vmoid_t block_map_vmoid_;
@@ -105,6 +147,19 @@ private:
     Minfs(mxtl::unique_ptr<Bcache> bc_, const minfs_info_t* info_);
     // Find a free inode, allocate it in the inode bitmap, and write it back to disk
     mx_status_t InoNew(WriteTxn* txn, const minfs_inode_t* inode, uint32_t* ino_out);
+    // BlockNew with lock_ already held.
+    mx_status_t BlockNewLocked(WriteTxn* txn, uint32_t hint, uint32_t* out_bno);
+
+#ifdef __Fuchsia__
+    // Copy-on-write snapshot state, protected by lock_. snapshot_map_
+    // freezes the block bitmap as of SnapshotCreate(): a set bit means the
+    // snapshot references the block, so it may be neither rewritten in place
+    // nor reallocated. snapshot_freed_ collects blocks the live filesystem
+    // freed while frozen; their bitmap bits are cleared on release.
+    bool snapshot_active_ = false;
+    RawBitmap snapshot_map_;
+    RawBitmap snapshot_freed_;
+#endif
 
 #ifdef __Fuchsia__
     mxtl::unique_ptr<fs::Dispatcher> dispatcher_;
@@ -130,6 +185,8 @@ struct DirArgs {
     uint32_t type;
     uint32_t reclen;
     WriteTxn* txn;
+    size_t start;    // Offset in directory at which the scan begins
+    size_t free_off; // First free record skipped by an append scan (0 if none)
 };
 
 struct DirectoryOffset {
@@ -173,6 +230,28 @@ public:
     mx_status_t WriteExactInternal(WriteTxn* txn, const void* data, size_t len,
                                    size_t off);
     mx_status_t TruncateInternal(WriteTxn* txn, size_t len);
+
+    // Hashed directory index (directories only; see minfs.h for the layout).
+    // The index accelerates lookup, but the dirent stream stays authoritative;
+    // whenever the index is unusable (not present, stale, corrupt), callers
+    // fall back to the linear scan.
+    bool DirIndexActive() const { return (inode_.flags & kMinfsInodeDirIndex) != 0; }
+    // Reads and validates the index header; ERR_BAD_STATE if it is stale or corrupt.
+    mx_status_t DirIndexLoad();
+    // Finds 'name' via the index. ERR_NOT_FOUND is authoritative; 'off' is the
+    // dirent's offset in the directory, and either out may be null.
+    mx_status_t DirIndexLookup(const char* name, size_t len, uint32_t* ino, size_t* off);
+    mx_status_t DirIndexInsert(WriteTxn* txn, const char* name, size_t len, size_t off);
+    mx_status_t DirIndexErase(WriteTxn* txn, const char* name, size_t len, size_t off);
+    // (Re)builds the index from the dirent stream and sets kMinfsInodeDirIndex.
+    mx_status_t DirIndexBuild(WriteTxn* txn);
+    // Writes the index header back, recording inode_.seq_num + 1: the header
+    // is synced from within a directory operation, just before ForEachDirent
+    // (or an equivalent caller) bumps the sequence number.
+    mx_status_t DirIndexSync(WriteTxn* txn);
+    // Drops the index; linear scans resume (the blocks are reclaimed when the
+    // directory itself is deleted).
+    void DirIndexDisable(WriteTxn* txn);
     ssize_t Ioctl(uint32_t op, const void* in_buf, size_t in_len, void* out_buf,
                   size_t out_len) final;
     mx_status_t Lookup(mxtl::RefPtr<fs::Vnode>* out, const char* name, size_t len) final;
@@ -182,6 +261,11 @@ public:
     Minfs* fs_;
     uint32_t ino_;
     minfs_inode_t inode_;
+    // Cached directory index header; only meaningful when dir_index_loaded_.
+    // The vnode is the sole writer of its directory, so once loaded the cache
+    // stays current until the index is disabled.
+    minfs_dir_index_t dir_index_;
+    bool dir_index_loaded_;
 
     ~VnodeMinfs();
 
@@ -210,8 +294,14 @@ private:
     mx_status_t AttachRemote(mx_handle_t) final;
 
 #ifdef __Fuchsia__
+    mx_status_t Mmap(int flags, size_t len, size_t* off, mx_handle_t* out) final;
+
     mx_status_t InitVmo();
     mx_status_t InitIndirectVmo();
+
+    // Reads the file blocks [n, n + count) into vmo_ from the block cache,
+    // if they are not already resident there.
+    mx_status_t InitVmoRange(uint32_t n, uint32_t count);
 #endif
 
     // Get the disk block 'bno' corresponding to the 'nth' logical block of the file.
@@ -243,9 +333,14 @@ private:
 
     // TODO(smklein): When we have can register MinFS as a pager service, and
     // it can properly handle pages faults on a vnode's contents, then we can
-    // avoid reading the entire file up-front. Until then, read the contents of
-    // a VMO into memory when it is read/written.
+    // avoid reading the file into a VMO at all. Until then, vmo_ caches the
+    // file contents, populated from the block cache one block range at a
+    // time as the file is read, written or mmapped.
     mx::vmo vmo_;
+    // One bit per file block: set when the block's contents in vmo_ match
+    // the logical file contents (read from disk, written through, or known
+    // to be zero).
+    RawBitmap vmo_valid_;
     mxtl::unique_ptr<MappedVmo> vmo_indirect_;
     vmoid_t vmoid_;
     vmoid_t vmoid_indirect_;
@@ -274,8 +369,17 @@ int minfs_mkfs(mxtl::unique_ptr<Bcache> bc);
 class MinfsChecker {
 public:
     MinfsChecker();
+    ~MinfsChecker();
     mx_status_t Init(mxtl::unique_ptr<Bcache> bc, const minfs_info_t* info);
     mx_status_t CheckInode(uint32_t ino, uint32_t parent, bool dot_or_dotdot);
+
+    // Waits for every queued CheckFile() to complete and folds the
+    // workers' block shards into checked_blocks_, reporting blocks
+    // referenced from inodes that landed on different workers. Must be
+    // called after the CheckInode() traversal and before the unused
+    // block/inode passes below. Returns the first error any worker hit.
+    mx_status_t DrainWorkers();
+
     mx_status_t CheckForUnusedBlocks() const;
     mx_status_t CheckForUnusedInodes() const;
     mx_status_t CheckLinkCounts() const;
@@ -287,18 +391,58 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(MinfsChecker);
 
+    // The directory traversal runs on the calling thread, but the heavy
+    // flat work -- walking every block pointer of every inode -- is
+    // queued to a small worker pool. Each worker marks the blocks it
+    // sees in a private bitmap shard, so no locking is needed on the hot
+    // path; DrainWorkers() merges the shards and catches double
+    // references that span shards.
+    static constexpr int kNumCheckWorkers = 4;
+    static constexpr size_t kCheckQueueLimit = 1024;
+
+    struct CheckJob : public mxtl::DoublyLinkedListable<mxtl::unique_ptr<CheckJob>> {
+        minfs_inode_t inode;
+        uint32_t ino;
+    };
+
+    struct CheckWorker {
+        MinfsChecker* chk;
+        thrd_t thread;
+        bool running;
+        RawBitmap shard;
+        bool conforming;
+        mx_status_t status;
+    };
+
+    static int WorkerThread(void* arg);
+    mx_status_t StartWorkers(uint32_t block_count);
+    // Hands a copy of |inode| to the workers; falls back to checking
+    // inline when the pool is unavailable.
+    mx_status_t QueueCheckFile(minfs_inode_t* inode, uint32_t ino);
+
     mx_status_t GetInode(minfs_inode_t* inode, uint32_t ino);
     mx_status_t GetInodeNthBno(minfs_inode_t* inode, uint32_t n, uint32_t* bno_out);
     mx_status_t CheckDirectory(minfs_inode_t* inode, uint32_t ino,
                                uint32_t parent, uint32_t flags);
-    const char* CheckDataBlock(uint32_t bno);
-    mx_status_t CheckFile(minfs_inode_t* inode, uint32_t ino);
+    mx_status_t CheckDirIndex(minfs_inode_t* inode, uint32_t ino);
+    const char* CheckDataBlock(uint32_t bno, RawBitmap* shard);
+    mx_status_t CheckFile(minfs_inode_t* inode, uint32_t ino,
+                          RawBitmap* shard, bool* conforming);
 
     mxtl::unique_ptr<Minfs> fs_;
     RawBitmap checked_inodes_;
     RawBitmap checked_blocks_;
 
     mxtl::Array<int32_t> links_;
+
+    CheckWorker workers_[kNumCheckWorkers];
+    int num_workers_ = 0;
+    mtx_t queue_lock_ = MTX_INIT;
+    cnd_t queue_work_cnd_;
+    cnd_t queue_space_cnd_;
+    mxtl::DoublyLinkedList<mxtl::unique_ptr<CheckJob>> queue_;
+    size_t queue_len_ = 0;
+    bool queue_done_ = false;
 };
 
 mx_status_t minfs_check(mxtl::unique_ptr<Bcache> bc);
@@ -306,6 +450,14 @@ mx_status_t minfs_check(mxtl::unique_ptr<Bcache> bc);
 
 mx_status_t minfs_mount(mxtl::RefPtr<VnodeMinfs>* root_out, mxtl::unique_ptr<Bcache> bc);
 
+#ifdef __Fuchsia__
+// In resident service mode an unmounted (and already synced) filesystem is
+// handed to this hook instead of being destroyed, so a later remount of the
+// same device can reuse the validated superblock and bitmaps. Set by the
+// 'service' command; null otherwise.
+extern mx_status_t (*minfs_retain_hook)(Minfs* fs, mxtl::RefPtr<VnodeMinfs> root);
+#endif
+
 void minfs_dir_init(void* bdata, uint32_t ino_self, uint32_t ino_parent);
 
 } // namespace minfs
@@ -16,6 +16,7 @@
 #include <mxtl/unique_ptr.h>
 #ifdef __Fuchsia__
 #include <fs/vfs-dispatcher.h>
+#include <mxtl/auto_lock.h>
 #endif
 
 #include "block-txn.h"
@@ -98,14 +99,15 @@ mx_status_t Minfs::InoFree(
     const MappedVmo* vmo_indirect,
 #endif
     const minfs_inode_t& inode, uint32_t ino) {
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&lock_);
+#endif
     // We're going to be updating block bitmaps repeatedly.
     WriteTxn txn(bc_.get());
 #ifdef __Fuchsia__
     auto ibm_id = inode_map_vmoid_;
-    auto bbm_id = block_map_vmoid_;
 #else
     auto ibm_id = inode_map_.StorageUnsafe()->GetData();
-    auto bbm_id = block_map_.StorageUnsafe()->GetData();
 #endif
 
     // Free the inode bit itself
@@ -121,9 +123,7 @@ mx_status_t Minfs::InoFree(
         }
         ValidateBno(inode.dnum[n]);
         block_count--;
-        block_map_.Clear(inode.dnum[n], inode.dnum[n] + 1);
-        uint32_t bitblock = inode.dnum[n] / kMinfsBlockBits;
-        txn.Enqueue(bbm_id, bitblock, info_.abm_block + bitblock, 1);
+        BlockFree(&txn, inode.dnum[n]);
     }
 
     // release all indirect blocks
@@ -145,15 +145,11 @@ mx_status_t Minfs::InoFree(
                 continue;
             }
             block_count--;
-            block_map_.Clear(entry[m], entry[m] + 1);
-            uint32_t bitblock = entry[m] / kMinfsBlockBits;
-            txn.Enqueue(bbm_id, bitblock, info_.abm_block + bitblock, 1);
+            BlockFree(&txn, entry[m]);
         }
         // release the direct block itself
         block_count--;
-        block_map_.Clear(inode.inum[n], inode.inum[n] + 1);
-        uint32_t bitblock = inode.inum[n] / kMinfsBlockBits;
-        txn.Enqueue(bbm_id, bitblock, info_.abm_block + bitblock, 1);
+        BlockFree(&txn, inode.inum[n]);
     }
 
     MX_DEBUG_ASSERT(block_count == 0);
@@ -161,6 +157,9 @@ mx_status_t Minfs::InoFree(
 }
 
 mx_status_t Minfs::InoNew(WriteTxn* txn, const minfs_inode_t* inode, uint32_t* ino_out) {
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&lock_);
+#endif
     size_t bitoff_start;
     mx_status_t status = inode_map_.Find(false, 0, inode_map_.size(), 1, &bitoff_start);
     if (status != NO_ERROR) {
@@ -216,13 +215,21 @@ mx_status_t Minfs::VnodeNew(WriteTxn* txn, mxtl::RefPtr<VnodeMinfs>* out, uint32
         return status;
     }
 
-    vnode_hash_.insert(vn.get());
+    {
+#ifdef __Fuchsia__
+        mxtl::AutoLock lock(&lock_);
+#endif
+        vnode_hash_.insert(vn.get());
+    }
 
     *out = mxtl::move(vn);
     return 0;
 }
 
 void Minfs::VnodeRelease(VnodeMinfs* vn) {
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&lock_);
+#endif
     vnode_hash_.erase(*vn);
 }
 
@@ -230,6 +237,9 @@ mx_status_t Minfs::VnodeGet(mxtl::RefPtr<VnodeMinfs>* out, uint32_t ino) {
     if ((ino < 1) || (ino >= info_.inode_count)) {
         return ERR_OUT_OF_RANGE;
     }
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&lock_);
+#endif
     mxtl::RefPtr<VnodeMinfs> vn = mxtl::RefPtr<VnodeMinfs>(vnode_hash_.find(ino).CopyPointer());
     if (vn != nullptr) {
         *out = mxtl::move(vn);
@@ -262,6 +272,13 @@ mx_status_t Minfs::VnodeGet(mxtl::RefPtr<VnodeMinfs>* out, uint32_t ino) {
 // If hint is nonzero it indicates which block number to start the search for
 // free blocks from.
 mx_status_t Minfs::BlockNew(WriteTxn* txn, uint32_t hint, uint32_t* out_bno) {
+#ifdef __Fuchsia__
+    mxtl::AutoLock lock(&lock_);
+#endif
+    return BlockNewLocked(txn, hint, out_bno);
+}
+
+mx_status_t Minfs::BlockNewLocked(WriteTxn* txn, uint32_t hint, uint32_t* out_bno) {
     size_t bitoff_start;
     mx_status_t status;
     if ((status = block_map_.Find(false, hint, block_map_.size(), 1, &bitoff_start)) != NO_ERROR) {
@@ -291,6 +308,121 @@ mx_status_t Minfs::BlockNew(WriteTxn* txn, uint32_t hint, uint32_t* out_bno) {
     return NO_ERROR;
 }
 
+void Minfs::BlockFree(WriteTxn* txn, uint32_t bno) {
+#ifdef __Fuchsia__
+    if (snapshot_active_ && snapshot_map_.Get(bno, bno + 1)) {
+        // The snapshot still references this block; leave the bitmap bit set
+        // so it cannot be reallocated, and apply the free on release.
+        snapshot_freed_.Set(bno, bno + 1);
+        return;
+    }
+    auto bbm_id = block_map_vmoid_;
+#else
+    auto bbm_id = block_map_.StorageUnsafe()->GetData();
+#endif
+    block_map_.Clear(bno, bno + 1);
+    uint32_t bitblock = bno / kMinfsBlockBits;
+    txn->Enqueue(bbm_id, bitblock, info_.abm_block + bitblock, 1);
+}
+
+#ifdef __Fuchsia__
+mx_status_t Minfs::BlockCowLocked(WriteTxn* txn, uint32_t* bno) {
+    if (!snapshot_active_ || !snapshot_map_.Get(*bno, *bno + 1)) {
+        return NO_ERROR;
+    }
+    uint32_t nbno;
+    mx_status_t status;
+    if ((status = BlockNewLocked(txn, 0, &nbno)) != NO_ERROR) {
+        return status;
+    }
+    BlockFree(txn, *bno);
+    *bno = nbno;
+    return NO_ERROR;
+}
+
+mx_status_t Minfs::BlockCow(WriteTxn* txn, uint32_t* bno) {
+    mxtl::AutoLock lock(&lock_);
+    return BlockCowLocked(txn, bno);
+}
+
+mx_status_t Minfs::SnapshotCreate(mx::vmo* out) {
+    mxtl::AutoLock lock(&lock_);
+    if (snapshot_active_) {
+        return ERR_ALREADY_EXISTS;
+    }
+
+    // Freeze the allocation state: every block referenced right now belongs
+    // to the snapshot until release.
+    mx_status_t status;
+    if ((status = snapshot_map_.Reset(abmblks_ * kMinfsBlockBits)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = snapshot_freed_.Reset(abmblks_ * kMinfsBlockBits)) != NO_ERROR) {
+        return status;
+    }
+    memcpy(snapshot_map_.StorageUnsafe()->GetData(),
+           block_map_.StorageUnsafe()->GetData(),
+           abmblks_ * kMinfsBlockSize);
+
+    // Capture the metadata region from the in-memory copies -- the
+    // authoritative ones -- so the snapshot costs no disk reads. Writes that
+    // raced with the snapshot may be torn, exactly as after a crash; the
+    // image is crash-consistent.
+    mx::vmo vmo;
+    const size_t meta_size = (size_t)info_.dat_block * kMinfsBlockSize;
+    if ((status = mx::vmo::create(meta_size, 0, &vmo)) != NO_ERROR) {
+        return status;
+    }
+    size_t actual;
+    if ((status = vmo.write(&info_, 0, sizeof(info_), &actual)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = vmo.write(inode_map_.StorageUnsafe()->GetData(),
+                            (uint64_t)info_.ibm_block * kMinfsBlockSize,
+                            ibmblks_ * kMinfsBlockSize, &actual)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = vmo.write(block_map_.StorageUnsafe()->GetData(),
+                            (uint64_t)info_.abm_block * kMinfsBlockSize,
+                            abmblks_ * kMinfsBlockSize, &actual)) != NO_ERROR) {
+        return status;
+    }
+    const size_t itable_size =
+        (size_t)(info_.inode_count / kMinfsInodesPerBlock) * kMinfsBlockSize;
+    if ((status = vmo.write(inode_table_->GetData(),
+                            (uint64_t)info_.ino_block * kMinfsBlockSize,
+                            itable_size, &actual)) != NO_ERROR) {
+        return status;
+    }
+
+    snapshot_active_ = true;
+    *out = mxtl::move(vmo);
+    return NO_ERROR;
+}
+
+mx_status_t Minfs::SnapshotRelease() {
+    mxtl::AutoLock lock(&lock_);
+    if (!snapshot_active_) {
+        return ERR_BAD_STATE;
+    }
+
+    // Apply the frees deferred while the snapshot pinned their blocks.
+    WriteTxn txn(bc_.get());
+    size_t bno = 0;
+    while (snapshot_freed_.Find(true, bno, snapshot_freed_.size(), 1, &bno) == NO_ERROR) {
+        block_map_.Clear(bno, bno + 1);
+        uint32_t bitblock = static_cast<uint32_t>(bno / kMinfsBlockBits);
+        txn.Enqueue(block_map_vmoid_, bitblock, info_.abm_block + bitblock, 1);
+        bno++;
+    }
+
+    snapshot_active_ = false;
+    snapshot_map_.Reset(0);
+    snapshot_freed_.Reset(0);
+    return txn.Flush();
+}
+#endif
+
 void minfs_dir_init(void* bdata, uint32_t ino_self, uint32_t ino_parent) {
 #define DE0_SIZE DirentSize(1)
 
@@ -325,6 +457,13 @@ mx_status_t Minfs::Create(Minfs** out, mxtl::unique_ptr<Bcache> bc, const minfs_
         return status;
     }
 
+    // Replay any journal entry committed before a crash, so the bitmaps and
+    // inode table read below observe a consistent image.
+    if ((status = Journal::Replay(bc.get())) != NO_ERROR) {
+        FS_TRACE_ERROR("minfs: journal replay failed\n");
+        return status;
+    }
+
     AllocChecker ac;
     mxtl::unique_ptr<Minfs> fs(new (&ac) Minfs(mxtl::move(bc), info));
     if (!ac.check()) {
@@ -378,6 +517,19 @@ mx_status_t Minfs::Create(Minfs** out, mxtl::unique_ptr<Bcache> bc, const minfs_
         return status;
     }
 
+    // Route metadata writes through the journal: all three metadata vmos
+    // are registered, so their write transactions are group-committed to
+    // the log before their home locations are updated.
+    if ((status = Journal::Create(fs->bc_.get(), &fs->journal_)) != NO_ERROR) {
+        return status;
+    }
+    fs->journal_->RegisterVmo(fs->block_map_vmoid_,
+                              fs->block_map_.StorageUnsafe()->GetData());
+    fs->journal_->RegisterVmo(fs->inode_map_vmoid_,
+                              fs->inode_map_.StorageUnsafe()->GetData());
+    fs->journal_->RegisterVmo(fs->inode_table_vmoid_, fs->inode_table_->GetData());
+    fs->bc_->SetJournal(fs->journal_.get());
+
     ReadTxn txn(fs->bc_.get());
     txn.Enqueue(fs->block_map_vmoid_, 0, fs->info_.abm_block, fs->abmblks_);
     txn.Enqueue(fs->inode_map_vmoid_, 0, fs->info_.ibm_block, fs->ibmblks_);
@@ -435,6 +587,10 @@ mx_status_t minfs_mount(mxtl::RefPtr<VnodeMinfs>* out, mxtl::unique_ptr<Bcache>
     return NO_ERROR;
 }
 
+#ifdef __Fuchsia__
+mx_status_t (*minfs_retain_hook)(Minfs* fs, mxtl::RefPtr<VnodeMinfs> root) = nullptr;
+#endif
+
 mx_status_t Minfs::Unmount() {
 #ifdef __Fuchsia__
     dispatcher_ = nullptr;
@@ -552,6 +708,15 @@ int minfs_mkfs(mxtl::unique_ptr<Bcache> bc) {
     ino[kMinfsRootIno].dnum[0] = info.dat_block;
     bc->Writeblk(info.ino_block, blk);
 
+    // write empty journal header
+    memset(blk, 0, sizeof(blk));
+    journal_header_t jh;
+    memset(&jh, 0, sizeof(jh));
+    jh.magic = kJournalMagic;
+    jh.checksum = journal_checksum(&jh);
+    memcpy(blk, &jh, sizeof(jh));
+    bc->Writeblk(kJournalStartBlock, blk);
+
     memset(blk, 0, sizeof(blk));
     memcpy(blk, &info, sizeof(info));
     bc->Writeblk(0, blk);
@@ -13,6 +13,7 @@
 #include <mxtl/ref_ptr.h>
 #include <mxtl/type_support.h>
 #include <mxtl/unique_free_ptr.h>
+#include <mxtl/unique_ptr.h>
 
 #include <magenta/types.h>
 
@@ -24,6 +25,8 @@
 #include "misc.h"
 
 #ifdef __Fuchsia__
+#include <threads.h>
+
 #include <block-client/client.h>
 using RawBitmap = bitmap::RawBitmapGeneric<bitmap::VmoStorage>;
 #else
@@ -100,7 +103,8 @@ typedef struct {
     uint32_t seq_num;               // bumped when modified
     uint32_t gen_num;               // bumped when deleted
     uint32_t dirent_count;          // for directories
-    uint32_t rsvd[5];
+    uint32_t flags;                 // kMinfsInode*; zero on old images
+    uint32_t rsvd[4];
     uint32_t dnum[kMinfsDirect];    // direct blocks
     uint32_t inum[kMinfsIndirect];  // indirect blocks
 } minfs_inode_t;
@@ -151,6 +155,67 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 //   also increase in size.
 
 
+// Hashed directory index
+//
+// Large directories may additionally carry a fixed-size open-addressed hash
+// table mapping name hashes to dirent offsets, making lookup O(1) instead of
+// a linear scan of the dirent stream. The index is stored in the directory
+// file itself, starting at the first block past the dirent region (dirents
+// never extend past kMinfsMaxDirectorySize), and is flagged by
+// kMinfsInodeDirIndex in the inode.
+//
+// The index is purely an acceleration structure: the dirent stream remains
+// authoritative, and drivers which do not understand the index simply ignore
+// the extra blocks. Since every directory modification bumps the inode's
+// seq_num, the index header records the seq_num it was last updated under;
+// an index left stale by an older driver is thereby detected, ignored, and
+// eventually rebuilt.
+constexpr uint32_t kMinfsInodeDirIndex = 0x00000001;
+
+constexpr uint64_t kMinfsDirIndexMagic   = (0x002158446e694d21ULL);
+constexpr uint32_t kMinfsDirIndexVersion = 1;
+
+constexpr size_t kMinfsDirIndexOffset = 128 * kMinfsBlockSize;
+static_assert(kMinfsDirIndexOffset >= kMinfsMaxDirectorySize,
+              "MinFS directory index must not overlap the dirent region");
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t seq_num;               // inode seq_num at last index update
+    uint32_t entries;               // live slots (== inode dirent_count)
+    uint32_t tombstones;            // erased slots awaiting a rebuild
+    uint32_t free_hint;             // no free dirent space before this offset
+    uint32_t rsvd;
+} minfs_dir_index_t;
+
+// Twice the number of minimum-size dirents which fit in the dirent region,
+// so the table's load factor stays below one half.
+constexpr uint32_t kMinfsDirIndexSlots = (1 << 17);
+
+constexpr size_t kMinfsDirIndexEnd = kMinfsDirIndexOffset +
+        sizeof(minfs_dir_index_t) + kMinfsDirIndexSlots * sizeof(uint32_t);
+static_assert(kMinfsDirIndexEnd <= kMinfsMaxFileSize,
+              "MinFS directory index must fit in the directory file");
+
+// A directory is indexed once it accumulates this many entries.
+constexpr uint32_t kMinfsDirIndexMinEntries = 512;
+
+// Slots pack a 13-bit fingerprint of the name hash with the dirent offset;
+// dirent offsets are 4-aligned and below 2^20, so (off >> 2) + 1 fits in the
+// low 19 bits and a live slot can never collide with kMinfsDirIndexSlotFree.
+constexpr uint32_t kMinfsDirIndexSlotFree = 0;
+constexpr uint32_t kMinfsDirIndexSlotDead = 0xFFFFFFFF; // tombstone
+
+constexpr uint32_t DirIndexSlot(uint32_t hash, size_t off) {
+    return ((hash >> 19) << 19) | (static_cast<uint32_t>(off >> 2) + 1);
+}
+
+constexpr size_t DirIndexSlotOffset(uint32_t slot) {
+    return static_cast<size_t>((slot & 0x0007FFFF) - 1) << 2;
+}
+
+
 // blocksize   8K    16K    32K
 // 16 dir =  128K   256K   512K
 // 32 ind =  512M  1024M  2048M
@@ -159,9 +224,38 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 //  4GB ->  512K blocks ->  64K bitmap (8K qword)
 // 32GB -> 4096K blocks -> 512K bitmap (64K qwords)
 
-// Block Cache (bcache.c)
+// Block Cache (bcache.cpp)
 constexpr uint32_t kMinfsHashBits = (8);
 
+// On a cache miss, up to this many contiguous blocks are read in a single
+// device operation; cold directory scans and sequential reads then hit the
+// cache instead of issuing one-block synchronous I/Os.
+constexpr uint32_t kMinfsReadaheadBlocks = 8;
+
+class Journal;
+
+// A cached disk block. Nodes are owned by the Bcache hash table (keyed by
+// block number) and threaded on the LRU list. Dirty nodes are written back
+// by Flush(), by eviction, or (on Fuchsia) by the background flush thread.
+class BlockNode : public mxtl::SinglyLinkedListable<mxtl::unique_ptr<BlockNode>>,
+                  public mxtl::DoublyLinkedListable<BlockNode*> {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(BlockNode);
+    friend class Bcache;
+
+    static mx_status_t Create(uint32_t bno, mxtl::unique_ptr<BlockNode>* out);
+
+    uint32_t GetKey() const { return bno_; }
+    static size_t GetHash(uint32_t key) { return fnv1a_tiny(key, kMinfsHashBits); }
+
+private:
+    BlockNode(uint32_t bno);
+
+    uint32_t bno_;
+    bool dirty_;
+    mxtl::unique_ptr<uint8_t[]> data_;
+};
+
 class Bcache {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Bcache);
@@ -169,13 +263,24 @@ public:
 
     static mx_status_t Create(mxtl::unique_ptr<Bcache>* out, int fd, uint32_t blockmax);
 
-    // Raw block read functions.
-    // These do not track blocks (or attempt to access the block cache)
+    // Cached block read/write. Reads populate the cache (with readahead);
+    // writes are buffered in the cache and marked dirty, reaching the
+    // device on Flush(), Sync(), eviction, or via the flush thread.
     mx_status_t Readblk(uint32_t bno, void* data);
     mx_status_t Writeblk(uint32_t bno, const void* data);
 
+    // Write back all dirty cached blocks. This is an ordering barrier:
+    // every write issued before Flush() reaches the device before any
+    // write issued after it.
+    mx_status_t Flush();
+
     uint32_t Maxblk() const { return blockmax_; };
 
+    // The journal (if any) which metadata write transactions are routed
+    // through; see block-txn.h. Unowned.
+    void SetJournal(Journal* journal) { journal_ = journal; }
+    Journal* GetJournal() const { return journal_; }
+
 #ifdef __Fuchsia__
     mx_status_t AttachVmo(mx_handle_t vmo, vmoid_t* out);
     mx_status_t Txn(block_fifo_request_t* requests, size_t count) {
@@ -191,12 +296,43 @@ public:
 private:
     Bcache(int fd, uint32_t blockmax);
 
+    // Uncached device access, used to fill and write back the cache.
+    mx_status_t RawReadblk(uint32_t bno, void* data);
+    mx_status_t RawRead(uint32_t bno, uint32_t count, void* data);
+    mx_status_t RawWriteblk(uint32_t bno, const void* data);
+
+    // The following require cache_lock_ (on Fuchsia).
+    mx_status_t CacheFetchLocked(uint32_t bno, BlockNode** out);
+    mx_status_t CacheInsertLocked(uint32_t bno, BlockNode** out);
+    mx_status_t CacheEvictLocked();
+    mx_status_t FlushLocked();
+    void LruTouchLocked(BlockNode* blk);
+
 #ifdef __Fuchsia__
+    static int FlushThread(void* arg);
+
+    // If the kernel reports memory pressure, evict most of the (clean)
+    // cache instead of waiting for capacity eviction.
+    void ShrinkOnPressureLocked();
+
     fifo_client_t* fifo_client_; // Fast path to interact with block device
     txnid_t txnid_; // TODO(smklein): One per thread
+
+    mtx_t cache_lock_ = MTX_INIT;
+    cnd_t flush_cnd_;
+    thrd_t flush_thread_;
+    bool flush_running_;
+    mx_handle_t pressure_event_ = MX_HANDLE_INVALID;
 #endif
     int fd_;
     uint32_t blockmax_;
+    Journal* journal_;
+
+    using BlockCache = mxtl::HashTable<uint32_t, mxtl::unique_ptr<BlockNode>>;
+    BlockCache cache_;
+    mxtl::DoublyLinkedList<BlockNode*> lru_;  // front is most recently used
+    uint32_t cache_count_;
+    mxtl::unique_ptr<uint8_t[]> readahead_;   // kMinfsReadaheadBlocks blocks
 };
 
 
@@ -12,10 +12,73 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #define BUFSIZE 2048
 
-void handle_rx(mx_handle_t rx_fifo, char* iobuf, unsigned count) {
+// Capture writes are coalesced into a buffer this large before going to
+// disk, so a burst of small frames costs one write() rather than hundreds.
+#define WRITEBUFSIZE (512 * 1024)
+
+// pcap file format
+#define PCAP_MAGIC 0xa1b2c3d4
+
+typedef struct {
+    uint32_t magic;
+    uint16_t major;
+    uint16_t minor;
+    int32_t tz;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t network;
+} __attribute__((packed)) pcap_file_header_t;
+
+typedef struct {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} __attribute__((packed)) pcap_pkt_header_t;
+
+typedef struct {
+    int wfd;      // capture file, or -1 when hexdumping to stdout
+    char* buf;    // coalescing buffer for capture writes
+    size_t off;
+} capture_t;
+
+static int flush_capture(capture_t* cap) {
+    char* data = cap->buf;
+    size_t len = cap->off;
+    while (len > 0) {
+        ssize_t r = write(cap->wfd, data, len);
+        if (r < 0) {
+            fprintf(stderr, "netdump: failed to write capture: %zd\n", r);
+            return -1;
+        }
+        data += r;
+        len -= r;
+    }
+    cap->off = 0;
+    return 0;
+}
+
+static int capture_packet(capture_t* cap, mx_time_t ts, void* data, size_t len) {
+    if (cap->off + sizeof(pcap_pkt_header_t) + len > WRITEBUFSIZE) {
+        if (flush_capture(cap) < 0) {
+            return -1;
+        }
+    }
+    pcap_pkt_header_t* hdr = (pcap_pkt_header_t*)(cap->buf + cap->off);
+    hdr->ts_sec = ts / MX_SEC(1);
+    hdr->ts_usec = (ts % MX_SEC(1)) / MX_USEC(1);
+    hdr->incl_len = len;
+    hdr->orig_len = len;
+    memcpy(hdr + 1, data, len);
+    cap->off += sizeof(pcap_pkt_header_t) + len;
+    return 0;
+}
+
+void handle_rx(mx_handle_t rx_fifo, char* iobuf, unsigned count, capture_t* cap) {
     eth_fifo_entry_t entries[count];
 
     for (;;) {
@@ -23,6 +86,13 @@ void handle_rx(mx_handle_t rx_fifo, char* iobuf, unsigned count) {
         mx_status_t status;
         if ((status = mx_fifo_read(rx_fifo, entries, sizeof(entries), &n)) < 0) {
             if (status == ERR_SHOULD_WAIT) {
+                // drain the write buffer while the wire is quiet, so a capture
+                // of an idle network is not held hostage in memory
+                if (cap->wfd >= 0 && cap->off > 0) {
+                    if (flush_capture(cap) < 0) {
+                        return;
+                    }
+                }
                 mx_object_wait_one(rx_fifo, MX_FIFO_READABLE | MX_FIFO_PEER_CLOSED, MX_TIME_INFINITE, NULL);
                 continue;
             }
@@ -30,26 +100,68 @@ void handle_rx(mx_handle_t rx_fifo, char* iobuf, unsigned count) {
             return;
         }
 
+        // one timestamp per batch: the frames were all on the wire within
+        // the time it took us to wake up and drain the fifo
+        mx_time_t ts = mx_time_get(MX_CLOCK_UTC);
+
         eth_fifo_entry_t* e = entries;
         for (uint32_t i = 0; i < n; i++, e++) {
             if (e->flags & ETH_FIFO_RX_OK) {
-                printf("---\n");
-                hexdump8_ex(iobuf + e->offset, e->length, 0);
+                if (cap->wfd >= 0) {
+                    if (capture_packet(cap, ts, iobuf + e->offset, e->length) < 0) {
+                        return;
+                    }
+                } else {
+                    printf("---\n");
+                    hexdump8_ex(iobuf + e->offset, e->length, 0);
+                }
             }
             e->length = BUFSIZE;
             e->flags = 0;
+        }
+
+        // return the whole batch of buffers to the driver in one fifo write
+        e = entries;
+        while (n > 0) {
             uint32_t actual;
-            if ((status = mx_fifo_write(rx_fifo, e, sizeof(*e), &actual)) < 0) {
+            if ((status = mx_fifo_write(rx_fifo, e, n * sizeof(*e), &actual)) < 0) {
+                if (status == ERR_SHOULD_WAIT) {
+                    mx_object_wait_one(rx_fifo, MX_FIFO_WRITABLE | MX_FIFO_PEER_CLOSED, MX_TIME_INFINITE, NULL);
+                    continue;
+                }
                 fprintf(stderr, "netdump: failed to queue rx packet: %d\n", status);
-                break;
+                return;
             }
+            e += actual;
+            n -= actual;
         }
     }
 }
 
+void usage(void) {
+    fprintf(stderr, "usage:  netdump [-w file] <network-device>\n");
+}
+
 int main(int argc, char** argv) {
+    capture_t cap = {
+        .wfd = -1,
+    };
+
+    while (argc > 2) {
+        if (!strcmp(argv[1], "-w")) {
+            if ((cap.wfd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+                fprintf(stderr, "netdump: cannot open '%s'\n", argv[2]);
+                return -1;
+            }
+            argv += 2;
+            argc -= 2;
+        } else {
+            usage();
+            return -1;
+        }
+    }
     if (argc != 2) {
-        fprintf(stderr, "usage:  netdump <network-device>\n");
+        usage();
         return -1;
     }
 
@@ -91,6 +203,22 @@ int main(int argc, char** argv) {
         fprintf(stderr, "netdump: failed to set client name %zd\n", r);
     }
 
+    if (cap.wfd >= 0) {
+        if ((cap.buf = malloc(WRITEBUFSIZE)) == NULL) {
+            fprintf(stderr, "netdump: cannot allocate write buffer\n");
+            return -1;
+        }
+        pcap_file_header_t hdr = {
+            .magic = PCAP_MAGIC,
+            .major = 2,
+            .minor = 4,
+            .snaplen = BUFSIZE,
+            .network = 1, // LINKTYPE_ETHERNET
+        };
+        memcpy(cap.buf, &hdr, sizeof(hdr));
+        cap.off = sizeof(hdr);
+    }
+
     // assign data chunks to ethbufs
     for (unsigned n = 0; n < count; n++) {
         eth_fifo_entry_t entry = {
@@ -116,7 +244,12 @@ int main(int argc, char** argv) {
         return -1;
     }
 
-    handle_rx(fifos.rx_fifo, iobuf, count);
+    handle_rx(fifos.rx_fifo, iobuf, count, &cap);
+
+    if (cap.wfd >= 0) {
+        flush_capture(&cap);
+        close(cap.wfd);
+    }
 
     return 0;
 }
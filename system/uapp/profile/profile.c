@@ -0,0 +1,170 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Control program for the mtrace sampling profiler. Samples every cpu for
+// a while and writes the collected records out as text, one sample per
+// line: timestamp, cpu, pid, tid, then the kernel pcs innermost first.
+// The pcs are kernel addresses; symbolize them offline against the kernel
+// ELF, the same workflow as Intel PT dumps.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/sysinfo.h>
+#include <magenta/mtrace.h>
+#include <magenta/syscalls.h>
+
+static mx_handle_t get_root_resource(void) {
+    int fd = open("/dev/misc/sysinfo", O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "profile: cannot open sysinfo\n");
+        return MX_HANDLE_INVALID;
+    }
+    mx_handle_t h;
+    ssize_t r = ioctl_sysinfo_get_root_resource(fd, &h);
+    close(fd);
+    if (r != sizeof(h)) {
+        fprintf(stderr, "profile: cannot get root resource\n");
+        return MX_HANDLE_INVALID;
+    }
+    return h;
+}
+
+static int dump_cpu(mx_handle_t resource, uint32_t cpu, FILE* out) {
+    uint32_t count;
+    mx_status_t status = mx_mtrace_control(resource, MTRACE_KIND_PROFILE,
+                                           MTRACE_PROFILE_GET_NUM_RECORDS,
+                                           MTRACE_PROFILE_OPTIONS(cpu),
+                                           &count, sizeof(count));
+    if (status != NO_ERROR) {
+        fprintf(stderr, "profile: cannot get record count for cpu %u: %d\n",
+                cpu, status);
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    mx_profile_record_t* records = calloc(count, sizeof(*records));
+    if (records == NULL) {
+        fprintf(stderr, "profile: out of memory\n");
+        return -1;
+    }
+    status = mx_mtrace_control(resource, MTRACE_KIND_PROFILE,
+                               MTRACE_PROFILE_READ,
+                               MTRACE_PROFILE_OPTIONS(cpu),
+                               records, count * sizeof(*records));
+    if (status != NO_ERROR) {
+        fprintf(stderr, "profile: cannot read records for cpu %u: %d\n",
+                cpu, status);
+        free(records);
+        return -1;
+    }
+
+    for (uint32_t n = 0; n < count; n++) {
+        mx_profile_record_t* rec = &records[n];
+        fprintf(out, "%lu %u %lu %lu", rec->timestamp, rec->cpu,
+                rec->pid, rec->tid);
+        for (uint32_t f = 0; f < rec->num_frames; f++) {
+            fprintf(out, " %#lx", rec->pc[f]);
+        }
+        fprintf(out, "\n");
+    }
+    free(records);
+    return (int)count;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: profile [options]\n"
+            "  -f <freq>     sample frequency in hz (default 1000)\n"
+            "  -d <secs>     duration in seconds (default 10)\n"
+            "  -o <file>     output file (default /tmp/profile.out)\n");
+}
+
+int main(int argc, char** argv) {
+    uint32_t freq = 1000;
+    uint32_t duration = 10;
+    const char* output = "/tmp/profile.out";
+
+    int c;
+    while ((c = getopt(argc, argv, "f:d:o:h")) > 0) {
+        switch (c) {
+        case 'f':
+            freq = atoi(optarg);
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+    if (freq == 0 || duration == 0) {
+        usage();
+        return 1;
+    }
+
+    mx_handle_t resource = get_root_resource();
+    if (resource == MX_HANDLE_INVALID) {
+        return 1;
+    }
+
+    mx_profile_config_t config = {
+        .sample_period_ns = MX_SEC(1) / freq,
+        // Room for the whole run plus some slop for timer overrun.
+        .num_records = freq * duration + freq,
+    };
+
+    mx_status_t status = mx_mtrace_control(resource, MTRACE_KIND_PROFILE,
+                                           MTRACE_PROFILE_ALLOC, 0,
+                                           &config, sizeof(config));
+    if (status != NO_ERROR) {
+        fprintf(stderr, "profile: cannot allocate buffers: %d\n", status);
+        return 1;
+    }
+
+    status = mx_mtrace_control(resource, MTRACE_KIND_PROFILE,
+                               MTRACE_PROFILE_START, 0, NULL, 0);
+    if (status != NO_ERROR) {
+        fprintf(stderr, "profile: cannot start: %d\n", status);
+        goto done;
+    }
+
+    printf("profiling all cpus at %u hz for %u seconds...\n", freq, duration);
+    mx_nanosleep(mx_deadline_after(MX_SEC(duration)));
+
+    mx_mtrace_control(resource, MTRACE_KIND_PROFILE,
+                      MTRACE_PROFILE_STOP, 0, NULL, 0);
+
+    FILE* out = fopen(output, "w");
+    if (out == NULL) {
+        fprintf(stderr, "profile: cannot open %s\n", output);
+        goto done;
+    }
+
+    int total = 0;
+    uint32_t num_cpus = mx_system_get_num_cpus();
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        int n = dump_cpu(resource, cpu, out);
+        if (n > 0) {
+            total += n;
+        }
+    }
+    fclose(out);
+    printf("%d samples written to %s\n", total, output);
+
+done:
+    mx_mtrace_control(resource, MTRACE_KIND_PROFILE,
+                      MTRACE_PROFILE_FREE, 0, NULL, 0);
+    mx_handle_close(resource);
+    return 0;
+}
@@ -3,16 +3,19 @@
 // found in the LICENSE file.
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <launchpad/launchpad.h>
 #include <limits.h>
 #include <magenta/listnode.h>
+#include <magenta/process.h>
 #include <magenta/syscalls.h>
 #include <magenta/syscalls/object.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <unittest/unittest.h>
 
@@ -54,6 +57,98 @@ static const char* default_test_groups[] = {
 };
 #define DEFAULT_NUM_TEST_GROUPS 5
 
+// Upper bound on -j; also the size of the in-flight test table.
+#define MAX_TEST_JOBS 16
+
+// How many tests to run concurrently (-j). 1 keeps today's sequential
+// behavior.
+static int max_jobs = 1;
+
+// Where to write per-test output files (-o). When tests run concurrently
+// their output would interleave, so each test's stdout/stderr goes to
+// <output_dir>/<test>.out instead of our own stdout.
+static const char* output_dir = NULL;
+
+typedef struct {
+    char name[NAME_MAX + 1];
+    mx_handle_t proc;
+    // The per-test job the process runs in, or MX_HANDLE_INVALID when
+    // running directly in our own job (sequential mode).
+    mx_handle_t job;
+} running_test_t;
+
+static running_test_t running[MAX_TEST_JOBS];
+static int running_count = 0;
+
+// Records the result of a terminated test and tears down its job, so
+// anything the test spawned and left behind goes away with it.
+static void finish_test(running_test_t* rt) {
+    mx_info_process_t proc_info;
+    mx_status_t status = mx_object_get_info(rt->proc, MX_INFO_PROCESS, &proc_info,
+                                            sizeof(proc_info), NULL, NULL);
+    mx_handle_close(rt->proc);
+    if (rt->job != MX_HANDLE_INVALID) {
+        mx_task_kill(rt->job);
+        mx_handle_close(rt->job);
+    }
+
+    if (status < 0) {
+        printf("FAILURE: Failed to get process return code %s: %d\n", rt->name, status);
+        fail_test(&failures, rt->name, FAILED_TO_RETURN_CODE, 0);
+        failed_count++;
+        return;
+    }
+
+    if (proc_info.return_code == 0) {
+        printf("PASSED: %s passed\n", rt->name);
+    } else {
+        printf("FAILED: %s exited with nonzero status: %d\n", rt->name, proc_info.return_code);
+        fail_test(&failures, rt->name, FAILED_NONZERO_RETURN_CODE, proc_info.return_code);
+        failed_count++;
+    }
+}
+
+// Waits until there is room to launch another test, or until everything
+// in flight has terminated when |all| is set.
+static void reap_tests(bool all) {
+    while (running_count > 0 && (all || running_count == max_jobs)) {
+        mx_wait_item_t items[MAX_TEST_JOBS];
+        for (int i = 0; i < running_count; i++) {
+            items[i].handle = running[i].proc;
+            items[i].waitfor = MX_PROCESS_TERMINATED;
+            items[i].pending = 0;
+        }
+        mx_status_t status = mx_object_wait_many(items, running_count, MX_TIME_INFINITE);
+        if (status != NO_ERROR) {
+            // We cannot tell which test is stuck, so give up on the batch.
+            for (int i = 0; i < running_count; i++) {
+                printf("FAILURE: Failed to wait for process exiting %s: %d\n",
+                       running[i].name, status);
+                fail_test(&failures, running[i].name, FAILED_TO_WAIT, 0);
+                failed_count++;
+                mx_handle_close(running[i].proc);
+                if (running[i].job != MX_HANDLE_INVALID) {
+                    mx_task_kill(running[i].job);
+                    mx_handle_close(running[i].job);
+                }
+            }
+            running_count = 0;
+            return;
+        }
+
+        // Retire every test that terminated and compact the table.
+        int kept = 0;
+        for (int i = 0; i < running_count; i++) {
+            if (items[i].pending & MX_PROCESS_TERMINATED) {
+                finish_test(&running[i]);
+            } else {
+                running[kept++] = running[i];
+            }
+        }
+        running_count = kept;
+    }
+}
+
 static bool run_tests(const char* dirn, const char* test_name) {
     DIR* dir = opendir(dirn);
     if (dir == NULL) {
@@ -74,6 +169,10 @@ static bool run_tests(const char* dirn, const char* test_name) {
             continue;
         }
 
+        // Make room for another in-flight test. In sequential mode this
+        // waits out the previous test, preserving today's output order.
+        reap_tests(false);
+
         total_count++;
         if (verbosity) {
             printf(
@@ -86,10 +185,32 @@ static bool run_tests(const char* dirn, const char* test_name) {
         const char* argv[] = {name, verbose_opt};
         int argc = verbosity >= 0 ? 2 : 1;
 
+        // When running concurrently, isolate each test in its own job so
+        // peers cannot see each other and stragglers can be killed as a
+        // unit in finish_test().
+        mx_handle_t job = MX_HANDLE_INVALID;
+        if (max_jobs > 1) {
+            if (mx_job_create(mx_job_default(), 0u, &job) != NO_ERROR) {
+                job = MX_HANDLE_INVALID;
+            }
+        }
+
         launchpad_t* lp;
-        launchpad_create(0, name, &lp);
+        launchpad_create(job, name, &lp);
         launchpad_load_from_file(lp, argv[0]);
-        launchpad_clone(lp, LP_CLONE_ALL);
+        if (output_dir != NULL) {
+            char out_path[64 + NAME_MAX];
+            snprintf(out_path, sizeof(out_path), "%s/%s.out", output_dir, de->d_name);
+            launchpad_clone(lp, LP_CLONE_ALL & ~LP_CLONE_MXIO_STDIO);
+            int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd >= 0) {
+                launchpad_clone_fd(lp, fd, STDOUT_FILENO);
+                launchpad_clone_fd(lp, fd, STDERR_FILENO);
+                close(fd);
+            }
+        } else {
+            launchpad_clone(lp, LP_CLONE_ALL);
+        }
         launchpad_set_args(lp, argc, argv);
         const char* errmsg;
         mx_handle_t handle;
@@ -98,46 +219,30 @@ static bool run_tests(const char* dirn, const char* test_name) {
             printf("FAILURE: Failed to launch %s: %d: %s\n", de->d_name, status, errmsg);
             fail_test(&failures, de->d_name, FAILED_TO_LAUNCH, 0);
             failed_count++;
+            if (job != MX_HANDLE_INVALID) {
+                mx_task_kill(job);
+                mx_handle_close(job);
+            }
             continue;
         }
 
-        status = mx_object_wait_one(handle, MX_PROCESS_TERMINATED,
-                                    MX_TIME_INFINITE, NULL);
-        if (status != NO_ERROR) {
-            printf("FAILURE: Failed to wait for process exiting %s: %d\n", de->d_name, status);
-            fail_test(&failures, de->d_name, FAILED_TO_WAIT, 0);
-            failed_count++;
-            continue;
-        }
-
-        // read the return code
-        mx_info_process_t proc_info;
-        status = mx_object_get_info(handle, MX_INFO_PROCESS, &proc_info, sizeof(proc_info), NULL, NULL);
-        mx_handle_close(handle);
-
-        if (status < 0) {
-            printf("FAILURE: Failed to get process return code %s: %d\n", de->d_name, status);
-            fail_test(&failures, de->d_name, FAILED_TO_RETURN_CODE, 0);
-            failed_count++;
-            continue;
-        }
-
-        if (proc_info.return_code == 0) {
-            printf("PASSED: %s passed\n", de->d_name);
-        } else {
-            printf("FAILED: %s exited with nonzero status: %d\n", de->d_name, proc_info.return_code);
-            fail_test(&failures, de->d_name, FAILED_NONZERO_RETURN_CODE, proc_info.return_code);
-            failed_count++;
-        }
+        running_test_t* rt = &running[running_count++];
+        strncpy(rt->name, de->d_name, sizeof(rt->name) - 1);
+        rt->name[sizeof(rt->name) - 1] = 0;
+        rt->proc = handle;
+        rt->job = job;
     }
 
+    // Drain whatever is still in flight before judging the group.
+    reap_tests(true);
+
     closedir(dir);
     return (init_failed_count == failed_count);
 }
 
 int usage(char* name) {
     fprintf(stderr,
-            "usage: %s [-q|-v] [-S|-s] [-M|-m] [-L|-l] [-P|-p] [-a] [-t test name] [group ...]\n"
+            "usage: %s [-q|-v] [-S|-s] [-M|-m] [-L|-l] [-P|-p] [-a] [-b file] [-j jobs] [-o dir] [-t test name] [group ...]\n"
             "\n"
             "The optional [group ...] is a list of test groups to  \n"
             "run. Valid groups are \"core\" \"ddk\" \"sys\" \"fs\" \n"
@@ -156,6 +261,11 @@ int usage(char* name) {
             "   -l: Turn OFF Large tests                           \n"
             "   -P: Turn ON Performance tests    (off by default)  \n"
             "   -p: Turn OFF Performance tests                     \n"
+            "   -b <file>: Record/check perf baselines in <file>   \n"
+            "   -j <jobs>: Run up to <jobs> tests concurrently,    \n"
+            "              each in its own job (0 = one per cpu)   \n"
+            "   -o <dir>: Write each test's output to              \n"
+            "             <dir>/<test>.out (implied by -j > 1)     \n"
             "   -a: Turn on All tests                              \n", name);
     return -1;
 }
@@ -193,6 +303,41 @@ int main(int argc, char** argv) {
             test_type |= TEST_ALL;
         } else if (strcmp(argv[i], "-h") == 0) {
             return usage(argv[0]);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            if (i + 1 < argc) {
+                // Consumed by ulib/unittest's PERF_MEASURE in the children.
+                if (setenv(PERF_BASELINES_ENV_NAME, argv[i + 1], 1) != 0) {
+                    printf("Failed: Could not set %s environment variable\n",
+                           PERF_BASELINES_ENV_NAME);
+                    return -1;
+                }
+                i++;
+            } else {
+                return usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 < argc) {
+                max_jobs = atoi(argv[i + 1]);
+                if (max_jobs == 0) {
+                    max_jobs = mx_system_get_num_cpus();
+                }
+                if (max_jobs < 1) {
+                    max_jobs = 1;
+                }
+                if (max_jobs > MAX_TEST_JOBS) {
+                    max_jobs = MAX_TEST_JOBS;
+                }
+                i++;
+            } else {
+                return usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-o") == 0) {
+            if (i + 1 < argc) {
+                output_dir = argv[i + 1];
+                i++;
+            } else {
+                return usage(argv[0]);
+            }
         } else if (strcmp(argv[i], "-t") == 0) {
             if (i + 1 < argc) {
                 test_name = argv[i + 1];
@@ -226,6 +371,16 @@ int main(int argc, char** argv) {
         num_test_groups = DEFAULT_NUM_TEST_GROUPS;
     }
 
+    // Concurrent test output would interleave on our stdout, so it always
+    // goes to per-test files.
+    if (max_jobs > 1 && output_dir == NULL) {
+        output_dir = "/tmp/runtests";
+    }
+    if (output_dir != NULL) {
+        // Best effort; open() failures below degrade to no stdio for a test.
+        mkdir(output_dir, 0755);
+    }
+
     bool success = true;
     char test_dir[64];
     struct stat st;
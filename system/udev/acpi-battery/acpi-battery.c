@@ -28,26 +28,62 @@
 #define ACPI_BATTERY_STATE_CHARGING    (1 << 1)
 #define ACPI_BATTERY_STATE_CRITICAL    (1 << 2)
 
+// Battery state is refreshed lazily: _BST/_BIF are not evaluated at
+// bind time (they are slow, and nobody may ever look at the battery),
+// but on the first read and whenever the cached values are older than
+// this.
+#define ACPI_BATTERY_CACHE_TTL MX_MSEC(1000)
+
 typedef struct acpi_battery_device {
     mx_device_t* mxdev;
 
     acpi_handle_t acpi_handle;
-    thrd_t poll_thread;
 
     mtx_t lock;
 
+    mx_time_t last_refresh;
     uint32_t state;
     uint32_t capacity_full;
     uint32_t capacity_design;
     uint32_t capacity_remaining;
 } acpi_battery_device_t;
 
+static void acpi_battery_refresh_locked(acpi_battery_device_t* dev) {
+    mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
+    if ((dev->last_refresh != 0) &&
+        (now - dev->last_refresh < ACPI_BATTERY_CACHE_TTL)) {
+        return;
+    }
+
+    acpi_rsp_bst_t* bst;
+    mx_status_t status = acpi_bst(&dev->acpi_handle, &bst);
+    if (status != NO_ERROR) {
+        return;
+    }
+
+    acpi_rsp_bif_t* bif;
+    status = acpi_bif(&dev->acpi_handle, &bif);
+    if (status != NO_ERROR) {
+        free(bst);
+        return;
+    }
+
+    dev->state = bst->state;
+    dev->capacity_remaining = bst->capacity_remaining;
+    dev->capacity_full = bif->capacity_full;
+    dev->capacity_design = bif->capacity_design;
+    dev->last_refresh = now;
+    free(bif);
+    free(bst);
+}
+
 static mx_status_t acpi_battery_read(void* ctx, void* buf, size_t count, mx_off_t off, size_t* actual) {
     acpi_battery_device_t* device = ctx;
     mtx_lock(&device->lock);
+    acpi_battery_refresh_locked(device);
     ssize_t rc = 0;
     int pct;
-    if ((device->capacity_remaining == 0xffffffff) || ((device->capacity_full == 0xffffffff) && device->capacity_design == 0xffffffff) || device->capacity_full == 0) {
+    if ((device->last_refresh == 0) || (device->capacity_remaining == 0xffffffff) || ((device->capacity_full == 0xffffffff) && device->capacity_design == 0xffffffff) || device->capacity_full == 0) {
         pct = -1;
     } else {
         pct = device->capacity_remaining * 100 / device->capacity_full;
@@ -74,36 +110,6 @@ static mx_protocol_device_t acpi_battery_device_proto = {
     // TODO(yky): release
 };
 
-static int acpi_battery_poll_thread(void* arg) {
-    acpi_battery_device_t* dev = arg;
-    for (;;) {
-        acpi_rsp_bst_t* bst;
-        mx_status_t status = acpi_bst(&dev->acpi_handle, &bst);
-        if (status != NO_ERROR) {
-            continue;
-        }
-
-        acpi_rsp_bif_t* bif;
-        status = acpi_bif(&dev->acpi_handle, &bif);
-        if (status != NO_ERROR) {
-            free(bst);
-            continue;
-        }
-
-        mtx_lock(&dev->lock);
-        dev->state = bst->state;
-        dev->capacity_remaining = bst->capacity_remaining;
-        dev->capacity_full = bif->capacity_full;
-        dev->capacity_design = bif->capacity_design;
-        mtx_unlock(&dev->lock);
-        free(bif);
-        free(bst);
-
-        mx_nanosleep(mx_deadline_after(MX_MSEC(1000)));
-    }
-    return 0;
-}
-
 static mx_status_t acpi_battery_bind(void* ctx, mx_device_t* dev, void** cookie) {
     mx_acpi_protocol_t* acpi;
     if (device_op_get_protocol(dev, MX_PROTOCOL_ACPI, (void**)&acpi)) {
@@ -122,11 +128,7 @@ static mx_status_t acpi_battery_bind(void* ctx, mx_device_t* dev, void** cookie)
         return ERR_NO_MEMORY;
     }
     acpi_handle_init(&device->acpi_handle, handle);
-
-    int rc = thrd_create_with_name(&device->poll_thread, acpi_battery_poll_thread, device, "acpi-battery-poll");
-    if (rc != thrd_success) {
-        printf("acpi-battery: polling thread did not start (%d)\n", rc);
-    }
+    mtx_init(&device->lock, mtx_plain);
 
    device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
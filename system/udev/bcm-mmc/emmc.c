@@ -23,6 +23,7 @@
 #include <assert.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,6 +32,7 @@
 // DDK Includes
 #include <ddk/binding.h>
 #include <ddk/device.h>
+#include <ddk/io-buffer.h>
 #include <ddk/iotxn.h>
 #include <ddk/protocol/bcm-bus.h>
 #include <ddk/protocol/platform-device.h>
@@ -91,6 +93,8 @@ struct emmc_regs {
         #define EMMC_HOSTCTRL_LED_ON              (1 << 0)
         #define EMMC_HOSTCTRL_FOUR_BIT_BUS_WIDTH  (1 << 1)
         #define EMMC_HOSTCTRL_HIGHSPEED_ENABLE    (1 << 2)
+        #define EMMC_HOSTCTRL_DMA_SELECT_MASK     (3 << 3)
+        #define EMMC_HOSTCTRL_DMA_SELECT_ADMA2    (2 << 3)
         #define EMMC_PWRCTRL_SD_BUS_POWER         (1 << 8)
     uint32_t ctrl1;         // 2Ch
         #define EMMC_INTERNAL_CLOCK_ENABLE        (1 << 0)
@@ -135,6 +139,7 @@ struct emmc_regs {
         #define EMMC_IRQ_ERR_VS_4          (1 << 31)
     uint32_t ctrl2;         // 3Ch
     uint32_t caps0;         // 40h
+        #define EMMC_CAP_ADMA2            (1 << 19)
     uint32_t caps1;         // 44h
     uint32_t maxcaps0;      // 48h
     uint32_t maxcaps1;      // 4Ch
@@ -154,6 +159,21 @@ struct emmc_regs {
         #define SDHCI_VERSION_3 0x02
 } __PACKED;
 
+// 32-bit addressing ADMA2 descriptor, per the SDHCI spec. A length field of
+// zero denotes a 65536 byte chunk.
+typedef struct emmc_adma2_desc {
+    uint16_t attr;
+        #define ADMA2_DESC_VALID    (1 << 0)
+        #define ADMA2_DESC_END      (1 << 1)
+        #define ADMA2_DESC_INT      (1 << 2)
+        #define ADMA2_DESC_ACT_TRAN (2 << 4)
+    uint16_t length;
+    uint32_t addr;
+} __PACKED emmc_adma2_desc_t;
+
+#define ADMA2_DESC_MAX_LENGTH 0x10000  // 64k
+#define ADMA2_DESC_COUNT (PAGE_SIZE / sizeof(emmc_adma2_desc_t))
+
 typedef struct emmc {
     // Interrupts mapped here.
     mx_handle_t irq_handle;
@@ -177,6 +197,11 @@ typedef struct emmc {
 
     // Cached base clock rate that the pi is running at.
     uint32_t base_clock;
+
+    // ADMA2 descriptor table, used when the controller advertises ADMA2
+    // support in its capability registers.
+    io_buffer_t adma_buffer;
+    bool use_adma2;
 } emmc_t;
 
 typedef struct emmc_setup_context {
@@ -203,6 +228,7 @@ static const uint32_t error_interrupts = (
 // These interrupts indicate that a transfer or command has progressed normally.
 static const uint32_t normal_interrupts = (
     EMMC_IRQ_CMD_CPLT |
+    EMMC_IRQ_XFER_CPLT |
     EMMC_IRQ_BUFF_READ_READY |
     EMMC_IRQ_BUFF_WRITE_READY
 );
@@ -295,6 +321,41 @@ static mx_status_t emmc_await_irq(emmc_t* emmc) {
     return NO_ERROR;
 }
 
+// Builds an ADMA2 descriptor chain covering the physical pages backing this
+// txn. The chain lives in the pre-allocated descriptor table, so nothing is
+// allocated per transfer.
+static mx_status_t emmc_build_adma2_descs(emmc_t* emmc, iotxn_t* txn) {
+    emmc_adma2_desc_t* desc = io_buffer_virt(&emmc->adma_buffer);
+    emmc_adma2_desc_t* first = desc;
+    emmc_adma2_desc_t* last = first + ADMA2_DESC_COUNT - 1;
+
+    iotxn_phys_iter_t iter;
+    iotxn_phys_iter_init(&iter, txn, ADMA2_DESC_MAX_LENGTH);
+
+    mx_paddr_t paddr;
+    size_t length;
+    while ((length = iotxn_phys_iter_next(&iter, &paddr)) > 0) {
+        if (desc > last) {
+            xprintf("emmc: txn needs more than %zu adma2 descriptors\n",
+                    ADMA2_DESC_COUNT);
+            return ERR_NO_RESOURCES;
+        }
+        desc->attr = ADMA2_DESC_ACT_TRAN | ADMA2_DESC_VALID;
+        // a length field of zero denotes a 65536 byte chunk
+        desc->length = (uint16_t)(length & (ADMA2_DESC_MAX_LENGTH - 1));
+        desc->addr = (uint32_t)(paddr + BCM_SDRAM_BUS_ADDR_BASE);
+        desc++;
+    }
+    if (desc == first) {
+        return ERR_INVALID_ARGS;
+    }
+    desc[-1].attr |= ADMA2_DESC_END;
+
+    io_buffer_cache_op(&emmc->adma_buffer, IOTXN_CACHE_CLEAN, 0,
+                       (desc - first) * sizeof(*desc));
+    return NO_ERROR;
+}
+
 static void emmc_iotxn_queue(void* ctx, iotxn_t* txn) {
     // Ensure that the offset is some multiple of the block size, we don't allow
     // writes that are partway into a block.
@@ -342,11 +403,24 @@ static void emmc_iotxn_queue(void* ctx, iotxn_t* txn) {
     // This command has a data phase?
     if (cmd & SDMMC_RESP_DATA_PRESENT) {
         iotxn_physmap(txn);
-        MX_DEBUG_ASSERT(txn->phys_count == 1);
-        regs->arg2 = iotxn_phys(txn) + BCM_SDRAM_BUS_ADDR_BASE;
-
         iotxn_cacheop(txn, IOTXN_CACHE_CLEAN, 0, blkcnt * blksiz);
 
+        if (emmc->use_adma2) {
+            // Hand the whole transfer to the controller as a descriptor
+            // chain; it completes with a single interrupt instead of one
+            // per block.
+            if ((st = emmc_build_adma2_descs(emmc, txn)) != NO_ERROR) {
+                iotxn_complete(txn, st, 0);
+                goto exit;
+            }
+            regs->admaaddr0 = io_buffer_phys(&emmc->adma_buffer) + BCM_SDRAM_BUS_ADDR_BASE;
+            regs->admaaddr1 = 0;
+            cmd |= SDMMC_CMD_DMA_EN;
+        } else {
+            MX_DEBUG_ASSERT(txn->phys_count == 1);
+            regs->arg2 = iotxn_phys(txn) + BCM_SDRAM_BUS_ADDR_BASE;
+        }
+
         if (cmd & SDMMC_CMD_MULTI_BLK)
             cmd |= SDMMC_CMD_AUTO12;
     }
@@ -391,7 +465,19 @@ static void emmc_iotxn_queue(void* ctx, iotxn_t* txn) {
 
 
     size_t bytes_copied = 0;
-    if (cmd & SDMMC_RESP_DATA_PRESENT) {
+    if ((cmd & SDMMC_RESP_DATA_PRESENT) && (cmd & SDMMC_CMD_DMA_EN)) {
+        // The descriptor chain covers the whole transfer, so there is a
+        // single transfer complete interrupt at the end.
+        regs->irqen = error_interrupts | EMMC_IRQ_XFER_CPLT;
+        if ((st = emmc_await_irq(emmc)) != NO_ERROR) {
+            iotxn_complete(txn, st, 0);
+            goto exit;
+        }
+        if (cmd & SDMMC_CMD_READ) {
+            iotxn_cacheop(txn, IOTXN_CACHE_INVALIDATE, 0, blkcnt * blksiz);
+        }
+        bytes_copied = blkcnt * blksiz;
+    } else if (cmd & SDMMC_RESP_DATA_PRESENT) {
         // Select the interrupt that we want to wait on based on whether we're
         // reading or writing.
         if (cmd & SDMMC_CMD_READ) {
@@ -566,6 +652,9 @@ static void emmc_unbind(void* ctx) {
 
 static void emmmc_release(void* ctx) {
     emmc_t* emmc = ctx;
+    if (io_buffer_is_valid(&emmc->adma_buffer)) {
+        io_buffer_release(&emmc->adma_buffer);
+    }
     free(emmc);
 }
 
@@ -726,6 +815,21 @@ static int emmc_bootstrap_thread(void *arg) {
     regs->ctrl1 = ctrl1;
     mx_nanosleep(mx_deadline_after(MX_MSEC(2)));
 
+    // Use ADMA2 for data transfers if the controller advertises support for
+    // it. The Pi3's controller does not populate its capability registers,
+    // so it continues down the PIO path.
+    if (regs->caps0 & EMMC_CAP_ADMA2) {
+        st = io_buffer_init(&emmc->adma_buffer, PAGE_SIZE, IO_BUFFER_RW);
+        if (st != NO_ERROR) {
+            xprintf("emmc: failed to allocate adma2 descriptor table, "
+                    "falling back to pio, retcode = %d\n", st);
+        } else {
+            regs->ctrl0 = (regs->ctrl0 & ~EMMC_HOSTCTRL_DMA_SELECT_MASK) |
+                          EMMC_HOSTCTRL_DMA_SELECT_ADMA2;
+            emmc->use_adma2 = true;
+        }
+    }
+
     // Disable all interrupts before we create the IRQ thread.
     regs->irqen = 0;
     regs->irq = 0xffffffff;
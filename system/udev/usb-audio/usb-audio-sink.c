@@ -4,10 +4,13 @@
 
 #include <ddk/device.h>
 #include <ddk/common/usb.h>
-#include <magenta/device/audio.h>
+#include <magenta/device/audio2.h>
 #include <magenta/device/usb.h>
 #include <magenta/hw/usb-audio.h>
-#include <sync/completion.h>
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/port.h>
+#include <magenta/threads.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -15,11 +18,23 @@
 
 #include "usb-audio.h"
 
-#define WRITE_REQ_COUNT 20
+// Number of isochronous requests kept in flight.  Each covers one USB frame
+// (1ms), so this bounds how far ahead of the ring read pointer the hardware
+// may fetch — and with it the end-to-end latency floor.
+#define WRITE_REQ_COUNT 6
 
-// Assume audio is paused and reset our timer logic
-// if no writes occur for 100ms
-#define WRITE_TIMEOUT_MS 100
+// USB frames to skip ahead of the current frame when (re)starting, to give
+// ourselves scheduling margin.
+#define START_FRAME_DELAY 2
+
+typedef union {
+    audio2_cmd_hdr_t hdr;
+    audio2_stream_cmd_set_format_req_t set_fmt_req;
+    audio2_rb_cmd_get_fifo_depth_req_t get_fifo_req;
+    audio2_rb_cmd_get_buffer_req_t get_buffer_req;
+    audio2_rb_cmd_start_req_t start_req;
+    audio2_rb_cmd_stop_req_t stop_req;
+} sink_req_packet_t;
 
 typedef struct {
     mx_device_t* mxdev;
@@ -27,17 +42,13 @@ typedef struct {
     uint8_t ep_addr;
     uint8_t interface_number;
     uint8_t alternate_setting;
+    int max_packet_size;
 
     // pool of free USB requests
     list_node_t free_write_reqs;
-    // mutex for synchronizing access to free_write_reqs, open and started
+    // mutex for synchronizing access to the request pool and ring state
     mtx_t mutex;
-    // completion signals free_write_reqs not empty
-    completion_t free_write_completion;
-    // mutex used to synchronize ioctl_audio_start() and ioctl_audio_stop()
-    mtx_t start_stop_mutex;
 
-    bool open;
     bool started;
     bool dead;
 
@@ -49,35 +60,33 @@ typedef struct {
     int num_channels;
     int audio_frame_size; // size of an audio frame
 
-    // partially filled iotxn with data left over from last write() call
-    // cur_txn->length marks size of left over data
-    iotxn_t* cur_txn;
+    // Audio2 stream/ring-buffer channels and the port the channel thread
+    // waits on.
+    mx_handle_t stream_ch;
+    mx_handle_t buffer_ch;
+    mx_handle_t port;
+    thrd_t port_thread;
+
+    // ring buffer shared with the client
+    mx_handle_t buffer_vmo;
+    void* buffer;
+    size_t buffer_size;
+    // driver read position within the ring, in bytes
+    size_t buffer_pos;
+    // bytes consumed since the last position notification
+    size_t notify_acc;
+    // notification interval in bytes, or 0 if notifications are disabled
+    size_t notify_bytes;
 
     // USB frame we started playing at
     uint64_t start_usb_frame;
     // last USB frame we scheduled a packet for
     uint64_t last_usb_frame;
-    // audio frames written since start_usb_frame
+    // audio frames sent since start_usb_frame
     uint64_t audio_frame_count;
-
-    // the last signals we reported
-    mx_signals_t signals;
-
 } usb_audio_sink_t;
 
-static void update_signals(usb_audio_sink_t* sink) {
-    mx_signals_t new_signals = 0;
-    if (sink->dead) {
-        new_signals |= (DEV_STATE_WRITABLE | DEV_STATE_ERROR);
-    } else if (!list_is_empty(&sink->free_write_reqs)) {
-        new_signals |= DEV_STATE_WRITABLE;
-    }
-    if (new_signals != sink->signals) {
-        device_state_set_clr(sink->mxdev, new_signals & ~sink->signals,
-                             sink->signals & ~new_signals);
-        sink->signals = new_signals;
-    }
-}
+static void usb_audio_sink_schedule_locked(usb_audio_sink_t* sink);
 
 static void usb_audio_sink_write_complete(iotxn_t* txn, void* cookie) {
     if (txn->status == ERR_PEER_CLOSED) {
@@ -86,34 +95,64 @@ static void usb_audio_sink_write_complete(iotxn_t* txn, void* cookie) {
     }
 
     usb_audio_sink_t* sink = (usb_audio_sink_t*)cookie;
-    // FIXME what to do with error here?
     mtx_lock(&sink->mutex);
     list_add_tail(&sink->free_write_reqs, &txn->node);
-    completion_signal(&sink->free_write_completion);
-    update_signals(sink);
+    if (sink->started && !sink->dead) {
+        usb_audio_sink_schedule_locked(sink);
+    }
     mtx_unlock(&sink->mutex);
 }
 
-static void usb_audio_sink_unbind(void* ctx) {
-    usb_audio_sink_t* sink = ctx;
-    sink->dead = true;
-    update_signals(sink);
-    completion_signal(&sink->free_write_completion);
-    device_remove(sink->mxdev);
-}
+// Fill 'txn' with the next 1ms worth of audio frames from the ring and queue
+// it for the next USB frame.  The hardware DMA-chains the in-flight requests,
+// so the ring is consumed at the isochronous clock rate without any
+// per-transfer involvement from the client.
+static void usb_audio_sink_schedule_locked(usb_audio_sink_t* sink) {
+    list_node_t* node;
+    while ((node = list_remove_head(&sink->free_write_reqs)) != NULL) {
+        iotxn_t* txn = containerof(node, iotxn_t, node);
+
+        uint64_t usb_frame = sink->last_usb_frame + 1;
+        // total number of audio frames we should have sent by usb_frame
+        uint64_t total_audio_frames = ((usb_frame - sink->start_usb_frame + 1) *
+                                       sink->sample_rate) / 1000;
+        uint64_t packet_frames = total_audio_frames - sink->audio_frame_count;
+        size_t packet_bytes = packet_frames * sink->audio_frame_size;
+
+        size_t offset = 0;
+        while (offset < packet_bytes) {
+            size_t copy = packet_bytes - offset;
+            if (copy > sink->buffer_size - sink->buffer_pos) {
+                copy = sink->buffer_size - sink->buffer_pos;
+            }
+            iotxn_copyto(txn, sink->buffer + sink->buffer_pos, copy, offset);
+            sink->buffer_pos += copy;
+            if (sink->buffer_pos == sink->buffer_size) {
+                sink->buffer_pos = 0;
+            }
+            offset += copy;
+        }
+        txn->length = packet_bytes;
 
-static void usb_audio_sink_free(usb_audio_sink_t* sink) {
-    iotxn_t* txn;
-    while ((txn = list_remove_head_type(&sink->free_write_reqs, iotxn_t, node)) != NULL) {
-        iotxn_release(txn);
-    }
-    free(sink->sample_rates);
-    free(sink);
-}
+        usb_iotxn_set_frame(txn, usb_frame);
+        iotxn_queue(sink->usb_mxdev, txn);
 
-static void usb_audio_sink_release(void* ctx) {
-    usb_audio_sink_t* sink = ctx;
-    usb_audio_sink_free(sink);
+        sink->last_usb_frame = usb_frame;
+        sink->audio_frame_count += packet_frames;
+
+        if (sink->notify_bytes > 0) {
+            sink->notify_acc += packet_bytes;
+            if (sink->notify_acc >= sink->notify_bytes) {
+                sink->notify_acc -= sink->notify_bytes;
+
+                audio2_rb_position_notify_t notify;
+                notify.hdr.transaction_id = AUDIO2_INVALID_TRANSACTION_ID;
+                notify.hdr.cmd = AUDIO2_RB_POSITION_NOTIFY;
+                notify.ring_buffer_pos = sink->buffer_pos;
+                mx_channel_write(sink->buffer_ch, 0, &notify, sizeof(notify), NULL, 0);
+            }
+        }
+    }
 }
 
 static uint64_t get_usb_current_frame(usb_audio_sink_t* sink) {
@@ -122,240 +161,402 @@ static uint64_t get_usb_current_frame(usb_audio_sink_t* sink) {
     mx_status_t status = device_op_ioctl(sink->usb_mxdev, IOCTL_USB_GET_CURRENT_FRAME,
                                  NULL, 0, &result, sizeof(result), &actual);
     if (status != NO_ERROR || actual != sizeof(result)) {
-        printf("get_usb_current_frame failed %u\n",status);
+        printf("get_usb_current_frame failed %u\n", status);
         return sink->last_usb_frame;
     }
     return result;
 }
 
-static mx_status_t usb_audio_sink_start(usb_audio_sink_t* sink) {
+static void usb_audio_sink_close_handle(mx_handle_t* handle) {
+    if (*handle != MX_HANDLE_INVALID) {
+        mx_handle_close(*handle);
+        *handle = MX_HANDLE_INVALID;
+    }
+}
+
+static void usb_audio_sink_stop_locked(usb_audio_sink_t* sink) {
+    if (!sink->started) {
+        return;
+    }
+    sink->started = false;
+
+    // switch back to primary interface, which also retires any queued
+    // requests; they return to the free pool through their completions
+    if (sink->alternate_setting != 0) {
+        usb_set_interface(sink->usb_mxdev, sink->interface_number, 0);
+    }
+}
+
+static void usb_audio_sink_release_buffer_locked(usb_audio_sink_t* sink) {
+    if (sink->buffer != NULL) {
+        mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)sink->buffer, sink->buffer_size);
+        sink->buffer = NULL;
+    }
+    usb_audio_sink_close_handle(&sink->buffer_vmo);
+    sink->buffer_size = 0;
+}
+
+static mx_status_t usb_audio_sink_get_fifo_depth(usb_audio_sink_t* sink,
+                                                 audio2_rb_cmd_get_fifo_depth_req_t req) {
+    audio2_rb_cmd_get_fifo_depth_resp_t resp;
+    resp.hdr = req.hdr;
+    resp.result = NO_ERROR;
+    // The hardware reads at most one packet per in-flight request ahead of
+    // the position we report.
+    resp.fifo_depth = WRITE_REQ_COUNT * sink->max_packet_size;
+
+    return mx_channel_write(sink->buffer_ch, 0, &resp, sizeof(resp), NULL, 0);
+}
+
+static mx_status_t usb_audio_sink_get_buffer(usb_audio_sink_t* sink,
+                                             audio2_rb_cmd_get_buffer_req_t req) {
+    audio2_rb_cmd_get_buffer_resp_t resp;
+    resp.hdr = req.hdr;
+
     mx_status_t status = NO_ERROR;
+    mx_handle_t ret_handle = MX_HANDLE_INVALID;
 
-    mtx_lock(&sink->start_stop_mutex);
-    if (sink->dead) {
-        status = ERR_PEER_CLOSED;
+    mtx_lock(&sink->mutex);
+
+    if (sink->started) {
+        status = ERR_BAD_STATE;
         goto out;
     }
-    if (sink->started) {
+    usb_audio_sink_release_buffer_locked(sink);
+
+    sink->buffer_size = req.min_ring_buffer_frames * sink->audio_frame_size;
+
+    if ((status = mx_vmo_create(sink->buffer_size, 0, &sink->buffer_vmo)) != NO_ERROR) {
         goto out;
     }
+    if ((status = mx_vmo_op_range(sink->buffer_vmo, MX_VMO_OP_COMMIT, 0,
+                                  sink->buffer_size, NULL, 0)) != NO_ERROR) {
+        goto fail;
+    }
+    if ((status = mx_vmar_map(mx_vmar_root_self(), 0, sink->buffer_vmo, 0, sink->buffer_size,
+                              MX_VM_FLAG_PERM_READ,
+                              (uintptr_t*)&sink->buffer)) != NO_ERROR) {
+        goto fail;
+    }
+    if ((status = mx_handle_duplicate(sink->buffer_vmo,
+                                      MX_RIGHT_TRANSFER | MX_RIGHT_READ |
+                                      MX_RIGHT_WRITE | MX_RIGHT_MAP,
+                                      &ret_handle)) != NO_ERROR) {
+        goto fail;
+    }
 
-    // switch to alternate interface if necessary
-    if (sink->alternate_setting != 0) {
-        usb_set_interface(sink->usb_mxdev, sink->interface_number, sink->alternate_setting);
+    if (req.notifications_per_ring > 0) {
+        sink->notify_bytes = sink->buffer_size / req.notifications_per_ring;
+    } else {
+        sink->notify_bytes = 0;
     }
-    sink->start_usb_frame = 0;
-    sink->cur_txn = NULL;
+    goto out;
 
+fail:
+    usb_audio_sink_release_buffer_locked(sink);
 out:
-    mtx_unlock(&sink->start_stop_mutex);
+    resp.result = status;
+    status = mx_channel_write(sink->buffer_ch, 0, &resp, sizeof(resp),
+                              ret_handle != MX_HANDLE_INVALID ? &ret_handle : NULL,
+                              ret_handle != MX_HANDLE_INVALID ? 1 : 0);
+    mtx_unlock(&sink->mutex);
     return status;
 }
 
-static mx_status_t usb_audio_sink_stop(usb_audio_sink_t* sink) {
+static mx_status_t usb_audio_sink_start(usb_audio_sink_t* sink,
+                                        audio2_rb_cmd_start_req_t req) {
+    audio2_rb_cmd_start_resp_t resp;
+    resp.hdr = req.hdr;
+    resp.start_ticks = 0;
+
     mx_status_t status = NO_ERROR;
 
-    mtx_lock(&sink->start_stop_mutex);
+    mtx_lock(&sink->mutex);
+
     if (sink->dead) {
         status = ERR_PEER_CLOSED;
         goto out;
     }
-    if (!sink->started) {
+    if (sink->started || sink->buffer == NULL) {
+        status = ERR_BAD_STATE;
         goto out;
     }
 
-    // switch back to primary interface
+    // switch to alternate interface if necessary
     if (sink->alternate_setting != 0) {
-        usb_set_interface(sink->usb_mxdev, sink->interface_number, 0);
+        usb_set_interface(sink->usb_mxdev, sink->interface_number, sink->alternate_setting);
     }
 
+    sink->buffer_pos = 0;
+    sink->notify_acc = 0;
+    sink->start_usb_frame = get_usb_current_frame(sink) + START_FRAME_DELAY;
+    sink->last_usb_frame = sink->start_usb_frame - 1;
+    sink->audio_frame_count = 0;
+    sink->started = true;
+
+    resp.start_ticks = mx_ticks_get();
+
+    // prime the transfer chain; completions keep it running from here
+    usb_audio_sink_schedule_locked(sink);
+
 out:
-    mtx_unlock(&sink->start_stop_mutex);
+    resp.result = status;
+    status = mx_channel_write(sink->buffer_ch, 0, &resp, sizeof(resp), NULL, 0);
+    mtx_unlock(&sink->mutex);
     return status;
 }
 
-static mx_status_t usb_audio_sink_open(void* ctx, mx_device_t** dev_out, uint32_t flags) {
-    usb_audio_sink_t* sink = ctx;
-    mx_status_t result;
+static mx_status_t usb_audio_sink_stop(usb_audio_sink_t* sink,
+                                       audio2_rb_cmd_stop_req_t req) {
+    audio2_rb_cmd_stop_resp_t resp;
+    resp.hdr = req.hdr;
 
     mtx_lock(&sink->mutex);
-    if (sink->open) {
-        result = ERR_ALREADY_BOUND;
+    if (!sink->started) {
+        resp.result = ERR_BAD_STATE;
     } else {
-        sink->open = true;
-        result = NO_ERROR;
+        usb_audio_sink_stop_locked(sink);
+        resp.result = NO_ERROR;
     }
+    mx_status_t status = mx_channel_write(sink->buffer_ch, 0, &resp, sizeof(resp), NULL, 0);
     mtx_unlock(&sink->mutex);
-
-    return result;
+    return status;
 }
 
-static mx_status_t usb_audio_sink_close(void* ctx, uint32_t flags) {
-    usb_audio_sink_t* sink = ctx;
+static mx_status_t usb_audio_sink_set_format(usb_audio_sink_t* sink,
+                                             audio2_stream_cmd_set_format_req_t req) {
+    audio2_stream_cmd_set_format_resp_t resp;
+    resp.hdr.transaction_id = req.hdr.transaction_id;
+    resp.hdr.cmd = AUDIO2_STREAM_CMD_SET_FORMAT;
+
+    mx_status_t status = NO_ERROR;
+    mx_handle_t ret_handle = MX_HANDLE_INVALID;
 
     mtx_lock(&sink->mutex);
-    sink->open = false;
-    mtx_unlock(&sink->mutex);
-    usb_audio_sink_stop(sink);
 
-    return NO_ERROR;
-}
+    if (sink->started) {
+        status = ERR_BAD_STATE;
+        goto out;
+    }
 
-static mx_status_t usb_audio_sink_write(void* ctx, const void* data, size_t length,
-                                        mx_off_t offset, size_t* actual) {
-    usb_audio_sink_t* sink = ctx;
+    if (req.channels != sink->num_channels ||
+        req.sample_format != AUDIO2_SAMPLE_FORMAT_16BIT) {
+        status = ERR_NOT_SUPPORTED;
+        goto out;
+    }
+    int i;
+    for (i = 0; i < sink->sample_rate_count; i++) {
+        if (req.frames_per_second == sink->sample_rates[i]) {
+            break;
+        }
+    }
+    if (i == sink->sample_rate_count) {
+        status = ERR_NOT_SUPPORTED;
+        goto out;
+    }
 
-    if (sink->dead) {
-        return ERR_PEER_CLOSED;
+    if (req.frames_per_second != sink->sample_rate) {
+        status = usb_audio_set_sample_rate(sink->usb_mxdev, sink->ep_addr,
+                                           req.frames_per_second);
+        if (status != NO_ERROR) {
+            goto out;
+        }
+        sink->sample_rate = req.frames_per_second;
     }
 
-    mx_status_t status = NO_ERROR;
-    size_t out_actual = length;
-
-    const void* src = data;
-
-    uint64_t current_frame = get_usb_current_frame(sink);
-    if (sink->start_usb_frame == 0 || current_frame > sink->last_usb_frame + WRITE_TIMEOUT_MS) {
-        // This is either the first time we are called or we have paused playing for awhile
-        // so reset our counters
-        sink->start_usb_frame = current_frame;
-        sink->last_usb_frame = current_frame;
-        sink->audio_frame_count = 0;
-    }
-
-    while (length > 0) {
-        // get a free iotxn (might be a partially filled one in sink->cur_txn
-        iotxn_t* txn;
-        mx_off_t txn_offset;
-        if (sink->cur_txn) {
-            txn = sink->cur_txn;
-            sink->cur_txn = NULL;
-            txn_offset = txn->length;
-        } else {
-            completion_wait(&sink->free_write_completion, MX_TIME_INFINITE);
-            if (sink->dead) {
-                return ERR_PEER_CLOSED;
+    // tear down any previous ring buffer channel and hand out a new one
+    usb_audio_sink_release_buffer_locked(sink);
+    usb_audio_sink_close_handle(&sink->buffer_ch);
+
+    if ((status = mx_channel_create(0, &sink->buffer_ch, &ret_handle)) != NO_ERROR) {
+        goto out;
+    }
+    status = mx_port_bind(sink->port, (uint64_t)sink->buffer_ch, sink->buffer_ch,
+                          MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED);
+    if (status != NO_ERROR) {
+        usb_audio_sink_close_handle(&sink->buffer_ch);
+        mx_handle_close(ret_handle);
+        ret_handle = MX_HANDLE_INVALID;
+    }
+
+out:
+    resp.result = status;
+    status = mx_channel_write(sink->stream_ch, 0, &resp, sizeof(resp),
+                              ret_handle != MX_HANDLE_INVALID ? &ret_handle : NULL,
+                              ret_handle != MX_HANDLE_INVALID ? 1 : 0);
+    mtx_unlock(&sink->mutex);
+    return status;
+}
+
+#define HANDLE_REQ(_cmd, _payload, _handler)        \
+    case _cmd:                                      \
+        if (req_size != sizeof(req._payload)) {     \
+            printf("usb-audio-sink: bad " #_payload \
+                   " length (%u != %zu)\n",         \
+                   req_size, sizeof(req._payload)); \
+            return -1;                              \
+        }                                           \
+        _handler(sink, req._payload);               \
+        break;
+static int usb_audio_sink_port_thread(void* arg) {
+    usb_audio_sink_t* sink = arg;
+
+    mx_io_packet_t port_out;
+    sink_req_packet_t req;
+
+    while ((sink->stream_ch != MX_HANDLE_INVALID) ||
+           (sink->buffer_ch != MX_HANDLE_INVALID)) {
+        mx_status_t status = mx_port_wait(sink->port, MX_TIME_INFINITE,
+                                          &port_out, sizeof(port_out));
+        if (status != NO_ERROR) {
+            break;
+        }
+
+        mx_handle_t channel = (mx_handle_t)port_out.hdr.key;
+        uint32_t req_size;
+
+        if (port_out.signals == MX_CHANNEL_READABLE) {
+            status = mx_channel_read(channel, 0, &req, NULL, sizeof(req), 0, &req_size, NULL);
+            if (status != NO_ERROR) {
+                if (channel == sink->buffer_ch) {
+                    break;
+                }
+                usb_audio_sink_close_handle(&sink->stream_ch);
+                continue;
             }
-            mtx_lock(&sink->mutex);
-            list_node_t* node = list_remove_head(&sink->free_write_reqs);
-            if (list_is_empty(&sink->free_write_reqs)) {
-                completion_reset(&sink->free_write_completion);
+
+            if (channel == sink->stream_ch) {
+                switch (req.hdr.cmd) {
+                    HANDLE_REQ(AUDIO2_STREAM_CMD_SET_FORMAT, set_fmt_req,
+                               usb_audio_sink_set_format);
+                default:
+                    printf("usb-audio-sink: unrecognized stream command %u\n", req.hdr.cmd);
+                    break;
+                }
+            } else if (channel == sink->buffer_ch) {
+                switch (req.hdr.cmd) {
+                    HANDLE_REQ(AUDIO2_RB_CMD_GET_FIFO_DEPTH, get_fifo_req,
+                               usb_audio_sink_get_fifo_depth);
+                    HANDLE_REQ(AUDIO2_RB_CMD_GET_BUFFER, get_buffer_req,
+                               usb_audio_sink_get_buffer);
+                    HANDLE_REQ(AUDIO2_RB_CMD_START, start_req, usb_audio_sink_start);
+                    HANDLE_REQ(AUDIO2_RB_CMD_STOP, stop_req, usb_audio_sink_stop);
+                default:
+                    printf("usb-audio-sink: unrecognized buffer command %u\n", req.hdr.cmd);
+                    break;
+                }
             }
-            mtx_unlock(&sink->mutex);
-            if (!node) {
-                // shouldn't happen!
-                status = ERR_INTERNAL;
-                goto out;
+        } else if (port_out.signals == MX_CHANNEL_PEER_CLOSED) {
+            if (channel == sink->stream_ch) {
+                usb_audio_sink_close_handle(&sink->stream_ch);
+            }
+            if (channel == sink->buffer_ch) {
+                break;
             }
-            txn = containerof(node, iotxn_t, node);
-            txn_offset = 0;
-        }
-
-        uint64_t current_usb_frame = sink->last_usb_frame + 1;
-        // total number of frames we should have sent by current_usb_frame
-        uint64_t total_audio_frames = ((current_usb_frame - sink->start_usb_frame) *
-                                       sink->sample_rate) / 1000;
-        uint64_t current_audio_frames = total_audio_frames - sink->audio_frame_count;
-        uint64_t packet_bytes = current_audio_frames * sink->audio_frame_size;
-        uint64_t copy = packet_bytes - txn_offset;
-        if (copy <= length) {
-            iotxn_copyto(txn, src, copy, txn_offset);
-            txn->length = txn_offset + copy;
-            src += copy;
-            length -= copy;
-
-            usb_iotxn_set_frame(txn, current_usb_frame);
-            iotxn_queue(sink->usb_mxdev, txn);
-
-            sink->last_usb_frame = current_usb_frame;
-            sink->audio_frame_count += current_audio_frames;
-        } else {
-            // not enough data remaining - save for next time
-            sink->cur_txn = txn;
-            iotxn_copyto(txn, src, length, 0);
-            txn->length = length;
-            length = 0;
         }
     }
 
-out:
-    update_signals(sink);
-    if (status == NO_ERROR) {
-        *actual = out_actual;
-    }
-    return status;
+    mtx_lock(&sink->mutex);
+    usb_audio_sink_stop_locked(sink);
+    usb_audio_sink_release_buffer_locked(sink);
+    usb_audio_sink_close_handle(&sink->buffer_ch);
+    usb_audio_sink_close_handle(&sink->stream_ch);
+    usb_audio_sink_close_handle(&sink->port);
+    mtx_unlock(&sink->mutex);
+    return 0;
 }
+#undef HANDLE_REQ
 
 static mx_status_t usb_audio_sink_ioctl(void* ctx, uint32_t op, const void* in_buf,
                                         size_t in_len, void* out_buf, size_t out_len,
                                         size_t* out_actual) {
     usb_audio_sink_t* sink = ctx;
 
-    switch (op) {
-    case IOCTL_AUDIO_GET_DEVICE_TYPE: {
-        int* reply = out_buf;
-        if (out_len < sizeof(*reply)) return ERR_BUFFER_TOO_SMALL;
-        *reply = AUDIO_TYPE_SINK;
-        *out_actual = sizeof(*reply);
-        return NO_ERROR;
-    }
-    case IOCTL_AUDIO_GET_SAMPLE_RATE_COUNT: {
-        int* reply = out_buf;
-        if (out_len < sizeof(*reply)) return ERR_BUFFER_TOO_SMALL;
-        *reply = sink->sample_rate_count;
-        *out_actual = sizeof(*reply);
-        return NO_ERROR;
-    }
-    case IOCTL_AUDIO_GET_SAMPLE_RATES: {
-        size_t reply_size = sink->sample_rate_count * sizeof(uint32_t);
-        if (out_len < reply_size) return ERR_BUFFER_TOO_SMALL;
-        memcpy(out_buf, sink->sample_rates, reply_size);
-        *out_actual = reply_size;
-        return NO_ERROR;
-    }
-    case IOCTL_AUDIO_GET_SAMPLE_RATE: {
-        uint32_t* reply = out_buf;
-        if (out_len < sizeof(*reply)) return ERR_BUFFER_TOO_SMALL;
-        *reply = sink->sample_rate;
-        *out_actual = sizeof(*reply);
-        return NO_ERROR;
-    }
-    case IOCTL_AUDIO_SET_SAMPLE_RATE: {
-        if (in_len < sizeof(uint32_t))  return ERR_BUFFER_TOO_SMALL;
-        uint32_t sample_rate = *((uint32_t *)in_buf);
-        if (sample_rate == sink->sample_rate) return NO_ERROR;
-        // validate sample rate
-        int i;
-        for (i = 0; i < sink->sample_rate_count; i++) {
-            if (sample_rate == sink->sample_rates[i]) {
-                break;
-            }
-        }
-        if (i == sink->sample_rate_count) {
-            return ERR_INVALID_ARGS;
-        }
-        mx_status_t status = usb_audio_set_sample_rate(sink->usb_mxdev, sink->ep_addr, sample_rate);
-        if (status == NO_ERROR) {
-            sink->sample_rate = sample_rate;
-        }
-        return status;
+    if (op != AUDIO2_IOCTL_GET_CHANNEL) {
+        return ERR_NOT_SUPPORTED;
     }
-    case IOCTL_AUDIO_START:
-        return usb_audio_sink_start(sink);
-    case IOCTL_AUDIO_STOP:
-        return usb_audio_sink_stop(sink);
+    if (out_len < sizeof(mx_handle_t)) {
+        return ERR_BUFFER_TOO_SMALL;
     }
 
-    return ERR_NOT_SUPPORTED;
+    mtx_lock(&sink->mutex);
+
+    mx_status_t status;
+    if (sink->dead) {
+        status = ERR_PEER_CLOSED;
+        goto out;
+    }
+    if (sink->stream_ch != MX_HANDLE_INVALID) {
+        // only one client at a time
+        status = ERR_ALREADY_BOUND;
+        goto out;
+    }
+
+    mx_handle_t ret_handle;
+    if ((status = mx_channel_create(0, &sink->stream_ch, &ret_handle)) != NO_ERROR) {
+        goto out;
+    }
+    if ((status = mx_port_create(0, &sink->port)) != NO_ERROR) {
+        usb_audio_sink_close_handle(&sink->stream_ch);
+        mx_handle_close(ret_handle);
+        goto out;
+    }
+    status = mx_port_bind(sink->port, (uint64_t)sink->stream_ch, sink->stream_ch,
+                          MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED);
+    if (status != NO_ERROR) {
+        usb_audio_sink_close_handle(&sink->stream_ch);
+        usb_audio_sink_close_handle(&sink->port);
+        mx_handle_close(ret_handle);
+        goto out;
+    }
+
+    int thrd_rc = thrd_create_with_name(&sink->port_thread, usb_audio_sink_port_thread,
+                                        sink, "usb-audio-sink-port-thread");
+    if (thrd_rc != thrd_success) {
+        usb_audio_sink_close_handle(&sink->stream_ch);
+        usb_audio_sink_close_handle(&sink->port);
+        mx_handle_close(ret_handle);
+        status = thrd_status_to_mx_status(thrd_rc);
+        goto out;
+    }
+    thrd_detach(sink->port_thread);
+
+    *((mx_handle_t*)out_buf) = ret_handle;
+    *out_actual = sizeof(ret_handle);
+
+out:
+    mtx_unlock(&sink->mutex);
+    return status;
+}
+
+static void usb_audio_sink_unbind(void* ctx) {
+    usb_audio_sink_t* sink = ctx;
+    mtx_lock(&sink->mutex);
+    sink->dead = true;
+    usb_audio_sink_stop_locked(sink);
+    mtx_unlock(&sink->mutex);
+    device_remove(sink->mxdev);
+}
+
+static void usb_audio_sink_free(usb_audio_sink_t* sink) {
+    iotxn_t* txn;
+    while ((txn = list_remove_head_type(&sink->free_write_reqs, iotxn_t, node)) != NULL) {
+        iotxn_release(txn);
+    }
+    usb_audio_sink_release_buffer_locked(sink);
+    free(sink->sample_rates);
+    free(sink);
+}
+
+static void usb_audio_sink_release(void* ctx) {
+    usb_audio_sink_t* sink = ctx;
+    usb_audio_sink_free(sink);
 }
 
 static mx_protocol_device_t usb_audio_sink_device_proto = {
     .version = DEVICE_OPS_VERSION,
     .unbind = usb_audio_sink_unbind,
     .release = usb_audio_sink_release,
-    .open = usb_audio_sink_open,
-    .close = usb_audio_sink_close,
-    .write = usb_audio_sink_write,
     .ioctl = usb_audio_sink_ioctl,
 };
 
@@ -385,25 +586,29 @@ mx_status_t usb_audio_sink_create(mx_device_t* device, int index,
     }
 
     list_initialize(&sink->free_write_reqs);
+    mtx_init(&sink->mutex, mtx_plain);
 
     sink->usb_mxdev = device;
     sink->ep_addr = ep->bEndpointAddress;
     sink->interface_number = intf->bInterfaceNumber;
     sink->alternate_setting = intf->bAlternateSetting;
-    int packet_size = usb_ep_max_packet(ep);
+    sink->stream_ch = MX_HANDLE_INVALID;
+    sink->buffer_ch = MX_HANDLE_INVALID;
+    sink->port = MX_HANDLE_INVALID;
+    sink->buffer_vmo = MX_HANDLE_INVALID;
+    sink->max_packet_size = usb_ep_max_packet(ep);
 
     for (int i = 0; i < WRITE_REQ_COUNT; i++) {
-        iotxn_t* txn = usb_alloc_iotxn(sink->ep_addr, packet_size);
+        iotxn_t* txn = usb_alloc_iotxn(sink->ep_addr, sink->max_packet_size);
         if (!txn) {
             usb_audio_sink_free(sink);
             return ERR_NO_MEMORY;
         }
-        txn->length = packet_size;
+        txn->length = sink->max_packet_size;
         txn->complete_cb = usb_audio_sink_write_complete;
         txn->cookie = sink;
         list_add_head(&sink->free_write_reqs, &txn->node);
     }
-    completion_signal(&sink->free_write_completion);
 
     // only support 2 channel with 16 bit samples for now
     sink->num_channels = 2;
@@ -430,7 +635,7 @@ mx_status_t usb_audio_sink_create(mx_device_t* device, int index,
         .name = name,
         .ctx = sink,
         .ops = &usb_audio_sink_device_proto,
-        .proto_id = MX_PROTOCOL_AUDIO,
+        .proto_id = MX_PROTOCOL_AUDIO2_OUTPUT,
     };
 
     mx_status_t status = device_add(device, &args, &sink->mxdev);
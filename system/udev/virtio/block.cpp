@@ -7,6 +7,8 @@
 #include <ddk/protocol/block.h>
 #include <inttypes.h>
 #include <magenta/compiler.h>
+#include <magenta/syscalls.h>
+#include <mxalloc/new.h>
 #include <mxtl/auto_lock.h>
 #include <pretty/hexdump.h>
 #include <stdint.h>
@@ -30,6 +32,7 @@
 #define VIRTIO_BLK_F_FLUSH    (1<<9)
 #define VIRTIO_BLK_F_TOPOLOGY (1<<10)
 #define VIRTIO_BLK_F_CONFIG_WCE (1<<11)
+#define VIRTIO_BLK_F_MQ       (1<<12)
 
 #define VIRTIO_BLK_T_IN         0
 #define VIRTIO_BLK_T_OUT        1
@@ -118,24 +121,56 @@ mx_status_t BlockDevice::Init() {
     // reset the device
     Reset();
 
-    // read our configuration
-    CopyDeviceConfig(&config_, sizeof(config_));
+    // ack and set the driver status bit
+    StatusAcknowledgeDriver();
+
+    // negotiate features; we only care about multiqueue, plus VERSION_1
+    // which virtio 1.0 devices require us to ack
+    uint64_t features = ReadDeviceFeatures();
+    uint64_t ack = features & (VIRTIO_F_VERSION_1 | VIRTIO_BLK_F_MQ);
+    SetDriverFeatures(ack);
+    if (!StatusFeaturesOK()) {
+        VIRTIO_ERROR("device rejected our feature set %#" PRIx64 "\n", ack);
+        return ERR_NOT_SUPPORTED;
+    }
+
+    // read our configuration; legacy devices only expose the fields up
+    // through blk_size
+    size_t config_size = trans_ ? offsetof(virtio_blk_config, physical_block_exp)
+                                : sizeof(config_);
+    CopyDeviceConfig(&config_, config_size);
 
     LTRACEF("capacity %#" PRIx64 "\n", config_.capacity);
     LTRACEF("size_max %#x\n", config_.size_max);
     LTRACEF("seg_max  %#x\n", config_.seg_max);
     LTRACEF("blk_size %#x\n", config_.blk_size);
 
-    // ack and set the driver status bit
-    StatusAcknowledgeDriver();
-
-    // XXX check features bits and ack/nak them
-
-    // allocate the main vring
-    auto err = vring_.Init(0, 128); // 128 matches legacy pci
-    if (err < 0) {
-        VIRTIO_ERROR("failed to allocate vring\n");
-        return err;
+    // with multiqueue, spread the rings across cpus so queue kicks and
+    // completions on different cpus don't serialize on one ring
+    if ((ack & VIRTIO_BLK_F_MQ) && (config_.num_queues > 1)) {
+        num_rings_ = config_.num_queues;
+        uint32_t cpus = mx_system_get_num_cpus();
+        if (num_rings_ > cpus) {
+            num_rings_ = (uint16_t)cpus;
+        }
+        if (num_rings_ > max_rings) {
+            num_rings_ = max_rings;
+        }
+    }
+    LTRACEF("num_rings %u\n", num_rings_);
+
+    // allocate the vrings
+    for (uint16_t i = 0; i < num_rings_; i++) {
+        AllocChecker ac;
+        rings_[i].reset(new (&ac) Ring(this));
+        if (!ac.check()) {
+            return ERR_NO_MEMORY;
+        }
+        auto err = rings_[i]->Init(i, 128); // 128 matches legacy pci
+        if (err < 0) {
+            VIRTIO_ERROR("failed to allocate vring %u\n", i);
+            return err;
+        }
     }
 
     // allocate a queue of block requests
@@ -186,47 +221,52 @@ mx_status_t BlockDevice::Init() {
 void BlockDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
 
-    // parse our descriptor chain, add back to the free queue
-    auto free_chain = [this](vring_used_elem* used_elem) {
-        uint32_t i = (uint16_t)used_elem->id;
-        struct vring_desc* desc = vring_.DescFromIndex((uint16_t)i);
-        auto head_desc = desc; // save the first element
-        for (;;) {
-            int next;
+    // handle completions on every ring in this single pass
+    for (uint16_t r = 0; r < num_rings_; r++) {
+        Ring* ring = rings_[r].get();
+
+        // parse our descriptor chain, add back to the free queue
+        auto free_chain = [this, ring](vring_used_elem* used_elem) {
+            uint32_t i = (uint16_t)used_elem->id;
+            struct vring_desc* desc = ring->DescFromIndex((uint16_t)i);
+            auto head_desc = desc; // save the first element
+            for (;;) {
+                int next;
 
 #if LOCAL_TRACE > 0
-            virtio_dump_desc(desc);
+                virtio_dump_desc(desc);
 #endif
 
-            if (desc->flags & VRING_DESC_F_NEXT) {
-                next = desc->next;
-            } else {
-                /* end of chain */
-                next = -1;
-            }
+                if (desc->flags & VRING_DESC_F_NEXT) {
+                    next = desc->next;
+                } else {
+                    /* end of chain */
+                    next = -1;
+                }
 
-            vring_.FreeDesc((uint16_t)i);
+                ring->FreeDesc((uint16_t)i);
 
-            if (next < 0)
-                break;
-            i = next;
-            desc = vring_.DescFromIndex((uint16_t)i);
-        }
+                if (next < 0)
+                    break;
+                i = next;
+                desc = ring->DescFromIndex((uint16_t)i);
+            }
 
-        // search our pending txn list to see if this completes it
-        iotxn_t* txn;
-        list_for_every_entry (&iotxn_list, txn, iotxn_t, node) {
-            if (txn->context == head_desc) {
-                LTRACEF("completes txn %p\n", txn);
-                list_delete(&txn->node);
-                iotxn_complete(txn, NO_ERROR, txn->length);
-                break;
+            // search our pending txn list to see if this completes it
+            iotxn_t* txn;
+            list_for_every_entry (&iotxn_list, txn, iotxn_t, node) {
+                if (txn->context == head_desc) {
+                    LTRACEF("completes txn %p\n", txn);
+                    list_delete(&txn->node);
+                    iotxn_complete(txn, NO_ERROR, txn->length);
+                    break;
+                }
             }
-        }
-    };
+        };
 
-    // tell the ring to find free chains and hand it back to our lambda
-    vring_.IrqRingUpdate(free_chain);
+        // tell the ring to find free chains and hand it back to our lambda
+        ring->IrqRingUpdate(free_chain);
+    }
 }
 
 void BlockDevice::IrqConfigChange() {
@@ -250,6 +290,11 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     // constrain to device capacity
     txn->length = MIN(txn->length, GetSize() - txn->offset);
 
+    // pick a ring for this request; round robin is close enough to
+    // per-cpu distribution without a way to observe our current cpu
+    Ring* ring = rings_[next_ring_].get();
+    next_ring_ = (uint16_t)((next_ring_ + 1) % num_rings_);
+
     // allocate and start filling out a block request
     auto index = alloc_blk_req();
     LTRACEF("request index %u\n", index);
@@ -262,7 +307,7 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
 
     /* put together a transfer */
     uint16_t i;
-    auto desc = vring_.AllocDescChain(3, &i);
+    auto desc = ring->AllocDescChain(3, &i);
     LTRACEF("after alloc chain desc %p, i %u\n", desc, i);
 
     /* point the iotxn at this head descriptor */
@@ -278,7 +323,7 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
 #endif
 
     /* set up the descriptor pointing to the buffer */
-    desc = vring_.DescFromIndex(desc->next);
+    desc = ring->DescFromIndex(desc->next);
 
     iotxn_physmap(txn);
 
@@ -294,7 +339,7 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
 #endif
 
     /* set up the descriptor pointing to the response */
-    desc = vring_.DescFromIndex(desc->next);
+    desc = ring->DescFromIndex(desc->next);
     desc->addr = blk_res_pa_ + index;
     desc->len = 1;
     desc->flags = VRING_DESC_F_WRITE;
@@ -307,10 +352,10 @@ void BlockDevice::QueueReadWriteTxn(iotxn_t* txn) {
     list_add_tail(&iotxn_list, &txn->node);
 
     /* submit the transfer */
-    vring_.SubmitChain(i);
+    ring->SubmitChain(i);
 
     /* kick it off */
-    vring_.Kick();
+    ring->Kick();
 }
 
 } // namespace virtio
@@ -7,6 +7,7 @@
 #include "ring.h"
 
 #include <magenta/compiler.h>
+#include <mxtl/unique_ptr.h>
 #include <stdlib.h>
 
 namespace virtio {
@@ -36,8 +37,12 @@ private:
 
     void QueueReadWriteTxn(iotxn_t* txn);
 
-    // the main virtio ring
-    Ring vring_ = {this};
+    // one ring per request queue; multiqueue devices get up to one per cpu
+    static const uint16_t max_rings = 8;
+
+    mxtl::unique_ptr<Ring> rings_[max_rings];
+    uint16_t num_rings_ = 1;
+    uint16_t next_ring_ = 0; // round robin submission cursor
 
     // saved block device configuration out of the pci config BAR
     struct virtio_blk_config {
@@ -50,6 +55,14 @@ private:
             uint8_t sectors;
         } geometry;
         uint32_t blk_size;
+        // the fields below are only valid on virtio 1.0 devices
+        uint8_t physical_block_exp;
+        uint8_t alignment_offset;
+        uint16_t min_io_size;
+        uint32_t opt_io_size;
+        uint8_t writeback;
+        uint8_t unused0;
+        uint16_t num_queues; // valid with VIRTIO_BLK_F_MQ
     } config_ __PACKED = {};
 
     struct virtio_blk_req {
@@ -255,15 +255,19 @@ void Device::WriteConfigBar(uint16_t offset, uint8_t val) {
 }
 
 mx_status_t Device::CopyDeviceConfig(void* _buf, size_t len) {
+    uint8_t* buf = (uint8_t*)_buf;
+
     if (!trans_) {
-        assert(0);
-        return 0;
+        volatile uint8_t* config = (volatile uint8_t*)mmio_regs_.device_config;
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = config[i];
+        }
+        return NO_ERROR;
     }
 
     // XXX handle MSI vs noMSI
     size_t offset = VIRTIO_PCI_CONFIG_OFFSET_NOMSI;
 
-    uint8_t* buf = (uint8_t*)_buf;
     for (size_t i = 0; i < len; i++) {
         if (bar0_pio_base_) {
             buf[i] = ReadConfigBar((offset + i) & 0xffff);
@@ -276,6 +280,41 @@ mx_status_t Device::CopyDeviceConfig(void* _buf, size_t len) {
     return NO_ERROR;
 }
 
+uint64_t Device::ReadDeviceFeatures() {
+    if (trans_) {
+        if (bar0_pio_base_) {
+            // legacy devices only have 32 feature bits
+            return inpd((bar0_pio_base_ + VIRTIO_PCI_DEVICE_FEATURES) & 0xffff);
+        }
+        // XXX implement
+        assert(0);
+        return 0;
+    }
+
+    mmio_regs_.common_config->device_feature_select = 0;
+    uint64_t features = mmio_regs_.common_config->device_feature;
+    mmio_regs_.common_config->device_feature_select = 1;
+    features |= (uint64_t)mmio_regs_.common_config->device_feature << 32;
+    return features;
+}
+
+void Device::SetDriverFeatures(uint64_t features) {
+    if (trans_) {
+        if (bar0_pio_base_) {
+            outpd((bar0_pio_base_ + VIRTIO_PCI_DRIVER_FEATURES) & 0xffff, (uint32_t)features);
+        } else {
+            // XXX implement
+            assert(0);
+        }
+        return;
+    }
+
+    mmio_regs_.common_config->driver_feature_select = 0;
+    mmio_regs_.common_config->driver_feature = (uint32_t)features;
+    mmio_regs_.common_config->driver_feature_select = 1;
+    mmio_regs_.common_config->driver_feature = (uint32_t)(features >> 32);
+}
+
 void Device::SetRing(uint16_t index, uint16_t count, mx_paddr_t pa_desc, mx_paddr_t pa_avail, mx_paddr_t pa_used) {
     LTRACEF("index %u, count %u, pa_desc %#" PRIxPTR ", pa_avail %#" PRIxPTR ", pa_used %#" PRIxPTR "\n",
             index, count, pa_desc, pa_avail, pa_used);
@@ -333,6 +372,15 @@ void Device::StatusAcknowledgeDriver() {
     }
 }
 
+bool Device::StatusFeaturesOK() {
+    if (trans_) {
+        // legacy devices have no FEATURES_OK handshake
+        return true;
+    }
+    mmio_regs_.common_config->device_status |= VIRTIO_STATUS_FEATURES_OK;
+    return mmio_regs_.common_config->device_status & VIRTIO_STATUS_FEATURES_OK;
+}
+
 void Device::StatusDriverOK() {
     if (trans_) {
         uint8_t val = ReadConfigBar(VIRTIO_PCI_DEVICE_STATUS);
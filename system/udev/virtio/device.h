@@ -44,8 +44,14 @@ protected:
     void WriteConfigBar(uint16_t offset, uint8_t val);
     mx_status_t CopyDeviceConfig(void* _buf, size_t len);
 
+    // feature negotiation
+    uint64_t ReadDeviceFeatures();
+    void SetDriverFeatures(uint64_t features);
+
     void Reset();
     void StatusAcknowledgeDriver();
+    // returns false if the device rejected the negotiated feature set
+    bool StatusFeaturesOK();
     void StatusDriverOK();
 
     static int IrqThreadEntry(void* arg);
@@ -0,0 +1,510 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "net.h"
+
+#include <inttypes.h>
+#include <magenta/compiler.h>
+#include <magenta/syscalls.h>
+#include <mxalloc/new.h>
+#include <mxtl/auto_lock.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "trace.h"
+#include "utils.h"
+
+#define LOCAL_TRACE 0
+
+// clang-format off
+#define VIRTIO_NET_F_CSUM       (1<<0)
+#define VIRTIO_NET_F_GUEST_CSUM (1<<1)
+#define VIRTIO_NET_F_MAC        (1<<5)
+#define VIRTIO_NET_F_GSO        (1<<6)
+#define VIRTIO_NET_F_GUEST_TSO4 (1<<7)
+#define VIRTIO_NET_F_GUEST_TSO6 (1<<8)
+#define VIRTIO_NET_F_GUEST_ECN  (1<<9)
+#define VIRTIO_NET_F_GUEST_UFO  (1<<10)
+#define VIRTIO_NET_F_HOST_TSO4  (1<<11)
+#define VIRTIO_NET_F_HOST_TSO6  (1<<12)
+#define VIRTIO_NET_F_HOST_ECN   (1<<13)
+#define VIRTIO_NET_F_HOST_UFO   (1<<14)
+#define VIRTIO_NET_F_MRG_RXBUF  (1<<15)
+#define VIRTIO_NET_F_STATUS     (1<<16)
+#define VIRTIO_NET_F_CTRL_VQ    (1<<17)
+#define VIRTIO_NET_F_MQ         (1<<22)
+
+#define VIRTIO_NET_S_LINK_UP    (1<<0)
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM 1
+#define VIRTIO_NET_HDR_F_DATA_VALID 2
+
+#define VIRTIO_NET_HDR_GSO_NONE 0
+
+#define VIRTIO_NET_OK   0
+#define VIRTIO_NET_ERR  1
+
+#define VIRTIO_NET_CTRL_MQ              4
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET 0
+// clang-format on
+
+namespace virtio {
+
+// prepended to every frame on the wire; legacy devices without
+// VIRTIO_NET_F_MRG_RXBUF omit the trailing num_buffers field
+struct virtio_net_hdr {
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+    uint16_t num_buffers;
+} __PACKED;
+
+// ethermac protocol hooks
+
+mx_status_t NetDevice::virtio_net_query(mx_device_t* dev, uint32_t options, ethmac_info_t* info) {
+    LTRACEF("dev %p, options %u\n", dev, options);
+
+    NetDevice* nd = static_cast<NetDevice*>(dev->ctx);
+
+    return nd->Query(options, info);
+}
+
+void NetDevice::virtio_net_stop(mx_device_t* dev) {
+    LTRACEF("dev %p\n", dev);
+
+    NetDevice* nd = static_cast<NetDevice*>(dev->ctx);
+
+    nd->Stop();
+}
+
+mx_status_t NetDevice::virtio_net_start(mx_device_t* dev, ethmac_ifc_t* ifc, void* cookie) {
+    LTRACEF("dev %p, ifc %p\n", dev, ifc);
+
+    NetDevice* nd = static_cast<NetDevice*>(dev->ctx);
+
+    return nd->Start(ifc, cookie);
+}
+
+void NetDevice::virtio_net_send(mx_device_t* dev, uint32_t options, void* data, size_t length) {
+    LTRACEF("dev %p, data %p, length %zu\n", dev, data, length);
+
+    NetDevice* nd = static_cast<NetDevice*>(dev->ctx);
+
+    nd->Send(options, data, length);
+}
+
+NetDevice::NetDevice(mx_device_t* bus_device)
+    : Device(bus_device) {
+    // so that Bind() knows how much io space to allocate
+    bar0_size_ = 0x40;
+}
+
+NetDevice::~NetDevice() {
+    // TODO: clean up allocated physical memory
+}
+
+mx_status_t NetDevice::Init() {
+    LTRACE_ENTRY;
+
+    // reset the device
+    Reset();
+
+    // ack and set the driver status bit
+    StatusAcknowledgeDriver();
+
+    // negotiate features: multiqueue to spread traffic across cpus, the
+    // checksum offloads, and VERSION_1 which virtio 1.0 devices require
+    // us to ack
+    uint64_t features = ReadDeviceFeatures();
+    uint64_t ack = features & (VIRTIO_F_VERSION_1 | VIRTIO_NET_F_MAC | VIRTIO_NET_F_STATUS |
+                               VIRTIO_NET_F_CSUM | VIRTIO_NET_F_GUEST_CSUM |
+                               VIRTIO_NET_F_HOST_TSO4 | VIRTIO_NET_F_HOST_TSO6 |
+                               VIRTIO_NET_F_CTRL_VQ | VIRTIO_NET_F_MQ);
+    // extra queue pairs are enabled with a control queue command
+    if (!(ack & VIRTIO_NET_F_CTRL_VQ))
+        ack &= ~VIRTIO_NET_F_MQ;
+    // the spec only allows tso when tx checksumming was negotiated
+    if (!(ack & VIRTIO_NET_F_CSUM))
+        ack &= ~(VIRTIO_NET_F_HOST_TSO4 | VIRTIO_NET_F_HOST_TSO6);
+    SetDriverFeatures(ack);
+    if (!StatusFeaturesOK()) {
+        VIRTIO_ERROR("device rejected our feature set %#" PRIx64 "\n", ack);
+        return ERR_NOT_SUPPORTED;
+    }
+    features_ = ack;
+
+    // legacy devices without MRG_RXBUF use the short header without the
+    // num_buffers field
+    hdr_size_ = (trans_ && !(ack & VIRTIO_NET_F_MRG_RXBUF))
+                    ? offsetof(virtio_net_hdr, num_buffers)
+                    : sizeof(virtio_net_hdr);
+
+    // read our configuration; max_virtqueue_pairs is only there with MQ
+    size_t config_size = (ack & VIRTIO_NET_F_MQ) ? sizeof(config_)
+                                                 : offsetof(virtio_net_config, max_virtqueue_pairs);
+    CopyDeviceConfig(&config_, config_size);
+
+    if (!(ack & VIRTIO_NET_F_MAC)) {
+        // no mac from the device; fall back to a fixed locally
+        // administered address
+        static const uint8_t fallback_mac[ETH_MAC_SIZE] = {0x02, 0x1a, 0xf4, 0x00, 0x00, 0x01};
+        memcpy(config_.mac, fallback_mac, sizeof(fallback_mac));
+    }
+
+    LTRACEF("mac %02x:%02x:%02x:%02x:%02x:%02x\n",
+            config_.mac[0], config_.mac[1], config_.mac[2],
+            config_.mac[3], config_.mac[4], config_.mac[5]);
+    LTRACEF("status %#x\n", config_.status);
+    LTRACEF("max_virtqueue_pairs %u\n", config_.max_virtqueue_pairs);
+
+    // with multiqueue, spread the queue pairs across cpus so senders on
+    // different cpus don't serialize on one tx ring
+    if ((features_ & VIRTIO_NET_F_MQ) && (config_.max_virtqueue_pairs > 1)) {
+        num_pairs_ = config_.max_virtqueue_pairs;
+        uint32_t cpus = mx_system_get_num_cpus();
+        if (num_pairs_ > cpus) {
+            num_pairs_ = (uint16_t)cpus;
+        }
+        if (num_pairs_ > max_pairs) {
+            num_pairs_ = max_pairs;
+        }
+    }
+    LTRACEF("num_pairs %u\n", num_pairs_);
+
+    // allocate the vrings and frame buffers; pair n uses virtqueues 2n
+    // (receive) and 2n+1 (transmit)
+    for (uint16_t n = 0; n < num_pairs_; n++) {
+        QueuePair* qp = &pairs_[n];
+
+        AllocChecker ac;
+        qp->rx.reset(new (&ac) Ring(this));
+        if (!ac.check()) {
+            return ERR_NO_MEMORY;
+        }
+        auto err = qp->rx->Init((uint16_t)(n * 2), 256); // 256 matches legacy pci
+        if (err < 0) {
+            VIRTIO_ERROR("failed to allocate rx vring %u\n", n);
+            return err;
+        }
+
+        qp->tx.reset(new (&ac) Ring(this));
+        if (!ac.check()) {
+            return ERR_NO_MEMORY;
+        }
+        err = qp->tx->Init((uint16_t)(n * 2 + 1), 256);
+        if (err < 0) {
+            VIRTIO_ERROR("failed to allocate tx vring %u\n", n);
+            return err;
+        }
+
+        size_t size = (rx_buf_count + tx_buf_count) * buf_size;
+        mx_status_t r = map_contiguous_memory(size, &qp->buf_va, &qp->buf_pa);
+        if (r < 0) {
+            VIRTIO_ERROR("cannot alloc frame buffers %d\n", r);
+            return r;
+        }
+
+        LTRACEF("pair %u buffers at %#" PRIxPTR ", physical address %#" PRIxPTR "\n",
+                n, qp->buf_va, qp->buf_pa);
+
+        // post all of the rx buffers; the rings are kicked after DRIVER_OK
+        for (size_t b = 0; b < rx_buf_count; b++) {
+            uint16_t i;
+            auto desc = qp->rx->AllocDescChain(1, &i);
+            desc->addr = qp->buf_pa + b * buf_size;
+            desc->len = buf_size;
+            desc->flags = VRING_DESC_F_WRITE;
+            qp->rx->SubmitChain(i);
+        }
+    }
+
+    // the control queue sits after every queue pair the device offers
+    if (features_ & VIRTIO_NET_F_CTRL_VQ) {
+        AllocChecker ac;
+        ctrl_ring_.reset(new (&ac) Ring(this));
+        if (!ac.check()) {
+            return ERR_NO_MEMORY;
+        }
+        uint16_t index = (features_ & VIRTIO_NET_F_MQ)
+                             ? (uint16_t)(config_.max_virtqueue_pairs * 2)
+                             : 2;
+        auto err = ctrl_ring_->Init(index, 64);
+        if (err < 0) {
+            VIRTIO_ERROR("failed to allocate control vring\n");
+            return err;
+        }
+
+        mx_status_t r = map_contiguous_memory(PAGE_SIZE, &ctrl_va_, &ctrl_pa_);
+        if (r < 0) {
+            VIRTIO_ERROR("cannot alloc control buffer %d\n", r);
+            return r;
+        }
+    }
+
+    // set DRIVER_OK and hand the posted rx buffers to the device
+    StatusDriverOK();
+    for (uint16_t n = 0; n < num_pairs_; n++) {
+        pairs_[n].rx->Kick();
+    }
+
+    // tell the device how many queue pairs we're driving
+    if ((features_ & VIRTIO_NET_F_MQ) && (num_pairs_ > 1)) {
+        uint16_t pairs = num_pairs_;
+        mx_status_t r = ControlCommand(VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET,
+                                       &pairs, sizeof(pairs));
+        if (r < 0) {
+            VIRTIO_ERROR("failed to enable %u queue pairs %d\n", num_pairs_, r);
+            return r;
+        }
+    }
+
+    // start the interrupt thread
+    StartIrqThread();
+
+    // initialize the mx_device and publish us
+    // point the ctx of our DDK device at ourself
+    ethmac_ops_.query = &virtio_net_query;
+    ethmac_ops_.stop = &virtio_net_stop;
+    ethmac_ops_.start = &virtio_net_start;
+    ethmac_ops_.send = &virtio_net_send;
+
+    device_add_args_t args = {};
+    args.version = DEVICE_ADD_ARGS_VERSION;
+    args.name = "virtio-net";
+    args.ctx = this;
+    args.ops = &device_ops_;
+    args.proto_id = MX_PROTOCOL_ETHERMAC;
+    args.proto_ops = &ethmac_ops_;
+
+    auto status = device_add(bus_device_, &args, &device_);
+    if (status < 0) {
+        device_ = nullptr;
+        return status;
+    }
+
+    return NO_ERROR;
+}
+
+mx_status_t NetDevice::ControlCommand(uint8_t cls, uint8_t cmd, const void* data, size_t len) {
+    LTRACEF("class %u cmd %u len %zu\n", cls, cmd, len);
+
+    // command layout: [class][command][payload...][ack]
+    auto buf = reinterpret_cast<uint8_t*>(ctrl_va_);
+    buf[0] = cls;
+    buf[1] = cmd;
+    memcpy(buf + 2, data, len);
+    volatile uint8_t* ack = buf + 2 + len;
+    *ack = VIRTIO_NET_ERR;
+
+    uint16_t i;
+    auto desc = ctrl_ring_->AllocDescChain(2, &i);
+    if (!desc) {
+        return ERR_NO_MEMORY;
+    }
+
+    /* the command, readable by the device */
+    desc->addr = ctrl_pa_;
+    desc->len = (uint32_t)(2 + len);
+
+    /* the ack byte the device writes back */
+    desc = ctrl_ring_->DescFromIndex(desc->next);
+    desc->addr = ctrl_pa_ + 2 + len;
+    desc->len = 1;
+    desc->flags = VRING_DESC_F_WRITE;
+
+    ctrl_ring_->SubmitChain(i);
+    ctrl_ring_->Kick();
+
+    // the irq thread is not running yet, so poll for the completion
+    bool done = false;
+    for (int tries = 0; tries < 100 && !done; tries++) {
+        ctrl_ring_->IrqRingUpdate([this, &done](vring_used_elem* used_elem) {
+            ctrl_ring_->FreeDescChain((uint16_t)used_elem->id);
+            done = true;
+        });
+        if (!done) {
+            mx_nanosleep(mx_deadline_after(MX_MSEC(10)));
+        }
+    }
+    if (!done) {
+        return ERR_TIMED_OUT;
+    }
+
+    return (*ack == VIRTIO_NET_OK) ? NO_ERROR : ERR_IO;
+}
+
+void NetDevice::IrqRingUpdate() {
+    LTRACE_ENTRY;
+
+    // called with lock_ held by the irq worker; handle completions on
+    // every queue pair in this single pass
+    for (uint16_t n = 0; n < num_pairs_; n++) {
+        QueuePair* qp = &pairs_[n];
+
+        // receive side: hand completed frames up and repost the buffer
+        bool kick = false;
+        auto rx_chain = [this, qp, &kick](vring_used_elem* used_elem) {
+            uint16_t id = (uint16_t)used_elem->id;
+            struct vring_desc* desc = qp->rx->DescFromIndex(id);
+            uintptr_t va = qp->buf_va + (uintptr_t)(desc->addr - qp->buf_pa);
+            auto hdr = reinterpret_cast<virtio_net_hdr*>(va);
+
+            if (ifc_ && (used_elem->len >= hdr_size_)) {
+                // with GUEST_CSUM the device may have verified the
+                // checksums for us already
+                uint32_t flags = (hdr->flags & VIRTIO_NET_HDR_F_DATA_VALID) ? ETHMAC_RX_CSUM_OK : 0;
+                ifc_->recv(cookie_, reinterpret_cast<void*>(va + hdr_size_),
+                           used_elem->len - hdr_size_, flags);
+            }
+
+            // hand the same buffer straight back to the device
+            uint64_t addr = desc->addr;
+            qp->rx->FreeDesc(id);
+            uint16_t i;
+            desc = qp->rx->AllocDescChain(1, &i);
+            desc->addr = addr;
+            desc->len = buf_size;
+            desc->flags = VRING_DESC_F_WRITE;
+            qp->rx->SubmitChain(i);
+            kick = true;
+        };
+        qp->rx->IrqRingUpdate(rx_chain);
+        if (kick) {
+            qp->rx->Kick();
+        }
+
+        // transmit side: reclaim completed buffers
+        auto tx_chain = [qp](vring_used_elem* used_elem) {
+            uint16_t id = (uint16_t)used_elem->id;
+            struct vring_desc* desc = qp->tx->DescFromIndex(id);
+            unsigned int b = (unsigned int)((desc->addr - qp->buf_pa) / buf_size - rx_buf_count);
+            qp->tx->FreeDesc(id);
+            qp->tx_free |= (1u << b);
+        };
+        mxtl::AutoLock lock(&qp->tx_lock);
+        qp->tx->IrqRingUpdate(tx_chain);
+    }
+}
+
+void NetDevice::IrqConfigChange() {
+    LTRACE_ENTRY;
+
+    if (!(features_ & VIRTIO_NET_F_STATUS)) {
+        return;
+    }
+
+    // called with lock_ held by the irq worker
+    CopyDeviceConfig(&config_, offsetof(virtio_net_config, max_virtqueue_pairs));
+    if (ifc_) {
+        ifc_->status(cookie_, (config_.status & VIRTIO_NET_S_LINK_UP) ? ETHMAC_STATUS_ONLINE : 0);
+    }
+}
+
+mx_status_t NetDevice::Query(uint32_t options, ethmac_info_t* info) {
+    if (options) {
+        return ERR_INVALID_ARGS;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->mtu = 1500;
+    memcpy(info->mac, config_.mac, sizeof(config_.mac));
+
+    // report the negotiated offloads so the protocol layer can make use
+    // of them as it learns to
+    if (features_ & VIRTIO_NET_F_CSUM) {
+        info->features |= ETHMAC_FEATURE_TX_CSUM;
+    }
+    if (features_ & VIRTIO_NET_F_GUEST_CSUM) {
+        info->features |= ETHMAC_FEATURE_RX_CSUM;
+    }
+    if (features_ & (VIRTIO_NET_F_HOST_TSO4 | VIRTIO_NET_F_HOST_TSO6)) {
+        info->features |= ETHMAC_FEATURE_TSO;
+    }
+
+    return NO_ERROR;
+}
+
+void NetDevice::Stop() {
+    mxtl::AutoLock lock(&lock_);
+    ifc_ = nullptr;
+}
+
+mx_status_t NetDevice::Start(ethmac_ifc_t* ifc, void* cookie) {
+    mxtl::AutoLock lock(&lock_);
+
+    if (ifc_) {
+        return ERR_BAD_STATE;
+    }
+
+    ifc_ = ifc;
+    cookie_ = cookie;
+
+    // without STATUS the device can't tell us about the link, so assume
+    // it's up
+    uint32_t status = ETHMAC_STATUS_ONLINE;
+    if ((features_ & VIRTIO_NET_F_STATUS) && !(config_.status & VIRTIO_NET_S_LINK_UP)) {
+        status = 0;
+    }
+    ifc_->status(cookie_, status);
+
+    return NO_ERROR;
+}
+
+void NetDevice::Send(uint32_t options, const void* data, size_t length) {
+    LTRACEF("data %p, length %zu\n", data, length);
+
+    if (length > buf_size - hdr_size_) {
+        return;
+    }
+
+    // pick the tx ring for the cpu we're running on so parallel senders
+    // on different cpus don't serialize on a single queue
+    QueuePair* qp = &pairs_[mx_system_get_cpu_num() % num_pairs_];
+
+    mxtl::AutoLock lock(&qp->tx_lock);
+
+    if (qp->tx_free == 0) {
+        // every tx buffer is in flight; nothing to do but drop the frame
+        return;
+    }
+    unsigned int b = (unsigned int)__builtin_ctz(qp->tx_free);
+    qp->tx_free &= ~(1u << b);
+
+    uintptr_t va = qp->buf_va + (rx_buf_count + b) * buf_size;
+
+    auto hdr = reinterpret_cast<virtio_net_hdr*>(va);
+    memset(hdr, 0, hdr_size_);
+    hdr->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+    if ((options & ETHMAC_TX_CSUM) && (features_ & VIRTIO_NET_F_CSUM)) {
+        // the checksum field is already seeded with the pseudo-header
+        // sum, which is exactly what the device wants
+        hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        hdr->csum_start = (uint16_t)ETHMAC_TX_CSUM_START(options);
+        hdr->csum_offset = (uint16_t)(ETHMAC_TX_CSUM_OFFSET(options) - ETHMAC_TX_CSUM_START(options));
+    }
+    memcpy(reinterpret_cast<void*>(va + hdr_size_), data, length);
+
+    uint16_t i;
+    auto desc = qp->tx->AllocDescChain(1, &i);
+    if (!desc) {
+        qp->tx_free |= (1u << b);
+        return;
+    }
+    desc->addr = qp->buf_pa + (rx_buf_count + b) * buf_size;
+    desc->len = (uint32_t)(hdr_size_ + length);
+
+#if LOCAL_TRACE > 0
+    virtio_dump_desc(desc);
+#endif
+
+    qp->tx->SubmitChain(i);
+    qp->tx->Kick();
+}
+
+} // namespace virtio
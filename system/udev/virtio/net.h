@@ -0,0 +1,95 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+#pragma once
+
+#include "device.h"
+#include "ring.h"
+
+#include <ddk/protocol/ethernet.h>
+#include <magenta/compiler.h>
+#include <mxtl/mutex.h>
+#include <mxtl/unique_ptr.h>
+#include <stdlib.h>
+
+namespace virtio {
+
+class Ring;
+
+class NetDevice : public Device {
+public:
+    NetDevice(mx_device_t* device);
+    virtual ~NetDevice();
+
+    virtual mx_status_t Init();
+
+    virtual void IrqRingUpdate();
+    virtual void IrqConfigChange();
+
+private:
+    // ethermac protocol hooks
+    static mx_status_t virtio_net_query(mx_device_t* dev, uint32_t options, ethmac_info_t* info);
+    static void virtio_net_stop(mx_device_t* dev);
+    static mx_status_t virtio_net_start(mx_device_t* dev, ethmac_ifc_t* ifc, void* cookie);
+    static void virtio_net_send(mx_device_t* dev, uint32_t options, void* data, size_t length);
+
+    mx_status_t Query(uint32_t options, ethmac_info_t* info);
+    mx_status_t Start(ethmac_ifc_t* ifc, void* cookie);
+    void Stop();
+    void Send(uint32_t options, const void* data, size_t length);
+
+    // issue a command on the control virtqueue and wait for the device
+    // to complete it; only used during Init(), before the irq thread runs
+    mx_status_t ControlCommand(uint8_t cls, uint8_t cmd, const void* data, size_t len);
+
+    // one rx/tx queue pair per cpu, up to the device's limit
+    static const uint16_t max_pairs = 8;
+
+    // room for a virtio_net_hdr and a full ethernet frame
+    static const size_t buf_size = 2048;
+    static const size_t rx_buf_count = 32;
+    static const size_t tx_buf_count = 32;
+
+    struct QueuePair {
+        mxtl::unique_ptr<Ring> rx;
+        mxtl::unique_ptr<Ring> tx;
+
+        // frame buffers; rx buffers first, then tx buffers
+        uintptr_t buf_va = 0;
+        mx_paddr_t buf_pa = 0;
+
+        // serializes tx submission against tx completion; the rx ring is
+        // only ever touched from the irq thread
+        mxtl::Mutex tx_lock;
+        uint32_t tx_free = 0xffffffff; // bitmap of free tx buffers
+    };
+
+    QueuePair pairs_[max_pairs];
+    uint16_t num_pairs_ = 1;
+
+    // control virtqueue, present with VIRTIO_NET_F_CTRL_VQ
+    mxtl::unique_ptr<Ring> ctrl_ring_;
+    uintptr_t ctrl_va_ = 0;
+    mx_paddr_t ctrl_pa_ = 0;
+
+    // negotiated feature bits
+    uint64_t features_ = 0;
+
+    // size of the virtio_net_hdr the device expects in front of each frame
+    size_t hdr_size_ = 0;
+
+    // saved network device configuration out of the pci config BAR
+    struct virtio_net_config {
+        uint8_t mac[6];
+        uint16_t status;              // valid with VIRTIO_NET_F_STATUS
+        uint16_t max_virtqueue_pairs; // valid with VIRTIO_NET_F_MQ
+    } config_ __PACKED = {};
+
+    // registered ethermac interface
+    ethmac_ifc_t* ifc_ = nullptr;
+    void* cookie_ = nullptr;
+
+    ethmac_protocol_t ethmac_ops_ = {};
+};
+
+} // namespace virtio
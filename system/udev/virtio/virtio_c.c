@@ -20,11 +20,12 @@ static mx_driver_ops_t virtio_driver_ops = {
     .bind = virtio_bind,
 };
 
-MAGENTA_DRIVER_BEGIN(virtio, virtio_driver_ops, "magenta", "0.1", 5)
+MAGENTA_DRIVER_BEGIN(virtio, virtio_driver_ops, "magenta", "0.1", 7)
     BI_ABORT_IF(NE, BIND_PROTOCOL, MX_PROTOCOL_PCI),
     BI_ABORT_IF(NE, BIND_PCI_VID, 0x1af4),
     BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1001), // Block device (transitional)
     BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1050), // GPU device
-    //BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1000), // Network device (transitional)
+    BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1000), // Network device (transitional)
+    BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1041), // Network device
     BI_ABORT(),
 MAGENTA_DRIVER_END(virtio)
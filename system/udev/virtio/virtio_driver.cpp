@@ -20,6 +20,7 @@
 #include "block.h"
 #include "device.h"
 #include "gpu.h"
+#include "net.h"
 #include "trace.h"
 
 #define LOCAL_TRACE 0
@@ -53,6 +54,11 @@ extern "C" mx_status_t virtio_bind(void* ctx, mx_device_t* device, void** cookie
     mxtl::unique_ptr<virtio::Device> vd = nullptr;
     AllocChecker ac;
     switch (config->device_id) {
+    case 0x1000:
+    case 0x1041:
+        LTRACEF("found net device\n");
+        vd.reset(new virtio::NetDevice(device));
+        break;
     case 0x1001:
         LTRACEF("found block device\n");
         vd.reset(new virtio::BlockDevice(device));
@@ -0,0 +1,215 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bitmap/hierarchical-bitmap.h>
+#include <bitmap/storage.h>
+
+#include <limits.h>
+#include <stddef.h>
+
+#include <magenta/types.h>
+#include <mxtl/algorithm.h>
+#include <mxtl/macros.h>
+
+#include "word-scan.h"
+
+namespace bitmap {
+
+using namespace internal;
+
+template <typename Storage>
+HierarchicalBitmapGeneric<Storage>::HierarchicalBitmapGeneric()
+    : size_(0), rotor_(0), data_(nullptr) {}
+
+// Resets the bitmap; clearing and resizing it.
+template <typename Storage>
+mx_status_t HierarchicalBitmapGeneric<Storage>::Reset(size_t size) {
+    size_ = size;
+    rotor_ = 0;
+    if (size_ == 0) {
+        data_ = nullptr;
+        return NO_ERROR;
+    }
+    size_t last_idx = LastIdx(size);
+    mx_status_t status = bits_.Allocate(sizeof(size_t) * (last_idx + 1));
+    if (status != NO_ERROR) {
+        return status;
+    }
+    if ((status = full_.Reset(last_idx + 1)) != NO_ERROR) {
+        return status;
+    }
+    if ((status = empty_.Reset(last_idx + 1)) != NO_ERROR) {
+        return status;
+    }
+    data_ = static_cast<size_t*>(bits_.GetData());
+    ClearAll();
+    return NO_ERROR;
+}
+
+template <typename Storage>
+mx_status_t HierarchicalBitmapGeneric<Storage>::Shrink(size_t size) {
+    if (size > size_) {
+        return ERR_NO_MEMORY;
+    }
+    size_ = size;
+    if (rotor_ >= size_) {
+        rotor_ = 0;
+    }
+    return NO_ERROR;
+}
+
+template <typename Storage>
+size_t HierarchicalBitmapGeneric<Storage>::Scan(size_t bitoff, size_t bitmax, bool is_set) const {
+    bitmax = mxtl::min(bitmax, size_);
+    if (bitoff >= bitmax) {
+        return bitmax;
+    }
+    size_t first_idx = FirstIdx(bitoff);
+    size_t last_idx = LastIdx(bitmax);
+    // Check the (possibly partial) first word directly.
+    size_t value = GetMask(true, first_idx == last_idx, bitoff, bitmax);
+    if (is_set) {
+        value = ~(~value | data_[first_idx]);
+    } else {
+        value &= data_[first_idx];
+    }
+    if (value != 0 || first_idx == last_idx) {
+        return mxtl::min(bitmax, CountZeros(first_idx, value));
+    }
+    // Hop over every following word that is uniformly |is_set|; the first
+    // clear summary bit marks the word holding the next candidate.
+    const RawBitmapGeneric<DefaultStorage>& uniform = is_set ? full_ : empty_;
+    size_t idx = uniform.Scan(first_idx + 1, last_idx + 1, true);
+    if (idx > last_idx) {
+        return bitmax;
+    }
+    value = GetMask(false, idx == last_idx, bitoff, bitmax);
+    if (is_set) {
+        value = ~(~value | data_[idx]);
+    } else {
+        value &= data_[idx];
+    }
+    // A mixed word always yields a bit, unless the only mismatches sit beyond
+    // bitmax in the masked final word; CountZeros exceeds bitmax in that case.
+    return mxtl::min(bitmax, CountZeros(idx, value));
+}
+
+template <typename Storage>
+mx_status_t HierarchicalBitmapGeneric<Storage>::Find(bool is_set, size_t bitoff, size_t bitmax,
+                                                     size_t run_len, size_t* out) const {
+    if (!out || bitmax <= bitoff) {
+        return ERR_INVALID_ARGS;
+    }
+    size_t start = bitoff;
+    while (bitoff - start < run_len && bitoff < bitmax) {
+        start = Scan(bitoff, bitmax, !is_set);
+        if (bitmax - start < run_len) {
+            *out = bitmax;
+            return ERR_NO_RESOURCES;
+        }
+        bitoff = Scan(start, start + run_len, is_set);
+    }
+    *out = start;
+    return NO_ERROR;
+}
+
+template <typename Storage>
+mx_status_t HierarchicalBitmapGeneric<Storage>::FindNextFit(bool is_set, size_t run_len,
+                                                            size_t* out) {
+    mx_status_t status = Find(is_set, rotor_, size_, run_len, out);
+    if (status != NO_ERROR && rotor_ != 0) {
+        // Wrap around and retry from the start.  This rescans the tail, but
+        // only on the path where the whole bitmap is nearly exhausted.
+        status = Find(is_set, 0, size_, run_len, out);
+    }
+    if (status == NO_ERROR) {
+        rotor_ = *out + run_len;
+        if (rotor_ >= size_) {
+            rotor_ = 0;
+        }
+    }
+    return status;
+}
+
+template <typename Storage>
+bool HierarchicalBitmapGeneric<Storage>::Get(size_t bitoff, size_t bitmax, size_t* first) const {
+    bitmax = mxtl::min(bitmax, size_);
+    size_t result = Scan(bitoff, bitmax, true);
+    if (first) {
+        *first = result;
+    }
+    return result == bitmax;
+}
+
+template <typename Storage>
+mx_status_t HierarchicalBitmapGeneric<Storage>::Set(size_t bitoff, size_t bitmax) {
+    if (bitoff > bitmax || bitmax > size_) {
+        return ERR_INVALID_ARGS;
+    }
+    if (bitoff == bitmax) {
+        return NO_ERROR;
+    }
+    size_t first_idx = FirstIdx(bitoff);
+    size_t last_idx = LastIdx(bitmax);
+    for (size_t i = first_idx; i <= last_idx; ++i) {
+        data_[i] |=
+                GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
+        SyncSummary(i);
+    }
+    return NO_ERROR;
+}
+
+template <typename Storage>
+mx_status_t HierarchicalBitmapGeneric<Storage>::Clear(size_t bitoff, size_t bitmax) {
+    if (bitoff > bitmax || bitmax > size_) {
+        return ERR_INVALID_ARGS;
+    }
+    if (bitoff == bitmax) {
+        return NO_ERROR;
+    }
+    size_t first_idx = FirstIdx(bitoff);
+    size_t last_idx = LastIdx(bitmax);
+    for (size_t i = first_idx; i <= last_idx; ++i) {
+        data_[i] &=
+                ~(GetMask(i == first_idx, i == last_idx, bitoff, bitmax));
+        SyncSummary(i);
+    }
+    return NO_ERROR;
+}
+
+template <typename Storage>
+void HierarchicalBitmapGeneric<Storage>::ClearAll() {
+    if (size_ == 0) {
+        return;
+    }
+    size_t last_idx = LastIdx(size_);
+    for (size_t i = 0; i <= last_idx; ++i) {
+        data_[i] = 0;
+    }
+    full_.ClearAll();
+    empty_.Set(0, last_idx + 1);
+}
+
+template <typename Storage>
+void HierarchicalBitmapGeneric<Storage>::SyncSummary(size_t idx) {
+    size_t ones = 0;
+    ones = ~ones;
+    if (data_[idx] == ones) {
+        full_.SetOne(idx);
+    } else {
+        full_.ClearOne(idx);
+    }
+    if (data_[idx] == 0) {
+        empty_.SetOne(idx);
+    } else {
+        empty_.ClearOne(idx);
+    }
+}
+
+#ifdef __Fuchsia__
+template class HierarchicalBitmapGeneric<VmoStorage>;
+#endif
+template class HierarchicalBitmapGeneric<DefaultStorage>;
+
+} // namespace bitmap
@@ -0,0 +1,122 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <bitmap/bitmap.h>
+#include <bitmap/raw-bitmap.h>
+#include <bitmap/storage.h>
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <magenta/types.h>
+#include <mxtl/macros.h>
+
+namespace bitmap {
+
+// A two-level bitmap backed by generic storage.
+//
+// The leaf level holds the bits themselves; for every leaf word, two summary
+// bits record whether that word is entirely set or entirely clear.  Scans
+// consult the summary to hop over runs of uniform words, so finding a free
+// bit in a mostly-full bitmap costs a word-level scan of the summary plus a
+// ctz of the mixed word, rather than a linear walk of the whole leaf level.
+//
+// The bit-level semantics and the contents of the underlying storage are
+// identical to RawBitmapGeneric, so the two are interchangeable when the
+// storage is persisted.
+//
+// Storage must implement:
+//   - mx_status_t Allocate(size_t size)
+//      To allocate |size| bytes of storage.
+//   - void* GetData()
+//      To access the underlying storage.
+template <typename Storage>
+class HierarchicalBitmapGeneric final : public Bitmap {
+public:
+    HierarchicalBitmapGeneric();
+    virtual ~HierarchicalBitmapGeneric() = default;
+    HierarchicalBitmapGeneric(HierarchicalBitmapGeneric&& rhs) = default;
+    HierarchicalBitmapGeneric& operator=(HierarchicalBitmapGeneric&& rhs) = default;
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(HierarchicalBitmapGeneric);
+
+    // Returns the size of this bitmap.
+    size_t size(void) const { return size_; }
+
+    // Resets the bitmap; clearing and resizing it.
+    // Allocates memory, and can fail.
+    mx_status_t Reset(size_t size);
+
+    // Shrinks the accessible portion of the bitmap, without re-allocating
+    // the underlying storage.
+    //
+    // This is useful for programs which require underlying bitmap storage
+    // to be aligned to a certain size (initialized via Reset), but want to
+    // restrict access to a smaller portion of the bitmap (via Shrink).
+    mx_status_t Shrink(size_t size);
+
+    // Returns the lesser of bitmax and the index of the first bit that doesn't
+    // match *is_set* starting from *bitoff*.  Words that are uniformly *is_set*
+    // are skipped via the summary.
+    size_t Scan(size_t bitoff, size_t bitmax, bool is_set) const;
+
+    // Find a run of *run_len* *is_set* bits, between bitoff and bitmax.
+    // Returns the start of the run in *out*, or bitmax if it is
+    // not found in the provided range.
+    // If the run is not found, "ERR_NO_RESOURCES" is returned.
+    mx_status_t Find(bool is_set, size_t bitoff, size_t bitmax, size_t run_len, size_t* out) const;
+
+    // Next-fit variant of Find: searches from the rotor (just past the last
+    // run this method returned) to the end of the bitmap, wrapping around
+    // once, so a stream of allocations doesn't rescan the occupied prefix
+    // every time.
+    mx_status_t FindNextFit(bool is_set, size_t run_len, size_t* out);
+
+    // Returns true if all the bits in [*bitoff*, *bitmax*) are set. Afterwards,
+    // *first_unset* will be set to the lesser of bitmax and the index of the
+    // first unset bit after *bitoff*.
+    bool Get(size_t bitoff, size_t bitmax,
+             size_t* first_unset = nullptr) const override;
+
+    // Sets all bits in the range [*bitoff*, *bitmax*).  Returns an error if
+    // bitmax < bitoff or size_ < bitmax, and NO_ERROR otherwise.
+    mx_status_t Set(size_t bitoff, size_t bitmax) override;
+
+    // Clears all bits in the range [*bitoff*, *bitmax*).  Returns an error if
+    // bitmax < bitoff or size_ < bitmax, and NO_ERROR otherwise.
+    mx_status_t Clear(size_t bitoff, size_t bitmax) override;
+
+    // Clear all bits in the bitmap.
+    void ClearAll() override;
+
+    // This function allows access to underlying data, but is dangerous: It
+    // leaks the pointer to bits_. Reset and the bitmap destructor should not
+    // be called on the bitmap while the pointer returned from data() is alive.
+    const Storage* StorageUnsafe() const { return &bits_; }
+
+private:
+    // Recomputes the summary bits covering the leaf word at *idx*.
+    void SyncSummary(size_t idx);
+
+    // The size of this bitmap, in bits.
+    size_t size_;
+
+    // Next-fit cursor; the bit just past the last run FindNextFit returned.
+    size_t rotor_;
+
+    // The storage backing this bitmap.
+    Storage bits_;
+    // Owned by bits_, cached
+    size_t* data_;
+
+    // One bit per leaf word: set iff that word is all ones / all zeros.
+    // The summaries are derived data, so they always live on the heap, even
+    // when the leaf level is backed by a VMO.
+    RawBitmapGeneric<DefaultStorage> full_;
+    RawBitmapGeneric<DefaultStorage> empty_;
+};
+
+} // namespace bitmap
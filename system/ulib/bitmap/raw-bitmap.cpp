@@ -12,62 +12,12 @@
 #include <mxtl/algorithm.h>
 #include <mxtl/macros.h>
 
-namespace {
-
-const size_t kBits = sizeof(size_t) * 8;
-
-// GetMask returns a 64-bit bitmask.  If the block of the bitmap we're looking
-// at isn't the first or last, all bits are set.  Otherwise, the bits outside of
-// [off,max) are cleared.  Bits are counted with the LSB as 0 and the MSB as 63.
-//
-// Examples:
-//  GetMask(false, false, 16, 48) => 0xffffffffffffffff
-//  GetMask(true,  false, 16, 48) => 0xffffffffffff0000
-//  GetMask(false,  true, 16, 48) => 0x0000ffffffffffff
-//  GetMask(true,   true, 16, 48) => 0x0000ffffffff0000
-size_t GetMask(bool first, bool last, size_t off, size_t max) {
-    size_t ones = 0;
-    ones = ~ones;
-    size_t mask = ones;
-    if (first) {
-        mask &= ones << (off % kBits);
-    }
-    if (last) {
-        mask &= ones >> ((kBits - (max % kBits)) % kBits);
-    }
-    return mask;
-}
-
-// Translates a bit offset into a starting index in the bitmap array.
-constexpr size_t FirstIdx(size_t bitoff) {
-    return bitoff / kBits;
-}
-
-// Translates a max bit into a final index in the bitmap array.
-constexpr size_t LastIdx(size_t bitmax) {
-    return (bitmax - 1) / kBits;
-}
-
-// Counts the number of zeros.  It assumes everything in the array up to
-// bits_[idx] is zero.
-#if (SIZE_MAX == UINT_MAX)
-#define CTZ(x) (x == 0 ? kBits : __builtin_ctz(x))
-#elif (SIZE_MAX == ULONG_MAX)
-#define CTZ(x) (x == 0 ? kBits : __builtin_ctzl(x))
-#elif (SIZE_MAX == ULLONG_MAX)
-#define CTZ(x) (x == 0 ? kBits : __builtin_ctzll(x))
-#else
-#error "Unsupported size_t length"
-#endif
-size_t CountZeros(size_t idx, size_t value) {
-    return idx * kBits + CTZ(value);
-}
-#undef CTZ
-
-} // namespace
+#include "word-scan.h"
 
 namespace bitmap {
 
+using namespace internal;
+
 template <typename Storage>
 RawBitmapGeneric<Storage>::RawBitmapGeneric() : size_(0), data_(nullptr) {}
 
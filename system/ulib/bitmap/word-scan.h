@@ -0,0 +1,73 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Word-scan primitives shared by the bitmap implementations.
+
+namespace bitmap {
+namespace internal {
+
+const size_t kBits = sizeof(size_t) * 8;
+
+// GetMask returns a 64-bit bitmask.  If the block of the bitmap we're looking
+// at isn't the first or last, all bits are set.  Otherwise, the bits outside of
+// [off,max) are cleared.  Bits are counted with the LSB as 0 and the MSB as 63.
+//
+// Examples:
+//  GetMask(false, false, 16, 48) => 0xffffffffffffffff
+//  GetMask(true,  false, 16, 48) => 0xffffffffffff0000
+//  GetMask(false,  true, 16, 48) => 0x0000ffffffffffff
+//  GetMask(true,   true, 16, 48) => 0x0000ffffffff0000
+inline size_t GetMask(bool first, bool last, size_t off, size_t max) {
+    size_t ones = 0;
+    ones = ~ones;
+    size_t mask = ones;
+    if (first) {
+        mask &= ones << (off % kBits);
+    }
+    if (last) {
+        mask &= ones >> ((kBits - (max % kBits)) % kBits);
+    }
+    return mask;
+}
+
+// Translates a bit offset into a starting index in the bitmap array.
+constexpr size_t FirstIdx(size_t bitoff) {
+    return bitoff / kBits;
+}
+
+// Translates a max bit into a final index in the bitmap array.
+constexpr size_t LastIdx(size_t bitmax) {
+    return (bitmax - 1) / kBits;
+}
+
+// Returns the number of trailing zeros in |x|, or kBits if |x| is zero.
+inline size_t Ctz(size_t x) {
+    if (x == 0) {
+        return kBits;
+    }
+#if (SIZE_MAX == UINT_MAX)
+    return __builtin_ctz(x);
+#elif (SIZE_MAX == ULONG_MAX)
+    return __builtin_ctzl(x);
+#elif (SIZE_MAX == ULLONG_MAX)
+    return __builtin_ctzll(x);
+#else
+#error "Unsupported size_t length"
+#endif
+}
+
+// Counts the number of zeros.  It assumes everything in the array up to
+// bits_[idx] is zero.
+inline size_t CountZeros(size_t idx, size_t value) {
+    return idx * kBits + Ctz(value);
+}
+
+} // namespace internal
+} // namespace bitmap
@@ -5,6 +5,7 @@
 #include <bootdata/decompress.h>
 
 #include <limits.h>
+#include <stdbool.h>
 #include <string.h>
 
 #include <magenta/boot/bootdata.h>
@@ -13,6 +14,12 @@
 
 #include <lz4/lz4.h>
 
+#ifdef BOOTFS_PARALLEL_DECOMPRESS
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <threads.h>
+#endif
+
 // The LZ4 Frame format is used to compress a bootfs image, but we cannot use
 // the LZ4 library's decompression functions in userboot. The following
 // definitions are used in the reimplementation of LZ4 Frame decompression, with
@@ -85,6 +92,129 @@ static mx_status_t check_lz4_frame(const lz4_frame_desc* fd,
     return NO_ERROR;
 }
 
+#ifdef BOOTFS_PARALLEL_DECOMPRESS
+
+#define MX_LZ4_BLOCK_SIZE (64 * 1024)
+#define MX_LZ4_MAX_WORKERS 4
+
+typedef struct {
+    const uint8_t* src;
+    uint8_t* dst;
+    uint32_t src_size;
+    uint32_t dst_size;
+    bool stored; // block is stored uncompressed
+} lz4_block_t;
+
+typedef struct {
+    lz4_block_t* blocks;
+    uint32_t count;
+    atomic_uint next;
+    atomic_bool failed;
+} lz4_work_t;
+
+static int decompress_worker(void* arg) {
+    lz4_work_t* work = arg;
+    for (;;) {
+        uint32_t n = atomic_fetch_add(&work->next, 1);
+        if ((n >= work->count) || atomic_load(&work->failed)) {
+            return 0;
+        }
+        lz4_block_t* blk = &work->blocks[n];
+        if (blk->stored) {
+            memcpy(blk->dst, blk->src, blk->dst_size);
+        } else {
+            int dcmp = LZ4_decompress_safe((const char*)blk->src, (char*)blk->dst,
+                                           blk->src_size, blk->dst_size);
+            if (dcmp != (int)blk->dst_size) {
+                // the block didn't fill its slot, so the layout
+                // assumption below doesn't hold for this stream
+                atomic_store(&work->failed, true);
+                return 0;
+            }
+        }
+    }
+}
+
+// The frame format requires independent blocks, and the tools that build
+// bootfs images compress in fixed 64k chunks, so block N's output lands
+// at N times the block size and only the final block may be short. Walk
+// the compressed stream once to lay out one work item per block, then
+// decompress the blocks on a few threads. Returns false if the stream
+// does not have that regular shape (detected up front for stored blocks
+// and by the workers for compressed ones); the caller then falls back to
+// the serial walk.
+static bool decompress_bootfs_parallel(const uint8_t* data, uint8_t* dst,
+                                       size_t content_size) {
+    const uint8_t* p = data;
+    uint32_t count = 0;
+    uint32_t blocksize;
+    while ((blocksize = *(const uint32_t*)p) != 0) {
+        p += sizeof(uint32_t) + (blocksize & 0x7fffffff);
+        count++;
+    }
+    // not worth spawning threads for a couple of blocks
+    if (count < 2) {
+        return false;
+    }
+    // the regular layout requires exactly this many full blocks
+    if ((content_size <= ((size_t)(count - 1)) * MX_LZ4_BLOCK_SIZE) ||
+        (content_size > ((size_t)count) * MX_LZ4_BLOCK_SIZE)) {
+        return false;
+    }
+
+    lz4_block_t* blocks = malloc(count * sizeof(lz4_block_t));
+    if (blocks == NULL) {
+        return false;
+    }
+
+    p = data;
+    for (uint32_t n = 0; n < count; n++) {
+        blocksize = *(const uint32_t*)p;
+        p += sizeof(uint32_t);
+        lz4_block_t* blk = &blocks[n];
+        blk->stored = (blocksize >> 31) != 0;
+        blk->src = p;
+        blk->src_size = blocksize & 0x7fffffff;
+        blk->dst = dst + ((size_t)n) * MX_LZ4_BLOCK_SIZE;
+        blk->dst_size = (n == count - 1)
+            ? (uint32_t)(content_size - ((size_t)n) * MX_LZ4_BLOCK_SIZE)
+            : MX_LZ4_BLOCK_SIZE;
+        if (blk->stored && (blk->src_size != blk->dst_size)) {
+            free(blocks);
+            return false;
+        }
+        p += blk->src_size;
+    }
+
+    lz4_work_t work = {
+        .blocks = blocks,
+        .count = count,
+    };
+    atomic_init(&work.next, 0);
+    atomic_init(&work.failed, false);
+
+    thrd_t threads[MX_LZ4_MAX_WORKERS - 1];
+    unsigned nthreads = 0;
+    while ((nthreads < MX_LZ4_MAX_WORKERS - 1) && (nthreads + 1 < count)) {
+        // if thread creation fails the remaining blocks are simply
+        // consumed by whoever is still running
+        if (thrd_create(&threads[nthreads], decompress_worker, &work) != thrd_success) {
+            break;
+        }
+        nthreads++;
+    }
+    decompress_worker(&work);
+    for (unsigned n = 0; n < nthreads; n++) {
+        thrd_join(threads[n], NULL);
+    }
+
+    bool ok = !atomic_load(&work.failed);
+    free(blocks);
+    return ok;
+}
+
+#endif // BOOTFS_PARALLEL_DECOMPRESS
+
 static mx_status_t decompress_bootfs_vmo(mx_handle_t vmar,
                                          const uint8_t* data, mx_handle_t* out,
                                          const char** err) {
@@ -136,6 +266,14 @@ static mx_status_t decompress_bootfs_vmo(mx_handle_t vmar,
     dst += sizeof(bootdata_t);
     remaining -= sizeof(bootdata_t);
 
+    bool done = false;
+#ifdef BOOTFS_PARALLEL_DECOMPRESS
+    done = decompress_bootfs_parallel(data, dst, hdr->extra - sizeof(bootdata_t));
+#endif
+    if (done) {
+        goto unmap;
+    }
+
     // Read each LZ4 block and decompress it. Block sizes are 32 bits.
     uint32_t blocksize = *(const uint32_t*)data;
     data += sizeof(uint32_t);
@@ -180,6 +318,7 @@ static mx_status_t decompress_bootfs_vmo(mx_handle_t vmar,
         return ERR_INVALID_ARGS;
     }
 
+unmap:
     status = mx_vmar_unmap(vmar, dst_addr, newsize);
     if (status < 0) {
         *err = "mx_vmar_unmap after decompress failed";
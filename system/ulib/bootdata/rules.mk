@@ -10,6 +10,11 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += $(LOCAL_DIR)/decompress.c
 
+# The library build has threads available, so bootfs sections are
+# decompressed in parallel; userboot compiles decompress.c directly
+# without this flag and keeps the serial path.
+MODULE_COMPILEFLAGS += -DBOOTFS_PARALLEL_DECOMPRESS
+
 MODULE_LIBS := \
     third_party/ulib/lz4 \
     system/ulib/magenta \
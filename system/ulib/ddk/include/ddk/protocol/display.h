@@ -47,6 +47,25 @@ typedef struct mx_display_protocol {
     // The provided callback will be invoked with a value of true if the display
     // has been acquired, false if it has been released.
 
+    mx_status_t (*get_framebuffer_vmo)(mx_device_t* dev, mx_handle_t* out_vmo);
+    // gets a duplicate handle to the vmo backing the framebuffer
+    // optional: only displays that can flip need provide it
+
+    mx_status_t (*flip)(mx_device_t* dev, mx_off_t offset);
+    // moves the scanout address to the given byte offset into the
+    // framebuffer, which must be a multiple of one line (stride times
+    // pixel size); optional: NULL when the hardware cannot flip
+
+    mx_status_t (*fill_rect)(mx_device_t* dev, const mx_display_blit_t* args);
+    mx_status_t (*copy_rect)(mx_device_t* dev, const mx_display_blit_t* args);
+    // fill/copy a rectangle of the visible framebuffer with the 2D
+    // engine; synchronous - the blit has completed when they return,
+    // so CPU access to the framebuffer is coherent afterwards.
+    // Callers must serialize blits against each other.  The driver
+    // validates coordinates against the current mode; ERR_NOT_SUPPORTED
+    // is returned for unsupported flags (e.g. colorkey).
+    // optional: NULL when the hardware has no 2D engine
+
 } mx_display_protocol_t;
 
 __END_CDECLS;
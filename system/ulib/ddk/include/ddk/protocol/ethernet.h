@@ -27,9 +27,30 @@ __BEGIN_CDECLS;
 //
 // The FEATURE_WLAN flag indicates a device that supports wlan operations.
 
+// The FEATURE_?X_CSUM and FEATURE_TSO flags advertise hardware
+// offloads the device negotiated; a device with FEATURE_RX_CSUM may
+// set ETHMAC_RX_CSUM_OK on frames it delivers via ifc->recv().
+
 #define ETHMAC_FEATURE_RX_QUEUE (1u)
 #define ETHMAC_FEATURE_TX_QUEUE (2u)
 #define ETHMAC_FEATURE_WLAN     (4u)
+#define ETHMAC_FEATURE_RX_CSUM  (8u)
+#define ETHMAC_FEATURE_TX_CSUM  (16u)
+#define ETHMAC_FEATURE_TSO      (32u)
+
+// flags for ifc->recv()
+#define ETHMAC_RX_CSUM_OK       (1u)
+
+// options for proto->send(): ask the device to compute and insert an L4
+// checksum (only valid when FEATURE_TX_CSUM was advertised).  'start' is
+// the byte offset summing begins at and 'off' is where the result is
+// stored, both relative to the start of the frame.  The checksum field
+// must be pre-seeded with the pseudo-header sum.
+#define ETHMAC_TX_CSUM                  (1u)
+#define ETHMAC_TX_CSUM_META(start, off) \
+    (ETHMAC_TX_CSUM | (((start) & 0xffu) << 8) | (((off) & 0xffffu) << 16))
+#define ETHMAC_TX_CSUM_START(options)   (((options) >> 8) & 0xffu)
+#define ETHMAC_TX_CSUM_OFFSET(options)  (((options) >> 16) & 0xffffu)
 
 typedef struct ethmac_info {
     uint32_t features;
@@ -35,16 +35,45 @@
 #define IOTXN_PFLAG_MMAP       (1 << 3)   // we performed mmap() on this vmo
 #define IOTXN_PFLAG_FREE       (1 << 4)   // this txn has been released
 #define IOTXN_PFLAG_QUEUED     (1 << 5)   // transaction has been queued and not yet released
+#define IOTXN_PFLAG_PINNED     (1 << 6)   // we pinned the vmo pages via MX_VMO_OP_LOCK
 
 #define IOTXN_STATE_MASK       (IOTXN_PFLAG_FREE | IOTXN_PFLAG_QUEUED)
 
-static list_node_t free_list = LIST_INITIAL_VALUE(free_list);
+// The free list is bucketed by buffer size so allocation does not scan
+// past every cached buffer of a different size. Bucket 0 holds txns with
+// no allocated vmo (used by clones); the rest are indexed by log2 of the
+// buffer size.
+#define FREE_LIST_BUCKETS 16
+
+static list_node_t free_lists[FREE_LIST_BUCKETS];
+static bool free_lists_initialized = false;
 static mtx_t free_list_mutex = MTX_INIT;
 #if FREE_LIST_MONITOR_LIMIT
 static size_t free_list_length = 0;
 static size_t free_list_monitor_warned = 0;
 #endif
 
+// call with free_list_mutex held
+static list_node_t* free_list_bucket_locked(uint64_t data_size) {
+    if (!free_lists_initialized) {
+        for (int i = 0; i < FREE_LIST_BUCKETS; i++) {
+            list_initialize(&free_lists[i]);
+        }
+        free_lists_initialized = true;
+    }
+    if (data_size == 0) {
+        return &free_lists[0];
+    }
+    // sizes up to 512 bytes share bucket 1; each bucket above doubles
+    int bucket = 64 - __builtin_clzll(data_size) - 9;
+    if (bucket < 1) {
+        bucket = 1;
+    } else if (bucket >= FREE_LIST_BUCKETS) {
+        bucket = FREE_LIST_BUCKETS - 1;
+    }
+    return &free_lists[bucket];
+}
+
 // This assert will fail if we attempt to access the buffer of a cloned txn after it has been completed
 #define ASSERT_BUFFER_VALID(priv) MX_DEBUG_ASSERT(!(priv->flags & IOTXN_FLAG_DEAD))
 
@@ -60,12 +89,23 @@ static bool do_free_phys(uint32_t pflags) {
     return (pflags & IOTXN_PFLAG_PHYSMAP);
 }
 
+static void iotxn_unpin(mx_handle_t vmo_handle, uint64_t vmo_offset, uint64_t vmo_length,
+                        uint32_t pflags) {
+    // balance the MX_VMO_OP_LOCK taken by physmap() over the same pages
+    if (pflags & IOTXN_PFLAG_PINNED) {
+        uint64_t page_offset = ROUNDDOWN(vmo_offset, PAGE_SIZE);
+        uint64_t page_length = vmo_length + (vmo_offset - page_offset);
+        mx_vmo_op_range(vmo_handle, MX_VMO_OP_UNLOCK, page_offset, page_length, NULL, 0);
+    }
+}
+
 static iotxn_t* find_in_free_list(uint32_t pflags, uint64_t data_size) {
     bool found = false;
     iotxn_t* txn = NULL;
     //xprintf("find_in_free_list pflags 0x%x data_size 0x%" PRIx64 "\n", pflags, data_size);
     mtx_lock(&free_list_mutex);
-    list_for_every_entry (&free_list, txn, iotxn_t, node) {
+    list_node_t* bucket = free_list_bucket_locked(data_size);
+    list_for_every_entry (bucket, txn, iotxn_t, node) {
         // txn->pflags has IOTXN_ALLOC_CONTIGUOUS set if the txn has a contiguous VMO we allocated,
         // or zero otherwise. And the pflags passed into this function is either zero or
         // IOTXN_ALLOC_CONTIGUOUS. So here we mask txn->pflags with IOTXN_ALLOC_CONTIGUOUS
@@ -110,6 +150,7 @@ static void iotxn_release_free_list(iotxn_t* txn) {
         txn->pflags = pflags;
     } else {
         if (do_free_phys(pflags)) {
+            iotxn_unpin(vmo_handle, vmo_offset, vmo_length, pflags);
             if (phys != NULL) {
                 free(phys);
             }
@@ -126,7 +167,7 @@ static void iotxn_release_free_list(iotxn_t* txn) {
     txn->release_cb = iotxn_release_free_list;
 
     mtx_lock(&free_list_mutex);
-    list_add_head(&free_list, &txn->node);
+    list_add_head(free_list_bucket_locked(txn->vmo_length), &txn->node);
 #if FREE_LIST_MONITOR_LIMIT
     free_list_length++;
     if (free_list_length % FREE_LIST_MONITOR_LIMIT == 0
@@ -143,6 +184,7 @@ static void iotxn_release_free_list(iotxn_t* txn) {
 // free the iotxn
 static void iotxn_release_free(iotxn_t* txn) {
     if (do_free_phys(txn->pflags)) {
+        iotxn_unpin(txn->vmo_handle, txn->vmo_offset, txn->vmo_length, txn->pflags);
         if (txn->phys != NULL) {
             free(txn->phys);
         }
@@ -163,6 +205,8 @@ static void iotxn_release_static(iotxn_t* txn) {
     uint32_t pflags = txn->pflags;
 
     if (do_free_phys(txn->pflags)) {
+        iotxn_unpin(txn->vmo_handle, txn->vmo_offset, txn->vmo_length, txn->pflags);
+        txn->pflags &= ~IOTXN_PFLAG_PINNED;
         // only free the scatter list if we called physmap()
         if (txn->phys != NULL) {
             free(txn->phys);
@@ -214,20 +258,22 @@ static mx_status_t iotxn_physmap_contiguous(iotxn_t* txn) {
         return ERR_NO_MEMORY;
     }
 
-    // for contiguous buffers, commit the whole range but just map the first
+    // for contiguous buffers, pin the whole range but just map the first
     // page
     uint64_t page_offset = ROUNDDOWN(txn->vmo_offset, PAGE_SIZE);
-    mx_status_t status = mx_vmo_op_range(txn->vmo_handle, MX_VMO_OP_COMMIT, page_offset, txn->vmo_length, NULL, 0);
+    uint64_t page_length = txn->vmo_length + (txn->vmo_offset - page_offset);
+    mx_status_t status = mx_vmo_op_range(txn->vmo_handle, MX_VMO_OP_LOCK, page_offset, page_length, NULL, 0);
     if (status != NO_ERROR) {
         goto fail;
     }
 
     status = mx_vmo_op_range(txn->vmo_handle, MX_VMO_OP_LOOKUP, page_offset, PAGE_SIZE, txn->phys, sizeof(mx_paddr_t));
     if (status != NO_ERROR) {
+        mx_vmo_op_range(txn->vmo_handle, MX_VMO_OP_UNLOCK, page_offset, page_length, NULL, 0);
         goto fail;
     }
 
-    txn->pflags |= IOTXN_PFLAG_PHYSMAP;
+    txn->pflags |= IOTXN_PFLAG_PHYSMAP | IOTXN_PFLAG_PINNED;
     txn->phys_count = 1;
     return NO_ERROR;
 fail:
@@ -249,23 +295,17 @@ static mx_status_t iotxn_physmap_paged(iotxn_t* txn) {
         return ERR_NO_MEMORY;
     }
 
-    // commit pages and lookup physical addresses
-    // assume that commited pages will never be auto-decommitted
-    mx_status_t status = mx_vmo_op_range(txn->vmo_handle, MX_VMO_OP_COMMIT, txn->vmo_offset, txn->vmo_length, NULL, 0);
-    if (status != NO_ERROR) {
-        xprintf("iotxn_physmap_paged: error %d in commit\n", status);
-        free(paddrs);
-        return status;
-    }
-
-    status = mx_vmo_op_range(txn->vmo_handle, MX_VMO_OP_LOOKUP, page_offset, page_length, paddrs, sizeof(mx_paddr_t) * pages);
+    // pin the pages and fetch their physical addresses in one op; pinned
+    // pages cannot be decommitted or reclaimed while DMA is in flight
+    mx_status_t status = mx_vmo_op_range(txn->vmo_handle, MX_VMO_OP_LOCK, page_offset,
+                                         page_length, paddrs, sizeof(mx_paddr_t) * pages);
     if (status != NO_ERROR) {
-        xprintf("iotxn_physmap_paged: error %d in lookup\n", status);
+        xprintf("iotxn_physmap_paged: error %d in lock\n", status);
         free(paddrs);
         return status;
     }
 
-    txn->pflags |= IOTXN_PFLAG_PHYSMAP;
+    txn->pflags |= IOTXN_PFLAG_PHYSMAP | IOTXN_PFLAG_PINNED;
     txn->phys = paddrs;
     txn->phys_count = pages;
     return NO_ERROR;
@@ -216,6 +216,13 @@ static mx_status_t finish_load_segment(
     return status;
 }
 
+// Segments are never copied out of the file VMO.  Read-only segments are
+// mapped directly from it, sharing pages with every other process running
+// the same binary; writable segments are mapped from a copy-on-write clone
+// so pages are only duplicated when they are actually dirtied.  The one
+// copy left is the partial page where initialized data meets bss, which
+// cannot be shared because the file bytes and the zero fill land in the
+// same page.
 static mx_status_t load_segment(mx_handle_t vmar, size_t vmar_offset,
                                 mx_handle_t vmo, const char* vmo_name,
                                 const elf_phdr_t* ph) {
@@ -101,6 +101,29 @@ mx_status_t mount(int devicefd, const char* mountpath, disk_format_t df,
 mx_status_t fmount(int devicefd, int mountfd, disk_format_t df,
                    const mount_options_t* options, LaunchCallback cb);
 
+// Launch a resident filesystem server for the given disk format, which stays
+// alive across mounts and unmounts. 'control_out' receives the channel used
+// to issue mount requests against the server; closing it shuts the server
+// down. Repeated mounts through one server skip the per-mount process launch,
+// and the server may retain validated filesystem state across an unmount so a
+// remount of the same device skips superblock and bitmap loading.
+//
+// Returns ERR_NOT_SUPPORTED for formats whose server lacks a service mode.
+mx_status_t fs_server_start(disk_format_t df, const mount_options_t* options,
+                            LaunchCallback cb, mx_handle_t* control_out);
+
+// Mount a device through a resident server, as 'fmount' does through a
+// freshly launched one. The server replies once the filesystem is serving
+// requests, so the 'wait_until_ready' option is always honored.
+//
+// devicefd is always consumed; mountfd and the control channel are not.
+mx_status_t fs_server_fmount(mx_handle_t control, int devicefd, int mountfd,
+                             const mount_options_t* options);
+
+// Ask a resident server to exit and close the control channel. Filesystems
+// still mounted through the server are torn down with it; unmount them first.
+mx_status_t fs_server_shutdown(mx_handle_t control);
+
 // Format the provided device with a requested disk format.
 mx_status_t mkfs(const char* devicepath, disk_format_t df, LaunchCallback cb,
                  const mkfs_options_t* options);
@@ -275,3 +275,101 @@ mx_status_t umount(const char* mountpath) {
     close(fd);
     return status;
 }
+
+mx_status_t fs_server_start(disk_format_t df, const mount_options_t* options,
+                            LaunchCallback cb, mx_handle_t* control_out) {
+    const char* binary;
+    switch (df) {
+    case DISK_FORMAT_MINFS:
+        binary = "/boot/bin/minfs";
+        break;
+    default:
+        return ERR_NOT_SUPPORTED;
+    }
+
+    mx_handle_t control, remote;
+    mx_status_t status;
+    if ((status = mx_channel_create(0, &control, &remote)) != NO_ERROR) {
+        return status;
+    }
+    if (options->verbose_mount) {
+        printf("fs_mount: Launching resident %s server\n", binary);
+    }
+    const char* argv[] = { binary, "service" };
+    mx_handle_t hnd[] = { remote };
+    uint32_t ids[] = { PA_USER0 };
+    if ((status = cb(countof(argv), argv, hnd, ids, countof(hnd))) != NO_ERROR) {
+        mx_handle_close(control);
+        return status;
+    }
+    *control_out = control;
+    return NO_ERROR;
+}
+
+mx_status_t fs_server_fmount(mx_handle_t control, int devicefd, int mountfd,
+                             const mount_options_t* options) {
+    mx_handle_t hnd[MXIO_MAX_HANDLES * 2];
+    uint32_t ids[MXIO_MAX_HANDLES * 2];
+    size_t n = 0;
+    mx_handle_t root;
+    mx_status_t status;
+    if ((status = mount_prepare_handles(devicefd, &root, hnd, ids, &n)) != NO_ERROR) {
+        return status;
+    }
+
+    // hnd[0] is the mountee channel, followed by the handles of the block
+    // device; the server binds the device itself, so the ids are not sent.
+    vfs_service_request_t req = {
+        .op = VFS_SERVICE_OP_MOUNT,
+        .reserved = 0,
+    };
+    if ((status = mx_channel_write(control, 0, &req, sizeof(req), hnd, n)) != NO_ERROR) {
+        for (size_t i = 0; i < n; i++) {
+            mx_handle_close(hnd[i]);
+        }
+        mx_handle_close(root);
+        return status;
+    }
+
+    // The server replies once the filesystem is serving requests, so no
+    // separate wait for readiness on the root channel is needed.
+    mx_status_t reply;
+    uint32_t actual = 0;
+    uint32_t hactual = 0;
+    if ((status = mx_object_wait_one(control, MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED,
+                                     MX_TIME_INFINITE, NULL)) == NO_ERROR) {
+        status = mx_channel_read(control, 0, &reply, NULL, sizeof(reply), 0,
+                                 &actual, &hactual);
+    }
+    if ((status == NO_ERROR) && (actual != sizeof(reply))) {
+        status = ERR_BAD_STATE;
+    }
+    if (status == NO_ERROR) {
+        status = reply;
+    }
+    if (status != NO_ERROR) {
+        mx_handle_close(root);
+        return status;
+    }
+
+    if ((status = ioctl_vfs_mount_fs(mountfd, &root)) != NO_ERROR) {
+        // Currently, the recipient of the ioctl is sending the unmount signal
+        // if an error occurs.
+        return status;
+    }
+    return NO_ERROR;
+}
+
+mx_status_t fs_server_shutdown(mx_handle_t control) {
+    vfs_service_request_t req = {
+        .op = VFS_SERVICE_OP_SHUTDOWN,
+        .reserved = 0,
+    };
+    mx_status_t status = mx_channel_write(control, 0, &req, sizeof(req), NULL, 0);
+    if (status == NO_ERROR) {
+        status = mx_object_wait_one(control, MX_CHANNEL_PEER_CLOSED,
+                                    MX_TIME_INFINITE, NULL);
+    }
+    mx_handle_close(control);
+    return status;
+}
@@ -54,6 +54,11 @@ private:
 
 // VfsDispatcher is a dispatcher which uses a pool of threads to distribute
 // requests to an underlying handlers concurrently.
+//
+// Each worker thread services its own port; connections are assigned to
+// a port round-robin when they are added, so all messages for a given
+// connection are handled on the same thread and connections never
+// contend with each other for a shared port.
 class VfsDispatcher final : public fs::Dispatcher {
 public:
     ~VfsDispatcher();
@@ -61,7 +66,7 @@ public:
     static mx_status_t Create(mxio_dispatcher_cb_t cb, uint32_t pool_size,
                               mxtl::unique_ptr<fs::Dispatcher>* out);
     void DisconnectHandler(Handler*, bool);
-    int Loop();
+    int Loop(uint32_t thread_index);
 private:
     VfsDispatcher(mxio_dispatcher_cb_t cb, uint32_t pool_size);
     mx_status_t AddVFSHandler(mx_handle_t h, void* cb, void* iostate) final;
@@ -75,10 +80,12 @@ private:
     mtx_t lock_;
     mxtl::DoublyLinkedList<mxtl::unique_ptr<Handler>> handlers_ __TA_GUARDED(lock_);
     uint32_t n_threads_;
+    // next port to assign a new connection to
+    uint32_t next_port_ __TA_GUARDED(lock_);
 
-    // NOTE: ioport_ intentionally declared after handlers_, so it
-    // is shut down before the handlers are destroyed.
-    mx::port ioport_;
+    // NOTE: ioports_ intentionally declared after handlers_, so they
+    // are shut down before the handlers are destroyed.
+    mxtl::Array<mx::port> ioports_;
 };
 
 } // namespace fs
@@ -79,15 +79,37 @@ public:
     ~VnodeWatcher();
 
     mx_handle_t h;
+
+    // Event records, packed end to end exactly as they appear on the wire,
+    // waiting to be sent as a single channel message.
+    static constexpr size_t kMaxPending = 1024;
+    uint8_t pending[kMaxPending];
+    size_t pending_len;
 };
 
-class WatcherContainer {
+class WatcherContainer : public mxtl::DoublyLinkedListable<WatcherContainer*> {
 public:
+    WatcherContainer();
+    ~WatcherContainer();
     virtual mx_status_t WatchDir(mx_handle_t* out) final;
     virtual void NotifyAdd(const char* name, size_t len) final;
 private:
+    // Body of the process-wide thread which flushes containers with
+    // buffered events once their deadline passes (vfs-watcher.cpp).
+    static int FlushThread(void* arg);
+
+    // Sends each watcher's buffered events as one channel message.
+    // Flush additionally acquires lock_; both require the flush lock.
+    void Flush();
+    void FlushLocked();
+
     mxtl::Mutex lock_;
     mxtl::DoublyLinkedList<mxtl::unique_ptr<VnodeWatcher>> watch_list_ __TA_GUARDED(lock_);
+
+    // While this container has buffered events it sits on the flush queue.
+    // Both fields are guarded by the flush lock in vfs-watcher.cpp.
+    mx_time_t flush_deadline_;
+    bool queued_;
 };
 
 #endif // __Fuchsia__
@@ -139,6 +161,12 @@ public:
         *type = MXIO_PROTOCOL_REMOTE;
         return 0;
     }
+
+    // Serializes operations dispatched against this vnode on behalf of
+    // multiple client connections (see vfs_handler in vfs-rpc.cpp).
+    // Held before vfs_lock; code already holding vfs_lock must not
+    // acquire it.
+    mtx_t* ConnectionLock() { return &connection_lock_; }
 #endif
 
     virtual mx_status_t WatchDir(mx_handle_t* out) { return ERR_NOT_SUPPORTED; }
@@ -272,9 +300,16 @@ public:
     bool IsDetachedDevice() const { return (flags_ & V_FLAG_DEVICE_DETACHED); }
 protected:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Vnode);
-    Vnode() : flags_(0) {};
+    Vnode() : flags_(0) {
+#ifdef __Fuchsia__
+        mtx_init(&connection_lock_, mtx_plain);
+#endif
+    };
 
     uint32_t flags_;
+#ifdef __Fuchsia__
+    mtx_t connection_lock_;
+#endif
 };
 
 struct Vfs {
@@ -309,6 +344,12 @@ struct Vfs {
 // vfs dispatch  (NOTE: only used for mounted roots)
 mx_handle_t vfs_rpc_server(mx_handle_t h, mxtl::RefPtr<fs::Vnode> vn);
 
+// Serve |h| as the root of a mounted filesystem on |dispatcher|, signaling
+// the peer that the filesystem is ready. Unlike vfs_rpc_server, does not
+// block; used by resident servers which host several mounts in one process.
+mx_status_t vfs_rpc_serve_root(mxio_dispatcher_t* dispatcher, mx_handle_t h,
+                               mxtl::RefPtr<fs::Vnode> vn);
+
 using Vnode = fs::Vnode;
 
 #else  // ifdef __cplusplus
@@ -337,4 +378,11 @@ mx_status_t vfs_unmount_handle(mx_handle_t h, mx_time_t deadline);
 // response of each one with the provided deadline.
 mx_status_t vfs_uninstall_all(mx_time_t deadline);
 
+#ifdef __Fuchsia__
+// Control whether IOCTL_VFS_UNMOUNT_FS exits the process (the default).
+// Resident servers hosting several mounts disable this so an unmount tears
+// down a single filesystem only.
+void vfs_set_exit_on_unmount(bool do_exit);
+#endif
+
 __END_CDECLS
@@ -23,12 +23,20 @@
 
 #define MXDEBUG 0
 
-// ** NOTE -- this prototype multithreaded dispatcher is only used by
-// ** minfs as part of ongoing multithread development. Not yet safe
-// ** for general consumption
+// Multithreaded dispatcher. Each worker thread owns a port; connections
+// are sharded across the ports round-robin when they are added, so a
+// given connection is always serviced by the same thread.
 
 namespace fs {
 
+namespace {
+// per-thread startup state, freed by the thread once it has been consumed
+struct ThreadInit {
+    VfsDispatcher* dispatcher;
+    uint32_t index;
+};
+} // namespace anonymous
+
 Handler::~Handler() {
     Close();
 }
@@ -49,7 +57,7 @@ void Handler::Close() {
 }
 
 VfsDispatcher::VfsDispatcher(mxio_dispatcher_cb_t cb, uint32_t pool_size) :
-    cb_(cb), pool_size_(pool_size), n_threads_(0) {
+    cb_(cb), pool_size_(pool_size), n_threads_(0), next_port_(0) {
     mtx_init(&lock_, mtx_plain);
 }
 
@@ -98,7 +106,7 @@ void VfsDispatcher::DisconnectHandler(Handler* handler, bool need_close_cb) {
     }
 }
 
-int VfsDispatcher::Loop() {
+int VfsDispatcher::Loop(uint32_t thread_index) {
     mx_status_t r;
 
     // when draining queue, limit the number of messages you take
@@ -107,10 +115,13 @@ int VfsDispatcher::Loop() {
     char tname[128];
     GetThreadName(tname, sizeof(tname));
 
+    // this thread exclusively services the connections sharded onto its port
+    const mx::port& ioport = ioports_[thread_index];
+
     for (;;) {
         mx_port_packet_t packet;
 
-        if ((r = ioport_.wait(MX_TIME_INFINITE, &packet, 0u)) < 0) {
+        if ((r = ioport.wait(MX_TIME_INFINITE, &packet, 0u)) < 0) {
             xprintf("mxio_dispatcher: port wait failed %d, worker exiting\n", r);
             return NO_ERROR;
         }
@@ -118,15 +129,10 @@ int VfsDispatcher::Loop() {
         xprintf("port_wait: thread %s \n", tname);
 
         if ((packet.signal.observed & MX_EVENT_SIGNALED) != 0) {
-            // reset for the next thread
-            r = shutdown_event_.wait_async(ioport_, 0u, MX_EVENT_SIGNALED,
-                                           MX_WAIT_ASYNC_ONCE);
-            if (r != NO_ERROR) {
-                FS_TRACE_ERROR("vfs-dispatcher: error, couldn't reset thread event\n");
-            }
-            // exit thread
+            // the shutdown event was armed once on every port, so each
+            // worker receives its own copy; just exit
             xprintf("%s: suicide\n", tname);
-            return r;
+            return NO_ERROR;
         }
 
         xprintf("thrd_: port_wait: returns key %p effective:%#x \n",
@@ -144,7 +150,7 @@ int VfsDispatcher::Loop() {
                 }
             }
             // maybe more work to do: re-arm handler to fire again
-            if ((r = handler->SetAsyncCallback(ioport_))!= NO_ERROR){
+            if ((r = handler->SetAsyncCallback(ioport))!= NO_ERROR){
                 DisconnectHandler(handler, true);
                 goto free_handler;
             }
@@ -177,18 +183,27 @@ mx_status_t VfsDispatcher::Create(mxio_dispatcher_cb_t cb, uint32_t pool_size,
     }
     dispatcher->t_.reset(t, pool_size);
 
-    mx_status_t status;
-    if ((status = mx::port::create(MX_PORT_OPT_V2, &dispatcher->ioport_)) != NO_ERROR) {
-        return status;
+    mx::port* ports = new (&ac) mx::port[pool_size];
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
     }
+    dispatcher->ioports_.reset(ports, pool_size);
+
+    mx_status_t status;
     if ((status = mx::event::create(0u, &dispatcher->shutdown_event_)) != NO_ERROR) {
         return status;
     }
-    status = dispatcher->shutdown_event_.wait_async(dispatcher->ioport_, 0u,
-                                                    MX_EVENT_SIGNALED,
-                                                    MX_WAIT_ASYNC_ONCE);
-    if (status != NO_ERROR) {
-        return status;
+    for (uint32_t i = 0; i < pool_size; i++) {
+        if ((status = mx::port::create(MX_PORT_OPT_V2, &dispatcher->ioports_[i])) != NO_ERROR) {
+            return status;
+        }
+        // arm the shutdown event on every port, so each worker sees it
+        status = dispatcher->shutdown_event_.wait_async(dispatcher->ioports_[i], 0u,
+                                                        MX_EVENT_SIGNALED,
+                                                        MX_WAIT_ASYNC_ONCE);
+        if (status != NO_ERROR) {
+            return status;
+        }
     }
 
     if ((status = dispatcher->Start("VFS Dispatcher")) != NO_ERROR) {
@@ -199,8 +214,11 @@ mx_status_t VfsDispatcher::Create(mxio_dispatcher_cb_t cb, uint32_t pool_size,
 }
 
 static int mxio_dispatcher_thread(void* arg) {
-    VfsDispatcher* md = reinterpret_cast<VfsDispatcher*>(arg);
-    return md->Loop();
+    mxtl::unique_ptr<ThreadInit> init(reinterpret_cast<ThreadInit*>(arg));
+    VfsDispatcher* md = init->dispatcher;
+    uint32_t index = init->index;
+    init.reset();
+    return md->Loop(index);
 }
 
 mx_status_t VfsDispatcher::Start(const char* name) {
@@ -223,8 +241,14 @@ mx_status_t VfsDispatcher::Start(const char* name) {
         }
 
         xprintf("start thread %s\n", namebuf);
+        AllocChecker ac;
+        ThreadInit* init = new (&ac) ThreadInit{this, n_threads_};
+        if (!ac.check()) {
+            return ERR_NO_MEMORY;
+        }
         if ((r = thrd_create_with_name(&t_[n_threads_], mxio_dispatcher_thread,
-                                       this, namebuf)) != thrd_success) {
+                                       init, namebuf)) != thrd_success) {
+            delete init;
             return ERR_NO_RESOURCES;
         } else {
             n_threads_++;
@@ -243,9 +267,14 @@ mx_status_t VfsDispatcher::AddVFSHandler(mx_handle_t h, void* cb, void* cookie)
 
     mxtl::AutoLock md_lock(&lock_);
 
-    // set us up to receive read/close callbacks from handler on ioport_
+    // shard the connection onto the next port round-robin; it will be
+    // serviced by that port's thread for its entire lifetime
+    const mx::port& ioport = ioports_[next_port_];
+    next_port_ = (next_port_ + 1) % pool_size_;
+
+    // set us up to receive read/close callbacks from handler on ioport
     mx_status_t status;
-    if ((status = handler->SetAsyncCallback(ioport_)) != NO_ERROR) {
+    if ((status = handler->SetAsyncCallback(ioport)) != NO_ERROR) {
         return status;
     } else {
         handlers_.push_back(mxtl::move(handler));
@@ -271,6 +271,60 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
         ssize_t r = vn->Write(msg->data, len, msg->arg2.off);
         return static_cast<mx_status_t>(r);
     }
+    case MXRIO_WRITE_VMO: {
+        // Bulk write: the client staged the data in the vmo sent as
+        // handle[0] and arg2.off is the byte count.  Stream it into the
+        // vnode locally rather than one message per chunk.
+        mx_handle_t vmo = msg->handle[0];
+        mx_status_t r;
+        if ((msg->arg2.off < 0) || (msg->arg2.off > INT32_MAX)) {
+            mx_handle_close(vmo);
+            return ERR_INVALID_ARGS;
+        }
+        size_t length = static_cast<size_t>(msg->arg2.off);
+        if (ios->io_flags & O_APPEND) {
+            vnattr_t attr;
+            if ((r = vn->Getattr(&attr)) < 0) {
+                mx_handle_close(vmo);
+                return r;
+            }
+            ios->io_off = attr.size;
+        }
+        size_t count = 0;
+        mx_status_t status = NO_ERROR;
+        while (count < length) {
+            size_t xfer = length - count;
+            if (xfer > MXIO_CHUNK_SIZE) {
+                xfer = MXIO_CHUNK_SIZE;
+            }
+            size_t actual;
+            if ((status = mx_vmo_read(vmo, msg->data, count, xfer,
+                                      &actual)) != NO_ERROR) {
+                break;
+            }
+            if (actual != xfer) {
+                status = ERR_IO;
+                break;
+            }
+            ssize_t written = vn->Write(msg->data, xfer, ios->io_off);
+            if (written < 0) {
+                status = static_cast<mx_status_t>(written);
+                break;
+            }
+            ios->io_off += written;
+            count += written;
+            if (static_cast<size_t>(written) < xfer) {
+                // short write; report what landed
+                break;
+            }
+        }
+        mx_handle_close(vmo);
+        if ((count == 0) && (status != NO_ERROR)) {
+            return status;
+        }
+        msg->arg2.off = ios->io_off;
+        return static_cast<mx_status_t>(count);
+    }
     case MXRIO_SEEK: {
         vnattr_t attr;
         mx_status_t r;
@@ -493,6 +547,8 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
                                       &msg->handle[0]);
         if (status == NO_ERROR) {
             msg->hcount = 1;
+            // echo the (possibly adjusted) window back to the client
+            msg->datalen = sizeof(mxrio_mmap_data_t);
         }
         return status;
     }
@@ -510,20 +566,21 @@ mx_status_t vfs_handler_vn(mxrio_msg_t* msg, mxtl::RefPtr<Vnode> vn, vfs_iostate
     }
 }
 
-// TODO(orr): temporary; prevent multithread weirdness while we
-// make locking more fine grained
-static mtx_t vfs_big_lock = MTX_INIT;
-
 mx_status_t vfs_handler(mxrio_msg_t* msg, void* cookie) {
     vfs_iostate_t* ios = static_cast<vfs_iostate_t*>(cookie);
 
-    mxtl::AutoLock lock(&vfs_big_lock);
+    // A connection is sharded onto a single dispatcher thread, so the
+    // iostate is only ever touched by one thread at a time. The vnode may
+    // be shared between connections; per-vnode state is serialized here,
+    // and path operations additionally serialize on vfs_lock within.
     mxtl::RefPtr<Vnode> vn = ios->vn;
+    mxtl::AutoLock lock(vn->ConnectionLock());
     mx_status_t status = vfs_handler_vn(msg, mxtl::move(vn), ios);
     return status;
 }
 
-mx_handle_t vfs_rpc_server(mx_handle_t h, mxtl::RefPtr<Vnode> vn) {
+mx_status_t vfs_rpc_serve_root(mxio_dispatcher_t* dispatcher, mx_handle_t h,
+                               mxtl::RefPtr<Vnode> vn) {
     vfs_iostate_t* ios;
     mx_status_t r;
 
@@ -532,20 +589,29 @@ mx_handle_t vfs_rpc_server(mx_handle_t h, mxtl::RefPtr<Vnode> vn) {
     ios->vn = mxtl::move(vn);  // reference passed in by caller
     ios->io_flags = 0;
 
-    mxio_dispatcher_t* vfs_dispatcher;
-    if ((r = mxio_dispatcher_create(&vfs_dispatcher, mxrio_handler)) < 0) {
+    // Tell the calling process that we've mounted
+    if ((r = mx_object_signal_peer(h, 0, MX_USER_SIGNAL_0)) != NO_ERROR) {
         free(ios);
         return r;
     }
 
-    // Tell the calling process that we've mounted
-    if ((r = mx_object_signal_peer(h, 0, MX_USER_SIGNAL_0)) != NO_ERROR) {
+    if ((r = mxio_dispatcher_add(dispatcher, h, (void*) vfs_handler, ios)) < 0) {
         free(ios);
         return r;
     }
 
-    if ((r = mxio_dispatcher_add(vfs_dispatcher, h, (void*) vfs_handler, ios)) < 0) {
-        free(ios);
+    return NO_ERROR;
+}
+
+mx_handle_t vfs_rpc_server(mx_handle_t h, mxtl::RefPtr<Vnode> vn) {
+    mx_status_t r;
+
+    mxio_dispatcher_t* vfs_dispatcher;
+    if ((r = mxio_dispatcher_create(&vfs_dispatcher, mxrio_handler)) < 0) {
+        return r;
+    }
+
+    if ((r = vfs_rpc_serve_root(vfs_dispatcher, h, mxtl::move(vn))) != NO_ERROR) {
         return r;
     }
 
@@ -9,6 +9,7 @@
 #include <unistd.h>
 
 #ifdef __Fuchsia__
+#include <threads.h>
 #include <magenta/device/vfs.h>
 #include <magenta/syscalls.h>
 #include <mxtl/auto_lock.h>
@@ -19,7 +20,30 @@
 
 namespace fs {
 
-VnodeWatcher::VnodeWatcher() : h(MX_HANDLE_INVALID) {}
+namespace {
+
+// Watch events are coalesced rather than sent one per channel message:
+// NotifyAdd appends records to each watcher's pending buffer and queues the
+// container here, and a single lazily created thread flushes queued
+// containers once a short delay has passed.  A hotplug burst creating
+// dozens of nodes then costs each watching client one or two channel reads
+// instead of one syscall per node.
+//
+// Lock ordering: flush_lock is always acquired before any container's
+// lock_.
+constexpr mx_time_t kFlushDelay = MX_MSEC(1);
+
+mtx_t flush_lock = MTX_INIT;
+cnd_t flush_cnd = CND_INIT;
+bool flush_thread_running;
+
+// Created on first use and intentionally never destroyed: containers may
+// still be queued when the process exits.
+mxtl::DoublyLinkedList<WatcherContainer*>* flush_queue;
+
+} // namespace
+
+VnodeWatcher::VnodeWatcher() : h(MX_HANDLE_INVALID), pending_len(0) {}
 
 VnodeWatcher::~VnodeWatcher() {
     if (h != MX_HANDLE_INVALID) {
@@ -27,6 +51,17 @@ VnodeWatcher::~VnodeWatcher() {
     }
 }
 
+WatcherContainer::WatcherContainer() : flush_deadline_(0), queued_(false) {}
+
+WatcherContainer::~WatcherContainer() {
+    // The directory is going away, and with it any buffered events.
+    mxtl::AutoLock guard(&flush_lock);
+    if (queued_) {
+        flush_queue->erase(*this);
+        queued_ = false;
+    }
+}
+
 mx_status_t WatcherContainer::WatchDir(mx_handle_t* out) {
     AllocChecker ac;
     mxtl::unique_ptr<VnodeWatcher> watcher(new (&ac) VnodeWatcher);
@@ -41,26 +76,40 @@ mx_status_t WatcherContainer::WatchDir(mx_handle_t* out) {
     return NO_ERROR;
 }
 
-void WatcherContainer::NotifyAdd(const char* name, size_t len) {
-    if (len > VFS_WATCH_NAME_MAX) {
-        return;
-    }
-
-    mxtl::AutoLock lock(&lock_);
-
-    if (watch_list_.is_empty()) {
-        return;
+int WatcherContainer::FlushThread(void*) {
+    mtx_lock(&flush_lock);
+    for (;;) {
+        if (flush_queue->is_empty()) {
+            cnd_wait(&flush_cnd, &flush_lock);
+            continue;
+        }
+        // Containers queue with a fixed delay, so the head of the queue
+        // always has the earliest deadline.
+        mx_time_t deadline = flush_queue->front().flush_deadline_;
+        if (mx_time_get(MX_CLOCK_MONOTONIC) < deadline) {
+            // Sleep unlocked.  The queue may change meanwhile, so re-examine
+            // the head afterwards rather than holding a reference to it.
+            mtx_unlock(&flush_lock);
+            mx_nanosleep(deadline);
+            mtx_lock(&flush_lock);
+            continue;
+        }
+        WatcherContainer* container = flush_queue->pop_front();
+        container->queued_ = false;
+        container->Flush();
     }
+}
 
-    uint8_t msg[len + 2];
-    msg[0] = VFS_WATCH_EVT_ADDED;
-    msg[1] = static_cast<uint8_t>(len);
-    memcpy(msg + 2, name, len);
-
+void WatcherContainer::FlushLocked() {
     for (auto it = watch_list_.begin(); it != watch_list_.end();) {
-        mx_status_t status = mx_channel_write(it->h, 0, msg,
-                                              static_cast<uint32_t>(len + 2),
+        if (it->pending_len == 0) {
+            ++it;
+            continue;
+        }
+        mx_status_t status = mx_channel_write(it->h, 0, it->pending,
+                                              static_cast<uint32_t>(it->pending_len),
                                               nullptr, 0);
+        it->pending_len = 0;
         if (status < 0) {
             // Lazily remove watchers when their handles cannot accept incoming
             // watch messages.
@@ -73,4 +122,76 @@ void WatcherContainer::NotifyAdd(const char* name, size_t len) {
     }
 }
 
+void WatcherContainer::Flush() {
+    mxtl::AutoLock lock(&lock_);
+    FlushLocked();
+}
+
+void WatcherContainer::NotifyAdd(const char* name, size_t len) {
+    if (len > VFS_WATCH_NAME_MAX) {
+        return;
+    }
+
+    mxtl::AutoLock guard(&flush_lock);
+    mxtl::AutoLock lock(&lock_);
+
+    if (watch_list_.is_empty()) {
+        return;
+    }
+
+    for (auto it = watch_list_.begin(); it != watch_list_.end();) {
+        // If the record doesn't fit, flush what has accumulated so far.
+        if (it->pending_len + len + 2 > sizeof(it->pending)) {
+            mx_status_t status = mx_channel_write(it->h, 0, it->pending,
+                                                  static_cast<uint32_t>(it->pending_len),
+                                                  nullptr, 0);
+            it->pending_len = 0;
+            if (status < 0) {
+                // Lazily remove watchers when their handles cannot accept
+                // incoming watch messages.
+                auto to_remove = it;
+                ++it;
+                watch_list_.erase(to_remove);
+                continue;
+            }
+        }
+        it->pending[it->pending_len] = VFS_WATCH_EVT_ADDED;
+        it->pending[it->pending_len + 1] = static_cast<uint8_t>(len);
+        memcpy(it->pending + it->pending_len + 2, name, len);
+        it->pending_len += len + 2;
+        ++it;
+    }
+
+    if (queued_) {
+        return;
+    }
+
+    if (flush_queue == nullptr) {
+        AllocChecker ac;
+        flush_queue = new (&ac) mxtl::DoublyLinkedList<WatcherContainer*>();
+        if (!ac.check()) {
+            flush_queue = nullptr;
+            FlushLocked();
+            return;
+        }
+    }
+    if (!flush_thread_running) {
+        thrd_t t;
+        if (thrd_create_with_name(&t, FlushThread, nullptr,
+                                  "vfs-watch-flush") != thrd_success) {
+            // No flusher; deliver synchronously rather than dropping the
+            // events.
+            FlushLocked();
+            return;
+        }
+        thrd_detach(t);
+        flush_thread_running = true;
+    }
+
+    flush_deadline_ = mx_time_get(MX_CLOCK_MONOTONIC) + kFlushDelay;
+    queued_ = true;
+    flush_queue->push_back(this);
+    cnd_signal(&flush_cnd);
+}
+
 } // namespace fs
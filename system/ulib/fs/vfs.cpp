@@ -23,6 +23,14 @@ uint32_t __trace_bits;
 
 #ifdef __Fuchsia__
 mtx_t vfs_lock = MTX_INIT;
+
+// Resident servers host several mounts in one process, so an unmount tears
+// down a single filesystem rather than exiting.
+static bool vfs_exit_on_unmount = true;
+
+void vfs_set_exit_on_unmount(bool do_exit) {
+    vfs_exit_on_unmount = do_exit;
+}
 #endif
 
 namespace fs {
@@ -313,8 +321,11 @@ ssize_t Vfs::Ioctl(mxtl::RefPtr<Vnode> vn, uint32_t op, const void* in_buf, size
     }
     case IOCTL_VFS_UNMOUNT_FS: {
         vfs_uninstall_all(MX_TIME_INFINITE);
-        vn->Ioctl(op, in_buf, in_len, out_buf, out_len);
-        exit(0);
+        ssize_t r = vn->Ioctl(op, in_buf, in_len, out_buf, out_len);
+        if (vfs_exit_on_unmount) {
+            exit(0);
+        }
+        return r;
     }
 #endif
     default:
@@ -214,154 +214,134 @@ void gfx_putchar(gfx_surface* surface, const gfx_font* font, unsigned ch, unsign
     surface->putchar(surface, font, ch, x, y, fg, bg);
 }
 
+// Copy a rect one row at a time with memmove, in an order that is safe
+// for overlapping source and destination rects (the virtcon scroll
+// case). memmove handles any overlap within a row, and copying the
+// rows bottom-up when the destination is below the source handles
+// overlap between rows. The memcpy/memmove/memset routines use the
+// wide (vectorized or string-instruction) paths the cpu offers, so the
+// per-pixel loops this replaces were leaving most of the store
+// bandwidth on the table.
 static void copyrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
     const uint8_t* src = &((const uint8_t*)surface->ptr)[x + y * surface->stride];
     uint8_t* dest = &((uint8_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
     if (dest < src) {
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest += surface->stride;
+            src += surface->stride;
         }
     } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
+        // copy bottom-up
+        src += (height - 1) * surface->stride;
+        dest += (height - 1) * surface->stride;
 
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest -= surface->stride;
+            src -= surface->stride;
         }
     }
 }
 
 static void fillrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint8_t* dest = &((uint8_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
     uint8_t color8 = (uint8_t)(surface->translate_color(color));
 
-    unsigned i, j;
+    unsigned i;
     for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color8;
-            dest++;
-        }
-        dest += stride_diff;
+        memset(dest, color8, width);
+        dest += surface->stride;
     }
 }
 
 static void copyrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
     const uint16_t* src = &((const uint16_t*)surface->ptr)[x + y * surface->stride];
     uint16_t* dest = &((uint16_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
     if (dest < src) {
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest += surface->stride;
+            src += surface->stride;
         }
     } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
+        // copy bottom-up
+        src += (height - 1) * surface->stride;
+        dest += (height - 1) * surface->stride;
 
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest -= surface->stride;
+            src -= surface->stride;
         }
     }
 }
 
 static void fillrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint16_t* dest = &((uint16_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
     uint16_t color16 = (uint16_t)(surface->translate_color(color));
 
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color16;
-            dest++;
-        }
-        dest += stride_diff;
+    // Fill the first row by pixel, then replicate it with memcpy.
+    unsigned j;
+    for (j = 0; j < width; j++) {
+        dest[j] = color16;
+    }
+
+    uint16_t* row = dest;
+    unsigned i;
+    for (i = 1; i < height; i++) {
+        row += surface->stride;
+        memcpy(row, dest, width * sizeof(*dest));
     }
 }
 
 static void copyrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
     const uint32_t* src = &((const uint32_t*)surface->ptr)[x + y * surface->stride];
     uint32_t* dest = &((uint32_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
     if (dest < src) {
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest += surface->stride;
+            src += surface->stride;
         }
     } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
+        // copy bottom-up
+        src += (height - 1) * surface->stride;
+        dest += (height - 1) * surface->stride;
 
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+            memmove(dest, src, width * sizeof(*dest));
+            dest -= surface->stride;
+            src -= surface->stride;
         }
     }
 }
 
 static void fillrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint32_t* dest = &((uint32_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color;
-            dest++;
-        }
-        dest += stride_diff;
+    // Fill the first row by pixel, then replicate it with memcpy.
+    unsigned j;
+    for (j = 0; j < width; j++) {
+        dest[j] = color;
+    }
+
+    uint32_t* row = dest;
+    unsigned i;
+    for (i = 1; i < height; i++) {
+        row += surface->stride;
+        memcpy(row, dest, width * sizeof(*dest));
     }
 }
 
@@ -494,20 +474,14 @@ void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned
         // 16 bit to 16 bit
         const uint16_t* src = &((const uint16_t*)source->ptr)[srcx + srcy * source->stride];
         uint16_t* dest = &((uint16_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
 
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+        xprintf("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+            memcpy(dest, src, width * sizeof(*dest));
+            dest += target->stride;
+            src += source->stride;
         }
     } else if (source->format == MX_PIXEL_FORMAT_ARGB_8888 && target->format == MX_PIXEL_FORMAT_ARGB_8888) {
         // both are 32 bit modes, both alpha
@@ -533,39 +507,27 @@ void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned
         // both are 32 bit modes, no alpha
         const uint32_t* src = &((const uint32_t*)source->ptr)[srcx + srcy * source->stride];
         uint32_t* dest = &((uint32_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
 
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+        xprintf("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+            memcpy(dest, src, width * sizeof(*dest));
+            dest += target->stride;
+            src += source->stride;
         }
     } else if (source->format == MX_PIXEL_FORMAT_MONO_1 && target->format == MX_PIXEL_FORMAT_MONO_1) {
         // both are 8 bit modes, no alpha
         const uint8_t* src = &((const uint8_t*)source->ptr)[srcx + srcy * source->stride];
         uint8_t* dest = &((uint8_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
 
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+        xprintf("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-        unsigned i, j;
+        unsigned i;
         for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+            memcpy(dest, src, width * sizeof(*dest));
+            dest += target->stride;
+            src += source->stride;
         }
     } else {
         xprintf("gfx_surface_blend: unimplemented colorspace combination (source %d target %d)\n", source->format, target->format);
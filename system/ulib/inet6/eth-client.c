@@ -97,6 +97,22 @@ mx_status_t eth_queue_rx(eth_client_t* eth, void* cookie,
     return mx_fifo_write(eth->rx_fifo, &e, sizeof(e), &actual);
 }
 
+mx_status_t eth_queue_rx_batch(eth_client_t* eth,
+                               eth_fifo_entry_t* entries, uint32_t count) {
+    mx_status_t status;
+    uint32_t actual;
+    IORING_TRACE("eth:rx+ batch n=%u\n", count);
+    while (count > 0) {
+        if ((status = mx_fifo_write(eth->rx_fifo, entries,
+                                    count * sizeof(entries[0]), &actual)) < 0) {
+            return status;
+        }
+        entries += actual;
+        count -= actual;
+    }
+    return NO_ERROR;
+}
+
 mx_status_t eth_complete_tx(eth_client_t* eth, void* ctx,
                             void (*func)(void* ctx, void* cookie)) {
     eth_fifo_entry_t entries[eth->tx_size];
@@ -34,6 +34,12 @@ mx_status_t eth_complete_tx(eth_client_t* eth, void* ctx,
 mx_status_t eth_queue_rx(eth_client_t* eth, void* cookie,
                          void* data, size_t len, uint32_t options);
 
+// Enqueue a batch of packets for reception with as few fifo
+// writes as possible.  The caller fills in the entries
+// (offsets are relative to the iobuf).
+mx_status_t eth_queue_rx_batch(eth_client_t* eth,
+                               eth_fifo_entry_t* entries, uint32_t count);
+
 // Process all received buffers
 mx_status_t eth_complete_rx(eth_client_t* eth, void* ctx,
                             void (*func)(void* ctx, void* cookie, size_t len, uint32_t flags));
@@ -128,9 +128,20 @@ static inline uint32_t _swap32(uint32_t n) {
 char* ip6toa(char* _out, void* ip6addr);
 #define IP6TOAMAX 40
 
+// flags for eth_recv(); when the interface reports CSUM_OK the device
+// already verified the frame's L4 checksum and the stack skips its own
+// software verification
+#define ETH_RECV_CSUM_OK (1u)
+
+// transmit offload flags for eth_send(); the stack only sets flags the
+// interface reported via eth_tx_offload().  The L4 checksum field must
+// be seeded with the pseudo-header sum; the device sums the rest.
+#define ETH_SEND_CSUM_UDP6  (1u)
+#define ETH_SEND_CSUM_ICMP6 (2u)
+
 // provided by inet6.c
 void ip6_init(void* macaddr);
-void eth_recv(void* data, size_t len);
+void eth_recv(void* data, size_t len, uint32_t flags);
 
 typedef struct eth_buffer eth_buffer_t;
 
@@ -138,7 +149,10 @@ typedef struct eth_buffer eth_buffer_t;
 int eth_get_buffer(size_t len, void** data, eth_buffer_t** out);
 void eth_put_buffer(eth_buffer_t* ethbuf);
 
-int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len);
+int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len, uint32_t flags);
+
+// returns the ETH_SEND_* offloads the interface supports
+uint32_t eth_tx_offload(void);
 
 int eth_add_mcast_filter(const mac_addr_t* addr);
 
@@ -147,6 +161,18 @@ int udp6_send(const void* data, size_t len,
               const ip6_addr_t* daddr, uint16_t dport,
               uint16_t sport);
 
+#define UDP6_MAX_PAYLOAD (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN)
+
+// zero-copy variant of udp6_send(): borrow a transmit buffer, compose
+// the payload (up to UDP6_MAX_PAYLOAD bytes) directly in place, then
+// hand it back with udp6_send_from(), which writes the headers around
+// it and transmits without a further copy.  udp6_send_from() consumes
+// the buffer, releasing it if transmission fails.
+int udp6_get_buffer(void** payload, eth_buffer_t** out);
+int udp6_send_from(eth_buffer_t* ethbuf, void* payload, size_t len,
+                   const ip6_addr_t* daddr, uint16_t dport,
+                   uint16_t sport);
+
 // implement to recive UDP packets
 void udp6_recv(void* data, size_t len,
                const ip6_addr_t* daddr, uint16_t dport,
@@ -143,15 +143,38 @@ static int resolve_ip6(mac_addr_t* _mac, const ip6_addr_t* _ip) {
 }
 
 static uint16_t checksum(const void* _data, size_t len, uint16_t _sum) {
-    uint32_t sum = _sum;
-    const uint16_t* data = _data;
+    uint64_t sum = _sum;
+    const uint8_t* data = _data;
+
+    // Accumulate 64 bits at a time, folding the end-around carry back in
+    // after each add.  Ones-complement addition is word-size agnostic, so
+    // the wide sums fold down to the same 16-bit result as a 16-bit loop.
+    // The loads go through memcpy so unaligned buffers are safe; the
+    // compiler lowers them to plain loads.
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        sum += word;
+        if (sum < word) {
+            sum++;
+        }
+        data += 8;
+        len -= 8;
+    }
     while (len > 1) {
-        sum += *data++;
+        uint16_t word;
+        memcpy(&word, data, sizeof(word));
+        sum += word;
+        if (sum < word) {
+            sum++;
+        }
+        data += 2;
         len -= 2;
     }
     if (len) {
         sum += (*data & 0xFF);
     }
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
     while (sum > 0xFFFF) {
         sum = (sum & 0xFFFF) + (sum >> 16);
     }
@@ -187,6 +210,17 @@ static unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length) {
     }
 }
 
+// partial (uncomplemented) sum of just the pseudo-header, used to seed
+// the checksum field when the device finishes the sum in hardware
+static unsigned ip6_pseudo_checksum(ip6_hdr_t* ip, unsigned type) {
+    uint16_t sum;
+
+    sum = checksum(&ip->length, 2, htons(type));
+    sum = checksum(&ip->src, 32, sum);
+
+    return sum;
+}
+
 static int ip6_setup(ip6_pkt_t* p, const ip6_addr_t* daddr, size_t length, uint8_t type) {
     mac_addr_t dmac;
 
@@ -210,16 +244,21 @@ static int ip6_setup(ip6_pkt_t* p, const ip6_addr_t* daddr, size_t length, uint8
     return 0;
 }
 
-#define UDP6_MAX_PAYLOAD (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN - UDP_HDR_LEN)
-
-int udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t dport, uint16_t sport) {
-    if (dlen > UDP6_MAX_PAYLOAD)
-        return -1;
-    size_t length = dlen + UDP_HDR_LEN;
+int udp6_get_buffer(void** payload, eth_buffer_t** out) {
     udp_pkt_t* p;
-    eth_buffer_t* ethbuf;
-    if (eth_get_buffer(ETH_MTU + 2, (void**) &p, &ethbuf))
+    if (eth_get_buffer(ETH_MTU + 2, (void**) &p, out))
         return -1;
+    *payload = p->data;
+    return 0;
+}
+
+int udp6_send_from(eth_buffer_t* ethbuf, void* payload, size_t dlen,
+                   const ip6_addr_t* daddr, uint16_t dport, uint16_t sport) {
+    udp_pkt_t* p = (udp_pkt_t*)((uint8_t*)payload - sizeof(udp_pkt_t));
+    size_t length = dlen + UDP_HDR_LEN;
+
+    if (dlen > UDP6_MAX_PAYLOAD)
+        goto fail;
     if (ip6_setup((void*)p, daddr, length, HDR_UDP))
         goto fail;
 
@@ -227,17 +266,34 @@ int udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t d
     p->udp.src_port = htons(sport);
     p->udp.dst_port = htons(dport);
     p->udp.length = htons(length);
-    p->udp.checksum = 0;
 
-    memcpy(p->data, data, dlen);
+    if (eth_tx_offload() & ETH_SEND_CSUM_UDP6) {
+        // seed the field with the pseudo-header sum and let the device
+        // finish the checksum in hardware
+        p->udp.checksum = ip6_pseudo_checksum(&p->ip6, HDR_UDP);
+        return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length, ETH_SEND_CSUM_UDP6);
+    }
+
+    p->udp.checksum = 0;
     p->udp.checksum = ip6_checksum(&p->ip6, HDR_UDP, length);
-    return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length);
+    return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length, 0);
 
 fail:
     eth_put_buffer(ethbuf);
     return -1;
 }
 
+int udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, uint16_t dport, uint16_t sport) {
+    if (dlen > UDP6_MAX_PAYLOAD)
+        return -1;
+    void* payload;
+    eth_buffer_t* ethbuf;
+    if (udp6_get_buffer(&payload, &ethbuf))
+        return -1;
+    memcpy(payload, data, dlen);
+    return udp6_send_from(ethbuf, payload, dlen, daddr, dport, sport);
+}
+
 #define ICMP6_MAX_PAYLOAD (ETH_MTU - ETH_HDR_LEN - IP6_HDR_LEN)
 
 static int icmp6_send(const void* data, size_t length, const ip6_addr_t* daddr) {
@@ -254,15 +310,21 @@ static int icmp6_send(const void* data, size_t length, const ip6_addr_t* daddr)
 
     icmp = (void*)p->data;
     memcpy(icmp, data, length);
+
+    if (eth_tx_offload() & ETH_SEND_CSUM_ICMP6) {
+        icmp->checksum = ip6_pseudo_checksum(&p->ip6, HDR_ICMP6);
+        return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length, ETH_SEND_CSUM_ICMP6);
+    }
+
     icmp->checksum = ip6_checksum(&p->ip6, HDR_ICMP6, length);
-    return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length);
+    return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length, 0);
 
 fail:
     eth_put_buffer(ethbuf);
     return -1;
 }
 
-void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
+void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len, uint32_t flags) {
     udp_hdr_t* udp = _data;
     uint16_t sum, n;
 
@@ -270,13 +332,17 @@ void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
         BAD("Bogus Header Len");
     if (udp->checksum == 0)
         BAD("Checksum Invalid");
-    if (udp->checksum == 0xFFFF)
-        udp->checksum = 0;
 
-    sum = checksum(&ip->length, 2, htons(HDR_UDP));
-    sum = checksum(&ip->src, 32 + len, sum);
-    if (sum != 0xFFFF)
-        BAD("Checksum Incorrect");
+    // skip software verification when the device already did it
+    if (!(flags & ETH_RECV_CSUM_OK)) {
+        if (udp->checksum == 0xFFFF)
+            udp->checksum = 0;
+
+        sum = checksum(&ip->length, 2, htons(HDR_UDP));
+        sum = checksum(&ip->src, 32 + len, sum);
+        if (sum != 0xFFFF)
+            BAD("Checksum Incorrect");
+    }
 
     n = ntohs(udp->length);
     if (n < UDP_HDR_LEN)
@@ -290,19 +356,23 @@ void _udp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
               (void*)&ip->src, ntohs(udp->src_port));
 }
 
-void icmp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
+void icmp6_recv(ip6_hdr_t* ip, void* _data, size_t len, uint32_t flags) {
     icmp6_hdr_t* icmp = _data;
     uint16_t sum;
 
     if (icmp->checksum == 0)
         BAD("Checksum Invalid");
-    if (icmp->checksum == 0xFFFF)
-        icmp->checksum = 0;
 
-    sum = checksum(&ip->length, 2, htons(HDR_ICMP6));
-    sum = checksum(&ip->src, 32 + len, sum);
-    if (sum != 0xFFFF)
-        BAD("Checksum Incorrect");
+    // skip software verification when the device already did it
+    if (!(flags & ETH_RECV_CSUM_OK)) {
+        if (icmp->checksum == 0xFFFF)
+            icmp->checksum = 0;
+
+        sum = checksum(&ip->length, 2, htons(HDR_ICMP6));
+        sum = checksum(&ip->src, 32 + len, sum);
+        if (sum != 0xFFFF)
+            BAD("Checksum Incorrect");
+    }
 
     if (icmp->type == ICMP6_NDP_N_SOLICIT) {
         ndp_n_hdr_t* ndp = _data;
@@ -341,7 +411,7 @@ void icmp6_recv(ip6_hdr_t* ip, void* _data, size_t len) {
     }
 }
 
-void eth_recv(void* _data, size_t len) {
+void eth_recv(void* _data, size_t len, uint32_t flags) {
     uint8_t* data = _data;
     ip6_hdr_t* ip;
     uint32_t n;
@@ -382,10 +452,10 @@ void eth_recv(void* _data, size_t len) {
 
     switch (ip->next_header) {
     case HDR_ICMP6:
-        icmp6_recv(ip, data, len);
+        icmp6_recv(ip, data, len, flags);
         break;
     case HDR_UDP:
-        _udp6_recv(ip, data, len);
+        _udp6_recv(ip, data, len, flags);
         break;
     default:
         // do nothing
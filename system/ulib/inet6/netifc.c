@@ -59,6 +59,7 @@ static int netfd = -1;
 static eth_client_t* eth;
 static uint8_t netmac[6];
 static size_t netmtu;
+static uint32_t netfeatures;
 
 static mx_handle_t iovmo;
 static void* iobuf;
@@ -162,7 +163,50 @@ static void tx_complete(void* ctx, void* cookie) {
     eth_put_buffer_locked(cookie, ETH_BUFFER_TX);
 }
 
-int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
+// Completed rx buffers are not returned to the fifo one at a time
+// (a syscall per packet); they accumulate here and are handed back
+// RX_BATCH at a time with a single fifo write.
+#define RX_BATCH 32
+
+static eth_fifo_entry_t rx_pending[NET_BUFFERS];
+static unsigned rx_pending_count;
+
+static void rx_flush_locked(void) {
+    if (rx_pending_count == 0) {
+        return;
+    }
+    if (eth_queue_rx_batch(eth, rx_pending, rx_pending_count) < 0) {
+        printf("netifc: rx replenish failed\n");
+        // back to the free list so the buffers aren't stranded
+        for (unsigned n = 0; n < rx_pending_count; n++) {
+            eth_put_buffer_locked(rx_pending[n].cookie, ETH_BUFFER_RX);
+        }
+    }
+    rx_pending_count = 0;
+}
+
+static void rx_flush(void) {
+    mtx_lock(&eth_lock);
+    rx_flush_locked();
+    mtx_unlock(&eth_lock);
+}
+
+static void rx_pend(eth_buffer_t* ethbuf) {
+    eth_fifo_entry_t* e = &rx_pending[rx_pending_count++];
+    e->offset = ethbuf->data - iobuf;
+    e->length = NET_BUFFERSZ;
+    e->flags = 0;
+    e->cookie = ethbuf;
+}
+
+uint32_t eth_tx_offload(void) {
+    if (netfeatures & ETH_FEATURE_TX_CSUM) {
+        return ETH_SEND_CSUM_UDP6 | ETH_SEND_CSUM_ICMP6;
+    }
+    return 0;
+}
+
+int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len, uint32_t flags) {
     mtx_lock(&eth_lock);
 
     check_ethbuf(ethbuf, ETH_BUFFER_CLIENT);
@@ -184,8 +228,16 @@ int eth_send(eth_buffer_t* ethbuf, size_t skip, size_t len) {
 
     eth_complete_tx(eth, NULL, tx_complete);
 
+    uint32_t options = 0;
+    if (flags & ETH_SEND_CSUM_UDP6) {
+        options |= ETH_FIFO_TX_CSUM_UDP6;
+    }
+    if (flags & ETH_SEND_CSUM_ICMP6) {
+        options |= ETH_FIFO_TX_CSUM_ICMP6;
+    }
+
     ethbuf->state = ETH_BUFFER_TX;
-    mx_status_t status = eth_queue_tx(eth, ethbuf, ethbuf->data + skip, len, 0);
+    mx_status_t status = eth_queue_tx(eth, ethbuf, ethbuf->data + skip, len, options);
     if (status < 0) {
         printf("eth_fifo_send: queue tx failed: %d\n", status);
         eth_put_buffer_locked(ethbuf, ETH_BUFFER_TX);
@@ -206,7 +258,7 @@ void netifc_send(const void* _data, size_t len) {
     eth_buffer_t* ethbuf;
     if (eth_get_buffer(len, &data, &ethbuf) == 0) {
         memcpy(data, _data, len);
-        eth_send(ethbuf, 0, len);
+        eth_send(ethbuf, 0, len, 0);
     }
 }
 
@@ -254,6 +306,7 @@ static mx_status_t netifc_open_cb(int dirfd, int event, const char* fn, void* co
     }
     memcpy(netmac, info.mac, sizeof(netmac));
     netmtu = info.mtu;
+    netfeatures = info.features;
 
     mtx_lock(&eth_lock);
     mx_status_t status;
@@ -313,8 +366,9 @@ static mx_status_t netifc_open_cb(int dirfd, int event, const char* fn, void* co
             printf("netifc: only queued %u buffers (desired: %u)\n", n, NET_BUFFERS);
             break;
         }
-        eth_queue_rx(eth, ethbuf, ethbuf->data, NET_BUFFERSZ, 0);
+        rx_pend(ethbuf);
     }
+    rx_flush_locked();
 
     mtx_unlock(&eth_lock);
 
@@ -352,6 +406,8 @@ void netifc_close(void) {
         eth_destroy(eth);
         eth = NULL;
     }
+    // buffers waiting in rx_pending are reclaimed by the scan below
+    rx_pending_count = 0;
     unsigned count = 0;
     for (unsigned n = 0; n < eth_buffer_count; n++) {
         switch (eth_buffer_base[n].state) {
@@ -380,8 +436,12 @@ void netifc_close(void) {
 static void rx_complete(void* ctx, void* cookie, size_t len, uint32_t flags) {
     eth_buffer_t* ethbuf = cookie;
     check_ethbuf(ethbuf, ETH_BUFFER_RX);
-    netifc_recv(ethbuf->data, len);
-    eth_queue_rx(eth, ethbuf, ethbuf->data, NET_BUFFERSZ, 0);
+    netifc_recv(ethbuf->data, len,
+                (flags & ETH_FIFO_RX_CSUM_OK) ? ETH_RECV_CSUM_OK : 0);
+    rx_pend(ethbuf);
+    if (rx_pending_count == RX_BATCH) {
+        rx_flush();
+    }
 }
 
 int netifc_poll(void) {
@@ -391,6 +451,7 @@ int netifc_poll(void) {
             printf("netifc: eth rx failed: %d\n", status);
             return -1;
         }
+        rx_flush();
         if (net_timer) {
             mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
             if (now > net_timer) {
@@ -772,6 +772,11 @@ mx_status_t launchpad_elf_load(launchpad_t* lp, mx_handle_t vmo) {
 }
 
 static mx_handle_t vdso_vmo = MX_HANDLE_INVALID;
+// Parsed ELF layout of the vDSO, filled in on the first load. Every
+// process launched maps the same vDSO VMO, so the header and phdr
+// reads only need to happen once per launching process rather than
+// once per spawn.
+static elf_load_info_t* vdso_elf_info;
 static mtx_t vdso_mutex = MTX_INIT;
 static void vdso_lock(void) {
     mtx_lock(&vdso_mutex);
@@ -802,6 +807,11 @@ mx_handle_t launchpad_set_vdso_vmo(mx_handle_t new_vdso_vmo) {
     vdso_lock();
     mx_handle_t old = vdso_vmo;
     vdso_vmo = new_vdso_vmo;
+    // the cached layout describes the old vmo
+    if (vdso_elf_info != NULL) {
+        elf_load_destroy(vdso_elf_info);
+        vdso_elf_info = NULL;
+    }
     vdso_unlock();
     return old;
 }
@@ -824,10 +834,25 @@ mx_status_t launchpad_load_vdso(launchpad_t* lp, mx_handle_t vmo) {
         return launchpad_elf_load_extra(lp, vmo, &lp->vdso_base, NULL);
     vdso_lock();
     vmo = vdso_get_vmo();
-    mx_status_t status = launchpad_elf_load_extra(lp, vmo,
-                                                  &lp->vdso_base, NULL);
+    if (vmo == MX_HANDLE_INVALID) {
+        vdso_unlock();
+        return lp_error(lp, ERR_INVALID_ARGS, "load_vdso: no vdso vmo");
+    }
+    if (lp->error) {
+        vdso_unlock();
+        return lp->error;
+    }
+
+    mx_status_t status;
+    if (vdso_elf_info == NULL &&
+        (status = elf_load_start(vmo, NULL, 0, &vdso_elf_info)) != NO_ERROR) {
+        lp_error(lp, status, "load_vdso: elf_load_start() failed");
+    } else if ((status = elf_load_finish(lp_vmar(lp), vdso_elf_info, vmo,
+                                         NULL, &lp->vdso_base, NULL))) {
+        lp_error(lp, status, "load_vdso: elf_load_finish() failed");
+    }
     vdso_unlock();
-    return status;
+    return lp->error;
 }
 
 mx_status_t launchpad_get_entry_address(launchpad_t* lp, mx_vaddr_t* entry) {
@@ -0,0 +1,37 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <magenta/syscalls.h>
+
+#include "private.h"
+
+uint32_t _mx_system_get_cpu_num(void) {
+#if __aarch64__
+    // The kernel stamps each cpu's number into its tpidrro_el0, which
+    // EL0 can read but not write.
+    uint64_t cpu;
+    __asm__ volatile("mrs %0, tpidrro_el0" : "=r" (cpu));
+    return (uint32_t)cpu;
+#elif __x86_64__
+    // The kernel programs each cpu's number into its IA32_TSC_AUX, which
+    // rdtscp reads back into %ecx.  On hardware without rdtscp the kernel
+    // redirects this entry point to soft_system_get_cpu_num at boot.
+    uint32_t cpu;
+    __asm__ volatile("rdtscp" : "=c" (cpu) : : "eax", "edx");
+    return cpu;
+#else
+#error Unsupported architecture
+#endif
+}
+
+VDSO_PUBLIC_ALIAS(mx_system_get_cpu_num);
+
+// At boot time the kernel can decide to redirect the
+// {_,}mx_system_get_cpu_num dynamic symbol table entries to point to this
+// instead.  See VDso::Create.
+VDSO_KERNEL_EXPORT uint32_t CODE_soft_system_get_cpu_num(void) {
+    // The cpu number is only ever a sharding hint, so with no way to read
+    // it from usermode, reporting cpu 0 is safe.
+    return 0;
+}
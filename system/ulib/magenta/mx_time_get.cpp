@@ -0,0 +1,70 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <magenta/syscalls.h>
+
+#include "private.h"
+
+// Fixed point multiply of a 64-bit counter value by the {l0, l32, l64}
+// ratio words published in vdso_constants.  This must stay bit-for-bit
+// identical to u64_mul_u64_fp32_64() in the kernel's lib/fixed_point so
+// that clock values computed here interleave monotonically with values
+// returned by the mx_time_get syscall.
+static uint64_t mul_u64_fp32_64(uint64_t a,
+                                uint32_t b_l0, uint32_t b_l32, uint32_t b_l64) {
+    uint32_t a_r32 = (uint32_t)(a >> 32);
+    uint32_t a_0 = (uint32_t)a;
+    uint64_t res_0;
+    uint64_t res_l32;
+    uint32_t res_l32_32;
+    uint64_t tmp;
+
+    tmp = (uint64_t)a_r32 * b_l0;
+    res_0 = tmp << 32;
+    tmp = (uint64_t)a_0 * b_l0;
+    res_0 += tmp;
+    tmp = (uint64_t)a_r32 * b_l32;
+    res_0 += tmp;
+    tmp = (uint64_t)a_0 * b_l32;
+    res_0 += tmp >> 32;
+    res_l32 = (uint32_t)tmp;
+    tmp = (uint64_t)a_r32 * b_l64;
+    res_0 += tmp >> 32;
+    res_l32 += (uint32_t)tmp;
+    tmp = (uint64_t)a_0 * b_l64; // Improve rounding accuracy
+    res_l32 += tmp >> 32;
+    res_0 += res_l32 >> 32;
+    res_l32_32 = (uint32_t)res_l32;
+    return res_0 + (res_l32_32 >> 31); // Round to nearest integer
+}
+
+static uint64_t read_raw_ticks(void) {
+#if __aarch64__
+    // The kernel grants EL0 access to the virtual counter and only
+    // publishes a nonzero ratio when the monotonic clock is built from it.
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+#elif __x86_64__
+    uint32_t ticks_low;
+    uint32_t ticks_high;
+    __asm__ volatile("rdtsc" : "=a" (ticks_low), "=d" (ticks_high));
+    return ((uint64_t)ticks_high << 32) | ticks_low;
+#else
+#error Unsupported architecture
+#endif
+}
+
+// At boot time the kernel can decide to redirect the {_,}mx_time_get
+// dynamic symbol table entries to point to this instead.  See VDso::Create.
+VDSO_KERNEL_EXPORT mx_time_t CODE_time_get_via_ticks(uint32_t clock_id) {
+    if (clock_id != MX_CLOCK_MONOTONIC)
+        return VDSO_mx_time_get(clock_id);
+
+    const struct vdso_constants* c = &DATA_CONSTANTS;
+    return mul_u64_fp32_64(read_raw_ticks(),
+                           c->ticks_to_mono_ratio[0],
+                           c->ticks_to_mono_ratio[1],
+                           c->ticks_to_mono_ratio[2]);
+}
@@ -21,6 +21,10 @@ extern "C" {
 
 __LOCAL decltype(mx_ticks_get) CODE_soft_ticks_get;
 
+__LOCAL decltype(mx_system_get_cpu_num) CODE_soft_system_get_cpu_num;
+
+__LOCAL decltype(mx_time_get) CODE_time_get_via_ticks;
+
 };
 
 // Code should define '_mx_foo' and then do 'VDSO_PUBLIC_ALIAS(mx_foo);'.
@@ -14,6 +14,9 @@ typedef struct mdi_node_ref {
     const mdi_node_t* node;
     uint32_t siblings_count;        // number of siblings following node in list
     const void* siblings_end;       // pointer to end of remaining siblings
+    const mdi_node_t* base;         // root node, which index offsets are relative to
+    const mdi_index_entry_t* index; // sorted lookup index, or NULL if none
+    uint32_t index_count;           // number of index entries
 } mdi_node_ref_t;
 
 static inline bool mdi_valid(const mdi_node_ref_t* ref) {
@@ -36,7 +36,7 @@ mx_status_t mdi_init(const void* mdi_data, size_t length, mdi_node_ref_t* out_re
     }
 
     const mdi_node_t* node = (const mdi_node_t *)(header + 1);
-    if (node->length != header->length) {
+    if (node->length > header->length) {
         xprintf("%s: bad root node length\n", __FUNCTION__);
         out_ref->node = NULL;
         return ERR_INVALID_ARGS;
@@ -45,6 +45,20 @@ mx_status_t mdi_init(const void* mdi_data, size_t length, mdi_node_ref_t* out_re
     out_ref->node = node;
     out_ref->siblings_count = 0;
     out_ref->siblings_end = NULL;
+    out_ref->base = node;
+    out_ref->index = NULL;
+    out_ref->index_count = 0;
+
+    // a lookup index may follow the tree (see magenta/mdi.h)
+    size_t remaining = header->length - node->length;
+    if (remaining >= sizeof(mdi_index_t)) {
+        const mdi_index_t* index = (const mdi_index_t *)((void *)node + node->length);
+        if (index->magic == MDI_INDEX_MAGIC &&
+            index->count <= (remaining - sizeof(*index)) / sizeof(mdi_index_entry_t)) {
+            out_ref->index = (const mdi_index_entry_t *)(index + 1);
+            out_ref->index_count = index->count;
+        }
+    }
     return NO_ERROR;
 }
 
@@ -189,6 +203,9 @@ mx_status_t mdi_first_child(const mdi_node_ref_t* ref, mdi_node_ref_t* out_ref)
     out_ref->node = NULL;
     out_ref->siblings_count = 0;
     out_ref->siblings_end = NULL;
+    out_ref->base = ref->base;
+    out_ref->index = ref->index;
+    out_ref->index_count = ref->index_count;
 
    if (mdi_node_type(ref) != MDI_LIST) {
         xprintf("%s: ref not a list\n", __FUNCTION__);
@@ -215,6 +232,9 @@ mx_status_t mdi_first_child(const mdi_node_ref_t* ref, mdi_node_ref_t* out_ref)
 }
 
 mx_status_t mdi_next_child(const mdi_node_ref_t* ref, mdi_node_ref_t* out_ref) {
+    out_ref->base = ref->base;
+    out_ref->index = ref->index;
+    out_ref->index_count = ref->index_count;
     if (ref->siblings_count == 0) {
         out_ref->node = NULL;
         out_ref->siblings_count = 0;
@@ -244,6 +264,40 @@ uint32_t mdi_child_count(const mdi_node_ref_t* ref) {
 }
 
 mx_status_t mdi_find_node(const mdi_node_ref_t* ref, mdi_id_t id, mdi_node_ref_t* out_ref) {
+    if (ref->index != NULL && mdi_node_type(ref) == MDI_LIST) {
+        // binary search the index for (parent offset, id)
+        uint32_t parent_offset = (uint32_t)((const void *)ref->node - (const void *)ref->base);
+        const mdi_index_entry_t* entries = ref->index;
+        uint32_t left = 0;
+        uint32_t right = ref->index_count;
+        while (left < right) {
+            uint32_t mid = left + (right - left) / 2;
+            if (entries[mid].parent_offset < parent_offset ||
+                (entries[mid].parent_offset == parent_offset && entries[mid].id < id)) {
+                left = mid + 1;
+            } else {
+                right = mid;
+            }
+        }
+        out_ref->base = ref->base;
+        out_ref->index = ref->index;
+        out_ref->index_count = ref->index_count;
+        if (left < ref->index_count && entries[left].parent_offset == parent_offset &&
+            entries[left].id == id) {
+            // compute before writing out_ref in case ref and out_ref alias
+            const void* siblings_end = (const void *)ref->node + ref->node->length;
+            out_ref->node = (const mdi_node_t *)((const void *)ref->base + entries[left].node_offset);
+            out_ref->siblings_count = entries[left].siblings_count;
+            out_ref->siblings_end = siblings_end;
+            return NO_ERROR;
+        }
+        out_ref->node = NULL;
+        out_ref->siblings_count = 0;
+        out_ref->siblings_end = NULL;
+        return ERR_NOT_FOUND;
+    }
+
+    // no index: walk the siblings
     out_ref->siblings_count = 0;
     out_ref->siblings_end = NULL;
     mx_status_t status = mdi_first_child(ref, out_ref);
@@ -14,6 +14,10 @@
 #include <mxalloc/new.h>
 #include <mxtl/unique_ptr.h>
 
+#ifndef USE_LIBCRYPTO
+#include "sha256-accel.h"
+#endif // USE_LIBCRYPTO
+
 namespace merkle {
 
 Digest::Digest(const Digest& other) {
@@ -50,7 +54,11 @@ void Digest::Init() {
 #ifdef USE_LIBCRYPTO
     SHA256_Init(&ctx_);
 #else
-    clSHA256_init(&ctx_);
+    if (internal::Sha256AccelSupported()) {
+        internal::Sha256AccelInit(&ctx_);
+    } else {
+        clSHA256_init(&ctx_);
+    }
 #endif // USE_LIBCRYPTO
 }
 
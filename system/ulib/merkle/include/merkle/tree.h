@@ -52,6 +52,10 @@ public:
 
     // Writes a Merkle tree for the given data and saves its root digest.
     // |tree_len| must be at least as much as returned by GetTreeLength().
+    // Large trees are constructed in parallel: the nodes of each level are
+    // hashed across worker threads before ascending.  The output is
+    // identical to the incremental CreateInit/CreateUpdate/CreateFinal
+    // path, which remains fully serial.
     static mx_status_t Create(const void* data, size_t data_len, void* tree,
                               size_t tree_len, Digest* digest);
 
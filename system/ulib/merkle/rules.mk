@@ -10,10 +10,13 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/digest.cpp \
+    $(LOCAL_DIR)/sha256-accel.cpp \
     $(LOCAL_DIR)/tree.cpp
 
 MODULE_SO_NAME := merkle
-MODULE_LIBS := system/ulib/c
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/magenta \
 
 # TODO(aarongreen): cryptolib is FAR too slow for general purpose use.  We'll
 # need to use it to bootstrap and verify libcrypto.so before switching to
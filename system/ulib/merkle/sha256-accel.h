@@ -0,0 +1,27 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#ifndef USE_LIBCRYPTO
+
+#include <lib/crypto/cryptolib.h>
+
+namespace merkle {
+namespace internal {
+
+// Returns true if this CPU has a usable hardware SHA-256 implementation
+// (SHA-NI on x86-64, the ARMv8 cryptography extensions on arm64).
+bool Sha256AccelSupported();
+
+// Initializes |ctx| to use the hardware-accelerated SHA-256 implementation.
+// The resulting context produces digests identical to clSHA256_init(), and
+// is driven through the same clHASH_update()/clHASH_final() macros; it must
+// only be used when Sha256AccelSupported() returns true.
+void Sha256AccelInit(clSHA256_CTX* ctx);
+
+} // namespace internal
+} // namespace merkle
+
+#endif // !USE_LIBCRYPTO
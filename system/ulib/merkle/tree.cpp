@@ -6,9 +6,11 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <threads.h>
 
 #include <magenta/assert.h>
 #include <magenta/errors.h>
+#include <magenta/syscalls.h>
 #include <merkle/digest.h>
 #include <mxalloc/new.h>
 #include <mxtl/algorithm.h>
@@ -91,6 +93,100 @@ size_t NextAligned(size_t length) {
     return mxtl::roundup(NextLength(length), Tree::kNodeSize);
 }
 
+////////
+// Parallel creation helpers.
+//
+// Within one level of the tree, the digest of each node depends only on that
+// node's data, so disjoint node ranges can be hashed concurrently.  |Create|
+// hashes each level by splitting its nodes across worker threads and then
+// ascends; the digests produced are identical to the serial
+// Init/Update/Final path.
+
+// The most worker threads one level is split across.
+constexpr size_t kMaxWorkers = 8;
+
+// Don't bother spinning up workers unless each has at least this much data
+// to hash; below this, thread creation costs more than it saves.
+constexpr size_t kMinWorkerLength = 32 * Tree::kNodeSize;
+
+// A contiguous range of nodes within one level, to be hashed by one worker.
+struct HashRange {
+    const uint8_t* data; // Start of this level's data.
+    size_t data_len;     // Total length of this level, possibly unaligned.
+    uint64_t level;
+    size_t offset;       // First node to hash; node aligned.
+    size_t end;          // One past the last byte to hash.
+    uint8_t* out;        // Where this range's digests are written.
+};
+
+// Hashes the nodes described by |range|, writing one digest per node.
+void HashNodeRange(const HashRange* range) {
+    Digest digest;
+    const uint8_t* in = range->data + range->offset;
+    uint8_t* out = range->out;
+    size_t offset = range->offset;
+    while (offset < range->end) {
+        DigestInit(&digest, offset | range->level, range->data_len - offset);
+        size_t chunk = DigestUpdate(&digest, in, offset, range->end - offset);
+        in += chunk;
+        offset += chunk;
+        DigestFinal(&digest, offset);
+        digest.CopyTo(out, Digest::kLength);
+        out += Digest::kLength;
+    }
+}
+
+int HashWorker(void* arg) {
+    HashNodeRange(static_cast<const HashRange*>(arg));
+    return 0;
+}
+
+// Hashes one complete level of the tree, writing its digests (followed by
+// zero padding up to a node boundary) to |out|.  |data_len| must be greater
+// than |kNodeSize|.
+void HashLevel(const void* data, size_t data_len, uint64_t level, void* out) {
+    memset(out, 0, NextAligned(data_len));
+    size_t nodes = mxtl::roundup(data_len, Tree::kNodeSize) / Tree::kNodeSize;
+    size_t workers = mxtl::min(
+        mxtl::min(static_cast<size_t>(mx_system_get_num_cpus()), kMaxWorkers),
+        data_len / kMinWorkerLength);
+    HashRange ranges[kMaxWorkers];
+    thrd_t threads[kMaxWorkers];
+    size_t spawned = 0;
+    size_t offset = 0;
+    if (workers > 1) {
+        size_t per_worker = (nodes / workers) * Tree::kNodeSize;
+        // The calling thread hashes the final range itself, so only
+        // |workers - 1| threads are created; if creation fails, the range
+        // is simply hashed inline instead.
+        for (size_t i = 0; i + 1 < workers && offset + per_worker < data_len; i++) {
+            HashRange* range = &ranges[spawned];
+            range->data = static_cast<const uint8_t*>(data);
+            range->data_len = data_len;
+            range->level = level;
+            range->offset = offset;
+            range->end = offset + per_worker;
+            range->out = static_cast<uint8_t*>(out) +
+                         (offset / Tree::kNodeSize) * Digest::kLength;
+            if (thrd_create(&threads[spawned], HashWorker, range) != thrd_success) {
+                HashNodeRange(range);
+            } else {
+                spawned++;
+            }
+            offset += per_worker;
+        }
+    }
+    // Hash the remainder on the calling thread.
+    HashRange tail = {static_cast<const uint8_t*>(data), data_len, level,
+                      offset, data_len,
+                      static_cast<uint8_t*>(out) +
+                          (offset / Tree::kNodeSize) * Digest::kLength};
+    HashNodeRange(&tail);
+    for (size_t i = 0; i < spawned; i++) {
+        thrd_join(threads[i], nullptr);
+    }
+}
+
 } // namespace
 
 ////////
@@ -103,13 +199,37 @@ size_t Tree::GetTreeLength(size_t data_len) {
 
 mx_status_t Tree::Create(const void* data, size_t data_len, void* tree,
                          size_t tree_len, Digest* digest) {
-    mx_status_t rc;
-    Tree mt;
-    if ((rc = mt.CreateInit(data_len, tree_len)) != NO_ERROR ||
-        (rc = mt.CreateUpdate(data, data_len, tree)) != NO_ERROR ||
-        (rc = mt.CreateFinal(tree, digest)) != NO_ERROR) {
-        return rc;
+    // Error precedence matches the incremental path: CreateInit checks the
+    // tree buffer size, then CreateUpdate checks for missing data or tree.
+    if (tree_len < GetTreeLength(data_len)) {
+        return ERR_BUFFER_TOO_SMALL;
+    }
+    if (!digest || (!data && data_len > 0) ||
+        (!tree && data_len > kNodeSize)) {
+        return ERR_INVALID_ARGS;
+    }
+    // Hash each level in turn, fanning the nodes of a level out across
+    // worker threads.  Upper levels consume the node-aligned, zero-padded
+    // digests of the level below, exactly as the incremental path does.
+    uint64_t level = 0;
+    const void* in = data;
+    size_t len = data_len;
+    uint8_t* out = static_cast<uint8_t*>(tree);
+    while (len > kNodeSize) {
+        HashLevel(in, len, level, out);
+        in = out;
+        out += NextAligned(len);
+        len = NextAligned(len);
+        ++level;
+    }
+    // The remaining (single, possibly partial or empty) node is the root.
+    Digest d;
+    DigestInit(&d, level, len);
+    if (len > 0) {
+        DigestUpdate(&d, static_cast<const uint8_t*>(in), 0, len);
     }
+    DigestFinal(&d, len);
+    *digest = d;
     return NO_ERROR;
 }
 
@@ -0,0 +1,327 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <magenta/types.h>
+
+#include <mxio/io.h>
+#include <mxio/remoteio.h>
+
+#include "private.h"
+
+// A buffered wrapper around another mxio_t.  Small sequential reads are
+// served out of a readahead window filled one chunk at a time, and small
+// writes are coalesced into a buffer which is pushed to the inner io when
+// it fills, on MXRIO_SYNC, or on close.  Reads, seeks, and positioned io
+// flush or rewind the buffers first so callers always observe ordinary
+// posix semantics; only the number of transactions changes.
+
+#define BUFIO_SIZE MXIO_CHUNK_SIZE
+
+typedef struct bufio {
+    mxio_t io;
+
+    // the wrapped io object; this wrapper owns one reference to it
+    mxio_t* inner;
+
+    mtx_t lock;
+
+    // readahead window: rbuf[roff..rlen) has been fetched from inner
+    // but not yet consumed by the caller
+    size_t roff;
+    size_t rlen;
+
+    // write coalescing buffer: wbuf[0..wlen) has been accepted from the
+    // caller but not yet pushed to inner
+    size_t wlen;
+
+    uint8_t rbuf[BUFIO_SIZE];
+    uint8_t wbuf[BUFIO_SIZE];
+} bufio_t;
+
+// push any coalesced writes to the inner io (lock held)
+static mx_status_t bufio_flush_locked(bufio_t* b) {
+    size_t off = 0;
+    while (off < b->wlen) {
+        ssize_t r = b->inner->ops->write(b->inner, b->wbuf + off, b->wlen - off);
+        if (r < 0) {
+            // keep whatever we could not push for a later retry
+            memmove(b->wbuf, b->wbuf + off, b->wlen - off);
+            b->wlen -= off;
+            return (mx_status_t)r;
+        }
+        off += r;
+    }
+    b->wlen = 0;
+    return NO_ERROR;
+}
+
+// discard the readahead window, rewinding the inner io position over the
+// unconsumed bytes so the caller-visible offset is unchanged (lock held).
+// non-seekable ios (pipes, sockets) never have readahead beyond what was
+// fetched from the stream, so a failed rewind is ignored for them.
+static void bufio_purge_read_locked(bufio_t* b) {
+    if (b->rlen > b->roff) {
+        b->inner->ops->seek(b->inner, -(off_t)(b->rlen - b->roff), SEEK_CUR);
+    }
+    b->roff = 0;
+    b->rlen = 0;
+}
+
+static ssize_t bufio_read(mxio_t* io, void* data, size_t len) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    mtx_lock(&b->lock);
+    if ((r = bufio_flush_locked(b)) < 0) {
+        mtx_unlock(&b->lock);
+        return r;
+    }
+
+    if (b->roff == b->rlen) {
+        // window empty: reads at least a window long skip the copy
+        if (len >= BUFIO_SIZE) {
+            ssize_t n = b->inner->ops->read(b->inner, data, len);
+            mtx_unlock(&b->lock);
+            return n;
+        }
+        ssize_t n = b->inner->ops->read(b->inner, b->rbuf, BUFIO_SIZE);
+        if (n <= 0) {
+            mtx_unlock(&b->lock);
+            return n;
+        }
+        b->roff = 0;
+        b->rlen = n;
+    }
+
+    size_t avail = b->rlen - b->roff;
+    size_t xfer = (len > avail) ? avail : len;
+    memcpy(data, b->rbuf + b->roff, xfer);
+    b->roff += xfer;
+    mtx_unlock(&b->lock);
+    return xfer;
+}
+
+static ssize_t bufio_write(mxio_t* io, const void* data, size_t len) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    mtx_lock(&b->lock);
+    bufio_purge_read_locked(b);
+
+    // writes at least a buffer long go straight through
+    if (len >= BUFIO_SIZE) {
+        if ((r = bufio_flush_locked(b)) < 0) {
+            mtx_unlock(&b->lock);
+            return r;
+        }
+        ssize_t n = b->inner->ops->write(b->inner, data, len);
+        mtx_unlock(&b->lock);
+        return n;
+    }
+
+    if ((b->wlen + len > BUFIO_SIZE) && ((r = bufio_flush_locked(b)) < 0)) {
+        mtx_unlock(&b->lock);
+        return r;
+    }
+
+    memcpy(b->wbuf + b->wlen, data, len);
+    b->wlen += len;
+    mtx_unlock(&b->lock);
+    return len;
+}
+
+static ssize_t bufio_read_at(mxio_t* io, void* data, size_t len, mx_off_t offset) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    mtx_lock(&b->lock);
+    if ((r = bufio_flush_locked(b)) < 0) {
+        mtx_unlock(&b->lock);
+        return r;
+    }
+    ssize_t n = b->inner->ops->read_at(b->inner, data, len, offset);
+    mtx_unlock(&b->lock);
+    return n;
+}
+
+static ssize_t bufio_write_at(mxio_t* io, const void* data, size_t len, mx_off_t offset) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    mtx_lock(&b->lock);
+    // the write may overlap the readahead window, so drop it
+    bufio_purge_read_locked(b);
+    if ((r = bufio_flush_locked(b)) < 0) {
+        mtx_unlock(&b->lock);
+        return r;
+    }
+    ssize_t n = b->inner->ops->write_at(b->inner, data, len, offset);
+    mtx_unlock(&b->lock);
+    return n;
+}
+
+static off_t bufio_seek(mxio_t* io, off_t offset, int whence) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    mtx_lock(&b->lock);
+    if ((r = bufio_flush_locked(b)) < 0) {
+        mtx_unlock(&b->lock);
+        return r;
+    }
+    if (whence == SEEK_CUR) {
+        // the inner position is ahead of the caller-visible position by
+        // the unconsumed readahead
+        offset -= (off_t)(b->rlen - b->roff);
+    }
+    b->roff = 0;
+    b->rlen = 0;
+    off_t n = b->inner->ops->seek(b->inner, offset, whence);
+    mtx_unlock(&b->lock);
+    return n;
+}
+
+static mx_status_t bufio_misc(mxio_t* io, uint32_t op, int64_t off, uint32_t maxreply, void* data, size_t len) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    if (op == MXRIO_SYNC) {
+        mtx_lock(&b->lock);
+        r = bufio_flush_locked(b);
+        mtx_unlock(&b->lock);
+        if (r < 0) {
+            return r;
+        }
+    }
+    return b->inner->ops->misc(b->inner, op, off, maxreply, data, len);
+}
+
+static mx_status_t bufio_close(mxio_t* io) {
+    bufio_t* b = (bufio_t*)io;
+
+    mtx_lock(&b->lock);
+    // flush coalesced writes; the close proceeds regardless since there
+    // is nowhere to report a deferred error other than the return value
+    mx_status_t r = bufio_flush_locked(b);
+    mtx_unlock(&b->lock);
+
+    mx_status_t rc = b->inner->ops->close(b->inner);
+    mxio_release(b->inner);
+    return (r < 0) ? r : rc;
+}
+
+static ssize_t bufio_recvmsg(mxio_t* io, struct msghdr* msg, int flags) {
+    bufio_t* b = (bufio_t*)io;
+    return b->inner->ops->recvmsg(b->inner, msg, flags);
+}
+
+static ssize_t bufio_sendmsg(mxio_t* io, const struct msghdr* msg, int flags) {
+    bufio_t* b = (bufio_t*)io;
+    return b->inner->ops->sendmsg(b->inner, msg, flags);
+}
+
+static mx_status_t bufio_open(mxio_t* io, const char* path, int32_t flags, uint32_t mode, mxio_t** out) {
+    bufio_t* b = (bufio_t*)io;
+    return b->inner->ops->open(b->inner, path, flags, mode, out);
+}
+
+static mx_status_t bufio_clone(mxio_t* io, mx_handle_t* out_handles, uint32_t* out_types) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    // the clone shares the inner object's state, not our buffers
+    mtx_lock(&b->lock);
+    r = bufio_flush_locked(b);
+    bufio_purge_read_locked(b);
+    mtx_unlock(&b->lock);
+    if (r < 0) {
+        return r;
+    }
+    return b->inner->ops->clone(b->inner, out_handles, out_types);
+}
+
+static mx_status_t bufio_unwrap(mxio_t* io, mx_handle_t* out_handles, uint32_t* out_types) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    mtx_lock(&b->lock);
+    r = bufio_flush_locked(b);
+    bufio_purge_read_locked(b);
+    mtx_unlock(&b->lock);
+    if (r < 0) {
+        return r;
+    }
+    return b->inner->ops->unwrap(b->inner, out_handles, out_types);
+}
+
+static void bufio_wait_begin(mxio_t* io, uint32_t events, mx_handle_t* handle, mx_signals_t* signals) {
+    bufio_t* b = (bufio_t*)io;
+    b->inner->ops->wait_begin(b->inner, events, handle, signals);
+}
+
+static void bufio_wait_end(mxio_t* io, mx_signals_t signals, uint32_t* events) {
+    bufio_t* b = (bufio_t*)io;
+    b->inner->ops->wait_end(b->inner, signals, events);
+}
+
+static ssize_t bufio_ioctl(mxio_t* io, uint32_t op, const void* in_buf, size_t in_len, void* out_buf, size_t out_len) {
+    bufio_t* b = (bufio_t*)io;
+    return b->inner->ops->ioctl(b->inner, op, in_buf, in_len, out_buf, out_len);
+}
+
+static ssize_t bufio_posix_ioctl(mxio_t* io, int req, va_list va) {
+    bufio_t* b = (bufio_t*)io;
+    return b->inner->ops->posix_ioctl(b->inner, req, va);
+}
+
+static mx_status_t bufio_get_vmo(mxio_t* io, mx_handle_t* out, size_t* off, size_t* len) {
+    bufio_t* b = (bufio_t*)io;
+    mx_status_t r;
+
+    mtx_lock(&b->lock);
+    r = bufio_flush_locked(b);
+    mtx_unlock(&b->lock);
+    if (r < 0) {
+        return r;
+    }
+    return b->inner->ops->get_vmo(b->inner, out, off, len);
+}
+
+static mxio_ops_t mxio_buffered_ops = {
+    .read = bufio_read,
+    .read_at = bufio_read_at,
+    .write = bufio_write,
+    .write_at = bufio_write_at,
+    .recvmsg = bufio_recvmsg,
+    .sendmsg = bufio_sendmsg,
+    .misc = bufio_misc,
+    .seek = bufio_seek,
+    .close = bufio_close,
+    .open = bufio_open,
+    .clone = bufio_clone,
+    .ioctl = bufio_ioctl,
+    .wait_begin = bufio_wait_begin,
+    .wait_end = bufio_wait_end,
+    .unwrap = bufio_unwrap,
+    .posix_ioctl = bufio_posix_ioctl,
+    .get_vmo = bufio_get_vmo,
+};
+
+mxio_t* mxio_buffered_create(mxio_t* inner) {
+    bufio_t* b = calloc(1, sizeof(*b));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->io.ops = &mxio_buffered_ops;
+    b->io.magic = MXIO_MAGIC;
+    atomic_init(&b->io.refcount, 1);
+    b->io.flags = inner->flags;
+    b->inner = inner;
+    mtx_init(&b->lock, mtx_plain);
+    return &b->io;
+}
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -38,12 +39,16 @@ typedef struct {
 #define FLAG_DISCONNECTED 1
 #endif
 
+#define MAX_POOL_THREADS 16
+
 struct mxio_dispatcher {
     mtx_t lock;
     list_node_t list;
     mx_handle_t ioport;
     mxio_dispatcher_cb_t default_cb;
-    thrd_t t;
+    uint32_t nthreads;          // nonzero once the dispatcher has been started
+    uint32_t active_threads;    // threads still in the dispatch loop
+    thrd_t threads[MAX_POOL_THREADS];
 };
 
 static void mxio_dispatcher_destroy(mxio_dispatcher_t* md) {
@@ -97,6 +102,10 @@ static void disconnect_handler(mxio_dispatcher_t* md, handler_t* handler, bool n
 #endif
 }
 
+// Several pool threads may block in mx_port_wait() on the same port, but a
+// given handler can never run on two of them at once: its wait is armed with
+// MX_WAIT_ASYNC_ONCE, so at most one packet for it is ever in flight, and it
+// is only re-armed after its callback has returned.
 static int mxio_dispatcher_thread(void* _md) {
     mxio_dispatcher_t* md = _md;
     mx_status_t r;
@@ -147,7 +156,12 @@ static int mxio_dispatcher_thread(void* _md) {
     }
 
     xprintf("dispatcher: FATAL ERROR, EXITING\n");
-    mxio_dispatcher_destroy(md);
+    mtx_lock(&md->lock);
+    bool last = (--md->active_threads == 0);
+    mtx_unlock(&md->lock);
+    if (last) {
+        mxio_dispatcher_destroy(md);
+    }
     return NO_ERROR;
 }
 
@@ -170,24 +184,54 @@ mx_status_t mxio_dispatcher_create(mxio_dispatcher_t** out, mxio_dispatcher_cb_t
 }
 
 mx_status_t mxio_dispatcher_start(mxio_dispatcher_t* md, const char* name) {
-    mx_status_t r;
+    return mxio_dispatcher_start_pool(md, name, 1);
+}
+
+mx_status_t mxio_dispatcher_start_pool(mxio_dispatcher_t* md, const char* name,
+                                       uint32_t nthreads) {
+    if ((nthreads == 0) || (nthreads > MAX_POOL_THREADS)) {
+        return ERR_INVALID_ARGS;
+    }
+#if !USE_WAIT_ONCE
+    // repeating waits can deliver packets for a handle while its callback is
+    // still running on another thread, so pool mode requires wait-once
+    if (nthreads > 1) {
+        return ERR_NOT_SUPPORTED;
+    }
+#endif
+    mx_status_t r = NO_ERROR;
     mtx_lock(&md->lock);
-    if (md->t == NULL) {
-        if (thrd_create_with_name(&md->t, mxio_dispatcher_thread, md, name) != thrd_success) {
-            mxio_dispatcher_destroy(md);
+    if (md->nthreads == 0) {
+        uint32_t n;
+        for (n = 0; n < nthreads; n++) {
+            if (thrd_create_with_name(&md->threads[n], mxio_dispatcher_thread, md,
+                                      name) != thrd_success) {
+                break;
+            }
+            thrd_detach(md->threads[n]);
+        }
+        if (n == 0) {
             r = ERR_NO_RESOURCES;
         } else {
-            thrd_detach(md->t);
-            r = NO_ERROR;
+            // a short pool still works, just with less parallelism
+            md->nthreads = n;
+            md->active_threads = n;
         }
     } else {
         r = ERR_BAD_STATE;
     }
     mtx_unlock(&md->lock);
+    if (r == ERR_NO_RESOURCES) {
+        mxio_dispatcher_destroy(md);
+    }
     return r;
 }
 
 void mxio_dispatcher_run(mxio_dispatcher_t* md) {
+    mtx_lock(&md->lock);
+    md->nthreads++;
+    md->active_threads++;
+    mtx_unlock(&md->lock);
     mxio_dispatcher_thread(md);
 }
 
@@ -11,6 +11,7 @@
 
 #include <magenta/listnode.h>
 #include <magenta/syscalls.h>
+#include <magenta/syscalls/port.h>
 #include <mxio/io.h>
 #include <mxio/util.h>
 
@@ -20,11 +21,24 @@
 // TODO: should use a system default
 #define MAX_WAIT_EVENTS 1024
 
+// epoll is built on a v2 port. Each watched fd has a standing async wait
+// registration keyed by its cookie, so a wakeup dequeues packets only for
+// the fds that are ready; nothing is re-registered per wait.
+//
+// EPOLLET registrations use a repeating wait, which queues a packet per
+// readiness edge. Level-triggered registrations use one-shot waits that are
+// re-armed as their packets are delivered; if the fd is still ready, the
+// fresh wait queues a packet immediately, preserving level semantics while
+// still costing only the ready set.
+
 typedef struct mxio_epoll_cookie {
     list_node_t node;
     mxio_t* io;
     struct epoll_event ep_event;
     int fd;
+    // handle and signals the io mapped the requested events onto
+    mx_handle_t h;
+    mx_signals_t signals;
 } mxio_epoll_cookie_t;
 
 typedef struct mxio_epoll {
@@ -68,20 +82,32 @@ static mxio_epoll_cookie_t* mxio_epoll_cookie_remove(mxio_epoll_t* epio, int fd)
     return mxio_epoll_cookie_get(epio, fd, true);
 }
 
+// Drops the standing registration for a cookie. ERR_NOT_FOUND is not an
+// error here: it just means a one-shot wait already fired and its packet
+// was consumed.
+static mx_status_t mxio_epoll_cancel(mxio_epoll_t* epio,
+                                     mxio_epoll_cookie_t* cookie) {
+    mx_status_t r = mx_port_cancel(epio->h, cookie->h,
+                                   (uint64_t)(uintptr_t)cookie);
+    return (r == ERR_NOT_FOUND) ? NO_ERROR : r;
+}
+
 static mx_status_t mxio_epoll_close(mxio_t* io) {
     mxio_epoll_t* epio = (mxio_epoll_t*)io;
-    mx_handle_t h = epio->h;
-    epio->h = MX_HANDLE_INVALID;
-    mx_handle_close(h);
 
     mxio_epoll_cookie_t* cookie;
     mtx_lock(&epio->cookies_lock);
     while ((cookie = list_remove_head_type(&epio->cookies, mxio_epoll_cookie_t,
                                            node))) {
+        mxio_epoll_cancel(epio, cookie);
         mxio_release(cookie->io);
         free(cookie);
     }
     mtx_unlock(&epio->cookies_lock);
+
+    mx_handle_t h = epio->h;
+    epio->h = MX_HANDLE_INVALID;
+    mx_handle_close(h);
     return NO_ERROR;
 }
 
@@ -121,7 +147,7 @@ static mxio_t* mxio_epoll_create(mx_handle_t h) {
 mx_status_t mxio_epoll(mxio_t** out) {
     mx_handle_t h;
     mx_status_t status;
-    if ((status = mx_waitset_create(0, &h)) < 0) {
+    if ((status = mx_port_create(MX_PORT_OPT_V2, &h)) < 0) {
         return status;
     }
     mxio_t* io;
@@ -195,13 +221,13 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event* ep_event) {
         break;
     case EPOLL_CTL_MOD:
     case EPOLL_CTL_DEL:
-        // or retrieve an existing cookie and remove the current epoll event
+        // or retrieve an existing cookie and drop its registration
         cookie = mxio_epoll_cookie_remove(epio, fd);
         if (cookie == NULL) {
             r = ERR_NOT_FOUND;
             goto end;
         }
-        if ((r = mx_waitset_remove(epio->h, (uint64_t)(uintptr_t)cookie)) < 0) {
+        if ((r = mxio_epoll_cancel(epio, cookie)) < 0) {
             mxio_epoll_cookie_add(epio, cookie);
             goto end;
         }
@@ -216,7 +242,7 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event* ep_event) {
         mxio_release(cookie->io);
         free(cookie);
     } else {
-        // or add a new epoll event and put the cookie into the list
+        // or register an async wait and put the cookie into the list
         mx_handle_t h = MX_HANDLE_INVALID;
         mx_signals_t signals = 0;
         io->ops->wait_begin(io, ep_event->events, &h, &signals);
@@ -229,7 +255,12 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event* ep_event) {
         }
 
         cookie->ep_event = *ep_event;
-        if ((r = mx_waitset_add(epio->h, (uint64_t)(uintptr_t)cookie, h, signals)) < 0) {
+        cookie->h = h;
+        cookie->signals = signals;
+        uint32_t options = (ep_event->events & EPOLLET) ?
+            MX_WAIT_ASYNC_REPEATING : MX_WAIT_ASYNC_ONCE;
+        if ((r = mx_object_wait_async(h, epio->h, (uint64_t)(uintptr_t)cookie,
+                                      signals, options)) < 0) {
             mxio_release(cookie->io);
             free(cookie);
             goto end;
@@ -265,29 +296,44 @@ int epoll_wait(int epfd, struct epoll_event* ep_events, int maxevents, int timeo
     }
     mxio_epoll_t* epio = (mxio_epoll_t*)io;
 
-    mx_status_t r;
-    uint32_t num_results = maxevents;
-    mx_waitset_result_t results[maxevents];
     mx_time_t tmo = (timeout >= 0) ? mx_deadline_after(MX_MSEC(timeout)) : MX_TIME_INFINITE;
 
-    if ((r = mx_waitset_wait(epio->h, tmo, results, &num_results)) < 0) {
-        mxio_release(io);
-        return (r == ERR_TIMED_OUT) ? 0 : ERROR(r);
-    }
-
-    for (uint32_t i = 0; i < num_results; i++) {
-        mxio_epoll_cookie_t* cookie = (mxio_epoll_cookie_t*)(uintptr_t)results[i].cookie;
-        mxio_t* io = cookie->io;
+    mx_status_t r = NO_ERROR;
+    int count = 0;
+    while (count < maxevents) {
+        mx_port_packet_t packet;
+        // block for the first packet, then drain whatever else is queued
+        mx_time_t deadline = (count == 0) ? tmo : 0u;
+        if ((r = mx_port_wait(epio->h, deadline, &packet, sizeof(packet))) < 0) {
+            break;
+        }
+        if ((packet.type != MX_PKT_TYPE_SIGNAL_ONE) &&
+            (packet.type != MX_PKT_TYPE_SIGNAL_REP)) {
+            continue;
+        }
+        mxio_epoll_cookie_t* cookie = (mxio_epoll_cookie_t*)(uintptr_t)packet.key;
         uint32_t events;
 
-        io->ops->wait_end(io, results[i].observed, &events);
+        cookie->io->ops->wait_end(cookie->io, packet.signal.observed, &events);
         // mask unrequested events except HUP/ERR
-        ep_events[i].events = events & (cookie->ep_event.events | EPOLLHUP | EPOLLERR);
+        events &= (cookie->ep_event.events | EPOLLHUP | EPOLLERR);
+
+        // re-arm level-triggered registrations; a still-ready fd queues a
+        // fresh packet immediately
+        if (!(cookie->ep_event.events & EPOLLET)) {
+            mx_object_wait_async(cookie->h, epio->h, packet.key,
+                                 cookie->signals, MX_WAIT_ASYNC_ONCE);
+        }
 
-        ep_events[i].data = cookie->ep_event.data;
+        ep_events[count].events = events;
+        ep_events[count].data = cookie->ep_event.data;
+        count++;
     }
     mxio_release(io);
-    return (int)num_results;
+    if ((count == 0) && (r < 0) && (r != ERR_TIMED_OUT)) {
+        return ERROR(r);
+    }
+    return count;
 }
 
 int epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout, const sigset_t* sigmask) {
@@ -29,6 +29,15 @@ mx_status_t mxio_dispatcher_create(mxio_dispatcher_t** out, mxio_dispatcher_cb_t
 // create a thread for a dispatcher and start it running
 mx_status_t mxio_dispatcher_start(mxio_dispatcher_t* md, const char* name);
 
+// create a pool of threads for a dispatcher and start them running.
+//
+// The callback for a given handle is never run on two threads at once
+// (a handle's wait is only re-armed after its callback returns), so
+// handlers written for the single-threaded dispatcher remain correct.
+// Independent handles may be dispatched in parallel across the pool.
+mx_status_t mxio_dispatcher_start_pool(mxio_dispatcher_t* md, const char* name,
+                                       uint32_t nthreads);
+
 // run the dispatcher loop on the current thread, never to return
 void mxio_dispatcher_run(mxio_dispatcher_t* md);
 
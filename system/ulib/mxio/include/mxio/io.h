@@ -68,4 +68,11 @@ mx_status_t mxio_get_exact_vmo(int fd, mx_handle_t* out_vmo);
 // is closed.
 int mxio_vmo_fd(mx_handle_t vmo, uint64_t offset, uint64_t length);
 
+// switch an fd into buffered mode: small sequential reads are served from
+// a readahead window and small writes are coalesced, reaching the server
+// when the buffer fills, on fsync(), or on close().  fails with EBUSY if
+// the fd has been dup()'d, since the buffer would not be shared with the
+// other fds.
+int mxio_buffer_fd(int fd);
+
 __END_CDECLS
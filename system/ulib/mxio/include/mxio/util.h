@@ -76,6 +76,13 @@ mx_status_t mxio_service_connect(const char* svcpath, mx_handle_t h);
 // an error is returned and the handle is closed.
 mx_status_t mxio_service_connect_at(mx_handle_t dir, const char* path, mx_handle_t h);
 
+// Connect to a named service, returning the connected channel.
+// Equivalent to creating a channel and calling mxio_service_connect(),
+// except that repeat connections to the same service may be served from
+// a small pool of pre-connected idle channels, making the common case a
+// single syscall.
+mx_status_t mxio_service_open(const char* svcpath, mx_handle_t* out);
+
 // Attempt to clone a sevice handle by doing a pipelined
 // CLONE operation, returning the new channel endpoint,
 // or MX_HANDLE_INVALID.
@@ -49,6 +49,72 @@ static const char* libpaths[] = {
     "/boot/lib",
 };
 
+// Cache of vmos for objects this service has already loaded, keyed by
+// the name the client asked for. Every process links against the same
+// handful of shared libraries, so after the first load the service can
+// hand out duplicate handles to one immutable vmo instead of re-opening
+// the file and materializing a fresh copy of its contents per spawn.
+// The client's dynamic linker maps writable segments copy-on-write, so
+// sharing the vmo is safe. Entries are never evicted; the set of
+// libraries is small and they live on read-only storage.
+typedef struct loaded_object {
+    struct loaded_object* next;
+    char* name;
+    mx_handle_t vmo;
+} loaded_object_t;
+
+static loaded_object_t* object_cache;
+static mtx_t object_cache_lock = MTX_INIT;
+
+static mx_handle_t object_cache_lookup(const char* fn) {
+    mx_handle_t copy = MX_HANDLE_INVALID;
+    mtx_lock(&object_cache_lock);
+    for (loaded_object_t* obj = object_cache; obj != NULL; obj = obj->next) {
+        if (!strcmp(obj->name, fn)) {
+            if (mx_handle_duplicate(obj->vmo, MX_RIGHT_SAME_RIGHTS,
+                                    &copy) != NO_ERROR) {
+                copy = MX_HANDLE_INVALID;
+            }
+            break;
+        }
+    }
+    mtx_unlock(&object_cache_lock);
+    return copy;
+}
+
+static void object_cache_add(const char* fn, mx_handle_t vmo) {
+    mx_handle_t copy;
+    if (mx_handle_duplicate(vmo, MX_RIGHT_SAME_RIGHTS, &copy) != NO_ERROR) {
+        return;
+    }
+    loaded_object_t* obj = malloc(sizeof(loaded_object_t));
+    char* name = strdup(fn);
+    if ((obj == NULL) || (name == NULL)) {
+        free(obj);
+        free(name);
+        mx_handle_close(copy);
+        return;
+    }
+    obj->name = name;
+    obj->vmo = copy;
+    mtx_lock(&object_cache_lock);
+    // a racing load of the same object may have beaten us here;
+    // keep the existing entry
+    for (loaded_object_t* other = object_cache; other != NULL;
+         other = other->next) {
+        if (!strcmp(other->name, fn)) {
+            mtx_unlock(&object_cache_lock);
+            mx_handle_close(copy);
+            free(name);
+            free(obj);
+            return;
+        }
+    }
+    obj->next = object_cache;
+    object_cache = obj;
+    mtx_unlock(&object_cache_lock);
+}
+
 // Always consumes the fd.
 static mx_handle_t load_object_fd(int fd, const char* fn) {
     mx_handle_t vmo;
@@ -64,16 +130,24 @@ static mx_handle_t default_load_object(void* ignored,
                                        uint32_t load_op,
                                        const char* fn) {
     switch (load_op) {
-    case LOADER_SVC_OP_LOAD_OBJECT:
+    case LOADER_SVC_OP_LOAD_OBJECT: {
+        mx_handle_t vmo = object_cache_lookup(fn);
+        if (vmo != MX_HANDLE_INVALID)
+            return vmo;
         // When loading a library object, search in the hard-coded locations.
         for (unsigned n = 0; n < countof(libpaths); n++) {
             char path[PATH_MAX];
             snprintf(path, sizeof(path), "%s/%s", libpaths[n], fn);
             int fd = open(path, O_RDONLY);
-            if (fd >= 0)
-                return load_object_fd(fd, fn);
+            if (fd >= 0) {
+                vmo = load_object_fd(fd, fn);
+                if (vmo > 0)
+                    object_cache_add(fn, vmo);
+                return vmo;
+            }
         }
         break;
+    }
     case LOADER_SVC_OP_LOAD_SCRIPT_INTERP:
         // When loading a script interpreter, we expect an absolute path.
         if (fn[0] != '/') {
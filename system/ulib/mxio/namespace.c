@@ -12,6 +12,7 @@
 #include <magenta/listnode.h>
 #include <magenta/syscalls.h>
 #include <magenta/processargs.h>
+#include <magenta/device/vfs.h>
 
 #include <mxio/namespace.h>
 #include <mxio/remoteio.h>
@@ -51,11 +52,32 @@ struct mxio_vnode {
     char name[];
 };
 
+// A cached directory prefix: h is an open handle to the directory at
+// relpath below vn's remote.  watch is a vfs-watcher channel on that
+// directory; any message (or peer closure) on it means the directory
+// was deleted or its entries changed, so the entry is dropped the next
+// time it is considered.  Entries let repeated opens below the same
+// directory send a single-component OPEN instead of re-walking the
+// whole path on the server.
+typedef struct mxio_dircache_entry dcentry_t;
+struct mxio_dircache_entry {
+    dcentry_t* next;
+    mxvn_t* vn;
+    mx_handle_t h;
+    mx_handle_t watch;
+    uint32_t pathlen;
+    char relpath[];
+};
+
+#define DIRCACHE_MAX_ENTRIES 16
+
 // refcount is incremented when a mxio_dir references any of its vnodes
 // when refcount is nonzero it may not be modified or destroyed
 struct mxio_namespace {
     mtx_t lock;
     int32_t refcount;
+    dcentry_t* dcache;
+    uint32_t dcache_count;
     mxvn_t root;
 };
 
@@ -165,6 +187,139 @@ static void vn_destroy_children_locked(mxvn_t* parent) {
     }
 }
 
+static void dcache_drop_locked(mxio_ns_t* ns, dcentry_t** prevp) {
+    dcentry_t* e = *prevp;
+    *prevp = e->next;
+    mx_handle_close(e->h);
+    mx_handle_close(e->watch);
+    free(e);
+    ns->dcache_count--;
+}
+
+static void dcache_flush_locked(mxio_ns_t* ns) {
+    while (ns->dcache != NULL) {
+        dcache_drop_locked(ns, &ns->dcache);
+    }
+}
+
+// Look up a cached directory handle for path[:len] below vn's remote,
+// discarding any entries whose watch channel reports a change.  A hit
+// moves the entry to the front so the cap evicts cold entries.
+static mx_handle_t dcache_lookup_locked(mxio_ns_t* ns, mxvn_t* vn,
+                                        const char* path, size_t len) {
+    dcentry_t** prevp = &ns->dcache;
+    dcentry_t* e;
+    while ((e = *prevp) != NULL) {
+        mx_signals_t pending = 0;
+        mx_object_wait_one(e->watch, MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED,
+                           0, &pending);
+        if (pending & (MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED)) {
+            dcache_drop_locked(ns, prevp);
+            continue;
+        }
+        if ((e->vn == vn) && (e->pathlen == len) &&
+            !memcmp(e->relpath, path, len)) {
+            *prevp = e->next;
+            e->next = ns->dcache;
+            ns->dcache = e;
+            return e->h;
+        }
+        prevp = &e->next;
+    }
+    return MX_HANDLE_INVALID;
+}
+
+// Take ownership of directory handle h and cache it for path[:len] below
+// vn's remote.  The handle is only cached if the server supports directory
+// watching, since without the watch channel there is no way to notice the
+// path going stale.
+static void dcache_install_locked(mxio_ns_t* ns, mxvn_t* vn,
+                                  const char* path, size_t len, mx_handle_t h) {
+    vfs_watch_dir_t wd = {
+        .mask = VFS_WATCH_MASK_DELETED | VFS_WATCH_MASK_REMOVED,
+        .options = 0,
+    };
+    mx_handle_t watch;
+    if (mx_channel_create(0, &wd.channel, &watch) < 0) {
+        mx_handle_close(h);
+        return;
+    }
+    if (mxrio_ioctl_handle(h, IOCTL_VFS_WATCH_DIR_V2, &wd, sizeof(wd), NULL, 0) < 0) {
+        mx_handle_close(watch);
+        mx_handle_close(h);
+        return;
+    }
+    dcentry_t* e = malloc(sizeof(*e) + len + 1);
+    if (e == NULL) {
+        mx_handle_close(watch);
+        mx_handle_close(h);
+        return;
+    }
+    e->vn = vn;
+    e->h = h;
+    e->watch = watch;
+    e->pathlen = len;
+    memcpy(e->relpath, path, len);
+    e->relpath[len] = 0;
+
+    if (ns->dcache_count >= DIRCACHE_MAX_ENTRIES) {
+        // evict the coldest (last) entry
+        dcentry_t** prevp = &ns->dcache;
+        while ((*prevp)->next != NULL) {
+            prevp = &(*prevp)->next;
+        }
+        dcache_drop_locked(ns, prevp);
+    }
+    e->next = ns->dcache;
+    ns->dcache = e;
+    ns->dcache_count++;
+}
+
+// Open path below vn's remote, caching the handle for its directory
+// prefix so later opens under the same directory skip the server-side
+// walk and send a single-component OPEN instead.
+static mx_status_t dcache_open_locked(mxio_ns_t* ns, mxvn_t* vn, const char* path,
+                                      int32_t flags, uint32_t mode, mxio_t** out) {
+    const char* leaf = strrchr(path, '/');
+    if (leaf == NULL) {
+        // single component, nothing to cache against
+        return mxrio_open_handle(vn->remote, path, flags, mode, out);
+    }
+    size_t dirlen = leaf - path;
+    leaf++;
+
+    mx_handle_t dh = dcache_lookup_locked(ns, vn, path, dirlen);
+    if (dh == MX_HANDLE_INVALID) {
+        char dirpath[PATH_MAX];
+        if (dirlen >= sizeof(dirpath)) {
+            return ERR_BAD_PATH;
+        }
+        memcpy(dirpath, path, dirlen);
+        dirpath[dirlen] = 0;
+        if (mxrio_open_handle_raw(vn->remote, dirpath, O_RDONLY | O_DIRECTORY,
+                                  0, &dh) == NO_ERROR) {
+            dcache_install_locked(ns, vn, path, dirlen, dh);
+        } else {
+            dh = MX_HANDLE_INVALID;
+        }
+        // re-fetch, since install may have declined to cache the handle
+        dh = dcache_lookup_locked(ns, vn, path, dirlen);
+    }
+
+    if (dh != MX_HANDLE_INVALID) {
+        mx_status_t r = mxrio_open_handle(dh, leaf, flags, mode, out);
+        if (r != ERR_PEER_CLOSED) {
+            return r;
+        }
+        // the cached directory went away under us; the lookup below will
+        // observe the closed watch channel and drop the entry, then we
+        // retry with a full walk
+        dcache_lookup_locked(ns, vn, path, dirlen);
+    }
+
+    return mxrio_open_handle(vn->remote, path, flags, mode, out);
+}
+
 static mx_status_t mxdir_close(mxio_t* io) {
     mxdir_t* dir = (mxdir_t*) io;
     mtx_lock(&dir->ns->lock);
@@ -194,14 +349,14 @@ static mx_status_t mxdir_clone(mxio_t* io, mx_handle_t* handles, uint32_t* types
     return 1;
 }
 
-mx_status_t mxio_ns_connect(mxio_ns_t* ns, const char* path, mx_handle_t h) {
-    mxvn_t* vn = &ns->root;
-    mx_status_t r = NO_ERROR;
-
-    mtx_lock(&ns->lock);
+// Walks the namespace looking for the filesystem responsible for 'path'.
+// On success, returns the vnode whose remote should serve the request and
+// the residual path to hand off (a suffix of 'path', or "" if the path
+// terminated exactly on the vnode).
+static mx_status_t vn_walk_locked(mxvn_t* vn, const char* path,
+                                  mxvn_t** out_vn, const char** out_path) {
     if (path[0] != '/') {
-        r = ERR_NOT_FOUND;
-        goto done;
+        return ERR_NOT_FOUND;
     }
     path++;
 
@@ -220,8 +375,7 @@ mx_status_t mxio_ns_connect(mxio_ns_t* ns, const char* path, mx_handle_t h) {
 
         // path segment can't be empty
         if (len == 0) {
-            r = ERR_BAD_PATH;
-            break;
+            return ERR_BAD_PATH;
         }
 
         // is there a local match?
@@ -249,20 +403,45 @@ mx_status_t mxio_ns_connect(mxio_ns_t* ns, const char* path, mx_handle_t h) {
         if (vn->remote == MX_HANDLE_INVALID) {
             // if not, we're done
             if (save_vn == NULL) {
-                r = ERR_NOT_FOUND;
-                break;
+                return ERR_NOT_FOUND;
             }
             // otherwise roll back
             vn = save_vn;
             path = save_path;
         }
 
+        *out_vn = vn;
+        *out_path = path;
+        return NO_ERROR;
+    }
+}
+
+mx_status_t mxio_ns_connect(mxio_ns_t* ns, const char* path, mx_handle_t h) {
+    mxvn_t* vn;
+    mx_status_t r;
+
+    mtx_lock(&ns->lock);
+    if ((r = vn_walk_locked(&ns->root, path, &vn, &path)) == NO_ERROR) {
         // hand off to remote filesystem
         r = mxio_service_connect_at(vn->remote, path, h);
-        goto done;
+    } else {
+        mx_handle_close(h);
+    }
+    mtx_unlock(&ns->lock);
+    return r;
+}
+
+mx_status_t mxio_ns_resolve(mxio_ns_t* ns, const char* path,
+                            mx_handle_t* out, const char** remainder) {
+    mxvn_t* vn;
+    mx_status_t r;
+
+    mtx_lock(&ns->lock);
+    if ((r = vn_walk_locked(&ns->root, path, &vn, remainder)) == NO_ERROR) {
+        // Duplicate, so the caller may hold the handle beyond the
+        // lifetime of the namespace binding.
+        r = mx_handle_duplicate(vn->remote, MX_RIGHT_SAME_RIGHTS, out);
     }
-    mx_handle_close(h);
-done:
     mtx_unlock(&ns->lock);
     return r;
 }
@@ -328,9 +507,10 @@ static mx_status_t mxdir_open(mxio_t* io, const char* path,
             break;
         }
 
-        // hand off to remote filesystem
+        // hand off to remote filesystem, via the directory cache
+        r = dcache_open_locked(dir->ns, vn, path, flags, mode, out);
         mtx_unlock(&dir->ns->lock);
-        return mxrio_open_handle(vn->remote, path, flags, mode, out);
+        return r;
     }
     if (r == NO_ERROR) {
         if ((vn->remote == MX_HANDLE_INVALID) && (save_vn != NULL)) {
@@ -503,6 +683,7 @@ static mxio_t* mxio_dir_create_locked(mxio_ns_t* ns, mxvn_t* vn, mx_handle_t h)
     }
     dir->ns = ns;
     dir->vn = vn;
+    mtx_init(&dir->rio.lock, mtx_plain);
     atomic_init(&dir->seq, 0);
     return &dir->rio.io;
 }
@@ -524,6 +705,7 @@ mx_status_t mxio_ns_destroy(mxio_ns_t* ns) {
         mtx_unlock(&ns->lock);
         return ERR_BAD_STATE;
     } else {
+        dcache_flush_locked(ns);
         vn_destroy_children_locked(&ns->root);
         mtx_unlock(&ns->lock);
         free(ns);
@@ -589,6 +771,10 @@ mx_status_t mxio_ns_bind(mxio_ns_t* ns, const char* path, mx_handle_t remote) {
             }
             vn = parent;
         }
+    } else {
+        // a new binding may shadow paths the dcache resolved through
+        // the old topology
+        dcache_flush_locked(ns);
     }
 done:
     mtx_unlock(&ns->lock);
@@ -19,6 +19,10 @@ struct mxrio {
 
     // transaction id used for synchronous remoteio calls
     _Atomic mx_txid_t txid;
+
+    // serializes pipelined transactions on the channel, which drain
+    // replies with mx_channel_read (see write_common in remoteio.c)
+    mtx_t lock;
 };
 
 // These are for the benefit of namespace.c
@@ -38,6 +42,11 @@ mx_status_t mxrio_open_handle_raw(mx_handle_t h, const char* path, int32_t flags
 mx_status_t mxrio_open(mxio_t* io, const char* path, int32_t flags,
                        uint32_t mode, mxio_t** out);
 
+// pipelined connect of 'cnxn' via a channel speaking the remoteio
+// protocol; always consumes cnxn (for the benefit of service.c)
+mx_status_t mxrio_connect(mx_handle_t svc, mx_handle_t cnxn,
+                          uint32_t op, const char* name);
+
 // misc operation directly on remoteio mxio_t
 mx_status_t mxrio_misc(mxio_t* io, uint32_t op, int64_t off,
                        uint32_t maxreply, void* ptr, size_t len);
@@ -50,6 +59,10 @@ mx_status_t mxrio_close(mxio_t* io);
 ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
                     size_t in_len, void* out_buf, size_t out_len);
 
+// ioctl directly against a remoteio handle
+ssize_t mxrio_ioctl_handle(mx_handle_t h, uint32_t op, const void* in_buf,
+                           size_t in_len, void* out_buf, size_t out_len);
+
 mx_status_t mxrio_getobject(mx_handle_t rio_h, uint32_t op, const char* name,
                             int32_t flags, uint32_t mode,
                             mxrio_object_t* info);
\ No newline at end of file
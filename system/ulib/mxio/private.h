@@ -130,6 +130,11 @@ mx_status_t mxio_pipe_posix_ioctl(mxio_t* io, int req, va_list va);
 // Takens ownership of h.
 mxio_t* mxio_vmofile_create(mx_handle_t h, mx_off_t off, mx_off_t len);
 
+// Wraps an existing io object with a buffered layer serving small reads
+// from a readahead window and coalescing small writes.
+// Takes ownership of the caller's reference to inner.
+mxio_t* mxio_buffered_create(mxio_t* inner);
+
 // Wraps a socket with an mxio_t using socket io.
 // Takes ownership of h and s.
 mxio_t* mxio_socket_create(mx_handle_t h, mx_handle_t s, int flags);
@@ -155,6 +160,18 @@ static inline void mxio_release(mxio_t* io) {
 
 mxio_t* mxio_ns_open_root(mxio_ns_t* ns);
 
+// Resolves 'path' to the remote filesystem that would serve it,
+// returning a duplicate of that filesystem's handle and the residual
+// path (a suffix of 'path') to hand off to it. Used by the service
+// connection cache to skip the namespace walk on repeat connections.
+mx_status_t mxio_ns_resolve(mxio_ns_t* ns, const char* path,
+                            mx_handle_t* out, const char** remainder);
+
+// Connect 'h' to the named service via the connection cache in
+// service.c, falling back to the svcroot handle or root namespace.
+// Always consumes 'h'.
+mx_status_t __mxio_service_connect_cached(const char* svcpath, mx_handle_t h);
+
 // io will be consumed by this and must not be shared
 void mxio_chdir(mxio_t* io, const char* path);
 
@@ -25,6 +25,7 @@
 #include <mxio/namespace.h>
 #include <mxio/remoteio.h>
 #include <mxio/util.h>
+#include <mxio/vfs.h>
 
 #include "private-remoteio.h"
 
@@ -244,6 +245,68 @@ fail_discard_handles:
     return r;
 }
 
+// Maximum number of transactions a pipelined batch keeps in flight
+// on one rio channel before collecting replies.
+#define MXRIO_MAX_INFLIGHT 4
+
+// Submit a transaction without waiting for the reply, which must later be
+// collected with mxrio_txn_wait().  Pipelined replies are drained off the
+// channel with mx_channel_read, so only one batch may be active per channel
+// at a time (callers hold rio->lock).  Transactions made with mxrio_txn()
+// may safely overlap a batch: the kernel hands their replies directly to
+// the calling thread by txid and they never reach the message queue.
+static mx_status_t mxrio_txn_submit(mxrio_t* rio, mxrio_msg_t* msg) {
+    if (!is_message_valid(msg)) {
+        return ERR_INVALID_ARGS;
+    }
+
+    msg->txid = atomic_fetch_add(&rio->txid, 1);
+    xprintf("txn submit h=%x txid=%x op=%d len=%u\n", rio->h, msg->txid, msg->op, msg->datalen);
+
+    return mx_channel_write(rio->h, 0, msg, MXRIO_HDR_SZ + msg->datalen,
+                            msg->handle, msg->hcount);
+}
+
+// Collect the next reply to a submitted transaction.  Replies may complete
+// out of order; msg->txid tells the caller which submission finished and
+// msg->arg carries the remote status.  An error return means the channel
+// is unusable and no further replies will arrive.
+static mx_status_t mxrio_txn_wait(mxrio_t* rio, mxrio_msg_t* msg) {
+    mx_status_t r;
+    uint32_t dsize;
+
+    for (;;) {
+        dsize = sizeof(mxrio_msg_t);
+        uint32_t hcount = 0;
+        r = mx_channel_read(rio->h, 0, msg, msg->handle, dsize,
+                            MXIO_MAX_HANDLES, &dsize, &hcount);
+        if (r == ERR_SHOULD_WAIT) {
+            mx_signals_t pending;
+            if ((r = mx_object_wait_one(rio->h, MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED,
+                                        MX_TIME_INFINITE, &pending)) < 0) {
+                return r;
+            }
+            if (pending & MX_CHANNEL_READABLE) {
+                continue;
+            }
+            return ERR_PEER_CLOSED;
+        }
+        if (r < 0) {
+            return r;
+        }
+        msg->hcount = hcount;
+        break;
+    }
+
+    if (!is_message_reply_valid(msg, dsize) ||
+        (MXRIO_OP(msg->op) != MXRIO_STATUS)) {
+        discard_handles(msg->handle, msg->hcount);
+        msg->hcount = 0;
+        return ERR_IO;
+    }
+    return NO_ERROR;
+}
+
 ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
                     size_t in_len, void* out_buf, size_t out_len) {
     mxrio_t* rio = (mxrio_t*)io;
@@ -334,44 +397,174 @@ ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
     return r;
 }
 
+// ioctl directly against a remoteio handle, for callers (like the
+// namespace layer) which hold raw handles rather than mxio_t objects
+ssize_t mxrio_ioctl_handle(mx_handle_t h, uint32_t op, const void* in_buf,
+                           size_t in_len, void* out_buf, size_t out_len) {
+    mxrio_t rio;
+    memset(&rio, 0, sizeof(rio));
+    rio.h = h;
+    return mxrio_ioctl(&rio.io, op, in_buf, in_len, out_buf, out_len);
+}
+
+// Threshold above which stream writes stage their data in a vmo and send
+// one MXRIO_WRITE_VMO message instead of a pipeline of chunked WRITEs.
+#define WRITE_VMO_THRESHOLD (16 * MXIO_CHUNK_SIZE)
+
+// Stage data in a vmo and describe it to the server in a single message.
+// Returns ERR_NOT_SUPPORTED, either from the server or because staging
+// failed locally, when the caller should fall back to chunked writes.
+static ssize_t write_vmo(mxrio_t* rio, const uint8_t* data, size_t len) {
+    mx_handle_t vmo;
+    size_t actual;
+    if (mx_vmo_create(len, 0, &vmo) != NO_ERROR) {
+        return ERR_NOT_SUPPORTED;
+    }
+    if ((mx_vmo_write(vmo, data, 0, len, &actual) != NO_ERROR) || (actual != len)) {
+        mx_handle_close(vmo);
+        return ERR_NOT_SUPPORTED;
+    }
+
+    mxrio_msg_t msg;
+    memset(&msg, 0, MXRIO_HDR_SZ);
+    msg.op = MXRIO_WRITE_VMO;
+    msg.arg2.off = len;
+    msg.hcount = 1;
+    msg.handle[0] = vmo;
+
+    mx_status_t r = mxrio_txn(rio, &msg);
+    if (r >= 0) {
+        discard_handles(msg.handle, msg.hcount);
+    }
+    return r;
+}
+
 static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t len, off_t offset) {
     mxrio_t* rio = (mxrio_t*)io;
     const uint8_t* data = _data;
     ssize_t count = 0;
     mx_status_t r = 0;
     mxrio_msg_t msg;
-    ssize_t xfer;
 
-    while (len > 0) {
-        xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
+    if ((op == MXRIO_WRITE) && (len >= WRITE_VMO_THRESHOLD) && (len <= INT32_MAX)) {
+        ssize_t rv = write_vmo(rio, data, len);
+        if (rv != ERR_NOT_SUPPORTED) {
+            return rv;
+        }
+        // server doesn't speak MXRIO_WRITE_VMO; use chunked writes
+    }
 
+    if (len <= MXIO_CHUNK_SIZE) {
+        // single transaction, use the synchronous path
         memset(&msg, 0, MXRIO_HDR_SZ);
         msg.op = op;
-        msg.datalen = xfer;
+        msg.datalen = len;
         if (op == MXRIO_WRITE_AT)
             msg.arg2.off = offset;
-        memcpy(msg.data, data, xfer);
+        memcpy(msg.data, data, len);
 
         if ((r = mxrio_txn(rio, &msg)) < 0) {
-            break;
+            return r;
         }
         discard_handles(msg.handle, msg.hcount);
 
-        if (r > xfer) {
-            r = ERR_IO;
+        return (r > (ssize_t)len) ? ERR_IO : r;
+    }
+
+    // Multiple chunks: pipeline them, keeping up to MXRIO_MAX_INFLIGHT
+    // transactions submitted ahead of their replies so consecutive writes
+    // pay one round trip per window rather than one per chunk.  Replies
+    // are matched back to submissions by txid and accounted in submission
+    // order, so a short or failed chunk stops the count exactly where the
+    // synchronous loop would have.
+    struct {
+        mx_txid_t txid;
+        uint32_t xfer;
+        mx_status_t status;
+        bool done;
+    } window[MXRIO_MAX_INFLIGHT];
+    uint32_t wr = 0; // submitted
+    uint32_t rd = 0; // retired, in submission order
+    mx_status_t error = 0;
+    bool stop = false;
+
+    mtx_lock(&rio->lock);
+
+    while ((len > 0 && !stop && (error == 0)) || (rd != wr)) {
+        // submit while there is room in the window and data left to send
+        while ((len > 0) && !stop && (error == 0) && ((wr - rd) < MXRIO_MAX_INFLIGHT)) {
+            size_t xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
+
+            memset(&msg, 0, MXRIO_HDR_SZ);
+            msg.op = op;
+            msg.datalen = xfer;
+            if (op == MXRIO_WRITE_AT)
+                msg.arg2.off = offset;
+            memcpy(msg.data, data, xfer);
+
+            if ((r = mxrio_txn_submit(rio, &msg)) < 0) {
+                error = r;
+                break;
+            }
+            unsigned slot = wr % MXRIO_MAX_INFLIGHT;
+            window[slot].txid = msg.txid;
+            window[slot].xfer = xfer;
+            window[slot].done = false;
+            wr++;
+
+            data += xfer;
+            len -= xfer;
+            if (op == MXRIO_WRITE_AT)
+                offset += xfer;
+        }
+
+        if (rd == wr) {
             break;
         }
-        count += r;
-        data += r;
-        len -= r;
-        if (op == MXRIO_WRITE_AT)
-            offset += r;
-        // stop at short read
-        if (r < xfer) {
+
+        // collect a reply and mark the matching submission complete
+        if ((r = mxrio_txn_wait(rio, &msg)) < 0) {
+            // the channel is dead; abandon the outstanding replies
+            if (error == 0) {
+                error = r;
+            }
             break;
         }
+        discard_handles(msg.handle, msg.hcount);
+
+        for (uint32_t i = rd; i != wr; i++) {
+            unsigned slot = i % MXRIO_MAX_INFLIGHT;
+            if (!window[slot].done && (window[slot].txid == msg.txid)) {
+                window[slot].done = true;
+                window[slot].status = msg.arg;
+                break;
+            }
+        }
+
+        // retire completed submissions in order
+        while ((rd != wr) && window[rd % MXRIO_MAX_INFLIGHT].done) {
+            unsigned slot = rd % MXRIO_MAX_INFLIGHT;
+            mx_status_t s = window[slot].status;
+            if (!stop && (error == 0)) {
+                if (s < 0) {
+                    error = s;
+                } else if ((uint32_t)s > window[slot].xfer) {
+                    error = ERR_IO;
+                } else {
+                    count += s;
+                    // stop at short write
+                    if ((uint32_t)s < window[slot].xfer) {
+                        stop = true;
+                    }
+                }
+            }
+            rd++;
+        }
     }
-    return count ? count : r;
+
+    mtx_unlock(&rio->lock);
+
+    return count ? count : error;
 }
 
 static ssize_t mxrio_write(mxio_t* io, const void* _data, size_t len) {
@@ -519,8 +712,8 @@ static mx_status_t mxrio_reply_channel_call(mx_handle_t rio_h, mxrio_msg_t* msg,
 
 // This function always consumes the cnxn handle
 // The svc handle is only used to send a message
-static mx_status_t mxrio_connect(mx_handle_t svc, mx_handle_t cnxn,
-                                 uint32_t op, const char* name) {
+mx_status_t mxrio_connect(mx_handle_t svc, mx_handle_t cnxn,
+                          uint32_t op, const char* name) {
     size_t len = strlen(name);
     if (len >= PATH_MAX) {
         mx_handle_close(cnxn);
@@ -551,22 +744,10 @@ mx_status_t mxio_service_connect(const char* svcpath, mx_handle_t h) {
         mx_handle_close(h);
         return ERR_INVALID_ARGS;
     }
-    // If there's an explicit svcroot handle,
-    // attempt to connect through that
-    if (mxio_svc_root != MX_HANDLE_INVALID) {
-        if (strncmp("/svc/", svcpath, 5)) {
-            goto not_found;
-        }
-        return mxio_service_connect_at(mxio_svc_root, svcpath + 5, h);
-    }
-    // Otherwise attempt to connect through the root namespace
-    if (mxio_root_ns != NULL) {
-        return mxio_ns_connect(mxio_root_ns, svcpath, h);
-    }
-    // Otherwise we fail
-not_found:
-    mx_handle_close(h);
-    return ERR_NOT_FOUND;
+    // Repeat connections to the same service are served out of the
+    // connection cache in service.c, which falls back to the svcroot
+    // handle or the root namespace for anything it cannot cache.
+    return __mxio_service_connect_cached(svcpath, h);
 }
 
 mx_status_t mxio_service_connect_at(mx_handle_t dir, const char* path, mx_handle_t h) {
@@ -885,6 +1066,35 @@ static void mxrio_wait_end(mxio_t* io, mx_signals_t signals, uint32_t* _events)
     *_events = ((signals >> POLL_SHIFT) & POLL_MASK) | events;
 }
 
+static mx_status_t mxrio_get_vmo(mxio_t* io, mx_handle_t* out, size_t* off, size_t* len) {
+    // The file's size bounds the window the server clones for us.
+    vnattr_t attr;
+    mx_status_t r = mxrio_misc(io, MXRIO_STAT, 0, sizeof(attr), &attr, 0);
+    if (r < 0) {
+        return r;
+    }
+    if (r < (int)sizeof(attr)) {
+        return ERR_IO;
+    }
+
+    // Ask the server for a copy-on-write clone of the backing VMO.
+    // Servers which cannot provide one fail with ERR_NOT_SUPPORTED and
+    // the caller falls back to reading the file contents (see get-vmo.c).
+    mxrio_mmap_data_t data;
+    data.offset = 0;
+    data.length = attr.size;
+    data.flags = MXIO_MMAP_FLAG_READ | MXIO_MMAP_FLAG_EXEC | MXIO_MMAP_FLAG_PRIVATE;
+
+    if ((r = mxrio_misc(io, MXRIO_MMAP, 0, sizeof(data), &data, sizeof(data))) < 0) {
+        return r;
+    }
+
+    *out = (mx_handle_t)r;
+    *off = data.offset;
+    *len = data.length;
+    return NO_ERROR;
+}
+
 static mxio_ops_t mx_remote_ops = {
     .read = mxrio_read,
     .read_at = mxrio_read_at,
@@ -902,7 +1112,7 @@ static mxio_ops_t mx_remote_ops = {
     .wait_end = mxrio_wait_end,
     .unwrap = mxrio_unwrap,
     .posix_ioctl = mxio_default_posix_ioctl,
-    .get_vmo = mxio_default_get_vmo,
+    .get_vmo = mxrio_get_vmo,
 };
 
 mxio_t* mxio_remote_create(mx_handle_t h, mx_handle_t e) {
@@ -917,5 +1127,6 @@ mxio_t* mxio_remote_create(mx_handle_t h, mx_handle_t e) {
     atomic_init(&rio->io.refcount, 1);
     rio->h = h;
     rio->h2 = e;
+    mtx_init(&rio->lock, mtx_plain);
     return &rio->io;
 }
@@ -539,6 +539,7 @@ mxio_t* mxio_socket_create(mx_handle_t h, mx_handle_t s, int flags) {
     rio->io.flags = MXIO_FLAG_SOCKET | flags;
     rio->h = h;
     rio->h2 = s;
+    mtx_init(&rio->lock, mtx_plain);
     return &rio->io;
 }
 
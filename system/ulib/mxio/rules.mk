@@ -11,6 +11,7 @@ MODULE_TYPE := userlib
 MODULE_SRCS += \
     $(LOCAL_DIR)/bootfs.c \
     $(LOCAL_DIR)/bsdsocket.c \
+    $(LOCAL_DIR)/bufferedio.c \
     $(LOCAL_DIR)/dispatcher.c \
     $(LOCAL_DIR)/epoll.c \
     $(LOCAL_DIR)/logger.c \
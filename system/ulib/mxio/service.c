@@ -5,11 +5,17 @@
 #include <errno.h>
 #include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
+#include <threads.h>
 
 #include <magenta/errors.h>
 #include <magenta/syscalls.h>
 
+#include <mxio/namespace.h>
+#include <mxio/remoteio.h>
+
 #include "private.h"
+#include "private-remoteio.h"
 #include "unistd.h"
 
 typedef struct {
@@ -55,6 +61,210 @@ mxio_t* mxio_service_create(mx_handle_t h) {
     return &svc->io;
 }
 
+// Client-side cache of service connections.
+//
+// Most processes talk to a small set of services over and over; walking
+// the namespace (under its global lock) for every connection makes that
+// far more expensive than it needs to be.  Each entry remembers which
+// remote directory a service path resolved to, so a repeat connection
+// is a single pipelined channel write on the cached handle.  Each entry
+// also keeps at most one pre-connected idle channel with a keep-alive
+// TTL, letting mxio_service_open() usually hand back a ready connection
+// without creating anything at all.
+
+#define SVC_CACHE_ENTRIES 8
+#define SVC_PATH_MAX      128
+#define SVC_IDLE_TTL      MX_SEC(30)
+
+typedef struct {
+    char path[SVC_PATH_MAX]; // service path; "" while the entry is unused
+    size_t remainder;        // offset of the residual path within 'path'
+    mx_handle_t dir;         // duplicated handle to the serving directory
+    mx_handle_t idle;        // pre-connected spare, or MX_HANDLE_INVALID
+    mx_time_t idle_born;     // when 'idle' was connected
+    uint64_t last_used;      // LRU stamp
+} svc_cache_entry_t;
+
+static svc_cache_entry_t svc_cache[SVC_CACHE_ENTRIES];
+static mtx_t svc_cache_lock = MTX_INIT;
+static uint64_t svc_cache_tick;
+
+static svc_cache_entry_t* svc_cache_find_locked(const char* svcpath) {
+    for (unsigned n = 0; n < SVC_CACHE_ENTRIES; n++) {
+        if (!strcmp(svc_cache[n].path, svcpath)) {
+            return &svc_cache[n];
+        }
+    }
+    return NULL;
+}
+
+static void svc_cache_evict_locked(svc_cache_entry_t* e) {
+    mx_handle_close(e->dir);
+    if (e->idle != MX_HANDLE_INVALID) {
+        mx_handle_close(e->idle);
+        e->idle = MX_HANDLE_INVALID;
+    }
+    e->path[0] = '\0';
+}
+
+// Resolve 'svcpath' and fill a cache entry with the result, evicting
+// the least recently used entry if necessary.
+static svc_cache_entry_t* svc_cache_fill_locked(const char* svcpath) {
+    mx_handle_t dir;
+    const char* remainder;
+
+    // Resolution order matches the original mxio_service_connect():
+    // an explicit svcroot handle wins, then the root namespace.
+    if (mxio_svc_root != MX_HANDLE_INVALID) {
+        if (strncmp("/svc/", svcpath, 5)) {
+            return NULL;
+        }
+        if (mx_handle_duplicate(mxio_svc_root, MX_RIGHT_SAME_RIGHTS, &dir) != NO_ERROR) {
+            return NULL;
+        }
+        remainder = svcpath + 5;
+    } else if (mxio_root_ns != NULL) {
+        if (mxio_ns_resolve(mxio_root_ns, svcpath, &dir, &remainder) != NO_ERROR) {
+            return NULL;
+        }
+    } else {
+        return NULL;
+    }
+
+    svc_cache_entry_t* e = &svc_cache[0];
+    for (unsigned n = 0; n < SVC_CACHE_ENTRIES; n++) {
+        if (svc_cache[n].path[0] == '\0') {
+            e = &svc_cache[n];
+            break;
+        }
+        if (svc_cache[n].last_used < e->last_used) {
+            e = &svc_cache[n];
+        }
+    }
+    if (e->path[0] != '\0') {
+        svc_cache_evict_locked(e);
+    }
+
+    strcpy(e->path, svcpath);
+    e->remainder = remainder - svcpath;
+    e->dir = dir;
+    e->idle = MX_HANDLE_INVALID;
+    e->idle_born = 0;
+    return e;
+}
+
+// Connect 'h' via a cache entry; always consumes 'h'. On failure the
+// entry is evicted (the cached handle may have gone stale because the
+// service restarted), so the next attempt re-resolves.
+static mx_status_t svc_cache_connect_locked(svc_cache_entry_t* e, mx_handle_t h) {
+    e->last_used = ++svc_cache_tick;
+    mx_status_t r = mxrio_connect(e->dir, h, MXRIO_OPEN, e->path + e->remainder);
+    if (r < 0) {
+        svc_cache_evict_locked(e);
+    }
+    return r;
+}
+
+mx_status_t __mxio_service_connect_cached(const char* svcpath, mx_handle_t h) {
+    if (strlen(svcpath) >= SVC_PATH_MAX) {
+        // Too long to cache; connect the old way.
+        if (mxio_svc_root != MX_HANDLE_INVALID) {
+            if (!strncmp("/svc/", svcpath, 5)) {
+                return mxio_service_connect_at(mxio_svc_root, svcpath + 5, h);
+            }
+        } else if (mxio_root_ns != NULL) {
+            return mxio_ns_connect(mxio_root_ns, svcpath, h);
+        }
+        mx_handle_close(h);
+        return ERR_NOT_FOUND;
+    }
+
+    mtx_lock(&svc_cache_lock);
+    svc_cache_entry_t* e = svc_cache_find_locked(svcpath);
+    if ((e == NULL) && ((e = svc_cache_fill_locked(svcpath)) == NULL)) {
+        mtx_unlock(&svc_cache_lock);
+        mx_handle_close(h);
+        return ERR_NOT_FOUND;
+    }
+    mx_status_t r = svc_cache_connect_locked(e, h);
+    mtx_unlock(&svc_cache_lock);
+    return r;
+}
+
+mx_status_t mxio_service_open(const char* svcpath, mx_handle_t* out) {
+    if ((svcpath == NULL) || (out == NULL)) {
+        return ERR_INVALID_ARGS;
+    }
+    if (strlen(svcpath) >= SVC_PATH_MAX) {
+        // Too long to pool; plain connect.
+        mx_handle_t cli, srv;
+        mx_status_t r;
+        if ((r = mx_channel_create(0, &cli, &srv)) < 0) {
+            return r;
+        }
+        if ((r = mxio_service_connect(svcpath, srv)) < 0) {
+            mx_handle_close(cli);
+            return r;
+        }
+        *out = cli;
+        return NO_ERROR;
+    }
+
+    mtx_lock(&svc_cache_lock);
+    svc_cache_entry_t* e = svc_cache_find_locked(svcpath);
+    if ((e != NULL) && (e->idle != MX_HANDLE_INVALID)) {
+        mx_handle_t idle = e->idle;
+        e->idle = MX_HANDLE_INVALID;
+        e->last_used = ++svc_cache_tick;
+        bool alive = (mx_time_get(MX_CLOCK_MONOTONIC) - e->idle_born) < SVC_IDLE_TTL;
+        if (alive) {
+            // Reject the spare if the service dropped its end while
+            // the connection sat idle.
+            mx_signals_t pending = 0;
+            mx_object_wait_one(idle, MX_CHANNEL_PEER_CLOSED, 0u, &pending);
+            alive = !(pending & MX_CHANNEL_PEER_CLOSED);
+        }
+        if (alive) {
+            mtx_unlock(&svc_cache_lock);
+            *out = idle;
+            return NO_ERROR;
+        }
+        mx_handle_close(idle);
+    }
+    if ((e == NULL) && ((e = svc_cache_fill_locked(svcpath)) == NULL)) {
+        mtx_unlock(&svc_cache_lock);
+        return ERR_NOT_FOUND;
+    }
+
+    // No usable spare: connect a fresh channel for the caller, and
+    // pre-connect one more so the next open is served from the pool.
+    mx_handle_t cli, srv;
+    mx_status_t r;
+    if ((r = mx_channel_create(0, &cli, &srv)) < 0) {
+        mtx_unlock(&svc_cache_lock);
+        return r;
+    }
+    if ((r = svc_cache_connect_locked(e, srv)) < 0) {
+        mtx_unlock(&svc_cache_lock);
+        mx_handle_close(cli);
+        return r;
+    }
+    mx_handle_t spare_cli, spare_srv;
+    if (mx_channel_create(0, &spare_cli, &spare_srv) == NO_ERROR) {
+        if (svc_cache_connect_locked(e, spare_srv) == NO_ERROR) {
+            e->idle = spare_cli;
+            e->idle_born = mx_time_get(MX_CLOCK_MONOTONIC);
+        } else {
+            // Spare connect failed (and evicted the entry); the
+            // caller's connection was already written, so keep it.
+            mx_handle_close(spare_cli);
+        }
+    }
+    mtx_unlock(&svc_cache_lock);
+    *out = cli;
+    return NO_ERROR;
+}
+
 mx_status_t mxio_get_service_handle(int fd, mx_handle_t* out) {
     mtx_lock(&mxio_lock);
     if ((fd < 0) || (fd >= MAX_MXIO_FD) || (mxio_fdtab[fd] == NULL)) {
@@ -140,6 +140,24 @@ done:
     return status;
 }
 
+int mxio_buffer_fd(int fd) {
+    mxio_t* io;
+    mx_status_t r;
+
+    if ((r = mxio_unbind_from_fd(fd, &io)) < 0) {
+        // dup'd or busy fds cannot be switched; the buffer would not be
+        // shared with the other references
+        return (r == ERR_UNAVAILABLE) ? ERRNO(EBUSY) : ERROR(r);
+    }
+    mxio_t* bio = mxio_buffered_create(io);
+    if (bio == NULL) {
+        // restore the fd rather than leak the io object
+        mxio_bind_to_fd(io, fd, 0);
+        return ERRNO(ENOMEM);
+    }
+    return mxio_bind_to_fd(bio, fd, 0);
+}
+
 mxio_t* __mxio_fd_to_io(int fd) {
     if ((fd < 0) || (fd >= MAX_MXIO_FD)) {
         return NULL;
@@ -6,6 +6,7 @@
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <magenta/syscalls.h>
@@ -58,11 +59,12 @@ mx_status_t mxio_watcher_create(int dirfd, mxio_watcher_t** out) {
     return NO_ERROR;
 }
 
-static mx_status_t mxio_watcher_wait(mxio_watcher_t* watcher, uint8_t msg[VFS_WATCH_NAME_MAX + 2]) {
+static mx_status_t mxio_watcher_wait(mxio_watcher_t* watcher, uint8_t msg[VFS_WATCH_MSG_MAX],
+                                     uint32_t* sz) {
     for (;;) {
         mx_status_t status;
-        uint32_t sz = VFS_WATCH_NAME_MAX + 2;
-        if ((status = mx_channel_read(watcher->h, 0, msg, NULL, sz, 0, &sz, NULL)) < 0) {
+        *sz = VFS_WATCH_MSG_MAX;
+        if ((status = mx_channel_read(watcher->h, 0, msg, NULL, *sz, 0, sz, NULL)) < 0) {
             if (status != ERR_SHOULD_WAIT) {
                 return status;
             }
@@ -73,10 +75,6 @@ static mx_status_t mxio_watcher_wait(mxio_watcher_t* watcher, uint8_t msg[VFS_WA
             }
             continue;
         }
-        if ((sz < 2) || (sz != (msg[1] + 2u))) {
-            // malformed message
-            return ERR_INTERNAL;
-        }
         return NO_ERROR;
     }
 }
@@ -136,31 +134,49 @@ mx_status_t mxio_watch_directory(int dirfd, watchdir_func_t cb, void *cookie) {
     }
 
     do {
-        // Message Format: { OP, LEN, DATA[LEN] }
-        uint8_t msg[VFS_WATCH_NAME_MAX + 3];
-        if ((status = mxio_watcher_wait(watcher, msg)) != NO_ERROR) {
+        // A message is one or more packed events: { OP, LEN, DATA[LEN] }
+        uint8_t msg[VFS_WATCH_MSG_MAX];
+        uint32_t sz;
+        if ((status = mxio_watcher_wait(watcher, msg, &sz)) != NO_ERROR) {
             break;
         }
 
-        uint32_t evt;
-        msg[msg[1] + 2] = 0;
-        switch (msg[0]) {
-        case VFS_WATCH_EVT_ADDED:
-        case VFS_WATCH_EVT_EXISTING:
-            evt = WATCH_EVENT_ADD_FILE;
-            break;
-        case VFS_WATCH_EVT_REMOVED:
-            evt = WATCH_EVENT_REMOVE_FILE;
-            break;
-        case VFS_WATCH_EVT_IDLE:
-            evt = WATCH_EVENT_IDLE;
-            break;
-        default:
-            // unsupported event
-            continue;
-        }
+        uint8_t* p = msg;
+        while (sz >= 2) {
+            unsigned len = p[1];
+            if (len + 2u > sz) {
+                // malformed message
+                status = ERR_INTERNAL;
+                break;
+            }
 
-        status = cb(dirfd, evt, (char*) (msg + 2), cookie);
+            char name[VFS_WATCH_NAME_MAX + 1];
+            memcpy(name, p + 2, len);
+            name[len] = 0;
+
+            uint32_t evt;
+            switch (p[0]) {
+            case VFS_WATCH_EVT_ADDED:
+            case VFS_WATCH_EVT_EXISTING:
+                evt = WATCH_EVENT_ADD_FILE;
+                break;
+            case VFS_WATCH_EVT_REMOVED:
+                evt = WATCH_EVENT_REMOVE_FILE;
+                break;
+            case VFS_WATCH_EVT_IDLE:
+                evt = WATCH_EVENT_IDLE;
+                break;
+            default:
+                // unsupported event
+                evt = 0;
+                break;
+            }
+            if (evt != 0 && (status = cb(dirfd, evt, name, cookie)) != NO_ERROR) {
+                break;
+            }
+            p += len + 2;
+            sz -= len + 2;
+        }
     } while (status == NO_ERROR);
 
 done:
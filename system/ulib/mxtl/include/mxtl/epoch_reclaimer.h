@@ -0,0 +1,228 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/assert.h>
+#include <mxtl/atomic.h>
+#include <mxtl/macros.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace mxtl {
+
+// EpochReclaimer implements classic three-epoch reclamation (EBR), the
+// missing piece for building lock-free read paths over linked structures:
+// readers traverse with no per-node atomics, writers unlink nodes and
+// retire them, and the reclaimer frees a retired node only once every
+// reader which could have observed it has moved on.
+//
+// The scheme: a global epoch advances whenever every participant inside a
+// critical region has been seen in the current epoch.  A node retired in
+// epoch E can only be referenced by readers pinned at E or E-1, so once
+// the global epoch reaches E+2 the node is unreachable and is freed.
+//
+// Participation is slot based.  A participant (a thread, or a cpu when
+// used with preemption disabled in the kernel) claims a Slot once and
+// then brackets each read-side critical region with Enter/Exit; both are
+// a pair of relaxed-cost atomic operations on the participant's own cache
+// line, with a single full fence in Enter.  Writers call Retire on the
+// slot they own.  Reclamation is driven from Retire and from Quiesce --
+// there is no background thread, so a participant which stops calling
+// either simply stops freeing its own garbage (and, if it sits inside a
+// critical region forever, stalls everyone's reclamation; keep critical
+// regions short).
+//
+// Retired objects embed a RetireNode and supply a deleter thunk, so the
+// reclaimer itself never allocates and works identically in the kernel
+// and in userspace.  Hooking a kernel quiescent point (e.g. calling
+// Quiesce from the context switch path) is a decision for the subsystem
+// which adopts this; nothing here depends on it.
+template <size_t kMaxSlots>
+class EpochReclaimer {
+public:
+    struct RetireNode;
+    using DeleterFn = void (*)(RetireNode* node);
+
+    // Embed one of these in any object which will be retired.  The
+    // deleter receives the node pointer back and is responsible for
+    // recovering the containing object (containerof style) and freeing it.
+    struct RetireNode {
+        RetireNode* next;
+        DeleterFn deleter;
+    };
+
+    // Retired nodes age through three per-slot bins: the epoch they were
+    // retired in, one epoch older, and old enough to free.
+    static constexpr size_t kNumBins = 3;
+
+    // How many retires a slot accumulates before it spontaneously tries
+    // to advance the epoch.
+    static constexpr uint32_t kAdvanceInterval = 64;
+
+    class Slot;
+
+    // An RAII bracket for a read-side critical region.
+    class Guard {
+    public:
+        explicit Guard(Slot* slot) : slot_(slot) { slot_->Enter(); }
+        ~Guard() { slot_->Exit(); }
+
+        DISALLOW_COPY_ASSIGN_AND_MOVE(Guard);
+
+    private:
+        Slot* slot_;
+    };
+
+    class Slot {
+    public:
+        // Pin the current epoch.  Critical regions must not nest.
+        void Enter() {
+            MX_DEBUG_ASSERT(active_.load(memory_order_relaxed) == 0u);
+            // The full fence orders the active_ store against the epoch
+            // load so an advancing writer either sees us active or we see
+            // the new epoch; re-reading until stable closes the window
+            // where we would pin an epoch which has already passed.
+            active_.store(1u, memory_order_seq_cst);
+            uint64_t e = reclaimer_->global_epoch_.load(memory_order_seq_cst);
+            while (epoch_.load(memory_order_relaxed) != e) {
+                epoch_.store(e, memory_order_seq_cst);
+                e = reclaimer_->global_epoch_.load(memory_order_seq_cst);
+            }
+        }
+
+        void Exit() {
+            MX_DEBUG_ASSERT(active_.load(memory_order_relaxed) != 0u);
+            active_.store(0u, memory_order_release);
+        }
+
+        // Hand |node| to the reclaimer; |deleter| runs once no reader can
+        // hold a reference.  Must be called outside a critical region (or
+        // by the lone writer) after the object is unlinked from every
+        // reader-visible structure.
+        void Retire(RetireNode* node, DeleterFn deleter) {
+            uint64_t e = reclaimer_->global_epoch_.load(memory_order_acquire);
+            Bin* bin = &bins_[e % kNumBins];
+            if (bin->epoch != e) {
+                // The bin last held nodes from an epoch old enough to be
+                // two behind by now, or FreeBins already emptied it.
+                FreeBin(bin, e);
+                bin->epoch = e;
+            }
+            node->deleter = deleter;
+            node->next = bin->head;
+            bin->head = node;
+            if (++retires_since_advance_ >= kAdvanceInterval) {
+                retires_since_advance_ = 0;
+                Quiesce();
+            }
+        }
+
+        // Declare a natural quiescent point: try to advance the global
+        // epoch and free whatever has become safe.  Cheap when the epoch
+        // cannot move; safe to call as often as convenient.
+        void Quiesce() {
+            reclaimer_->TryAdvance();
+            FreeBins();
+        }
+
+        // Free everything retired through this slot which has aged out.
+        void FreeBins() {
+            uint64_t e = reclaimer_->global_epoch_.load(memory_order_acquire);
+            for (size_t i = 0; i < kNumBins; ++i)
+                FreeBin(&bins_[i], e);
+        }
+
+    private:
+        friend class EpochReclaimer<kMaxSlots>;
+
+        struct Bin {
+            RetireNode* head = nullptr;
+            uint64_t epoch = 0;
+        };
+
+        // Nodes retired in bin->epoch are safe once the global epoch is
+        // two ahead.  (A fresh bin has epoch 0 and no nodes, so the age
+        // check falling through for it is harmless.)
+        void FreeBin(Bin* bin, uint64_t global) {
+            if ((bin->head == nullptr) || (global < bin->epoch + 2))
+                return;
+            RetireNode* node = bin->head;
+            bin->head = nullptr;
+            while (node) {
+                RetireNode* next = node->next;
+                node->deleter(node);
+                node = next;
+            }
+        }
+
+        EpochReclaimer<kMaxSlots>* reclaimer_ = nullptr;
+        // mxtl::atomic does not support bool; 0/1 flags instead.
+        atomic<uint32_t> claimed_{0};
+        atomic<uint32_t> active_{0};
+        atomic<uint64_t> epoch_{0};
+        Bin bins_[kNumBins];
+        uint32_t retires_since_advance_ = 0;
+    };
+
+    constexpr EpochReclaimer() {}
+    ~EpochReclaimer() {
+        // Retired nodes are only freed by slot operations, so drain every
+        // slot now that readers are gone; with no active participants two
+        // advances are always possible.
+        TryAdvance();
+        TryAdvance();
+        for (size_t i = 0; i < kMaxSlots; ++i)
+            slots_[i].FreeBins();
+    }
+
+    // Claim a slot for the calling participant, or nullptr if all
+    // kMaxSlots are taken.  Slots are never returned; size kMaxSlots for
+    // the maximum number of concurrent participants (e.g. SMP_MAX_CPUS).
+    Slot* ClaimSlot() {
+        for (size_t i = 0; i < kMaxSlots; ++i) {
+            uint32_t expected = 0;
+            if (slots_[i].claimed_.compare_exchange_strong(
+                    &expected, 1u,
+                    memory_order_acq_rel, memory_order_relaxed)) {
+                slots_[i].reclaimer_ = this;
+                return &slots_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Advance the global epoch if every active participant has caught up
+    // with it.  Returns true if the epoch moved.
+    bool TryAdvance() {
+        uint64_t e = global_epoch_.load(memory_order_seq_cst);
+        for (size_t i = 0; i < kMaxSlots; ++i) {
+            const Slot& slot = slots_[i];
+            if (slot.claimed_.load(memory_order_acquire) == 0u)
+                continue;
+            if ((slot.active_.load(memory_order_seq_cst) != 0u) &&
+                (slot.epoch_.load(memory_order_seq_cst) != e))
+                return false;
+        }
+        // A stale loser here is fine: epochs only move forward, and two
+        // racing advances from e can only reach e+1 once.
+        uint64_t expected = e;
+        global_epoch_.compare_exchange_strong(&expected, e + 1,
+                                              memory_order_seq_cst,
+                                              memory_order_relaxed);
+        return true;
+    }
+
+    uint64_t global_epoch() const {
+        return global_epoch_.load(memory_order_relaxed);
+    }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(EpochReclaimer);
+
+private:
+    atomic<uint64_t> global_epoch_{1};
+    Slot slots_[kMaxSlots];
+};
+
+}  // namespace mxtl
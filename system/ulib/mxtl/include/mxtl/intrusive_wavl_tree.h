@@ -9,6 +9,7 @@
 #include <mxtl/intrusive_pointer_traits.h>
 #include <mxtl/intrusive_wavl_tree_internal.h>
 #include <mxtl/macros.h>
+#include <mxtl/type_support.h>
 
 // Implementation Notes:
 //
@@ -38,6 +39,20 @@
 // upper_bound(key) : Finds the element (E) in the tree such that E.key > key
 // lower_bound(key) : Finds the element (E) in the tree such that E.key >= key
 //
+// Trees whose elements mix-in WAVLTreeSizedContainable<> (or whose custom node
+// state includes a subtree_size_ member) additionally maintain per-node subtree
+// sizes, enabling two order-statistic operations:
+// select(index)   : Finds the index'th smallest element in the tree in O(log)
+//                   time.
+// index_of(obj)   : Computes the in-order rank of an element which is a member
+//                   of the tree in O(log) time.
+// The bookkeeping adds a constant amount of work to each insert, erase and
+// rotation; trees whose node state carries no subtree_size_ member pay nothing.
+//
+// Finally, a tree may be populated from a key-sorted array of elements using
+// bulk_build(), which constructs a perfectly balanced tree in O(N) time instead
+// of paying the O(N log N) cost of N individual insert operations.
+//
 // The worst depth of a WAVL tree depends on whether or not the tree has ever
 // been subject to erase operations.
 // ++ If the tree has seen only insert operations, the worst case depth of the
@@ -59,6 +74,21 @@
 //
 namespace mxtl {
 
+namespace internal {
+
+// Detects the presence of a subtree_size_ member in a node state structure.
+// Used to selectively enable subtree size bookkeeping (and the select/index_of
+// operations built on top of it) only for trees whose node state carries the
+// extra storage.
+template <typename NodeStateType>
+struct WAVLTreeNodeStateHasSubtreeSize {
+    template <typename T> static int  test(decltype(&T::subtree_size_));
+    template <typename T> static char test(...);
+    static constexpr bool value = sizeof(test<NodeStateType>(nullptr)) == sizeof(int);
+};
+
+}  // namespace internal
+
 template <typename PtrType, typename RankType>
 struct WAVLTreeNodeStateBase {
     using PtrTraits = internal::ContainerPtrTraits<PtrType>;
@@ -81,10 +111,19 @@ struct WAVLTreeNodeState<PtrType, bool> : public WAVLTreeNodeStateBase<PtrType,
     void double_demote_rank()  { }
 };
 
+// A node state which extends the basic WAVLTreeNodeState with a count of the
+// nodes in the subtree rooted at this node (including the node itself).  Trees
+// whose node state is one of these automatically maintain the counts and gain
+// the O(log) select/index_of operations.
+template <typename PtrType, typename RankType = bool>
+struct WAVLTreeSizedNodeState : public WAVLTreeNodeState<PtrType, RankType> {
+    size_t subtree_size_ = 0;
+};
+
 template <typename PtrType, typename RankType = bool>
 struct DefaultWAVLTreeTraits {
     using PtrTraits = internal::ContainerPtrTraits<PtrType>;
-    static WAVLTreeNodeState<PtrType, RankType>& node_state(typename PtrTraits::RefType obj) {
+    static auto& node_state(typename PtrTraits::RefType obj) {
         return obj.wavl_node_state_;
     }
 };
@@ -99,6 +138,16 @@ private:
     WAVLTreeNodeState<PtrType, bool> wavl_node_state_;
 };
 
+template <typename PtrType>
+struct WAVLTreeSizedContainable {
+public:
+    bool InContainer() const { return wavl_node_state_.InContainer(); }
+
+private:
+    friend DefaultWAVLTreeTraits<PtrType, bool>;
+    WAVLTreeSizedNodeState<PtrType, bool> wavl_node_state_;
+};
+
 template <typename _KeyType,
           typename _PtrType,
           typename _KeyTraits  = DefaultKeyedObjectTraits<
@@ -246,6 +295,41 @@ public:
         return !collision;
     }
 
+    // bulk_build
+    //
+    // Populate an empty tree from an array of |count| pointers to elements
+    // which have already been sorted into strictly ascending key order,
+    // consuming the array entries in the process.  The tree produced is
+    // perfectly height balanced and is constructed in O(N) time, instead of
+    // paying the O(N log N) rebalancing cost of building the same tree with
+    // individual insert operations.  It is an error to call bulk_build on a
+    // non-empty tree, or with elements whose keys are not strictly ascending.
+    void bulk_build(PtrType* sorted_elements, size_t count) {
+        MX_DEBUG_ASSERT(is_empty());
+        MX_DEBUG_ASSERT((sorted_elements != nullptr) || !count);
+
+        if (!count)
+            return;
+
+        for (size_t i = 1; i < count; ++i) {
+            MX_DEBUG_ASSERT(sorted_elements[i - 1] != nullptr);
+            MX_DEBUG_ASSERT(sorted_elements[i] != nullptr);
+            MX_DEBUG_ASSERT(KeyTraits::LessThan(KeyTraits::GetKey(*sorted_elements[i - 1]),
+                                                KeyTraits::GetKey(*sorted_elements[i])));
+        }
+
+        left_most_  = PtrTraits::GetRaw(sorted_elements[0]);
+        right_most_ = PtrTraits::GetRaw(sorted_elements[count - 1]);
+
+        uint32_t height;
+        root_  = BuildSubtree(sorted_elements, count, sentinel(), &height);
+        count_ = count;
+
+        // Attach the left and right sentinels to the extremes of the tree.
+        NodeTraits::node_state(*left_most_).left_   = PtrTraits::MakeSentinel(this);
+        NodeTraits::node_state(*right_most_).right_ = PtrTraits::MakeSentinel(this);
+    }
+
     // pop_front and pop_back
     //
     // Removes either the left-most or right-most member of tree and transfers
@@ -306,6 +390,68 @@ public:
         return iterator(citer.node_);
     }
 
+    // select
+    //
+    // Return an iterator to the index'th smallest element in the tree (so
+    // select(0) == begin()), or end() if index >= size().  Runs in O(log)
+    // time, but is only available on trees which maintain subtree sizes.
+    const_iterator select(size_t index) const {
+        static_assert(kTrackSubtreeSizes,
+                      "select requires a node state with subtree size bookkeeping "
+                      "(see WAVLTreeSizedContainable<>)");
+        if (index >= count_)
+            return const_iterator(sentinel());
+
+        RawPtrType node = PtrTraits::GetRaw(root_);
+        while (true) {
+            MX_DEBUG_ASSERT(PtrTraits::IsValid(node));
+            auto&  ns        = NodeTraits::node_state(*node);
+            size_t left_size = SizeOps<kTrackSubtreeSizes>::Get(PtrTraits::GetRaw(ns.left_));
+
+            if (index < left_size) {
+                node = PtrTraits::GetRaw(ns.left_);
+            } else if (index == left_size) {
+                return const_iterator(node);
+            } else {
+                index -= (left_size + 1);
+                node   = PtrTraits::GetRaw(ns.right_);
+            }
+        }
+    }
+
+    iterator select(size_t index) {
+        const_iterator citer = const_cast<const ContainerType*>(this)->select(index);
+        return iterator(citer.node_);
+    }
+
+    // index_of
+    //
+    // Return the in-order rank of "obj" (which must currently be a member of
+    // this tree), such that select(index_of(obj)) refers to obj.  Runs in
+    // O(log) time, but is only available on trees which maintain subtree
+    // sizes.
+    size_t index_of(const ValueType& obj) const {
+        static_assert(kTrackSubtreeSizes,
+                      "index_of requires a node state with subtree size bookkeeping "
+                      "(see WAVLTreeSizedContainable<>)");
+        RawPtrType node = const_cast<RawPtrType>(&obj);
+        auto&      ns   = NodeTraits::node_state(*node);
+        MX_DEBUG_ASSERT(ns.InContainer());
+
+        size_t index = SizeOps<kTrackSubtreeSizes>::Get(PtrTraits::GetRaw(ns.left_));
+        while (!PtrTraits::IsSentinel(NodeTraits::node_state(*node).parent_)) {
+            RawPtrType parent    = NodeTraits::node_state(*node).parent_;
+            auto&      parent_ns = NodeTraits::node_state(*parent);
+
+            if (PtrTraits::GetRaw(parent_ns.right_) == node)
+                index += SizeOps<kTrackSubtreeSizes>::Get(PtrTraits::GetRaw(parent_ns.left_)) + 1;
+
+            node = parent;
+        }
+
+        return index;
+    }
+
     // erase
     //
     // Remove the first element in the tree whose key matches "key" and return a
@@ -663,6 +809,7 @@ private:
             right_most_ = PtrTraits::GetRaw(ptr);
 
             root_ = mxtl::move(ptr);
+            SizeOps<kTrackSubtreeSizes>::Set(left_most_, 1u);
 
             ++count_;
             Observer::RecordInsert();
@@ -738,6 +885,8 @@ private:
         MX_DEBUG_ASSERT(*owner == nullptr);
         ns.parent_ = parent;
         *owner = mxtl::move(ptr);
+        SizeOps<kTrackSubtreeSizes>::Set(PtrTraits::GetRaw(*owner), 1u);
+        SizeOps<kTrackSubtreeSizes>::IncrementPath(parent);
 
         ++count_;
         Observer::RecordInsert();
@@ -880,6 +1029,7 @@ private:
 
         // Update the count bookkeeping.
         --count_;
+        SizeOps<kTrackSubtreeSizes>::DecrementPath(parent);
         Observer::RecordErase();
 
         // Time to rebalance.  We know that we don't need to rebalance if we
@@ -955,6 +1105,116 @@ private:
         second = tmp;
     }
 
+    // The concrete node state type returned by NodeTraits, along with a
+    // compile time test for whether or not it carries subtree size
+    // bookkeeping.  DeclNodeRef is declared-but-never-defined; it exists only
+    // to provide an expression of RefType for use in the unevaluated decltype
+    // context.
+    static typename PtrTraits::RefType DeclNodeRef();
+    using NodeStateType =
+        typename remove_reference<decltype(NodeTraits::node_state(DeclNodeRef()))>::type;
+    static constexpr bool kTrackSubtreeSizes =
+        internal::WAVLTreeNodeStateHasSubtreeSize<NodeStateType>::value;
+
+    // SizeOps encapsulates all of the subtree size bookkeeping.  Call sites
+    // always use SizeOps<kTrackSubtreeSizes>; when the node state carries no
+    // subtree_size_ member, the disabled specialization is selected instead
+    // and every operation becomes a no-op which falls out of the code during
+    // template expansion.
+    template <bool Enabled, typename Dummy = void>
+    struct SizeOps {
+        static size_t Get(RawPtrType node) {
+            return PtrTraits::IsValid(node)
+                 ? NodeTraits::node_state(*node).subtree_size_
+                 : 0u;
+        }
+
+        static void Set(RawPtrType node, size_t size) {
+            NodeTraits::node_state(*node).subtree_size_ = size;
+        }
+
+        static void Recompute(RawPtrType node) {
+            auto& ns = NodeTraits::node_state(*node);
+            ns.subtree_size_ = 1u + Get(PtrTraits::GetRaw(ns.left_))
+                                  + Get(PtrTraits::GetRaw(ns.right_));
+        }
+
+        static void IncrementPath(RawPtrType node) {
+            while (PtrTraits::IsValid(node)) {
+                auto& ns = NodeTraits::node_state(*node);
+                ++ns.subtree_size_;
+                node = ns.parent_;
+            }
+        }
+
+        static void DecrementPath(RawPtrType node) {
+            while (PtrTraits::IsValid(node)) {
+                auto& ns = NodeTraits::node_state(*node);
+                MX_DEBUG_ASSERT(ns.subtree_size_ > 0u);
+                --ns.subtree_size_;
+                node = ns.parent_;
+            }
+        }
+
+        template <typename NodeState>
+        static void Swap(NodeState& ns1, NodeState& ns2) {
+            pod_swap(ns1.subtree_size_, ns2.subtree_size_);
+        }
+    };
+
+    template <typename Dummy>
+    struct SizeOps<false, Dummy> {
+        static size_t Get(RawPtrType) { return 0u; }
+        static void Set(RawPtrType, size_t) { }
+        static void Recompute(RawPtrType) { }
+        static void IncrementPath(RawPtrType) { }
+        static void DecrementPath(RawPtrType) { }
+        template <typename NodeState>
+        static void Swap(NodeState&, NodeState&) { }
+    };
+
+    // Recursively build a perfectly balanced subtree from a key-sorted array
+    // of elements, returning the root of the subtree and (via height_out) its
+    // height.  Each node is assigned rank == height, which always satisfies
+    // the WAVL rank rule for a tree built by median subdivision.  The total
+    // cost of the rank assignments is O(N); the sum of the subtree heights of
+    // a balanced tree is linear in the number of nodes.
+    PtrType BuildSubtree(PtrType* elements, size_t count, RawPtrType parent, uint32_t* height_out) {
+        MX_DEBUG_ASSERT(count > 0);
+
+        size_t  mid  = count >> 1;
+        PtrType node = mxtl::move(elements[mid]);
+        auto&   ns   = NodeTraits::node_state(*node);
+        MX_DEBUG_ASSERT(ns.IsValid() && !ns.InContainer());
+
+        RawPtrType raw = PtrTraits::GetRaw(node);
+        ns.parent_ = parent;
+
+        uint32_t left_height  = 0;
+        uint32_t right_height = 0;
+        if (mid > 0)
+            ns.left_ = BuildSubtree(elements, mid, raw, &left_height);
+        if ((count - mid - 1) > 0)
+            ns.right_ = BuildSubtree(elements + mid + 1, count - mid - 1, raw, &right_height);
+
+        // Express the rank assignment using the rank manipulation methods so
+        // that it works with both rank parity (production) and full rank
+        // (testing) storage.
+        uint32_t height = 0;
+        if (count > 1)
+            height = ((left_height > right_height) ? left_height : right_height) + 1;
+
+        ns.rank_ = 0;
+        for (uint32_t i = 0; i < height; ++i)
+            ns.promote_rank();
+
+        SizeOps<kTrackSubtreeSizes>::Set(raw, count);
+        Observer::RecordInsert();
+
+        *height_out = height;
+        return node;
+    }
+
     // Swaps the positions of two nodes, one of which is guaranteed to be a
     // right-hand descendant of the other.
     //
@@ -1001,6 +1261,7 @@ private:
         PtrTraits::Swap(ns1.left_,  ns2.left_);
         PtrTraits::Swap(ns1.right_, ns2.right_);
         pod_swap(ns1.rank_, ns2.rank_);
+        SizeOps<kTrackSubtreeSizes>::Swap(ns1, ns2);
 
         // At this point, there are two scenarios.
         //
@@ -1260,6 +1521,11 @@ private:
         Z_ns.parent_ = X;
         if (Y)
             NodeTraits::node_state(*Y).parent_ = Z;
+
+        // The rotation has not changed the membership of the subtree now
+        // rooted at X, but Z's subtree has shrunk.  Recompute bottom-up.
+        SizeOps<kTrackSubtreeSizes>::Recompute(Z);
+        SizeOps<kTrackSubtreeSizes>::Recompute(X);
     }
 
     // PostInsertFixupLR<LRTraits>
@@ -0,0 +1,179 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/assert.h>
+#include <magenta/compiler.h>
+#include <mxtl/atomic.h>
+#include <mxtl/macros.h>
+
+#if _KERNEL
+#include <kernel/thread.h>
+#else
+#include <threads.h>
+#endif
+
+namespace mxtl {
+namespace internal {
+
+// An opaque token identifying the calling thread, used to decide whether a
+// reference count operation may take the biased (non-atomic) fast path.
+#if _KERNEL
+inline uintptr_t current_thread_token() {
+    return reinterpret_cast<uintptr_t>(get_current_thread());
+}
+#else
+inline uintptr_t current_thread_token() {
+    return static_cast<uintptr_t>(thrd_current());
+}
+#endif
+
+// Thread-biased variant of RefCountedBase.
+//
+// The thread which constructs the object becomes its bias owner.  AddRef() and
+// Release() calls made by the owner manipulate a plain, non-atomic counter; all
+// other threads share a single atomic counter.  The object is destroyed when
+// both counters have drained, which is detected without ever requiring the two
+// to be read together: the shared counter is allowed to go negative while the
+// bias is in place, and the final transition is keyed off a merge flag which is
+// set exactly once, when the owner drops its last biased reference (or
+// explicitly calls MergeBias()).
+//
+// This removes an atomic RMW from every acquire/release pair performed on the
+// owning thread, but it comes with two structural constraints which callers
+// must respect:
+//
+//  1) The owning thread must merge the bias (by releasing every reference it
+//     acquired, or by calling MergeBias()) before it exits.  A stale owner
+//     token could otherwise alias a later thread.
+//
+//  2) References acquired on the owning thread and released on another thread
+//     keep the biased counter elevated until the owner merges; the object's
+//     destruction is deferred accordingly (it is never destroyed early, but it
+//     can be destroyed late).
+//
+// In short: bias only objects whose references are overwhelmingly acquired and
+// released on a single thread.  Objects whose references routinely migrate
+// between threads should use the plain atomic RefCountedBase instead.
+class RefCountedBiasedBase {
+protected:
+    RefCountedBiasedBase()
+        : owner_(current_thread_token()), shared_count_(0) {}
+    ~RefCountedBiasedBase() {}
+
+    void AddRef() {
+        MX_DEBUG_ASSERT_COND(adopted_);
+        if (owner_.load(memory_order_relaxed) == current_thread_token()) {
+            // Only the owner ever touches biased_count_, so a plain
+            // increment is sufficient.
+            ++biased_count_;
+        } else {
+            shared_count_.fetch_add(kCountOne, memory_order_relaxed);
+        }
+    }
+
+    // Returns true if the object should self-delete.
+    bool Release() __WARN_UNUSED_RESULT {
+        MX_DEBUG_ASSERT_COND(adopted_);
+        if (owner_.load(memory_order_relaxed) == current_thread_token()) {
+            MX_DEBUG_ASSERT(biased_count_ > 0);
+            if (--biased_count_ > 0)
+                return false;
+            // That was the last biased reference; fold the (now zero) biased
+            // count into the shared counter and give up the bias.
+            return MergeLocked(0);
+        }
+
+        // Note: the shared counter may legitimately go negative here if the
+        // reference being dropped was acquired on the owning thread.  The
+        // object is only destroyed once the merge flag is set and the count
+        // component has returned to zero.
+        int prev = shared_count_.fetch_sub(kCountOne, memory_order_release);
+        if (prev - kCountOne == kMergedFlag) {
+            atomic_thread_fence(memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+    // Transfers any outstanding biased references to the shared counter and
+    // revokes the bias, after which all threads (including the former owner)
+    // use the atomic path.  Must be called from the owning thread, while the
+    // caller holds at least one reference; calls from other threads (or after
+    // the bias has already been merged) are no-ops.
+    void MergeBias() {
+        if (owner_.load(memory_order_relaxed) != current_thread_token())
+            return;
+        MX_DEBUG_ASSERT(biased_count_ > 0);
+        int count = biased_count_;
+        biased_count_ = 0;
+        bool release = MergeLocked(count);
+        // The caller holds a reference, so the merge cannot observe a zero
+        // total count.
+        MX_DEBUG_ASSERT(!release);
+    }
+
+#if MX_DEBUG_ASSERT_IMPLEMENTED
+    void Adopt() {
+        MX_DEBUG_ASSERT(!adopted_);
+        adopted_ = true;
+    }
+#endif
+
+private:
+    // The shared counter packs a signed reference count (in units of
+    // kCountOne) together with a flag recording that the bias has been merged.
+    // Additions and subtractions of kCountOne never disturb the flag bit.
+    static constexpr int kMergedFlag = 1;
+    static constexpr int kCountOne = 2;
+
+    // Folds |count| biased references into the shared counter, sets the merge
+    // flag and clears the owner token.  Returns true if the total reference
+    // count was observed to hit zero (the object should self-delete).
+    bool MergeLocked(int count) {
+        owner_.store(0u, memory_order_relaxed);
+        int delta = count * kCountOne + kMergedFlag;
+        int prev = shared_count_.fetch_add(delta, memory_order_release);
+        if (prev + delta == kMergedFlag) {
+            atomic_thread_fence(memory_order_acquire);
+            return true;
+        }
+        return false;
+    }
+
+    // Token of the bias-owning thread; 0 once the bias has been merged.
+    mxtl::atomic_uintptr_t owner_;
+    // Owner-thread reference count; only ever touched by the owning thread.
+    // Starts at 1, matching the adoption model of RefCountedBase.
+    int biased_count_ = 1;
+    mxtl::atomic_int shared_count_;
+#if MX_DEBUG_ASSERT_IMPLEMENTED
+    bool adopted_ = false;
+#endif
+};
+
+}  // namespace internal
+
+// Drop-in alternative to RefCounted<T> for types whose reference traffic is
+// dominated by a single thread.  See internal::RefCountedBiasedBase for the
+// constraints which apply; most types should continue to use RefCounted<T>.
+template <typename T>
+class RefCountedBiased : public internal::RefCountedBiasedBase {
+public:
+    RefCountedBiased() {}
+    ~RefCountedBiased() {}
+
+    using internal::RefCountedBiasedBase::AddRef;
+    using internal::RefCountedBiasedBase::Release;
+    using internal::RefCountedBiasedBase::MergeBias;
+#if MX_DEBUG_ASSERT_IMPLEMENTED
+    using internal::RefCountedBiasedBase::Adopt;
+#endif
+
+    // RefCountedBiased<> instances may not be copied, assigned or moved.
+    DISALLOW_COPY_ASSIGN_AND_MOVE(RefCountedBiased);
+};
+
+}  // namespace mxtl
@@ -0,0 +1,206 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <mxtl/intrusive_hash_table.h>
+#include <mxtl/macros.h>
+#include <mxtl/mutex.h>
+
+namespace mxtl {
+
+// ShardedHashTable is a concurrency wrapper around kNumShards independent
+// HashTables, each protected by its own lock.  Keys are spread across the
+// shards by a second level of the hash, so operations on different keys
+// mostly take different locks and read-mostly tables stop serializing on a
+// single table-wide mutex.
+//
+// Because the table is internally locked, it cannot hand out iterators or
+// references; keyed operations return a fresh copy of the stored pointer
+// instead (an additional reference for RefPtr tables, a plain copy for
+// unmanaged pointer tables, where the caller remains responsible for the
+// object's lifetime).  Cross-shard aggregates (size_slow, is_empty, clear)
+// take the shard locks one at a time and are correspondingly only
+// approximate when run concurrently with writers.
+//
+// The template arguments mirror HashTable's, with the shard count and the
+// lock type appended.  LockType must expose Acquire/Release in the style
+// of mxtl::Mutex; substituting mxtl::NullLock recovers an externally
+// locked table for single threaded use.
+
+// DefaultShardTraits spreads keys across shards using the same
+// ObjType::GetHash convention as DefaultHashTraits.  The per-shard tables
+// consume the hash modulo their bucket count, so the shard selector
+// divides the bucket count out first to keep the two indices from
+// correlating.  Users whose hash functions are too weak for this (or who
+// can pick a shard more cheaply) can supply their own traits; the only
+// requirement is a static GetShard returning a value on the range
+// [0, kNumShards - 1].
+template <typename KeyType,
+          typename ObjType,
+          typename HashType,
+          HashType kNumBuckets,
+          size_t kNumShards>
+struct DefaultShardTraits {
+    static size_t GetShard(const KeyType& key) {
+        return static_cast<size_t>((ObjType::GetHash(key) / kNumBuckets) % kNumShards);
+    }
+};
+
+template <typename  _KeyType,
+          typename  _PtrType,
+          typename  _BucketType  = SinglyLinkedList<_PtrType>,
+          typename  _HashType    = size_t,
+          _HashType _NumBuckets  = 37,
+          size_t    _NumShards   = 16,
+          typename  _LockType    = ::mxtl::Mutex,
+          typename  _KeyTraits   = DefaultKeyedObjectTraits<
+                                     _KeyType,
+                                     typename internal::ContainerPtrTraits<_PtrType>::ValueType>,
+          typename  _HashTraits  = DefaultHashTraits<
+                                     _KeyType,
+                                     typename internal::ContainerPtrTraits<_PtrType>::ValueType,
+                                     _HashType,
+                                     _NumBuckets>,
+          typename  _ShardTraits = DefaultShardTraits<
+                                     _KeyType,
+                                     typename internal::ContainerPtrTraits<_PtrType>::ValueType,
+                                     _HashType,
+                                     _NumBuckets,
+                                     _NumShards>>
+class ShardedHashTable {
+public:
+    using TableType = HashTable<_KeyType, _PtrType, _BucketType,
+                                _HashType, _NumBuckets, _KeyTraits, _HashTraits>;
+
+    // Pointer types/traits
+    using PtrType      = _PtrType;
+    using PtrTraits    = internal::ContainerPtrTraits<PtrType>;
+    using ValueType    = typename PtrTraits::ValueType;
+    using RawPtrType   = typename PtrTraits::RawPtrType;
+
+    // Key types/traits
+    using KeyType      = _KeyType;
+    using KeyTraits    = _KeyTraits;
+    using ShardTraits  = _ShardTraits;
+    using LockType     = _LockType;
+
+    static constexpr size_t kNumShards = _NumShards;
+    static_assert(kNumShards > 0, "Hash tables must have at least one shard");
+
+    constexpr ShardedHashTable() {}
+    ~ShardedHashTable() {}
+
+    void insert(const PtrType& ptr) { insert(PtrType(ptr)); }
+    void insert(PtrType&& ptr) {
+        Shard& shard = GetShard(KeyTraits::GetKey(*ptr));
+        AutoShardLock guard(&shard.lock);
+        shard.table.insert(mxtl::move(ptr));
+    }
+
+    // Insert |ptr| if no entry with the same key exists; otherwise leave
+    // the table unmodified.  Returns true if the insert took place.  If
+    // |collided| is non-null, it receives a copy of the colliding entry's
+    // pointer on failure (and is left untouched on success).
+    bool insert_or_find(const PtrType& ptr, PtrType* collided = nullptr) {
+        return insert_or_find(PtrType(ptr), collided);
+    }
+    bool insert_or_find(PtrType&& ptr, PtrType* collided = nullptr) {
+        Shard& shard = GetShard(KeyTraits::GetKey(*ptr));
+        AutoShardLock guard(&shard.lock);
+        typename TableType::iterator iter;
+        if (shard.table.insert_or_find(mxtl::move(ptr), &iter))
+            return true;
+        if (collided)
+            *collided = CopyPointer(iter);
+        return false;
+    }
+
+    // Return a copy of the entry matching |key|, or a null pointer if
+    // there is none.
+    PtrType find(const KeyType& key) {
+        Shard& shard = GetShard(key);
+        AutoShardLock guard(&shard.lock);
+        auto iter = shard.table.find(key);
+        return iter.IsValid() ? CopyPointer(iter) : PtrType(nullptr);
+    }
+
+    // Remove and return the entry matching |key|, or a null pointer if
+    // there is none.
+    PtrType erase(const KeyType& key) {
+        Shard& shard = GetShard(key);
+        AutoShardLock guard(&shard.lock);
+        return shard.table.erase(key);
+    }
+
+    PtrType erase(ValueType& obj) {
+        Shard& shard = GetShard(KeyTraits::GetKey(obj));
+        AutoShardLock guard(&shard.lock);
+        return shard.table.erase(obj);
+    }
+
+    // Note: when writers are running concurrently, these report a state
+    // the table passed through, not necessarily its state at return.
+    size_t size_slow() const {
+        size_t size = 0;
+        for (auto& shard : shards_) {
+            AutoShardLock guard(&shard.lock);
+            size += shard.table.size();
+        }
+        return size;
+    }
+
+    bool is_empty() const {
+        for (auto& shard : shards_) {
+            AutoShardLock guard(&shard.lock);
+            if (!shard.table.is_empty())
+                return false;
+        }
+        return true;
+    }
+
+    void clear() {
+        for (auto& shard : shards_) {
+            AutoShardLock guard(&shard.lock);
+            shard.table.clear();
+        }
+    }
+
+    // ShardedHashTables, like the HashTables they wrap, are neither
+    // copyable nor movable.
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ShardedHashTable);
+
+private:
+    // A scoped guard in the style of mxtl::AutoLock, but generic over any
+    // lock exposing Acquire/Release so alternate LockTypes work too.
+    class __TA_SCOPED_CAPABILITY AutoShardLock {
+    public:
+        explicit AutoShardLock(LockType* lock) __TA_ACQUIRE(lock)
+            : lock_(lock) { lock_->Acquire(); }
+        ~AutoShardLock() __TA_RELEASE() { lock_->Release(); }
+        DISALLOW_COPY_ASSIGN_AND_MOVE(AutoShardLock);
+    private:
+        LockType* lock_;
+    };
+
+    struct Shard {
+        mutable LockType lock;
+        TableType table;
+    };
+
+    Shard& GetShard(const KeyType& key) {
+        size_t ndx = ShardTraits::GetShard(key);
+        MX_DEBUG_ASSERT(ndx < kNumShards);
+        return shards_[ndx];
+    }
+
+    static PtrType CopyPointer(typename TableType::iterator& iter) {
+        RawPtrType raw = &(*iter);
+        return PtrTraits::Copy(raw);
+    }
+
+    Shard shards_[kNumShards];
+};
+
+}  // namespace mxtl
@@ -16,6 +16,13 @@
 #include <mxtl/type_support.h>
 #include <mxtl/unique_ptr.h>
 
+#if _KERNEL
+#include <arch/ops.h>
+#include <kernel/spinlock.h>
+#else
+#include <mxtl/atomic.h>
+#endif
+
 // Demand that the project using us has a definition of the
 // bring-your-own-memory, non-array, placement new operator.  We don't want to
 // demand a specific implementation, just that one exists.
@@ -86,6 +93,28 @@ void* operator new(size_t sz, void *ptr);
 // UnlockedInstancedSlabAllocatorTraits or UnlockedStaticSlabAllocatorTraits may
 // be used as a shorthand for this.
 //
+// :: Local cache tier ::
+//
+// Allocators whose traits set the ENABLE_LOCAL_CACHE flag maintain a small
+// second tier of free objects in front of the shared free list.  In the kernel
+// the tier is a set of per-CPU free lists accessed with interrupts disabled
+// (and therefore without taking the allocator's lock); in user-mode it is a
+// set of per-thread free lists (threads are assigned slots round-robin, so
+// when there are more threads than slots some threads share a slot and
+// briefly spin).
+//
+// Allocations are served from the local list when possible and frees are
+// parked there.  The shared lock is only taken when the local list runs dry
+// (a batch of objects is pulled over in a single acquisition) or overflows (a
+// batch is pushed back in a single acquisition), so back-to-back
+// allocate/free cycles on a hot path do not contend with other CPUs/threads
+// at all.  LocalCachedSlabAllocatorTraits and
+// LocalCachedStaticSlabAllocatorTraits are provided as shorthand.
+//
+// Note that objects parked in a local cache count against the allocator's
+// slab quota exactly like objects on the shared free list; the flag changes
+// contention behavior, not memory limits.
+//
 // ** Example **
 //
 // using MyAllocatorTraits =
@@ -287,7 +316,8 @@ enum class SlabAllocatorFlavor {
 template <typename T,
           size_t   SLAB_SIZE,
           typename LockType,
-          SlabAllocatorFlavor AllocatorFlavor> struct SlabAllocatorTraits;
+          SlabAllocatorFlavor AllocatorFlavor,
+          bool     ENABLE_LOCAL_CACHE> struct SlabAllocatorTraits;
 template <typename SATraits, typename = void> class SlabAllocator;
 template <typename SATraits, typename = void> class SlabAllocated;
 
@@ -351,6 +381,193 @@ struct SlabOriginSetter<SATraits,
                                  internal::SlabAllocator<SATraits>* origin) { }
 };
 
+// Free object memory parked in a local cache is chained through this instead
+// of through a FreeListEntry; object memory is always at least pointer sized.
+struct SlabLocalCacheEntry {
+    SlabLocalCacheEntry* next;
+};
+
+// Default (disabled) local cache tier.  Every operation is a no-op which the
+// compiler folds away, so allocate and free go straight to the shared lock,
+// exactly as if the tier did not exist.
+template <typename SATraits, typename = void>
+class SlabLocalCache {
+public:
+    using Entry = SlabLocalCacheEntry;
+    static constexpr size_t EXCHANGE_COUNT = 0;
+
+    void*  Pop()                    { return nullptr; }
+    bool   Push(void* ptr)          { return false; }
+    Entry* Drain(size_t* count_out) { *count_out = 0; return nullptr; }
+    void   Fill(Entry*, size_t)     { }
+    Entry* DrainAll()               { return nullptr; }
+};
+
+// Enabled local cache tier; see the usage notes at the top of the file.  A
+// fixed array of slots, each holding a short free list of object memory.  In
+// the kernel slots belong to CPUs; in user-mode they are handed out to
+// threads round-robin.
+template <typename SATraits>
+class SlabLocalCache<SATraits,
+                     typename enable_if<SATraits::ENABLE_LOCAL_CACHE>::type> {
+public:
+    using Entry = SlabLocalCacheEntry;
+
+    // Maximum number of objects parked in each slot, and the number of
+    // objects moved to/from the shared free list in a single lock acquisition
+    // when a slot runs dry or overflows.
+    static constexpr size_t CACHE_DEPTH    = 16;
+    static constexpr size_t EXCHANGE_COUNT = CACHE_DEPTH / 2;
+
+    // Takes one object from the local slot, or returns nullptr if it is
+    // empty.
+    void* Pop() {
+        SlotGuard guard(this);
+        Slot* slot = guard.slot();
+
+        Entry* entry = slot->head;
+        if (entry == nullptr)
+            return nullptr;
+
+        slot->head = entry->next;
+        slot->count--;
+        return entry;
+    }
+
+    // Parks ptr in the local slot.  Refuses (returns false) when the slot is
+    // full; the caller is expected to Drain a batch back to the shared free
+    // list instead.
+    bool Push(void* ptr) {
+        SlotGuard guard(this);
+        Slot* slot = guard.slot();
+
+        if (slot->count >= CACHE_DEPTH)
+            return false;
+
+        Entry* entry = new (ptr) Entry{slot->head};
+        slot->head = entry;
+        slot->count++;
+        return true;
+    }
+
+    // Detaches up to EXCHANGE_COUNT entries from the local slot and returns
+    // them as a chain for the caller to give back to the shared free list.
+    Entry* Drain(size_t* count_out) {
+        SlotGuard guard(this);
+        Slot* slot = guard.slot();
+
+        Entry* chain = nullptr;
+        size_t count = 0;
+        while ((slot->head != nullptr) && (count < EXCHANGE_COUNT)) {
+            Entry* entry = slot->head;
+            slot->head = entry->next;
+            slot->count--;
+
+            entry->next = chain;
+            chain = entry;
+            count++;
+        }
+
+        *count_out = count;
+        return chain;
+    }
+
+    // Splices a chain of count entries (fresh from the shared free list) into
+    // the local slot.
+    void Fill(Entry* chain, size_t count) {
+        SlotGuard guard(this);
+        Slot* slot = guard.slot();
+
+        Entry* tail = chain;
+        while (tail->next != nullptr)
+            tail = tail->next;
+
+        tail->next = slot->head;
+        slot->head = chain;
+        slot->count += count;
+    }
+
+    // Detaches everything from every slot.  Only used at destruction time,
+    // when no one else can possibly be touching the allocator, so no slot
+    // protection is needed.
+    Entry* DrainAll() {
+        Entry* chain = nullptr;
+        for (size_t i = 0; i < NUM_SLOTS; ++i) {
+            while (slots_[i].head != nullptr) {
+                Entry* entry = slots_[i].head;
+                slots_[i].head = entry->next;
+
+                entry->next = chain;
+                chain = entry;
+            }
+            slots_[i].count = 0;
+        }
+        return chain;
+    }
+
+private:
+    struct Slot {
+        Entry* head  = nullptr;
+        size_t count = 0;
+#if !_KERNEL
+        atomic<uint32_t> busy { 0 };
+#endif
+    };
+
+#if _KERNEL
+    static constexpr size_t NUM_SLOTS = SMP_MAX_CPUS;
+
+    // Slots belong to CPUs.  Disabling interrupts pins us to the current CPU
+    // and keeps everyone else on this CPU off of its slot, so no lock (and no
+    // cross-CPU cache line traffic) is needed.
+    class SlotGuard {
+    public:
+        explicit SlotGuard(SlabLocalCache* cache) {
+            arch_interrupt_save(&state_, SPIN_LOCK_FLAG_INTERRUPTS);
+            slot_ = &cache->slots_[arch_curr_cpu_num()];
+        }
+
+        ~SlotGuard() {
+            arch_interrupt_restore(state_, SPIN_LOCK_FLAG_INTERRUPTS);
+        }
+
+        Slot* slot() { return slot_; }
+
+    private:
+        Slot* slot_;
+        spin_lock_saved_state_t state_;
+    };
+#else
+    static constexpr size_t NUM_SLOTS = 16;
+
+    // Slots are assigned to threads round-robin on first use.  With more
+    // threads than slots some threads share a slot, so each slot carries a
+    // tiny spin lock; it is uncontended whenever a slot has a single owner.
+    class SlotGuard {
+    public:
+        explicit SlotGuard(SlabLocalCache* cache) {
+            static atomic<size_t> next_slot { 0 };
+            thread_local size_t slot_index =
+                next_slot.fetch_add(1, memory_order_relaxed) % NUM_SLOTS;
+
+            slot_ = &cache->slots_[slot_index];
+            while (slot_->busy.exchange(1u, memory_order_acquire) != 0u) { }
+        }
+
+        ~SlotGuard() {
+            slot_->busy.store(0u, memory_order_release);
+        }
+
+        Slot* slot() { return slot_; }
+
+    private:
+        Slot* slot_;
+    };
+#endif
+
+    Slot slots_[NUM_SLOTS];
+};
+
 // Non-templated SlabAllocatorBase.  Any code which does not strictly depend on
 // trait/type awareness lives here in order to minimize code size explosion due
 // to template expansion.
@@ -434,17 +651,23 @@ public:
     size_t max_slabs() const { return max_slabs_; }
 
 protected:
+    void* TakeFromFreeListLocked() {
+        if (free_list_.is_empty())
+            return nullptr;
+        dec_free_list_size();
+        return free_list_.pop_front();
+    }
+
     void* AllocateLocked() {
         // If we can alloc from the free list, do so.
-        if (!free_list_.is_empty()) {
-            dec_free_list_size();
-            return free_list_.pop_front();
-        }
+        void* mem = TakeFromFreeListLocked();
+        if (mem != nullptr)
+            return mem;
 
         // If we can allocate from the currently active slab, do so.
         if (!slab_list_.is_empty()) {
             auto& active_slab = slab_list_.front();
-            void* mem = active_slab.Allocate(alloc_size_, slab_storage_limit_);
+            mem = active_slab.Allocate(alloc_size_, slab_storage_limit_);
             if (mem)
                 return mem;
         }
@@ -541,8 +764,6 @@ public:
                             max_slabs,
                             alloc_initial) { }
 
-    ~SlabAllocator() { }
-
     template <typename... ConstructorSignature>
     PtrType New(ConstructorSignature&&... args) {
         void* mem = Allocate();
@@ -571,24 +792,81 @@ public:
         return PtrTraits::CreatePtr(obj);
     }
 
+    ~SlabAllocator() {
+        // Give everything parked in the local cache tier back to the shared
+        // free list before the base class audits it.  No locking is needed;
+        // we are being destroyed, so no one else knows about us any more.
+        auto chain = local_cache_.DrainAll();
+        while (chain != nullptr) {
+            auto next = chain->next;
+            ReturnToFreeListLocked(chain);
+            chain = next;
+        }
+    }
+
 protected:
     friend class ::mxtl::SlabAllocator<SATraits>;
     friend class ::mxtl::SlabAllocated<SATraits>;
 
+    using CacheType = SlabLocalCache<SATraits>;
+
     void* Allocate() {
-        AutoLock alloc_lock(&this->alloc_lock_);
-        return AllocateLocked();
+        // Alloc from the local cache tier (if enabled) without taking the
+        // shared lock.
+        void* mem = local_cache_.Pop();
+        if (mem != nullptr)
+            return mem;
+
+        typename CacheType::Entry* chain = nullptr;
+        size_t count = 0;
+        {
+            AutoLock alloc_lock(&this->alloc_lock_);
+            mem = AllocateLocked();
+
+            // On a local cache miss, pull a batch of entries over from the
+            // shared free list in the same lock acquisition so that the next
+            // few allocations do not need to come back here.
+            if (mem != nullptr) {
+                while (count < CacheType::EXCHANGE_COUNT) {
+                    void* extra = TakeFromFreeListLocked();
+                    if (extra == nullptr)
+                        break;
+                    chain = new (extra) typename CacheType::Entry{chain};
+                    count++;
+                }
+            }
+        }
+
+        if (chain != nullptr)
+            local_cache_.Fill(chain, count);
+
+        return mem;
     }
 
     void ReturnToFreeList(void* ptr) {
-        FreeListEntry* free_obj = new (ptr) FreeListEntry;
+        // Park the object in the local cache tier (if enabled) without taking
+        // the shared lock.
+        if (local_cache_.Push(ptr))
+            return;
+
+        // The local slot is full (or caching is disabled); push this object,
+        // along with a batch drained from the local slot, back to the shared
+        // free list in a single lock acquisition.
+        size_t count;
+        auto chain = local_cache_.Drain(&count);
         {
             AutoLock alloc_lock(&alloc_lock_);
-            ReturnToFreeListLocked(free_obj);
+            ReturnToFreeListLocked(ptr);
+            while (chain != nullptr) {
+                auto next = chain->next;
+                ReturnToFreeListLocked(chain);
+                chain = next;
+            }
         }
     }
 
     typename SATraits::LockType alloc_lock_;
+    CacheType local_cache_;
 };
 }  // namespace internal
 
@@ -630,11 +908,18 @@ protected:
 //     the object to the allocator it came from.  MANUAL_DELETE allocators are
 //     only permitted for unmanaged pointer types.
 //
+// ++ ENABLE_LOCAL_CACHE
+//  When true, maintains a per-CPU (kernel) / per-thread (user-mode) cache
+//  tier in front of the shared free list so that hot allocate/free paths do
+//  not take the allocator's lock.  See the "Local cache tier" section of the
+//  usage notes, above.
+//
 ////////////////////////////////////////////////////////////////////////////////
 template <typename T,
           size_t   _SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
           typename _LockType  = ::mxtl::Mutex,
-          SlabAllocatorFlavor _AllocatorFlavor = SlabAllocatorFlavor::INSTANCED>
+          SlabAllocatorFlavor _AllocatorFlavor = SlabAllocatorFlavor::INSTANCED,
+          bool     _ENABLE_LOCAL_CACHE = false>
 struct SlabAllocatorTraits {
     using PtrTraits     = internal::SlabAllocatorPtrTraits<T>;
     using PtrType       = typename PtrTraits::PtrType;
@@ -643,6 +928,7 @@ struct SlabAllocatorTraits {
 
     static constexpr size_t SLAB_SIZE = _SLAB_SIZE;
     static constexpr SlabAllocatorFlavor AllocatorFlavor = _AllocatorFlavor;
+    static constexpr bool ENABLE_LOCAL_CACHE = _ENABLE_LOCAL_CACHE;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -775,6 +1061,14 @@ template <typename T,
 using UnlockedManualDeleteSlabAllocatorTraits =
     SlabAllocatorTraits<T, SLAB_SIZE, ::mxtl::NullLock, SlabAllocatorFlavor::MANUAL_DELETE>;
 
+// Shorthand for declaring the properties of an instanced allocator with the
+// local cache tier enabled.
+template <typename T,
+          size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
+          typename LockType  = ::mxtl::Mutex>
+using LocalCachedSlabAllocatorTraits =
+    SlabAllocatorTraits<T, SLAB_SIZE, LockType, SlabAllocatorFlavor::INSTANCED, true>;
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Implementation of a static slab allocator.
@@ -846,6 +1140,14 @@ template <typename T,
 using UnlockedStaticSlabAllocatorTraits =
     SlabAllocatorTraits<T, SLAB_SIZE, ::mxtl::NullLock, SlabAllocatorFlavor::STATIC>;
 
+// Shorthand for declaring the properties of a static allocator with the local
+// cache tier enabled.
+template <typename T,
+          size_t   SLAB_SIZE = DEFAULT_SLAB_ALLOCATOR_SLAB_SIZE,
+          typename LockType  = ::mxtl::Mutex>
+using LocalCachedStaticSlabAllocatorTraits =
+    SlabAllocatorTraits<T, SLAB_SIZE, LockType, SlabAllocatorFlavor::STATIC, true>;
+
 // Shorthand for declaring the global storage required for a static allocator
 #define DECLARE_STATIC_SLAB_ALLOCATOR_STORAGE(ALLOC_TRAITS, ...) \
 template<> ::mxtl::SlabAllocator<ALLOC_TRAITS>::InternalAllocatorType \
@@ -0,0 +1,119 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <string.h>
+
+#include <magenta/assert.h>
+#include <mxtl/macros.h>
+#include <mxtl/string_piece.h>
+
+namespace mxtl {
+
+// A growable, always NUL-terminated string which stores short strings (up to
+// kInlineCapacity characters) directly inside the object instead of on the
+// heap.  Paths, device names and similar short strings fit in the inline
+// storage and never touch malloc; longer strings transparently spill to a heap
+// buffer.
+//
+// Because we build with exceptions disabled, the operations which may need to
+// allocate (Set and Append) report failure by returning false, leaving the
+// string unchanged.  SmallString is move-only; an explicit Set from another
+// string's piece() is the way to make a copy.
+class SmallString {
+public:
+    // Strings of up to kInlineCapacity characters (not counting the
+    // terminating NUL) are stored inline.
+    static constexpr size_t kInlineCapacity = 23u;
+
+    SmallString() { inline_[0] = 0; }
+    ~SmallString();
+
+    SmallString(SmallString&& other) { MoveFrom(&other); }
+    SmallString& operator=(SmallString&& other) {
+        if (this != &other) {
+            Reset();
+            MoveFrom(&other);
+        }
+        return *this;
+    }
+
+    // move semantics only
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(SmallString);
+
+    size_t length() const { return length_; }
+    bool  empty()  const { return length_ == 0; }
+
+    // The returned string is always NUL-terminated.
+    const char* data()  const { return is_inline() ? inline_ : heap_; }
+    const char* c_str() const { return data(); }
+
+    char operator[](size_t i) const {
+        MX_DEBUG_ASSERT(i < length_);
+        return data()[i];
+    }
+
+    StringPiece piece() const { return StringPiece(data(), length_); }
+
+    // Reset the string to empty, retaining any heap buffer already allocated.
+    void clear() {
+        length_ = 0;
+        MutableData()[0] = 0;
+    }
+
+    // Replace the contents of the string.  On allocation failure, return false
+    // and leave the string unchanged.
+    bool Set(const char* str, size_t len);
+    bool Set(const char* str) { return Set(str, (str == nullptr) ? 0u : strlen(str)); }
+    bool Set(const StringPiece& piece) { return Set(piece.data(), piece.length()); }
+
+    // Append to the string.  On allocation failure, return false and leave the
+    // string unchanged.
+    bool Append(const char* str, size_t len);
+    bool Append(const char* str) { return Append(str, (str == nullptr) ? 0u : strlen(str)); }
+    bool Append(const StringPiece& piece) { return Append(piece.data(), piece.length()); }
+    bool Append(char c) { return Append(&c, 1u); }
+
+    int compare(const SmallString& other) const { return piece().compare(other.piece()); }
+    int compare(const StringPiece& other) const { return piece().compare(other); }
+
+    void swap(SmallString& other);
+
+private:
+    bool is_inline() const { return capacity_ == kInlineCapacity; }
+    char* MutableData() { return is_inline() ? inline_ : heap_; }
+
+    // Grow the backing store (if needed) so that it can hold a string of
+    // new_length characters plus the terminating NUL.
+    bool EnsureCapacity(size_t new_length);
+
+    // Free any heap buffer and return to the empty, inline state.
+    void Reset();
+
+    // Steal the contents of other, which must not be this, leaving it empty.
+    void MoveFrom(SmallString* other);
+
+    size_t length_   = 0;
+    size_t capacity_ = kInlineCapacity;
+    union {
+        char  inline_[kInlineCapacity + 1];
+        char* heap_;
+    };
+};
+
+inline bool operator==(const SmallString& lhs, const SmallString& rhs) {
+    return lhs.piece() == rhs.piece();
+}
+
+inline bool operator!=(const SmallString& lhs, const SmallString& rhs) {
+    return lhs.piece() != rhs.piece();
+}
+
+inline bool operator==(const SmallString& lhs, const StringPiece& rhs) { return lhs.piece() == rhs; }
+inline bool operator!=(const SmallString& lhs, const StringPiece& rhs) { return lhs.piece() != rhs; }
+inline bool operator==(const StringPiece& lhs, const SmallString& rhs) { return lhs == rhs.piece(); }
+inline bool operator!=(const StringPiece& lhs, const SmallString& rhs) { return lhs != rhs.piece(); }
+
+}  // namespace mxtl
@@ -0,0 +1,208 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <string.h>
+
+#include <magenta/assert.h>
+#include <mxalloc/new.h>
+#include <mxtl/macros.h>
+#include <mxtl/type_support.h>
+
+// Demand that the project using us has a definition of the
+// bring-your-own-memory, non-array, placement new operator.  We don't want to
+// demand a specific implementation, just that one exists.
+void* operator new(size_t sz, void *ptr);
+
+namespace mxtl {
+
+// A dynamic array which stores its first InlineCount elements directly inside
+// the object instead of on the heap.  Collections which are almost always
+// small (argument lists, path segments, watcher lists and the like) stay
+// entirely out of malloc; larger collections transparently spill to a heap
+// buffer which grows geometrically.
+//
+// Because we build with exceptions disabled, the operations which may need to
+// allocate (push_back and reserve) report failure by returning false, leaving
+// the vector unchanged.  SmallVector is move-only and requires T to be
+// move-constructible.
+template <typename T, size_t InlineCount = 4>
+class SmallVector {
+public:
+    static_assert(InlineCount > 0, "SmallVector requires at least one inline element");
+
+    static constexpr size_t kInlineCount = InlineCount;
+
+    SmallVector() : ptr_(inline_storage()) { }
+
+    ~SmallVector() {
+        DestroyElements();
+        if (!is_inline())
+            delete[] reinterpret_cast<Block*>(ptr_);
+    }
+
+    SmallVector(SmallVector&& other) : ptr_(inline_storage()) {
+        MoveFrom(&other);
+    }
+
+    SmallVector& operator=(SmallVector&& other) {
+        if (this != &other) {
+            DestroyElements();
+            if (!is_inline()) {
+                delete[] reinterpret_cast<Block*>(ptr_);
+                ptr_      = inline_storage();
+                capacity_ = InlineCount;
+            }
+            MoveFrom(&other);
+        }
+        return *this;
+    }
+
+    // move semantics only
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(SmallVector);
+
+    size_t size()     const { return count_; }
+    size_t capacity() const { return capacity_; }
+    bool   is_empty() const { return count_ == 0; }
+
+    T*       begin()       { return ptr_; }
+    const T* begin() const { return ptr_; }
+    T*       end()         { return ptr_ + count_; }
+    const T* end()   const { return ptr_ + count_; }
+
+    T& operator[](size_t i) {
+        MX_DEBUG_ASSERT(i < count_);
+        return ptr_[i];
+    }
+
+    const T& operator[](size_t i) const {
+        MX_DEBUG_ASSERT(i < count_);
+        return ptr_[i];
+    }
+
+    T& front() {
+        MX_DEBUG_ASSERT(count_ > 0);
+        return ptr_[0];
+    }
+
+    T& back() {
+        MX_DEBUG_ASSERT(count_ > 0);
+        return ptr_[count_ - 1];
+    }
+
+    // Append an element.  On allocation failure, return false and leave the
+    // vector unchanged.
+    bool push_back(T&& element) {
+        if ((count_ == capacity_) && !Grow(capacity_ * 2u))
+            return false;
+
+        new (&ptr_[count_]) T(mxtl::move(element));
+        ++count_;
+        return true;
+    }
+
+    bool push_back(const T& element) {
+        if ((count_ == capacity_) && !Grow(capacity_ * 2u))
+            return false;
+
+        new (&ptr_[count_]) T(element);
+        ++count_;
+        return true;
+    }
+
+    // Remove and return the last element.  It is an error to call pop_back on
+    // an empty vector.
+    T pop_back() {
+        MX_DEBUG_ASSERT(count_ > 0);
+        T ret(mxtl::move(ptr_[count_ - 1]));
+        ptr_[--count_].~T();
+        return ret;
+    }
+
+    // Grow the backing store (if needed) so that it can hold at least new_capacity
+    // elements without further allocation.
+    bool reserve(size_t new_capacity) {
+        return (new_capacity <= capacity_) || Grow(new_capacity);
+    }
+
+    // Destroy all of the elements, retaining any heap buffer already
+    // allocated.
+    void clear() {
+        DestroyElements();
+    }
+
+private:
+    // Uninitialized, properly aligned storage for a single T.  Heap buffers
+    // are allocated as arrays of these so that no element is constructed (or
+    // destroyed) by the allocation itself.
+    struct alignas(alignof(T)) Block {
+        char bytes[sizeof(T)];
+    };
+
+    bool is_inline() const { return ptr_ == inline_storage(); }
+
+    T* inline_storage() const {
+        return reinterpret_cast<T*>(const_cast<Block*>(inline_blocks_));
+    }
+
+    void DestroyElements() {
+        for (size_t i = 0; i < count_; ++i)
+            ptr_[i].~T();
+        count_ = 0;
+    }
+
+    bool Grow(size_t new_capacity) {
+        MX_DEBUG_ASSERT(new_capacity > capacity_);
+
+        AllocChecker ac;
+        Block* mem = new (&ac) Block[new_capacity];
+        if (!ac.check())
+            return false;
+
+        T* new_ptr = reinterpret_cast<T*>(mem);
+        for (size_t i = 0; i < count_; ++i) {
+            new (&new_ptr[i]) T(mxtl::move(ptr_[i]));
+            ptr_[i].~T();
+        }
+
+        if (!is_inline())
+            delete[] reinterpret_cast<Block*>(ptr_);
+
+        ptr_      = new_ptr;
+        capacity_ = new_capacity;
+        return true;
+    }
+
+    // Steal the contents of other, which must not be this, leaving it empty.
+    // The storage this points to must be the inline storage.
+    void MoveFrom(SmallVector* other) {
+        MX_DEBUG_ASSERT(other != this);
+        MX_DEBUG_ASSERT(is_inline() && (count_ == 0));
+
+        if (other->is_inline()) {
+            for (size_t i = 0; i < other->count_; ++i) {
+                new (&ptr_[i]) T(mxtl::move(other->ptr_[i]));
+                other->ptr_[i].~T();
+            }
+            count_ = other->count_;
+        } else {
+            ptr_      = other->ptr_;
+            count_    = other->count_;
+            capacity_ = other->capacity_;
+
+            other->ptr_      = other->inline_storage();
+            other->capacity_ = InlineCount;
+        }
+
+        other->count_ = 0;
+    }
+
+    T*     ptr_;
+    size_t count_    = 0;
+    size_t capacity_ = InlineCount;
+    Block  inline_blocks_[InlineCount];
+};
+
+}  // namespace mxtl
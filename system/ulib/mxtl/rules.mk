@@ -9,6 +9,10 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := userlib
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/small_string.cpp \
     $(LOCAL_DIR)/string_piece.cpp \
 
+MODULE_STATIC_LIBS := \
+    system/ulib/mxalloc \
+
 include make/module.mk
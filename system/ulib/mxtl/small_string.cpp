@@ -0,0 +1,101 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mxtl/small_string.h>
+
+#include <mxalloc/new.h>
+#include <mxtl/algorithm.h>
+#include <mxtl/type_support.h>
+
+namespace mxtl {
+
+SmallString::~SmallString() {
+    if (!is_inline())
+        delete[] heap_;
+}
+
+bool SmallString::Set(const char* str, size_t len) {
+    if (!EnsureCapacity(len))
+        return false;
+
+    char* dst = MutableData();
+    memcpy(dst, str, len);
+    dst[len] = 0;
+    length_  = len;
+    return true;
+}
+
+bool SmallString::Append(const char* str, size_t len) {
+    // Note: str may point into our own buffer (appending a string to itself),
+    // but EnsureCapacity only reallocates when the buffer actually needs to
+    // grow, in which case it copies the old contents before we release them.
+    // Capture the offset so the source survives a reallocation.
+    const char* old_data  = data();
+    bool        self_copy = (str >= old_data) && (str < (old_data + length_ + 1));
+    size_t      offset    = self_copy ? static_cast<size_t>(str - old_data) : 0u;
+
+    if (!EnsureCapacity(length_ + len))
+        return false;
+
+    char* dst = MutableData();
+    memcpy(dst + length_, self_copy ? (dst + offset) : str, len);
+    length_ += len;
+    dst[length_] = 0;
+    return true;
+}
+
+bool SmallString::EnsureCapacity(size_t new_length) {
+    if (new_length <= capacity_)
+        return true;
+
+    // Grow geometrically so that building a string with repeated appends runs
+    // in amortized linear time.
+    size_t new_capacity = max(new_length, (capacity_ * 2u) + 1u);
+
+    AllocChecker ac;
+    char* buf = new (&ac) char[new_capacity + 1];
+    if (!ac.check())
+        return false;
+
+    memcpy(buf, data(), length_ + 1);
+    if (!is_inline())
+        delete[] heap_;
+
+    heap_     = buf;
+    capacity_ = new_capacity;
+    return true;
+}
+
+void SmallString::Reset() {
+    if (!is_inline())
+        delete[] heap_;
+
+    length_    = 0;
+    capacity_  = kInlineCapacity;
+    inline_[0] = 0;
+}
+
+void SmallString::MoveFrom(SmallString* other) {
+    MX_DEBUG_ASSERT(other != this);
+
+    length_   = other->length_;
+    capacity_ = other->capacity_;
+    if (other->is_inline()) {
+        memcpy(inline_, other->inline_, other->length_ + 1);
+    } else {
+        heap_ = other->heap_;
+    }
+
+    other->length_    = 0;
+    other->capacity_  = kInlineCapacity;
+    other->inline_[0] = 0;
+}
+
+void SmallString::swap(SmallString& other) {
+    SmallString tmp(mxtl::move(other));
+    other = mxtl::move(*this);
+    *this = mxtl::move(tmp);
+}
+
+}  // namespace mxtl
@@ -63,6 +63,38 @@ __NO_SAFESTACK static inline void* mxr_tp_get(void) {
 }
 
 __NO_SAFESTACK static inline void mxr_tp_set(mx_handle_t self, void* tp) {
+    // CPUID.(EAX=07H,ECX=0):EBX bit 0 reports the {rd,wr}{fs,gs}base
+    // instructions. The kernel sets CR4.FSGSBASE whenever the hardware
+    // has them, so the CPUID bit alone tells us we can set the thread
+    // pointer directly instead of asking the kernel to. That also makes
+    // user-level context switching (fibers swapping their TLS) cheap.
+    // Leaf 7 is only meaningful if the basic leaves reach it: on CPUs
+    // whose maximum leaf is lower, CPUID.EAX=7 returns the data of the
+    // highest supported leaf, so the bit must not be trusted without
+    // checking leaf 0 first. The answer never changes, so probe once
+    // and cache it (racing initializers store the same value).
+    static int has_fsgsbase; // 0 unknown, 1 yes, -1 no
+    if (has_fsgsbase == 0) {
+        uint32_t a, b, c, d;
+        __asm__ __volatile__("cpuid"
+                             : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                             : "a"(0u), "c"(0u));
+        if (a >= 7) {
+            __asm__ __volatile__("cpuid"
+                                 : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                                 : "a"(7u), "c"(0u));
+            has_fsgsbase = (b & 1u) ? 1 : -1;
+        } else {
+            has_fsgsbase = -1;
+        }
+    }
+    if (has_fsgsbase > 0) {
+        __asm__ __volatile__("wrfsbase %0"
+                             :
+                             : "r"(tp));
+        return;
+    }
+
     mx_status_t status = _mx_object_set_property(
         self, MX_PROP_REGISTER_FS, (uintptr_t*)&tp, sizeof(uintptr_t));
     if (status != NO_ERROR)
@@ -0,0 +1,49 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/types.h>
+#include <magenta/compiler.h>
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+__BEGIN_CDECLS;
+
+// An adaptive futex-backed mutex. On contention the acquiring thread
+// spins a bounded number of iterations, selected per-mutex at init time,
+// before falling back to mx_futex_wait. Short critical sections avoid the
+// syscall round trip entirely; setting spin_count to zero gives the plain
+// sleeping behavior of mxr_mutex.
+typedef struct {
+    atomic_int futex;
+    uint32_t spin_count;
+} sync_mutex_t;
+
+// A reasonable default for short (sub-microsecond) critical sections.
+#define SYNC_MUTEX_DEFAULT_SPIN_COUNT 100u
+
+#define SYNC_MUTEX_INIT ((sync_mutex_t){ .spin_count = SYNC_MUTEX_DEFAULT_SPIN_COUNT })
+#define SYNC_MUTEX_INIT_SPIN(spins) ((sync_mutex_t){ .spin_count = (spins) })
+
+// Initializes the mutex with the given spin count.
+void sync_mutex_init(sync_mutex_t* mutex, uint32_t spin_count);
+
+// Attempts to take the lock without blocking. Returns NO_ERROR if the
+// lock is obtained, and ERR_BAD_STATE if not.
+mx_status_t sync_mutex_trylock(sync_mutex_t* mutex);
+
+// Attempts to take the lock before the deadline passes. This takes an
+// absolute time. Returns NO_ERROR if the lock is acquired, and
+// ERR_TIMED_OUT if the deadline passes.
+mx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, mx_time_t deadline);
+
+// Blocks until the lock is obtained.
+void sync_mutex_lock(sync_mutex_t* mutex);
+
+// Unlocks the lock.
+void sync_mutex_unlock(sync_mutex_t* mutex);
+
+__END_CDECLS;
@@ -0,0 +1,47 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/types.h>
+#include <magenta/compiler.h>
+
+__BEGIN_CDECLS;
+
+// A priority-inheritance mutex. The futex word holds the owning thread's
+// handle, so while a waiter is blocked in mx_futex_wait_pi the kernel
+// boosts the owner to the waiter's effective priority, bounding priority
+// inversion through this lock.
+//
+// Acquiring threads pass a handle to their own thread (e.g. the one
+// returned by thrd_get_mx_handle()); the handle must stay open until the
+// lock is released. Unlike sync_mutex_t there is no spinning phase: a PI
+// mutex is for lock holders that can be preempted, where spinning in the
+// waiter only steals time from the holder.
+typedef struct {
+    mx_futex_t futex;
+} sync_pi_mutex_t;
+
+#define SYNC_PI_MUTEX_INIT ((sync_pi_mutex_t){})
+
+// Initializes the mutex, as an alternative to SYNC_PI_MUTEX_INIT.
+void sync_pi_mutex_init(sync_pi_mutex_t* mutex);
+
+// Attempts to take the lock without blocking. Returns NO_ERROR if the
+// lock is obtained, and ERR_BAD_STATE if not.
+mx_status_t sync_pi_mutex_trylock(sync_pi_mutex_t* mutex, mx_handle_t self);
+
+// Attempts to take the lock before the deadline passes. This takes an
+// absolute time. Returns NO_ERROR if the lock is acquired, and
+// ERR_TIMED_OUT if the deadline passes.
+mx_status_t sync_pi_mutex_timedlock(sync_pi_mutex_t* mutex, mx_handle_t self,
+                                    mx_time_t deadline);
+
+// Blocks until the lock is obtained.
+void sync_pi_mutex_lock(sync_pi_mutex_t* mutex, mx_handle_t self);
+
+// Unlocks the lock.
+void sync_pi_mutex_unlock(sync_pi_mutex_t* mutex);
+
+__END_CDECLS;
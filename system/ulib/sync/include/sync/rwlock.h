@@ -0,0 +1,60 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/types.h>
+#include <magenta/compiler.h>
+
+#include <stdatomic.h>
+
+__BEGIN_CDECLS;
+
+// A futex-backed reader-writer lock. Readers run concurrently; a writer
+// gets the lock to itself. The lock is roughly phase-fair: new readers
+// queue behind a waiting writer, and a releasing writer lets the whole
+// queued batch of readers in before the next writer, so neither side
+// starves the other under contention.
+//
+// Not recursive in either mode; upgrades and downgrades are not
+// supported.
+typedef struct {
+    // bit 30 = writer held, low bits = active reader count
+    atomic_int state;
+    // writers waiting on wr_wakeup; readers defer to them
+    atomic_int pending_writers;
+    // readers waiting on rd_wakeup
+    atomic_int pending_readers;
+    // wakeup generation counters the waiters sleep on
+    atomic_int rd_wakeup;
+    atomic_int wr_wakeup;
+} sync_rwlock_t;
+
+#define SYNC_RWLOCK_INIT ((sync_rwlock_t){ .state = 0 })
+
+// Acquires the lock for reading. Blocks while a writer holds the lock or
+// writers are waiting for it.
+void sync_rwlock_read_lock(sync_rwlock_t* rw);
+
+// Attempts to acquire the lock for reading without blocking. Returns
+// NO_ERROR on success and ERR_BAD_STATE if a writer holds or is waiting
+// for the lock.
+mx_status_t sync_rwlock_read_trylock(sync_rwlock_t* rw);
+
+// Releases a read hold on the lock.
+void sync_rwlock_read_unlock(sync_rwlock_t* rw);
+
+// Acquires the lock for writing, blocking until all readers (or the
+// current writer) have drained.
+void sync_rwlock_write_lock(sync_rwlock_t* rw);
+
+// Attempts to acquire the lock for writing without blocking. Returns
+// NO_ERROR on success and ERR_BAD_STATE if the lock is held in either
+// mode.
+mx_status_t sync_rwlock_write_trylock(sync_rwlock_t* rw);
+
+// Releases the write hold on the lock.
+void sync_rwlock_write_unlock(sync_rwlock_t* rw);
+
+__END_CDECLS;
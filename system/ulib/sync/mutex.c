@@ -0,0 +1,141 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/mutex.h>
+
+#include <magenta/syscalls.h>
+#include <stdatomic.h>
+
+// The sleeping state machine matches mxr_mutex (Drepper's "Mutex, Take 2"
+// with an atomic swap in unlock); the spinning phase in front of it is the
+// only addition.
+enum {
+    UNLOCKED = 0,
+    LOCKED_WITHOUT_WAITERS = 1,
+    LOCKED_WITH_WAITERS = 2,
+};
+
+static inline void spin_hint(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause" ::: "memory");
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ volatile("yield" ::: "memory");
+#else
+    atomic_signal_fence(memory_order_seq_cst);
+#endif
+}
+
+// Spin waiting for the lock to be released, for at most the mutex's
+// configured iteration budget. Returns the last observed state. Spinning
+// stops early if another thread is already sleeping on the futex: at that
+// point the holder is making syscall-slow progress anyway and queueing
+// behind the sleepers keeps the wake order sane.
+static int spin_phase(sync_mutex_t* mutex) {
+    int old_state = atomic_load_explicit(&mutex->futex, memory_order_relaxed);
+    for (uint32_t spins = mutex->spin_count; spins > 0; spins--) {
+        if (old_state == UNLOCKED) {
+            int expected = UNLOCKED;
+            if (atomic_compare_exchange_strong(&mutex->futex, &expected,
+                                               LOCKED_WITHOUT_WAITERS)) {
+                return UNLOCKED;
+            }
+            old_state = expected;
+            continue;
+        }
+        if (old_state == LOCKED_WITH_WAITERS)
+            break;
+        spin_hint();
+        old_state = atomic_load_explicit(&mutex->futex, memory_order_relaxed);
+    }
+    return old_state;
+}
+
+// On success, this will leave the mutex in the LOCKED_WITH_WAITERS state.
+static mx_status_t lock_slow_path(sync_mutex_t* mutex, mx_time_t deadline,
+                                  int old_state) {
+    for (;;) {
+        // If the state shows there are already waiters, or we can update
+        // it to indicate that there are waiters, then wait.
+        if (old_state == LOCKED_WITH_WAITERS ||
+            (old_state == LOCKED_WITHOUT_WAITERS &&
+             atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                            LOCKED_WITH_WAITERS))) {
+            mx_status_t status = _mx_futex_wait(
+                    &mutex->futex, LOCKED_WITH_WAITERS, deadline);
+            if (status == ERR_TIMED_OUT)
+                return ERR_TIMED_OUT;
+        }
+
+        // Try again to claim the mutex.  On this try, we must set the
+        // mutex state to LOCKED_WITH_WAITERS rather than
+        // LOCKED_WITHOUT_WAITERS.  This is because we could have been
+        // woken up when many threads are in the wait queue for the mutex.
+        old_state = UNLOCKED;
+        if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                           LOCKED_WITH_WAITERS)) {
+            return NO_ERROR;
+        }
+    }
+}
+
+void sync_mutex_init(sync_mutex_t* mutex, uint32_t spin_count) {
+    atomic_init(&mutex->futex, UNLOCKED);
+    mutex->spin_count = spin_count;
+}
+
+mx_status_t sync_mutex_trylock(sync_mutex_t* mutex) {
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                       LOCKED_WITHOUT_WAITERS)) {
+        return NO_ERROR;
+    }
+    return ERR_BAD_STATE;
+}
+
+mx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, mx_time_t deadline) {
+    // Try to claim the mutex.  This compare-and-swap executes the full
+    // memory barrier that locking a mutex is required to execute.
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                       LOCKED_WITHOUT_WAITERS)) {
+        return NO_ERROR;
+    }
+
+    old_state = spin_phase(mutex);
+    if (old_state == UNLOCKED)
+        return NO_ERROR;
+
+    return lock_slow_path(mutex, deadline, old_state);
+}
+
+void sync_mutex_lock(sync_mutex_t* mutex) {
+    mx_status_t status = sync_mutex_timedlock(mutex, MX_TIME_INFINITE);
+    if (status != NO_ERROR)
+        __builtin_trap();
+}
+
+void sync_mutex_unlock(sync_mutex_t* mutex) {
+    // Attempt to release the mutex.  This atomic swap executes the full
+    // memory barrier that unlocking a mutex is required to execute.
+    int old_state = atomic_exchange(&mutex->futex, UNLOCKED);
+    switch (old_state) {
+        case LOCKED_WITHOUT_WAITERS:
+            // There were no waiters, so there is nothing more to do.
+            break;
+
+        case LOCKED_WITH_WAITERS: {
+            mx_status_t status = _mx_futex_wake(&mutex->futex, 1);
+            if (status != NO_ERROR)
+                __builtin_trap();
+            break;
+        }
+
+        case UNLOCKED:
+        default:
+            // Either the mutex was unlocked (in which case the unlock call
+            // was invalid), or the mutex was in an invalid state.
+            __builtin_trap();
+            break;
+    }
+}
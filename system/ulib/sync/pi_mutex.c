@@ -0,0 +1,93 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/pi_mutex.h>
+
+#include <magenta/syscalls.h>
+#include <stdatomic.h>
+
+// State encoding: 0 is unlocked; otherwise the word holds the owner's
+// thread handle, with MX_FUTEX_PI_CONTESTED set once a waiter has
+// announced itself. Handle values are never zero and never carry the
+// contested bit, so the three cases cannot collide.
+
+void sync_pi_mutex_init(sync_pi_mutex_t* mutex) {
+    atomic_init(&mutex->futex, 0);
+}
+
+mx_status_t sync_pi_mutex_trylock(sync_pi_mutex_t* mutex, mx_handle_t self) {
+    int old_state = 0;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state, (int)self)) {
+        return NO_ERROR;
+    }
+    return ERR_BAD_STATE;
+}
+
+mx_status_t sync_pi_mutex_timedlock(sync_pi_mutex_t* mutex, mx_handle_t self,
+                                    mx_time_t deadline) {
+    // Try to claim the mutex.  This compare-and-swap executes the full
+    // memory barrier that locking a mutex is required to execute.
+    int old_state = 0;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state, (int)self)) {
+        return NO_ERROR;
+    }
+
+    for (;;) {
+        if (old_state == 0) {
+            // Claim with the contested bit set: we may have been woken
+            // with other waiters still queued, and the eventual unlock
+            // must wake them.
+            if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                               (int)self | MX_FUTEX_PI_CONTESTED)) {
+                return NO_ERROR;
+            }
+            continue;
+        }
+
+        // Announce ourselves in the futex word so the owner's unlock takes
+        // the waking path, then sleep, donating our priority to the owner
+        // the word names.
+        int contested = old_state | MX_FUTEX_PI_CONTESTED;
+        if (old_state != contested &&
+            !atomic_compare_exchange_strong(&mutex->futex, &old_state, contested)) {
+            continue;
+        }
+
+        mx_status_t status = _mx_futex_wait_pi(&mutex->futex, contested, deadline);
+        if (status == ERR_TIMED_OUT)
+            return ERR_TIMED_OUT;
+        if (status == ERR_INVALID_ARGS) {
+            // The owner's handle went stale under us (e.g. it was closed
+            // while the lock is held); we can still queue, just without
+            // the priority donation.
+            status = _mx_futex_wait(&mutex->futex, contested, deadline);
+            if (status == ERR_TIMED_OUT)
+                return ERR_TIMED_OUT;
+        }
+
+        old_state = atomic_load_explicit(&mutex->futex, memory_order_relaxed);
+    }
+}
+
+void sync_pi_mutex_lock(sync_pi_mutex_t* mutex, mx_handle_t self) {
+    mx_status_t status = sync_pi_mutex_timedlock(mutex, self, MX_TIME_INFINITE);
+    if (status != NO_ERROR)
+        __builtin_trap();
+}
+
+void sync_pi_mutex_unlock(sync_pi_mutex_t* mutex) {
+    // Attempt to release the mutex.  This atomic swap executes the full
+    // memory barrier that unlocking a mutex is required to execute.
+    int old_state = atomic_exchange(&mutex->futex, 0);
+    if (old_state == 0) {
+        // The mutex was not held; the unlock call was invalid.
+        __builtin_trap();
+    }
+
+    if (old_state & MX_FUTEX_PI_CONTESTED) {
+        mx_status_t status = _mx_futex_wake_pi(&mutex->futex, 1);
+        if (status != NO_ERROR)
+            __builtin_trap();
+    }
+}
@@ -10,6 +10,9 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/completion.c \
+    $(LOCAL_DIR)/mutex.c \
+    $(LOCAL_DIR)/pi_mutex.c \
+    $(LOCAL_DIR)/rwlock.c \
 
 MODULE_LIBS := \
     system/ulib/magenta \
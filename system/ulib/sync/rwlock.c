@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <sync/rwlock.h>
+
+#include <magenta/syscalls.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define WRITER (1 << 30)
+#define READER_MASK (WRITER - 1)
+
+// Waiters sleep on generation counters rather than on the state word
+// itself: a releaser bumps the generation and wakes, so a waiter that
+// re-checks between reading the generation and calling futex_wait can
+// never miss its wakeup (the wait fails with ERR_BAD_STATE instead).
+
+void sync_rwlock_read_lock(sync_rwlock_t* rw) {
+    // a wakeup from a releasing writer admits us for one attempt even if
+    // more writers are already queued; that batch admission is what keeps
+    // a stream of writers from starving readers
+    bool admitted = false;
+    bool pending = false;
+
+    for (;;) {
+        if (admitted ||
+            atomic_load_explicit(&rw->pending_writers, memory_order_relaxed) == 0) {
+            int old = atomic_load_explicit(&rw->state, memory_order_relaxed);
+            while (!(old & WRITER)) {
+                if (atomic_compare_exchange_strong(&rw->state, &old, old + 1)) {
+                    if (pending)
+                        atomic_fetch_sub(&rw->pending_readers, 1);
+                    return;
+                }
+            }
+        }
+
+        if (!pending) {
+            atomic_fetch_add(&rw->pending_readers, 1);
+            pending = true;
+        }
+
+        int gen = atomic_load(&rw->rd_wakeup);
+        // re-check after publishing ourselves as pending; the releaser
+        // bumps the generation after clearing the state we just saw
+        if ((atomic_load(&rw->state) & WRITER) != 0 ||
+            atomic_load(&rw->pending_writers) != 0) {
+            _mx_futex_wait(&rw->rd_wakeup, gen, MX_TIME_INFINITE);
+        }
+        admitted = true;
+    }
+}
+
+mx_status_t sync_rwlock_read_trylock(sync_rwlock_t* rw) {
+    if (atomic_load_explicit(&rw->pending_writers, memory_order_relaxed) != 0)
+        return ERR_BAD_STATE;
+    int old = atomic_load_explicit(&rw->state, memory_order_relaxed);
+    while (!(old & WRITER)) {
+        if (atomic_compare_exchange_strong(&rw->state, &old, old + 1))
+            return NO_ERROR;
+    }
+    return ERR_BAD_STATE;
+}
+
+void sync_rwlock_read_unlock(sync_rwlock_t* rw) {
+    int old = atomic_fetch_sub(&rw->state, 1);
+    if ((old & READER_MASK) == 1 &&
+        atomic_load(&rw->pending_writers) != 0) {
+        // we were the last reader out and a writer is waiting
+        atomic_fetch_add(&rw->wr_wakeup, 1);
+        _mx_futex_wake(&rw->wr_wakeup, 1);
+    }
+}
+
+void sync_rwlock_write_lock(sync_rwlock_t* rw) {
+    // publishing ourselves as pending blocks new readers
+    atomic_fetch_add(&rw->pending_writers, 1);
+
+    for (;;) {
+        int old = 0;
+        if (atomic_compare_exchange_strong(&rw->state, &old, WRITER)) {
+            atomic_fetch_sub(&rw->pending_writers, 1);
+            return;
+        }
+
+        int gen = atomic_load(&rw->wr_wakeup);
+        if (atomic_load(&rw->state) != 0)
+            _mx_futex_wait(&rw->wr_wakeup, gen, MX_TIME_INFINITE);
+    }
+}
+
+mx_status_t sync_rwlock_write_trylock(sync_rwlock_t* rw) {
+    int old = 0;
+    if (atomic_compare_exchange_strong(&rw->state, &old, WRITER))
+        return NO_ERROR;
+    return ERR_BAD_STATE;
+}
+
+void sync_rwlock_write_unlock(sync_rwlock_t* rw) {
+    atomic_store(&rw->state, 0);
+
+    // phase-fair hand-off: any queued batch of readers goes first, then
+    // the next writer. the woken readers admit themselves even though
+    // pending_writers may still be non-zero.
+    if (atomic_load(&rw->pending_readers) != 0) {
+        atomic_fetch_add(&rw->rd_wakeup, 1);
+        _mx_futex_wake(&rw->rd_wakeup, UINT32_MAX);
+    } else if (atomic_load(&rw->pending_writers) != 0) {
+        atomic_fetch_add(&rw->wr_wakeup, 1);
+        _mx_futex_wake(&rw->wr_wakeup, 1);
+    }
+}
@@ -43,6 +43,9 @@ typedef struct tftp_data_msg_t {
 #define DEFAULT_WINDOWSIZE 1
 #define DEFAULT_MODE MODE_OCTET
 
+// Number of consecutive timeouts tolerated before the transfer is abandoned
+#define TFTP_MAX_RETRIES 5
+
 typedef struct tftp_options_t {
     // Maximum filename really is 505 including \0
     // max request size (512) - opcode (2) - shortest mode (4) - null (1)
@@ -92,7 +95,6 @@ typedef enum {
     COMPLETED,
 } tftp_state;
 
-// TODO add a state so time out can be handled properly as well as unexpected traffic
 struct tftp_session_t {
     tftp_options options;
     tftp_state state;
@@ -101,6 +103,11 @@ struct tftp_session_t {
     uint32_t block_number;
     uint32_t window_index;
 
+    // Timeout handling
+    bool sender;        // initiated the transfer via tftp_generate_write_request()
+    uint32_t retries;   // consecutive timeouts since the last packet from the peer
+    uint32_t last_ack;  // highest block acked by the receiver (sender only)
+
     // "Negotiated" values
     size_t file_size;
     tftp_mode mode;
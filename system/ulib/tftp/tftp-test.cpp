@@ -1112,6 +1112,124 @@ static bool test_tftp_send_data_receive_ack_window_size(void) {
     END_TEST;
 }
 
+static bool test_tftp_timeout_sender_retransmit(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 1024, 1500);
+
+    auto status = tftp_generate_write_request(ts.session, kFilename, MODE_OCTET,
+        ts.msg_size, 0, 0, 0, ts.out, &ts.outlen, &ts.timeout);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "error generating write request");
+
+    uint8_t oack_buf[] = {
+        0x00, 0x06,                     // Opcode (OACK)
+        'T', 'S', 'I', 'Z', 'E', 0x00,  // Option
+        '1', '0', '2', '4', 0x00,       // TSIZE value
+    };
+
+    tftp_session_set_read_cb(ts.session, mock_read);
+
+    tx_test_data td;
+    status = tftp_handle_msg(ts.session, oack_buf, sizeof(oack_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive error");
+    ASSERT_TRUE(verify_read_data(ts, td), "bad test data");
+
+    // No ack arrives; the block should be retransmitted from the last acked
+    // position (the start of the file)
+    tx_test_data td2;
+    ts.outlen = ts.out_size;
+    status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, &td2);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "timeout error");
+    EXPECT_EQ(ts.outlen, sizeof(tftp_data_msg) + DEFAULT_BLOCKSIZE, "bad outlen");
+    EXPECT_TRUE(verify_read_data(ts, td2), "bad test data");
+    EXPECT_EQ(1, ts.session->retries, "retry count should be 1");
+
+    END_TEST;
+}
+
+static bool test_tftp_timeout_receiver_reack(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 1024, 1500);
+    tftp_session_set_open_cb(ts.session,
+            [](const char* filename, size_t size, void* cookie) -> tftp_status {
+                return 0;
+            });
+
+    uint8_t req_buf[] = {
+        0x00, 0x02,                                   // Opcode (WRQ)
+        'f', 'i', 'l', 'e', 'n', 'a', 'm', 'e', 0x00, // Filename
+        'O', 'C', 'T', 'E', 'T', 0x00,                // Mode
+        'T', 'S', 'I', 'Z', 'E', 0x00,                // Option
+        '1', '0', '2', '4', 0x00,                     // TSIZE value
+    };
+    auto status = tftp_handle_msg(ts.session, req_buf, sizeof(req_buf), ts.out, &ts.outlen, &ts.timeout, nullptr);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive write request failed");
+
+    uint8_t data_buf[516] = {
+        0x00, 0x03,  // Opcode (DATA)
+        0x01, 0x00,  // Block
+    };
+
+    tftp_session_set_write_cb(ts.session, mock_write);
+
+    tx_test_data td;
+    status = tftp_handle_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+
+    // The next block never arrives; the last ack should be repeated so the
+    // sender rewinds
+    ts.outlen = ts.out_size;
+    status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, nullptr);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "timeout error");
+    EXPECT_EQ(ts.outlen, sizeof(tftp_data_msg), "bad outlen");
+    auto msg = reinterpret_cast<tftp_data_msg*>(ts.out);
+    EXPECT_EQ(htons(OPCODE_ACK), msg->opcode, "bad opcode");
+    EXPECT_EQ(1, msg->block, "should re-ack the last block received");
+    EXPECT_EQ(1, ts.session->retries, "retry count should be 1");
+
+    // A packet from the peer resets the retry count
+    data_buf[2] = 0x02;
+    tx_test_data td2;
+    td2.expected.block = 2;
+    td2.expected.offset = DEFAULT_BLOCKSIZE;
+    ts.outlen = ts.out_size;
+    status = tftp_handle_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td2);
+    EXPECT_EQ(TFTP_TRANSFER_COMPLETED, status, "receive data failed");
+    EXPECT_EQ(0, ts.session->retries, "retry count should reset on progress");
+
+    END_TEST;
+}
+
+static bool test_tftp_timeout_gives_up(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 1024, 1500);
+
+    auto status = tftp_generate_write_request(ts.session, kFilename, MODE_OCTET,
+        ts.msg_size, 0, 0, 0, ts.out, &ts.outlen, &ts.timeout);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "error generating write request");
+
+    // The request is retransmitted until the retry limit, then the transfer
+    // is abandoned
+    for (int i = 0; i < TFTP_MAX_RETRIES; i++) {
+        ts.outlen = ts.out_size;
+        status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, nullptr);
+        EXPECT_EQ(TFTP_NO_ERROR, status, "timeout error");
+        EXPECT_TRUE(verify_write_request(ts), "bad write request");
+    }
+    ts.outlen = ts.out_size;
+    status = tftp_timeout(ts.session, ts.out, &ts.outlen, &ts.timeout, nullptr);
+    EXPECT_EQ(TFTP_ERR_TIMED_OUT, status, "should give up after max retries");
+    EXPECT_EQ(0, ts.outlen, "no outgoing message expected");
+    EXPECT_EQ(ERROR, ts.session->state, "session should be in ERROR state");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(tftp_setup)
 RUN_TEST(test_tftp_init)
 RUN_TEST(test_tftp_session_options)
@@ -1157,6 +1275,12 @@ RUN_TEST(test_tftp_send_data_receive_ack_skipped_block)
 RUN_TEST(test_tftp_send_data_receive_ack_window_size)
 END_TEST_CASE(tftp_send_data)
 
+BEGIN_TEST_CASE(tftp_timeout)
+RUN_TEST(test_tftp_timeout_sender_retransmit)
+RUN_TEST(test_tftp_timeout_receiver_reack)
+RUN_TEST(test_tftp_timeout_gives_up)
+END_TEST_CASE(tftp_timeout)
+
 int main(int argc, char* argv[]) {
     return unittest_run_all_tests(argc, argv) ? 0 : -1;
 }
@@ -299,6 +299,7 @@ tftp_status tftp_generate_write_request(tftp_session* session,
     // Nothing has been negotiated yet so use default
     *timeout_ms = 1000 * session->timeout;
 
+    session->sender = true;
     session->state = WRITE_REQUESTED;
     xprintf("Generated write request, len=%zu\n", *outlen);
     return TFTP_NO_ERROR;
@@ -572,6 +573,7 @@ tftp_status tftp_handle_ack(tftp_session* session,
 
     xprintf(" <- Ack %d\n", ack_data->block);
     session->block_number = ack_data->block;
+    session->last_ack = ack_data->block;
     session->window_index = 0;
 
     if ((session->block_number + session->window_index) * session->block_size >= session->file_size) {
@@ -741,6 +743,9 @@ tftp_status tftp_handle_msg(tftp_session* session,
     // Set default timeout
     *timeout_ms = 1000 * session->timeout;
 
+    // Any packet from the peer means the transfer is making progress
+    session->retries = 0;
+
     switch (opcode) {
     case OPCODE_RRQ:
         return tftp_handle_rrq(session, msg, inlen, resp, outlen, timeout_ms, cookie);
@@ -787,6 +792,60 @@ tftp_status tftp_timeout(tftp_session* session,
                          size_t* outlen,
                          uint32_t* timeout_ms,
                          void* cookie) {
-    // TODO: really handle timeouts
-    return TFTP_NO_ERROR;
+    xprintf("Timeout\n");
+    *timeout_ms = 1000 * session->timeout;
+
+    switch (session->state) {
+    case WRITE_REQUESTED:
+    case TRANSMITTING:
+    case LAST_PACKET:
+        break;
+    default:
+        // No transfer in flight; nothing to retransmit
+        *outlen = 0;
+        return TFTP_NO_ERROR;
+    }
+
+    if (++session->retries > TFTP_MAX_RETRIES) {
+        *outlen = 0;
+        session->state = ERROR;
+        return TFTP_ERR_TIMED_OUT;
+    }
+
+    if (!session->sender) {
+        // Receiver: our last ack (or the window of data behind it) was
+        // lost. Re-ack the last block received; the sender rewinds to it
+        // and retransmits the window.
+        tftp_data_msg* ack_data = outgoing;
+        OPCODE(ack_data, OPCODE_ACK);
+        ack_data->block = session->block_number;
+        *outlen = sizeof(*ack_data);
+        session->window_index = 0;
+        return TFTP_NO_ERROR;
+    }
+
+    if (session->state == WRITE_REQUESTED) {
+        // Our write request (or the response to it) was lost; send it again
+        // from the saved options.
+        char filename[sizeof(session->options.filename)];
+        memcpy(filename, session->options.filename, sizeof(filename));
+        return tftp_generate_write_request(session, filename,
+                session->options.mode,
+                session->file_size,
+                (session->options.requested & BLOCKSIZE_OPTION) ? session->options.block_size : 0,
+                (session->options.requested & TIMEOUT_OPTION) ? session->options.timeout : 0,
+                (session->options.requested & WINDOWSIZE_OPTION) ? (uint8_t)session->options.window_size : 0,
+                outgoing, outlen, timeout_ms);
+    }
+
+    // Sender: no ack arrived for the window in flight. Rewind to the last
+    // acked block and retransmit the window from there; the caller streams
+    // out the rest of the window via tftp_prepare_data() as usual.
+    session->block_number = session->last_ack;
+    session->window_index = 0;
+    tftp_status ret = tx_data(session, (tftp_data_msg*)outgoing, outlen, cookie);
+    if (ret < 0) {
+        set_error(session, OPCODE_ERROR, outgoing, outlen);
+    }
+    return ret;
 }
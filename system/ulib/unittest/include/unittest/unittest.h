@@ -181,6 +181,44 @@ int unittest_set_verbosity_level(int new_level);
 #define RUN_TEST(test) RUN_NAMED_TEST_TYPE(#test, test, TEST_SMALL)
 #define RUN_NAMED_TEST(name, test) RUN_NAMED_TEST_TYPE(name, test, TEST_SMALL)
 
+/*
+ * Performance measurement.
+ *
+ * A perf test is an ordinary test registered with RUN_PERF_TEST (so it only
+ * runs when the TEST_PERFORMANCE class is selected, e.g. runtests -P) whose
+ * body measures one or more operations with PERF_MEASURE:
+ *
+ *  static bool bench_foo(void)
+ *  {
+ *      BEGIN_TEST;
+ *      PERF_MEASURE(foo_op, 10000, { foo_op(); });
+ *      END_TEST;
+ *  }
+ *
+ * PERF_MEASURE runs the body |iters| times bracketed by mx_ticks_get() and
+ * reports nanoseconds per iteration. If a baseline file is configured via
+ * the environment (see PERF_BASELINES_ENV_NAME) the result is checked
+ * against the stored baseline for |name| and the measurement FAILS when it
+ * is more than the margin (default 20%, PERF_MARGIN_ENV_NAME, in percent)
+ * slower. Measurements without a stored baseline are appended to the file,
+ * so the first run against a fresh file records the baselines.
+ */
+#define PERF_BASELINES_ENV_NAME "RUNTESTS_PERF_BASELINES"
+#define PERF_MARGIN_ENV_NAME "RUNTESTS_PERF_MARGIN"
+
+#define RUN_PERF_TEST(test) RUN_NAMED_TEST_TYPE(#test, test, TEST_PERFORMANCE)
+
+#define PERF_MEASURE(name, iters, body)                                        \
+    do {                                                                       \
+        uint64_t _perf_start = unittest_perf_start();                          \
+        for (uint64_t _perf_i = 0; _perf_i < (uint64_t)(iters); _perf_i++) {   \
+            body;                                                              \
+        }                                                                      \
+        if (!unittest_perf_finish(#name, (uint64_t)(iters), _perf_start)) {    \
+            current_test_info->all_ok = false;                                 \
+        }                                                                      \
+    } while (0)
+
 /*
  * BEGIN_TEST and END_TEST go in a function that is called by RUN_TEST
  * and that call the EXPECT_ macros.
@@ -420,4 +458,9 @@ void unittest_run_named_test(const char* name, bool (*test)(void),
                              struct test_info** current_test_info,
                              bool* all_success);
 
+/* Used to implement PERF_MEASURE(). */
+uint64_t unittest_perf_start(void);
+bool unittest_perf_finish(const char* name, uint64_t iterations,
+                          uint64_t start_ticks);
+
 __END_CDECLS
@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Support for PERF_MEASURE: cycle-accurate measurement via the mx_ticks
+// vDSO calls plus optional baseline checking.
+//
+// Baselines live in a plain text file ("<name> <ns-per-iteration>\n" per
+// line) named by RUNTESTS_PERF_BASELINES. Measurements with a stored
+// baseline fail when they are more than the margin (default 20%,
+// RUNTESTS_PERF_MARGIN) slower; measurements without one are appended so
+// the first run against a file records the baselines for later runs.
+//
+// N.B. This file may only use libc's weakly-stubbed io (no mxio, see
+// ./README.md). When running without a filesystem the baseline file
+// simply fails to open and measurements are report-only.
+
+#include <unittest/unittest.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/syscalls.h>
+
+#define DEFAULT_MARGIN_PERCENT 20u
+
+// Contents of the baseline file, loaded on first use. NULL when absent.
+static char* baseline_data;
+static bool baseline_loaded;
+
+static void load_baselines(void) {
+    if (baseline_loaded) {
+        return;
+    }
+    baseline_loaded = true;
+
+    const char* path = getenv(PERF_BASELINES_ENV_NAME);
+    if (path == NULL) {
+        return;
+    }
+    FILE* f = fopen(path, "r");
+    if (f == NULL) {
+        return;
+    }
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long size = ftell(f);
+        if (size >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+            baseline_data = malloc(size + 1);
+            if (baseline_data != NULL) {
+                size_t actual = fread(baseline_data, 1, size, f);
+                baseline_data[actual] = '\0';
+            }
+        }
+    }
+    fclose(f);
+}
+
+// Returns true and sets |*out| if |name| has a stored baseline.
+static bool baseline_lookup(const char* name, uint64_t* out) {
+    load_baselines();
+    if (baseline_data == NULL) {
+        return false;
+    }
+    size_t name_len = strlen(name);
+    const char* line = baseline_data;
+    while (*line != '\0') {
+        if (!strncmp(line, name, name_len) && line[name_len] == ' ') {
+            *out = strtoull(line + name_len + 1, NULL, 10);
+            return true;
+        }
+        const char* next = strchr(line, '\n');
+        if (next == NULL) {
+            break;
+        }
+        line = next + 1;
+    }
+    return false;
+}
+
+static void baseline_record(const char* name, uint64_t ns) {
+    const char* path = getenv(PERF_BASELINES_ENV_NAME);
+    if (path == NULL) {
+        return;
+    }
+    FILE* f = fopen(path, "a");
+    if (f == NULL) {
+        return;
+    }
+    fprintf(f, "%s %" PRIu64 "\n", name, ns);
+    fclose(f);
+}
+
+static uint32_t margin_percent(void) {
+    const char* margin = getenv(PERF_MARGIN_ENV_NAME);
+    if (margin == NULL) {
+        return DEFAULT_MARGIN_PERCENT;
+    }
+    return (uint32_t)strtoul(margin, NULL, 10);
+}
+
+uint64_t unittest_perf_start(void) {
+    return mx_ticks_get();
+}
+
+bool unittest_perf_finish(const char* name, uint64_t iterations,
+                          uint64_t start_ticks) {
+    uint64_t elapsed_ticks = mx_ticks_get() - start_ticks;
+    uint64_t ns = (uint64_t)((double)elapsed_ticks * 1000000000.0 /
+                             ((double)mx_ticks_per_second() * (double)iterations));
+
+    uint64_t baseline;
+    if (!baseline_lookup(name, &baseline)) {
+        unittest_printf_critical(
+            "        PERF  %-40s %8" PRIu64 " ns/iter (no baseline)\n",
+            name, ns);
+        baseline_record(name, ns);
+        return true;
+    }
+
+    uint64_t limit = baseline + (baseline * margin_percent()) / 100u;
+    if (ns > limit) {
+        unittest_printf_critical(
+            "        PERF  %-40s %8" PRIu64 " ns/iter [FAILED]\n"
+            "        exceeds baseline %" PRIu64 " ns + %u%% margin (%" PRIu64 " ns)\n",
+            name, ns, baseline, margin_percent(), limit);
+        return false;
+    }
+    unittest_printf_critical(
+        "        PERF  %-40s %8" PRIu64 " ns/iter (baseline %" PRIu64 ")\n",
+        name, ns, baseline);
+    return true;
+}
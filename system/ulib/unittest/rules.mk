@@ -10,12 +10,13 @@ MODULE_TYPE := userlib
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/all-tests.c \
+    $(LOCAL_DIR)/perf.c \
     $(LOCAL_DIR)/unittest.c \
 
 MODULE_SO_NAME := unittest
 
 # N.B. mxio, and thus launchpad, cannot appear here. See ./README.md.
-MODULE_LIBS := system/ulib/c
+MODULE_LIBS := system/ulib/magenta system/ulib/c
 
 MODULE_STATIC_LIBS := system/ulib/pretty
 
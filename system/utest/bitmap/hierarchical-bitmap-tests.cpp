@@ -0,0 +1,228 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bitmap/hierarchical-bitmap.h>
+#include <bitmap/storage.h>
+
+#include <mxalloc/new.h>
+#include <mxtl/algorithm.h>
+#include <unittest/unittest.h>
+
+namespace bitmap {
+namespace tests {
+
+template <typename HierarchicalBitmap>
+static bool InitializedEmpty(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(0), NO_ERROR, "");
+    EXPECT_EQ(bitmap.size(), 0U, "get size");
+
+    EXPECT_TRUE(bitmap.GetOne(0), "get one bit");
+    EXPECT_EQ(bitmap.SetOne(0), ERR_INVALID_ARGS, "set one bit");
+    EXPECT_EQ(bitmap.ClearOne(0), ERR_INVALID_ARGS, "clear one bit");
+
+    EXPECT_EQ(bitmap.Reset(1), NO_ERROR, "");
+    EXPECT_FALSE(bitmap.GetOne(0), "get one bit");
+    EXPECT_EQ(bitmap.SetOne(0), NO_ERROR, "set one bit");
+    EXPECT_EQ(bitmap.ClearOne(0), NO_ERROR, "clear one bit");
+
+    END_TEST;
+}
+
+template <typename HierarchicalBitmap>
+static bool SingleBit(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(128), NO_ERROR, "");
+    EXPECT_EQ(bitmap.size(), 128U, "get size");
+
+    EXPECT_FALSE(bitmap.GetOne(2), "get bit before setting");
+
+    EXPECT_EQ(bitmap.SetOne(2), NO_ERROR, "set bit");
+    EXPECT_TRUE(bitmap.GetOne(2), "get bit after setting");
+
+    EXPECT_EQ(bitmap.ClearOne(2), NO_ERROR, "clear bit");
+    EXPECT_FALSE(bitmap.GetOne(2), "get bit after clearing");
+
+    END_TEST;
+}
+
+template <typename HierarchicalBitmap>
+static bool SetRange(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(256), NO_ERROR, "");
+    EXPECT_EQ(bitmap.Set(50, 200), NO_ERROR, "set range across words");
+
+    size_t first_unset = 0;
+    EXPECT_TRUE(bitmap.Get(50, 200, &first_unset), "get whole range");
+    EXPECT_EQ(first_unset, 200U, "check returned arg");
+
+    EXPECT_FALSE(bitmap.Get(0, 256, &first_unset), "get superset range");
+    EXPECT_EQ(first_unset, 0U, "check returned arg");
+
+    EXPECT_EQ(bitmap.Scan(0, 256, false), 50U, "scan for first set bit");
+    EXPECT_EQ(bitmap.Scan(50, 256, true), 200U, "scan over uniform words");
+
+    EXPECT_EQ(bitmap.Clear(60, 190), NO_ERROR, "clear subrange");
+    EXPECT_EQ(bitmap.Scan(50, 256, true), 60U, "scan after clearing");
+    EXPECT_TRUE(bitmap.Get(190, 200, &first_unset), "get remaining tail");
+    EXPECT_EQ(first_unset, 200U, "check returned arg");
+
+    END_TEST;
+}
+
+template <typename HierarchicalBitmap>
+static bool FindOverUniformWords(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(1024), NO_ERROR, "");
+
+    // Fill everything except a hole spanning a word boundary deep inside.
+    EXPECT_EQ(bitmap.Set(0, 1024), NO_ERROR, "fill bitmap");
+    EXPECT_EQ(bitmap.Clear(700, 720), NO_ERROR, "open a hole");
+
+    size_t bitoff_start = 0;
+    EXPECT_EQ(bitmap.Find(false, 0, 1024, 1, &bitoff_start), NO_ERROR, "find single bit");
+    EXPECT_EQ(bitoff_start, 700U, "check returned arg");
+
+    EXPECT_EQ(bitmap.Find(false, 0, 1024, 20, &bitoff_start), NO_ERROR, "find whole hole");
+    EXPECT_EQ(bitoff_start, 700U, "check returned arg");
+
+    EXPECT_EQ(bitmap.Find(false, 0, 1024, 21, &bitoff_start), ERR_NO_RESOURCES, "hole too small");
+    EXPECT_EQ(bitoff_start, 1024U, "check returned arg");
+
+    EXPECT_EQ(bitmap.Find(false, 710, 1024, 1, &bitoff_start), NO_ERROR, "find with offset");
+    EXPECT_EQ(bitoff_start, 710U, "check returned arg");
+
+    // Searching for set bits skips the all-clear words the same way.
+    bitmap.ClearAll();
+    EXPECT_EQ(bitmap.Set(900, 905), NO_ERROR, "set small run");
+    EXPECT_EQ(bitmap.Find(true, 0, 1024, 5, &bitoff_start), NO_ERROR, "find set run");
+    EXPECT_EQ(bitoff_start, 900U, "check returned arg");
+    EXPECT_EQ(bitmap.Find(true, 0, 1024, 6, &bitoff_start), ERR_NO_RESOURCES, "run too long");
+    EXPECT_EQ(bitoff_start, 1024U, "check returned arg");
+
+    END_TEST;
+}
+
+template <typename HierarchicalBitmap>
+static bool NextFitRotor(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(128), NO_ERROR, "");
+
+    // Successive finds march forward instead of re-returning the prefix.
+    size_t bitoff_start = 0;
+    EXPECT_EQ(bitmap.FindNextFit(false, 10, &bitoff_start), NO_ERROR, "first fit");
+    EXPECT_EQ(bitoff_start, 0U, "check returned arg");
+    EXPECT_EQ(bitmap.Set(0, 10), NO_ERROR, "claim run");
+
+    EXPECT_EQ(bitmap.FindNextFit(false, 10, &bitoff_start), NO_ERROR, "second fit");
+    EXPECT_EQ(bitoff_start, 10U, "check returned arg");
+
+    // A hole before the rotor is only found after wrapping around.
+    EXPECT_EQ(bitmap.Set(10, 128), NO_ERROR, "fill the rest");
+    EXPECT_EQ(bitmap.Clear(2, 8), NO_ERROR, "open hole behind rotor");
+    EXPECT_EQ(bitmap.FindNextFit(false, 6, &bitoff_start), NO_ERROR, "wrap to hole");
+    EXPECT_EQ(bitoff_start, 2U, "check returned arg");
+
+    EXPECT_EQ(bitmap.Set(2, 8), NO_ERROR, "claim hole");
+    EXPECT_EQ(bitmap.FindNextFit(false, 1, &bitoff_start), ERR_NO_RESOURCES, "bitmap full");
+
+    END_TEST;
+}
+
+template <typename HierarchicalBitmap>
+static bool ClearAll(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(128), NO_ERROR, "");
+    EXPECT_EQ(bitmap.size(), 128U, "get size");
+
+    EXPECT_EQ(bitmap.Set(0, 100), NO_ERROR, "set range");
+
+    bitmap.ClearAll();
+
+    size_t first = 0;
+    EXPECT_FALSE(bitmap.Get(2, 100, &first), "get range");
+    EXPECT_EQ(first, 2U, "all clear");
+
+    size_t bitoff_start = 0;
+    EXPECT_EQ(bitmap.Find(true, 0, 128, 1, &bitoff_start), ERR_NO_RESOURCES, "no set bits");
+    EXPECT_EQ(bitoff_start, 128U, "check returned arg");
+
+    END_TEST;
+}
+
+template <typename HierarchicalBitmap>
+static bool BoundaryArguments(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(128), NO_ERROR, "");
+    EXPECT_EQ(bitmap.size(), 128U, "get size");
+
+    EXPECT_EQ(bitmap.Set(0, 0), NO_ERROR, "range contains no bits");
+    EXPECT_EQ(bitmap.Set(5, 4), ERR_INVALID_ARGS, "max is less than off");
+    EXPECT_EQ(bitmap.Set(5, 5), NO_ERROR, "range contains no bits");
+
+    EXPECT_EQ(bitmap.Clear(0, 0), NO_ERROR, "range contains no bits");
+    EXPECT_EQ(bitmap.Clear(5, 4), ERR_INVALID_ARGS, "max is less than off");
+    EXPECT_EQ(bitmap.Clear(5, 5), NO_ERROR, "range contains no bits");
+
+    EXPECT_TRUE(bitmap.Get(0, 0), "range contains no bits, so all are true");
+    EXPECT_TRUE(bitmap.Get(5, 4), "range contains no bits, so all are true");
+    EXPECT_TRUE(bitmap.Get(5, 5), "range contains no bits, so all are true");
+
+    END_TEST;
+}
+
+template <typename HierarchicalBitmap>
+static bool ShrinkAccess(void) {
+    BEGIN_TEST;
+
+    HierarchicalBitmap bitmap;
+    EXPECT_EQ(bitmap.Reset(128), NO_ERROR, "");
+    EXPECT_EQ(bitmap.Set(0, 128), NO_ERROR, "fill bitmap");
+    EXPECT_EQ(bitmap.Shrink(129), ERR_NO_MEMORY, "grow via shrink");
+    EXPECT_EQ(bitmap.Shrink(100), NO_ERROR, "shrink");
+    EXPECT_EQ(bitmap.size(), 100U, "get size");
+
+    EXPECT_EQ(bitmap.Clear(90, 100), NO_ERROR, "clear visible tail");
+    EXPECT_EQ(bitmap.Scan(0, 100, true), 90U, "scan stops at visible bits");
+
+    size_t bitoff_start = 0;
+    EXPECT_EQ(bitmap.Find(false, 0, 100, 10, &bitoff_start), NO_ERROR, "find in tail");
+    EXPECT_EQ(bitoff_start, 90U, "check returned arg");
+    EXPECT_EQ(bitmap.Set(100, 128), ERR_INVALID_ARGS, "set beyond shrunk size");
+
+    END_TEST;
+}
+
+#define RUN_TEMPLATIZED_TEST(test, specialization) RUN_TEST(test<specialization>)
+#define ALL_TESTS(specialization)                               \
+    RUN_TEMPLATIZED_TEST(InitializedEmpty, specialization)      \
+    RUN_TEMPLATIZED_TEST(SingleBit, specialization)             \
+    RUN_TEMPLATIZED_TEST(SetRange, specialization)              \
+    RUN_TEMPLATIZED_TEST(FindOverUniformWords, specialization)  \
+    RUN_TEMPLATIZED_TEST(NextFitRotor, specialization)          \
+    RUN_TEMPLATIZED_TEST(ClearAll, specialization)              \
+    RUN_TEMPLATIZED_TEST(BoundaryArguments, specialization)     \
+    RUN_TEMPLATIZED_TEST(ShrinkAccess, specialization)
+
+BEGIN_TEST_CASE(hierarchical_bitmap_tests)
+ALL_TESTS(HierarchicalBitmapGeneric<DefaultStorage>)
+ALL_TESTS(HierarchicalBitmapGeneric<VmoStorage>)
+END_TEST_CASE(hierarchical_bitmap_tests);
+
+} // namespace tests
+} // namespace bitmap
@@ -10,6 +10,7 @@
 #include <unistd.h>
 
 #include <magenta/syscalls.h>
+#include <magenta/syscalls/object.h>
 #include <unittest/unittest.h>
 
 static mx_signals_t get_signals(mx_handle_t h) {
@@ -108,8 +109,61 @@ static bool basic_test(void) {
     END_TEST;
 }
 
+static bool read_threshold_test(void) {
+    BEGIN_TEST;
+    mx_handle_t a, b;
+    uint64_t n[8] = { 1, 2, 3, 4, 5, 6, 7, 8};
+    uint32_t actual;
+    uint32_t threshold;
+
+    ASSERT_EQ(mx_fifo_create(8, 8, 0, &a, &b), NO_ERROR, "");
+
+    // the default threshold is one element
+    ASSERT_EQ(mx_object_get_property(b, MX_PROP_FIFO_READ_THRESHOLD,
+                                     &threshold, sizeof(threshold)), NO_ERROR, "");
+    ASSERT_EQ(threshold, 1u, "");
+
+    // cannot set a threshold deeper than the fifo
+    threshold = 9;
+    EXPECT_EQ(mx_object_set_property(b, MX_PROP_FIFO_READ_THRESHOLD,
+                                     &threshold, sizeof(threshold)), ERR_OUT_OF_RANGE, "");
+
+    threshold = 4;
+    ASSERT_EQ(mx_object_set_property(b, MX_PROP_FIFO_READ_THRESHOLD,
+                                     &threshold, sizeof(threshold)), NO_ERROR, "");
+
+    // below the threshold the fifo has data but is not signaled readable
+    ASSERT_EQ(mx_fifo_write(a, n, sizeof(uint64_t) * 3, &actual), NO_ERROR, "");
+    ASSERT_EQ(actual, 3u, "");
+    EXPECT_SIGNALS(b, MX_FIFO_WRITABLE | MX_SIGNAL_LAST_HANDLE);
+
+    // crossing the threshold asserts readable
+    ASSERT_EQ(mx_fifo_write(a, n, sizeof(uint64_t), &actual), NO_ERROR, "");
+    EXPECT_SIGNALS(b, MX_FIFO_READABLE | MX_FIFO_WRITABLE | MX_SIGNAL_LAST_HANDLE);
+
+    // a read may still drain everything below the threshold
+    ASSERT_EQ(mx_fifo_read(b, n, sizeof(uint64_t) * 2, &actual), NO_ERROR, "");
+    ASSERT_EQ(actual, 2u, "");
+    EXPECT_SIGNALS(b, MX_FIFO_WRITABLE | MX_SIGNAL_LAST_HANDLE);
+
+    // zero resets to the default, re-evaluating pending data
+    threshold = 0;
+    ASSERT_EQ(mx_object_set_property(b, MX_PROP_FIFO_READ_THRESHOLD,
+                                     &threshold, sizeof(threshold)), NO_ERROR, "");
+    ASSERT_EQ(mx_object_get_property(b, MX_PROP_FIFO_READ_THRESHOLD,
+                                     &threshold, sizeof(threshold)), NO_ERROR, "");
+    ASSERT_EQ(threshold, 1u, "");
+    EXPECT_SIGNALS(b, MX_FIFO_READABLE | MX_FIFO_WRITABLE | MX_SIGNAL_LAST_HANDLE);
+
+    mx_handle_close(a);
+    mx_handle_close(b);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(fifo_tests)
 RUN_TEST(basic_test)
+RUN_TEST(read_threshold_test)
 END_TEST_CASE(fifo_tests)
 
 #ifndef BUILD_COMBINED_TESTS
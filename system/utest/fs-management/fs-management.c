@@ -250,6 +250,99 @@ static bool mount_fsck(void) {
     END_TEST;
 }
 
+static bool mount_snapshot(void) {
+    const char* ramdisk_name = "mount_snapshot";
+    char ramdisk_path[PATH_MAX];
+    const char* mount_path = "/tmp/mount_snapshot";
+    const char* file_path = "/tmp/mount_snapshot/file";
+
+    BEGIN_TEST;
+    ASSERT_EQ(create_ramdisk(ramdisk_name, ramdisk_path, 512, 1 << 16), 0, "");
+    ASSERT_EQ(mkfs(ramdisk_path, DISK_FORMAT_MINFS, launch_stdio_sync, &default_mkfs_options), NO_ERROR, "");
+    ASSERT_EQ(mkdir(mount_path, 0666), 0, "");
+    int fd = open(ramdisk_path, O_RDWR);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(mount(fd, mount_path, DISK_FORMAT_MINFS, &default_mount_options,
+                    launch_stdio_async),
+              NO_ERROR, "");
+
+    fd = open(file_path, O_CREAT | O_RDWR);
+    ASSERT_GT(fd, 0, "");
+    char buf[4096];
+    memset(buf, 'a', sizeof(buf));
+    ASSERT_EQ(write(fd, buf, sizeof(buf)), (ssize_t)sizeof(buf), "");
+    ASSERT_EQ(close(fd), 0, "");
+
+    int mountfd = open(mount_path, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(mountfd, 0, "Couldn't open mounted filesystem");
+    mx_handle_t meta_vmo;
+    ASSERT_EQ(ioctl_vfs_snapshot_create(mountfd, &meta_vmo),
+              (ssize_t)sizeof(meta_vmo), "Couldn't create snapshot");
+    // A second snapshot cannot be created while one is active
+    mx_handle_t dup;
+    ASSERT_NEQ(ioctl_vfs_snapshot_create(mountfd, &dup),
+               (ssize_t)sizeof(dup), "");
+
+    // Mutate the filesystem while the snapshot pins the old blocks:
+    // overwrite in place, then delete.
+    fd = open(file_path, O_RDWR);
+    ASSERT_GT(fd, 0, "");
+    memset(buf, 'b', sizeof(buf));
+    ASSERT_EQ(write(fd, buf, sizeof(buf)), (ssize_t)sizeof(buf), "");
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink(file_path), 0, "");
+
+    ASSERT_EQ(ioctl_vfs_snapshot_release(mountfd), NO_ERROR, "");
+    ASSERT_EQ(ioctl_vfs_snapshot_release(mountfd), ERR_BAD_STATE, "");
+    ASSERT_EQ(mx_handle_close(meta_vmo), NO_ERROR, "");
+    ASSERT_EQ(close(mountfd), 0, "");
+
+    // The deferred frees must leave a consistent bitmap behind.
+    ASSERT_EQ(umount(mount_path), NO_ERROR, "");
+    ASSERT_EQ(fsck(ramdisk_path, DISK_FORMAT_MINFS, &default_fsck_options, launch_stdio_sync),
+              NO_ERROR, "");
+    ASSERT_EQ(destroy_ramdisk(ramdisk_path), 0, "");
+    ASSERT_EQ(unlink(mount_path), 0, "");
+    END_TEST;
+}
+
+static bool mount_service_remount(void) {
+    const char* ramdisk_name = "mount_service";
+    char ramdisk_path[PATH_MAX];
+    const char* mount_path = "/tmp/mount_service";
+
+    BEGIN_TEST;
+    ASSERT_EQ(create_ramdisk(ramdisk_name, ramdisk_path, 512, 1 << 16), 0, "");
+    ASSERT_EQ(mkfs(ramdisk_path, DISK_FORMAT_MINFS, launch_stdio_sync, &default_mkfs_options), NO_ERROR, "");
+    ASSERT_EQ(mkdir(mount_path, 0666), 0, "");
+
+    mx_handle_t control;
+    ASSERT_EQ(fs_server_start(DISK_FORMAT_MINFS, &default_mount_options,
+                              launch_stdio_async, &control),
+              NO_ERROR, "Could not launch resident server");
+
+    int mountfd = open(mount_path, O_RDONLY | O_DIRECTORY);
+    ASSERT_GT(mountfd, 0, "Couldn't open mount point");
+
+    // One server should handle repeated mounts; the later iterations remount
+    // a device the server has already seen.
+    for (size_t i = 0; i < 10; i++) {
+        int fd = open(ramdisk_path, O_RDWR);
+        ASSERT_GE(fd, 0, "");
+        ASSERT_EQ(fs_server_fmount(control, fd, mountfd, &default_mount_options),
+                  NO_ERROR, "");
+        ASSERT_TRUE(check_mounted_fs(mount_path, "minfs", strlen("minfs")), "");
+        ASSERT_EQ(fumount(mountfd), NO_ERROR, "");
+    }
+    ASSERT_TRUE(check_mounted_fs(mount_path, "memfs", strlen("memfs")), "");
+
+    ASSERT_EQ(fs_server_shutdown(control), NO_ERROR, "");
+    ASSERT_EQ(close(mountfd), 0, "Couldn't close ex-mount point");
+    ASSERT_EQ(destroy_ramdisk(ramdisk_path), 0, "");
+    ASSERT_EQ(unlink(mount_path), 0, "");
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(fs_management_tests)
 RUN_TEST_MEDIUM(mount_unmount)
 RUN_TEST_MEDIUM(mount_mkdir_unmount)
@@ -257,6 +350,8 @@ RUN_TEST_MEDIUM(fmount_funmount)
 RUN_TEST_MEDIUM(mount_evil_memfs)
 RUN_TEST_MEDIUM(mount_evil_minfs)
 RUN_TEST_MEDIUM(mount_remount)
+RUN_TEST_MEDIUM(mount_service_remount)
+RUN_TEST_MEDIUM(mount_snapshot)
 RUN_TEST_MEDIUM(mount_fsck)
 END_TEST_CASE(fs_management_tests)
 
@@ -24,6 +24,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/test-dot-dot.c \
     $(LOCAL_DIR)/test-link.c \
     $(LOCAL_DIR)/test-maxfile.c \
+    $(LOCAL_DIR)/test-mmap.c \
     $(LOCAL_DIR)/test-overflow.c \
     $(LOCAL_DIR)/test-persist.cpp \
     $(LOCAL_DIR)/test-rw-workers.c \
@@ -0,0 +1,127 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
+#include <mxio/io.h>
+
+#include "filesystems.h"
+#include "misc.h"
+
+// Ask the filesystem for a VMO backed by a file's contents (the transport
+// underneath mmap), map it, and check that it observes the file contents.
+bool test_mmap_basic(void) {
+    BEGIN_TEST;
+
+    int fd = open("::mmapfile", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+
+    // A couple of blocks plus a partial tail, so both the block-aligned and
+    // unaligned paths get exercised.
+    char data[17000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char)(i * 31 + (i >> 8));
+    }
+    ASSERT_STREAM_ALL(write, fd, data, sizeof(data));
+
+    mx_handle_t vmo;
+    mx_status_t status = mxio_get_exact_vmo(fd, &vmo);
+    if (status == ERR_NOT_SUPPORTED) {
+        // Filesystem cannot serve VMOs directly; nothing more to check.
+        ASSERT_EQ(close(fd), 0, "");
+        ASSERT_EQ(unlink("::mmapfile"), 0, "");
+        END_TEST;
+    }
+    ASSERT_EQ(status, NO_ERROR, "");
+
+    size_t len = (sizeof(data) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    uintptr_t addr;
+    ASSERT_EQ(mx_vmar_map(mx_vmar_root_self(), 0, vmo, 0, len,
+                          MX_VM_FLAG_PERM_READ, &addr), NO_ERROR, "");
+    ASSERT_EQ(memcmp((void*)addr, data, sizeof(data)), 0, "");
+
+    // The mapping is a snapshot: it must stay mapped and readable after the
+    // file is closed and unlinked.
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::mmapfile"), 0, "");
+    ASSERT_EQ(memcmp((void*)addr, data, sizeof(data)), 0, "");
+
+    ASSERT_EQ(mx_vmar_unmap(mx_vmar_root_self(), addr, len), NO_ERROR, "");
+    ASSERT_EQ(mx_handle_close(vmo), NO_ERROR, "");
+
+    END_TEST;
+}
+
+// Reads through the fd and the mapping should agree when interleaved.
+bool test_mmap_after_read(void) {
+    BEGIN_TEST;
+
+    int fd = open("::mmapread", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+
+    char data[9000];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (char)(0x55 ^ i);
+    }
+    ASSERT_STREAM_ALL(write, fd, data, sizeof(data));
+
+    // Touch a small window through read() first, so the file is only
+    // partially resident in the server's cache when the VMO is requested.
+    char buf[100];
+    ASSERT_EQ(lseek(fd, 4000, SEEK_SET), 4000, "");
+    ASSERT_STREAM_ALL(read, fd, buf, sizeof(buf));
+    ASSERT_EQ(memcmp(buf, data + 4000, sizeof(buf)), 0, "");
+
+    mx_handle_t vmo;
+    mx_status_t status = mxio_get_exact_vmo(fd, &vmo);
+    if (status == ERR_NOT_SUPPORTED) {
+        ASSERT_EQ(close(fd), 0, "");
+        ASSERT_EQ(unlink("::mmapread"), 0, "");
+        END_TEST;
+    }
+    ASSERT_EQ(status, NO_ERROR, "");
+
+    size_t len = (sizeof(data) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    uintptr_t addr;
+    ASSERT_EQ(mx_vmar_map(mx_vmar_root_self(), 0, vmo, 0, len,
+                          MX_VM_FLAG_PERM_READ, &addr), NO_ERROR, "");
+    ASSERT_EQ(memcmp((void*)addr, data, sizeof(data)), 0, "");
+
+    ASSERT_EQ(mx_vmar_unmap(mx_vmar_root_self(), addr, len), NO_ERROR, "");
+    ASSERT_EQ(mx_handle_close(vmo), NO_ERROR, "");
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::mmapread"), 0, "");
+
+    END_TEST;
+}
+
+// Directories cannot be mapped.
+bool test_mmap_directory(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(mkdir("::mmapdir", 0755), 0, "");
+    int fd = open("::mmapdir", O_RDONLY | O_DIRECTORY, 0644);
+    ASSERT_GT(fd, 0, "");
+
+    mx_handle_t vmo;
+    ASSERT_NEQ(mxio_get_exact_vmo(fd, &vmo), NO_ERROR, "");
+
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::mmapdir"), 0, "");
+
+    END_TEST;
+}
+
+RUN_FOR_ALL_FILESYSTEMS(mmap_tests,
+    RUN_TEST_MEDIUM(test_mmap_basic)
+    RUN_TEST_MEDIUM(test_mmap_after_read)
+    RUN_TEST_MEDIUM(test_mmap_directory)
+)
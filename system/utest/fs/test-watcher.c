@@ -49,6 +49,81 @@ bool check_for_watched(mx_handle_t h, const char* expected, size_t expected_len)
     return true;
 }
 
+// Drain 'count' ADDED events for names "f0".."fN" off the channel.  The
+// server may pack several events into a single message.
+bool check_for_watched_batch(mx_handle_t h, unsigned count) {
+    bool seen[count];
+    memset(seen, 0, sizeof(seen));
+    unsigned remaining = count;
+    while (remaining > 0) {
+        mx_signals_t observed;
+        ASSERT_EQ(mx_object_wait_one(h, MX_CHANNEL_READABLE,
+                                     mx_deadline_after(MX_SEC(5)), &observed),
+                  NO_ERROR, "");
+        ASSERT_EQ(observed & MX_CHANNEL_READABLE, MX_CHANNEL_READABLE, "");
+
+        uint8_t msg[VFS_WATCH_MSG_MAX];
+        uint32_t actual;
+        ASSERT_EQ(mx_channel_read(h, 0, msg, NULL, sizeof(msg), 0, &actual, NULL),
+                  NO_ERROR, "");
+        uint8_t* p = msg;
+        while (actual >= 2) {
+            uint8_t len = p[1];
+            ASSERT_LE(len + 2u, actual, "");
+            ASSERT_EQ(p[0], VFS_WATCH_EVT_ADDED, "");
+            ASSERT_EQ(len, 2, "");
+            ASSERT_EQ(p[2], 'f', "");
+            unsigned idx = p[3] - '0';
+            ASSERT_LT(idx, count, "");
+            ASSERT_FALSE(seen[idx], "");
+            seen[idx] = true;
+            remaining--;
+            p += len + 2;
+            actual -= len + 2;
+        }
+    }
+    return true;
+}
+
+bool test_watcher_batch(void) {
+    BEGIN_TEST;
+
+    if (!test_info->supports_watchers) {
+        return true;
+    }
+
+    ASSERT_EQ(mkdir("::dir", 0666), 0, "");
+    DIR* dir = opendir("::dir");
+    ASSERT_NONNULL(dir, "");
+    mx_handle_t h;
+    ASSERT_EQ(ioctl_vfs_watch_dir(dirfd(dir), &h), (ssize_t) sizeof(mx_handle_t), "");
+
+    // Create a burst of files without draining the channel; every event
+    // should still be observed, however the server chooses to pack them.
+    for (unsigned n = 0; n < 10; n++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::dir/f%u", n);
+        int fd = open(path, O_RDWR | O_CREAT);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(close(fd), 0, "");
+    }
+    ASSERT_TRUE(check_for_watched_batch(h, 10), "");
+
+    // Clean up
+    for (unsigned n = 0; n < 10; n++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::dir/f%u", n);
+        ASSERT_EQ(unlink(path), 0, "");
+    }
+    ASSERT_TRUE(check_for_empty(h), "");
+    ASSERT_EQ(mx_handle_close(h), 0, "");
+
+    ASSERT_EQ(closedir(dir), 0, "");
+    ASSERT_EQ(rmdir("::dir"), 0, "");
+
+    END_TEST;
+}
+
 bool test_watcher_basic(void) {
     BEGIN_TEST;
 
@@ -95,4 +170,5 @@ bool test_watcher_basic(void) {
 
 RUN_FOR_ALL_FILESYSTEMS(directory_watcher_tests,
     RUN_TEST_MEDIUM(test_watcher_basic)
+    RUN_TEST_MEDIUM(test_watcher_batch)
 )
@@ -0,0 +1,162 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mxtl/epoch_reclaimer.h>
+
+#include <mxalloc/new.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+using Reclaimer = mxtl::EpochReclaimer<4>;
+
+struct TestObj {
+    // Keep the node first so the deleter's cast back is trivial.
+    Reclaimer::RetireNode node;
+
+    static size_t deleted_count;
+    static void Deleter(Reclaimer::RetireNode* node) {
+        ++deleted_count;
+        delete reinterpret_cast<TestObj*>(node);
+    }
+};
+
+size_t TestObj::deleted_count = 0;
+
+bool epoch_reclaimer_basic_test() {
+    BEGIN_TEST;
+
+    TestObj::deleted_count = 0;
+    {
+        Reclaimer gc;
+        Reclaimer::Slot* slot = gc.ClaimSlot();
+        ASSERT_NONNULL(slot, "");
+
+        constexpr size_t kObjCount = 16;
+        for (size_t i = 0; i < kObjCount; ++i) {
+            AllocChecker ac;
+            TestObj* obj = new (&ac) TestObj;
+            ASSERT_TRUE(ac.check(), "");
+            slot->Retire(&obj->node, TestObj::Deleter);
+        }
+
+        // Nothing can be freed until the epoch has advanced twice past
+        // the retiring epoch.
+        EXPECT_EQ(0u, TestObj::deleted_count, "");
+        slot->Quiesce();
+        EXPECT_EQ(0u, TestObj::deleted_count, "");
+        slot->Quiesce();
+        slot->Quiesce();
+        EXPECT_EQ(kObjCount, TestObj::deleted_count, "");
+    }
+
+    END_TEST;
+}
+
+bool epoch_reclaimer_pinned_reader_test() {
+    BEGIN_TEST;
+
+    TestObj::deleted_count = 0;
+    Reclaimer gc;
+    Reclaimer::Slot* writer = gc.ClaimSlot();
+    Reclaimer::Slot* reader = gc.ClaimSlot();
+    ASSERT_NONNULL(writer, "");
+    ASSERT_NONNULL(reader, "");
+
+    // A reader pinned in the retiring epoch keeps the object alive no
+    // matter how often the writer quiesces.
+    reader->Enter();
+    {
+        AllocChecker ac;
+        TestObj* obj = new (&ac) TestObj;
+        ASSERT_TRUE(ac.check(), "");
+        writer->Retire(&obj->node, TestObj::Deleter);
+    }
+    for (size_t i = 0; i < 8; ++i)
+        writer->Quiesce();
+    EXPECT_EQ(0u, TestObj::deleted_count, "");
+
+    // Once the reader leaves its critical region the epoch can advance
+    // far enough to free the object.
+    reader->Exit();
+    writer->Quiesce();
+    writer->Quiesce();
+    writer->Quiesce();
+    EXPECT_EQ(1u, TestObj::deleted_count, "");
+
+    END_TEST;
+}
+
+bool epoch_reclaimer_guard_test() {
+    BEGIN_TEST;
+
+    TestObj::deleted_count = 0;
+    Reclaimer gc;
+    Reclaimer::Slot* writer = gc.ClaimSlot();
+    Reclaimer::Slot* reader = gc.ClaimSlot();
+    ASSERT_NONNULL(writer, "");
+    ASSERT_NONNULL(reader, "");
+
+    {
+        Reclaimer::Guard guard(reader);
+
+        AllocChecker ac;
+        TestObj* obj = new (&ac) TestObj;
+        ASSERT_TRUE(ac.check(), "");
+        writer->Retire(&obj->node, TestObj::Deleter);
+
+        for (size_t i = 0; i < 4; ++i)
+            writer->Quiesce();
+        EXPECT_EQ(0u, TestObj::deleted_count, "");
+    }
+
+    writer->Quiesce();
+    writer->Quiesce();
+    writer->Quiesce();
+    EXPECT_EQ(1u, TestObj::deleted_count, "");
+
+    END_TEST;
+}
+
+bool epoch_reclaimer_slot_exhaustion_test() {
+    BEGIN_TEST;
+
+    mxtl::EpochReclaimer<2> gc;
+    EXPECT_NONNULL(gc.ClaimSlot(), "");
+    EXPECT_NONNULL(gc.ClaimSlot(), "");
+    EXPECT_NULL(gc.ClaimSlot(), "");
+
+    END_TEST;
+}
+
+bool epoch_reclaimer_destructor_drain_test() {
+    BEGIN_TEST;
+
+    TestObj::deleted_count = 0;
+    {
+        Reclaimer gc;
+        Reclaimer::Slot* slot = gc.ClaimSlot();
+        ASSERT_NONNULL(slot, "");
+
+        AllocChecker ac;
+        TestObj* obj = new (&ac) TestObj;
+        ASSERT_TRUE(ac.check(), "");
+        slot->Retire(&obj->node, TestObj::Deleter);
+
+        // The reclaimer's destructor drains whatever is still pending.
+    }
+    EXPECT_EQ(1u, TestObj::deleted_count, "");
+
+    END_TEST;
+}
+
+}  // namespace
+
+BEGIN_TEST_CASE(epoch_reclaimer_tests)
+RUN_NAMED_TEST("EpochReclaimer basic retire/advance test", epoch_reclaimer_basic_test)
+RUN_NAMED_TEST("EpochReclaimer pinned reader test", epoch_reclaimer_pinned_reader_test)
+RUN_NAMED_TEST("EpochReclaimer guard test", epoch_reclaimer_guard_test)
+RUN_NAMED_TEST("EpochReclaimer slot exhaustion test", epoch_reclaimer_slot_exhaustion_test)
+RUN_NAMED_TEST("EpochReclaimer destructor drain test", epoch_reclaimer_destructor_drain_test)
+END_TEST_CASE(epoch_reclaimer_tests);
@@ -421,6 +421,176 @@ static bool WAVLBalanceTest() {
     END_TEST;
 }
 
+// Test objects for the bulk build and subtree size (order statistic) tests.
+// Like the balance test objects, these use the int32_t rank storage (so that
+// the sanity checker can verify the rank rule) but extend the node state with
+// subtree size bookkeeping.
+class SizedTestObj;
+
+using SizedTestObjPtr = unique_ptr<SizedTestObj>;
+using SizedTestTree   = WAVLTree<BalanceTestKeyType,
+                                 SizedTestObjPtr,
+                                 DefaultKeyedObjectTraits<BalanceTestKeyType, SizedTestObj>,
+                                 DefaultWAVLTreeTraits<SizedTestObjPtr, int32_t>,
+                                 WAVLBalanceTestObserver>;
+
+class SizedTestObj {
+public:
+    void Init(BalanceTestKeyType val) { key_ = val; }
+    BalanceTestKeyType GetKey() const { return key_; }
+    bool InContainer() const { return wavl_node_state_.InContainer(); }
+
+private:
+    friend DefaultWAVLTreeTraits<SizedTestObjPtr, int32_t>;
+
+    static void operator delete(void* ptr) {
+        // Deliberate no-op
+    }
+    friend class mxtl::unique_ptr<SizedTestObj[]>;
+    friend class mxtl::unique_ptr<SizedTestObj>;
+
+    BalanceTestKeyType key_;
+    WAVLTreeSizedNodeState<SizedTestObjPtr, int32_t> wavl_node_state_;
+};
+
+static constexpr size_t kSizedTestMaxSize = 257;
+
+// Verify that every element of the tree can be round-tripped through the order
+// statistic operations; select(ndx) must return the ndx'th smallest element,
+// and index_of must be its inverse.
+static bool VerifyOrderStatistics(const SizedTestTree& tree) {
+    BEGIN_TEST;
+
+    size_t ndx = 0;
+    for (const auto& obj : tree) {
+        auto iter = tree.select(ndx);
+        ASSERT_TRUE(iter != tree.end(), "");
+        EXPECT_EQ(&obj, &*iter, "");
+        EXPECT_EQ(ndx, tree.index_of(obj), "");
+        ++ndx;
+    }
+
+    EXPECT_EQ(tree.size(), ndx, "");
+    EXPECT_TRUE(tree.select(tree.size()) == tree.end(), "");
+
+    END_TEST;
+}
+
+static bool WAVLBulkBuildTest() {
+    BEGIN_TEST;
+
+    // Declare these in a specific order (object pointer first) so that the
+    // tree has a chance to clean up before the memory backing the objects gets
+    // cleaned up.
+    unique_ptr<SizedTestObj[]>  objects;
+    unique_ptr<SizedTestObjPtr[]> sorted;
+    SizedTestTree tree;
+
+    {
+        AllocChecker ac;
+        objects.reset(new (&ac) SizedTestObj[kSizedTestMaxSize]);
+        ASSERT_TRUE(ac.check(), "Failed to allocate test objects!");
+        sorted.reset(new (&ac) SizedTestObjPtr[kSizedTestMaxSize]);
+        ASSERT_TRUE(ac.check(), "Failed to allocate sorted pointer array!");
+    }
+
+    // Exercise a selection of sizes, paying special attention to the powers of
+    // two (perfect trees) and their immediate neighbors.
+    static const size_t sizes[] = { 1, 2, 3, 4, 7, 8, 9, 15, 16, 17, 63, 64, 100, 256, 257 };
+
+    for (size_t size_ndx = 0; size_ndx < countof(sizes); ++size_ndx) {
+        size_t size = sizes[size_ndx];
+        ASSERT_GE(kSizedTestMaxSize, size, "");
+
+        WAVLBalanceTestObserver::ResetObserverOpCounts();
+
+        for (size_t i = 0; i < size; ++i) {
+            objects[i].Init((i * 2) + 1);
+            sorted[i] = SizedTestObjPtr(&objects[i]);
+        }
+
+        // Build the tree, then make certain that it obeys all of the WAVL
+        // invariants and that it enumerates the elements in order.
+        tree.bulk_build(sorted.get(), size);
+        ASSERT_EQ(size, tree.size(), "");
+        ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+
+        size_t ndx = 0;
+        for (const auto& obj : tree) {
+            EXPECT_EQ((ndx * 2) + 1, obj.GetKey(), "");
+            ++ndx;
+        }
+        EXPECT_EQ(size, ndx, "");
+
+        EXPECT_TRUE(VerifyOrderStatistics(tree), "");
+
+        // Make sure that a bulk-built tree behaves properly when subsequently
+        // mutated with ordinary insert and erase operations.
+        if (size > 1) {
+            SizedTestObjPtr erased = tree.erase(objects[size >> 1].GetKey());
+            ASSERT_NONNULL(erased.get(), "");
+            ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+            EXPECT_TRUE(VerifyOrderStatistics(tree), "");
+
+            ASSERT_TRUE(tree.insert_or_find(mxtl::move(erased)), "");
+            ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+            EXPECT_TRUE(VerifyOrderStatistics(tree), "");
+        }
+
+        tree.clear();
+        ASSERT_EQ(0u, tree.size(), "");
+    }
+
+    END_TEST;
+}
+
+static bool WAVLSubtreeSizeTest() {
+    BEGIN_TEST;
+
+    unique_ptr<SizedTestObj[]> objects;
+    SizedTestTree tree;
+
+    {
+        AllocChecker ac;
+        objects.reset(new (&ac) SizedTestObj[kSizedTestMaxSize]);
+        ASSERT_TRUE(ac.check(), "Failed to allocate test objects!");
+    }
+
+    WAVLBalanceTestObserver::ResetObserverOpCounts();
+
+    // Insert all of the objects in ascending key order (this exercises the
+    // rotation paths), checking the order statistics as the tree grows.
+    for (size_t i = 0; i < kSizedTestMaxSize; ++i) {
+        objects[i].Init(i);
+        ASSERT_TRUE(tree.insert_or_find(SizedTestObjPtr(&objects[i])), "");
+    }
+    ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+    EXPECT_TRUE(VerifyOrderStatistics(tree), "");
+
+    // Erase every other element (this exercises the erase rebalancing paths),
+    // then verify that select still enumerates the survivors in order.
+    for (size_t i = 0; i < kSizedTestMaxSize; i += 2)
+        ASSERT_NONNULL(tree.erase(objects[i]).get(), "");
+    ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+
+    for (size_t ndx = 0; ndx < tree.size(); ++ndx) {
+        auto iter = tree.select(ndx);
+        ASSERT_TRUE(iter != tree.end(), "");
+        EXPECT_EQ((ndx * 2) + 1, iter->GetKey(), "");
+    }
+    EXPECT_TRUE(VerifyOrderStatistics(tree), "");
+
+    // Put the erased elements back and make sure everything still lines up.
+    for (size_t i = 0; i < kSizedTestMaxSize; i += 2)
+        ASSERT_TRUE(tree.insert_or_find(SizedTestObjPtr(&objects[i])), "");
+    ASSERT_TRUE(WAVLTreeChecker::SanityCheck(tree), "");
+    EXPECT_TRUE(VerifyOrderStatistics(tree), "");
+
+    tree.clear();
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(wavl_tree_tests)
 //////////////////////////////////////////
 // General container specific tests.
@@ -540,6 +710,8 @@ RUN_NAMED_TEST("LowerBound (RefPtr)",            RPTE::LowerBoundTest)
 // WAVLTree specific tests.
 ////////////////////////////
 RUN_NAMED_TEST("BalanceTest", WAVLBalanceTest)
+RUN_NAMED_TEST("BulkBuildTest", WAVLBulkBuildTest)
+RUN_NAMED_TEST("SubtreeSizeTest", WAVLSubtreeSizeTest)
 
 END_TEST_CASE(wavl_tree_tests);
 
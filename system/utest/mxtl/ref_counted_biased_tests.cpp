@@ -0,0 +1,122 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mxalloc/new.h>
+#include <pthread.h>
+#include <unittest/unittest.h>
+#include <mxtl/ref_counted_biased.h>
+#include <mxtl/ref_ptr.h>
+
+namespace {
+
+class BiasedTracker : public mxtl::RefCountedBiased<BiasedTracker> {
+public:
+    explicit BiasedTracker(bool* destroyed)
+        : destroyed_(destroyed) {}
+    ~BiasedTracker() { *destroyed_ = true; }
+
+private:
+    bool* destroyed_;
+};
+
+// Takes and drops balanced references from a non-owner thread.
+void* biased_inc_and_dec(void* arg) {
+    BiasedTracker* tracker = reinterpret_cast<BiasedTracker*>(arg);
+    for (size_t i = 0u; i < 500; ++i) {
+        mxtl::RefPtr<BiasedTracker> ptr(tracker);
+    }
+    return nullptr;
+}
+
+// Drops a reference which was handed off from the owning thread.
+void* biased_release(void* arg) {
+    mxtl::RefPtr<BiasedTracker>* ptr =
+        reinterpret_cast<mxtl::RefPtr<BiasedTracker>*>(arg);
+    ptr->reset();
+    return nullptr;
+}
+
+bool biased_same_thread_test() {
+    BEGIN_TEST;
+
+    bool destroyed = false;
+    {
+        AllocChecker ac;
+        mxtl::RefPtr<BiasedTracker> ptr =
+            mxtl::AdoptRef(new (&ac) BiasedTracker(&destroyed));
+        EXPECT_TRUE(ac.check(), "");
+        EXPECT_FALSE(destroyed, "should not be destroyed");
+
+        // Exercise the owner-thread fast path.
+        for (size_t i = 0u; i < 500; ++i) {
+            mxtl::RefPtr<BiasedTracker> copy(ptr);
+            EXPECT_FALSE(destroyed, "should not be destroyed while copy live");
+        }
+        EXPECT_FALSE(destroyed, "should not be destroyed after inc/dec pairs");
+    }
+    EXPECT_TRUE(destroyed, "should be when RefPtr falls out of scope");
+    END_TEST;
+}
+
+bool biased_cross_thread_test() {
+    BEGIN_TEST;
+
+    bool destroyed = false;
+    {
+        AllocChecker ac;
+        mxtl::RefPtr<BiasedTracker> ptr =
+            mxtl::AdoptRef(new (&ac) BiasedTracker(&destroyed));
+        EXPECT_TRUE(ac.check(), "");
+
+        void* arg = reinterpret_cast<void*>(ptr.get());
+
+        pthread_t threads[5];
+        for (size_t i = 0u; i < countof(threads); ++i) {
+            int res = pthread_create(&threads[i], NULL, &biased_inc_and_dec, arg);
+            ASSERT_LE(0, res, "Failed to create biased_inc_and_dec thread!");
+        }
+
+        biased_inc_and_dec(arg);
+
+        for (size_t i = 0u; i < countof(threads); ++i)
+            pthread_join(threads[i], NULL);
+
+        EXPECT_FALSE(destroyed, "should not be destroyed after inc/dec pairs");
+    }
+    EXPECT_TRUE(destroyed, "should be when RefPtr falls out of scope");
+    END_TEST;
+}
+
+bool biased_merge_and_hand_off_test() {
+    BEGIN_TEST;
+
+    bool destroyed = false;
+
+    AllocChecker ac;
+    mxtl::RefPtr<BiasedTracker> ptr =
+        mxtl::AdoptRef(new (&ac) BiasedTracker(&destroyed));
+    EXPECT_TRUE(ac.check(), "");
+
+    // The last reference will be dropped by another thread, so the bias must
+    // be merged before the hand-off.
+    ptr->MergeBias();
+    EXPECT_FALSE(destroyed, "should not be destroyed by the merge");
+
+    pthread_t thread;
+    int res = pthread_create(&thread, NULL, &biased_release, &ptr);
+    ASSERT_LE(0, res, "Failed to create biased_release thread!");
+    pthread_join(thread, NULL);
+
+    EXPECT_NULL(ptr.get(), "hand-off thread should have consumed the reference");
+    EXPECT_TRUE(destroyed, "should be destroyed by the hand-off thread");
+    END_TEST;
+}
+
+}  // namespace
+
+BEGIN_TEST_CASE(ref_counted_biased_tests)
+RUN_NAMED_TEST("Biased Same Thread", biased_same_thread_test)
+RUN_NAMED_TEST("Biased Cross Thread", biased_cross_thread_test)
+RUN_NAMED_TEST("Biased Merge And Hand Off", biased_merge_and_hand_off_test)
+END_TEST_CASE(ref_counted_biased_tests);
@@ -15,6 +15,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/array_tests.cpp \
     $(LOCAL_DIR)/atomic_tests.cpp \
     $(LOCAL_DIR)/auto_call_tests.cpp \
+    $(LOCAL_DIR)/epoch_reclaimer_tests.cpp \
     $(LOCAL_DIR)/forward_tests.cpp \
     $(LOCAL_DIR)/intrusive_container_tests.cpp \
     $(LOCAL_DIR)/intrusive_doubly_linked_list_tests.cpp \
@@ -24,9 +25,13 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/intrusive_wavl_tree_tests.cpp \
     $(LOCAL_DIR)/main.c \
     $(LOCAL_DIR)/recycler_tests.cpp \
+    $(LOCAL_DIR)/ref_counted_biased_tests.cpp \
     $(LOCAL_DIR)/ref_counted_tests.cpp \
     $(LOCAL_DIR)/ref_ptr_tests.cpp \
+    $(LOCAL_DIR)/sharded_hash_table_tests.cpp \
     $(LOCAL_DIR)/slab_allocator_tests.cpp \
+    $(LOCAL_DIR)/small_string_tests.cpp \
+    $(LOCAL_DIR)/small_vector_tests.cpp \
     $(LOCAL_DIR)/string_piece_tests.cpp \
     $(LOCAL_DIR)/type_support_tests.cpp \
     $(LOCAL_DIR)/unique_free_ptr_tests.cpp \
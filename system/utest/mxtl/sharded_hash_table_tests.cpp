@@ -0,0 +1,147 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mxtl/sharded_hash_table.h>
+
+#include <mxalloc/new.h>
+#include <mxtl/intrusive_single_list.h>
+#include <mxtl/ref_counted.h>
+#include <mxtl/ref_ptr.h>
+#include <mxtl/unique_ptr.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+constexpr size_t kTestObjCount = 128;
+
+class UnmanagedObj
+    : public mxtl::SinglyLinkedListable<UnmanagedObj*> {
+public:
+    explicit UnmanagedObj(size_t key) : key_(key) {}
+
+    size_t GetKey() const { return key_; }
+    static size_t GetHash(const size_t& key) { return key * 2654435761u; }
+
+private:
+    const size_t key_;
+};
+
+class ManagedObj
+    : public mxtl::RefCounted<ManagedObj>,
+      public mxtl::SinglyLinkedListable<mxtl::RefPtr<ManagedObj>> {
+public:
+    explicit ManagedObj(size_t key) : key_(key) { ++live_count; }
+    ~ManagedObj() { --live_count; }
+
+    size_t GetKey() const { return key_; }
+    static size_t GetHash(const size_t& key) { return key * 2654435761u; }
+
+    static size_t live_count;
+
+private:
+    const size_t key_;
+};
+
+size_t ManagedObj::live_count = 0;
+
+using UnmanagedTable = mxtl::ShardedHashTable<size_t, UnmanagedObj*>;
+using ManagedTable   = mxtl::ShardedHashTable<size_t, mxtl::RefPtr<ManagedObj>>;
+
+bool sharded_hash_table_unmanaged_test() {
+    BEGIN_TEST;
+
+    mxtl::unique_ptr<UnmanagedObj> storage[kTestObjCount];
+    UnmanagedTable table;
+
+    ASSERT_TRUE(table.is_empty(), "");
+    for (size_t i = 0; i < kTestObjCount; ++i) {
+        AllocChecker ac;
+        storage[i].reset(new (&ac) UnmanagedObj(i));
+        ASSERT_TRUE(ac.check(), "");
+        table.insert(storage[i].get());
+    }
+
+    EXPECT_FALSE(table.is_empty(), "");
+    EXPECT_EQ(kTestObjCount, table.size_slow(), "");
+
+    // Every key should come back as exactly the pointer which went in;
+    // keys never inserted should come back null.
+    for (size_t i = 0; i < kTestObjCount; ++i)
+        EXPECT_EQ(storage[i].get(), table.find(i), "");
+    EXPECT_NULL(table.find(kTestObjCount), "");
+
+    // Erase the even keys by key and one odd key by object reference.
+    for (size_t i = 0; i < kTestObjCount; i += 2)
+        EXPECT_EQ(storage[i].get(), table.erase(i), "");
+    EXPECT_EQ(storage[1].get(), table.erase(*storage[1]), "");
+    EXPECT_NULL(table.erase(static_cast<size_t>(0)), "");
+
+    EXPECT_EQ(kTestObjCount / 2 - 1, table.size_slow(), "");
+    EXPECT_NULL(table.find(2), "");
+    EXPECT_EQ(storage[3].get(), table.find(3), "");
+
+    table.clear();
+    EXPECT_TRUE(table.is_empty(), "");
+    EXPECT_EQ(0u, table.size_slow(), "");
+
+    END_TEST;
+}
+
+bool sharded_hash_table_managed_test() {
+    BEGIN_TEST;
+
+    ASSERT_EQ(0u, ManagedObj::live_count, "");
+    {
+        ManagedTable table;
+
+        for (size_t i = 0; i < kTestObjCount; ++i) {
+            AllocChecker ac;
+            mxtl::RefPtr<ManagedObj> obj =
+                mxtl::AdoptRef(new (&ac) ManagedObj(i));
+            ASSERT_TRUE(ac.check(), "");
+            table.insert(mxtl::move(obj));
+        }
+        EXPECT_EQ(kTestObjCount, ManagedObj::live_count, "");
+        EXPECT_EQ(kTestObjCount, table.size_slow(), "");
+
+        // find hands back a new reference which keeps the object alive
+        // independently of the table.
+        mxtl::RefPtr<ManagedObj> held = table.find(7);
+        ASSERT_NONNULL(held.get(), "");
+        EXPECT_EQ(7u, held->GetKey(), "");
+        EXPECT_EQ(held.get(), table.erase(7u).get(), "");
+        EXPECT_NULL(table.find(7).get(), "");
+        EXPECT_EQ(kTestObjCount, ManagedObj::live_count, "");
+        held.reset();
+        EXPECT_EQ(kTestObjCount - 1, ManagedObj::live_count, "");
+
+        // A colliding insert_or_find leaves the original in place and
+        // reports it to the caller.
+        AllocChecker ac;
+        mxtl::RefPtr<ManagedObj> dup = mxtl::AdoptRef(new (&ac) ManagedObj(11));
+        ASSERT_TRUE(ac.check(), "");
+        mxtl::RefPtr<ManagedObj> collided;
+        EXPECT_FALSE(table.insert_or_find(mxtl::move(dup), &collided), "");
+        ASSERT_NONNULL(collided.get(), "");
+        EXPECT_EQ(collided.get(), table.find(11).get(), "");
+
+        // ...while a non-colliding one inserts.
+        mxtl::RefPtr<ManagedObj> fresh = mxtl::AdoptRef(new (&ac) ManagedObj(7));
+        ASSERT_TRUE(ac.check(), "");
+        EXPECT_TRUE(table.insert_or_find(mxtl::move(fresh)), "");
+        EXPECT_NONNULL(table.find(7).get(), "");
+
+        // Destroying the table drops the last references.
+    }
+    EXPECT_EQ(0u, ManagedObj::live_count, "");
+
+    END_TEST;
+}
+
+}  // namespace
+
+BEGIN_TEST_CASE(sharded_hash_table_tests)
+RUN_NAMED_TEST("ShardedHashTable unmanaged pointer test", sharded_hash_table_unmanaged_test)
+RUN_NAMED_TEST("ShardedHashTable managed pointer test", sharded_hash_table_managed_test)
+END_TEST_CASE(sharded_hash_table_tests);
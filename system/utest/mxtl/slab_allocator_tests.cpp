@@ -118,11 +118,13 @@ struct ReleaseHelper<SATraits, typename mxtl::enable_if<
 
 // Traits which define the various test flavors.
 template <typename LockType,
-          mxtl::SlabAllocatorFlavor AllocatorFlavor = mxtl::SlabAllocatorFlavor::INSTANCED>
+          mxtl::SlabAllocatorFlavor AllocatorFlavor = mxtl::SlabAllocatorFlavor::INSTANCED,
+          bool EnableLocalCache = false>
 struct UnmanagedTestTraits {
     class ObjType;
     using PtrType       = ObjType*;
-    using AllocTraits   = mxtl::SlabAllocatorTraits<PtrType, 1024, LockType, AllocatorFlavor>;
+    using AllocTraits   = mxtl::SlabAllocatorTraits<PtrType, 1024, LockType, AllocatorFlavor,
+                                                    EnableLocalCache>;
     using AllocatorType = mxtl::SlabAllocator<AllocTraits>;
     using RefList       = mxtl::DoublyLinkedList<PtrType>;
 
@@ -165,11 +167,13 @@ struct UniquePtrTestTraits {
     static constexpr size_t MaxAllocs(size_t slabs) { return AllocatorType::AllocsPerSlab * slabs; }
 };
 
-template <typename LockType>
+template <typename LockType, bool EnableLocalCache = false>
 struct RefPtrTestTraits {
     class ObjType;
     using PtrType       = mxtl::RefPtr<ObjType>;
-    using AllocTraits   = mxtl::SlabAllocatorTraits<PtrType, 1024, LockType>;
+    using AllocTraits   = mxtl::SlabAllocatorTraits<PtrType, 1024, LockType,
+                                                    mxtl::SlabAllocatorFlavor::INSTANCED,
+                                                    EnableLocalCache>;
     using AllocatorType = mxtl::SlabAllocator<AllocTraits>;
     using RefList       = mxtl::DoublyLinkedList<PtrType>;
 
@@ -456,6 +460,12 @@ RUN_NAMED_TEST("UniquePtr Multi Slab  (unlock)", (slab_test<UniquePtrTestTraits<
 RUN_NAMED_TEST("RefPtr Single Slab    (unlock)", (slab_test<RefPtrTestTraits<NullLock>, 1>))
 RUN_NAMED_TEST("RefPtr Multi Slab     (unlock)", (slab_test<RefPtrTestTraits<NullLock>>))
 
+RUN_NAMED_TEST("Unmanaged Multi Slab  (cached)",
+              (slab_test<UnmanagedTestTraits<MutexLock,
+                                             mxtl::SlabAllocatorFlavor::INSTANCED,
+                                             true>>))
+RUN_NAMED_TEST("RefPtr Multi Slab     (cached)", (slab_test<RefPtrTestTraits<MutexLock, true>>))
+
 RUN_NAMED_TEST("Manual Delete Unmanaged (mutex)",
               (slab_test<UnmanagedTestTraits<MutexLock, mxtl::SlabAllocatorFlavor::MANUAL_DELETE>>))
 RUN_NAMED_TEST("Manual Delete Unmanaged (unlock)",
@@ -0,0 +1,133 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mxtl/small_string.h>
+
+#include <mxtl/type_support.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+bool inline_test() {
+    BEGIN_TEST;
+
+    mxtl::SmallString str;
+    EXPECT_TRUE(str.empty(), "");
+    EXPECT_EQ(0u, str.length(), "");
+    EXPECT_EQ(0, str.c_str()[0], "");
+
+    // A string which fits in the inline storage must not move when modified;
+    // the data pointer always refers to storage inside the object.
+    ASSERT_TRUE(str.Set("short"), "");
+    EXPECT_EQ(5u, str.length(), "");
+    EXPECT_EQ(0, strcmp(str.c_str(), "short"), "");
+
+    const void* obj_begin = &str;
+    const void* obj_end   = &str + 1;
+    EXPECT_TRUE((str.data() >= obj_begin) && (str.data() < obj_end), "");
+
+    ASSERT_TRUE(str.Append("/dev"), "");
+    EXPECT_EQ(0, strcmp(str.c_str(), "short/dev"), "");
+    EXPECT_TRUE((str.data() >= obj_begin) && (str.data() < obj_end), "");
+
+    // Filling the storage exactly to the inline capacity must stay inline.
+    ASSERT_TRUE(str.Set("12345678901234567890123"), "");
+    EXPECT_EQ(mxtl::SmallString::kInlineCapacity, str.length(), "");
+    EXPECT_TRUE((str.data() >= obj_begin) && (str.data() < obj_end), "");
+
+    str.clear();
+    EXPECT_TRUE(str.empty(), "");
+    EXPECT_EQ(0, str.c_str()[0], "");
+
+    END_TEST;
+}
+
+bool spill_test() {
+    BEGIN_TEST;
+
+    mxtl::SmallString str;
+
+    // One character past the inline capacity forces a heap buffer.
+    ASSERT_TRUE(str.Set("123456789012345678901234"), "");
+    EXPECT_EQ(mxtl::SmallString::kInlineCapacity + 1, str.length(), "");
+    EXPECT_EQ(0, strcmp(str.c_str(), "123456789012345678901234"), "");
+
+    const void* obj_begin = &str;
+    const void* obj_end   = &str + 1;
+    EXPECT_FALSE((str.data() >= obj_begin) && (str.data() < obj_end), "");
+
+    // Build a long string with repeated appends and verify the contents.
+    str.clear();
+    for (size_t i = 0; i < 100; ++i)
+        ASSERT_TRUE(str.Append("abcd"), "");
+    ASSERT_EQ(400u, str.length(), "");
+    for (size_t i = 0; i < str.length(); ++i)
+        EXPECT_EQ("abcd"[i % 4], str[i], "");
+
+    // Appending a piece of ourselves must work even if it triggers a regrow.
+    ASSERT_TRUE(str.Set("0123456789"), "");
+    for (size_t i = 0; i < 8; ++i)
+        ASSERT_TRUE(str.Append(str.piece()), "");
+    ASSERT_EQ(2560u, str.length(), "");
+    for (size_t i = 0; i < str.length(); ++i)
+        EXPECT_EQ(static_cast<char>('0' + (i % 10)), str[i], "");
+
+    END_TEST;
+}
+
+bool move_test() {
+    BEGIN_TEST;
+
+    // Moving an inline string copies the bytes and empties the source.
+    mxtl::SmallString a;
+    ASSERT_TRUE(a.Set("inline"), "");
+    mxtl::SmallString b(mxtl::move(a));
+    EXPECT_TRUE(a.empty(), "");
+    EXPECT_EQ(0, strcmp(b.c_str(), "inline"), "");
+
+    // Moving a spilled string steals the heap buffer.
+    mxtl::SmallString c;
+    ASSERT_TRUE(c.Set("this string is much too long for the inline storage"), "");
+    const char* heap_data = c.data();
+    mxtl::SmallString d(mxtl::move(c));
+    EXPECT_TRUE(c.empty(), "");
+    EXPECT_EQ(heap_data, d.data(), "");
+
+    d = mxtl::move(b);
+    EXPECT_TRUE(b.empty(), "");
+    EXPECT_EQ(0, strcmp(d.c_str(), "inline"), "");
+
+    b.swap(d);
+    EXPECT_TRUE(d.empty(), "");
+    EXPECT_EQ(0, strcmp(b.c_str(), "inline"), "");
+
+    END_TEST;
+}
+
+bool compare_test() {
+    BEGIN_TEST;
+
+    mxtl::SmallString a, b;
+    ASSERT_TRUE(a.Set("abc"), "");
+    ASSERT_TRUE(b.Set("abd"), "");
+
+    EXPECT_TRUE(a == a, "");
+    EXPECT_TRUE(a != b, "");
+    EXPECT_GT(0, a.compare(b), "");
+    EXPECT_LT(0, b.compare(a), "");
+    EXPECT_TRUE(a == mxtl::StringPiece("abc"), "");
+    EXPECT_TRUE(mxtl::StringPiece("abd") == b, "");
+    EXPECT_TRUE(a != mxtl::StringPiece("abd"), "");
+
+    END_TEST;
+}
+
+}  // namespace
+
+BEGIN_TEST_CASE(small_string_tests)
+RUN_NAMED_TEST("inline test", inline_test)
+RUN_NAMED_TEST("spill test", spill_test)
+RUN_NAMED_TEST("move test", move_test)
+RUN_NAMED_TEST("compare test", compare_test)
+END_TEST_CASE(small_string_tests);
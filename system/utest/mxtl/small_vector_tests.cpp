@@ -0,0 +1,162 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <mxtl/small_vector.h>
+
+#include <mxtl/type_support.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+// A move-only type which counts live instances so the tests can check that
+// SmallVector constructs and destroys elements correctly.
+class Counted {
+public:
+    Counted() : value_(0) { ++instances_; }
+    explicit Counted(int value) : value_(value) { ++instances_; }
+    ~Counted() { --instances_; }
+
+    Counted(Counted&& other) : value_(other.value_) {
+        other.value_ = -1;
+        ++instances_;
+    }
+
+    Counted& operator=(Counted&& other) {
+        value_ = other.value_;
+        other.value_ = -1;
+        return *this;
+    }
+
+    Counted(const Counted&) = delete;
+    Counted& operator=(const Counted&) = delete;
+
+    int value() const { return value_; }
+    static size_t instances() { return instances_; }
+
+private:
+    int value_;
+    static size_t instances_;
+};
+
+size_t Counted::instances_ = 0;
+
+bool inline_test() {
+    BEGIN_TEST;
+
+    {
+        mxtl::SmallVector<Counted, 4> vec;
+        EXPECT_TRUE(vec.is_empty(), "");
+        EXPECT_EQ(4u, vec.capacity(), "");
+
+        // Elements within the inline capacity live inside the object.
+        for (int i = 0; i < 4; ++i)
+            ASSERT_TRUE(vec.push_back(Counted(i)), "");
+        EXPECT_EQ(4u, vec.size(), "");
+        EXPECT_EQ(4u, vec.capacity(), "");
+        EXPECT_EQ(4u, Counted::instances(), "");
+
+        const void* obj_begin = &vec;
+        const void* obj_end   = &vec + 1;
+        EXPECT_TRUE((static_cast<const void*>(vec.begin()) >= obj_begin) &&
+                    (static_cast<const void*>(vec.begin()) < obj_end), "");
+
+        for (int i = 0; i < 4; ++i)
+            EXPECT_EQ(i, vec[static_cast<size_t>(i)].value(), "");
+
+        Counted last = vec.pop_back();
+        EXPECT_EQ(3, last.value(), "");
+        EXPECT_EQ(3u, vec.size(), "");
+    }
+
+    EXPECT_EQ(0u, Counted::instances(), "");
+
+    END_TEST;
+}
+
+bool spill_test() {
+    BEGIN_TEST;
+
+    {
+        mxtl::SmallVector<Counted, 4> vec;
+
+        // Pushing past the inline capacity spills to the heap and the
+        // elements survive the move to the new storage.
+        for (int i = 0; i < 100; ++i)
+            ASSERT_TRUE(vec.push_back(Counted(i)), "");
+        EXPECT_EQ(100u, vec.size(), "");
+        EXPECT_LE(100u, vec.capacity(), "");
+        EXPECT_EQ(100u, Counted::instances(), "");
+
+        const void* obj_begin = &vec;
+        const void* obj_end   = &vec + 1;
+        EXPECT_FALSE((static_cast<const void*>(vec.begin()) >= obj_begin) &&
+                     (static_cast<const void*>(vec.begin()) < obj_end), "");
+
+        int expected = 0;
+        for (const auto& element : vec)
+            EXPECT_EQ(expected++, element.value(), "");
+
+        // reserve must be able to pre-allocate without disturbing contents.
+        ASSERT_TRUE(vec.reserve(500), "");
+        EXPECT_LE(500u, vec.capacity(), "");
+        EXPECT_EQ(100u, vec.size(), "");
+        EXPECT_EQ(0, vec.front().value(), "");
+        EXPECT_EQ(99, vec.back().value(), "");
+
+        vec.clear();
+        EXPECT_TRUE(vec.is_empty(), "");
+        EXPECT_EQ(0u, Counted::instances(), "");
+    }
+
+    EXPECT_EQ(0u, Counted::instances(), "");
+
+    END_TEST;
+}
+
+bool move_test() {
+    BEGIN_TEST;
+
+    {
+        // Moving an inline vector moves the elements one by one.
+        mxtl::SmallVector<Counted, 4> a;
+        for (int i = 0; i < 3; ++i)
+            ASSERT_TRUE(a.push_back(Counted(i)), "");
+
+        mxtl::SmallVector<Counted, 4> b(mxtl::move(a));
+        EXPECT_TRUE(a.is_empty(), "");
+        ASSERT_EQ(3u, b.size(), "");
+        for (int i = 0; i < 3; ++i)
+            EXPECT_EQ(i, b[static_cast<size_t>(i)].value(), "");
+
+        // Moving a spilled vector steals the heap buffer.
+        mxtl::SmallVector<Counted, 4> c;
+        for (int i = 0; i < 32; ++i)
+            ASSERT_TRUE(c.push_back(Counted(i)), "");
+        const Counted* heap_data = c.begin();
+
+        mxtl::SmallVector<Counted, 4> d(mxtl::move(c));
+        EXPECT_TRUE(c.is_empty(), "");
+        EXPECT_EQ(4u, c.capacity(), "");
+        EXPECT_EQ(heap_data, d.begin(), "");
+        ASSERT_EQ(32u, d.size(), "");
+
+        // Move assignment releases the destination's previous contents.
+        d = mxtl::move(b);
+        EXPECT_TRUE(b.is_empty(), "");
+        ASSERT_EQ(3u, d.size(), "");
+        EXPECT_EQ(3u, Counted::instances(), "");
+    }
+
+    EXPECT_EQ(0u, Counted::instances(), "");
+
+    END_TEST;
+}
+
+}  // namespace
+
+BEGIN_TEST_CASE(small_vector_tests)
+RUN_NAMED_TEST("inline test", inline_test)
+RUN_NAMED_TEST("spill test", spill_test)
+RUN_NAMED_TEST("move test", move_test)
+END_TEST_CASE(small_vector_tests);
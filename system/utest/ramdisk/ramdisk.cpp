@@ -79,6 +79,41 @@ static bool ramdisk_test_simple(void) {
     END_TEST;
 }
 
+static bool ramdisk_test_mappable_vmo(void) {
+    uint8_t buf[PAGE_SIZE];
+    uint8_t out[PAGE_SIZE];
+
+    BEGIN_TEST;
+    int fd = get_ramdisk("ramdisk-test-mappable-vmo", PAGE_SIZE, 512);
+
+    mx_handle_t vmo;
+    ASSERT_EQ(ioctl_block_get_mappable_vmo(fd, &vmo), (ssize_t) sizeof(vmo),
+              "Could not get backing vmo");
+    uintptr_t mapped;
+    ASSERT_EQ(mx_vmar_map(mx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE * 2,
+                          MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE, &mapped),
+              NO_ERROR, "Could not map backing vmo");
+
+    // Data written through the fd is visible through the mapping...
+    memset(buf, 'a', sizeof(buf));
+    ASSERT_EQ(write(fd, buf, sizeof(buf)), (ssize_t) sizeof(buf), "");
+    ASSERT_EQ(memcmp((void*) mapped, buf, sizeof(buf)), 0, "");
+
+    // ...and data written through the mapping is visible through the fd
+    memset((void*) (mapped + PAGE_SIZE), 'b', PAGE_SIZE);
+    memset(buf, 'b', sizeof(buf));
+    memset(out, 0, sizeof(out));
+    ASSERT_EQ(lseek(fd, PAGE_SIZE, SEEK_SET), PAGE_SIZE, "");
+    ASSERT_EQ(read(fd, out, sizeof(out)), (ssize_t) sizeof(out), "");
+    ASSERT_EQ(memcmp(out, buf, sizeof(out)), 0, "");
+
+    ASSERT_EQ(mx_vmar_unmap(mx_vmar_root_self(), mapped, PAGE_SIZE * 2), NO_ERROR, "");
+    ASSERT_EQ(mx_handle_close(vmo), NO_ERROR, "");
+    ASSERT_GE(ioctl_ramdisk_unlink(fd), 0, "Could not unlink ramdisk device");
+    close(fd);
+    END_TEST;
+}
+
 // This test creates a ramdisk, verifies it is visible in the filesystem
 // (where we expect it to be!) and verifies that it is removed when we
 // "unplug" the device.
@@ -899,6 +934,7 @@ bool ramdisk_test_fifo_bad_client_bad_vmo(void) {
 
 BEGIN_TEST_CASE(ramdisk_tests)
 RUN_TEST(ramdisk_test_simple)
+RUN_TEST(ramdisk_test_mappable_vmo)
 RUN_TEST(ramdisk_test_filesystem)
 RUN_TEST(ramdisk_test_bad_requests)
 RUN_TEST(ramdisk_test_multiple)
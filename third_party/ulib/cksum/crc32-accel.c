@@ -0,0 +1,331 @@
+/* crc32-accel.c -- CRC-32 and CRC-32C with hardware carryless-multiply
+ * and CRC instructions
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ *
+ * GPT header validation and image verification run crc32() over megabytes,
+ * where the bytewise/slicing table loops in crc32.c leave a lot on the
+ * table.  This file provides:
+ *  * crc32_accel(): the zlib-polynomial CRC folded 64 bytes at a time with
+ *    PCLMULQDQ on x86-64 (following Gopal et al., "Fast CRC Computation for
+ *    Generic Polynomials Using PCLMULQDQ Instruction"), or computed with
+ *    the arm64 crc32x instructions.  crc32() in crc32.c dispatches to it.
+ *  * crc32c(): the Castagnoli CRC used by modern on-disk formats, computed
+ *    with the SSE4.2 crc32 instruction or the arm64 crc32cx instructions,
+ *    with a bytewise table fallback.
+ *
+ * As with the merkle library's SHA-256 paths, x86-64 support is detected
+ * at runtime via cpuid, while the arm64 paths are only compiled in when
+ * the target build enables the CRC32 extension, since userspace has no way
+ * to query ID_AA64ISAR0_EL1.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <lib/cksum.h>
+
+#include "crc32-accel.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h> /* SSE4.2 */
+#include <wmmintrin.h> /* PCLMULQDQ */
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+/* Bytewise table for the Castagnoli polynomial (reflected 0x82f63b78),
+ * used when no CRC instruction is available.  arm64 builds with the CRC32
+ * extension enabled always take the instruction path, so the table is
+ * omitted there.
+ */
+#if !defined(__aarch64__) || !defined(__ARM_FEATURE_CRC32)
+static const uint32_t crc32c_table[256] = {
+    0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4,
+    0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
+    0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b,
+    0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24,
+    0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b,
+    0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+    0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54,
+    0x5d1d08bf, 0xaf768bbc, 0xbc267848, 0x4e4dfb4b,
+    0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a,
+    0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+    0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5,
+    0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+    0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45,
+    0xf779deae, 0x05125dad, 0x1642ae59, 0xe4292d5a,
+    0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a,
+    0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595,
+    0x417b1dbc, 0xb3109ebf, 0xa0406d4b, 0x522bee48,
+    0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+    0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687,
+    0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+    0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927,
+    0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38,
+    0xdbfc821c, 0x2997011f, 0x3ac7f2eb, 0xc8ac71e8,
+    0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+    0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096,
+    0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789,
+    0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859,
+    0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46,
+    0x7198540d, 0x83f3d70e, 0x90a324fa, 0x62c8a7f9,
+    0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+    0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36,
+    0x3cdb9bdd, 0xceb018de, 0xdde0eb2a, 0x2f8b6829,
+    0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c,
+    0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93,
+    0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043,
+    0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+    0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3,
+    0x55326b08, 0xa759e80b, 0xb4091bff, 0x466298fc,
+    0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c,
+    0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+    0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652,
+    0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+    0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d,
+    0xef087a76, 0x1d63f975, 0x0e330a81, 0xfc588982,
+    0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d,
+    0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622,
+    0x38cc2a06, 0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2,
+    0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+    0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530,
+    0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+    0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff,
+    0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0,
+    0xd3d3e1ab, 0x21b862a8, 0x32e8915c, 0xc083125f,
+    0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+    0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90,
+    0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f,
+    0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee,
+    0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1,
+    0x69e9f0d5, 0x9b8273d6, 0x88d28022, 0x7ab90321,
+    0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+    0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81,
+    0x34f4f86a, 0xc69f7b69, 0xd5cf889d, 0x27a40b9e,
+    0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e,
+    0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351
+};
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char* buf, unsigned len) {
+    while (len--) {
+        crc = crc32c_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+#endif
+
+#if defined(__x86_64__)
+
+/* CPUID.1:ECX feature bits. */
+#define X86_FEATURE_PCLMULQDQ (1u << 1)
+#define X86_FEATURE_SSE4_1 (1u << 19)
+#define X86_FEATURE_SSE4_2 (1u << 20)
+
+static uint32_t x86_features(void) {
+    static uint32_t features;
+    static int probed;
+    if (!probed) {
+        uint32_t eax, ebx, ecx, edx;
+        __asm__("cpuid"
+                : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                : "a"(1u), "c"(0u));
+        features = ecx;
+        probed = 1;
+    }
+    return features;
+}
+
+int crc32_accel_supported(void) {
+    return (x86_features() & (X86_FEATURE_PCLMULQDQ | X86_FEATURE_SSE4_1)) ==
+           (X86_FEATURE_PCLMULQDQ | X86_FEATURE_SSE4_1);
+}
+
+/* Constants from the paper above, bit-reflected for the 0xedb88320
+ * polynomial: k1/k2 fold 512 bits, k3/k4 fold 128 bits, k5 reduces
+ * 128 to 64 bits, and poly holds P(x) and mu for the Barrett reduction.
+ */
+__attribute__((aligned(16))) static const uint64_t crc32_k1k2[] = {
+    0x0154442bd4, 0x01c6e41596};
+__attribute__((aligned(16))) static const uint64_t crc32_k3k4[] = {
+    0x01751997d0, 0x00ccaa009e};
+__attribute__((aligned(16))) static const uint64_t crc32_k5k0[] = {
+    0x0163cd6124, 0x0000000000};
+__attribute__((aligned(16))) static const uint64_t crc32_poly[] = {
+    0x01db710641, 0x01f7011641};
+
+__attribute__((target("pclmul,sse4.1")))
+uint32_t crc32_accel(const unsigned char* buf, unsigned len, uint32_t crc) {
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    /* The caller guarantees at least one block of 64. */
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+    x0 = _mm_load_si128((const __m128i*)crc32_k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    /* Fold four 128-bit lanes in parallel across blocks of 64. */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+        x1 = _mm_xor_si128(x1, x5);
+        x2 = _mm_xor_si128(x2, x6);
+        x3 = _mm_xor_si128(x3, x7);
+        x4 = _mm_xor_si128(x4, x8);
+
+        x1 = _mm_xor_si128(x1, y5);
+        x2 = _mm_xor_si128(x2, y6);
+        x3 = _mm_xor_si128(x3, y7);
+        x4 = _mm_xor_si128(x4, y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /* Fold the four lanes down to one. */
+    x0 = _mm_load_si128((const __m128i*)crc32_k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(x1, x2);
+    x1 = _mm_xor_si128(x1, x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(x1, x3);
+    x1 = _mm_xor_si128(x1, x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(x1, x4);
+    x1 = _mm_xor_si128(x1, x5);
+
+    /* Fold any remaining blocks of 16. */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(x1, x2);
+        x1 = _mm_xor_si128(x1, x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits to 64 bits. */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)crc32_k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduce to 32 bits. */
+    x0 = _mm_load_si128((const __m128i*)crc32_poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* buf, unsigned len) {
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, buf, sizeof(word));
+        c = _mm_crc32_u64(c, word);
+        buf += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)c;
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *buf++);
+    }
+    return crc;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+
+int crc32_accel_supported(void) {
+    return 1;
+}
+
+uint32_t crc32_accel(const unsigned char* buf, unsigned len, uint32_t crc) {
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, buf, sizeof(word));
+        crc = __crc32d(crc, word);
+        buf += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32b(crc, *buf++);
+    }
+    return crc;
+}
+
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* buf, unsigned len) {
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, buf, sizeof(word));
+        crc = __crc32cd(crc, word);
+        buf += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *buf++);
+    }
+    return crc;
+}
+
+#endif
+
+unsigned long crc32c(unsigned long crc, const unsigned char* buf,
+                     unsigned int len) {
+    if (buf == NULL) {
+        return 0UL;
+    }
+    uint32_t c = (uint32_t)crc ^ 0xffffffffu;
+#if defined(__x86_64__)
+    if (x86_features() & X86_FEATURE_SSE4_2) {
+        c = crc32c_hw(c, buf, len);
+    } else {
+        c = crc32c_sw(c, buf, len);
+    }
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    c = crc32c_hw(c, buf, len);
+#else
+    c = crc32c_sw(c, buf, len);
+#endif
+    return (unsigned long)(c ^ 0xffffffffu);
+}
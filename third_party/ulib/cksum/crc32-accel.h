@@ -0,0 +1,33 @@
+/* crc32-accel.h -- hardware-assisted CRC internals
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#ifndef CRC32_ACCEL_H
+#define CRC32_ACCEL_H
+
+#include <stdint.h>
+
+/* CRC32_ACCEL is defined when crc32-accel.c provides a fast path for the
+ * zlib-polynomial crc32().  On x86-64 support must still be confirmed at
+ * runtime with crc32_accel_supported(); on arm64 the path is only compiled
+ * in when the target build enables the CRC32 extension, so the check is
+ * constant-true there.
+ */
+#if defined(__x86_64__)
+#define CRC32_ACCEL 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32_ACCEL 1
+#endif
+
+#ifdef CRC32_ACCEL
+int crc32_accel_supported(void);
+
+/* Computes the zlib-polynomial CRC-32 of buf[0..len-1].  crc is the raw
+ * shift register value: the caller performs the usual pre- and
+ * post-conditioning (xor with 0xffffffff).  len must be a multiple of 16
+ * and at least 64.
+ */
+uint32_t crc32_accel(const unsigned char* buf, unsigned len, uint32_t crc);
+#endif
+
+#endif /* CRC32_ACCEL_H */
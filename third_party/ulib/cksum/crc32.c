@@ -30,6 +30,8 @@
 
 #include "zutil.h"      /* for STDC and FAR definitions */
 
+#include "crc32-accel.h"
+
 #define local static
 
 /* Definitions for doing the crc four data bytes at a time. */
@@ -214,6 +216,18 @@ unsigned long ZEXPORT crc32(crc, buf, len)
         make_crc_table();
 #endif /* DYNAMIC_CRC_TABLE */
 
+#ifdef CRC32_ACCEL
+    if (len >= 64 && crc32_accel_supported()) {
+        /* The folded path handles multiples of 16; the table loops below
+           pick up the tail. */
+        unsigned chunk = len & ~15u;
+        crc = (unsigned long)~crc32_accel(buf, chunk, (uint32_t)~crc);
+        buf += chunk;
+        len -= chunk;
+        if (len == 0) return crc;
+    }
+#endif /* CRC32_ACCEL */
+
 #ifdef BYFOUR
     if (sizeof(void *) == sizeof(ptrdiff_t)) {
         z_crc_t endian;
@@ -22,6 +22,13 @@ unsigned short update_crc16(unsigned short crc, const unsigned char *buf, unsign
 
 unsigned long crc32(unsigned long crc, const unsigned char *buf, unsigned int len);
 
+/*
+ * Computes the CRC-32C (Castagnoli) of 'buf', continuing from 'crc'.
+ * Same calling convention as crc32(): pass 0 to start a new checksum.
+ * Uses the SSE4.2 / arm64 CRC32C instructions where available.
+ */
+unsigned long crc32c(unsigned long crc, const unsigned char *buf, unsigned int len);
+
 unsigned long adler32(unsigned long adler, const unsigned char *buf, unsigned int len);
 
 __END_CDECLS
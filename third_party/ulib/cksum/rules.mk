@@ -7,7 +7,8 @@ MODULE_TYPE := userlib
 MODULE_SRCS += \
     $(LOCAL_DIR)/adler32.c \
     $(LOCAL_DIR)/crc16.c \
-    $(LOCAL_DIR)/crc32.c
+    $(LOCAL_DIR)/crc32.c \
+    $(LOCAL_DIR)/crc32-accel.c
 
 MODULE_CFLAGS := -Wno-strict-prototypes
 
@@ -37,7 +37,9 @@
  * next step after purging on Windows anyway, there's no point in adding such
  * complexity.
  */
-#if !defined(_WIN32) && defined(JEMALLOC_PURGE_MADVISE_DONTNEED)
+/* On Fuchsia, forced purging decommits through the mapping's backing vmo. */
+#if !defined(_WIN32) && (defined(JEMALLOC_PURGE_MADVISE_DONTNEED) || \
+    defined(__Fuchsia__))
 #  define PAGES_CAN_PURGE_FORCED
 #endif
 
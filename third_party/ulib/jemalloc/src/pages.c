@@ -5,6 +5,12 @@
 #include <sys/sysctl.h>
 #endif
 
+#ifdef __Fuchsia__
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
+#include <stdatomic.h>
+#endif
+
 /******************************************************************************/
 /* Data. */
 
@@ -17,6 +23,132 @@ static bool	os_overcommits;
 
 /******************************************************************************/
 
+#ifdef __Fuchsia__
+/*
+ * Returning memory to the kernel requires the vmo backing a mapping, which
+ * mmap() never exposes, so on Fuchsia mappings are made directly with the
+ * vmar API and the backing vmo of every mapping is remembered here.
+ * pages_purge_forced() consults the table to translate an address range
+ * into a vmo range for MX_VMO_OP_DECOMMIT, which frees the backing pages;
+ * they are faulted back in zero-filled on next access, which is what
+ * forced purging promises.
+ *
+ * Trimming only ever unmaps a prefix or a suffix of a mapping, which the
+ * bookkeeping below mirrors.  If a hole is ever punched in the middle of
+ * a region its vmo handle is dropped and purging simply stops working for
+ * what remains of it, which is safe.
+ */
+typedef struct {
+	uintptr_t	base;	/* address vmo offset 0 is mapped at */
+	uintptr_t	start;	/* live range of the mapping */
+	uintptr_t	end;
+	mx_handle_t	vmo;	/* MX_HANDLE_INVALID when unused */
+} fuchsia_region_t;
+
+#define	FUCHSIA_MAX_REGIONS	128
+
+static fuchsia_region_t	fuchsia_regions[FUCHSIA_MAX_REGIONS];
+static atomic_flag	fuchsia_regions_lock = ATOMIC_FLAG_INIT;
+
+static void
+fuchsia_regions_acquire(void)
+{
+
+	while (atomic_flag_test_and_set_explicit(&fuchsia_regions_lock,
+	    memory_order_acquire)) {
+	}
+}
+
+static void
+fuchsia_regions_release(void)
+{
+
+	atomic_flag_clear_explicit(&fuchsia_regions_lock, memory_order_release);
+}
+
+static void
+fuchsia_region_add(uintptr_t addr, size_t size, mx_handle_t vmo)
+{
+	unsigned i;
+
+	fuchsia_regions_acquire();
+	for (i = 0; i < FUCHSIA_MAX_REGIONS; i++) {
+		fuchsia_region_t *r = &fuchsia_regions[i];
+		if (r->vmo == MX_HANDLE_INVALID) {
+			r->base = addr;
+			r->start = addr;
+			r->end = addr + size;
+			r->vmo = vmo;
+			fuchsia_regions_release();
+			return;
+		}
+	}
+	fuchsia_regions_release();
+	/* Table full; the mapping works but can no longer be purged. */
+	_mx_handle_close(vmo);
+}
+
+static void
+fuchsia_region_unmapped(uintptr_t addr, size_t size)
+{
+	uintptr_t top = addr + size;
+	mx_handle_t vmo = MX_HANDLE_INVALID;
+	unsigned i;
+
+	fuchsia_regions_acquire();
+	for (i = 0; i < FUCHSIA_MAX_REGIONS; i++) {
+		fuchsia_region_t *r = &fuchsia_regions[i];
+		if (r->vmo == MX_HANDLE_INVALID || top <= r->start ||
+		    addr >= r->end)
+			continue;
+		if (addr <= r->start && top >= r->end) {
+			/* The whole region is gone. */
+			vmo = r->vmo;
+			r->vmo = MX_HANDLE_INVALID;
+		} else if (addr <= r->start)
+			r->start = top;
+		else if (top >= r->end)
+			r->end = addr;
+		else {
+			/* Hole in the middle; give up on purging this one. */
+			vmo = r->vmo;
+			r->vmo = MX_HANDLE_INVALID;
+		}
+		break;
+	}
+	fuchsia_regions_release();
+	if (vmo != MX_HANDLE_INVALID)
+		_mx_handle_close(vmo);
+}
+
+static bool
+fuchsia_decommit(void *addr, size_t size)
+{
+	uintptr_t a = (uintptr_t)addr;
+	bool err = true;
+	unsigned i;
+
+	/*
+	 * The op is issued under the table lock so the handle cannot be
+	 * closed out from underneath a concurrent unmap of the region.
+	 */
+	fuchsia_regions_acquire();
+	for (i = 0; i < FUCHSIA_MAX_REGIONS; i++) {
+		fuchsia_region_t *r = &fuchsia_regions[i];
+		if (r->vmo != MX_HANDLE_INVALID && a >= r->start &&
+		    a + size <= r->end) {
+			err = (_mx_vmo_op_range(r->vmo, MX_VMO_OP_DECOMMIT,
+			    a - r->base, size, NULL, 0) != NO_ERROR);
+			break;
+		}
+	}
+	fuchsia_regions_release();
+	return (err);
+}
+#endif /* __Fuchsia__ */
+
+/******************************************************************************/
+
 void *
 pages_map(void *addr, size_t size, bool *commit)
 {
@@ -34,6 +166,44 @@ pages_map(void *addr, size_t size, bool *commit)
 	 */
 	ret = VirtualAlloc(addr, size, MEM_RESERVE | (*commit ? MEM_COMMIT : 0),
 	    PAGE_READWRITE);
+#elif defined(__Fuchsia__)
+	{
+		mx_handle_t vmo;
+		uintptr_t ptr = 0;
+		size_t offset = 0;
+		uint32_t mx_flags = MX_VM_FLAG_PERM_READ |
+		    MX_VM_FLAG_PERM_WRITE;
+
+		if (_mx_vmo_create(size, 0, &vmo) != NO_ERROR)
+			return (NULL);
+		_mx_object_set_property(vmo, MX_PROP_NAME, "jemalloc-heap",
+		    strlen("jemalloc-heap"));
+		if (addr != NULL) {
+			mx_info_vmar_t info;
+
+			if (_mx_object_get_info(_mx_vmar_root_self(),
+			    MX_INFO_VMAR, &info, sizeof(info), NULL,
+			    NULL) != NO_ERROR || (uintptr_t)addr < info.base) {
+				_mx_handle_close(vmo);
+				return (NULL);
+			}
+			offset = (uintptr_t)addr - info.base;
+			/*
+			 * Unlike MAP_FIXED, a specific vmar mapping never
+			 * replaces an existing mapping; it simply fails,
+			 * which is the semantic wanted here.
+			 */
+			mx_flags |= MX_VM_FLAG_SPECIFIC;
+		}
+		if (_mx_vmar_map(_mx_vmar_root_self(), offset, vmo, 0, size,
+		    mx_flags, &ptr) != NO_ERROR) {
+			_mx_handle_close(vmo);
+			return (NULL);
+		}
+		/* The table owns the vmo handle from here on. */
+		fuchsia_region_add(ptr, size, vmo);
+		ret = (void *)ptr;
+	}
 #else
 	/*
 	 * We don't use MAP_FIXED here, because it can cause the *replacement*
@@ -66,6 +236,9 @@ pages_unmap(void *addr, size_t size)
 {
 #ifdef _WIN32
 	if (VirtualFree(addr, 0, MEM_RELEASE) == 0)
+#elif defined(__Fuchsia__)
+	if (_mx_vmar_unmap(_mx_vmar_root_self(), (uintptr_t)addr,
+	    size) != NO_ERROR)
 #else
 	if (munmap(addr, size) == -1)
 #endif
@@ -76,6 +249,8 @@ pages_unmap(void *addr, size_t size)
 		malloc_printf("<jemalloc>: Error in "
 #ifdef _WIN32
 		              "VirtualFree"
+#elif defined(__Fuchsia__)
+		              "mx_vmar_unmap"
 #else
 		              "munmap"
 #endif
@@ -83,6 +258,10 @@ pages_unmap(void *addr, size_t size)
 		if (opt_abort)
 			abort();
 	}
+#ifdef __Fuchsia__
+	else
+		fuchsia_region_unmapped((uintptr_t)addr, size);
+#endif
 }
 
 void *
@@ -182,6 +361,8 @@ pages_purge_forced(void *addr, size_t size)
 
 #if defined(JEMALLOC_PURGE_MADVISE_DONTNEED)
 	return (madvise(addr, size, MADV_DONTNEED) != 0);
+#elif defined(__Fuchsia__)
+	return (fuchsia_decommit(addr, size));
 #else
 	not_reached();
 #endif
@@ -288,6 +469,13 @@ pages_boot(void)
 	if (os_overcommits)
 		mmap_flags |= MAP_NORESERVE;
 #  endif
+#elif defined(__Fuchsia__)
+	/*
+	 * vmo pages are committed on demand, so there is no separate
+	 * decommitted-but-reserved state; unused dirty pages are returned
+	 * through forced purging instead.
+	 */
+	os_overcommits = true;
 #else
 	os_overcommits = false;
 #endif
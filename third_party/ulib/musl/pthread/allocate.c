@@ -4,6 +4,7 @@
 
 #include <magenta/process.h>
 #include <magenta/syscalls.h>
+#include <runtime/mutex.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -28,6 +29,76 @@ static inline size_t round_up_to_page(size_t sz) {
     return (sz + PAGE_SIZE - 1) & -PAGE_SIZE;
 }
 
+// Setting up a thread's stacks costs a vmar allocation and a mapping
+// each for the safe and the unsafe stack, and tearing them down costs
+// the unmaps. Nearly every thread uses the default geometry, so rather
+// than unmapping the stacks of an exited thread, keep them mapped and
+// hand them to the next pthread_create asking for the same sizes. The
+// bookkeeping entry lives in the first bytes of the dead safe stack
+// itself, so the cache allocates no memory of its own. The TCB region
+// is never cached; its size depends on the TLS state, which dlopen can
+// change, and it has to be re-initialized per thread anyway.
+struct thread_stacks {
+    struct thread_stacks* next;
+    struct iovec safe_stack, safe_stack_region;
+    struct iovec unsafe_stack, unsafe_stack_region;
+};
+
+#define STACK_CACHE_MAX 8
+
+static struct thread_stacks* stack_cache;
+static unsigned stack_cache_count;
+static mxr_mutex_t stack_cache_lock = MXR_MUTEX_INIT;
+
+__NO_SAFESTACK static struct thread_stacks* stack_cache_take(
+    size_t stack_size, size_t guard_size) {
+    struct thread_stacks* e = NULL;
+    mxr_mutex_lock(&stack_cache_lock);
+    for (struct thread_stacks** ep = &stack_cache; *ep != NULL;
+         ep = &(*ep)->next) {
+        if ((*ep)->safe_stack.iov_len == stack_size &&
+            (*ep)->safe_stack_region.iov_len == guard_size + stack_size) {
+            e = *ep;
+            *ep = e->next;
+            stack_cache_count--;
+            break;
+        }
+    }
+    mxr_mutex_unlock(&stack_cache_lock);
+    return e;
+}
+
+__NO_SAFESTACK static void stack_cache_put(struct thread_stacks* e) {
+    mxr_mutex_lock(&stack_cache_lock);
+    if (stack_cache_count < STACK_CACHE_MAX) {
+        e->next = stack_cache;
+        stack_cache = e;
+        stack_cache_count++;
+        e = NULL;
+    }
+    mxr_mutex_unlock(&stack_cache_lock);
+    if (e != NULL) {
+        // Copy the regions out before the unmap pulls the entry's own
+        // memory out from under it.
+        struct iovec safe_region = e->safe_stack_region;
+        struct iovec unsafe_region = e->unsafe_stack_region;
+        _mx_vmar_unmap(_mx_vmar_root_self(),
+                       (uintptr_t)unsafe_region.iov_base,
+                       unsafe_region.iov_len);
+        _mx_vmar_unmap(_mx_vmar_root_self(),
+                       (uintptr_t)safe_region.iov_base, safe_region.iov_len);
+    }
+}
+
+__NO_SAFESTACK void __thread_stacks_release(pthread_t td) {
+    struct thread_stacks* e = td->safe_stack.iov_base;
+    e->safe_stack = td->safe_stack;
+    e->safe_stack_region = td->safe_stack_region;
+    e->unsafe_stack = td->unsafe_stack;
+    e->unsafe_stack_region = td->unsafe_stack_region;
+    stack_cache_put(e);
+}
+
 static ptrdiff_t offset_for_module(const struct tls_module* module) {
 #ifdef TLS_ABOVE_TP
     return module->offset;
@@ -123,11 +194,18 @@ __NO_SAFESTACK pthread_t __allocate_thread(const pthread_attr_t* attr) {
 
     const size_t tcb_size = round_up_to_page(libc.tls_size);
 
-    const size_t vmo_size = tcb_size + stack_size * 2;
+    // A recycled pair of stacks saves both stack mappings; the vmo then
+    // only needs to back the TCB region.
+    struct thread_stacks* stacks = stack_cache_take(stack_size, guard_size);
+
+    const size_t vmo_size =
+        tcb_size + (stacks == NULL ? stack_size * 2 : 0);
     mx_handle_t vmo;
     mx_status_t status = _mx_vmo_create(vmo_size, 0, &vmo);
     if (status != NO_ERROR) {
         __thread_allocation_release();
+        if (stacks != NULL)
+            stack_cache_put(stacks);
         return NULL;
     }
 
@@ -136,6 +214,8 @@ __NO_SAFESTACK pthread_t __allocate_thread(const pthread_attr_t* attr) {
                   &tcb, &tcb_region)) {
         __thread_allocation_release();
         _mx_handle_close(vmo);
+        if (stacks != NULL)
+            stack_cache_put(stacks);
         return NULL;
     }
 
@@ -145,25 +225,32 @@ __NO_SAFESTACK pthread_t __allocate_thread(const pthread_attr_t* attr) {
     // can allow dlopen again.
     __thread_allocation_release();
 
-    if (map_block(_mx_vmar_root_self(), vmo,
-                  tcb_size, stack_size, guard_size, 0,
-                  &td->safe_stack, &td->safe_stack_region)) {
-        _mx_vmar_unmap(_mx_vmar_root_self(),
-                       (uintptr_t)tcb_region.iov_base, tcb_region.iov_len);
-        _mx_handle_close(vmo);
-        return NULL;
-    }
+    if (stacks != NULL) {
+        td->safe_stack = stacks->safe_stack;
+        td->safe_stack_region = stacks->safe_stack_region;
+        td->unsafe_stack = stacks->unsafe_stack;
+        td->unsafe_stack_region = stacks->unsafe_stack_region;
+    } else {
+        if (map_block(_mx_vmar_root_self(), vmo,
+                      tcb_size, stack_size, guard_size, 0,
+                      &td->safe_stack, &td->safe_stack_region)) {
+            _mx_vmar_unmap(_mx_vmar_root_self(),
+                           (uintptr_t)tcb_region.iov_base, tcb_region.iov_len);
+            _mx_handle_close(vmo);
+            return NULL;
+        }
 
-    if (map_block(_mx_vmar_root_self(), vmo,
-                  tcb_size + stack_size, stack_size, guard_size, 0,
-                  &td->unsafe_stack, &td->unsafe_stack_region)) {
-        _mx_vmar_unmap(_mx_vmar_root_self(),
-                       (uintptr_t)td->safe_stack_region.iov_base,
-                       td->safe_stack_region.iov_len);
-        _mx_vmar_unmap(_mx_vmar_root_self(),
-                       (uintptr_t)tcb_region.iov_base, tcb_region.iov_len);
-        _mx_handle_close(vmo);
-        return NULL;
+        if (map_block(_mx_vmar_root_self(), vmo,
+                      tcb_size + stack_size, stack_size, guard_size, 0,
+                      &td->unsafe_stack, &td->unsafe_stack_region)) {
+            _mx_vmar_unmap(_mx_vmar_root_self(),
+                           (uintptr_t)td->safe_stack_region.iov_base,
+                           td->safe_stack_region.iov_len);
+            _mx_vmar_unmap(_mx_vmar_root_self(),
+                           (uintptr_t)tcb_region.iov_base, tcb_region.iov_len);
+            _mx_handle_close(vmo);
+            return NULL;
+        }
     }
 
     _mx_handle_close(vmo);
@@ -67,8 +67,7 @@ int pthread_create(pthread_t* restrict res, const pthread_attr_t* restrict attrp
 
     atomic_fetch_sub(&libc.thread_count, 1);
 fail_after_alloc:
-    deallocate_region(&new->safe_stack_region);
-    deallocate_region(&new->unsafe_stack_region);
+    __thread_stacks_release(new);
     deallocate_region(&new->tcb_region);
     return status == ERR_ACCESS_DENIED ? EPERM : EAGAIN;
 }
@@ -77,8 +76,9 @@ static _Noreturn void final_exit(pthread_t self)
     __asm__("final_exit") __attribute__((used));
 
 static __NO_SAFESTACK void final_exit(pthread_t self) {
-    deallocate_region(&self->safe_stack_region);
-    deallocate_region(&self->unsafe_stack_region);
+    // The stacks usually go into the cache for the next thread rather
+    // than being unmapped; we're running on the TCB region either way.
+    __thread_stacks_release(self);
 
     // This deallocates the TCB region too for the detached case.
     // If not detached, pthread_join will deallocate it.
@@ -205,4 +205,9 @@ static inline int __rt_sigqueueinfo(pid_t pid, int sig, siginfo_t* info) {
 pthread_t __allocate_thread(const pthread_attr_t* attr)
     __attribute__((nonnull(1))) ATTR_LIBC_VISIBILITY;
 
+// Release a thread's stacks, either into the per-process stack cache
+// for reuse by a later pthread_create or by unmapping them.  The
+// caller must no longer be running on either stack.
+void __thread_stacks_release(pthread_t td) ATTR_LIBC_VISIBILITY;
+
 pthread_t __init_main_thread(mx_handle_t thread_self) ATTR_LIBC_VISIBILITY;